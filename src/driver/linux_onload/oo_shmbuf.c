@@ -2,7 +2,22 @@
 #include <onload/oo_shmbuf.h>
 
 
-int oo_shmbuf_alloc(struct oo_shmbuf* sh, int order, int max, int init_num)
+/* vmalloc_user() can't be told which node to use.  Where the mapping
+ * doesn't rely on VM_USERMAP (see oo_remap_vmalloc_range_partial(), in
+ * linux>=5.13) a zeroed allocation on the node does just as well.
+ */
+static void* oo_shmbuf_vmalloc(struct oo_shmbuf* sh, unsigned long size)
+{
+#ifndef EFRM_HAS_REMAP_VMALLOC_RANGE_PARTIAL
+  if( sh->numa_node != NUMA_NO_NODE )
+    return vzalloc_node(size, sh->numa_node);
+#endif
+  return vmalloc_user(size);
+}
+
+
+int oo_shmbuf_alloc(struct oo_shmbuf* sh, int order, int max, int init_num,
+                    int numa_node)
 {
   int i;
 
@@ -10,13 +25,15 @@ int oo_shmbuf_alloc(struct oo_shmbuf* sh, int order, int max, int init_num)
   sh->order = order;
   sh->num = init_num;
   sh->init_num = init_num;
+  sh->numa_node = numa_node;
   mutex_init(&sh->lock);
 
   sh->addrs = kzalloc(sizeof(sh->addrs[0]) * max, GFP_KERNEL);
   if( sh->addrs == NULL )
     return -ENOMEM;
 
-  sh->addrs[0] = vmalloc_user((unsigned long)init_num << PAGE_SHIFT << order);
+  sh->addrs[0] = oo_shmbuf_vmalloc(sh, (unsigned long)init_num <<
+                                       PAGE_SHIFT << order);
   if( sh->addrs[0] == 0 ) {
     ci_log("%s: failed to allocate a virtually-continuous buffer of size %ld",
            __func__, (unsigned long)init_num << PAGE_SHIFT << order);
@@ -55,7 +72,7 @@ int oo_shmbuf_add(struct oo_shmbuf* sh)
   i = sh->num;
   /* Fixme implement locking */
 
-  sh->addrs[i] = vmalloc_user(PAGE_SIZE << sh->order);
+  sh->addrs[i] = oo_shmbuf_vmalloc(sh, PAGE_SIZE << sh->order);
   if( sh->addrs[i] == 0 ) {
     mutex_unlock(&sh->lock);
     return -ENOMEM;
@@ -411,6 +411,10 @@ typedef struct {
   ci_int32      sack_blocks;
   ci_uint32     ack,seq;         /* ACK and SEQ values in host endian */
   ci_uint32     hash;            /* hash for l/r addr/port */
+#if CI_CFG_TCP_FASTOPEN
+  ci_uint8*     fastopen_cookie; /* pointer into the TCP options */
+  ci_int8       fastopen_len;    /* cookie length, or -1 if no option */
+#endif
 } ciip_tcp_rx_pkt;
 
 
@@ -873,6 +877,19 @@ extern void ci_udp_ep_assert_valid(citp_socket* ep,
 extern void ci_udp_handle_rx(ci_netif*, ci_ip_pkt_fmt* pkt, ci_udp_hdr*,
                              int ip_paylen) CI_HF;
 
+/*** udp_reuseport.c ***/
+#if CI_CFG_UDP_REUSEPORT
+extern void ci_udp_reuseport_group_join(ci_netif*, ci_udp_state*) CI_HF;
+extern void ci_udp_reuseport_group_leave(ci_netif*, ci_udp_state*) CI_HF;
+extern int ci_udp_reuseport_group_attach(ci_netif*, ci_udp_state*,
+                                         const struct oo_bpf_insn* prog,
+                                         unsigned len) CI_HF;
+/* The member of [us]'s group that should receive [pkt], or [us] */
+extern ci_udp_state*
+ci_udp_reuseport_group_select(ci_netif*, ci_udp_state* us,
+                              ci_ip_pkt_fmt* pkt) CI_HF;
+#endif
+
 
 ci_inline 
 void ci_pkt_init_from_ipcache_len(ci_ip_pkt_fmt *pkt,
@@ -921,8 +938,10 @@ struct cmsg_state {
 
 extern void ci_put_cmsg(struct cmsg_state *cmsg_state, int level, int type,
                         socklen_t len, const void *data) CI_HF;
-/* info_out contains a pointer to struct in_pktinfo or struct in6_pktinfo */
-extern int ci_ip_cmsg_send(const struct msghdr*, void** info_out) CI_HF;
+/* info_out contains a pointer to struct in_pktinfo or struct in6_pktinfo,
+ * gso_size_out the UDP_SEGMENT size (both are left alone if not given) */
+extern int ci_ip_cmsg_send(const struct msghdr*, void** info_out,
+                           ci_uint32* gso_size_out) CI_HF;
 extern void ci_ip_cmsg_finish(struct cmsg_state* cmsg_state) CI_HF;
 
 #ifndef __KERNEL__
@@ -997,6 +1016,11 @@ extern int ci_tcp_zc_send(ci_netif* ni, ci_tcp_state* ts,
                           struct onload_zc_mmsg* msgs, int flags);
 struct onload_zc_recv_args;
 int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args);
+struct onload_zc_recv_batch_msg;
+struct onload_zc_iovec;
+int ci_udp_zc_recv_batch(ci_netif* ni, ci_udp_state* us, int fd,
+                         struct onload_zc_recv_batch_msg* msgs, int max_msgs,
+                         struct onload_zc_iovec** piov, int* piov_len);
 
 /* A special version of recvmsg to grab data from kernel stack when
  * doing zero-copy 
@@ -1020,6 +1044,10 @@ ci_netif_raw_send(ci_netif* ni, int intf_i,
 extern void ci_ip_cmsg_recv(ci_netif*, ci_udp_state*, const ci_ip_pkt_fmt*,
                             struct msghdr*, int netif_locked,
                             int *p_msg_flags) CI_HF;
+/* Append a UDP_GRO message after those from ci_ip_cmsg_recv().
+ * [controllen] is the size of the control buffer the caller passed in. */
+extern void ci_ip_cmsg_recv_gro(struct msghdr*, socklen_t controllen,
+                                int gso_size, int *p_msg_flags) CI_HF;
 #if OO_DO_STACK_POLL
 extern void ci_udp_all_fds_gone(ci_netif* netif, oo_sp, int do_free);
 #endif
@@ -1512,6 +1540,30 @@ ci_tcp_syncookie_ack(ci_netif* netif, ci_tcp_socket_listen* tls,
                      ciip_tcp_rx_pkt* rxp,
                      ci_tcp_state_synrecv **tsr_p);
 
+#if CI_CFG_TCP_FASTOPEN
+/* Length of the TCP Fast Open cookies we issue */
+#define CI_TCP_FASTOPEN_COOKIE_LEN  8
+
+extern void
+ci_tcp_fastopen_cookie(ci_netif* netif, ci_addr_t l_addr, ci_addr_t r_addr,
+                       ci_uint8* cookie);
+extern int
+ci_tcp_fastopen_cookie_check(ci_netif* netif, ci_addr_t l_addr,
+                             ci_addr_t r_addr, const ci_uint8* cookie,
+                             int len);
+/* Returns the length of the cookie cached for [r_addr], or 0 */
+extern int
+ci_tcp_fastopen_cache_get(ci_netif* netif, ci_addr_t r_addr,
+                          ci_uint8* cookie);
+extern void
+ci_tcp_fastopen_cache_put(ci_netif* netif, ci_addr_t r_addr,
+                          const ci_uint8* cookie, int len);
+extern void ci_tcp_send_fastopen_synack(ci_netif* netif,
+                                        ci_tcp_state* ts) CI_HF;
+extern int ci_tcp_tx_fastopen_requeue(ci_netif* netif,
+                                      ci_tcp_state* ts) CI_HF;
+#endif
+
 extern void ci_tcp_set_sndbuf(ci_netif* ni, ci_tcp_state* ts);
 extern void ci_tcp_set_sndbuf_from_sndbuf_pkts(ci_netif* ni, ci_tcp_state* ts);
 
@@ -1674,9 +1726,46 @@ extern void ci_tcp_retrans_recover(ci_netif* ni, ci_tcp_state* ts,
                                    int force_retrans_first) CI_HF;
 extern int /*bool*/
 ci_tcp_maybe_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern int /*bool*/
+ci_tcp_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts) CI_HF;
 
 extern void ci_tcp_recovered(ci_netif* ni, ci_tcp_state* ts) CI_HF;
 
+/* Congestion control algorithms other than reno (tcp_cong.c) */
+#define CI_TCP_CONG_NAME_MAX 16  /* as TCP_CA_NAME_MAX */
+struct ci_tcp_info;
+extern void ci_tcp_cong_init(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern int /*bool*/ ci_tcp_cong_on_ack(ci_netif* ni, ci_tcp_state* ts,
+                                       ci_uint32 ack, unsigned acked) CI_HF;
+extern unsigned ci_tcp_cong_losswnd_slow(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_cong_ecn_ack(ci_netif* ni, ci_tcp_state* ts, ci_uint32 ack,
+                                unsigned acked, int ece) CI_HF;
+extern unsigned ci_tcp_cong_ecn_losswnd(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_cong_recovered(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_cong_idle_restart(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern const char* ci_tcp_cong_name(int alg) CI_HF;
+extern int ci_tcp_cong_by_name(const char* name) CI_HF;
+extern void ci_tcp_cong_get_info(ci_netif* ni, ci_tcp_state* ts,
+                                 struct ci_tcp_info* info) CI_HF;
+extern void ci_tcp_cong_dump(ci_netif* ni, ci_tcp_state* ts, const char* pf,
+                             oo_dump_log_fn_t logger, void* log_arg) CI_HF;
+#if CI_CFG_TCP_PACING
+extern int ci_tcp_pace_budget(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_pace_sent(ci_netif* ni, ci_tcp_state* ts,
+                             unsigned bytes) CI_HF;
+extern void ci_tcp_pace_get_info(ci_netif* ni, ci_tcp_state* ts,
+                                 struct ci_tcp_info* info) CI_HF;
+#endif
+#if CI_CFG_TCP_RACK
+/* RACK-TLP loss detection (tcp_rack.c) */
+extern ci_ip_pkt_fmt* ci_tcp_rack_detect_loss(ci_netif* ni, ci_tcp_state* ts,
+                                              ci_uint32* timeout_out) CI_HF;
+extern int /*bool*/ ci_tcp_rack_on_ack(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_timeout_rack_reo(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_rack_dsack(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_rack_recovered(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+#endif
+
 extern void ci_tcp_clear_sacks(ci_netif* ni, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_retrans_init_ptrs(ci_netif* ni, ci_tcp_state* ts,
                                      unsigned* recover_seq_out) CI_HF;
@@ -1908,6 +1997,9 @@ extern void ci_tcp_timeout_zwin(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_timeout_delack(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_timeout_rto(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_timeout_cork(ci_netif* netif, ci_tcp_state* ts) CI_HF;
+#if CI_CFG_TCP_PACING
+extern void ci_tcp_timeout_pace(ci_netif* netif, ci_tcp_state* ts) CI_HF;
+#endif
 extern void ci_tcp_timeout_recycle(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_stop_timers(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_send_corked_packets(ci_netif* netif, ci_tcp_state* ts) CI_HF;
@@ -3826,6 +3918,9 @@ ci_inline void ci_tcp_rto_check_and_set(ci_netif* netif, ci_tcp_state* ts) {
   if( ! ci_ip_timer_pending(netif, &ts->rto_tid) ) {
 #if CI_CFG_TAIL_DROP_PROBE
     ts->tcpflags &=~ CI_TCPT_FLAG_TAIL_DROP_TIMING;
+#endif
+#if CI_CFG_TCP_RACK
+    ts->tcpflags &=~ CI_TCPT_FLAG_RACK_REO_TIMING;
 #endif
     ci_ip_timer_set(netif, &ts->rto_tid, ci_tcp_time_now(netif) + ts->rto);
   }
@@ -3842,7 +3937,13 @@ ci_inline void ci_tcp_rto_restart(ci_netif* netif, ci_tcp_state* ts) {
 #if CI_CFG_TAIL_DROP_PROBE
   ts->tcpflags &=~ CI_TCPT_FLAG_TAIL_DROP_TIMING;
 #endif
-  ci_ip_timer_modify(netif, &ts->rto_tid, ci_tcp_time_now(netif) + ts->rto);
+#if CI_CFG_TCP_RACK
+  ts->tcpflags &=~ CI_TCPT_FLAG_RACK_REO_TIMING;
+#endif
+  /* The RTO is restarted by nearly every ACK and rarely fires, so don't
+   * requeue it each time. */
+  ci_ip_timer_modify_lazy(netif, &ts->rto_tid,
+                          ci_tcp_time_now(netif) + ts->rto);
 }
 
 ci_inline void ci_tcp_rto_set_with_timeout(ci_netif* netif, ci_tcp_state* ts,
@@ -3851,6 +3952,9 @@ ci_inline void ci_tcp_rto_set_with_timeout(ci_netif* netif, ci_tcp_state* ts,
   ci_assert(!ci_tcp_retransq_is_empty(ts));
   /* shouldn't set an RTO timer in a state that doesn't allow them */
   ci_assert(!(ts->s.b.state & CI_TCP_STATE_NO_TIMERS));
+#if CI_CFG_TCP_RACK
+  ts->tcpflags &=~ CI_TCPT_FLAG_RACK_REO_TIMING;
+#endif
   ci_ip_timer_set(netif, &ts->rto_tid, ci_tcp_time_now(netif) + timeout);
 }
 
@@ -3895,7 +3999,12 @@ ci_inline void ci_tcp_delack_soon(ci_netif* netif, ci_tcp_state* ts)
 ci_inline int ci_tcp_taildrop_probe_enabled(const ci_netif* ni,
                                             const ci_tcp_state* ts)
 {
-  return NI_OPTS(ni).tail_drop_probe &&
+  /* RACK-TLP sends the probe whether or not EF_TAIL_DROP_PROBE is set. */
+  return (NI_OPTS(ni).tail_drop_probe
+#if CI_CFG_TCP_RACK
+          || NI_OPTS(ni).tcp_rack
+#endif
+          ) &&
          (ts->tcpflags & CI_TCPT_FLAG_SACK) &&
          ts->congstate == CI_TCP_CONG_OPEN &&
          (ts->s.b.state & CI_TCP_STATE_SYNCHRONISED);
@@ -4342,8 +4451,133 @@ ci_inline ci_uint32 ci_tcp_base_dupack_thresh(ci_tcp_state *ts) {
   return CI_CFG_TCP_DUPACK_THRESH_BASE;
 }
 
+
+#if CI_CFG_TCP_RACK
+/* RACK-TLP, RFC8985.  Times are kept in usticks (frc >> frc2us) so that
+ * 32 bits cover over an hour, and are taken from the stack's cached frc
+ * rather than read afresh for each segment.
+ */
+
+ci_inline int ci_tcp_rack_enabled(ci_netif* ni, const ci_tcp_state* ts)
+{
+  return NI_OPTS(ni).tcp_rack && (ts->tcpflags & CI_TCPT_FLAG_SACK);
+}
+
+/* Record the time at which [pkt] was (re)transmitted. */
+ci_inline void ci_tcp_rack_stamp(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  if( NI_OPTS(ni).tcp_rack )
+    pkt->tstamp_frc = IPTIMER_STATE(ni)->frc;
+}
+
+ci_inline ci_uint32 ci_tcp_rack_now(ci_netif* ni)
+{
+  return (ci_uint32) (IPTIMER_STATE(ni)->frc >>
+                      IPTIMER_STATE(ni)->ci_ip_time_frc2us);
+}
+
+ci_inline ci_uint32 ci_tcp_rack_xmit_ts(ci_netif* ni, const ci_ip_pkt_fmt* pkt)
+{
+  return (ci_uint32) (pkt->tstamp_frc >> IPTIMER_STATE(ni)->ci_ip_time_frc2us);
+}
+
+/* Was the segment ending at [seq1] sent after the one ending at [seq2]?
+ * Segments sent in the same tick are ordered by sequence number.
+ */
+ci_inline int ci_tcp_rack_sent_after(ci_uint32 t1, ci_uint32 seq1,
+                                     ci_uint32 t2, ci_uint32 seq2)
+{
+  return (ci_int32) (t1 - t2) > 0 || (t1 == t2 && SEQ_LT(seq2, seq1));
+}
+
+/* [pkt] has been newly acknowledged or SACKed: update the most recently
+ * sent segment known to be delivered, RFC8985 6.2 steps 1-3.
+ * [prior_end_seq] is ts->rack.end_seq from before this ACK, used to spot
+ * reordering.
+ */
+ci_inline void ci_tcp_rack_delivered(ci_netif* ni, ci_tcp_state* ts,
+                                     const ci_ip_pkt_fmt* pkt,
+                                     ci_uint32 prior_end_seq)
+{
+  ci_uint32 xmit_ts = ci_tcp_rack_xmit_ts(ni, pkt);
+  ci_uint32 end_seq = pkt->pf.tcp_tx.end_seq;
+  ci_int32 rtt = ci_tcp_rack_now(ni) - xmit_ts;
+  int retrans = pkt->flags & CI_PKT_FLAG_RTQ_RETRANS;
+
+  if( rtt <= 0 )
+    rtt = 1;
+  /* An ACK for a retransmission that arrives sooner than any ACK could is
+   * for the original transmission.
+   */
+  if( retrans && (ci_uint32) rtt < ts->rack.min_rtt )
+    return;
+  if( ! retrans &&
+      (ts->rack.min_rtt == 0 || (ci_uint32) rtt < ts->rack.min_rtt) )
+    ts->rack.min_rtt = rtt;
+
+  if( ts->rack.rtt == 0 ||
+      ci_tcp_rack_sent_after(xmit_ts, end_seq,
+                             ts->rack.xmit_ts, ts->rack.end_seq) ) {
+    ts->rack.rtt = rtt;
+    ts->rack.xmit_ts = xmit_ts;
+    ts->rack.end_seq = end_seq;
+  }
+  if( ! retrans && SEQ_LT(end_seq, prior_end_seq) &&
+      ! (ts->rack_flags & CI_TCP_RACK_FLAG_REORDER) ) {
+    ts->rack_flags |= CI_TCP_RACK_FLAG_REORDER;
+    CITP_STATS_NETIF_INC(ni, tcp_rack_reordering);
+  }
+}
+
+/* Reordering window in usticks, RFC8985 6.2 step 4.  It is zero, making
+ * RACK behave like the dupack threshold, until reordering has been seen.
+ */
+ci_inline ci_uint32 ci_tcp_rack_reo_wnd(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  ci_uint32 srtt;
+
+  if( ! (ts->rack_flags & CI_TCP_RACK_FLAG_REORDER) &&
+      ((ts->congstate != CI_TCP_CONG_OPEN &&
+        ts->congstate != CI_TCP_CONG_NOTIFIED) ||
+       ts->dup_acks >= ci_tcp_base_dupack_thresh(ts)) )
+    return 0;
+  srtt = tcp_srtt(ts) << (its->ci_ip_time_frc2tick - its->ci_ip_time_frc2us);
+  return CI_MIN(ts->rack_reo_wnd_mult * ts->rack.min_rtt / 4, srtt);
+}
+
+/* Time until RACK deems the unSACKed segment [pkt] lost, in usticks: zero
+ * if it is lost now, or -1 if nothing sent after it has been delivered.
+ */
+ci_inline ci_int32 ci_tcp_rack_remaining(ci_netif* ni, const ci_tcp_state* ts,
+                                         const ci_ip_pkt_fmt* pkt,
+                                         ci_uint32 reo_wnd, ci_uint32 now)
+{
+  ci_uint32 xmit_ts = ci_tcp_rack_xmit_ts(ni, pkt);
+  ci_int32 remaining;
+
+  if( ts->rack.rtt == 0 ||
+      ! ci_tcp_rack_sent_after(ts->rack.xmit_ts, ts->rack.end_seq,
+                               xmit_ts, pkt->pf.tcp_tx.end_seq) )
+    return -1;
+  remaining = xmit_ts + ts->rack.rtt + reo_wnd - now;
+  return CI_MAX(remaining, 0);
+}
+#endif
+
 /* congestion control functions */
 
+ci_inline int ci_tcp_cong_is_reno(ci_tcp_state* ts)
+{ return ts->c.cong_alg == EF_TCP_CONG_CONTROL_RENO; }
+
+/* Options to advertise on SYN.  DCTCP needs ECN whatever EF_TCP_SYN_OPTS
+ * says. */
+ci_inline ci_uint32 ci_tcp_syn_opts(ci_netif* ni, ci_tcp_socket_cmn* c)
+{
+  return NI_OPTS(ni).syn_opts |
+         (c->cong_alg == EF_TCP_CONG_CONTROL_DCTCP ? CI_TCPT_FLAG_ECN : 0);
+}
+
 /* set the initial congestion window as in rfc3390/rfc2581/rfc2001 */ 
 ci_inline void ci_tcp_set_initialcwnd(ci_netif* ni, ci_tcp_state* ts) {
   if( NI_OPTS(ni).initial_cwnd == 0 ) {
@@ -4381,6 +4615,8 @@ ci_inline void ci_tcp_set_initialcwnd(ci_netif* ni, ci_tcp_state* ts) {
    * processed the options, so this is OK. */
   ci_assert_le(ts->snd_wscl, CI_TCP_WSCL_MAX);
   ts->ssthresh = 65535 << ts->snd_wscl;
+  if( ! ci_tcp_cong_is_reno(ts) )
+    ci_tcp_cong_init(ni, ts);
 }
 
 /*! ?? \TODO should we use fackets to make things more exact ? */ 
@@ -4394,6 +4630,14 @@ ci_inline unsigned ci_tcp_losswnd(ci_tcp_state* ts) {
   return CI_MAX(x, y);
 }
 
+/* New value for [ssthresh] after loss, according to the congestion control
+ * algorithm of the socket. */
+ci_inline unsigned ci_tcp_cong_losswnd(ci_netif* ni, ci_tcp_state* ts) {
+  if(CI_LIKELY( ci_tcp_cong_is_reno(ts) ))
+    return ci_tcp_losswnd(ts);
+  return ci_tcp_cong_losswnd_slow(ni, ts);
+}
+
 
 #if CI_CFG_BURST_CONTROL
 ci_inline unsigned ci_tcp_burst_exhausted(ci_netif* ni, ci_tcp_state* ts) {
@@ -5274,6 +5518,17 @@ ci_inline void ci_tcp_recvmsg_args_init(ci_tcp_recvmsg_args* a,
 /*********************************************************************
 ***************************** Tcpdump support ************************
 *********************************************************************/
+#if CI_CFG_TCPDUMP || CI_CFG_UDP_REUSEPORT
+/* Run a classic BPF program over the [limit] bytes of the frame that start
+ * [base] bytes after the ethernet header.  Returns the program's result,
+ * or 0 if it is invalid or loads from beyond those bytes. */
+extern ci_uint32 oo_bpf_run(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                            const struct oo_bpf_insn* prog, unsigned n,
+                            ci_uint32 base, ci_uint32 limit) CI_HF;
+extern int oo_bpf_uses_ancillary(const struct oo_bpf_insn* prog,
+                                 unsigned n) CI_HF;
+#endif
+
 #if CI_CFG_TCPDUMP
 /** Current length of dump queue. */
 ci_inline ci_uint16 oo_tcpdump_queue_len(ci_netif* ni)
@@ -5281,11 +5536,18 @@ ci_inline ci_uint16 oo_tcpdump_queue_len(ci_netif* ni)
   return ni->state->dump_write_i - ni->state->dump_read_i;
 }
 
+/* Number of dump_queue entries in use, less one.  onload_tcpdump sets it
+ * in shared memory, so make sure it doesn't take us out of the array. */
+ci_inline ci_uint16 oo_tcpdump_queue_mask(ci_netif* ni)
+{
+  return ni->state->dump_queue_mask & (CI_CFG_DUMPQUEUE_LEN - 1);
+}
+
 /* Should we dump this packet? */
 ci_inline int oo_tcpdump_check(ci_netif *ni, ci_ip_pkt_fmt *pkt, int intf_i)
 {
   if( ni->state->dump_intf[intf_i] == OO_INTF_I_DUMP_ALL ) {
-    if( oo_tcpdump_queue_len(ni) < CI_CFG_DUMPQUEUE_LEN - 1 )
+    if( oo_tcpdump_queue_len(ni) < oo_tcpdump_queue_mask(ni) )
       return 1;
     else
       CITP_STATS_NETIF_INC(ni, tcpdump_missed);
@@ -5298,7 +5560,7 @@ ci_inline int oo_tcpdump_check_no_match(ci_netif *ni, ci_ip_pkt_fmt *pkt,
                                         int intf_i)
 {
   if( ni->state->dump_intf[intf_i] == OO_INTF_I_DUMP_NO_MATCH ) {
-    if( oo_tcpdump_queue_len(ni) < CI_CFG_DUMPQUEUE_LEN - 1 )
+    if( oo_tcpdump_queue_len(ni) < oo_tcpdump_queue_mask(ni) )
       return 1;
     else
       CITP_STATS_NETIF_INC(ni, tcpdump_missed);
@@ -5309,21 +5571,31 @@ ci_inline int oo_tcpdump_check_no_match(ci_netif *ni, ci_ip_pkt_fmt *pkt,
 /* Release all the packets up to dump_read_i */
 extern void oo_tcpdump_free_pkts(ci_netif* ni, ci_uint16 i);
 
+/* Run the capture filter over the whole frame.  Returns non-zero if the
+ * packet should be dumped. */
+extern ci_uint32 oo_tcpdump_filter(ci_netif* ni, ci_ip_pkt_fmt* pkt);
+
 /* Dump this packet */
 ci_inline void oo_tcpdump_dump_pkt(ci_netif *ni, ci_ip_pkt_fmt *pkt)
 {
   ci_uint16 write_i = ni->state->dump_write_i;
+  ci_uint16 mask = oo_tcpdump_queue_mask(ni);
   oo_pkt_p* dq = ni->state->dump_queue;
 
   if(CI_UNLIKELY( pkt->flags & CI_PKT_FLAG_MSG_WARM ))
     return;
 
-  if( dq[write_i % CI_CFG_DUMPQUEUE_LEN] != OO_PP_NULL )
+  /* Filter before taking a reference, so that packets nobody wants don't
+   * cost a cache miss in the dump queue. */
+  if( ni->state->dump_filter_len != 0 && ! oo_tcpdump_filter(ni, pkt) )
+    return;
+
+  if( dq[write_i & mask] != OO_PP_NULL )
     oo_tcpdump_free_pkts(ni, write_i);
 
-  ci_assert_equal(dq[write_i % CI_CFG_DUMPQUEUE_LEN], OO_PP_NULL);
+  ci_assert_equal(dq[write_i & mask], OO_PP_NULL);
   ci_netif_pkt_hold(ni, pkt);
-  dq[write_i % CI_CFG_DUMPQUEUE_LEN] = OO_PKT_P(pkt);
+  dq[write_i & mask] = OO_PKT_P(pkt);
   ci_wmb();
   ni->state->dump_write_i = write_i + 1;
 }
@@ -5333,6 +5605,157 @@ ci_inline void oo_tcpdump_dump_pkt(ci_netif *ni, ci_ip_pkt_fmt *pkt)
 #endif
 
 
+/*********************************************************************
+************************* Latency histograms *************************
+*********************************************************************/
+#if CI_CFG_LATENCY_HIST
+#define oo_lat_hist_enabled(ni)  (NI_OPTS(ni).latency_hist != 0)
+
+/* Index of the bucket that counts [v] */
+ci_inline unsigned oo_lat_hist_bucket(ci_uint32 v)
+{
+  unsigned msb;
+  if( v < (1u << OO_LAT_HIST_SUB_BITS) )
+    return v;
+  msb = 31 - __builtin_clz(v);
+  return ((msb - OO_LAT_HIST_SUB_BITS + 1) << OO_LAT_HIST_SUB_BITS) +
+         ((v >> (msb - OO_LAT_HIST_SUB_BITS)) &
+          ((1u << OO_LAT_HIST_SUB_BITS) - 1));
+}
+
+/* Smallest value counted by bucket [i] */
+ci_inline ci_uint64 oo_lat_hist_bucket_min(unsigned i)
+{
+  unsigned sub = i & ((1u << OO_LAT_HIST_SUB_BITS) - 1);
+  if( i < (1u << OO_LAT_HIST_SUB_BITS) )
+    return i;
+  return (ci_uint64) ((1u << OO_LAT_HIST_SUB_BITS) + sub) <<
+         ((i >> OO_LAT_HIST_SUB_BITS) - 1);
+}
+
+ci_inline void oo_lat_hist_add(struct oo_lat_hist* h, ci_uint64 v)
+{
+  ci_uint32 v32 = CI_MIN(v, (ci_uint64) 0xffffffffu);
+  ++h->bucket[oo_lat_hist_bucket(v32)];
+  ++h->count;
+  h->sum += v32;
+  if( v32 > h->max )
+    h->max = v32;
+}
+
+extern struct oo_lat_hist_sock*
+oo_lat_hist_sock(ci_netif* ni, oo_sp sock_id) CI_HF;
+extern void oo_lat_hist_sock_release(ci_netif* ni, oo_sp sock_id) CI_HF;
+extern void __oo_lat_hist_rx_to_app(ci_netif* ni, oo_sp sock_id,
+                                    ci_uint64 start) CI_HF;
+extern void __oo_lat_hist_send_to_wire(ci_netif* ni,
+                                       ci_ip_pkt_fmt* pkt) CI_HF;
+extern void __oo_lat_hist_lock_hold(ci_netif* ni) CI_HF;
+
+/* The application is being given data from [pkt] */
+ci_inline void oo_lat_hist_rx_to_app(ci_netif* ni, oo_sp sock_id,
+                                     ci_ip_pkt_fmt* pkt)
+{
+  if(CI_UNLIKELY( oo_lat_hist_enabled(ni) && pkt->tstamp_frc != 0 ))
+    __oo_lat_hist_rx_to_app(ni, sock_id, pkt->tstamp_frc);
+}
+
+/* The NIC has finished sending [pkt], which was stamped when it was put
+ * on the DMA queue */
+ci_inline void oo_lat_hist_send_to_wire(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  if(CI_UNLIKELY( oo_lat_hist_enabled(ni) ))
+    __oo_lat_hist_send_to_wire(ni, pkt);
+}
+#else
+#define oo_lat_hist_enabled(ni) 0
+#define oo_lat_hist_rx_to_app(ni, sock_id, pkt)
+#define oo_lat_hist_send_to_wire(ni, pkt)
+#endif
+
+
+/*********************************************************************
+*********************** Stack lock profiling *************************
+*********************************************************************/
+#if CI_CFG_LOCK_PROFILE
+#define oo_lock_prof_enabled(ni)  (NI_OPTS(ni).lock_profile != 0)
+
+extern void __oo_lock_prof_deferred(ci_netif* ni, ci_uint64 flags) CI_HF;
+
+/* Count the deferred work for lock [flags] done on unlock */
+ci_inline void oo_lock_prof_deferred(ci_netif* ni, ci_uint64 flags)
+{
+  if(CI_UNLIKELY( oo_lock_prof_enabled(ni) ))
+    __oo_lock_prof_deferred(ni, flags);
+}
+#else
+#define oo_lock_prof_enabled(ni) 0
+#define oo_lock_prof_deferred(ni, flags)
+#endif
+
+
+/*********************************************************************
+************************* Adaptive spinning **************************
+*********************************************************************/
+#if CI_CFG_SPIN_ADAPTIVE
+/* Index of the bucket that counts a wait of [cycles] */
+ci_inline unsigned oo_spin_adapt_bucket(ci_uint64 cycles)
+{
+  if( cycles < 2 )
+    return 0;
+  return CI_MIN(63u - __builtin_clzll(cycles), OO_SPIN_ADAPT_N_BUCKETS - 1);
+}
+
+/* oo_spin_adapt_budget()
+**
+** How long the thread whose waits are in [sa] should spin when it could
+** spin for [max_spin] cycles.
+*/
+ci_inline ci_uint64 oo_spin_adapt_budget(const struct oo_spin_adapt* sa,
+                                         ci_uint64 max_spin)
+{
+  if( sa->budget_bucket < 0 )
+    return 0;
+  if( sa->budget_bucket >= OO_SPIN_ADAPT_N_BUCKETS - 1 )
+    return max_spin;
+  return CI_MIN(max_spin, 2ull << sa->budget_bucket);
+}
+
+extern void oo_spin_adapt_add(struct oo_spin_adapt* sa, ci_uint64 wait,
+                              ci_uint64 max_spin, unsigned pct) CI_HF;
+#endif
+
+#if CI_CFG_SPIN_ADAPTIVE && ! defined(__KERNEL__)
+extern ci_uint64 __oo_spin_budget(ci_netif* ni, ci_uint64 max_spin) CI_HF;
+extern void __oo_spin_adapt_record(ci_netif* ni, ci_uint64 wait,
+                                   ci_uint64 max_spin) CI_HF;
+
+/* How long a blocking receive that may spin for up to [max_spin] cycles
+ * should spin for */
+ci_inline ci_uint64 oo_spin_budget(ci_netif* ni, ci_uint64 max_spin)
+{
+  if(CI_LIKELY( NI_OPTS(ni).spin_adaptive == 0 ))
+    return max_spin;
+  return __oo_spin_budget(ni, max_spin);
+}
+
+/* A blocking receive that started waiting at [start_frc], and whose spin
+ * was sized by oo_spin_budget(), has something to return */
+ci_inline void oo_spin_adapt_record(ci_netif* ni, ci_uint64 start_frc,
+                                    ci_uint64 max_spin)
+{
+  ci_uint64 now;
+  if(CI_UNLIKELY( NI_OPTS(ni).spin_adaptive != 0 )) {
+    ci_frc64(&now);
+    __oo_spin_adapt_record(ni, now - start_frc, max_spin);
+  }
+}
+#else
+#define oo_spin_budget(ni, max_spin)  (max_spin)
+#define oo_spin_adapt_record(ni, start_frc, max_spin)
+#endif
+
+
 #ifdef __KERNEL__
 /*********************************************************************
 **************************** OS socket status ************************
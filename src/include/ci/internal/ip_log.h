@@ -204,7 +204,7 @@
  */
 
 #define CI_TCP_SOCKET_FLAGS_FMT                                        \
-  "%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s"
+  "%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s"
 #define CI_TCP_SOCKET_FLAGS_PRI_ARG(ts)                                \
   ((ts)->tcpflags & CI_TCPT_FLAG_TSO    ? "TSO " :""),                 \
   ((ts)->tcpflags & CI_TCPT_FLAG_WSCL   ? "WSCL ":""),                 \
@@ -226,7 +226,15 @@
   ((ts)->tcpflags & CI_TCPT_FLAG_LOOP_FAKE        ? "LOOP_FAKE ":""),   \
   ((ts)->tcpflags & CI_TCPT_FLAG_TAIL_DROP_TIMING ? "TLP_TIMER ":""),   \
   ((ts)->tcpflags & CI_TCPT_FLAG_TAIL_DROP_MARKED ? "TLP_SENT ":""),    \
-  ((ts)->tcpflags & CI_TCPT_FLAG_FIN_PENDING      ? "FIN_PENDING ":"")
+  ((ts)->tcpflags & CI_TCPT_FLAG_RACK_REO_TIMING  ? "RACK_TIMER ":""),  \
+  ((ts)->tcpflags & CI_TCPT_FLAG_FIN_PENDING      ? "FIN_PENDING ":""), \
+  ((ts)->tcpflags & CI_TCPT_FLAG_ECN_ECE          ? "ECE ":""),         \
+  ((ts)->tcpflags & CI_TCPT_FLAG_ECN_CWR          ? "CWR ":""),         \
+  ((ts)->tcpflags & CI_TCPT_FLAG_ECN_CWR_STATE    ? "ECN_CWR_STATE ":""), \
+  ((ts)->tcpflags & CI_TCPT_FLAG_FASTOPEN         ? "TFO ":""),         \
+  ((ts)->tcpflags & CI_TCPT_FLAG_FASTOPEN_DEFER   ? "TFO_DEFER ":""),   \
+  ((ts)->tcpflags & CI_TCPT_FLAG_FASTOPEN_DATA    ? "TFO_DATA ":""),    \
+  ((ts)->tcpflags & CI_TCPT_FLAG_FASTOPEN_SYNACK  ? "TFO_SYNACK ":"")
 
 
 #define CI_SOCK_FLAGS_FMT \
@@ -327,7 +335,7 @@
  * UDP
  */
 
-#define CI_UDP_STATE_FLAGS_FMT		"%s%s%s%s%s%s%s%s%s%s%s%s%s%s"
+#define CI_UDP_STATE_FLAGS_FMT		"%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s"
 #define CI_UDP_STATE_FLAGS_PRI_ARG(ts)				\
   (UDP_FLAGS(ts) & CI_UDPF_FILTERED     ? "FILT ":""),          \
   (UDP_FLAGS(ts) & CI_UDPF_MCAST_LOOP   ? "MCAST_LOOP ":""),    \
@@ -342,7 +350,8 @@
   (UDP_FLAGS(ts) & CI_UDPF_MCAST_JOIN   ? "MC ":""),            \
   (UDP_FLAGS(ts) & CI_UDPF_MCAST_FILTER ? "MC_FILT ":""),       \
   (UDP_FLAGS(ts) & CI_UDPF_NO_UCAST_FILTER ? "NO_UC_FILT ":""), \
-  (UDP_FLAGS(ts) & CI_UDPF_LAST_SEND_NOMAC ? "LAST_SEND_NOMAC":"")
+  (UDP_FLAGS(ts) & CI_UDPF_LAST_SEND_NOMAC ? "LAST_SEND_NOMAC ":""), \
+  (UDP_FLAGS(ts) & CI_UDPF_GRO          ? "GRO":"")
 
 
 extern unsigned ci_tp_log CI_HV;
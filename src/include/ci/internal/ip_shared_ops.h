@@ -50,19 +50,82 @@ ci_netif_unlock_slow_common(ci_netif*, ci_uint64 lock_val,
                             ci_uint64 flags_to_handle) CI_HF;
 
 
+#if CI_CFG_LOCK_PROFILE
+extern void __oo_lock_prof_acquired(ci_netif* ni, const char* func,
+                                    int line, ci_uint64 wait_frc) CI_HF;
+extern void __oo_lock_prof_released(ci_netif* ni) CI_HF;
+#endif
+
+#if CI_CFG_LATENCY_HIST || CI_CFG_LOCK_PROFILE
+/* With EF_LATENCY_HIST, note when the lock is taken so that
+ * ci_netif_unlock() can record how long it was held.  With
+ * EF_LOCK_PROFILE, also note who took it, and how long they waited if
+ * [wait_frc] is when they started to.  NI_OPTS() isn't available here, so
+ * this looks at the copy of the options in the stack.
+ */
+ci_inline void ci_netif_lock_stamp(ci_netif* ni, const char* func, int line,
+                                   ci_uint64 wait_frc)
+{
+#if CI_CFG_LATENCY_HIST
+  if(CI_UNLIKELY( ni->state->opts.latency_hist ))
+    ci_frc64(&ni->state->lock_frc);
+#endif
+#if CI_CFG_LOCK_PROFILE
+  if(CI_UNLIKELY( ni->state->opts.lock_profile ))
+    __oo_lock_prof_acquired(ni, func, line, wait_frc);
+#endif
+}
+
+ci_inline int __ci_netif_lock(ci_netif* ni, const char* func, int line)
+  OO_MUST_CHECK_RET_IN_KERNEL;
+ci_inline int __ci_netif_lock(ci_netif* ni, const char* func, int line)
+{
+  ci_uint64 wait_frc = 0;
+  int rc;
+#if CI_CFG_LOCK_PROFILE
+  /* Time only the acquisitions that find the lock taken. */
+  if(CI_UNLIKELY( ni->state->opts.lock_profile )) {
+    if( ef_eplock_trylock(&ni->state->lock) ) {
+      ci_netif_lock_stamp(ni, func, line, 0);
+      return 0;
+    }
+    ci_frc64(&wait_frc);
+  }
+#endif
+  rc = ef_eplock_lock(ni);
+  if( rc == 0 )
+    ci_netif_lock_stamp(ni, func, line, wait_frc);
+  return rc;
+}
+
+ci_inline int __ci_netif_trylock(ci_netif* ni, const char* func, int line)
+{
+  int rc = ef_eplock_trylock(&ni->state->lock);
+  if( rc )
+    ci_netif_lock_stamp(ni, func, line, 0);
+  return rc;
+}
+#else
+# define __ci_netif_lock(ni, func, line)     ef_eplock_lock(ni)
+# define __ci_netif_trylock(ni, func, line)  \
+  ef_eplock_trylock(&(ni)->state->lock)
+#endif
+
 /*! Blocking calls that grab the stack lock return 0 on success.  When
  * called at userlevel, this is the only possible outcome.  In the kernel,
  * they return -EINTR if interrupted by a signal.
+ *
+ * The caller's function and line identify it to EF_LOCK_PROFILE.
  */
 #if ! defined(__KERNEL__) || ! CI_CFG_UL_INTERRUPT_HELPER
-#define ci_netif_lock(ni)        ef_eplock_lock(ni)
+#define ci_netif_lock(ni)        __ci_netif_lock((ni), __func__, __LINE__)
 #endif
 
 #ifdef __KERNEL__
 #define ci_netif_lock_maybe_wedged(ni) ef_eplock_lock_maybe_wedged(ni)
 #endif
-#define ci_netif_lock_id(ni,id)  ef_eplock_lock(ni)
-#define ci_netif_trylock(ni)     ef_eplock_trylock(&(ni)->state->lock)
+#define ci_netif_lock_id(ni,id)  __ci_netif_lock((ni), __func__, __LINE__)
+#define ci_netif_trylock(ni)     __ci_netif_trylock((ni), __func__, __LINE__)
 
 #define ci_netif_lock_fdi(epi)   ci_netif_lock_id((epi)->sock.netif,    \
                                                   SC_SP((epi)->sock.s))
@@ -74,9 +137,10 @@ ci_netif_unlock_slow_common(ci_netif*, ci_uint64 lock_val,
 ** member on contention.
 */
 #if CI_CFG_STATS_NETIF
-ci_inline int __ci_netif_lock_count(ci_netif* ni, ci_uint32* stat) {
-  if( ! ci_netif_trylock(ni) ) {
-    int rc = ci_netif_lock(ni);
+ci_inline int __ci_netif_lock_count(ci_netif* ni, ci_uint32* stat,
+                                    const char* func, int line) {
+  if( ! __ci_netif_trylock(ni, func, line) ) {
+    int rc = __ci_netif_lock(ni, func, line);
     if( rc )  return rc;
     ++*stat;
   }
@@ -84,7 +148,8 @@ ci_inline int __ci_netif_lock_count(ci_netif* ni, ci_uint32* stat) {
 }
 
 # define ci_netif_lock_count(ni, stat_name)                     \
-  __ci_netif_lock_count((ni), &(ni)->state->stats.stat_name)
+  __ci_netif_lock_count((ni), &(ni)->state->stats.stat_name,    \
+                        __func__, __LINE__)
 #else
 # define ci_netif_lock_count(ni, stat)  ci_netif_lock(ni)
 #endif
@@ -85,13 +85,19 @@
 
 /* Timer wheels are used to schedule the timers. There are 4 level's on
 ** the wheel each of 256 buckets each bucket is a doubly linked list
-** of timers
+** of timers.  Wheel 0 has twice as many buckets: it holds the next
+** rotation as well as the current one, so that the next rotation can be
+** cascaded out of wheel 1 a little at a time.
 */
 #define CI_IPTIME_WHEELS      4
 #define CI_IPTIME_BUCKETS     256
 #define CI_IPTIME_BUCKETMASK  255
 #define CI_IPTIME_BUCKETBITS  8
-#define CI_IPTIME_WHEELSIZE   (CI_IPTIME_WHEELS*CI_IPTIME_BUCKETS)
+#define CI_IPTIME_WHEEL0_BUCKETS (2*CI_IPTIME_BUCKETS)
+#define CI_IPTIME_WHEELSIZE   (CI_IPTIME_WHEELS*CI_IPTIME_BUCKETS + \
+                               CI_IPTIME_BUCKETS)
+/* Fewest timers to cascade per poll while cascading the next rotation */
+#define CI_IPTIME_CASCADE_BATCH  64
 
 
 /* ========= Field Protection ======== */
@@ -413,7 +419,7 @@ struct ci_ip_pkt_fmt_s {
   ci_int8               n_buffers;
 
   /*! Time packet was sent or received.  Used for software timestamps
-   * (SO_TIMESTAMP, SIOCGSTAMP etc.) and onload_tcpdump.
+   * (SO_TIMESTAMP, SIOCGSTAMP etc.), onload_tcpdump and TCP RACK.
    */
   ci_uint64             tstamp_frc CI_ALIGN(8);
 
@@ -816,7 +822,12 @@ typedef struct {
   struct oo_p_dllink warray[CI_IPTIME_WHEELSIZE];  
 
   /* bitmask of non-empty buckets in the lowest weel */
-  ci_uint64 busy_mask[4] CI_ALIGN(8);
+  ci_uint64 busy_mask[CI_IPTIME_WHEEL0_BUCKETS / 64] CI_ALIGN(8);
+  /* timers added to each wheel1 bucket since it was last cascaded; an upper
+   * bound on its length, as cancelled timers are not subtracted */
+  ci_uint32 cascade_count[CI_IPTIME_BUCKETS];
+  /* upper bound on timers still to cascade into the next rotation */
+  ci_uint32 cascade_left;
 } ci_ip_timer_state;
 
 
@@ -844,6 +855,8 @@ typedef struct {
 # define CI_IP_TIMER_NETIF_STATS        0xa  /* netif statistics timer   */
 # define CI_IP_TIMER_TCP_CORK           0xb  /* TCP_CORK timer           */
 # define CI_IP_TIMER_NETIF_TCP_RECYCLE  0xc  /* EF100 plugin recycling   */
+# define CI_IP_TIMER_TCP_PACE           0xd  /* TCP pacing callback      */
+  ci_uint16                   defer;         /* lazy extension of [time] */
 } ci_ip_timer;
 
 
@@ -878,6 +891,7 @@ typedef struct {
                                          containing page allocation, e.g. if
                                          packet buffers are 2K and pages are
                                          2MB then 10. */
+  CI_ULCONST ci_int16   numa_node; /**< Node the set's memory is on */
 } oo_pktbuf_set;
 
 typedef struct {
@@ -1109,6 +1123,120 @@ typedef struct {
 } ci_netif_state_nic_t;
 
 
+#if CI_CFG_TCPDUMP || CI_CFG_UDP_REUSEPORT
+/* A classic BPF instruction, as in struct sock_filter */
+struct oo_bpf_insn {
+  ci_uint16 code;
+  ci_uint8  jt;
+  ci_uint8  jf;
+  ci_uint32 k;
+};
+#endif
+
+
+#if CI_CFG_LATENCY_HIST
+/* Log-linear histogram of intervals in CPU cycles.  Values below 8 have a
+ * bucket each, and every power of two above that is split into 8 buckets,
+ * so a bucket's width is at most 1/8 of its lower bound.  Values are
+ * clamped to 32 bits.  See oo_lat_hist_bucket().
+ */
+#define OO_LAT_HIST_SUB_BITS   3
+#define OO_LAT_HIST_N_BUCKETS  ((32 - OO_LAT_HIST_SUB_BITS + 1) << \
+                                OO_LAT_HIST_SUB_BITS)
+
+struct oo_lat_hist {
+  ci_uint64 count;
+  ci_uint64 sum;
+  ci_uint32 max;
+  ci_uint32 bucket[OO_LAT_HIST_N_BUCKETS];
+};
+
+struct oo_lat_hist_sock {
+  /* Socket these belong to, or OO_SP_NULL if the slot is free */
+  oo_sp              sock_id;
+  struct oo_lat_hist rx_to_app;
+  struct oo_lat_hist send_to_wire;
+};
+#endif
+
+
+#if CI_CFG_LOCK_PROFILE
+/* Statistics for one place that takes the stack lock.  Times are in CPU
+ * cycles. */
+struct oo_lock_prof_site {
+  ci_uint32 line;              /* 0 if the slot is free */
+  char      func[28];          /* NUL-terminated, maybe truncated */
+  ci_uint64 n_locks;
+  ci_uint64 n_waits;           /* acquisitions that found it locked */
+  ci_uint64 wait_cycles;
+  ci_uint64 n_holds;           /* releases that could be timed */
+  ci_uint64 hold_cycles;
+  ci_uint32 wait_max;
+  ci_uint32 hold_max;
+};
+
+/* Number of lock flag bits counted by oo_lock_prof.deferred */
+#define OO_LOCK_PROF_N_FLAGS  64
+
+struct oo_lock_prof {
+  ci_uint64 hold_frc;          /* when the current holder took the lock */
+  ci_int32  holder;            /* index of its site, or -1 */
+  ci_uint32 n_untracked;       /* acquisitions from sites not in site[] */
+  /* Work done by ci_netif_unlock_slow_common(), indexed by lock flag bit.
+   * The deferred socket list, CI_EPLOCK_NETIF_SOCKET_LIST, is counted at
+   * bit 0. */
+  ci_uint64 deferred[OO_LOCK_PROF_N_FLAGS];
+  struct oo_lock_prof_site site[CI_CFG_LOCK_PROFILE_SITES];
+};
+#endif
+
+
+#if CI_CFG_SPIN_ADAPTIVE
+/* How long one thread's blocking receives have waited for data, for
+ * EF_SPIN_ADAPTIVE.  Waits are in CPU cycles, and the histogram has a
+ * bucket for each power of two.  See oo_spin_adapt_budget().
+ */
+#define OO_SPIN_ADAPT_N_BUCKETS  32
+/* The recent counts are halved after this many waits */
+#define OO_SPIN_ADAPT_DECAY      256
+
+struct oo_spin_adapt {
+  ci_int32  tid;               /* thread using this slot, or 0 if free */
+  /* Spin for up to 2 << budget_bucket cycles.  -1 means don't spin and
+   * OO_SPIN_ADAPT_N_BUCKETS - 1 means spin for the full limit. */
+  ci_int32  budget_bucket;
+  ci_uint64 last_frc;          /* when the thread last waited */
+  ci_uint64 n_waits;
+  ci_uint64 n_spun;            /* waits that ended while spinning */
+  ci_uint64 n_long;            /* waits too long for the full spin */
+  ci_uint64 spin_cycles;       /* spent spinning */
+  ci_uint64 full_spin_cycles;  /* that would have been without this */
+  ci_uint16 recent;            /* waits since the counts were halved */
+  ci_uint16 recent_long;
+  ci_uint16 hist[OO_SPIN_ADAPT_N_BUCKETS];  /* recent waits short enough */
+};
+#endif
+
+
+#if CI_CFG_UDP_REUSEPORT
+/* Unconnected SO_REUSEPORT UDP sockets in one stack bound to the same
+ * address and port.  Datagrams matching any of them are steered by
+ * ci_udp_reuseport_select().  A group is free if n_members is 0.
+ */
+struct oo_udp_reuseport_group {
+  ci_addr_t          laddr;
+  ci_uint16          lport_be16;
+  ci_uint16          n_members;
+  /* SO_ATTACH_REUSEPORT_CBPF program returning an index into members[],
+   * or none if prog_len is 0. */
+  ci_uint16          prog_len;
+  ci_uint16          pad;
+  oo_sp              members[CI_CFG_UDP_REUSEPORT_GROUP_SIZE];
+  struct oo_bpf_insn prog[CI_CFG_UDP_REUSEPORT_PROG_MAX];
+};
+#endif
+
+
 struct ci_netif_state_s {
 
   ci_netif_state_nic_t  nic[CI_CFG_MAX_INTERFACES];
@@ -1419,6 +1547,17 @@ struct ci_netif_state_s {
 
   CI_ULCONST ci_uint8   hash_salt[16];
 
+#if CI_CFG_TCP_FASTOPEN
+  /* TCP Fast Open cookies from the servers we have connected to,
+   * direct-mapped by server address.  Updated under the stack lock. */
+#define CI_TCP_FASTOPEN_CACHE_SIZE  64
+  struct {
+    ci_addr_t           addr;
+    ci_uint8            len;      /* 0 if unused */
+    ci_uint8            cookie[CI_TCP_FASTOPEN_COOKIE_MAX];
+  } fastopen_cache[CI_TCP_FASTOPEN_CACHE_SIZE];
+#endif
+
 #if CI_CFG_STATS_NETIF
   ci_netif_stats        stats;
 #endif
@@ -1434,12 +1573,46 @@ struct ci_netif_state_s {
   ci_uint8              dump_intf[OO_INTF_I_NUM];
   volatile ci_uint16    dump_read_i;
   volatile ci_uint16    dump_write_i;
+  /* These are set by onload_tcpdump when it attaches.  The stack uses the
+   * first dump_queue_mask + 1 entries of dump_queue, and doesn't queue
+   * packets the filter rejects.  No filter if dump_filter_len is 0. */
+  ci_uint16             dump_queue_mask;
+  ci_uint16             dump_filter_len;
+  struct oo_bpf_insn    dump_filter[CI_CFG_DUMP_FILTER_MAX];
+#endif
+
+#if CI_CFG_LATENCY_HIST
+  /* Maintained only when EF_LATENCY_HIST is set.  Updates are not atomic
+   * and some are made without the stack lock, so concurrent updates can
+   * occasionally be lost. */
+  ci_uint64             lock_frc;        /* when the stack lock was taken */
+  struct oo_lat_hist    lat_rx_to_app CI_ALIGN(8);
+  struct oo_lat_hist    lat_send_to_wire;
+  struct oo_lat_hist    lat_lock_hold;
+  struct oo_lat_hist_sock lat_sock[CI_CFG_LATENCY_HIST_SOCKETS];
+#endif
+
+#if CI_CFG_LOCK_PROFILE
+  /* Maintained only when EF_LOCK_PROFILE is set, with the stack lock
+   * held. */
+  struct oo_lock_prof   lock_prof CI_ALIGN(8);
+#endif
+
+#if CI_CFG_SPIN_ADAPTIVE
+  /* Maintained only when EF_SPIN_ADAPTIVE is set, each by its own
+   * thread. */
+  struct oo_spin_adapt  spin_adapt[CI_CFG_SPIN_ADAPTIVE_THREADS] CI_ALIGN(8);
+#endif
+
+#if CI_CFG_UDP_REUSEPORT
+  struct oo_udp_reuseport_group udp_reuseport[CI_CFG_UDP_REUSEPORT_GROUPS];
 #endif
 
   ef_vi_stats           vi_stats CI_ALIGN(8);
 
   CI_ULCONST ci_int32   creation_numa_node;
   CI_ULCONST ci_int32   load_numa_node;
+  CI_ULCONST ci_int32   alloc_numa_node; /**< EF_NUMA_NODE's choice, or -1 */
   CI_ULCONST ci_uint32  packet_alloc_numa_nodes;
   CI_ULCONST ci_uint32  sock_alloc_numa_nodes;
   CI_ULCONST ci_uint32  interrupt_numa_nodes;
@@ -2204,6 +2377,9 @@ typedef struct {
   ci_uint32 n_rx_overflow;    /* datagrams dropped due to overflow     */
   ci_uint32 n_rx_mem_drop;    /* datagrams dropped due to out-of-mem   */
   ci_uint32 n_rx_pktinfo;     /* n times IP/IPV6_PKTINFO retrieved     */
+  ci_uint32 n_rx_gro;         /* receives that coalesced (UDP_GRO)     */
+  ci_uint32 n_rx_gro_segs;    /* datagrams merged into those receives  */
+  ci_uint32 n_rx_reuseport;   /* datagrams steered here by its group   */
   ci_uint32 max_recvq_pkts;   /* maximum packets queued for recv       */
 
   ci_uint32 n_tx_os;          /* datagrams send via OS socket          */
@@ -2225,6 +2401,8 @@ typedef struct {
   ci_uint32 n_tx_block;       /* send queue was full, did block        */
   ci_uint32 n_tx_poll_avoids_full; /* polling made space in sendq      */
   ci_uint32 n_tx_fragments;   /* number of (non-first) fragments       */
+  ci_uint32 n_tx_gso;         /* sends split by UDP_SEGMENT            */
+  ci_uint32 n_tx_gso_segs;    /* datagrams sent by those sends         */
   ci_uint32 n_tx_msg_confirm; /* onload send with MSG_CONFIRM          */
   ci_uint32 n_tx_os_late;     /* sent via OS, after copying            */
   ci_uint32 n_tx_unconnect_late; /* concurrent send and unconnect      */
@@ -2253,9 +2431,18 @@ struct  ci_udp_state_s {
 #define CI_UDPF_MCAST_FILTER    0x00010000  /*!< mcast filter added */
 #define CI_UDPF_NO_UCAST_FILTER 0x00020000  /*!< don't add unicast filters */
 #define CI_UDPF_LAST_SEND_NOMAC 0x00040000  /*!< last send was via nomac path */
+#define CI_UDPF_GRO             0x00080000  /*!< UDP_GRO                 */
 
   ci_uint32 future_intf_i; /* Interface to check for incoming future packets */
 
+  /*! UDP_SEGMENT: payload bytes per datagram when splitting sends, or 0 */
+  ci_uint32 gso_size;
+
+#if CI_CFG_UDP_REUSEPORT
+  /*! Index of the in-stack SO_REUSEPORT group this socket is in, or -1 */
+  ci_int32 reuseport_group;
+#endif
+
 #if CI_CFG_ZC_RECV_FILTER
   /* Only safe to use these at user-level in context of caller who set them */
   ci_uint64     recv_q_filter CI_ALIGN(8);
@@ -2514,6 +2701,14 @@ typedef struct {
   ci_uint16            user_mss;            /* user-provided maximum MSS */
   ci_uint8             tcp_defer_accept;    /* TCP_DEFER_ACCEPT sockopt  */
 #define OO_TCP_DEFER_ACCEPT_OFF 0xff
+  ci_uint8             cong_alg;            /* EF_TCP_CONG_CONTROL_* */
+#if CI_CFG_TCP_FASTOPEN
+  ci_uint16            fastopen_qlen;       /* TCP_FASTOPEN sockopt */
+#endif
+#if CI_CFG_TCP_PACING
+  ci_uint64            max_pacing_rate;     /* SO_MAX_PACING_RATE, bytes/s */
+#define CI_TCP_PACING_RATE_UNLIMITED (~0ull)
+#endif
 
 } ci_tcp_socket_cmn;
 
@@ -2527,6 +2722,9 @@ struct oo_tcp_socket_stats {
   ci_uint32  tx_stop_app;     /* TX stopped because TXQ empty      */
 #if CI_CFG_BURST_CONTROL
   ci_uint32  tx_stop_burst;   /* TX stopped by burst control       */
+#endif
+#if CI_CFG_TCP_PACING
+  ci_uint32  tx_stop_pace;    /* TX stopped by pacing              */
 #endif
   ci_uint32  tx_nomac_defer;  /* Deferred send waiting for ARP     */
   ci_uint32  tx_defer;        /* Deferred send to avoid lock contention */
@@ -2608,6 +2806,34 @@ struct ci_tcp_state_s {
    * because packet allocation failed.  Must send FIN, really. */
 #define CI_TCPT_FLAG_FIN_PENDING        0x800000
 
+  /* ECN state, valid iff CI_TCPT_FLAG_ECN has been negotiated.
+   * ECE: set ECE on outgoing segments.  With RFC3168 this is from the
+   * receipt of CE until the peer sends CWR; with DCTCP it is the CE mark
+   * of the last segment received.
+   * CWR: the window has been reduced, set CWR on the next new data.
+   * CWR_STATE: the window has been reduced, and we do not react to ECE
+   * again until [ecn_recover] is acked. */
+#define CI_TCPT_FLAG_ECN_ECE            0x1000000
+#define CI_TCPT_FLAG_ECN_CWR            0x2000000
+#define CI_TCPT_FLAG_ECN_CWR_STATE      0x4000000
+
+  /* TCP Fast Open, RFC7413.
+   * FASTOPEN: TCP_FASTOPEN_CONNECT or MSG_FASTOPEN; the SYN carries a
+   * cookie option.  In ci_tcp_state_synrecv it means the peer asked for
+   * a cookie.
+   * FASTOPEN_DEFER: the SYN is in the sendq, held back until the first
+   * send so that it can carry data.
+   * FASTOPEN_DATA: the SYN carried data.
+   * FASTOPEN_SYNACK: passively opened with the data in the SYN accepted;
+   * the SYN-ACK has not been acked yet. */
+#define CI_TCPT_FLAG_FASTOPEN           0x40000
+#define CI_TCPT_FLAG_FASTOPEN_DEFER     0x8000000
+#define CI_TCPT_FLAG_FASTOPEN_DATA      0x10000000
+#define CI_TCPT_FLAG_FASTOPEN_SYNACK    0x20000000
+
+  /* The RTO timer is running as the RACK reordering timer, RFC8985 6.3. */
+#define CI_TCPT_FLAG_RACK_REO_TIMING    0x40000000
+
   /* flags advertised on SYN */
 # define CI_TCPT_SYN_FLAGS \
         (CI_TCPT_FLAG_WSCL | CI_TCPT_FLAG_TSO | CI_TCPT_FLAG_SACK)
@@ -2723,6 +2949,11 @@ struct ci_tcp_state_s {
                                         can burst to before receiving
                                         any packets from other side,
                                         or zero if unlimited */
+#endif
+#if CI_CFG_TCP_PACING
+  ci_int32             pace_credit; /* bytes we may send at pace_stamp */
+  ci_uint32            pace_stamp;  /* when pace_credit was last topped
+                                       up, in usticks                     */
 #endif
   ci_uint32            rcv_up;      /* receive urgent pointer, holds the
                                        seq num of the OOB byte            */
@@ -2742,11 +2973,24 @@ struct ci_tcp_state_s {
 
   ci_uint8             incoming_tcp_hdr_len; /* expected TCP header length */
 
+#if CI_CFG_TCP_RACK
+  ci_uint8             rack_reo_wnd_mult; /* reordering window in quarters
+                                           * of rack.min_rtt              */
+  ci_uint8             rack_reo_wnd_persist; /* recoveries until
+                                              * reo_wnd_mult is reset     */
+  ci_uint8             rack_flags;
+# define CI_TCP_RACK_FLAG_REORDER  0x1 /* reordering has been seen       */
+# define CI_TCP_RACK_FLAG_DSACK    0x2 /* reo_wnd_mult has been raised in
+                                        * this recovery episode          */
+#endif
+
 #if CI_CFG_TCP_OFFLOAD_RECYCLER
   ci_uint16            plugin_stream_id;
 #endif
 
   ci_uint32            congrecover; /* snd_nxt when loss detected         */
+  ci_uint32            ecn_recover; /* snd_nxt when window reduced on ECE,
+                                     * see CI_TCPT_FLAG_ECN_CWR_STATE     */
   oo_pkt_p             retrans_ptr; /* next packet to retransmit          */
   ci_uint32            retrans_seq; /* seq of next packet to retransmit   */
 
@@ -2754,6 +2998,42 @@ struct ci_tcp_state_s {
   ci_uint32            cwnd_extra;  /* adjustments when congested         */
   ci_uint32            ssthresh;    /* slow-start threshold               */
   ci_uint32            bytes_acked; /* bytes acked but not yet added to cwnd */
+
+  /* State private to the congestion control algorithm, see tcp_cong.c.
+   * Unused by reno. */
+  union {
+    struct {
+      ci_uint32        epoch_start; /* start of growth epoch, or 0       */
+      ci_uint32        w_max;       /* cwnd before the last reduction    */
+      ci_uint32        origin;      /* plateau of the cubic function     */
+      ci_uint32        k;           /* time to reach origin, in ms       */
+      ci_uint32        w_est;       /* TCP-friendly (reno) estimate      */
+    } cubic;
+    struct {
+      ci_uint32        bw[2];       /* max delivery rate, this and last
+                                     * window of rounds                 */
+      ci_uint32        min_rtt;     /* min round time                    */
+      ci_uint32        min_rtt_stamp;
+      ci_uint32        round_start; /* time the current round started    */
+      ci_uint32        round_seq;   /* snd_una when the round started    */
+      ci_uint32        round_end;   /* snd_nxt when the round started    */
+      ci_uint32        full_bw;     /* bw at the last growth in STARTUP  */
+      ci_uint32        prior_cwnd;  /* cwnd to restore after loss/PROBE_RTT */
+      ci_uint32        mode_stamp;  /* start of gain cycle phase or
+                                     * PROBE_RTT hold deadline          */
+      ci_uint8         mode;
+      ci_uint8         cycle_idx;
+      ci_uint8         full_bw_cnt;
+      ci_uint8         bw_rounds;
+      ci_uint8         flags;
+    } bbr;
+    struct {
+      ci_uint32        alpha;       /* fraction of CE-marked bytes << 10 */
+      ci_uint32        acked;       /* bytes acked in this window        */
+      ci_uint32        ce_acked;    /* ...of which acked with ECE        */
+      ci_uint32        next_seq;    /* snd_nxt when the window started   */
+    } dctcp;
+  } cong;
   
 #if CI_CFG_TCP_FASTSTART  
   ci_uint32            faststart_acks; /* Bytes to ack before leaving faststart */
@@ -2765,6 +3045,19 @@ struct ci_tcp_state_s {
   ci_uint32            taildrop_mark;
 #endif
 
+#if CI_CFG_TCP_RACK
+  /* RACK loss detection, RFC8985.  [xmit_ts] and [end_seq] identify the
+   * most recently sent segment that has been delivered, and [rtt] is the
+   * round trip measured on it.  Times are in usticks; [min_rtt] is zero
+   * until the first segment is delivered. */
+  struct {
+    ci_uint32          xmit_ts;
+    ci_uint32          end_seq;
+    ci_uint32          rtt;
+    ci_uint32          min_rtt;
+  } rack;
+#endif
+
   /* Keep alive probes, and sending ACKs after gaps that may cause
    * other end to validated its congetion window 
    */
@@ -2852,6 +3145,9 @@ struct ci_tcp_state_s {
   ci_ip_timer          stats_tid;   /* Statistics report timer            */
 #endif
   ci_ip_timer          cork_tid;    /* TCP timer for TCP_CORK/MSG_MORE   */
+#if CI_CFG_TCP_PACING
+  ci_ip_timer          pace_tid;    /* TCP timer to release paced data   */
+#endif
 
 #if CI_CFG_TCP_OFFLOAD_RECYCLER
   /* Technically a timer, but it always has a single-tick expiry so we save
@@ -281,6 +281,20 @@ ci_ip_stats_update(ci_ip_stats *dest_stats, ci_ip_stats *src_stats) {
       __CI_TCP_COUNT_STATS_INC( (netif), tcp_retran_segs)
 #define CI_TCP_STATS_INC_OUT_RSTS( netif ) \
       __CI_TCP_COUNT_STATS_INC( (netif), tcp_out_rsts)
+#define CI_TCP_STATS_INC_ECN_ESTAB( netif ) \
+      __CI_TCP_COUNT_STATS_INC( (netif), tcp_ecn_estab)
+#define CI_TCP_STATS_INC_ECN_CE_RCVD( netif ) \
+      __CI_TCP_COUNT_STATS_INC( (netif), tcp_ecn_ce_rcvd)
+#define CI_TCP_STATS_INC_ECN_ECE_RCVD( netif ) \
+      __CI_TCP_COUNT_STATS_INC( (netif), tcp_ecn_ece_rcvd)
+#define CI_TCP_STATS_INC_ECN_CWND_REDUCED( netif ) \
+      __CI_TCP_COUNT_STATS_INC( (netif), tcp_ecn_cwnd_reduced)
+#define CI_TCP_STATS_INC_FASTOPEN_COOKIE_ISSUED( netif ) \
+      __CI_TCP_COUNT_STATS_INC( (netif), tcp_fastopen_cookie_issued)
+#define CI_TCP_STATS_INC_FASTOPEN_ACCEPTED( netif ) \
+      __CI_TCP_COUNT_STATS_INC( (netif), tcp_fastopen_accepted)
+#define CI_TCP_STATS_INC_FASTOPEN_REJECTED( netif ) \
+      __CI_TCP_COUNT_STATS_INC( (netif), tcp_fastopen_rejected)
 
 
 /* macros to update udp statistics */
@@ -24,12 +24,17 @@
 #define IPTIMER_BUCKETNO(wheelno, abs)                          \
         (((abs) >> ((wheelno)*CI_IPTIME_BUCKETBITS)) & CI_IPTIME_BUCKETMASK)
 
+/* gives the index into warray for a given wheelno and abs; wheel0 comes
+ * first and has room for two rotations */
+#define IPTIMER_BUCKETIDX(wheelno, abs)                                 \
+  ((wheelno) == 0 ? ((abs) & (CI_IPTIME_WHEEL0_BUCKETS - 1)) :          \
+   ((wheelno) + 1)*CI_IPTIME_BUCKETS + IPTIMER_BUCKETNO((wheelno), (abs)))
+
 /* get the bucket for a given wheelno and abs */
 #define IPTIMER_BUCKET(netif, wheelno, abs)                     \
   oo_p_dllink_ptr(netif,                                        \
                   &(IPTIMER_STATE((netif))->warray[             \
-                                  (wheelno)*CI_IPTIME_BUCKETS + \
-                                  IPTIMER_BUCKETNO((wheelno), (abs))]))
+                                  IPTIMER_BUCKETIDX((wheelno), (abs))]))
 
 #define IPTIMER_WHEEL2_MASK (CI_IPTIME_BUCKETMASK << (CI_IPTIME_BUCKETBITS*3))
 #define IPTIMER_WHEEL1_MASK (IPTIMER_WHEEL2_MASK + \
@@ -37,34 +42,40 @@
 #define IPTIMER_WHEEL0_MASK (IPTIMER_WHEEL1_MASK + \
                             (CI_IPTIME_BUCKETMASK << (CI_IPTIME_BUCKETBITS*1)))
 
+/* Start of the wheel0 rotation after the one containing time [stime].
+ * Timers due before this rotation ends live in wheel0; the higher wheels
+ * are arranged relative to it. */
+#define IPTIMER_NEXT_ROTATION(stime) \
+  (((stime) & IPTIMER_WHEEL0_MASK) + CI_IPTIME_BUCKETS)
+
+/* Is [time] in the current or next rotation, i.e. covered by wheel0? */
+ci_inline int ci_ip_timer_in_wheel0(ci_netif* netif, ci_iptime_t time)
+{
+  ci_iptime_t base = IPTIMER_STATE(netif)->sched_ticks & IPTIMER_WHEEL0_MASK;
+  return (ci_iptime_t) (time - base) < CI_IPTIME_WHEEL0_BUCKETS;
+}
+
 /* Mark a wheel0 bucket as busy adding a timer with the given time */
 ci_inline void __ci_timer_busy_set(ci_netif* netif, ci_iptime_t time)
 {
-  int b = IPTIMER_BUCKETNO(0, time);
-  ci_assert_equal(IPTIMER_STATE(netif)->sched_ticks & IPTIMER_WHEEL0_MASK,
-                  time & IPTIMER_WHEEL0_MASK);
+  int b = IPTIMER_BUCKETIDX(0, time);
+  ci_assert(ci_ip_timer_in_wheel0(netif, time));
   IPTIMER_STATE(netif)->busy_mask[b/64] |= 1ULL << (b%64);
 }
 
 /*  Mark a wheel0 bucket as non-busy when removing a timer */
 ci_inline void __ci_timer_busy_unset(ci_netif* netif, ci_iptime_t time)
 {
-  int b = IPTIMER_BUCKETNO(0, time);
-  ci_assert_equal(IPTIMER_STATE(netif)->sched_ticks & IPTIMER_WHEEL0_MASK,
-                  time & IPTIMER_WHEEL0_MASK);
+  int b = IPTIMER_BUCKETIDX(0, time);
+  ci_assert(ci_ip_timer_in_wheel0(netif, time));
   IPTIMER_STATE(netif)->busy_mask[b/64] &=~ (1ULL << (b%64));
 }
 
 ci_inline void ci_timer_busy_maybe_unset(ci_netif* netif, ci_iptime_t time)
 {
-  int b;
-  if( (IPTIMER_STATE(netif)->sched_ticks & IPTIMER_WHEEL0_MASK) !=
-      (time & IPTIMER_WHEEL0_MASK) )
+  if( ! ci_ip_timer_in_wheel0(netif, time) )
     return;
-  b = IPTIMER_BUCKETNO(0, time);
-  if( oo_p_dllink_is_empty(netif,
-                           oo_p_dllink_ptr(netif,
-                                           &IPTIMER_STATE(netif)->warray[b])) )
+  if( oo_p_dllink_is_empty(netif, IPTIMER_BUCKET(netif, 0, time)) )
     __ci_timer_busy_unset(netif, time);
 }
 
@@ -135,6 +146,34 @@ ci_inline void ci_ip_timer_modify(ci_netif* ni, ci_ip_timer* ts, ci_iptime_t t)
   __ci_ip_timer_set(ni, ts, t);
 }
 
+/*! Modify a timer that is usually pushed back again before it fires, such
+**  as the RTO timer.  A pending timer is not moved when its expiry gets
+**  later: the extra ticks are recorded and the timer is requeued for them
+**  when it reaches its current slot.
+**  \param netif  A pointer to the netif for this timer
+**  \param ts     A pointer to the timer structure
+**  \param t      The time at which the timer should now fire in ticks
+*/
+ci_inline void ci_ip_timer_modify_lazy(ci_netif* ni, ci_ip_timer* ts,
+                                       ci_iptime_t t)
+{
+  if( ci_ip_timer_pending(ni, ts) && TIME_GE(t, ts->time) &&
+      t - ts->time <= 0xffff ) {
+    ts->defer = t - ts->time;
+#if CI_CFG_STATS_NETIF
+    ++ni->state->stats.timer_lazy_rearms;
+#endif
+    return;
+  }
+  ci_ip_timer_modify(ni, ts, t);
+}
+
+/*! Time at which a pending timer will fire, allowing for lazy modification
+**  \param ts     A pointer to the timer structure
+*/
+ci_inline ci_iptime_t ci_ip_timer_expiry(const ci_ip_timer* ts)
+{ return ts->time + ts->defer; }
+
 /*! Initialise a new timer. */
 ci_inline void ci_ip_timer_init(ci_netif* netif, ci_ip_timer* t,
                                 oo_p t_sp, const char* name)
@@ -143,6 +182,7 @@ ci_inline void ci_ip_timer_init(ci_netif* netif, ci_ip_timer* t,
   OO_P_ADD(t_sp, CI_MEMBER_OFFSET(ci_ip_timer, link));
   link = oo_p_dllink_statep(netif, t_sp);
   t->statep = t_sp;
+  t->defer = 0;
   oo_p_dllink_init(netif, link);
 }
 
@@ -103,6 +103,16 @@ CI_CFG_OPT("EF_UL_EPOLL", ul_epoll, ci_uint32,
 "another epoll/poll/select.",
           2, , CITP_EPOLL_UL, 0, 3, oneof:kernel;ul;kernel_accel;ul_scale)
 
+CI_CFG_OPT("EF_IO_URING", io_uring, ci_uint32,
+"Handle io_uring receive, send, accept, connect and poll requests on "
+"accelerated sockets in Onload, rather than leaving them to the kernel.  "
+"Completions are posted to the application's ring as usual.\n"
+"This needs Linux 5.18 or later, and only applies to rings created with "
+"the syscall() function that don't use SQPOLL, 128-byte SQEs or "
+"registered ring file descriptors.  Linked requests, fixed files, provided "
+"buffers and multishot requests on accelerated sockets go to the kernel.",
+           1, , 0, 0, 1, yesno)
+
 CI_CFG_OPT("EF_EPOLL_SPIN", ul_epoll_spin, ci_uint32, 
 "Spin in epoll_wait() calls until an event is satisfied or the spin timeout "
 "expires (whichever is the sooner).  If the spin timeout expires, enter the "
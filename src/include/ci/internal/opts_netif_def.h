@@ -287,6 +287,18 @@ CI_CFG_OPT("EF_FORCE_TCP_NODELAY", tcp_force_nodelay, ci_uint32,
 "  2 - never set TCP_NODELAY",
            2, , 0, 0, 2, level)
 
+#if CI_CFG_UDP_REUSEPORT
+CI_CFG_OPT("EF_UDP_REUSEPORT_INSTACK", udp_reuseport_instack, ci_uint32,
+"When several unconnected UDP sockets in the same stack are bound to the "
+"same address and port with SO_REUSEPORT, spread the unicast datagrams "
+"they receive across them, as the kernel does.  Each datagram goes to the "
+"socket chosen by the program attached with SO_ATTACH_REUSEPORT_CBPF, or "
+"else by a hash of its addresses and ports.\n"
+"When disabled, all of these datagrams are delivered to one of the "
+"sockets.  Multicast datagrams are delivered to every socket either way.",
+           1, , 1, 0, 1, yesno)
+#endif
+
 CI_CFG_OPT("EF_UDP_SEND_UNLOCKED", udp_send_unlocked, ci_uint32,
 "Enables the 'unlocked' UDP send path.  When enabled this option improves "
 "concurrency when multiple threads are performing UDP sends.",
@@ -392,6 +404,20 @@ CI_CFG_OPT("EF_TAIL_DROP_PROBE", tail_drop_probe, ci_uint32,
            , , 1, 0, 1, yesno)
 #endif
 
+#if CI_CFG_TCP_RACK
+CI_CFG_OPT("EF_TCP_RACK", tcp_rack, ci_uint32,
+"Use RACK-TLP (RFC8985) to detect lost segments on TCP connections that "
+"have negotiated SACK.  A segment is deemed lost when a segment sent "
+"sufficiently later than it has been delivered, rather than when three "
+"duplicate ACKs have arrived, so that reordering in the network does not "
+"cause spurious retransmits.  The reordering "
+"window starts at a quarter of the minimum round trip time and widens "
+"when D-SACKs show that retransmits were spurious.\n"
+"Tail loss probes are sent on these connections as if EF_TAIL_DROP_PROBE "
+"were set.  Connections without SACK use duplicate ACKs as before.",
+           , , 0, 0, 1, yesno)
+#endif
+
 CI_CFG_OPT("EF_TCP_RST_DELAYED_CONN", rst_delayed_conn, ci_uint32,
 "This option tells Onload to reset TCP connections rather than allow data to "
 "be transmitted late.  Specifically, TCP connections are reset if the "
@@ -614,6 +640,22 @@ CI_CFG_OPT("EF_COMPOUND_PAGES_MODE", compound_pages, ci_uint32,
 "  2 - do not use compound pages at all.\n",
           2, , 0, 0, 2, oneof:always;small;never)
 
+#define CITP_NUMA_NODE_THREAD  -2
+#define CITP_NUMA_NODE_NIC     -1
+CI_CFG_OPT("EF_NUMA_NODE", numa_node, ci_int32,
+"Chooses the NUMA node on which the stack's packet buffers, shared state "
+"and socket buffers are allocated:\n"
+"  -1 - the node of the stack's first network interface, or of the "
+"thread doing each allocation if that is not known (default);\n"
+"  -2 - the node of the thread doing each allocation;\n"
+"  N  - node N.\n"
+"Memory is taken from other nodes if the chosen one has none free.  Huge "
+"pages (EF_USE_HUGE_PAGES) always follow the memory policy of the thread "
+"allocating them, as do the shared state and socket buffers on kernels "
+"older than 5.13.  onload_stackdump shows the node of each packet set and "
+"the free packet buffers on each node.",
+           , , -1, -2, SMAX, count)
+
 #if CI_CFG_PIO
 CI_CFG_OPT("EF_PIO", pio, ci_uint32,
 "Control of whether Programmed I/O is used instead of DMA for small packets:\n"
@@ -677,7 +719,7 @@ CI_CFG_OPT("EF_TCP_SYN_OPTS", syn_opts, ci_uint32,
 "bit 0 (0x1) is set to 1 to enable PAWS and RTTM timestamps (RFC1323),\n"
 "bit 1 (0x2) is set to 1 to enable window scaling (RFC1323),\n"
 "bit 2 (0x4) is set to 1 to enable SACK (RFC2018),\n"
-"bit 3 (0x8) is set to 1 to enable ECN (RFC3128).\n"
+"bit 3 (0x8) is set to 1 to enable ECN (RFC3168).\n"
 "The values from /proc/sys/net/ipv4/tcp_{sack,timestamp,window_scaling} "
 "are used to find the default.",
            4, , CI_TCPT_SYN_FLAGS, MIN, MAX, bitmask)
@@ -705,6 +747,31 @@ CI_CFG_OPT("EF_TCP_RX_LOG_FLAGS", tcp_rx_log_flags, ci_uint32,
 "Only active when EF_TCP_RX_CHECKS is set.",
            8, ,  0, MIN, MAX, bitmask)
 
+#if CI_CFG_LATENCY_HIST
+CI_CFG_OPT("EF_LATENCY_HIST", latency_hist, ci_uint32,
+"Record histograms of the time from a packet arriving to the application "
+"receiving it, from a packet being passed to the NIC to its transmission "
+"completing, and of how long the stack lock is held.  "
+"When set to 0 (default) nothing is recorded.\n"
+"When set to 1 the histograms are kept per stack.\n"
+"When set to 2 the first sockets to send or receive also get receive and "
+"transmit histograms of their own.\n"
+"The histograms can be read with onload_stackdump lat_hist and the "
+"onload_remote_monitor.  Their buckets are in CPU cycles.",
+           2, , 0, 0, 2, oneof:off;stack;socket)
+#endif
+
+#if CI_CFG_LOCK_PROFILE
+CI_CFG_OPT("EF_LOCK_PROFILE", lock_profile, ci_uint32,
+"Record, for each place in Onload that takes the stack lock, how often it "
+"does so, how often and for how long it has to wait for the lock, and how "
+"long it holds it.  Also count the work deferred to the lock holder that "
+"is done when the lock is released.\n"
+"The statistics can be read with onload_stackdump lock_prof.  Recording "
+"them adds to the cost of every lock and unlock.",
+           1, , 0, 0, 1, yesno)
+#endif
+
 #if CI_CFG_PORT_STRIPING
 CI_CFG_OPT("EF_STRIPE_DUPACK_THRESHOLD", stripe_dupack_threshold, ci_uint16,
 "For connections using port striping: Sets the number of duplicate ACKs that "
@@ -970,6 +1037,20 @@ CI_CFG_OPT("EF_SPIN_USEC", spin_usec, ci_uint32,
            "" /* documented in opts_citp_def.h */,
            ,  poll_cycles, 0, MIN, MAX, time:usec)
 
+#if CI_CFG_SPIN_ADAPTIVE
+CI_CFG_OPT("EF_SPIN_ADAPTIVE", spin_adaptive, ci_uint32,
+"Spin in blocking TCP and UDP receives for only as long as recent waits by "
+"the same thread suggest is worthwhile, up to the limit set by "
+"EF_SPIN_USEC or SO_BUSY_POLL.  The value is the percentage of the waits "
+"short enough to have been caught by spinning for the full limit that "
+"should still be caught.  Waits longer than the limit don't count, so a "
+"thread whose waits are all long stops spinning, and one whose data "
+"arrives soon after it asks spins for little longer than that.\n"
+"When set to 0 (default) receives spin for the full limit.  The decisions "
+"can be seen with onload_stackdump spin_adapt.",
+           8, ,  0, 0, 100, count)
+#endif
+
 CI_CFG_OPT("EF_BUZZ_USEC", buzz_usec, ci_uint32,
 "Sets the timeout in microseconds for lock buzzing options.  Set to zero to "
 "disable lock buzzing (spinning).  Will buzz forever if set to -1.  Also set "
@@ -1236,6 +1317,26 @@ CI_CFG_OPT("EF_TCP_MIN_CWND", min_cwnd, ci_uint32,
 "WARNING: Modifying this option may violate the TCP protocol.",
            ,  , 0, 0, SMAX, count)
 
+#define EF_TCP_CONG_CONTROL_RENO  0
+#define EF_TCP_CONG_CONTROL_CUBIC 1
+#define EF_TCP_CONG_CONTROL_BBR   2
+#define EF_TCP_CONG_CONTROL_DCTCP 3
+#define EF_TCP_CONG_CONTROL_MAX   EF_TCP_CONG_CONTROL_DCTCP
+CI_CFG_OPT("EF_TCP_CONG_CONTROL", tcp_cong_control, ci_uint32,
+"Selects the default congestion control algorithm for TCP connections.  "
+"Applications may override it per socket with the TCP_CONGESTION socket "
+"option.\n"
+"reno  - NewReno with Appropriate Byte Counting (RFC 3465).\n"
+"cubic - CUBIC (RFC 8312), without HyStart.\n"
+"bbr   - BBR version 1.  BBR paces transmits only when EF_TCP_PACING is "
+"enabled; otherwise it just controls the congestion window.\n"
+"dctcp - Data Center TCP (RFC 8257).  Connections always negotiate ECN, and "
+"reduce the window in proportion to the fraction of CE-marked segments.  "
+"Without ECN it behaves as reno.  It is only suitable within a data centre "
+"whose switches mark CE at a shallow queue threshold.",
+           2, , EF_TCP_CONG_CONTROL_RENO, 0, EF_TCP_CONG_CONTROL_MAX,
+           oneof:reno;cubic;bbr;dctcp)
+
 #if CI_CFG_TCP_FASTSTART
 CI_CFG_OPT("EF_TCP_FASTSTART_INIT", tcp_faststart_init, ci_uint32,
 "The FASTSTART feature prevents Onload from delaying ACKs during times when "
@@ -1320,6 +1421,39 @@ CI_CFG_OPT("EF_BURST_CONTROL_LIMIT", burst_control_limit, ci_uint32,
            , , CI_CFG_TCP_BURST_CONTROL_LIMIT, MIN, MAX, count)
 #endif
 
+#if CI_CFG_TCP_PACING
+CI_CFG_OPT("EF_TCP_PACING", tcp_pacing, ci_uint32,
+"Pace the transmission of TCP data, to avoid sending a whole congestion "
+"window back-to-back into switches with shallow buffers.\n"
+"When enabled, connections are paced at the rate chosen by the congestion "
+"control algorithm (BBR), or else at twice cwnd/srtt in slow start and 1.2 "
+"times cwnd/srtt after it.  Connections with a round trip time shorter "
+"than the timer granularity (about 1ms) are not paced by this rule.\n"
+"Independently of this option, the SO_MAX_PACING_RATE socket option paces "
+"a socket at no more than the given rate.\n"
+"Pacing is done in software by the stack's timer, so the pacing "
+"granularity is one timer tick.",
+           1, , 0, 0, 1, yesno)
+#endif
+
+#if CI_CFG_TCP_FASTOPEN
+#define CI_TCP_FASTOPEN_CLIENT  1
+#define CI_TCP_FASTOPEN_SERVER  2
+CI_CFG_OPT("EF_TCP_FASTOPEN", tcp_fastopen, ci_uint32,
+"A bitmask enabling TCP Fast Open (RFC7413), which lets the data of the "
+"first request travel in the SYN on connections after the first to a "
+"server.\n"
+"1 - client: the TCP_FASTOPEN_CONNECT socket option and the MSG_FASTOPEN "
+"flag to sendto() ask for a cookie, and use it on later connections to "
+"the same server.\n"
+"2 - server: listening sockets with the TCP_FASTOPEN socket option set "
+"issue cookies, and accept data in a SYN with a valid cookie when fewer "
+"connections than the option's value are waiting to be accepted.\n"
+"Cookies are only used with accelerated peers, not over loopback, and not "
+"when syncookies are in use.",
+           2, , CI_TCP_FASTOPEN_CLIENT, 0, 3, bitmask)
+#endif
+
 #if CI_CFG_CONG_AVOID_NOTIFIED
 CI_CFG_OPT("EF_CONG_NOTIFY_THRESH", cong_notify_thresh, ci_uint32,
 /* FIXME: need to introduce concept of burst control. */
@@ -268,6 +268,23 @@ OO_STAT("Bind() on a UDP socket found that we had insufficient filters "
 OO_STAT("Connect() on a UDP socket found that we had insufficient filters "
         "available, so the socket was handed to the kernel.",
         ci_uint32, udp_connect_no_filter, count)
+#if CI_CFG_UDP_REUSEPORT
+OO_STAT("Number of unicast UDP datagrams steered to a socket in a "
+        "SO_REUSEPORT group by the group's BPF program.",
+        ci_uint32, udp_reuseport_prog, count)
+OO_STAT("Number of unicast UDP datagrams steered to a socket in a "
+        "SO_REUSEPORT group by hashing their addresses and ports.",
+        ci_uint32, udp_reuseport_hash, count)
+OO_STAT("Number of times a SO_REUSEPORT UDP socket could not join an "
+        "in-stack group because the stack's groups were all in use or full.",
+        ci_uint32, udp_reuseport_no_group, count)
+#endif
+#if CI_CFG_SPIN_ADAPTIVE
+OO_STAT("Number of blocking receives that spun for the full EF_SPIN_USEC "
+        "because there was no room to track the thread's waits "
+        "(EF_SPIN_ADAPTIVE).",
+        ci_uint32, spin_adapt_no_slot, count)
+#endif
 OO_STAT("Onload was short of socket buffers, and reclaimed sockets that were "
         "closing, but not yet fully closed.  This can cause resets to be "
         "sent; if the remote side later finalises the close sequence.",
@@ -304,6 +321,28 @@ OO_STAT("Number of slots occupied in IPv6 software-filter hash table.",
 OO_STAT("Number of retransmit timeouts, across all TCP sockets that stack "
         "has had.",
         ci_uint32, tcp_rtos, count)
+OO_STAT("Number of timer wheel rotations that needed timers cascading into "
+        "them from the wheel above.",
+        ci_uint32, timer_cascades, count)
+OO_STAT("Number of timers cascaded into the next timer wheel rotation a few "
+        "at a time, spread over the polls of the current rotation.",
+        ci_uint32, timer_cascaded, count)
+OO_STAT("Number of timers cascaded all at once at the start of a timer wheel "
+        "rotation, because the polls during the previous rotation did not get "
+        "through them.  Indicates that the stack is polled too rarely for the "
+        "number of timers it has.",
+        ci_uint32, timer_cascade_forced, count)
+OO_STAT("Largest number of timers moved between timer wheels by one poll.",
+        ci_uint32, timer_cascade_max, val)
+OO_STAT("Most CPU cycles spent moving timers between timer wheels in one "
+        "poll.",
+        ci_uint32, timer_cascade_max_cycles, val)
+OO_STAT("Number of times a pending timer (e.g. a TCP retransmit timer) was "
+        "pushed back without requeueing it.",
+        ci_uint32, timer_lazy_rearms, count)
+OO_STAT("Number of timers that were requeued rather than fired on expiry, "
+        "because they had been pushed back since they were queued.",
+        ci_uint32, timer_lazy_requeues, count)
 #if CI_CFG_TAIL_DROP_PROBE
 OO_STAT("Number of tail-drop probes sent from retransmit queue.",
         ci_uint32, tail_drop_probe_retrans, count)
@@ -314,6 +353,21 @@ OO_STAT("Number of tail-drop probes that were probably unnecessary.",
 OO_STAT("Number of tail-drop probes that probably recovered loss.",
         ci_uint32, tail_drop_probe_success, count)
 #endif
+#if CI_CFG_TCP_RACK
+OO_STAT("Number of segments retransmitted because RACK deemed them lost.",
+        ci_uint32, tcp_rack_losses, count)
+OO_STAT("Number of fast recoveries entered because RACK deemed a segment "
+        "lost.",
+        ci_uint32, tcp_rack_recoveries, count)
+OO_STAT("Number of retransmissions that RACK deemed lost in turn.",
+        ci_uint32, tcp_rack_lost_retrans, count)
+OO_STAT("Number of times the RACK reordering timer fired.",
+        ci_uint32, tcp_rack_reo_timeouts, count)
+OO_STAT("Number of TCP connections on which RACK saw reordering.",
+        ci_uint32, tcp_rack_reordering, count)
+OO_STAT("Number of times D-SACKs widened a RACK reordering window.",
+        ci_uint32, tcp_rack_reo_wnd_grown, count)
+#endif
 OO_STAT("Number of times a connection has been reset while in accept queue; "
         "not yet a fully-connected socket.",
         ci_uint32, rst_recv_acceptq, count)
@@ -24,3 +24,20 @@ OO_STAT("Total number of segments retransmitted.",
         CI_IP_STATS_TYPE, tcp_retran_segs, count)
 OO_STAT("Number of RST segments sent.",
         CI_IP_STATS_TYPE, tcp_out_rsts, count)
+OO_STAT("Number of connections which have negotiated ECN (RFC3168).",
+        CI_IP_STATS_TYPE, tcp_ecn_estab, count)
+OO_STAT("Number of segments received with the CE (congestion experienced) "
+        "mark on connections using ECN.",
+        CI_IP_STATS_TYPE, tcp_ecn_ce_rcvd, count)
+OO_STAT("Number of ACKs of new data received with the ECE flag.",
+        CI_IP_STATS_TYPE, tcp_ecn_ece_rcvd, count)
+OO_STAT("Number of times the congestion window has been reduced in response "
+        "to ECE.",
+        CI_IP_STATS_TYPE, tcp_ecn_cwnd_reduced, count)
+OO_STAT("Number of TCP Fast Open cookies sent in SYN-ACKs (RFC7413).",
+        CI_IP_STATS_TYPE, tcp_fastopen_cookie_issued, count)
+OO_STAT("Number of connections accepted with data in the SYN and a valid "
+        "TCP Fast Open cookie.",
+        CI_IP_STATS_TYPE, tcp_fastopen_accepted, count)
+OO_STAT("Number of SYNs with an invalid TCP Fast Open cookie.",
+        CI_IP_STATS_TYPE, tcp_fastopen_rejected, count)
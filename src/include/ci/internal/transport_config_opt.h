@@ -54,6 +54,12 @@
 #define CI_CFG_TCP_BURST_CONTROL_LIMIT  0
 #endif
 
+/* Software pacing of TCP transmits (EF_TCP_PACING, SO_MAX_PACING_RATE). */
+#define CI_CFG_TCP_PACING               1
+
+/* TCP Fast Open, RFC7413 (EF_TCP_FASTOPEN). */
+#define CI_CFG_TCP_FASTOPEN             1
+
 #define CI_CFG_CONG_AVOID_NOTIFIED 0
 #if CI_CFG_CONG_AVOID_NOTIFIED
 #define CI_CFG_CONG_NOTIFY_THRESH 24
@@ -79,6 +85,12 @@
 #define CI_CFG_USERSPACE_SYSCALL        0
 #endif
 
+/* Whether to do io_uring requests on accelerated sockets in the stack.
+ * There is no libc wrapper for io_uring, so we see it only through the
+ * syscall function.
+ */
+#define CI_CFG_IO_URING                 CI_CFG_USERSPACE_SYSCALL
+
 /* Maximum number of onload stacks handled by single epoll object.
  * See also epoll_max_stacks module parameter.
  * Socket from other stacks will look just like "regular file descriptor"
@@ -410,6 +422,9 @@
 */
 #define CI_CFG_TAIL_DROP_PROBE 1
 
+/* RACK-TLP time-based loss detection, RFC8985 (EF_TCP_RACK). */
+#define CI_CFG_TCP_RACK        1
+
 /* Dump users of TCP and UDP sockets to a log file. */
 #define CI_CFG_LOG_SOCKET_USERS         0
 
@@ -484,10 +499,56 @@
 #define CI_CFG_TCPDUMP 1
 
 #if CI_CFG_TCPDUMP
-/* Dump queue length, should be 2^x, x <= 16 */
-#define CI_CFG_DUMPQUEUE_LEN 128
+/* Maximum dump queue length, should be 2^x, x <= 16.  onload_tcpdump
+ * chooses how much of it to use when it attaches. */
+#define CI_CFG_DUMPQUEUE_LEN 2048
+#define CI_CFG_DUMPQUEUE_LEN_DEFAULT 128
+
+/* Maximum length of the classic BPF program onload_tcpdump can ask the
+ * stack to run before queueing a packet */
+#define CI_CFG_DUMP_FILTER_MAX 128
 #endif /* CI_CFG_TCPDUMP */
 
+/* Latency histograms in the stack state (EF_LATENCY_HIST).  Nothing is
+ * recorded unless the option is set. */
+#define CI_CFG_LATENCY_HIST 1
+
+#if CI_CFG_LATENCY_HIST
+/* Number of sockets that can have histograms of their own */
+#define CI_CFG_LATENCY_HIST_SOCKETS 8
+#endif
+
+/* Per-call-site stack lock statistics (EF_LOCK_PROFILE).  Nothing is
+ * recorded unless the option is set. */
+#define CI_CFG_LOCK_PROFILE 1
+
+#if CI_CFG_LOCK_PROFILE
+/* Number of places in the code that can have statistics of their own */
+#define CI_CFG_LOCK_PROFILE_SITES 64
+#endif
+
+/* Steer unicast UDP datagrams across SO_REUSEPORT sockets that share a
+ * stack (EF_UDP_REUSEPORT_INSTACK). */
+#define CI_CFG_UDP_REUSEPORT 1
+
+#if CI_CFG_UDP_REUSEPORT
+/* Number of distinct addresses that can have a group in one stack */
+#define CI_CFG_UDP_REUSEPORT_GROUPS 8
+/* Maximum number of sockets in a group */
+#define CI_CFG_UDP_REUSEPORT_GROUP_SIZE 32
+/* Maximum length of a SO_ATTACH_REUSEPORT_CBPF program */
+#define CI_CFG_UDP_REUSEPORT_PROG_MAX 64
+#endif
+
+/* Size blocking receives' spin from how long recent ones waited
+ * (EF_SPIN_ADAPTIVE). */
+#define CI_CFG_SPIN_ADAPTIVE 1
+
+#if CI_CFG_SPIN_ADAPTIVE
+/* Number of threads per stack whose waits can be tracked */
+#define CI_CFG_SPIN_ADAPTIVE_THREADS 16
+#endif
+
 
 /* Support for reducing ACK rate at high throughput to improve efficiency */
 #define CI_CFG_DYNAMIC_ACK_RATE 1
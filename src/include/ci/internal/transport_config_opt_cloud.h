@@ -21,6 +21,10 @@
 #undef CI_CFG_TCP_PLUGIN_EXTRA_VIS
 #define CI_CFG_TCP_PLUGIN_EXTRA_VIS 1
 
+/* The recycler's per-connection state leaves no room for RACK's. */
+#undef CI_CFG_TCP_RACK
+#define CI_CFG_TCP_RACK 0
+
 /* Enable the SmartNIC TX CRC-offload plugin */
 #undef CI_CFG_TX_CRC_OFFLOAD
 #define CI_CFG_TX_CRC_OFFLOAD 1
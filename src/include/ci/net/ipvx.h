@@ -420,6 +420,17 @@ ipx_hdr_tos_tclass(int af, const ci_ipx_hdr_t* hdr)
       hdr->ip4.ip_tos;
 }
 
+ci_inline void
+ipx_hdr_set_tos_tclass(int af, ci_ipx_hdr_t* hdr, ci_uint8 tos)
+{
+#if CI_CFG_IPV6
+  if( IS_AF_INET6(af) )
+    ci_ip6_set_tclass(&hdr->ip6, tos);
+  else
+#endif
+    hdr->ip4.ip_tos = tos;
+}
+
 ci_inline ci_addr_t
 ci_ipx_addr_xor(int af, ci_addr_t* a, ci_addr_t* b)
 {
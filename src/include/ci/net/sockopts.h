@@ -31,6 +31,23 @@
 #define CI_UDP_ENCAP_ESPINUDP_NON_IKE 1
 #define CI_UDP_ENCAP_ESPINUDP         2
 
+/* SOL_UDP options for segmentation offload, as in linux/udp.h */
+#define CI_UDP_SEGMENT                103
+#define CI_UDP_GRO                    104
+
+/* Most datagrams a UDP_SEGMENT send may be split into (UDP_MAX_SEGMENTS) */
+#define CI_UDP_GSO_MAX_SEGS           64
+
+/* SOL_SOCKET options for SO_REUSEPORT groups, as in asm-generic/socket.h */
+#define CI_SO_ATTACH_REUSEPORT_CBPF   51
+#define CI_SO_DETACH_REUSEPORT_BPF    68
+
+/* As struct sock_fprog in linux/filter.h */
+struct ci_sock_fprog {
+  unsigned short len;
+  const void*    filter;
+};
+
 
 /* For CI_TCP_INFO */
 
@@ -79,6 +96,22 @@ struct ci_tcp_info
   ci_uint32 tcpi_rcv_space;
 
   ci_uint32 tcpi_total_retrans;
+
+  /* linux >= 3.15 */
+  ci_uint64 tcpi_pacing_rate;
+  ci_uint64 tcpi_max_pacing_rate;
+  /* linux >= 4.1 */
+  ci_uint64 tcpi_bytes_acked;
+  ci_uint64 tcpi_bytes_received;
+  ci_uint32 tcpi_segs_out;
+  ci_uint32 tcpi_segs_in;
+  /* linux >= 4.6 */
+  ci_uint32 tcpi_notsent_bytes;
+  ci_uint32 tcpi_min_rtt;
+  ci_uint32 tcpi_data_segs_in;
+  ci_uint32 tcpi_data_segs_out;
+  /* linux >= 4.9 */
+  ci_uint64 tcpi_delivery_rate;
 };
 
 #endif /* __CI_NET_SOCKOPTS_H__ */
@@ -17,14 +17,38 @@
 
 extern ci_uint32 ci_crc32c_partial(const ci_uint8 *buf, ci_uint32 buflen,
                                    ci_uint32 crc);
+  /*!< CRC32C (Castagnoli polynomial) calculation.  Values are bit
+   * reversed, as for ci_crc32_partial().  [crc] is neither inverted on the
+   * way in nor on the way out.  Uses the SSE4.2 crc32 instruction (and
+   * pclmul to run several streams at once) when the CPU has them.
+   */
 
 extern ci_uint32 ci_crc32c_partial_copy(ci_uint8 *dest, const ci_uint8 *buf,
                                         ci_uint32 buflen, ci_uint32 crc);
+  /*!< As ci_crc32c_partial(), and copies [buf] to [dest] too. */
 
 ci_inline ci_uint32 ci_crc32c(const ci_uint8 *buf, ci_uint32 buflen)
 {
   return ~ci_crc32c_partial(buf, buflen, 0xffffffff);
 }
 
+#ifndef __KERNEL__
+
+extern const char* ci_crc32c_impl_name(int i);
+  /*!< Name of the i'th implementation (best first), or NULL beyond the
+   * last one.  "slice8" is the portable one.
+   */
+
+extern int ci_crc32c_impl_select(const char* name);
+  /*!< Use the named implementation rather than the best one.  Returns
+   * -ENOENT if there's no such implementation or -EOPNOTSUPP if the CPU
+   * can't run it.  For tests and benchmarks.
+   */
+
+extern const char* ci_crc32c_impl_selected(void);
+  /*!< Name of the implementation in use. */
+
+#endif
+
 #endif  /* __CI_TOOLS_CRC32C_H__ */
 /*! \cidoxg_end */
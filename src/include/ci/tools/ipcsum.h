@@ -291,5 +291,40 @@ extern int ci_ip_csum_copy_to_iovec(ci_iovec_ptr* dest, const void* src,
 				    int src_len, unsigned* sum) CI_HF;
 
 
+/****************************************************************************
+ * Vector implementations
+ ***************************************************************************/
+
+#ifndef __KERNEL__
+
+  /*! Below this many bytes the C loop is as fast as any vector one. */
+#define CI_IP_CSUM_VEC_MIN  64
+
+  /*! Checksum a prefix of [src] with the best vector unit this CPU has,
+  ** copying it to [dest] unless [dest] is NULL.  Returns the number of
+  ** bytes done, which is a multiple of 4 and may be 0, and adds them to
+  ** the partial checksum [*sum].  The caller finishes off the rest.
+  */
+extern int ci_ip_csum_vec(void* dest, const void* src, int n,
+                          unsigned* sum) CI_HF;
+
+  /*! Name of the i'th implementation (best first), or NULL beyond the
+  ** last one.  "c" means no vector unit is used.
+  */
+extern const char* ci_ip_csum_impl_name(int i) CI_HF;
+
+  /*! Use the named implementation rather than the best one.  Returns
+  ** -ENOENT if there's no such implementation or -EOPNOTSUPP if the CPU
+  ** can't run it.  For tests and benchmarks.
+  */
+extern int ci_ip_csum_impl_select(const char* name) CI_HF;
+
+  /*! Name of the implementation in use. */
+extern const char* ci_ip_csum_impl_selected(void) CI_HF;
+
+#endif
+
+
+
 #endif  /* __CI_TOOLS_IPCSUM_H__ */
 /*! \cidoxg_end */
@@ -664,6 +664,8 @@ enum ef_vi_arch {
   EF_VI_ARCH_EFCT,
   /** Arbitrary NICs using AF_XDP */
   EF_VI_ARCH_AF_XDP,
+  /** Software back-to-back link over shared memory */
+  EF_VI_ARCH_SHM,
 };
 
 /*! \brief State of TX descriptor ring
@@ -2418,6 +2420,9 @@ extern int ef_eventq_check_event_phase_bit(const ef_vi* vi, int look_ahead);
 
 extern int efxdp_ef_eventq_check_event(const ef_vi* vi, int look_ahead);
 extern int efct_ef_eventq_check_event(const ef_vi* vi);
+#ifndef __KERNEL__
+extern int ef_shm_eventq_check_event(const ef_vi* vi);
+#endif
 
 
 /*! \brief Returns true if ef_eventq_poll() will return event(s)
@@ -2439,6 +2444,10 @@ ef_eventq_has_event(const ef_vi* vi)
       return efxdp_ef_eventq_check_event(vi, 0);
     case EF_VI_ARCH_EFCT:
       return efct_ef_eventq_check_event(vi);
+#ifndef __KERNEL__
+    case EF_VI_ARCH_SHM:
+      return ef_shm_eventq_check_event(vi);
+#endif
     default:
       return ef_eventq_check_event_phase_bit(vi, 0);
   }
@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+#ifndef __EFAB_SHM_VI_H__
+#define __EFAB_SHM_VI_H__
+
+/*! \file
+**  \brief Software \a ef_vi backend over shared memory
+**
+** A shared-memory link connects two VIs back-to-back without any network
+** hardware, so that \a ef_vi applications can be run and benchmarked on any
+** machine.  The two ends of a link can be in the same process or in
+** different processes: the link is a POSIX shared memory object named by
+** the caller, and is created by whichever end attaches first.
+**
+** Differences from hardware VIs:
+**  \li VIs are allocated with \a ef_shm_vi_alloc rather than
+**    \a ef_vi_alloc_from_pd, and need no driver handle or protection domain.
+**    Filters are not supported: a VI receives everything its peer sends.
+**  \li DMA addresses are process virtual addresses.  \a ef_shm_memreg_init
+**    sets up an \a ef_memreg so that \a ef_memreg_dma_addr returns them.
+**  \li Frames are copied when they are transmitted, so TX completions are
+**    reported by the next \a ef_eventq_poll after \a ef_vi_transmit_push.
+**  \li Frames are limited to \a EF_SHM_VI_MAX_FRAME bytes.  RX buffers
+**    are assumed to be that long unless the application says otherwise with
+**    \a ef_vi_receive_set_buffer_len; longer frames are not scattered but
+**    discarded with \a EF_EVENT_RX_DISCARD_TRUNC.  There is no RX prefix.
+**  \li A frame that arrives when the receiver has no RX descriptor posted,
+**    or that finds the link full, is dropped and counted.
+**  \li PIO, TX alternatives, timestamps and packed stream are not supported.
+**    CTPIO sends fall back to a normal send.
+**
+** Each end can impair the frames it transmits with a fixed latency, random
+** loss and random reordering; see \a ef_shm_attr.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <etherfabric/ef_vi.h>
+#include <etherfabric/memreg.h>
+
+/*! \brief Largest frame that can be sent over a shared-memory link */
+#define EF_SHM_VI_MAX_FRAME  2032
+
+/*! \brief Impairments applied to the frames transmitted by one end */
+struct ef_shm_attr {
+  /** One-way delay added to every frame, in nanoseconds */
+  unsigned latency_ns;
+  /** Frames dropped per million transmitted */
+  unsigned loss_ppm;
+  /** Frames delivered after their successor, per million transmitted */
+  unsigned reorder_ppm;
+  /** Seed for the loss and reordering decisions */
+  unsigned seed;
+};
+
+/*! \brief Initialise link attributes to their defaults
+**
+** \param attr The attributes to initialise.
+**
+** Defaults are taken from the environment variables EF_SHM_LATENCY_NS,
+** EF_SHM_LOSS_PPM, EF_SHM_REORDER_PPM and EF_SHM_SEED, and are otherwise
+** zero (no impairment).
+*/
+extern void ef_shm_attr_init(struct ef_shm_attr* attr);
+
+/*! \brief Allocate a VI on one end of a shared-memory link
+**
+** \param vi           The VI to initialise.
+** \param link_name    Name of the POSIX shared memory object for the link.
+** \param end          Which end of the link to attach to: 0 or 1.
+** \param attr         Impairments for frames sent by this VI, or NULL for
+**                     the defaults from \a ef_shm_attr_init.
+** \param rxq_capacity Capacity of the RX queue, or -1 for the default.
+** \param txq_capacity Capacity of the TX queue, or -1 for the default.
+** \param flags        Flags to select features.
+**
+** \return 0 on success, or a negative error code:\n
+**         -EBUSY if another live process has this end of the link\n
+**         -EOPNOTSUPP if \a flags requests an unsupported feature\n
+**         other negative error codes from shm_open() or mmap().
+*/
+extern int ef_shm_vi_alloc(ef_vi* vi, const char* link_name, int end,
+                           const struct ef_shm_attr* attr,
+                           int rxq_capacity, int txq_capacity,
+                           enum ef_vi_flags flags);
+
+/*! \brief Free a VI allocated by \a ef_shm_vi_alloc
+**
+** \param vi The VI to free.
+**
+** The link's shared memory object is removed when both ends are freed.
+*/
+extern void ef_shm_vi_free(ef_vi* vi);
+
+/*! \brief Set up a memory region for use with shared-memory VIs
+**
+** \param mr        The ef_memreg object to initialise.
+** \param p_mem     Start of the memory region; must be 4K aligned.
+** \param len_bytes Length of the memory region.
+**
+** \return 0 on success, or -ENOMEM.
+**
+** Nothing is pinned or mapped for DMA: this only records addresses so that
+** \a ef_memreg_dma_addr works as usual.
+*/
+extern int ef_shm_memreg_init(ef_memreg* mr, void* p_mem, size_t len_bytes);
+
+/*! \brief Free a memory region set up by \a ef_shm_memreg_init */
+extern void ef_shm_memreg_fini(ef_memreg* mr);
+
+/*! \brief Counters for one end of a shared-memory link */
+struct ef_shm_vi_stats {
+  /** Frames sent onto the link */
+  uint64_t tx_pkts;
+  /** Frames dropped by the configured loss rate */
+  uint64_t tx_lost;
+  /** Frames held back to be delivered after their successor */
+  uint64_t tx_reordered;
+  /** Frames dropped because the receiver had fallen too far behind */
+  uint64_t tx_link_full;
+  /** Frames received */
+  uint64_t rx_pkts;
+  /** Frames dropped because no RX descriptor was posted */
+  uint64_t rx_no_desc;
+};
+
+/*! \brief Read the counters for a shared-memory VI
+**
+** \param vi    The VI to query.
+** \param stats Filled in with the counters.
+*/
+extern void ef_shm_vi_get_stats(ef_vi* vi, struct ef_shm_vi_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __EFAB_SHM_VI_H__ */
@@ -15,6 +15,7 @@
 #define __ONLOAD_EXTENSIONS_H__
 
 #include <sys/types.h>
+#include <sys/socket.h>
 #include <stdint.h>
 #include <onload/extensions_timestamping.h>
 
@@ -251,6 +252,62 @@ extern int onload_fd_check_feature(int fd, enum onload_fd_feature feature);
 extern int onload_move_fd(int fd);
 
 
+/**********************************************************************
+ * onload_accept_batch: Accept many connections in one call
+ *
+ * Takes up to max_msgs established connections from the accept queue of
+ * the listening socket fd.  The queue is drained under one hold of the
+ * listener's lock rather than one per connection, so this is cheaper than
+ * calling accept4() in a loop when connections arrive in bursts.
+ *
+ * For each connection onload fills in msgs[i]:
+ *  - fd is the new socket
+ *  - addr and addrlen are the peer's address, as from accept()
+ *
+ * flags may contain SOCK_NONBLOCK and SOCK_CLOEXEC, which apply to the
+ * new sockets as for accept4().  onload_accept_batch never blocks.
+ *
+ * Returns the number of connections accepted, which may be zero, or <0 to
+ * indicate an error.  fd must be an accelerated TCP socket, otherwise the
+ * call fails with -ESOCKTNOSUPPORT, and it must be listening, otherwise it
+ * fails with -EINVAL.  If it runs out of fds after accepting some
+ * connections then their number is returned, and the rest are left on the
+ * queue.
+ */
+
+struct onload_accept_batch_msg {
+  int fd;
+  socklen_t addrlen;
+  struct sockaddr_storage addr;
+};
+
+extern int onload_accept_batch(int fd, struct onload_accept_batch_msg* msgs,
+                               int max_msgs, int flags);
+
+
+/* onload_accept_batchv accepts connections on several listening sockets in
+ * one call, for example those that epoll_wait() reports as readable.  For
+ * each vec[i] it accepts up to vec[i].max_msgs connections on vec[i].fd
+ * into vec[i].msgs, as onload_accept_batch() does, and sets vec[i].n_msgs
+ * to the number accepted.
+ *
+ * Returns the total number of connections accepted, or <0 to indicate an
+ * error.  The listeners are handled in order and the call stops at the
+ * first one that fails.  If connections were already accepted on earlier
+ * listeners their number is returned, and n_msgs is zero for the rest.
+ */
+
+struct onload_accept_batch_vec {
+  int fd;
+  struct onload_accept_batch_msg* msgs;
+  int max_msgs;
+  int n_msgs;
+};
+
+extern int onload_accept_batchv(struct onload_accept_batch_vec* vec, int vlen,
+                                int flags);
+
+
 /**********************************************************************
  * onload_ordered_epoll_wait: Wire order delivery via epoll
  *
@@ -17,6 +17,7 @@
 #include <sys/uio.h>    // for struct iovec
 #include <sys/socket.h> // for struct msghdr
 #include <stdint.h>
+#include <time.h>       // for struct timespec
 
 #include <etherfabric/ef_vi.h>
 
@@ -277,6 +278,61 @@ struct onload_zc_recv_args {
 extern int onload_zc_recv(int fd, struct onload_zc_recv_args *args);
 
 
+/* onload_zc_recv_batch receives messages from several UDP sockets in one
+ * call, without callbacks.  It is meant for applications that receive on
+ * many sockets, such as one per multicast group, and would otherwise call
+ * onload_zc_recv() on each socket that epoll reports as readable.
+ *
+ * Each stack is polled once, and then up to max_msgs messages are taken
+ * from the sockets in fds, in that order.  Sockets get an equal share of
+ * max_msgs first, and any space left goes to sockets with more to read.
+ *
+ * For each message onload fills in msgs[i]:
+ *  - fd is the socket it arrived on
+ *  - msg.iov points to its buffers, which are taken from the iov array of
+ *  iov_len entries
+ *  - msg.msghdr.msg_iovlen is the number of buffers
+ *  - msg.msghdr.msg_name and msg_namelen are set to the source address,
+ *  if the caller set msg_name and msg_namelen in msgs[i] beforehand
+ *  - ts is the software receive timestamp, and hw_ts the NIC's receive
+ *  timestamp if the stack has hardware timestamping enabled; otherwise
+ *  they are zero
+ *  - flags is ONLOAD_ZC_MSG_SHARED if the buffers are shared with other
+ *  sockets, as for multicast, in which case they must not be modified
+ *
+ * If the socket has a filter set with onload_set_recv_filter(), it is
+ * called for each message first, as for the other receive calls.
+ *
+ * The buffers belong to the application, as if a receive callback had
+ * returned ONLOAD_ZC_KEEP.  They must be released with
+ * onload_zc_release_buffers(fd, &msgs[i].msg.iov[0].buf, 1).
+ *
+ * onload_zc_recv_batch never blocks, and does not deliver datagrams
+ * received through the kernel; use onload_recvmsg_kernel() for those.
+ * Sockets locked by another thread's receive are skipped.  flags must be
+ * zero.
+ *
+ * Returns the number of messages received, which may be zero, or <0 to
+ * indicate an error.  If one of the sockets is not an accelerated UDP
+ * socket this is -ESOCKTNOSUPPORT, unless messages were already received
+ * from earlier sockets, in which case their number is returned.
+ */
+
+struct onload_zc_recv_batch_msg {
+  struct onload_zc_msg msg;
+  int fd;
+  int flags;
+  struct timespec ts;
+  struct timespec hw_ts;
+};
+
+extern int onload_zc_recv_batch(const int* fds, int nfds,
+                                struct onload_zc_recv_batch_msg* msgs,
+                                int max_msgs,
+                                struct onload_zc_iovec* iov, int iov_len,
+                                int flags);
+
+
 /* Use onload_recvmsg_kernel() to access packets delivered by
  * kernel/OS rather than Onload, when onload_zc_recv() returns
  * -ENOTEMPTY
@@ -143,6 +143,8 @@ void oo_iobufset_kfree(struct oo_buffer_pages *pages);
  *
  * \param order         page order to allocate
  * \param min_nic_order minimum NIC page order
+ * \param numa_node     node to allocate the pages on, or NUMA_NO_NODE for
+ *                      the current one; huge pages ignore it
  * \param flags         see OO_IOBUFSET_FLAG_*, in/out
  * \param pages_out     pointer to return the allocated pages
  *
@@ -153,8 +155,8 @@ void oo_iobufset_kfree(struct oo_buffer_pages *pages);
  * EFHW_NIC_PAGE_SIZE != PAGE_SIZE, as on PPC.
  */
 extern int
-oo_iobufset_pages_alloc(int nic_order, int min_nic_order, int *flags,
-                        struct oo_buffer_pages **pages_out);
+oo_iobufset_pages_alloc(int nic_order, int min_nic_order, int numa_node,
+                        int *flags, struct oo_buffer_pages **pages_out);
 extern void oo_iobufset_pages_release(struct oo_buffer_pages *);
 
 /*!
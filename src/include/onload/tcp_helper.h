@@ -180,6 +180,10 @@ typedef struct tcp_helper_resource_s {
 
   ci_netif               netif;
 
+  /*! Node to allocate the stack's memory on, or NUMA_NO_NODE for the
+   * allocating thread's (EF_NUMA_NODE). */
+  int                    numa_node;
+
 #if ! CI_CFG_UL_INTERRUPT_HELPER
   /*! Kernel side stack lock. Needed so we can determine who "owns" the
    *   netif lock (kernel or user).
@@ -46,6 +46,10 @@ struct oo_per_thread {
   ci_uint64                  select_nonblock_fast_frc;
   struct oo_timesync         timesync;
   unsigned                   spinstate; 
+  /* This thread's id, and the slot in the stack's spin_adapt[] it last
+   * used (EF_SPIN_ADAPTIVE) */
+  int                        spin_adapt_tid;
+  int                        spin_adapt_slot;
   int                        in_vfork_child;
   void*                      vfork_scratch[OO_VFORK_SCRATCH_SIZE];
 };
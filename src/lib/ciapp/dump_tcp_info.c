@@ -28,6 +28,10 @@ void ci_dump_tcp_info(ci_log_fn_t l, const struct ci_tcp_info* i)
     snprintf(s, sizeof(s), "%20s: %d", #x, (int) i->x); \
     l(s);                                               \
   } while(0)
+#define dump64(x)  do {                                             \
+    snprintf(s, sizeof(s), "%20s: %llu", #x, (unsigned long long) i->x); \
+    l(s);                                                           \
+  } while(0)
 
   dump(tcpi_state);
   dump(tcpi_ca_state);
@@ -66,6 +70,18 @@ void ci_dump_tcp_info(ci_log_fn_t l, const struct ci_tcp_info* i)
   dump(tcpi_rcv_rtt);
   dump(tcpi_rcv_space);
   dump(tcpi_total_retrans);
+
+  dump64(tcpi_pacing_rate);
+  dump64(tcpi_max_pacing_rate);
+  dump64(tcpi_bytes_acked);
+  dump64(tcpi_bytes_received);
+  dump(tcpi_segs_out);
+  dump(tcpi_segs_in);
+  dump(tcpi_notsent_bytes);
+  dump(tcpi_min_rtt);
+  dump(tcpi_data_segs_in);
+  dump(tcpi_data_segs_out);
+  dump64(tcpi_delivery_rate);
 }
 
 #endif
@@ -48,7 +48,7 @@ get_cpuid(int op, int *eax, int *ebx, int *ecx, int *edx)
   /* NB. We have to save [ebx] when building position indepent code. */
   __asm__ __volatile__ ("pushl %%ebx; cpuid; mov %%ebx, %0; popl %%ebx"
 			: "=r" (*ebx), "=a" (*eax), "=c" (*ecx), "=d" (*edx)
-			: "a" (op));
+			: "a" (op), "c" (0));
 }
 #endif
 
@@ -149,7 +149,7 @@ get_cpuid(int op, int *eax, int *ebx, int *ecx, int *edx)
 {
   __asm__ __volatile__ ("cpuid\n\t"
                         : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
-                        : "a" (op));
+                        : "a" (op), "c" (0));
 }
 
 #else
@@ -167,16 +167,53 @@ extern int ci_cpu_features_check(int verbose)
 
 #endif
 
+#if defined(__x86_64__) || defined(__i386__)
+
+/* Register state enabled by the OS in XCR0 */
+#define XCR0_AVX     0x06  /* SSE and AVX */
+#define XCR0_AVX512  0xe6  /* ... and opmask, ZMM0-15 upper halves, ZMM16-31 */
+
+ci_inline int os_has_xstate(int ecx, unsigned mask)
+{
+  unsigned eax, edx;
+
+  /* OSXSAVE: XGETBV is usable */
+  if( ! (ecx & 0x08000000) )
+    return 0;
+  __asm__ __volatile__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+  return (eax & mask) == mask;
+}
+
+#endif
+
 int ci_cpu_has_feature(char* feature)
 {
 #if defined(__x86_64__) || defined(__i386__)
   int eax, ebx, ecx, edx;
+  int max_leaf, eax7, ebx7, ecx7, edx7;
+
+  get_cpuid(0, &max_leaf, &ebx, &ecx, &edx);
 
   /* Leaf 1 = CPUID feature bits */
   get_cpuid(1, &eax, &ebx, &ecx, &edx);
 
   if( ! strcmp(feature, "pclmul") )
     return ecx & 0x00000002;
+  if( ! strcmp(feature, "sse2") )
+    return edx & 0x04000000;
+  if( ! strcmp(feature, "sse4.2") )
+    return ecx & 0x00100000;
+
+  /* Leaf 7 = extended feature bits.  AVX state must also be enabled by the
+   * OS, or the instructions fault. */
+  if( max_leaf < 7 )
+    return 0;
+  get_cpuid(7, &eax7, &ebx7, &ecx7, &edx7);
+
+  if( ! strcmp(feature, "avx2") )
+    return (ebx7 & 0x00000020) && os_has_xstate(ecx, XCR0_AVX);
+  if( ! strcmp(feature, "avx512f") )
+    return (ebx7 & 0x00010000) && os_has_xstate(ecx, XCR0_AVX512);
 #endif
 
   /* Not supported on platforms that don't implement the CPUID instruction */
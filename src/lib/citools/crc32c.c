@@ -0,0 +1,262 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+*//*! \file
+** <L5_PRIVATE L5_SOURCE>
+**  \brief  CRC32C (Castagnoli), as used by iSCSI, NVMe/TCP and Ceph.
+** </L5_PRIVATE>
+*//*
+\**************************************************************************/
+
+/*! \cidoxg_lib_citools */
+
+#include "citools_internal.h"
+#include <ci/tools/crc32c.h>
+#include "crc32c_table.h"
+
+#if ! defined(__KERNEL__) && defined(CI_HAVE_X86INTRIN)
+# include <x86intrin.h>
+# define CRC32C_HW 1
+#else
+# define CRC32C_HW 0
+#endif
+
+
+/* All the implementations work on the raw CRC register: no inversion on
+ * the way in or out.  Like ci_crc32_partial(), the values are
+ * bit-reversed. */
+
+typedef ci_uint32 (*crc32c_fn)(ci_uint32 crc, const ci_uint8* buf,
+                               ci_uint32 len);
+
+
+static ci_uint32 crc32c_slice8(ci_uint32 crc, const ci_uint8* buf,
+                               ci_uint32 len)
+{
+  const ci_uint32 (*t)[256] = crc32c_table;
+
+  for( ; len != 0 && ((ci_uintptr_t) buf & 7) != 0; --len )
+    crc = t[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+  for( ; len >= 8; len -= 8, buf += 8 ) {
+    ci_uint32 lo, hi;
+    memcpy(&lo, buf, sizeof(lo));
+    memcpy(&hi, buf + 4, sizeof(hi));
+    lo = CI_BSWAP_LE32(lo) ^ crc;
+    hi = CI_BSWAP_LE32(hi);
+    crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+          t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+          t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+  }
+
+  while( len-- )
+    crc = t[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+
+#if CRC32C_HW
+
+/* The SSE4.2 crc32 instruction does 8 bytes per go, but its latency is 3
+ * cycles, so a single stream runs at a third of the throughput.  The
+ * pclmul version runs three streams over adjacent blocks and then
+ * combines them: if c0, c1 and c2 are the CRCs of three blocks of L bytes
+ * (only c0 with the initial value) then the CRC of the lot is
+ *
+ *   c0 * x^(16L) + c1 * x^(8L) + c2  (mod P).
+ *
+ * Multiplying by a constant K with pclmul gives a 64-bit product, and
+ * crc32 of that multiplies it by x^33 (x^32, plus one for the bit-reversed
+ * product) and reduces it.  So K is x^(8L-33) mod P.
+ */
+#define LONG_BLOCK   1024
+#define LONG_K1      0x170076fa  /* x^(8 * 1024 - 33) mod P */
+#define LONG_K2      0xa51b6135  /* x^(16 * 1024 - 33) mod P */
+#define SHORT_BLOCK  128
+#define SHORT_K1     0x0d3b6092  /* x^(8 * 128 - 33) mod P */
+#define SHORT_K2     0xb9e02b86  /* x^(16 * 128 - 33) mod P */
+
+
+__attribute__((target("sse4.2"))) ci_inline ci_uint64
+crc32c_u64(ci_uint64 crc, const ci_uint8* buf)
+{
+  ci_uint64 v;
+  memcpy(&v, buf, sizeof(v));
+  return _mm_crc32_u64(crc, v);
+}
+
+
+__attribute__((target("sse4.2"))) static ci_uint32
+crc32c_sse42(ci_uint32 crc, const ci_uint8* buf, ci_uint32 len)
+{
+  ci_uint64 c = crc;
+
+  for( ; len != 0 && ((ci_uintptr_t) buf & 7) != 0; --len )
+    c = _mm_crc32_u8((ci_uint32) c, *buf++);
+  for( ; len >= 8; len -= 8, buf += 8 )
+    c = crc32c_u64(c, buf);
+  while( len-- )
+    c = _mm_crc32_u8((ci_uint32) c, *buf++);
+  return (ci_uint32) c;
+}
+
+
+__attribute__((target("sse4.2,pclmul"))) ci_inline ci_uint64
+crc32c_shift(ci_uint64 crc, ci_uint32 k)
+{
+  __m128i p = _mm_clmulepi64_si128(_mm_cvtsi32_si128((ci_uint32) crc),
+                                   _mm_cvtsi32_si128(k), 0);
+  return _mm_crc32_u64(0, _mm_cvtsi128_si64(p));
+}
+
+
+__attribute__((target("sse4.2,pclmul"), always_inline)) ci_inline ci_uint64
+crc32c_3way(ci_uint64 c, const ci_uint8** pbuf, ci_uint32* plen,
+            const ci_uint32 block, ci_uint32 k1, ci_uint32 k2)
+{
+  const ci_uint8* buf = *pbuf;
+  ci_uint32 len = *plen;
+
+  for( ; len >= 3 * block; len -= 3 * block, buf += 3 * block ) {
+    ci_uint64 c1 = 0, c2 = 0;
+    ci_uint32 i;
+    for( i = 0; i < block; i += 8 ) {
+      c = crc32c_u64(c, buf + i);
+      c1 = crc32c_u64(c1, buf + block + i);
+      c2 = crc32c_u64(c2, buf + 2 * block + i);
+    }
+    c = crc32c_shift(c, k2) ^ crc32c_shift(c1, k1) ^ c2;
+  }
+
+  *pbuf = buf;
+  *plen = len;
+  return c;
+}
+
+
+__attribute__((target("sse4.2,pclmul"))) static ci_uint32
+crc32c_pclmul(ci_uint32 crc, const ci_uint8* buf, ci_uint32 len)
+{
+  ci_uint64 c = crc;
+
+  for( ; len != 0 && ((ci_uintptr_t) buf & 7) != 0; --len )
+    c = _mm_crc32_u8((ci_uint32) c, *buf++);
+  c = crc32c_3way(c, &buf, &len, LONG_BLOCK, LONG_K1, LONG_K2);
+  c = crc32c_3way(c, &buf, &len, SHORT_BLOCK, SHORT_K1, SHORT_K2);
+  return crc32c_sse42((ci_uint32) c, buf, len);
+}
+
+#endif /* CRC32C_HW */
+
+
+#ifndef __KERNEL__
+
+struct crc32c_impl {
+  const char* name;
+  /* As for ci_cpu_has_feature(), NULL if not needed */
+  const char* feature[2];
+  crc32c_fn fn;
+};
+
+/* Best first */
+static const struct crc32c_impl crc32c_impls[] = {
+#if CRC32C_HW
+  { "pclmul", { "sse4.2", "pclmul" }, crc32c_pclmul },
+  { "sse42",  { "sse4.2", NULL },     crc32c_sse42 },
+#endif
+  { "slice8", { NULL, NULL },         crc32c_slice8 },
+};
+
+#define N_IMPLS  (sizeof(crc32c_impls) / sizeof(crc32c_impls[0]))
+
+static const struct crc32c_impl* crc32c_impl;
+
+
+static int crc32c_impl_supported(const struct crc32c_impl* impl)
+{
+  int i;
+
+  for( i = 0; i < 2; ++i )
+    if( impl->feature[i] != NULL &&
+        ! ci_cpu_has_feature((char*) impl->feature[i]) )
+      return 0;
+  return 1;
+}
+
+
+static const struct crc32c_impl* crc32c_impl_get(void)
+{
+  const struct crc32c_impl* impl = crc32c_impl;
+
+  /* Racing threads pick the same one, so no need for a lock. */
+  if(CI_UNLIKELY( impl == NULL )) {
+    for( impl = crc32c_impls; ! crc32c_impl_supported(impl); ++impl )
+      ;
+    crc32c_impl = impl;
+  }
+  return impl;
+}
+
+
+const char* ci_crc32c_impl_name(int i)
+{
+  if( i < 0 || i >= N_IMPLS )
+    return NULL;
+  return crc32c_impls[i].name;
+}
+
+
+int ci_crc32c_impl_select(const char* name)
+{
+  int i;
+
+  for( i = 0; i < N_IMPLS; ++i )
+    if( ! strcmp(crc32c_impls[i].name, name) ) {
+      if( ! crc32c_impl_supported(&crc32c_impls[i]) )
+        return -EOPNOTSUPP;
+      crc32c_impl = &crc32c_impls[i];
+      return 0;
+    }
+  return -ENOENT;
+}
+
+
+const char* ci_crc32c_impl_selected(void)
+{
+  return crc32c_impl_get()->name;
+}
+
+#endif /* __KERNEL__ */
+
+
+ci_uint32 ci_crc32c_partial(const ci_uint8 *buf, ci_uint32 buflen,
+                            ci_uint32 crc)
+{
+  ci_assert(buf || buflen == 0);
+#ifndef __KERNEL__
+  return crc32c_impl_get()->fn(crc, buf, buflen);
+#else
+  return crc32c_slice8(crc, buf, buflen);
+#endif
+}
+
+
+ci_uint32 ci_crc32c_partial_copy(ci_uint8 *dest, const ci_uint8 *buf,
+                                 ci_uint32 buflen, ci_uint32 crc)
+{
+  /* Copy a chunk at a time and checksum the copy while it's in cache */
+  const ci_uint32 chunk = 4096;
+
+  while( buflen != 0 ) {
+    ci_uint32 n = CI_MIN(buflen, chunk);
+    memcpy(dest, buf, n);
+    crc = ci_crc32c_partial(dest, n, crc);
+    dest += n;
+    buf += n;
+    buflen -= n;
+  }
+  return crc;
+}
+
+/*! \cidoxg_end */
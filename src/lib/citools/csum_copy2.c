@@ -34,6 +34,15 @@ unsigned ci_ip_csum_copy2(void* dest, const void* src, int n, unsigned sum)
   ci_assert(n >= 0);
   ci_assert(CI_OFFSET(n, 2) == 0);
 
+#ifndef __KERNEL__
+  if( n >= CI_IP_CSUM_VEC_MIN ) {
+    int done = ci_ip_csum_vec(dest, src, n, &sum);
+    d4 += done >> 2;
+    s4 += done >> 2;
+    n -= done;
+  }
+#endif
+
   es4 = s4 + (n >> 2);
 
   while( s4 != es4 ) {
@@ -25,6 +25,16 @@ unsigned ci_ip_csum_partial(unsigned sum, const volatile void* in_buf,
   ci_assert(in_buf || bytes == 0);
   ci_assert(bytes >= 0);
 
+#ifndef __KERNEL__
+  if( bytes >= CI_IP_CSUM_VEC_MIN ) {
+    int done = ci_ip_csum_vec(NULL, (const void*) buf, bytes, &sum);
+    buf += done >> 1;
+    bytes -= done;
+    /* The loop below does not carry, so leave it room */
+    sum = ci_ip_csum_fold(sum);
+  }
+#endif
+
   while( bytes > 1 ) {
     sum += *buf++;
     bytes -= 2;
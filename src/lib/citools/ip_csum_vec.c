@@ -0,0 +1,322 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+*//*! \file
+** <L5_PRIVATE L5_SOURCE>
+**  \brief  Internet checksum (and copy) with vector instructions.
+** </L5_PRIVATE>
+*//*
+\**************************************************************************/
+
+/*! \cidoxg_lib_citools */
+
+#include "citools_internal.h"
+
+#if defined(CI_HAVE_X86INTRIN)
+# include <x86intrin.h>
+#elif defined(__aarch64__)
+# include <arm_neon.h>
+#endif
+
+
+/* The one's complement sum is the sum of the 32-bit words modulo 0xffff, so
+ * the words are zero-extended and summed in 64-bit lanes, which can't
+ * overflow for any sane length, and the carries are folded in once at the
+ * end.  Every kernel does as many whole blocks as it can and leaves the
+ * tail to the C code.
+ *
+ * Each kernel is instantiated twice, with and without the copy, so that the
+ * inner loop has no branch on [dest].
+ */
+
+typedef int (*ci_ip_csum_vec_fn)(void* dest, const void* src, int n,
+                                 ci_uint64* sum64);
+
+#define LOAD_SRC(type, load, off)  load((const type*) ((const char*) src + (off)))
+#define STORE_DEST(type, store, off, v)              \
+  do {                                               \
+    if( copy )                                       \
+      store((type*) ((char*) dest + (off)), (v));    \
+  } while( 0 )
+
+
+#if defined(CI_HAVE_X86INTRIN)
+
+__attribute__((target("sse2"))) static inline ci_uint64
+sse2_sum(__m128i acc)
+{
+  ci_uint64 lane[2];
+  _mm_storeu_si128((__m128i*) lane, acc);
+  return lane[0] + lane[1];
+}
+
+__attribute__((target("sse2"), always_inline)) static inline int
+ci_ip_csum_sse2_body(void* dest, const void* src, int n,
+                     ci_uint64* sum64, const int copy)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc0 = zero, acc1 = zero;
+  int i;
+
+  for( i = 0; i + 32 <= n; i += 32 ) {
+    __m128i a = LOAD_SRC(__m128i, _mm_loadu_si128, i);
+    __m128i b = LOAD_SRC(__m128i, _mm_loadu_si128, i + 16);
+    STORE_DEST(__m128i, _mm_storeu_si128, i, a);
+    STORE_DEST(__m128i, _mm_storeu_si128, i + 16, b);
+    acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(a, zero));
+    acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(a, zero));
+    acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(b, zero));
+    acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(b, zero));
+  }
+  if( i + 16 <= n ) {
+    __m128i a = LOAD_SRC(__m128i, _mm_loadu_si128, i);
+    STORE_DEST(__m128i, _mm_storeu_si128, i, a);
+    acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(a, zero));
+    acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(a, zero));
+    i += 16;
+  }
+
+  *sum64 += sse2_sum(_mm_add_epi64(acc0, acc1));
+  return i;
+}
+
+__attribute__((target("sse2"))) static int
+ci_ip_csum_sse2(void* dest, const void* src, int n, ci_uint64* sum64)
+{
+  if( dest != NULL )
+    return ci_ip_csum_sse2_body(dest, src, n, sum64, 1);
+  else
+    return ci_ip_csum_sse2_body(NULL, src, n, sum64, 0);
+}
+
+
+__attribute__((target("avx2"))) static inline ci_uint64
+avx2_sum(__m256i acc)
+{
+  return sse2_sum(_mm_add_epi64(_mm256_castsi256_si128(acc),
+                                _mm256_extracti128_si256(acc, 1)));
+}
+
+__attribute__((target("avx2"), always_inline)) static inline int
+ci_ip_csum_avx2_body(void* dest, const void* src, int n,
+                     ci_uint64* sum64, const int copy)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i acc0 = zero, acc1 = zero;
+  int i;
+
+  for( i = 0; i + 64 <= n; i += 64 ) {
+    __m256i a = LOAD_SRC(__m256i, _mm256_loadu_si256, i);
+    __m256i b = LOAD_SRC(__m256i, _mm256_loadu_si256, i + 32);
+    STORE_DEST(__m256i, _mm256_storeu_si256, i, a);
+    STORE_DEST(__m256i, _mm256_storeu_si256, i + 32, b);
+    acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(a, zero));
+    acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(a, zero));
+    acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(b, zero));
+    acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(b, zero));
+  }
+  if( i + 32 <= n ) {
+    __m256i a = LOAD_SRC(__m256i, _mm256_loadu_si256, i);
+    STORE_DEST(__m256i, _mm256_storeu_si256, i, a);
+    acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(a, zero));
+    acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(a, zero));
+    i += 32;
+  }
+
+  *sum64 += avx2_sum(_mm256_add_epi64(acc0, acc1));
+  return i;
+}
+
+__attribute__((target("avx2"))) static int
+ci_ip_csum_avx2(void* dest, const void* src, int n, ci_uint64* sum64)
+{
+  if( dest != NULL )
+    return ci_ip_csum_avx2_body(dest, src, n, sum64, 1);
+  else
+    return ci_ip_csum_avx2_body(NULL, src, n, sum64, 0);
+}
+
+
+__attribute__((target("avx512f"), always_inline)) static inline int
+ci_ip_csum_avx512_body(void* dest, const void* src, int n,
+                       ci_uint64* sum64, const int copy)
+{
+  const __m512i zero = _mm512_setzero_si512();
+  __m512i acc0 = zero, acc1 = zero;
+  ci_uint64 lane[8];
+  int i, j;
+
+  for( i = 0; i + 128 <= n; i += 128 ) {
+    __m512i a = LOAD_SRC(__m512i, _mm512_loadu_si512, i);
+    __m512i b = LOAD_SRC(__m512i, _mm512_loadu_si512, i + 64);
+    STORE_DEST(__m512i, _mm512_storeu_si512, i, a);
+    STORE_DEST(__m512i, _mm512_storeu_si512, i + 64, b);
+    acc0 = _mm512_add_epi64(acc0, _mm512_unpacklo_epi32(a, zero));
+    acc1 = _mm512_add_epi64(acc1, _mm512_unpackhi_epi32(a, zero));
+    acc0 = _mm512_add_epi64(acc0, _mm512_unpacklo_epi32(b, zero));
+    acc1 = _mm512_add_epi64(acc1, _mm512_unpackhi_epi32(b, zero));
+  }
+  if( i + 64 <= n ) {
+    __m512i a = LOAD_SRC(__m512i, _mm512_loadu_si512, i);
+    STORE_DEST(__m512i, _mm512_storeu_si512, i, a);
+    acc0 = _mm512_add_epi64(acc0, _mm512_unpacklo_epi32(a, zero));
+    acc1 = _mm512_add_epi64(acc1, _mm512_unpackhi_epi32(a, zero));
+    i += 64;
+  }
+
+  _mm512_storeu_si512(lane, _mm512_add_epi64(acc0, acc1));
+  for( j = 0; j < 8; ++j )
+    *sum64 += lane[j];
+
+  /* Up to 63 bytes are left, so finish with 256-bit vectors */
+  return i + ci_ip_csum_avx2_body(copy ? (char*) dest + i : NULL,
+                                  (const char*) src + i, n - i, sum64, copy);
+}
+
+__attribute__((target("avx512f"))) static int
+ci_ip_csum_avx512(void* dest, const void* src, int n, ci_uint64* sum64)
+{
+  if( dest != NULL )
+    return ci_ip_csum_avx512_body(dest, src, n, sum64, 1);
+  else
+    return ci_ip_csum_avx512_body(NULL, src, n, sum64, 0);
+}
+
+#endif /* CI_HAVE_X86INTRIN */
+
+
+#if defined(__aarch64__)
+
+ci_inline int
+ci_ip_csum_neon_body(void* dest, const void* src, int n,
+                     ci_uint64* sum64, const int copy)
+{
+  uint64x2_t acc0 = vdupq_n_u64(0), acc1 = vdupq_n_u64(0);
+  int i;
+
+  for( i = 0; i + 32 <= n; i += 32 ) {
+    uint8x16_t a = LOAD_SRC(uint8_t, vld1q_u8, i);
+    uint8x16_t b = LOAD_SRC(uint8_t, vld1q_u8, i + 16);
+    STORE_DEST(uint8_t, vst1q_u8, i, a);
+    STORE_DEST(uint8_t, vst1q_u8, i + 16, b);
+    acc0 = vpadalq_u32(acc0, vreinterpretq_u32_u8(a));
+    acc1 = vpadalq_u32(acc1, vreinterpretq_u32_u8(b));
+  }
+  if( i + 16 <= n ) {
+    uint8x16_t a = LOAD_SRC(uint8_t, vld1q_u8, i);
+    STORE_DEST(uint8_t, vst1q_u8, i, a);
+    acc0 = vpadalq_u32(acc0, vreinterpretq_u32_u8(a));
+    i += 16;
+  }
+
+  *sum64 += vaddvq_u64(acc0) + vaddvq_u64(acc1);
+  return i;
+}
+
+static int
+ci_ip_csum_neon(void* dest, const void* src, int n, ci_uint64* sum64)
+{
+  if( dest != NULL )
+    return ci_ip_csum_neon_body(dest, src, n, sum64, 1);
+  else
+    return ci_ip_csum_neon_body(NULL, src, n, sum64, 0);
+}
+
+#endif /* __aarch64__ */
+
+
+struct ci_ip_csum_impl {
+  const char* name;
+  /* As for ci_cpu_has_feature(), or NULL if always available */
+  const char* feature;
+  ci_ip_csum_vec_fn fn;
+};
+
+/* Best first */
+static const struct ci_ip_csum_impl ci_ip_csum_impls[] = {
+#if defined(CI_HAVE_X86INTRIN)
+  { "avx512", "avx512f", ci_ip_csum_avx512 },
+  { "avx2",   "avx2",    ci_ip_csum_avx2 },
+  { "sse2",   "sse2",    ci_ip_csum_sse2 },
+#elif defined(__aarch64__)
+  { "neon",   NULL,      ci_ip_csum_neon },
+#endif
+  { "c",      NULL,      NULL },
+};
+
+#define N_IMPLS  (sizeof(ci_ip_csum_impls) / sizeof(ci_ip_csum_impls[0]))
+
+static const struct ci_ip_csum_impl* ci_ip_csum_impl;
+
+
+static int ci_ip_csum_impl_supported(const struct ci_ip_csum_impl* impl)
+{
+  return impl->feature == NULL ||
+         ci_cpu_has_feature((char*) impl->feature) != 0;
+}
+
+
+static const struct ci_ip_csum_impl* ci_ip_csum_impl_get(void)
+{
+  const struct ci_ip_csum_impl* impl = ci_ip_csum_impl;
+
+  /* Racing threads pick the same one, so no need for a lock. */
+  if(CI_UNLIKELY( impl == NULL )) {
+    for( impl = ci_ip_csum_impls; ! ci_ip_csum_impl_supported(impl); ++impl )
+      ;
+    ci_ip_csum_impl = impl;
+  }
+  return impl;
+}
+
+
+int ci_ip_csum_vec(void* dest, const void* src, int n, unsigned* sum)
+{
+  const struct ci_ip_csum_impl* impl = ci_ip_csum_impl_get();
+  ci_uint64 sum64 = 0;
+  int done;
+
+  ci_assert(src || n == 0);
+  ci_assert_ge(n, 0);
+
+  if( impl->fn == NULL )
+    return 0;
+  done = impl->fn(dest, src, n, &sum64);
+
+  /* 2^32 == 1 modulo 0xffff, so the high half folds onto the low one */
+  sum64 = (sum64 & 0xffffffff) + (sum64 >> 32);
+  sum64 = (sum64 & 0xffffffff) + (sum64 >> 32);
+  ci_add_carry32(*sum, (ci_uint32) sum64);
+  return done;
+}
+
+
+const char* ci_ip_csum_impl_name(int i)
+{
+  if( i < 0 || i >= N_IMPLS )
+    return NULL;
+  return ci_ip_csum_impls[i].name;
+}
+
+
+int ci_ip_csum_impl_select(const char* name)
+{
+  int i;
+
+  for( i = 0; i < N_IMPLS; ++i )
+    if( ! strcmp(ci_ip_csum_impls[i].name, name) ) {
+      if( ! ci_ip_csum_impl_supported(&ci_ip_csum_impls[i]) )
+        return -EOPNOTSUPP;
+      ci_ip_csum_impl = &ci_ip_csum_impls[i];
+      return 0;
+    }
+  return -ENOENT;
+}
+
+
+const char* ci_ip_csum_impl_selected(void)
+{
+  return ci_ip_csum_impl_get()->name;
+}
+
+/*! \cidoxg_end */
@@ -0,0 +1,793 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Software ef_vi backend: two VIs connected back-to-back through rings in
+ * POSIX shared memory.  See etherfabric/shm_vi.h for the user's view.
+ *
+ * A link holds two one-way "wires".  Wire i carries frames sent by end i,
+ * and is a single-producer single-consumer ring of fixed size frame slots.
+ * Frames are copied into the wire when they are transmitted and out of it
+ * into a posted RX buffer when the receiver polls, so the TX buffer can be
+ * completed straight away.
+ *
+ * The per-VI state that isn't shared lives in struct shm_vi, found through
+ * vi->evq_base as AF_XDP does with its ring offsets.
+ */
+
+#include "ef_vi_internal.h"
+#include "logging.h"
+#include <etherfabric/shm_vi.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#define SHM_LINK_MAGIC        0x65667368u  /* "efsh" */
+#define SHM_LINK_READY        2
+#define SHM_WIRE_FRAMES       1024u
+#define SHM_WIRE_MASK         (SHM_WIRE_FRAMES - 1)
+#define SHM_DEFAULT_Q_SIZE    512
+/* A frame held back for reordering goes out with the next frame, or after
+ * this long if there isn't one.
+ */
+#define SHM_REORDER_HOLD_NS   20000
+
+struct shm_frame {
+  uint64_t deliver_ns;
+  uint32_t len;
+  uint32_t reserved;
+  uint8_t  data[EF_SHM_VI_MAX_FRAME];
+};
+
+struct shm_wire {
+  /* Written by the producer */
+  volatile uint32_t prod;
+  uint32_t latency_ns;
+  uint32_t loss_ppm;
+  uint32_t reorder_ppm;
+  uint64_t tx_pkts;
+  uint64_t tx_lost;
+  uint64_t tx_reordered;
+  uint64_t tx_link_full;
+
+  /* Written by the consumer */
+  volatile uint32_t cons EF_VI_ALIGN(EF_VI_DMA_ALIGN);
+  uint64_t rx_pkts;
+  uint64_t rx_no_desc;
+
+  struct shm_frame frames[SHM_WIRE_FRAMES] EF_VI_ALIGN(EF_VI_DMA_ALIGN);
+};
+
+struct shm_link {
+  volatile uint32_t magic;
+  volatile uint32_t state;
+  /* pid of the process attached to each end, or 0 */
+  volatile int32_t  owner[2];
+  struct shm_wire   wire[2] EF_VI_ALIGN(EF_VI_DMA_ALIGN);
+};
+
+struct shm_vi {
+  struct shm_link*  link;
+  char*             link_name;
+  int               end;
+  struct shm_wire*  tx;
+  struct shm_wire*  rx;
+  /* Frames written to [tx], some of which may not be pushed yet */
+  uint32_t          tx_prod;
+  /* TX descriptors pushed, and those reported complete */
+  uint32_t          tx_pushed;
+  uint32_t          tx_completed;
+  uint64_t          rng;
+  /* Frame held back for reordering, if hold.len != 0 */
+  uint64_t          hold_until_ns;
+  struct shm_frame  hold;
+};
+
+
+static inline struct shm_vi* shm_vi(const ef_vi* vi)
+{
+  return (struct shm_vi*) vi->evq_base;
+}
+
+
+static inline uint64_t shm_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+/* xorshift64*: plenty for picking which frames to impair */
+static inline uint32_t shm_rand_ppm(struct shm_vi* sv)
+{
+  sv->rng ^= sv->rng >> 12;
+  sv->rng ^= sv->rng << 25;
+  sv->rng ^= sv->rng >> 27;
+  return ((sv->rng * 0x2545f4914f6cdd1dull) >> 32) % 1000000;
+}
+
+
+/**********************************************************************
+ * Transmit
+ */
+
+/* Put [f] on the wire if there is room.  It becomes visible to the
+ * receiver at the next shm_tx_publish().
+ */
+static void shm_tx_frame(struct shm_vi* sv, const struct shm_frame* f)
+{
+  struct shm_frame* slot;
+
+  if( sv->tx_prod - sv->tx->cons >= SHM_WIRE_FRAMES ) {
+    ++sv->tx->tx_link_full;
+    return;
+  }
+  slot = &sv->tx->frames[sv->tx_prod++ & SHM_WIRE_MASK];
+  slot->deliver_ns = f->deliver_ns;
+  slot->len = f->len;
+  memcpy(slot->data, f->data, f->len);
+  ++sv->tx->tx_pkts;
+}
+
+
+static void shm_tx_publish(struct shm_vi* sv)
+{
+  wmb();
+  sv->tx->prod = sv->tx_prod;
+}
+
+
+static void shm_tx_flush_hold(struct shm_vi* sv)
+{
+  shm_tx_frame(sv, &sv->hold);
+  sv->hold.len = 0;
+}
+
+
+static int shm_ef_vi_transmitv_init(ef_vi* vi, const ef_iovec* iov,
+                                    int iov_len, ef_request_id dma_id)
+{
+  struct shm_vi* sv = shm_vi(vi);
+  ef_vi_txq* q = &vi->vi_txq;
+  ef_vi_txq_state* qs = &vi->ep_state->txq;
+  struct shm_wire* w = sv->tx;
+  struct shm_frame* f;
+  uint32_t len = 0;
+  int i;
+
+  for( i = 0; i < iov_len; ++i )
+    len += iov[i].iov_len;
+  if( len > EF_SHM_VI_MAX_FRAME )
+    return -EINVAL;
+  if( qs->added - qs->removed >= q->mask )
+    return -EAGAIN;
+
+  i = qs->added++ & q->mask;
+  EF_VI_BUG_ON(q->ids[i] != EF_REQUEST_ID_MASK);
+  q->ids[i] = dma_id;
+
+  if( w->loss_ppm && shm_rand_ppm(sv) < w->loss_ppm ) {
+    ++w->tx_lost;
+    return 0;
+  }
+
+  /* Only one frame is held at a time, so reordering never moves a frame
+   * more than one place.
+   */
+  if( w->reorder_ppm && sv->hold.len == 0 &&
+      shm_rand_ppm(sv) < w->reorder_ppm ) {
+    f = &sv->hold;
+    ++w->tx_reordered;
+  }
+  else {
+    if( sv->tx_prod - w->cons >= SHM_WIRE_FRAMES ) {
+      ++w->tx_link_full;
+      return 0;
+    }
+    f = &w->frames[sv->tx_prod++ & SHM_WIRE_MASK];
+    ++w->tx_pkts;
+  }
+
+  f->deliver_ns = w->latency_ns ? shm_now_ns() + w->latency_ns : 0;
+  f->len = len;
+  len = 0;
+  for( i = 0; i < iov_len; ++i ) {
+    memcpy(f->data + len, (void*) (uintptr_t) iov[i].iov_base,
+           iov[i].iov_len);
+    len += iov[i].iov_len;
+  }
+
+  if( f == &sv->hold )
+    sv->hold_until_ns = shm_now_ns() + SHM_REORDER_HOLD_NS;
+  else if( sv->hold.len != 0 )
+    shm_tx_flush_hold(sv);
+  return 0;
+}
+
+
+static void shm_ef_vi_transmit_push(ef_vi* vi)
+{
+  struct shm_vi* sv = shm_vi(vi);
+  shm_tx_publish(sv);
+  sv->tx_pushed = vi->ep_state->txq.added;
+}
+
+
+static int shm_ef_vi_transmitv(ef_vi* vi, const ef_iovec* iov, int iov_len,
+                               ef_request_id dma_id)
+{
+  int rc = shm_ef_vi_transmitv_init(vi, iov, iov_len, dma_id);
+  if( rc == 0 )
+    shm_ef_vi_transmit_push(vi);
+  return rc;
+}
+
+
+static int shm_ef_vi_transmit(ef_vi* vi, ef_addr base, int len,
+                              ef_request_id dma_id)
+{
+  ef_iovec iov = { base, len };
+  return shm_ef_vi_transmitv(vi, &iov, 1, dma_id);
+}
+
+
+static int shm_ef_vi_transmit_pio(ef_vi* vi, int offset, int len,
+                                  ef_request_id dma_id)
+{
+  return -EOPNOTSUPP;
+}
+
+
+static int shm_ef_vi_transmit_copy_pio(ef_vi* vi, int offset,
+                                       const void* src_buf, int len,
+                                       ef_request_id dma_id)
+{
+  return -EOPNOTSUPP;
+}
+
+
+static void shm_ef_vi_transmit_pio_warm(ef_vi* vi)
+{
+}
+
+
+static void shm_ef_vi_transmit_copy_pio_warm(ef_vi* vi, int pio_offset,
+                                             const void* src_buf, int len)
+{
+}
+
+
+static void shm_ef_vi_transmitv_ctpio(ef_vi* vi, size_t frame_len,
+                                      const struct iovec* iov, int iovcnt,
+                                      unsigned threshold)
+{
+  /* Nothing to cut through to.  The fallback sends the frame. */
+}
+
+
+static void shm_ef_vi_transmitv_ctpio_copy(ef_vi* vi, size_t frame_len,
+                                           const struct iovec* iov,
+                                           int iovcnt, unsigned threshold,
+                                           void* fallback)
+{
+  int i;
+  for( i = 0; i < iovcnt; ++i ) {
+    memcpy(fallback, iov[i].iov_base, iov[i].iov_len);
+    fallback = (char*) fallback + iov[i].iov_len;
+  }
+}
+
+
+static int shm_ef_vi_transmit_ctpio_fallback(ef_vi* vi, ef_addr dma_addr,
+                                             size_t len, ef_request_id dma_id)
+{
+  return shm_ef_vi_transmit(vi, dma_addr, len, dma_id);
+}
+
+
+static int shm_ef_vi_transmitv_ctpio_fallback(ef_vi* vi,
+                                              const ef_iovec* dma_iov,
+                                              int dma_iov_len,
+                                              ef_request_id dma_id)
+{
+  return shm_ef_vi_transmitv(vi, dma_iov, dma_iov_len, dma_id);
+}
+
+
+static int shm_ef_vi_transmit_alt_select(ef_vi* vi, unsigned alt_id)
+{
+  return -EOPNOTSUPP;
+}
+
+
+static int shm_ef_vi_transmit_alt_select_normal(ef_vi* vi)
+{
+  return -EOPNOTSUPP;
+}
+
+
+static int shm_ef_vi_transmit_alt_stop(ef_vi* vi, unsigned alt_id)
+{
+  return -EOPNOTSUPP;
+}
+
+
+static int shm_ef_vi_transmit_alt_go(ef_vi* vi, unsigned alt_id)
+{
+  return -EOPNOTSUPP;
+}
+
+
+static int shm_ef_vi_transmit_alt_discard(ef_vi* vi, unsigned alt_id)
+{
+  return -EOPNOTSUPP;
+}
+
+
+static ssize_t shm_ef_vi_transmit_memcpy(struct ef_vi* vi,
+                                         const ef_remote_iovec* dst_iov,
+                                         int dst_iov_len,
+                                         const ef_remote_iovec* src_iov,
+                                         int src_iov_len)
+{
+  return -EOPNOTSUPP;
+}
+
+
+static int shm_ef_vi_transmit_memcpy_sync(struct ef_vi* vi,
+                                          ef_request_id dma_id)
+{
+  return -EOPNOTSUPP;
+}
+
+
+/**********************************************************************
+ * Receive
+ */
+
+static int shm_ef_vi_receive_init(ef_vi* vi, ef_addr addr,
+                                  ef_request_id dma_id)
+{
+  ef_vi_rxq* q = &vi->vi_rxq;
+  ef_vi_rxq_state* qs = &vi->ep_state->rxq;
+  ef_addr* dq = q->descriptors;
+  int i;
+
+  if( qs->added - qs->removed >= q->mask )
+    return -EAGAIN;
+
+  i = qs->added++ & q->mask;
+  EF_VI_BUG_ON(q->ids[i] != EF_REQUEST_ID_MASK);
+  q->ids[i] = dma_id;
+  dq[i] = addr;
+  return 0;
+}
+
+
+static void shm_ef_vi_receive_push(ef_vi* vi)
+{
+  /* Descriptors are private to this VI, so there is nothing to publish */
+}
+
+
+static int shm_ef_vi_receive_set_discards(ef_vi* vi,
+                                          unsigned discard_err_flags)
+{
+  return -EOPNOTSUPP;
+}
+
+
+static uint64_t shm_ef_vi_receive_get_discards(ef_vi* vi)
+{
+  return 0;
+}
+
+
+/**********************************************************************
+ * Events
+ */
+
+int ef_shm_eventq_check_event(const ef_vi* vi)
+{
+  struct shm_vi* sv = shm_vi(vi);
+
+  if( sv->tx_completed != sv->tx_pushed )
+    return 1;
+  if( sv->rx->cons == sv->rx->prod )
+    return 0;
+  /* Not ready until its delivery time.  This may well return true for a
+   * frame that will be dropped, which is allowed.
+   */
+  return sv->rx->frames[sv->rx->cons & SHM_WIRE_MASK].deliver_ns <=
+         shm_now_ns();
+}
+
+
+static int shm_ef_eventq_poll(ef_vi* vi, ef_event* evs, int evs_len)
+{
+  struct shm_vi* sv = shm_vi(vi);
+  struct shm_wire* w = sv->rx;
+  ef_vi_rxq* q = &vi->vi_rxq;
+  ef_vi_rxq_state* qs = &vi->ep_state->rxq;
+  ef_addr* dq = q->descriptors;
+  uint32_t cons, prod;
+  uint64_t now = 0;
+  int n = 0;
+
+  cons = w->cons;
+  prod = w->prod;
+  if( cons != prod ) {
+    ci_rmb();
+    do {
+      struct shm_frame* f = &w->frames[cons & SHM_WIRE_MASK];
+      unsigned desc_i;
+
+      if( f->deliver_ns != 0 ) {
+        if( now < f->deliver_ns )
+          now = shm_now_ns();
+        if( now < f->deliver_ns )
+          break;
+      }
+      ++cons;
+      if( qs->added == qs->removed ) {
+        ++w->rx_no_desc;
+        continue;
+      }
+
+      desc_i = qs->removed++ & q->mask;
+      if( f->len <= vi->rx_buffer_len ) {
+        memcpy((void*) (uintptr_t) dq[desc_i], f->data, f->len);
+        evs[n].rx.type = EF_EVENT_TYPE_RX;
+        evs[n].rx.q_id = 0;
+        evs[n].rx.rq_id = q->ids[desc_i];
+        evs[n].rx.len = f->len;
+        evs[n].rx.flags = EF_EVENT_FLAG_SOP;
+        evs[n].rx.ofs = 0;
+        ++w->rx_pkts;
+      }
+      else {
+        /* We don't scatter, so report it as hardware would a frame that
+         * overflowed its buffer with scatter disabled.
+         */
+        evs[n].rx_discard.type = EF_EVENT_TYPE_RX_DISCARD;
+        evs[n].rx_discard.q_id = 0;
+        evs[n].rx_discard.rq_id = q->ids[desc_i];
+        evs[n].rx_discard.len = f->len;
+        evs[n].rx_discard.flags = EF_EVENT_FLAG_SOP;
+        evs[n].rx_discard.subtype = EF_EVENT_RX_DISCARD_TRUNC;
+      }
+      q->ids[desc_i] = EF_REQUEST_ID_MASK;
+      ++n;
+    } while( cons != prod && n != evs_len );
+
+    /* The slots may be reused as soon as [cons] moves on */
+    ci_mb();
+    w->cons = cons;
+  }
+
+  if( sv->hold.len != 0 && shm_now_ns() >= sv->hold_until_ns ) {
+    shm_tx_flush_hold(sv);
+    shm_tx_publish(sv);
+  }
+
+  /* TX buffers were copied when they were sent, so complete everything
+   * that has been pushed.
+   */
+  while( n < evs_len && sv->tx_completed != sv->tx_pushed ) {
+    if( sv->tx_pushed - sv->tx_completed <= EF_VI_TRANSMIT_BATCH )
+      sv->tx_completed = sv->tx_pushed;
+    else
+      sv->tx_completed += EF_VI_TRANSMIT_BATCH;
+    evs[n].tx.type = EF_EVENT_TYPE_TX;
+    evs[n].tx.desc_id = sv->tx_completed;
+    evs[n].tx.flags = 0;
+    evs[n].tx.q_id = 0;
+    ++n;
+  }
+
+  return n;
+}
+
+
+static void shm_ef_eventq_prime(ef_vi* vi)
+{
+  /* No interrupts */
+}
+
+
+static void shm_ef_eventq_timer_prime(ef_vi* vi, unsigned v)
+{
+}
+
+
+static void shm_ef_eventq_timer_run(ef_vi* vi, unsigned v)
+{
+}
+
+
+static void shm_ef_eventq_timer_clear(ef_vi* vi)
+{
+}
+
+
+static void shm_ef_eventq_timer_zero(ef_vi* vi)
+{
+}
+
+
+void shm_vi_init(ef_vi* vi)
+{
+  vi->ops.transmit               = shm_ef_vi_transmit;
+  vi->ops.transmitv              = shm_ef_vi_transmitv;
+  vi->ops.transmitv_init         = shm_ef_vi_transmitv_init;
+  vi->ops.transmit_push          = shm_ef_vi_transmit_push;
+  vi->ops.transmit_pio           = shm_ef_vi_transmit_pio;
+  vi->ops.transmit_copy_pio      = shm_ef_vi_transmit_copy_pio;
+  vi->ops.transmit_pio_warm      = shm_ef_vi_transmit_pio_warm;
+  vi->ops.transmit_copy_pio_warm = shm_ef_vi_transmit_copy_pio_warm;
+  vi->ops.transmitv_ctpio        = shm_ef_vi_transmitv_ctpio;
+  vi->ops.transmitv_ctpio_copy   = shm_ef_vi_transmitv_ctpio_copy;
+  vi->ops.transmit_alt_select    = shm_ef_vi_transmit_alt_select;
+  vi->ops.transmit_alt_select_default = shm_ef_vi_transmit_alt_select_normal;
+  vi->ops.transmit_alt_stop      = shm_ef_vi_transmit_alt_stop;
+  vi->ops.transmit_alt_go        = shm_ef_vi_transmit_alt_go;
+  vi->ops.receive_set_discards   = shm_ef_vi_receive_set_discards;
+  vi->ops.receive_get_discards   = shm_ef_vi_receive_get_discards;
+  vi->ops.transmit_alt_discard   = shm_ef_vi_transmit_alt_discard;
+  vi->ops.receive_init           = shm_ef_vi_receive_init;
+  vi->ops.receive_push           = shm_ef_vi_receive_push;
+  vi->ops.eventq_poll            = shm_ef_eventq_poll;
+  vi->ops.eventq_prime           = shm_ef_eventq_prime;
+  vi->ops.eventq_timer_prime     = shm_ef_eventq_timer_prime;
+  vi->ops.eventq_timer_run       = shm_ef_eventq_timer_run;
+  vi->ops.eventq_timer_clear     = shm_ef_eventq_timer_clear;
+  vi->ops.eventq_timer_zero      = shm_ef_eventq_timer_zero;
+  vi->ops.transmit_memcpy        = shm_ef_vi_transmit_memcpy;
+  vi->ops.transmit_memcpy_sync   = shm_ef_vi_transmit_memcpy_sync;
+  vi->ops.transmit_ctpio_fallback = shm_ef_vi_transmit_ctpio_fallback;
+  vi->ops.transmitv_ctpio_fallback = shm_ef_vi_transmitv_ctpio_fallback;
+
+  vi->rx_buffer_len = EF_SHM_VI_MAX_FRAME;
+  vi->rx_prefix_len = 0;
+  vi->evq_phase_bits = 1; /* We set this flag for ef_eventq_has_event */
+}
+
+
+/**********************************************************************
+ * Link management
+ */
+
+static unsigned shm_getenv_uint(const char* name)
+{
+  const char* s = getenv(name);
+  return s ? strtoul(s, NULL, 0) : 0;
+}
+
+
+void ef_shm_attr_init(struct ef_shm_attr* attr)
+{
+  attr->latency_ns = shm_getenv_uint("EF_SHM_LATENCY_NS");
+  attr->loss_ppm = shm_getenv_uint("EF_SHM_LOSS_PPM");
+  attr->reorder_ppm = shm_getenv_uint("EF_SHM_REORDER_PPM");
+  attr->seed = shm_getenv_uint("EF_SHM_SEED");
+}
+
+
+/* Map the link, creating and initialising it if we're first.  Everyone
+ * sizes the object identically, and exactly one attacher wins the right to
+ * initialise it; the others wait for it to become ready.
+ */
+static int shm_link_map(const char* name, struct shm_link** link_out)
+{
+  struct shm_link* link;
+  int fd, i;
+
+  fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+  if( fd < 0 )
+    return -errno;
+  if( ftruncate(fd, sizeof(*link)) < 0 ) {
+    int rc = -errno;
+    close(fd);
+    return rc;
+  }
+  link = mmap(NULL, sizeof(*link), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if( link == MAP_FAILED )
+    return -errno;
+
+  if( __sync_bool_compare_and_swap(&link->state, 0, 1) ) {
+    /* A fresh object is zero-filled, which is all the rings need */
+    wmb();
+    link->magic = SHM_LINK_MAGIC;
+    wmb();
+    link->state = SHM_LINK_READY;
+  }
+  for( i = 0; link->state != SHM_LINK_READY; ++i ) {
+    if( i == 1000 ) {
+      LOG(ef_log("%s: link '%s' never became ready", __FUNCTION__, name));
+      munmap(link, sizeof(*link));
+      return -ETIMEDOUT;
+    }
+    usleep(1000);
+  }
+  ci_rmb();
+  if( link->magic != SHM_LINK_MAGIC ) {
+    munmap(link, sizeof(*link));
+    return -EINVAL;
+  }
+
+  *link_out = link;
+  return 0;
+}
+
+
+/* Take ownership of one end.  An end left behind by a process that has
+ * gone away may be reclaimed.
+ */
+static int shm_link_claim(struct shm_link* link, int end)
+{
+  int32_t me = getpid();
+  int32_t owner;
+
+  while( 1 ) {
+    owner = link->owner[end];
+    if( owner != 0 && owner != me && kill(owner, 0) == 0 )
+      return -EBUSY;
+    if( owner == me )
+      return -EBUSY;
+    if( __sync_bool_compare_and_swap(&link->owner[end], owner, me) )
+      return 0;
+  }
+}
+
+
+static int shm_q_size(int capacity)
+{
+  int size = 1;
+  if( capacity < 0 )
+    return SHM_DEFAULT_Q_SIZE;
+  while( size < capacity + 1 )
+    size <<= 1;
+  return size;
+}
+
+
+int ef_shm_vi_alloc(ef_vi* vi, const char* link_name, int end,
+                    const struct ef_shm_attr* attr,
+                    int rxq_capacity, int txq_capacity,
+                    enum ef_vi_flags flags)
+{
+  const enum ef_vi_flags unsupported =
+    EF_VI_RX_TIMESTAMPS | EF_VI_TX_TIMESTAMPS | EF_VI_TX_ALT |
+    EF_VI_RX_PACKED_STREAM | EF_VI_RX_EVENT_MERGE;
+  struct ef_shm_attr default_attr;
+  struct shm_vi* sv;
+  ef_vi_state* state;
+  ef_addr* rx_descs;
+  uint32_t* ids;
+  int rxq_size = shm_q_size(rxq_capacity);
+  int txq_size = shm_q_size(txq_capacity);
+  int rc;
+
+  if( end != 0 && end != 1 )
+    return -EINVAL;
+  if( flags & unsupported ) {
+    LOGVV(ef_log("%s: ERROR: flags %x not supported on shared memory links",
+                 __FUNCTION__, flags & unsupported));
+    return -EOPNOTSUPP;
+  }
+  if( attr == NULL ) {
+    ef_shm_attr_init(&default_attr);
+    attr = &default_attr;
+  }
+
+  sv = calloc(1, sizeof(*sv));
+  state = calloc(1, ef_vi_calc_state_bytes(rxq_size, txq_size));
+  rx_descs = calloc(rxq_size, sizeof(*rx_descs));
+  if( sv == NULL || state == NULL || rx_descs == NULL ||
+      (sv->link_name = strdup(link_name)) == NULL ) {
+    rc = -ENOMEM;
+    goto fail;
+  }
+  if( (rc = shm_link_map(link_name, &sv->link)) < 0 )
+    goto fail;
+  if( (rc = shm_link_claim(sv->link, end)) < 0 ) {
+    munmap(sv->link, sizeof(*sv->link));
+    goto fail;
+  }
+
+  sv->end = end;
+  sv->tx = &sv->link->wire[end];
+  sv->rx = &sv->link->wire[!end];
+  /* Impairments belong to the sending side of each wire.  Anything left in
+   * our RX wire was meant for a previous incarnation of this end.
+   */
+  sv->tx->latency_ns = attr->latency_ns;
+  sv->tx->loss_ppm = attr->loss_ppm;
+  sv->tx->reorder_ppm = attr->reorder_ppm;
+  sv->tx_prod = sv->tx->prod;
+  sv->rx->cons = sv->rx->prod;
+  sv->rng = ((uint64_t) attr->seed << 1) | 1;
+
+  ef_vi_init(vi, EF_VI_ARCH_SHM, 0, 0, flags, 0, state);
+  ef_vi_init_evq(vi, 1, (char*) sv);
+  ids = (void*) (state + 1);
+  ef_vi_init_rxq(vi, rxq_size, rx_descs, ids, 0);
+  ef_vi_init_txq(vi, txq_size, NULL, ids + rxq_size);
+  vi->rx_buffer_len = EF_SHM_VI_MAX_FRAME;
+  vi->vi_i = end;
+  ef_vi_init_state(vi);
+  ef_vi_add_queue(vi, vi);
+  return 0;
+
+ fail:
+  if( sv != NULL )
+    free(sv->link_name);
+  free(rx_descs);
+  free(state);
+  free(sv);
+  return rc;
+}
+
+
+void ef_shm_vi_free(ef_vi* vi)
+{
+  struct shm_vi* sv = shm_vi(vi);
+  struct shm_link* link = sv->link;
+
+  link->owner[sv->end] = 0;
+  ci_mb();
+  if( link->owner[!sv->end] == 0 )
+    shm_unlink(sv->link_name);
+  munmap(link, sizeof(*link));
+  free(sv->link_name);
+  free(vi->vi_rxq.descriptors);
+  free(vi->ep_state);
+  free(sv);
+  memset(vi, 0, sizeof(*vi));
+}
+
+
+void ef_shm_vi_get_stats(ef_vi* vi, struct ef_shm_vi_stats* stats)
+{
+  struct shm_vi* sv = shm_vi(vi);
+
+  stats->tx_pkts = sv->tx->tx_pkts;
+  stats->tx_lost = sv->tx->tx_lost;
+  stats->tx_reordered = sv->tx->tx_reordered;
+  stats->tx_link_full = sv->tx->tx_link_full;
+  stats->rx_pkts = sv->rx->rx_pkts;
+  stats->rx_no_desc = sv->rx->rx_no_desc;
+}
+
+
+int ef_shm_memreg_init(ef_memreg* mr, void* p_mem, size_t len_bytes)
+{
+  size_t i, n_pages = (len_bytes + EF_VI_NIC_PAGE_SIZE - 1) >>
+                      EF_VI_NIC_PAGE_SHIFT;
+
+  EF_VI_BUG_ON(((uintptr_t) p_mem & (EF_VI_NIC_PAGE_SIZE - 1)) != 0);
+  mr->mr_dma_addrs = malloc(n_pages * sizeof(ef_addr));
+  if( mr->mr_dma_addrs == NULL )
+    return -ENOMEM;
+  mr->mr_dma_addrs_base = mr->mr_dma_addrs;
+  for( i = 0; i < n_pages; ++i )
+    mr->mr_dma_addrs[i] = (uintptr_t) p_mem + (i << EF_VI_NIC_PAGE_SHIFT);
+  return 0;
+}
+
+
+void ef_shm_memreg_fini(ef_memreg* mr)
+{
+  free(mr->mr_dma_addrs_base);
+  mr->mr_dma_addrs = mr->mr_dma_addrs_base = NULL;
+}
@@ -202,6 +202,7 @@ static int tx_fifo_bytes(struct ef_vi* vi)
   case EF_VI_ARCH_EF10:
   case EF_VI_ARCH_EF100:
   case EF_VI_ARCH_AF_XDP:
+  case EF_VI_ARCH_SHM:
     /* No FIFO, so return a large number to indicate no limit */
     return INT_MAX;
   case EF_VI_ARCH_EFCT:
@@ -263,6 +264,11 @@ int ef_vi_init(struct ef_vi* vi, int arch, int variant, int revision,
   case EF_VI_ARCH_AF_XDP:
     efxdp_vi_init(vi);
     break;
+#ifndef __KERNEL__
+  case EF_VI_ARCH_SHM:
+    shm_vi_init(vi);
+    break;
+#endif
   default:
     return -EINVAL;
   }
@@ -294,7 +294,7 @@ static int oo_bufpage_init(struct oo_buffer_pages **pages_out,
 
 static int oo_bufpage_alloc(struct oo_buffer_pages **pages_out,
                             int user_order, int low_order, int min_nic_order,
-                            int *flags, int gfp_flag)
+                            int numa_node, int *flags, int gfp_flag)
 {
   struct oo_buffer_pages *pages;
   int n_bufs = 1 << (user_order - low_order);
@@ -333,7 +333,7 @@ static int oo_bufpage_alloc(struct oo_buffer_pages **pages_out,
   }
 
   for( i = 0; i < n_bufs; ++i ) {
-    pages->pages[i] = alloc_pages_node(numa_node_id(), gfp_flag, low_order);
+    pages->pages[i] = alloc_pages_node(numa_node, gfp_flag, low_order);
     if( pages->pages[i] == NULL ) {
       OO_DEBUG_VERB(ci_log("%s: failed to allocate page (i=%u) "
                            "user_order=%d page_order=%d",
@@ -358,8 +358,8 @@ void oo_iobufset_pages_release(struct oo_buffer_pages *pages)
 }
 
 int
-oo_iobufset_pages_alloc(int nic_order, int min_nic_order, int *flags,
-                        struct oo_buffer_pages **pages_out)
+oo_iobufset_pages_alloc(int nic_order, int min_nic_order, int numa_node,
+                        int *flags, struct oo_buffer_pages **pages_out)
 {
   int rc;
   int gfp_flag = (in_atomic() || in_interrupt()) ? GFP_ATOMIC : GFP_KERNEL;
@@ -372,8 +372,8 @@ oo_iobufset_pages_alloc(int nic_order, int min_nic_order, int *flags,
 #if CI_CFG_PKTS_AS_HUGE_PAGES
   if( *flags & OO_IOBUFSET_FLAG_HUGE_PAGE_FORCE ) {
 # ifdef OO_DO_HUGE_PAGES
-    rc = oo_bufpage_alloc(pages_out, order, order, min_order, flags,
-                          gfp_flag);
+    rc = oo_bufpage_alloc(pages_out, order, order, min_order, numa_node,
+                          flags, gfp_flag);
 # else
     rc = -ENOMEM;
 # endif
@@ -397,11 +397,12 @@ oo_iobufset_pages_alloc(int nic_order, int min_nic_order, int *flags,
     else
       low_order = HPAGE_SHIFT - PAGE_SHIFT;
 
-    rc = oo_bufpage_alloc(pages_out, order, low_order, min_order, flags,
-                          gfp_flag);
+    rc = oo_bufpage_alloc(pages_out, order, low_order, min_order, numa_node,
+                          flags, gfp_flag);
 
     if( rc != 0 && low_order != 0 )
-      rc = oo_bufpage_alloc(pages_out, order, 0, min_order, flags, gfp_flag);
+      rc = oo_bufpage_alloc(pages_out, order, 0, min_order, numa_node,
+                            flags, gfp_flag);
   }
 
   if( rc == -EMSGSIZE ) {
@@ -2396,7 +2396,7 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
    * for the sockets).  These pages get zeroed, so all fields in the shared
    * state can be assumed to have been zero-initialised. */
   rc = oo_shmbuf_alloc(&ni->shmbuf, OO_SHARED_BUFFER_CHUNK_ORDER, i,
-                       sz / OO_SHARED_BUFFER_CHUNK_SIZE);
+                       sz / OO_SHARED_BUFFER_CHUNK_SIZE, trs->numa_node);
   if( rc < 0 ) {
     OO_DEBUG_ERR(ci_log("%s: failed to alloc shmbuf for shared state and "
                         "socket buffers (%d)", __FUNCTION__, rc));
@@ -2416,6 +2416,7 @@ allocate_netif_resources(ci_resource_onload_alloc_t* alloc,
 #endif
   ns->n_ep_bufs = 0;
   ns->nic_n = trs->netif.nic_n;
+  ns->alloc_numa_node = trs->numa_node;
 
 #if CI_CFG_UL_INTERRUPT_HELPER
   ns->n_ep_orphaned = OO_N_EP_ORPHANED_INIT;
@@ -3208,6 +3209,42 @@ static int oo_get_nics(tcp_helper_resource_t* trs, int ifindices_len)
 }
 
 
+/* Returns the node to allocate the stack's memory on, as chosen by
+ * EF_NUMA_NODE, or NUMA_NO_NODE to leave it to the allocating thread.
+ * Must be called after oo_get_nics().
+ */
+static int tcp_helper_numa_node(tcp_helper_resource_t* trs)
+{
+  ci_netif* ni = &trs->netif;
+  int node = NI_OPTS(ni).numa_node;
+  struct device* dev;
+  int intf_i;
+
+  if( node >= 0 ) {
+    if( node < MAX_NUMNODES && node_online(node) )
+      return node;
+    ci_log("%s: EF_NUMA_NODE=%d is not an online node, ignoring it",
+           __FUNCTION__, node);
+    return NUMA_NO_NODE;
+  }
+  if( node != CITP_NUMA_NODE_NIC )
+    return NUMA_NO_NODE;
+
+  node = NUMA_NO_NODE;
+  OO_STACK_FOR_EACH_INTF_I(ni, intf_i) {
+    dev = efhw_nic_get_dev(
+                efrm_client_get_nic(trs->nic[intf_i].thn_oo_nic->efrm_client));
+    if( dev == NULL )
+      continue;
+    node = dev_to_node(dev);
+    put_device(dev);
+    if( node != NUMA_NO_NODE )
+      break;
+  }
+  return node;
+}
+
+
 ci_inline void efab_notify_stacklist_change(tcp_helper_resource_t *thr)
 {
   /* here we should notify tcpdump process that the stack list have
@@ -4455,6 +4492,7 @@ int tcp_helper_rm_alloc(ci_resource_onload_alloc_t* alloc,
   rc = oo_get_nics(rs, ifindices_len);
   if( rc < 0 )
     goto fail2;
+  rs->numa_node = tcp_helper_numa_node(rs);
 
   /* Allocate an instance number. */
   ci_irqlock_lock(&THR_TABLE.lock, &lock_flags);
@@ -6156,8 +6194,6 @@ install_socks(tcp_helper_resource_t* trs, unsigned id, int num)
     if( eps[i] )
       ci_free(eps[i]);
   vfree(eps);
-
-  trs->netif.state->sock_alloc_numa_nodes |= 1 << numa_node_id();
   return 0;
 }
 
@@ -6165,7 +6201,7 @@ install_socks(tcp_helper_resource_t* trs, unsigned id, int num)
 int efab_tcp_helper_more_socks(tcp_helper_resource_t* trs)
 {
   ci_netif* ni = &trs->netif;
-  int rc;
+  int rc, node;
 
   if( ni->ep_tbl_n >= ni->ep_tbl_max )  return -ENOSPC;
 
@@ -6180,9 +6216,13 @@ int efab_tcp_helper_more_socks(tcp_helper_resource_t* trs)
     OO_DEBUG_ERR(ci_log("%s: demand failed (%d)", __FUNCTION__, rc));
     return rc;
   }
+  node = page_to_nid(vmalloc_to_page(oo_shmbuf_idx2ptr(&ni->shmbuf, rc)));
 
-  return install_socks(trs, ni->ep_tbl_n,
-                       EP_BUF_PER_PAGE << OO_SHARED_BUFFER_CHUNK_ORDER);
+  rc = install_socks(trs, ni->ep_tbl_n,
+                     EP_BUF_PER_PAGE << OO_SHARED_BUFFER_CHUNK_ORDER);
+  if( rc == 0 )
+    ni->state->sock_alloc_numa_nodes |= 1 << node;
+  return rc;
 }
 
 
@@ -6338,8 +6378,8 @@ efab_tcp_helper_iobufset_alloc(tcp_helper_resource_t* trs,
 #endif
   }
 #endif
-  rc = oo_iobufset_pages_alloc(HW_PAGES_PER_SET_S, min_nics_order, &flags,
-                               &pages);
+  rc = oo_iobufset_pages_alloc(HW_PAGES_PER_SET_S, min_nics_order,
+                               trs->numa_node, &flags, &pages);
   if( rc != 0 )
     return rc;
 #if CI_CFG_PKTS_AS_HUGE_PAGES
@@ -6777,6 +6817,9 @@ efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs)
   else
     page_order += ci_log2_ge(PAGE_SIZE / CI_CFG_PKT_BUF_SIZE, 0);
   ni->packets->set[bufset_id].page_order = page_order;
+  /* The page allocator falls back to other nodes, so the set may not be
+   * where we asked. */
+  ni->packets->set[bufset_id].numa_node = page_to_nid(pages->pages[0]);
   ni->dma_addr_next += (PKTS_PER_SET >> page_order) * CI_CFG_MAX_INTERFACES;
   ni->packets->n_free += PKTS_PER_SET;
 
@@ -6804,7 +6847,8 @@ efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs)
   }
   ci_vfree(hw_addrs);
 
-  trs->netif.state->packet_alloc_numa_nodes |= 1 << numa_node_id();
+  trs->netif.state->packet_alloc_numa_nodes |=
+                                  1 << ni->packets->set[bufset_id].numa_node;
   CHECK_FREEPKTS(ni);
   return 0;
 }
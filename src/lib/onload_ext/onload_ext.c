@@ -147,6 +147,14 @@ int onload_zc_recv(int fd, struct onload_zc_recv_args* args)
   return -ENOSYS;
 }
 
+__attribute__((weak))
+int onload_zc_recv_batch(const int* fds, int nfds,
+                         struct onload_zc_recv_batch_msg* msgs, int max_msgs,
+                         struct onload_zc_iovec* iov, int iov_len, int flags)
+{
+  return -ENOSYS;
+}
+
 __attribute__((weak))
 int onload_zc_send(struct onload_zc_mmsg* msgs, int mlen, int flags)
 {
@@ -280,6 +288,20 @@ int onload_move_fd(int fd)
   return 0;
 }
 
+__attribute__((weak))
+int onload_accept_batch(int fd, struct onload_accept_batch_msg* msgs,
+                        int max_msgs, int flags)
+{
+  return -ENOSYS;
+}
+
+__attribute__((weak))
+int onload_accept_batchv(struct onload_accept_batch_vec* vec, int vlen,
+                         int flags)
+{
+  return -ENOSYS;
+}
+
 
 /**************************************************************************/
 
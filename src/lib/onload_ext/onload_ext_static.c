@@ -173,6 +173,12 @@ wrap(int, onload_zc_buffer_decref, (int fd, onload_zc_handle buf),
 wrap(int, onload_zc_recv, (int fd, struct onload_zc_recv_args* args),
      (fd, args), -ENOSYS)
 
+wrap(int, onload_zc_recv_batch, (const int* fds, int nfds,
+                                 struct onload_zc_recv_batch_msg* msgs,
+                                 int max_msgs, struct onload_zc_iovec* iov,
+                                 int iov_len, int flags),
+     (fds, nfds, msgs, max_msgs, iov, iov_len, flags), -ENOSYS)
+
 wrap(int, onload_zc_send, (struct onload_zc_mmsg* msgs, int mlen, int flags),
      (msgs, mlen, flags), -ENOSYS)
 
@@ -230,6 +236,14 @@ wrap(int, onload_thread_get_spin, (unsigned* state), (state), -ENOSYS)
 
 wrap(int, onload_move_fd, (int fd), (fd), 0)
 
+wrap(int, onload_accept_batch, (int fd, struct onload_accept_batch_msg* msgs,
+                                int max_msgs, int flags),
+     (fd, msgs, max_msgs, flags), -ENOSYS)
+
+wrap(int, onload_accept_batchv, (struct onload_accept_batch_vec* vec,
+                                 int vlen, int flags),
+     (vec, vlen, flags), -ENOSYS)
+
 wrap( int, onload_fd_check_feature, (int fd, enum onload_fd_feature feature),
      (fd, feature), -ENOSYS)
 
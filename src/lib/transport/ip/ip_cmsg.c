@@ -15,6 +15,7 @@
 
 #include "ip_internal.h"
 #include <ci/internal/ip_timestamp.h>
+#include <ci/net/sockopts.h>
 
 
 #define LPF "IP CMSG "
@@ -435,6 +436,30 @@ void ci_ip_cmsg_recv(ci_netif* ni, ci_udp_state* us, const ci_ip_pkt_fmt *pkt,
   ci_ip_cmsg_finish(&cmsg_state);
 }
 
+
+void ci_ip_cmsg_recv_gro(struct msghdr *msg, socklen_t controllen,
+                         int gso_size, int *p_msg_flags)
+{
+  struct cmsg_state cmsg_state;
+
+  cmsg_state.msg = msg;
+  cmsg_state.cmsg_bytes_used = msg->msg_controllen;
+  cmsg_state.p_msg_flags = p_msg_flags;
+
+  /* Pick up where ci_ip_cmsg_recv() left off. */
+  msg->msg_controllen = controllen;
+  if( cmsg_state.cmsg_bytes_used == 0 )
+    cmsg_state.cm = CMSG_FIRSTHDR(msg);
+  else if( cmsg_state.cmsg_bytes_used + sizeof(struct cmsghdr) <= controllen )
+    cmsg_state.cm = (struct cmsghdr*) ((char*) msg->msg_control +
+                                       cmsg_state.cmsg_bytes_used);
+  else
+    cmsg_state.cm = NULL;
+
+  ci_put_cmsg(&cmsg_state, IPPROTO_UDP, CI_UDP_GRO, sizeof(gso_size), &gso_size);
+  ci_ip_cmsg_finish(&cmsg_state);
+}
+
 #endif /* !__KERNEL__ */
 
 
@@ -444,7 +469,8 @@ void ci_ip_cmsg_recv(ci_netif* ni, ci_udp_state* us, const ci_ip_pkt_fmt *pkt,
  * \param info_out    Must be a valid pointer. Contains a pointer to
  * struct in_pktinfo or struct in6_pktinfo.
  */
-int ci_ip_cmsg_send(const struct msghdr* msg, void** info_out)
+int ci_ip_cmsg_send(const struct msghdr* msg, void** info_out,
+                    ci_uint32* gso_size_out)
 {
   struct cmsghdr *cmsg;
 
@@ -483,6 +509,15 @@ int ci_ip_cmsg_send(const struct msghdr* msg, void** info_out)
       else
         return -EINVAL;
     }
+    else if( cmsg->cmsg_level == IPPROTO_UDP ) {
+      if( cmsg->cmsg_type == CI_UDP_SEGMENT ) {
+        if( cmsg->cmsg_len != CMSG_LEN(sizeof(ci_uint16)) )
+          return -EINVAL;
+        *gso_size_out = *(ci_uint16*) CMSG_DATA(cmsg);
+      }
+      else
+        return -EINVAL;
+    }
   }
 
   return 0;
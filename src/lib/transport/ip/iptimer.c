@@ -152,33 +152,38 @@ void ci_ip_timer_state_init(ci_netif* netif, unsigned cpu_khz)
 /* insert a non-pending timer into the scheduler */
 void __ci_ip_timer_set(ci_netif *netif, ci_ip_timer *ts, ci_iptime_t t)
 {
+  ci_ip_timer_state* ipts = IPTIMER_STATE(netif);
   struct oo_p_dllink_state bucket;
   int w;
-  ci_iptime_t stime = IPTIMER_STATE(netif)->sched_ticks;
+  ci_iptime_t stime = ipts->sched_ticks;
+  ci_iptime_t next = IPTIMER_NEXT_ROTATION(stime);
 
   ci_assert(TIME_GT(t, stime));
   /* this is absolute time */
   ts->time = t;
+  ts->defer = 0;
 
-  if( TIME_LT(t, IPTIMER_STATE(netif)->closest_timer) )
-    IPTIMER_STATE(netif)->closest_timer = t;
+  if( TIME_LT(t, ipts->closest_timer) )
+    ipts->closest_timer = t;
 
   /* Previous error in this code was to choose wheel based on time delta 
    * before timer fires (ts->time - stime). This is bogus as the timer wheels
    * work like a clock and we need to find wheel based on the absolute time
    */
 
-  /* insert in wheel 0 if the top 3 wheels have the same time */
-  if ((stime & IPTIMER_WHEEL0_MASK) == (t & IPTIMER_WHEEL0_MASK)) {
+  /* insert in wheel 0 if due in the current or the next rotation */
+  if( TIME_LT(t, next + CI_IPTIME_BUCKETS) ) {
     w = 0;
     __ci_timer_busy_set(netif, t);
   }
-  /* else, insert in wheel 1 if the top 2 wheels have the same time */
-  else if ((stime & IPTIMER_WHEEL1_MASK) == (t & IPTIMER_WHEEL1_MASK)) {
+  /* else, insert in wheel 1 if the top 2 wheels have the same time as the
+   * next rotation */
+  else if ((next & IPTIMER_WHEEL1_MASK) == (t & IPTIMER_WHEEL1_MASK)) {
     w = 1;
+    ++ipts->cascade_count[IPTIMER_BUCKETNO(1, t)];
   }
   /* else, insert in wheel 2 if the top wheel has the same time */
-  else if ((stime & IPTIMER_WHEEL2_MASK) == (t & IPTIMER_WHEEL2_MASK)) {
+  else if ((next & IPTIMER_WHEEL2_MASK) == (t & IPTIMER_WHEEL2_MASK)) {
     w = 2;
   }
   else {
@@ -206,6 +211,10 @@ void __ci_ip_timer_set(ci_netif *netif, ci_ip_timer *ts, ci_iptime_t t)
 
 /* take the bucket corresponding to time t in the given wheel and 
 ** reinsert them back into the wheel (i.e. into wheelno -1)
+**
+** Only used for wheels 2 and 3, which cascade at most once every 256
+** rotations; wheel 1 is cascaded incrementally by ci_ip_timer_cascade_next().
+** Returns the number of timers moved.
 */
 static int ci_ip_timer_cascadewheel(ci_netif* netif, int wheelno,
 				     ci_iptime_t stime)
@@ -214,9 +223,9 @@ static int ci_ip_timer_cascadewheel(ci_netif* netif, int wheelno,
   struct oo_p_dllink_state bucket;
   struct oo_p_dllink_state cur;
   oo_p lastp;
-  int changed = 0;
+  int n = 0;
 
-  ci_assert(wheelno > 0 && wheelno < CI_IPTIME_WHEELS);
+  ci_assert(wheelno > 1 && wheelno < CI_IPTIME_WHEELS);
   /* check time is on the boundary expected by the wheel number passed in */
   ci_assert( (stime & ((unsigned)(-1) << (CI_IPTIME_BUCKETBITS*wheelno))) == stime );
 
@@ -239,13 +248,8 @@ static int ci_ip_timer_cascadewheel(ci_netif* netif, int wheelno,
 
 #ifndef NDEBUG
     {
-      /* if inserting in wheel 0 - top 3 wheels must have the same time */
-      if (wheelno == 1) {
-        ci_assert_equal(stime & IPTIMER_WHEEL0_MASK,
-                        ts->time & IPTIMER_WHEEL0_MASK);
-      }
-      /* else, if inserting in wheel 1 - top 2 wheels must have the same time */
-      else if (wheelno == 2) {
+      /* if inserting in wheel 1 - top 2 wheels must have the same time */
+      if (wheelno == 2) {
         ci_assert_equal(stime & IPTIMER_WHEEL1_MASK,
                         ts->time & IPTIMER_WHEEL1_MASK);
       }
@@ -260,7 +264,7 @@ static int ci_ip_timer_cascadewheel(ci_netif* netif, int wheelno,
 
     /* insert ts into wheel below */
     bucket = IPTIMER_BUCKET(netif, wheelno-1, ts->time);
-    changed = 1;
+    ++n;
 
     /* append onto the correct bucket 
     **
@@ -270,10 +274,75 @@ static int ci_ip_timer_cascadewheel(ci_netif* netif, int wheelno,
     */
     oo_p_dllink_add_tail(netif, bucket, oo_p_dllink_statep(netif, ts->statep));
 
-    if( wheelno == 1 )
+    if( wheelno == 2 )
+      ++IPTIMER_STATE(netif)->cascade_count[IPTIMER_BUCKETNO(1, ts->time)];
+  }
+  return n;
+}
+
+
+/* Move up to [max] timers from the wheel1 bucket holding the rotation that
+** starts at [next] into wheel0.  Returns the number of timers moved.
+*/
+static int ci_ip_timer_cascade_next(ci_netif* netif, ci_iptime_t next,
+                                    int max)
+{
+  ci_ip_timer_state* ipts = IPTIMER_STATE(netif);
+  struct oo_p_dllink_state bucket = IPTIMER_BUCKET(netif, 1, next);
+  struct oo_p_dllink_state link;
+  ci_ip_timer* ts;
+  int n = 0;
+
+  while( n < max && ! oo_p_dllink_is_empty(netif, bucket) ) {
+    link = oo_p_dllink_statep(netif, bucket.l->next);
+    oo_p_dllink_del(netif, link);
+    ts = LINK2TIMER(link.l);
+    ci_assert_equal(next & IPTIMER_WHEEL0_MASK, ts->time & IPTIMER_WHEEL0_MASK);
+
+    if( ts->defer ) {
+      /* Pushed back since it was queued: fold that in while we're here. */
+      __ci_ip_timer_set(netif, ts, ts->time + ts->defer);
+    }
+    else {
+      oo_p_dllink_add_tail(netif, IPTIMER_BUCKET(netif, 0, ts->time), link);
       __ci_timer_busy_set(netif, ts->time);
+    }
+    ++n;
   }
-  return changed;
+
+  ipts->cascade_left -= CI_MIN((ci_uint32) n, ipts->cascade_left);
+  return n;
+}
+
+
+/* Called as the scheduler enters the rotation starting at [stime].  Any
+** part of this rotation that has not yet been cascaded into wheel0 has to
+** be done now; then we begin on the next one.  Returns the number of timers
+** moved.
+*/
+static int ci_ip_timer_rotate(ci_netif* netif, ci_iptime_t stime)
+{
+  ci_ip_timer_state* ipts = IPTIMER_STATE(netif);
+  ci_iptime_t next = stime + CI_IPTIME_BUCKETS;
+  int b1 = IPTIMER_BUCKETNO(1, next);
+  int n;
+
+  ci_assert_equal(IPTIMER_BUCKETNO(0, stime), 0);
+
+  n = ci_ip_timer_cascade_next(netif, stime, INT_MAX);
+  CITP_STATS_NETIF_ADD(netif, timer_cascade_forced, n);
+
+  if( b1 == 0 ) {
+    if( IPTIMER_BUCKETNO(2, next) == 0 )
+      n += ci_ip_timer_cascadewheel(netif, 3, next);
+    n += ci_ip_timer_cascadewheel(netif, 2, next);
+  }
+
+  ipts->cascade_left = ipts->cascade_count[b1];
+  ipts->cascade_count[b1] = 0;
+  if( ipts->cascade_left != 0 )
+    CITP_STATS_NETIF_INC(netif, timer_cascades);
+  return n;
 }
 
 
@@ -336,6 +405,13 @@ static void ci_ip_timer_docallback(ci_netif *netif, ci_ip_timer* ts)
     sp = oo_statep_to_sockp(netif, ts->statep);
     ci_tcp_timeout_cork(netif, SP_TO_TCP(netif, sp));
     break;
+#if CI_CFG_TCP_PACING
+  case CI_IP_TIMER_TCP_PACE:
+    sp = oo_statep_to_sockp(netif, ts->statep);
+    CHECK_TS(netif, SP_TO_TCP(netif, sp));
+    ci_tcp_timeout_pace(netif, SP_TO_TCP(netif, sp));
+    break;
+#endif
   case CI_IP_TIMER_NETIF_TCP_RECYCLE:
     ci_ip_timer_do_recycle(netif);
     break;
@@ -376,17 +452,57 @@ static void ci_ip_timer_docallback(ci_netif *netif, ci_ip_timer* ts)
   }  
 }
 
+#if CI_CFG_STATS_NETIF
+static void ci_ip_timer_cascade_stats(ci_netif* netif, int n,
+                                      ci_uint64 cycles)
+{
+  ci_netif_stats* stats = &netif->state->stats;
+
+  if( (ci_uint32) n > stats->timer_cascade_max )
+    stats->timer_cascade_max = n;
+  if( cycles > stats->timer_cascade_max_cycles )
+    stats->timer_cascade_max_cycles = CI_MIN(cycles, (ci_uint64) UINT_MAX);
+}
+#endif
+
+
+/* Find the first busy wheel0 bucket at [stime] or up to [n]-1 ticks after
+** it.  Returns the offset from [stime], or -1 if there is none.
+*/
+static int ci_ip_timer_busy_find(ci_ip_timer_state* ipts, ci_iptime_t stime,
+                                 int n)
+{
+  int off = 0, b;
+  ci_uint64 word;
+
+  while( off < n ) {
+    b = IPTIMER_BUCKETIDX(0, stime + off);
+    word = ipts->busy_mask[b/64] >> (b%64);
+    if( word != 0 ) {
+      off += ci_ffs64(word) - 1;
+      return off < n ? off : -1;
+    }
+    off += 64 - b%64;
+  }
+  return -1;
+}
+
+
 /* run any pending timers */
 void ci_ip_timer_poll(ci_netif *netif) {
   ci_ip_timer_state* ipts = IPTIMER_STATE(netif); 
   ci_iptime_t* stime = &ipts->sched_ticks;
   ci_ip_timer* ts;
-  ci_iptime_t rtime;
+  ci_iptime_t rtime, next;
   int changed = 0;
+  int cascaded = 0;
   struct oo_p_dllink_state fire_list = oo_p_dllink_ptr(netif,
                                                        &ipts->fire_list);
   struct oo_p_dllink_state bucket;
   struct oo_p_dllink_state link;
+#if CI_CFG_STATS_NETIF
+  ci_uint64 frc, cascade_cycles = 0;
+#endif
 
   /* The caller is expected to ensure that the current time is sufficiently
   ** up-to-date.
@@ -405,15 +521,12 @@ void ci_ip_timer_poll(ci_netif *netif) {
     /* advance the schedulers view of time */
     (*stime)++;
 
-    /* cascade through wheels if reached end of current wheel */
+    /* finish cascading this rotation and start on the next one if we
+     * reached end of current rotation */
     if(IPTIMER_BUCKETNO(0, *stime) == 0) {
-      if(IPTIMER_BUCKETNO(1, *stime) == 0) {
-	if(IPTIMER_BUCKETNO(2, *stime) == 0) {
-	  ci_ip_timer_cascadewheel(netif, 3, *stime);
-	}
-	ci_ip_timer_cascadewheel(netif, 2, *stime);
-      }
-      changed = ci_ip_timer_cascadewheel(netif, 1, *stime);
+      CITP_STATS_NETIF(ci_frc64(&frc));
+      cascaded += ci_ip_timer_rotate(netif, *stime);
+      CITP_STATS_NETIF(cascade_cycles += ci_frc64_get() - frc);
     }
 
 
@@ -427,8 +540,7 @@ void ci_ip_timer_poll(ci_netif *netif) {
     OO_P_DLLINK_ASSERT_EMPTY(netif, fire_list);
 
     /* run timers in the current bucket */
-    bucket = oo_p_dllink_ptr(netif,
-                             &ipts->warray[IPTIMER_BUCKETNO(0, *stime)]),
+    bucket = IPTIMER_BUCKET(netif, 0, *stime);
     oo_p_dllink_splice(netif, bucket, fire_list);
     oo_p_dllink_init(netif, bucket);
 
@@ -443,6 +555,13 @@ void ci_ip_timer_poll(ci_netif *netif) {
 
       ci_assert_equal(ts->time, *stime);
 
+      /* pushed back by ci_ip_timer_modify_lazy() since it was queued */
+      if( ts->defer ) {
+        __ci_ip_timer_set(netif, ts, ts->time + ts->defer);
+        CITP_STATS_NETIF_INC(netif, timer_lazy_requeues);
+        continue;
+      }
+
       /* callback safe to set/clear this or other timers */
       ci_ip_timer_docallback(netif, ts);
     }
@@ -453,38 +572,64 @@ void ci_ip_timer_poll(ci_netif *netif) {
 
   OO_P_DLLINK_ASSERT_EMPTY(netif, fire_list);
 
+  /* Cascade a share of the next rotation into wheel0, so that it is spread
+   * over the polls of this rotation rather than done all at once when the
+   * next rotation starts. */
+  next = IPTIMER_NEXT_ROTATION(*stime);
+  if( ! oo_p_dllink_is_empty(netif, IPTIMER_BUCKET(netif, 1, next)) ) {
+    ci_uint32 ticks_left = next - *stime;
+    int max = (ipts->cascade_left + ticks_left - 1) / ticks_left;
+    int n;
+
+    CITP_STATS_NETIF(ci_frc64(&frc));
+    n = ci_ip_timer_cascade_next(netif, next,
+                                 CI_MAX(max, CI_IPTIME_CASCADE_BATCH));
+    CITP_STATS_NETIF(cascade_cycles += ci_frc64_get() - frc);
+    CITP_STATS_NETIF_ADD(netif, timer_cascaded, n);
+    cascaded += n;
+  }
+  if( cascaded ) {
+    changed = 1;
+    CITP_STATS_NETIF(ci_ip_timer_cascade_stats(netif, cascaded,
+                                               cascade_cycles));
+  }
+
   /* What is our next timer?
    * Let's update if our previous "closest" timer have already been
    * handled, or we have cascaded some more timers into wheel0. */
   if( TIME_GE(ipts->sched_ticks, ipts->closest_timer) || changed  ) {
-    /* we peek into the first wheel only */
-    ci_iptime_t base = ipts->sched_ticks & IPTIMER_WHEEL0_MASK;
-    ci_iptime_t b = ipts->sched_ticks - base;
-    int i = b/64;
+    int off;
 
-    /* All the lower bits have been already unset in the bitmask: */
-    ci_assert_nflags(ipts->busy_mask[i], (1ULL << (b%64)) - 1);
+    /* The bucket for the current tick has been emptied already. */
+    ci_assert_nflags(ipts->busy_mask[IPTIMER_BUCKETIDX(0, *stime) / 64],
+                     1ULL << (IPTIMER_BUCKETIDX(0, *stime) % 64));
+
+    /* While the next rotation is only partly cascaded, come back on the
+     * next tick to do some more. */
+    if( ! oo_p_dllink_is_empty(netif, IPTIMER_BUCKET(netif, 1, next)) ) {
+      ipts->closest_timer = *stime + 1;
+      return;
+    }
 
     /* We peek into the wheel0 */
-    for( ; i < 4; i++ ) {
-      if( ipts->busy_mask[i] != 0 ) {
-        ipts->closest_timer = base + i*64 + ci_ffs64(ipts->busy_mask[i]) - 1;
-        return;
-      }
+    off = ci_ip_timer_busy_find(ipts, *stime, next + CI_IPTIME_BUCKETS - *stime);
+    if( off >= 0 ) {
+      ipts->closest_timer = *stime + off;
+      return;
     }
 
-    /* Next timer is not closer that the start of wheel1.  We'll cascade it
-     * and determine the closest_timer correctly after cascading.  */
-    ipts->closest_timer = base + CI_IPTIME_BUCKETS;
+    /* Next timer is not closer that the start of the next rotation, when
+     * we'll start cascading the one after it.  */
+    ipts->closest_timer = next;
 
-    /* But if the first bucket in wheel1 is empty, we can push the
-     * closest_timer even further.  We are guaranteed to cascade at least
+    /* But if that rotation has nothing in wheel1, we can push the
+     * closest_timer even further.  We are guaranteed to poll at least
      * once during this time frame, so we'll get better estimation when
      * this value becomes limiting (we call linux_tcp_timer_do() every
      * 90ms, which is smaller than CI_IPTIME_BUCKETS=250 ticks. */
     if( oo_p_dllink_is_empty(netif,
                              IPTIMER_BUCKET(netif, 1,
-                                            base + CI_IPTIME_BUCKETS) ) ) {
+                                            next + CI_IPTIME_BUCKETS) ) ) {
       ipts->closest_timer += CI_IPTIME_BUCKETS;
     }
   }
@@ -492,6 +637,38 @@ void ci_ip_timer_poll(ci_netif *netif) {
 
 #endif
 
+/* Find the range of times [min_time, max_time) that belong in bucket [b]
+** of wheel [w] at scheduler time [stime].  Wheel0 holds single ticks of the
+** current and next rotations; the wheels above are arranged relative to the
+** start of the next rotation.  Returns true if the bucket ought to be empty.
+*/
+ci_inline int ci_ip_timer_bucket_range(ci_iptime_t stime, int w, unsigned b,
+                                       ci_iptime_t* min_time,
+                                       ci_iptime_t* max_time)
+{
+  /* shifting a 32 bit integer left or right 32 bits has undefined results 
+   * (i.e. not 0 which is required). Therefore I now use an array of mask 
+   * values 
+   */
+  static const unsigned wheel_mask[CI_IPTIME_WHEELS] =
+                { IPTIMER_WHEEL0_MASK, IPTIMER_WHEEL1_MASK,
+                  IPTIMER_WHEEL2_MASK, 0 };
+  ci_iptime_t next = IPTIMER_NEXT_ROTATION(stime);
+  int bit_shift = CI_IPTIME_BUCKETBITS*w;
+
+  if( w == 0 ) {
+    ci_iptime_t base = stime & IPTIMER_WHEEL0_MASK;
+    *min_time = base + ((b - base) & (CI_IPTIME_WHEEL0_BUCKETS - 1));
+    *max_time = *min_time + 1;
+    return TIME_LE(*min_time, stime);
+  }
+  *min_time = (next & wheel_mask[w]) + (b << bit_shift);
+  *max_time = *min_time + (1u << bit_shift);
+  /* wheel1 may still hold the part of the next rotation not yet cascaded */
+  return TIME_LT(*min_time, next);
+}
+
+
 #ifndef NDEBUG
 
 void ci_ip_timer_state_assert_valid(ci_netif* ni, const char* file, int line)
@@ -500,16 +677,8 @@ void ci_ip_timer_state_assert_valid(ci_netif* ni, const char* file, int line)
   ci_ip_timer* ts;
   struct oo_p_dllink_state bucket;
   struct oo_p_dllink_state l;
-  ci_iptime_t stime, wheel_base, max_time, min_time;
-  int a1, a2, a3, w, b, bit_shift;
-
-  /* shifting a 32 bit integer left or right 32 bits has undefined results 
-   * (i.e. not 0 which is required). Therefore I now use an array of mask 
-   * values 
-   */
-  unsigned wheel_mask[CI_IPTIME_WHEELS] = 
-                { IPTIMER_WHEEL0_MASK, IPTIMER_WHEEL1_MASK,
-                  IPTIMER_WHEEL2_MASK, 0 };
+  ci_iptime_t stime, max_time, min_time;
+  int a1, a2, a3, w, b, should_be_empty;
 
   ipts = IPTIMER_STATE(ni);
   stime = ipts->sched_ticks;
@@ -517,17 +686,14 @@ void ci_ip_timer_state_assert_valid(ci_netif* ni, const char* file, int line)
   /* for each wheel */
   for(w=0; w < CI_IPTIME_WHEELS; w++) {
 
-    /* base time of wheel */
-    wheel_base = stime & wheel_mask[w];
     /* for each bucket in wheel */
-    for (b=0; b < CI_IPTIME_BUCKETS; b++) {
+    for (b=0; b < (w ? CI_IPTIME_BUCKETS : CI_IPTIME_WHEEL0_BUCKETS); b++) {
 
       /* max and min relative times for this bucket */
-      bit_shift = CI_IPTIME_BUCKETBITS*w;
-      min_time = wheel_base + (b << bit_shift);
-      max_time = min_time   + (1 << bit_shift);
-
-      bucket = oo_p_dllink_ptr(ni, &ipts->warray[w*CI_IPTIME_BUCKETS + b]);
+      should_be_empty = ci_ip_timer_bucket_range(stime, w, b,
+                                                 &min_time, &max_time);
+      bucket = oo_p_dllink_ptr(ni, &ipts->warray[w ? (w + 1) *
+                                                 CI_IPTIME_BUCKETS + b : b]);
 
       /* check list looks valid */
       if( w == 0 ) {
@@ -539,7 +705,7 @@ void ci_ip_timer_state_assert_valid(ci_netif* ni, const char* file, int line)
 
 
       /* check buckets that should be empty are! */
-      a3 = TIME_GT(min_time, stime) || oo_p_dllink_is_empty(ni, bucket);
+      a3 = ! should_be_empty || oo_p_dllink_is_empty(ni, bucket);
 
       /* run through timers in bucket */
       oo_p_dllink_for_each(ni, l, bucket) {
@@ -582,6 +748,9 @@ static const char* ci_ip_timer_dump(const ci_ip_timer* ts)
     MAKECASE(CI_IP_TIMER_TCP_KALIVE,   "kalive")
     MAKECASE(CI_IP_TIMER_TCP_LISTEN,   "listen")
     MAKECASE(CI_IP_TIMER_TCP_CORK,     "cork")
+#if CI_CFG_TCP_PACING
+    MAKECASE(CI_IP_TIMER_TCP_PACE,     "pace")
+#endif
     MAKECASE(CI_IP_TIMER_NETIF_TIMEOUT, "netif")
     MAKECASE(CI_IP_TIMER_PMTU_DISCOVER, "pmtu")
 #if CI_CFG_SUPPORT_STATS_COLLECTION
@@ -606,38 +775,28 @@ void ci_ip_timer_state_dump(ci_netif* ni)
   ci_ip_timer* ts;
   struct oo_p_dllink_state bucket;
   struct oo_p_dllink_state l;
-  ci_iptime_t stime, wheel_base, max_time, min_time;
-  int w, b, bit_shift;
-
-  /* shifting a 32 bit integer left or right 32 bits has undefined results 
-   * (i.e. not 0 which is required). Therefore I now use an array of mask 
-   * values 
-   */
-  unsigned wheel_mask[CI_IPTIME_WHEELS] = 
-                { IPTIMER_WHEEL0_MASK, IPTIMER_WHEEL1_MASK,
-                  IPTIMER_WHEEL2_MASK, 0 };
+  ci_iptime_t stime, max_time, min_time;
+  int w, b, should_be_empty;
 
   ipts = IPTIMER_STATE(ni);
   stime = ipts->sched_ticks;
 
-  ci_log("%s: time is 0x%x", __FUNCTION__, stime);
+  ci_log("%s: time is 0x%x, %u to cascade into next rotation", __FUNCTION__,
+         stime, ipts->cascade_left);
   /* for each wheel */
   for(w=0; w < CI_IPTIME_WHEELS; w++) {
 
-    /* base time of wheel */
-    wheel_base = stime & wheel_mask[w];
     /* for each bucket in wheel */
-    for (b=0; b < CI_IPTIME_BUCKETS; b++) {
+    for (b=0; b < (w ? CI_IPTIME_BUCKETS : CI_IPTIME_WHEEL0_BUCKETS); b++) {
 
       /* max and min relative times for this bucket */
-      bit_shift = CI_IPTIME_BUCKETBITS*w;
-      min_time = wheel_base + (b << bit_shift);
-      max_time = min_time   + (1 << bit_shift);
-
-      bucket = oo_p_dllink_ptr(ni, &ipts->warray[w*CI_IPTIME_BUCKETS + b]);
+      should_be_empty = ci_ip_timer_bucket_range(stime, w, b,
+                                                 &min_time, &max_time);
+      bucket = oo_p_dllink_ptr(ni, &ipts->warray[w ? (w + 1) *
+                                                 CI_IPTIME_BUCKETS + b : b]);
 
       /* check buckets that should be empty are! */
-      if ( TIME_LE(min_time, stime) && !oo_p_dllink_is_empty(ni, bucket) )
+      if ( should_be_empty && !oo_p_dllink_is_empty(ni, bucket) )
         ci_log("w:%d, b:%d, [0x%x->0x%x] - bucket should be empty",  
                 w, b, min_time, max_time);
 
@@ -646,8 +805,9 @@ void ci_ip_timer_state_dump(ci_netif* ni)
         /* get timer */
         ts = LINK2TIMER(l.l);
 
-        ci_log(" ts = 0x%x %s  w:%d, b:%d, [0x%x->0x%x]",
-               ts->time, ci_ip_timer_dump(ts), w, b, min_time, max_time);
+        ci_log(" ts = 0x%x+0x%x %s  w:%d, b:%d, [0x%x->0x%x]",
+               ts->time, ts->defer, ci_ip_timer_dump(ts), w, b,
+               min_time, max_time);
         if ( TIME_LE(ts->time, stime) )
           ci_log("    ERROR: timer before current time");
         if ( !(TIME_LT(ts->time, max_time) && TIME_GE(ts->time, min_time)) )
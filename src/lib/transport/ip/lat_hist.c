@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+** <L5_PRIVATE L5_SOURCE>
+** Description: Latency histograms kept in the stack state when
+**              EF_LATENCY_HIST is set.
+** </L5_PRIVATE>
+\**************************************************************************/
+
+#include "ip_internal.h"
+
+#if CI_CFG_LATENCY_HIST
+
+static ci_uint64 lat_hist_since(ci_uint64 start)
+{
+  ci_uint64 now;
+  ci_frc64(&now);
+  /* The stamp may come from another core, so allow for a little skew. */
+  return (ci_int64) (now - start) > 0 ? now - start : 0;
+}
+
+
+/* Returns the histograms for this socket, giving it a free slot if it
+ * hasn't got one.  NULL if per-socket histograms are off or all the slots
+ * are taken.
+ */
+struct oo_lat_hist_sock* oo_lat_hist_sock(ci_netif* ni, oo_sp sock_id)
+{
+  struct oo_lat_hist_sock* ls = ni->state->lat_sock;
+  int i;
+
+  if( NI_OPTS(ni).latency_hist < 2 || OO_SP_IS_NULL(sock_id) )
+    return NULL;
+
+  for( i = 0; i < CI_CFG_LATENCY_HIST_SOCKETS; ++i )
+    if( OO_SP_EQ(ls[i].sock_id, sock_id) )
+      return &ls[i];
+
+  /* Not necessarily under the stack lock, so claim the slot atomically.
+   * The previous owner's histograms stay readable until now. */
+  for( i = 0; i < CI_CFG_LATENCY_HIST_SOCKETS; ++i )
+    if( OO_SP_IS_NULL(ls[i].sock_id) &&
+        ci_cas32_succeed(&ls[i].sock_id, OO_SP_NULL, sock_id) ) {
+      memset(&ls[i].rx_to_app, 0, sizeof(ls[i].rx_to_app));
+      memset(&ls[i].send_to_wire, 0, sizeof(ls[i].send_to_wire));
+      return &ls[i];
+    }
+
+  return NULL;
+}
+
+
+void oo_lat_hist_sock_release(ci_netif* ni, oo_sp sock_id)
+{
+  struct oo_lat_hist_sock* ls = ni->state->lat_sock;
+  int i;
+
+  for( i = 0; i < CI_CFG_LATENCY_HIST_SOCKETS; ++i )
+    if( OO_SP_EQ(ls[i].sock_id, sock_id) )
+      ci_cas32_succeed(&ls[i].sock_id, sock_id, OO_SP_NULL);
+}
+
+
+void __oo_lat_hist_rx_to_app(ci_netif* ni, oo_sp sock_id, ci_uint64 start)
+{
+  struct oo_lat_hist_sock* ls;
+  ci_uint64 v = lat_hist_since(start);
+
+  oo_lat_hist_add(&ni->state->lat_rx_to_app, v);
+  if( (ls = oo_lat_hist_sock(ni, sock_id)) != NULL )
+    oo_lat_hist_add(&ls->rx_to_app, v);
+}
+
+
+void __oo_lat_hist_send_to_wire(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  struct oo_lat_hist_sock* ls;
+  ci_uint64 v = lat_hist_since(pkt->tstamp_frc);
+
+  oo_lat_hist_add(&ni->state->lat_send_to_wire, v);
+  /* Only UDP packets know which socket sent them. */
+  if( (pkt->flags & CI_PKT_FLAG_UDP) &&
+      (ls = oo_lat_hist_sock(ni, pkt->pf.udp.tx_sock_id)) != NULL )
+    oo_lat_hist_add(&ls->send_to_wire, v);
+}
+
+
+void __oo_lat_hist_lock_hold(ci_netif* ni)
+{
+  ci_uint64 start = ni->state->lock_frc;
+
+  ni->state->lock_frc = 0;
+  if( start != 0 )
+    oo_lat_hist_add(&ni->state->lat_lock_hold, lat_hist_since(start));
+}
+
+#endif /* CI_CFG_LATENCY_HIST */
@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+** <L5_PRIVATE L5_SOURCE>
+** Description: Per-call-site stack lock statistics kept in the stack
+**              state when EF_LOCK_PROFILE is set.
+** </L5_PRIVATE>
+\**************************************************************************/
+
+#include "ip_internal.h"
+
+#if CI_CFG_LOCK_PROFILE
+
+static ci_uint64 lock_prof_interval(ci_uint64 start, ci_uint64 end)
+{
+  /* The stamps may come from different cores, so allow for a little
+   * skew. */
+  return (ci_int64) (end - start) > 0 ? end - start : 0;
+}
+
+
+static void lock_prof_max(ci_uint32* max, ci_uint64 v)
+{
+  ci_uint32 v32 = CI_MIN(v, (ci_uint64) 0xffffffffu);
+  if( v32 > *max )
+    *max = v32;
+}
+
+
+/* Returns the index of the site for [func]:[line], giving it a free slot
+ * if it hasn't got one, or -1 if the table is full.  Called with the stack
+ * lock held, so nothing else is changing the table.
+ */
+static int lock_prof_site(struct oo_lock_prof* lp, const char* func,
+                          int line)
+{
+  struct oo_lock_prof_site* site;
+  unsigned i, j, k;
+
+  for( j = 0; j < CI_CFG_LOCK_PROFILE_SITES; ++j ) {
+    i = ((unsigned) line + j) % CI_CFG_LOCK_PROFILE_SITES;
+    site = &lp->site[i];
+    if( site->line == (unsigned) line &&
+        strncmp(site->func, func, sizeof(site->func) - 1) == 0 )
+      return i;
+    if( site->line == 0 ) {
+      for( k = 0; k < sizeof(site->func) - 1 && func[k] != '\0'; ++k )
+        site->func[k] = func[k];
+      site->func[k] = '\0';
+      site->line = line;
+      return i;
+    }
+  }
+  return -1;
+}
+
+
+/* The stack lock has just been taken by [func]:[line].  [wait_frc] is
+ * when it started waiting, or 0 if it didn't have to.
+ */
+void __oo_lock_prof_acquired(ci_netif* ni, const char* func, int line,
+                             ci_uint64 wait_frc)
+{
+  struct oo_lock_prof* lp = &ni->state->lock_prof;
+  struct oo_lock_prof_site* site;
+  ci_uint64 v;
+  int i = lock_prof_site(lp, func, line);
+
+  ci_frc64(&lp->hold_frc);
+  lp->holder = i;
+  if( i < 0 ) {
+    ++lp->n_untracked;
+    return;
+  }
+
+  site = &lp->site[i];
+  ++site->n_locks;
+  if( wait_frc != 0 ) {
+    v = lock_prof_interval(wait_frc, lp->hold_frc);
+    ++site->n_waits;
+    site->wait_cycles += v;
+    lock_prof_max(&site->wait_max, v);
+  }
+}
+
+
+/* The stack lock is about to be dropped by ci_netif_unlock(). */
+void __oo_lock_prof_released(ci_netif* ni)
+{
+  struct oo_lock_prof* lp = &ni->state->lock_prof;
+  struct oo_lock_prof_site* site;
+  ci_uint64 now, v;
+  unsigned i = lp->holder;
+
+  lp->holder = -1;
+  /* The lock may have been taken some way that didn't note the holder. */
+  if( i >= CI_CFG_LOCK_PROFILE_SITES )
+    return;
+
+  ci_frc64(&now);
+  v = lock_prof_interval(lp->hold_frc, now);
+  site = &lp->site[i];
+  ++site->n_holds;
+  site->hold_cycles += v;
+  lock_prof_max(&site->hold_max, v);
+}
+
+
+/* ci_netif_unlock_slow_common() is doing the work for lock [flags]. */
+void __oo_lock_prof_deferred(ci_netif* ni, ci_uint64 flags)
+{
+  ci_uint64* deferred = ni->state->lock_prof.deferred;
+
+  if( flags & CI_EPLOCK_NETIF_SOCKET_LIST ) {
+    ++deferred[0];
+    flags &= ~CI_EPLOCK_NETIF_SOCKET_LIST;
+  }
+  for( ; flags != 0; flags &= flags - 1 )
+    ++deferred[__builtin_ctzll(flags)];
+}
+
+#endif /* CI_CFG_LOCK_PROFILE */
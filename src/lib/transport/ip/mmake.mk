@@ -18,6 +18,8 @@ LIB_SRCS	:=		\
 		tcp_tx.c	\
 		tcp_tx_reformat.c \
 		tcp_timer.c	\
+		tcp_cong.c	\
+		tcp_rack.c	\
 		tcp_close.c	\
 		tcp_init_shared.c \
 		pmtu.c		\
@@ -26,6 +28,7 @@ LIB_SRCS	:=		\
 		udp_rx.c	\
 		udp_connect.c	\
 		udp_misc.c	\
+		udp_reuseport.c	\
 		icmp_send.c	\
 		tcp_stats.c	\
 		netif_stats.c	\
@@ -53,7 +56,10 @@ LIB_SRCS	:=		\
 		active_wild.c	\
 		pkt_checksum.c	\
 		netif_dtor.c	\
-		ringbuffer.c
+		ringbuffer.c	\
+		tcpdump_bpf.c	\
+		lat_hist.c	\
+		lock_prof.c
 
 ifneq ($(DRIVER),1)
 LIB_SRCS	+=		\
@@ -68,7 +74,8 @@ LIB_SRCS	+=		\
 		tcp_helper.c	\
 		syscall.c	\
 		per_thread.c	\
-		rwlock.c
+		rwlock.c	\
+		spin_adapt.c
 endif
 
 ifeq ($(DRIVER),1)
@@ -1089,6 +1089,7 @@ ci_uint64 ci_netif_unlock_slow_common(ci_netif* ni, ci_uint64 lock_val,
     /* assume caller always asks to handle these flags */
     ci_assert_flags(flags_to_handle, CI_EPLOCK_NETIF_SOCKET_LIST);
     CITP_STATS_NETIF_INC(ni, unlock_slow_socket_list);
+    oo_lock_prof_deferred(ni, CI_EPLOCK_NETIF_SOCKET_LIST);
     lock_val = ci_netif_purge_deferred_socket_list(ni);
   }
   ci_assert(! (lock_val & CI_EPLOCK_NETIF_SOCKET_LIST));
@@ -1100,6 +1101,7 @@ ci_uint64 ci_netif_unlock_slow_common(ci_netif* ni, ci_uint64 lock_val,
 
   /* Restrict work below to what has been requested */
   test_val = lock_val & flags_to_handle;
+  oo_lock_prof_deferred(ni, test_val);
 
   if( test_val & CI_EPLOCK_NETIF_IS_PKT_WAITER ) {
     if( ci_netif_pkt_tx_can_alloc_now(ni) ) {
@@ -1287,6 +1289,14 @@ void ci_netif_unlock(ci_netif* ni)
   ci_assert_nflags(ni->state->flags, CI_NETIF_FLAG_PKT_ACCOUNT_PENDING);
 
   ci_assert_equal(ni->state->in_poll, 0);
+#if CI_CFG_LATENCY_HIST
+  if(CI_UNLIKELY( oo_lat_hist_enabled(ni) ))
+    __oo_lat_hist_lock_hold(ni);
+#endif
+#if CI_CFG_LOCK_PROFILE
+  if(CI_UNLIKELY( oo_lock_prof_enabled(ni) ))
+    __oo_lock_prof_released(ni);
+#endif
   if(CI_LIKELY( ni->state->lock.lock == CI_EPLOCK_LOCKED &&
                 ci_cas64u_succeed(&ni->state->lock.lock,
                                   CI_EPLOCK_LOCKED, 0) ))
@@ -1933,6 +1943,7 @@ void ci_netif_active_wild_sharer_closed(ci_netif* ni, ci_sock_cmn* s)
 void oo_tcpdump_free_pkts(ci_netif* ni, ci_uint16 i)
 {
   ci_uint16 read_i = ni->state->dump_read_i;
+  ci_uint16 mask = oo_tcpdump_queue_mask(ni);
 
   ci_assert(ci_netif_is_locked(ni));
 
@@ -1940,14 +1951,14 @@ void oo_tcpdump_free_pkts(ci_netif* ni, ci_uint16 i)
   ci_mb();
 
   do {
-    oo_pkt_p id = ni->state->dump_queue[i % CI_CFG_DUMPQUEUE_LEN];
+    oo_pkt_p id = ni->state->dump_queue[i & mask];
     if( id != OO_PP_NULL ) {
       ci_ip_pkt_fmt* pkt = PKT_CHK(ni, id);
-      ni->state->dump_queue[i % CI_CFG_DUMPQUEUE_LEN] = OO_PP_NULL;
+      ni->state->dump_queue[i & mask] = OO_PP_NULL;
       ci_wmb();
       ci_netif_pkt_release(ni, pkt);
     }
-  } while( (++i - read_i) % CI_CFG_DUMPQUEUE_LEN );
+  } while( (ci_uint16) (++i - read_i) & mask );
 }
 #endif
 
@@ -285,6 +285,31 @@ void ci_netif_print_sockets(ci_netif* ni)
 }
 
 
+/* Sums the packet sets and their free lists by the NUMA node they're on. */
+static void ci_netif_dump_pkt_nodes(ci_netif* ni, oo_dump_log_fn_t logger,
+                                    void* log_arg)
+{
+  oo_pktbuf_set* set = ni->packets->set;
+  int i, j, n_sets, n_free;
+
+  for( i = 0; i < ni->packets->sets_n; i++ ) {
+    for( j = 0; j < i; j++ )
+      if( set[j].numa_node == set[i].numa_node )
+        break;
+    if( j < i )
+      continue;
+    n_sets = n_free = 0;
+    for( ; j < ni->packets->sets_n; j++ )
+      if( set[j].numa_node == set[i].numa_node ) {
+        ++n_sets;
+        n_free += set[j].n_free;
+      }
+    logger(log_arg, "  pkt_node[%d]: sets=%d alloc=%d free=%d",
+           set[i].numa_node, n_sets, n_sets * PKTS_PER_SET, n_free);
+  }
+}
+
+
 static void ci_netif_dump_pkt_summary(ci_netif* ni, oo_dump_log_fn_t logger,
                                       void* log_arg)
 {
@@ -296,9 +321,11 @@ static void ci_netif_dump_pkt_summary(ci_netif* ni, oo_dump_log_fn_t logger,
          ni->packets->sets_n);
 
   for( i = 0; i < ni->packets->sets_n; i++ ) {
-    logger(log_arg, "  pkt_set[%d]: free=%d%s", i, ni->packets->set[i].n_free,
+    logger(log_arg, "  pkt_set[%d]: free=%d node=%d%s", i,
+           ni->packets->set[i].n_free, ni->packets->set[i].numa_node,
            i == ni->packets->id ? " current" : "");
   }
+  ci_netif_dump_pkt_nodes(ni, logger, log_arg);
 
   rx_ring = 0;
   tx_ring = 0;
@@ -587,8 +614,8 @@ void ci_netif_dump_extra_to_logger(ci_netif* ni, oo_dump_log_fn_t logger,
   logger(log_arg, "  hwport_to_intf_i=%s intf_i_to_hwport=%s", hp2i, i2hp);
   logger(log_arg, "  uk_intf_ver=%s", OO_UK_INTF_VER);
   logger(log_arg, "  deferred count %d/%d", ns->defer_work_count, NI_OPTS(ni).defer_work_limit);
-  logger(log_arg, "  numa nodes: creation=%d load=%d",
-         ns->creation_numa_node, ns->load_numa_node);
+  logger(log_arg, "  numa nodes: creation=%d load=%d alloc=%d",
+         ns->creation_numa_node, ns->load_numa_node, ns->alloc_numa_node);
   logger(log_arg, "  numa node masks: packet alloc=%x sock alloc=%x interrupt=%x",
          ns->packet_alloc_numa_nodes, ns->sock_alloc_numa_nodes,
          ns->interrupt_numa_nodes);
@@ -990,11 +1017,27 @@ void ci_netif_dump_to_logger(ci_netif* ni, oo_dump_log_fn_t logger,
            CI_NETIF_ERRORS_PRI_ARG(ns->error_flags));
   {
     ci_uint16 dwi = ni->state->dump_write_i, dri = ni->state->dump_read_i;
-    if( dwi != dri )
-      logger(log_arg, "  tcpdump: %d/%d packets in queue (wr=%u rd=%u)",
-             (int)(ci_uint16) (dwi - dri), CI_CFG_DUMPQUEUE_LEN, dwi, dri);
+    if( dwi != dri || ni->state->dump_filter_len != 0 )
+      logger(log_arg, "  tcpdump: %d/%d packets in queue (wr=%u rd=%u) "
+             "filter=%d insns", (int)(ci_uint16) (dwi - dri),
+             oo_tcpdump_queue_mask(ni) + 1, dwi, dri,
+             (int) ni->state->dump_filter_len);
   }
 
+#if CI_CFG_UDP_REUSEPORT
+  {
+    int g;
+    for( g = 0; g < CI_CFG_UDP_REUSEPORT_GROUPS; ++g ) {
+      const struct oo_udp_reuseport_group* grp = &ns->udp_reuseport[g];
+      if( grp->n_members != 0 )
+        logger(log_arg, "  udp reuseport group %d: "IPX_PORT_FMT
+               " members=%u prog=%u insns", g,
+               IPX_ARG(AF_IP(grp->laddr)), CI_BSWAP_BE16(grp->lport_be16),
+               grp->n_members, grp->prog_len);
+    }
+  }
+#endif
+
 #if CI_CFG_FD_CACHING
   logger(log_arg, "  active cache: hit=%d avail=%d cache=%s pending=%s",
          ns->stats.activecache_hit,
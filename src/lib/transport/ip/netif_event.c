@@ -1745,6 +1745,10 @@ ci_inline void __ci_netif_tx_pkt_complete(ci_netif* ni,
   }
 #endif
 
+  /* Not on NIC reset, when the packet may not have been sent at all */
+  if( ev != NULL )
+    oo_lat_hist_send_to_wire(ni, pkt);
+
   pkt->flags &=~ CI_PKT_FLAG_TX_PENDING;
   if( pkt->flags & CI_PKT_FLAG_UDP )
     ci_netif_tx_pkt_complete_udp(ni, ps, pkt);
@@ -190,6 +190,26 @@ void ci_netif_state_init(ci_netif* ni, int cpu_khz, const char* name)
   nis->dump_read_i = 0;
   nis->dump_write_i = 0;
   memset(nis->dump_intf, 0, sizeof(nis->dump_intf));
+  nis->dump_queue_mask = CI_CFG_DUMPQUEUE_LEN_DEFAULT - 1;
+  nis->dump_filter_len = 0;
+#endif
+
+#if CI_CFG_LATENCY_HIST
+  for( i = 0; i < CI_CFG_LATENCY_HIST_SOCKETS; ++i )
+    nis->lat_sock[i].sock_id = OO_SP_NULL;
+#endif
+
+#if CI_CFG_SPIN_ADAPTIVE
+  memset(nis->spin_adapt, 0, sizeof(nis->spin_adapt));
+#endif
+
+#if CI_CFG_LOCK_PROFILE
+  memset(&nis->lock_prof, 0, sizeof(nis->lock_prof));
+  nis->lock_prof.holder = -1;
+#endif
+
+#if CI_CFG_UDP_REUSEPORT
+  memset(nis->udp_reuseport, 0, sizeof(nis->udp_reuseport));
 #endif
 
   nis->uuid = ci_current_from_kuid_munged(ni->kuid);
@@ -752,6 +772,10 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
 
   if( (s = getenv("EF_INT_DRIVEN")) )
     opts->int_driven = atoi(s);
+#if CI_CFG_SPIN_ADAPTIVE
+  if( (s = getenv("EF_SPIN_ADAPTIVE")) )
+    opts->spin_adaptive = CI_MIN(atoi(s), 100);
+#endif
 #if CI_CFG_WANT_BPF_NATIVE
   if( (s = getenv("EF_POLL_IN_KERNEL")) )
     opts->poll_in_kernel = atoi(s);
@@ -797,6 +821,11 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
   static const char* const urgent_opts[] = { "allow", "ignore", 0 };
   opts->urg_mode = parse_enum(opts, "EF_TCP_URG_MODE", urgent_opts, "ignore");
 
+  static const char* const cong_control_opts[] = { "reno", "cubic", "bbr",
+                                                    "dctcp", 0 };
+  opts->tcp_cong_control = parse_enum(opts, "EF_TCP_CONG_CONTROL",
+                                      cong_control_opts, "reno");
+
   if( (s = getenv("EF_MCAST_RECV")) )
     opts->mcast_recv = atoi(s);
   if( (s = getenv("EF_FORCE_SEND_MULTICAST")) )
@@ -884,6 +913,8 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
 #endif
   if ( (s = getenv("EF_COMPOUND_PAGES_MODE")) )
     opts->compound_pages = atoi(s);
+  if ( (s = getenv("EF_NUMA_NODE")) )
+    opts->numa_node = atoi(s);
   if ( (s = getenv("EF_RXQ_SIZE")) )
     opts->rxq_size = atoi(s);
   if ( (s = getenv("EF_RXQ_LIMIT")) )
@@ -993,6 +1024,10 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->tcp_connect_handover = atoi(s);
   if( (s = getenv("EF_UDP_CONNECT_HANDOVER")) )
     opts->udp_connect_handover = atoi(s);
+#if CI_CFG_UDP_REUSEPORT
+  if( (s = getenv("EF_UDP_REUSEPORT_INSTACK")) )
+    opts->udp_reuseport_instack = atoi(s) != 0;
+#endif
   if( (s = getenv("EF_UDP_SEND_UNLOCKED")) )
     opts->udp_send_unlocked = atoi(s);
   if( (s = getenv("EF_UDP_SEND_NONBLOCK_NO_PACKETS_MODE")) )
@@ -1026,6 +1061,14 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
       opts->tcp_rx_log_flags = v;
     }
   }
+#if CI_CFG_LATENCY_HIST
+  if( (s = getenv("EF_LATENCY_HIST")) )
+    opts->latency_hist = atoi(s);
+#endif
+#if CI_CFG_LOCK_PROFILE
+  if( (s = getenv("EF_LOCK_PROFILE")) )
+    opts->lock_profile = atoi(s) != 0;
+#endif
 
   if( (s = getenv("EF_ACCEPTQ_MIN_BACKLOG")) )
     opts->acceptq_min_backlog = atoi(s);
@@ -1169,6 +1212,14 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
   if ( (s = getenv("EF_BURST_CONTROL_LIMIT")))
     opts->burst_control_limit = atoi(s);
 #endif
+#if CI_CFG_TCP_PACING
+  if ( (s = getenv("EF_TCP_PACING")))
+    opts->tcp_pacing = atoi(s);
+#endif
+#if CI_CFG_TCP_FASTOPEN
+  if( (s = getenv("EF_TCP_FASTOPEN")) )
+    opts->tcp_fastopen = atoi(s);
+#endif
 #if CI_CFG_CONG_AVOID_NOTIFIED
   if ( (s = getenv("EF_CONG_NOTIFY_THRESH")))
     opts->cong_notify_thresh = atoi(s);
@@ -1177,6 +1228,10 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
   if ( (s = getenv("EF_TAIL_DROP_PROBE")))
     opts->tail_drop_probe = atoi(s);
 #endif
+#if CI_CFG_TCP_RACK
+  if( (s = getenv("EF_TCP_RACK")) )
+    opts->tcp_rack = atoi(s);
+#endif
 #if CI_CFG_CONG_AVOID_SCALE_BACK
   if ( (s = getenv("EF_CONG_AVOID_SCALE_BACK")))
     opts->cong_avoid_scale_back = atoi(s);
@@ -162,6 +162,20 @@ ci_netif_stats_report_text(ci_netif *netif, char *buf, int count)
                          tcp_retran_segs);
   __TEXT_NETIF_COUNT_LOG("Tcp_out_rsts:", tcp,
                          tcp_out_rsts);
+  __TEXT_NETIF_COUNT_LOG("Tcp_ecn_estab:", tcp,
+                         tcp_ecn_estab);
+  __TEXT_NETIF_COUNT_LOG("Tcp_ecn_ce_rcvd:", tcp,
+                         tcp_ecn_ce_rcvd);
+  __TEXT_NETIF_COUNT_LOG("Tcp_ecn_ece_rcvd:", tcp,
+                         tcp_ecn_ece_rcvd);
+  __TEXT_NETIF_COUNT_LOG("Tcp_ecn_cwnd_reduced:", tcp,
+                         tcp_ecn_cwnd_reduced);
+  __TEXT_NETIF_COUNT_LOG("Tcp_fastopen_cookie_issued:", tcp,
+                         tcp_fastopen_cookie_issued);
+  __TEXT_NETIF_COUNT_LOG("Tcp_fastopen_accepted:", tcp,
+                         tcp_fastopen_accepted);
+  __TEXT_NETIF_COUNT_LOG("Tcp_fastopen_rejected:", tcp,
+                         tcp_fastopen_rejected);
   /* UDP statistics */
   __TEXT_NETIF_COUNT_LOG("Udp_in_dgrams:", udp,
                          udp_in_dgrams);
@@ -417,6 +431,20 @@ ci_netif_stats_report_xml(ci_netif* netif, char *buf, int count)
                             tcp_retran_segs);
   __XML_NETIF_COUNT_LOG("Tcp_out_rsts:", tcp,
                             tcp_out_rsts);
+  __XML_NETIF_COUNT_LOG("Tcp_ecn_estab:", tcp,
+                            tcp_ecn_estab);
+  __XML_NETIF_COUNT_LOG("Tcp_ecn_ce_rcvd:", tcp,
+                            tcp_ecn_ce_rcvd);
+  __XML_NETIF_COUNT_LOG("Tcp_ecn_ece_rcvd:", tcp,
+                            tcp_ecn_ece_rcvd);
+  __XML_NETIF_COUNT_LOG("Tcp_ecn_cwnd_reduced:", tcp,
+                            tcp_ecn_cwnd_reduced);
+  __XML_NETIF_COUNT_LOG("Tcp_fastopen_cookie_issued:", tcp,
+                            tcp_fastopen_cookie_issued);
+  __XML_NETIF_COUNT_LOG("Tcp_fastopen_accepted:", tcp,
+                            tcp_fastopen_accepted);
+  __XML_NETIF_COUNT_LOG("Tcp_fastopen_rejected:", tcp,
+                            tcp_fastopen_rejected);
   
   /* UDP statistics */
   __XML_NETIF_COUNT_LOG("Udp_in_dgrams:", udp,
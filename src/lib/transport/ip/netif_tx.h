@@ -323,6 +323,9 @@ ci_inline void ci_netif_dmaq_and_vi_for_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
       ci_frc64(&((pkt)->tstamp_frc));                                   \
       oo_tcpdump_dump_pkt(ni, pkt);                                     \
     }                                                                   \
+    else if( oo_lat_hist_enabled(ni) ) {                                \
+      ci_frc64(&((pkt)->tstamp_frc));                                   \
+    }                                                                   \
   } while(0)
 
 #define __ci_netif_dmaq_insert_prep_pkt(ni, pkt)                        \
@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+** <L5_PRIVATE L5_SOURCE>
+** Description: Sizing the spin of blocking receives from the waits seen
+**              by each thread (EF_SPIN_ADAPTIVE).
+** </L5_PRIVATE>
+\**************************************************************************/
+
+/*
+** With EF_SPIN_USEC every blocking receive spins for the full limit before
+** it sleeps.  That only helps if data arrives within the limit: a thread
+** whose waits are longer burns the whole spin every time for nothing, and
+** one whose data arrives within a few microseconds never needs more than
+** a few microseconds of it.
+**
+** So each thread that waits in a stack gets a slot in the stack state.
+** When a wait ends, by spinning or by being woken, its length goes into
+** the slot's histogram if spinning for the full limit would have caught it,
+** and is counted as long otherwise.  The thread then spins for just long
+** enough to catch EF_SPIN_ADAPTIVE percent of the waits in the histogram,
+** rounded up to a power of two.  Waits that end after the thread has gone
+** to sleep are still counted, including the time to wake it, so a thread
+** whose waits get longer soon spins for longer again.  The counts are
+** halved every OO_SPIN_ADAPT_DECAY waits, so that old traffic is
+** forgotten.
+**
+** A new slot starts with the full spin.  If all the threads' slots are
+** taken, the thread spins for the full limit.
+*/
+
+#include "ip_internal.h"
+#include <sys/syscall.h>
+
+#if CI_CFG_SPIN_ADAPTIVE
+
+
+void oo_spin_adapt_add(struct oo_spin_adapt* sa, ci_uint64 wait,
+                       ci_uint64 max_spin, unsigned pct)
+{
+  ci_uint64 budget = oo_spin_adapt_budget(sa, max_spin);
+  unsigned i, total, want;
+
+  ++sa->n_waits;
+  if( wait < budget )
+    ++sa->n_spun;
+  sa->spin_cycles += CI_MIN(wait, budget);
+  sa->full_spin_cycles += CI_MIN(wait, max_spin);
+  if( wait < max_spin ) {
+    ++sa->hist[oo_spin_adapt_bucket(wait)];
+  }
+  else {
+    ++sa->n_long;
+    ++sa->recent_long;
+  }
+
+  if( ++sa->recent >= OO_SPIN_ADAPT_DECAY ) {
+    for( i = 0; i < OO_SPIN_ADAPT_N_BUCKETS; ++i )
+      sa->hist[i] >>= 1;
+    sa->recent_long >>= 1;
+    sa->recent = 0;
+  }
+
+  for( i = 0, total = 0; i < OO_SPIN_ADAPT_N_BUCKETS; ++i )
+    total += sa->hist[i];
+  if( total == 0 ) {
+    /* Spinning wouldn't have helped lately. */
+    sa->budget_bucket = -1;
+    return;
+  }
+  want = (total * CI_MIN(pct, 100u) + 99) / 100;
+  for( i = 0, total = 0; i < OO_SPIN_ADAPT_N_BUCKETS - 1; ++i )
+    if( (total += sa->hist[i]) >= want )
+      break;
+  sa->budget_bucket = i;
+}
+
+
+/* Returns this thread's slot in the stack, claiming a free one if it
+ * hasn't got one.  If there are none, it takes one whose thread hasn't
+ * started or finished a wait for a second, as threads don't give their
+ * slots up when they exit.  NULL if there is no such slot either.
+ */
+static struct oo_spin_adapt* oo_spin_adapt_slot(ci_netif* ni)
+{
+  struct oo_per_thread* pt = oo_per_thread_get();
+  struct oo_spin_adapt* sa = ni->state->spin_adapt;
+  struct oo_spin_adapt fresh;
+  ci_uint64 now, idle = (ci_uint64) IPTIMER_STATE(ni)->khz * 1000;
+  ci_int32 tid;
+  int i;
+
+  if(CI_UNLIKELY( pt->spin_adapt_tid == 0 ))
+    pt->spin_adapt_tid = syscall(SYS_gettid);
+  i = pt->spin_adapt_slot;
+  if(CI_LIKELY( (unsigned) i < CI_CFG_SPIN_ADAPTIVE_THREADS &&
+                sa[i].tid == pt->spin_adapt_tid ))
+    return &sa[i];
+
+  for( i = 0; i < CI_CFG_SPIN_ADAPTIVE_THREADS; ++i )
+    if( sa[i].tid == pt->spin_adapt_tid )
+      goto found;
+
+  /* Other threads may be claiming slots at the same time. */
+  for( i = 0; i < CI_CFG_SPIN_ADAPTIVE_THREADS; ++i )
+    if( sa[i].tid == 0 && ci_cas32_succeed(&sa[i].tid, 0, pt->spin_adapt_tid) )
+      goto claimed;
+
+  ci_frc64(&now);
+  for( i = 0; i < CI_CFG_SPIN_ADAPTIVE_THREADS; ++i ) {
+    tid = sa[i].tid;
+    if( now - sa[i].last_frc > idle &&
+        ci_cas32_succeed(&sa[i].tid, tid, pt->spin_adapt_tid) )
+      goto claimed;
+  }
+  return NULL;
+
+ claimed:
+  memset(&fresh, 0, sizeof(fresh));
+  fresh.tid = pt->spin_adapt_tid;
+  fresh.budget_bucket = OO_SPIN_ADAPT_N_BUCKETS - 1;
+  ci_frc64(&fresh.last_frc);
+  sa[i] = fresh;
+ found:
+  pt->spin_adapt_slot = i;
+  return &sa[i];
+}
+
+
+ci_uint64 __oo_spin_budget(ci_netif* ni, ci_uint64 max_spin)
+{
+  struct oo_spin_adapt* sa = oo_spin_adapt_slot(ni);
+
+  if( sa == NULL ) {
+    CITP_STATS_NETIF_INC(ni, spin_adapt_no_slot);
+    return max_spin;
+  }
+  /* So that the slot isn't taken from us while we wait */
+  ci_frc64(&sa->last_frc);
+  return oo_spin_adapt_budget(sa, max_spin);
+}
+
+
+void __oo_spin_adapt_record(ci_netif* ni, ci_uint64 wait, ci_uint64 max_spin)
+{
+  struct oo_spin_adapt* sa = oo_spin_adapt_slot(ni);
+
+  if( sa == NULL )
+    return;
+  /* The thread may have moved to a core whose clock is a little behind. */
+  if( (ci_int64) wait < 0 )
+    wait = 0;
+  oo_spin_adapt_add(sa, wait, max_spin, NI_OPTS(ni).spin_adaptive);
+  ci_frc64(&sa->last_frc);
+}
+
+#endif /* CI_CFG_SPIN_ADAPTIVE */
@@ -32,6 +32,8 @@
 
 /* define the ci_sys_ pointers */
 #define CI_MK_DECL(ret, fn, args)  ret (*ci_sys_##fn) args = fn
+/* libc may not have these, so callers have to cope with NULL */
+#define CI_MK_DECL_OPTIONAL(ret, fn, args)  ret (*ci_sys_##fn) args
 #include <onload/declare_syscalls.h.tmpl>
 
 
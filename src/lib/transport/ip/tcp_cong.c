@@ -0,0 +1,912 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+*//*! \file
+**  \brief  TCP congestion control algorithms: CUBIC, BBR and DCTCP; pacing.
+** <L5_PRIVATE L5_SOURCE>
+** </L5_PRIVATE>
+*//*
+\**************************************************************************/
+
+/*! \cidoxg_lib_transport_ip */
+
+/*
+** Reno (RFC5681 with RFC3465 ABC) is implemented inline in tcp_rx.c,
+** tcp_timer.c and tcp_misc.c, and remains the fast path: callers test
+** ci_tcp_cong_is_reno() and only come here for the other algorithms.
+**
+** The algorithm is per-socket (ts->c.cong_alg) and lives in shared state,
+** so it is validated against the table on every use.
+**
+** An algorithm without on_ack grows the window as reno does.  The ecn_*
+** hooks are only called on connections which have negotiated ECN.
+**
+** Times are measured in "usticks" - the free running cycle counter shifted
+** down by ci_ip_time_frc2us, i.e. roughly a microsecond.  They are
+** converted to real units only when reported to the user.
+*/
+
+#include "ip_internal.h"
+#include "tcp_rx.h"
+#include <ci/net/sockopts.h>
+
+#define LPF "TCP CONG "
+
+
+struct ci_tcp_cong_ops {
+  const char* name;
+  void (*init)(ci_netif* ni, ci_tcp_state* ts);
+  void (*on_ack)(ci_netif* ni, ci_tcp_state* ts, ci_uint32 ack,
+                 unsigned acked);
+  unsigned (*losswnd)(ci_netif* ni, ci_tcp_state* ts);
+  void (*ecn_ack)(ci_netif* ni, ci_tcp_state* ts, ci_uint32 ack,
+                  unsigned acked, int ece);
+  unsigned (*ecn_losswnd)(ci_netif* ni, ci_tcp_state* ts);
+  ci_uint32 (*pacing_rate)(ci_netif* ni, ci_tcp_state* ts);
+  void (*recovered)(ci_netif* ni, ci_tcp_state* ts);
+  void (*idle_restart)(ci_netif* ni, ci_tcp_state* ts);
+  void (*get_info)(ci_netif* ni, ci_tcp_state* ts, struct ci_tcp_info* info);
+  void (*dump)(ci_netif* ni, ci_tcp_state* ts, const char* pf,
+               oo_dump_log_fn_t logger, void* log_arg);
+};
+
+
+ci_inline ci_uint32 ci_tcp_cong_usticks(ci_netif* ni)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  return (ci_uint32) (its->frc >> its->ci_ip_time_frc2us);
+}
+
+ci_inline ci_uint32 ci_tcp_cong_ms2usticks(ci_netif* ni, ci_uint32 ms)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  return (ci_uint32) (((ci_uint64) ms * its->khz) >> its->ci_ip_time_frc2us);
+}
+
+static ci_uint32 ci_tcp_cong_usticks2us(ci_netif* ni, ci_uint32 t)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  if( its->khz == 0 )
+    return 0;
+  return (ci_uint32) ((((ci_uint64) t << its->ci_ip_time_frc2us) * 1000) /
+                      its->khz);
+}
+
+
+/**********************************************************************
+ * CUBIC (RFC8312)
+ *
+ * Window is in bytes, time in ms.  W(t) = C*(t-K)^3 + W_max with C=0.4
+ * segments/s^3 gives the target; cwnd grows towards it by
+ * (target-cwnd)/cwnd per byte acked.  HyStart is not implemented: slow
+ * start is the same as reno's.
+ */
+
+#define CUBIC_BETA        717   /* multiplicative decrease, 0.7 << 10 */
+#define CUBIC_FAST_CONV   870   /* (1 + beta) / 2 << 10 */
+#define CUBIC_RENO_ALPHA  542   /* 3 * (1 - beta) / (1 + beta) << 10 */
+/* 1 / C in ms^3 per segment: 10^9 / 0.4 */
+#define CUBIC_INV_C       2500000000ull
+
+#define CUBIC_MAX_DIFF    (1u << 30)
+#define CUBIC_MAX_T       (1 << 20)
+
+
+/* Integer cube root, rounded down. */
+static ci_uint32 ci_tcp_cubic_cbrt(ci_uint64 x)
+{
+  ci_uint64 y = 0;
+  int s;
+
+  for( s = 63; s >= 0; s -= 3 ) {
+    ci_uint64 b;
+    y <<= 1;
+    b = 3 * y * (y + 1) + 1;
+    if( (x >> s) >= b ) {
+      x -= b << s;
+      y++;
+    }
+  }
+  return (ci_uint32) y;
+}
+
+
+static void ci_tcp_cubic_init(ci_netif* ni, ci_tcp_state* ts)
+{
+  memset(&ts->cong.cubic, 0, sizeof(ts->cong.cubic));
+}
+
+
+static void ci_tcp_cubic_epoch_start(ci_netif* ni, ci_tcp_state* ts,
+                                     ci_uint32 now)
+{
+  unsigned mss = tcp_eff_mss(ts);
+
+  ts->cong.cubic.epoch_start = now | 1;
+  ts->cong.cubic.w_est = ts->cwnd;
+  if( ts->cong.cubic.w_max > ts->cwnd ) {
+    ci_uint64 diff = CI_MIN(ts->cong.cubic.w_max - ts->cwnd, CUBIC_MAX_DIFF);
+    ts->cong.cubic.k = ci_tcp_cubic_cbrt(diff * CUBIC_INV_C / mss);
+    ts->cong.cubic.origin = ts->cong.cubic.w_max;
+  }
+  else {
+    ts->cong.cubic.k = 0;
+    ts->cong.cubic.origin = ts->cwnd;
+  }
+}
+
+
+static ci_uint32 ci_tcp_cubic_target(ci_netif* ni, ci_tcp_state* ts,
+                                     ci_uint32 now)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  unsigned mss = tcp_eff_mss(ts);
+  /* epoch_start is rounded up to be non-zero */
+  ci_int32 elapsed = CI_MAX((ci_int32) (now - ts->cong.cubic.epoch_start), 0);
+  ci_uint64 t, delta;
+  ci_int64 d;
+
+  /* Where the window should be one RTT from now. */
+  t = ((ci_uint64) elapsed << its->ci_ip_time_frc2us) / its->khz;
+  t += ci_ip_time_ticks2ms(ni, tcp_srtt(ts));
+  d = (ci_int64) t - ts->cong.cubic.k;
+  t = CI_MIN(d < 0 ? -d : d, CUBIC_MAX_T);
+  delta = CI_MIN(t * t * t / (CUBIC_INV_C / mss), CUBIC_MAX_DIFF);
+
+  if( d >= 0 )
+    return ts->cong.cubic.origin + (ci_uint32) delta;
+  if( delta + mss < ts->cong.cubic.origin )
+    return ts->cong.cubic.origin - (ci_uint32) delta;
+  return mss;
+}
+
+
+static void ci_tcp_cubic_on_ack(ci_netif* ni, ci_tcp_state* ts,
+                                ci_uint32 ack, unsigned acked)
+{
+  unsigned mss = tcp_eff_mss(ts);
+  ci_uint32 now, target;
+  ci_uint64 inc;
+
+  if( ts->congstate != CI_TCP_CONG_OPEN ) {
+    /* No growth until recovered: ci_tcp_recovered() sets the window. */
+    ts->bytes_acked = 0;
+    return;
+  }
+  if( ts->cwnd < ts->ssthresh ) {
+    ci_tcp_opencwnd_slow_start(ts);
+    return;
+  }
+
+  now = ci_tcp_cong_usticks(ni);
+  if( ts->cong.cubic.epoch_start == 0 )
+    ci_tcp_cubic_epoch_start(ni, ts, now);
+
+  target = ci_tcp_cubic_target(ni, ts, now);
+
+  /* TCP-friendly region: never grow slower than reno would. */
+  ts->cong.cubic.w_est += ((ci_uint64) acked * mss * CUBIC_RENO_ALPHA >> 10) /
+                          ts->cwnd;
+  target = CI_MAX(target, ts->cong.cubic.w_est);
+
+  if( target > ts->cwnd ) {
+    inc = (ci_uint64) (target - ts->cwnd) * ts->bytes_acked / ts->cwnd;
+    /* Grow by at most 1.5x per RTT. */
+    inc = CI_MIN(inc, ts->bytes_acked >> 1);
+  }
+  else {
+    /* On the plateau: grow very slowly (one segment per 100 RTTs). */
+    inc = (ci_uint64) ts->bytes_acked * mss / (100 * ts->cwnd);
+  }
+
+  if( inc > 0 ) {
+    ts->cwnd += (ci_uint32) inc;
+    ts->bytes_acked = 0;
+  }
+
+  LOG_TV(log(LPF "%d CUBIC: cwnd=%u target=%u w_max=%u k=%u", S_FMT(ts),
+             ts->cwnd, target, ts->cong.cubic.w_max, ts->cong.cubic.k));
+}
+
+
+static unsigned ci_tcp_cubic_losswnd(ci_netif* ni, ci_tcp_state* ts)
+{
+  unsigned w = ci_tcp_inflight(ts);
+
+  /* Fast convergence: release bandwidth to new flows. */
+  if( w < ts->cong.cubic.w_max )
+    ts->cong.cubic.w_max = (ci_uint64) w * CUBIC_FAST_CONV >> 10;
+  else
+    ts->cong.cubic.w_max = w;
+  ts->cong.cubic.epoch_start = 0;
+
+  return CI_MAX((ci_uint32) ((ci_uint64) w * CUBIC_BETA >> 10),
+                tcp_eff_mss(ts) << 1u);
+}
+
+
+static void ci_tcp_cubic_idle_restart(ci_netif* ni, ci_tcp_state* ts)
+{
+  ts->cong.cubic.epoch_start = 0;
+}
+
+
+static void ci_tcp_cubic_dump(ci_netif* ni, ci_tcp_state* ts, const char* pf,
+                              oo_dump_log_fn_t logger, void* log_arg)
+{
+  logger(log_arg, "%s  cong: cubic w_max=%u origin=%u k=%ums w_est=%u%s",
+         pf, ts->cong.cubic.w_max, ts->cong.cubic.origin, ts->cong.cubic.k,
+         ts->cong.cubic.w_est, ts->cong.cubic.epoch_start ? "" : " idle");
+}
+
+
+/**********************************************************************
+ * BBR version 1
+ *
+ * The model is the max delivery rate over the last 5-10 rounds and the
+ * min round time over the last 10s.  Both are sampled once per round trip
+ * rather than per packet: a round ends when the first byte sent after its
+ * start is acked.
+ *
+ * With EF_TCP_PACING the pacer sends at the pacing gain times the max
+ * delivery rate.  Otherwise the gains only drive the cwnd and the state
+ * machine, and the pacing rate is just reported through TCP_INFO.
+ *
+ * Delivery rate is in bytes per 1024 usticks, gains are in 1/256.
+ */
+
+#define BBR_UNIT            256
+#define BBR_HIGH_GAIN       739   /* 2/ln(2) */
+#define BBR_DRAIN_GAIN      88    /* 1/high_gain */
+#define BBR_CWND_GAIN       512
+#define BBR_FULL_BW_THRESH  320   /* grow by 25%... */
+#define BBR_FULL_BW_CNT     3     /* ...in 3 rounds, or startup is done */
+#define BBR_BW_WIN_ROUNDS   5
+#define BBR_MIN_RTT_WIN_MS  10000
+#define BBR_PROBE_RTT_MS    200
+#define BBR_MIN_CWND_SEGS   4
+#define BBR_CYCLE_LEN       8
+
+#define BBR_STARTUP         0
+#define BBR_DRAIN           1
+#define BBR_PROBE_BW        2
+#define BBR_PROBE_RTT       3
+
+#define BBR_FLAG_FULL_BW          0x1
+#define BBR_FLAG_APP_LIMITED      0x2
+#define BBR_FLAG_PROBE_RTT_ROUND  0x4
+
+static const ci_uint16 bbr_cycle_gain[BBR_CYCLE_LEN] = {
+  320, 192, 256, 256, 256, 256, 256, 256
+};
+
+static const char* const bbr_mode_str[] = {
+  "STARTUP", "DRAIN", "PROBE_BW", "PROBE_RTT"
+};
+
+
+ci_inline ci_uint32 ci_tcp_bbr_max_bw(ci_tcp_state* ts)
+{
+  return CI_MAX(ts->cong.bbr.bw[0], ts->cong.bbr.bw[1]);
+}
+
+static unsigned ci_tcp_bbr_pacing_gain(ci_tcp_state* ts)
+{
+  switch( ts->cong.bbr.mode ) {
+  case BBR_STARTUP:
+    return BBR_HIGH_GAIN;
+  case BBR_DRAIN:
+    return BBR_DRAIN_GAIN;
+  case BBR_PROBE_BW:
+    return bbr_cycle_gain[ts->cong.bbr.cycle_idx & (BBR_CYCLE_LEN - 1)];
+  default:
+    return BBR_UNIT;
+  }
+}
+
+static unsigned ci_tcp_bbr_cwnd_gain(ci_tcp_state* ts)
+{
+  switch( ts->cong.bbr.mode ) {
+  case BBR_STARTUP:
+    return BBR_HIGH_GAIN;
+  case BBR_DRAIN:
+    /* Without pacing the queue built in STARTUP can only be drained by
+     * limiting cwnd. */
+    return BBR_UNIT;
+  case BBR_PROBE_BW:
+    return BBR_CWND_GAIN;
+  default:
+    return BBR_UNIT;
+  }
+}
+
+/* Bandwidth-delay product scaled by gain, or 0 if there is no model yet. */
+static ci_uint32 ci_tcp_bbr_bdp(ci_tcp_state* ts, unsigned gain)
+{
+  ci_uint64 bdp = (ci_uint64) ci_tcp_bbr_max_bw(ts) * ts->cong.bbr.min_rtt;
+  bdp = ((bdp >> 10) * gain) >> 8;
+  return (ci_uint32) CI_MIN(bdp, 0x7fffffffull);
+}
+
+static unsigned ci_tcp_bbr_min_cwnd(ci_netif* ni, ci_tcp_state* ts)
+{
+  return CI_MAX(tcp_eff_mss(ts) * BBR_MIN_CWND_SEGS, NI_OPTS(ni).min_cwnd);
+}
+
+static void ci_tcp_bbr_save_cwnd(ci_tcp_state* ts)
+{
+  if( ts->congstate == CI_TCP_CONG_OPEN && ts->cong.bbr.mode != BBR_PROBE_RTT )
+    ts->cong.bbr.prior_cwnd = ts->cwnd;
+  else
+    ts->cong.bbr.prior_cwnd = CI_MAX(ts->cong.bbr.prior_cwnd, ts->cwnd);
+}
+
+
+static void ci_tcp_bbr_init(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_uint32 now = ci_tcp_cong_usticks(ni);
+
+  memset(&ts->cong.bbr, 0, sizeof(ts->cong.bbr));
+  ts->cong.bbr.mode = BBR_STARTUP;
+  ts->cong.bbr.round_start = now;
+  ts->cong.bbr.round_seq = tcp_snd_una(ts);
+  ts->cong.bbr.round_end = tcp_snd_nxt(ts);
+  ts->cong.bbr.min_rtt_stamp = now;
+}
+
+
+static void ci_tcp_bbr_enter_probe_bw(ci_netif* ni, ci_tcp_state* ts,
+                                      ci_uint32 now)
+{
+  ts->cong.bbr.mode = BBR_PROBE_BW;
+  /* Start in one of the cruising phases, so that flows which enter
+   * PROBE_BW together do not probe in sync. */
+  ts->cong.bbr.cycle_idx = 2 + (now >> 4) % (BBR_CYCLE_LEN - 2);
+  ts->cong.bbr.mode_stamp = now;
+}
+
+
+/* A round trip has completed: update the model. */
+static void ci_tcp_bbr_round_end(ci_netif* ni, ci_tcp_state* ts,
+                                 ci_uint32 ack, ci_uint32 now, int expired)
+{
+  ci_uint32 elapsed = now - ts->cong.bbr.round_start;
+  ci_uint32 delivered = SEQ_SUB(ack, ts->cong.bbr.round_seq);
+  int app_limited = ts->cong.bbr.flags & BBR_FLAG_APP_LIMITED;
+
+  if( elapsed > 0 ) {
+    ci_uint64 sample = ((ci_uint64) delivered << 10) / elapsed;
+    sample = CI_MIN(sample, 0xffffffffull);
+    /* App-limited samples underestimate the path, so only use them if they
+     * raise the estimate. */
+    if( ! app_limited || sample > ci_tcp_bbr_max_bw(ts) )
+      ts->cong.bbr.bw[0] = CI_MAX(ts->cong.bbr.bw[0], (ci_uint32) sample);
+
+    /* The round time overestimates RTT if the sender was idle, which is
+     * harmless for a min filter. */
+    if( ts->cong.bbr.min_rtt == 0 || elapsed < ts->cong.bbr.min_rtt ||
+        expired ) {
+      ts->cong.bbr.min_rtt = elapsed;
+      ts->cong.bbr.min_rtt_stamp = now;
+    }
+  }
+
+  if( ++ts->cong.bbr.bw_rounds >= BBR_BW_WIN_ROUNDS ) {
+    ts->cong.bbr.bw[1] = ts->cong.bbr.bw[0];
+    ts->cong.bbr.bw[0] = 0;
+    ts->cong.bbr.bw_rounds = 0;
+  }
+
+  if( ! (ts->cong.bbr.flags & BBR_FLAG_FULL_BW) && ! app_limited ) {
+    ci_uint32 bw = ci_tcp_bbr_max_bw(ts);
+    if( bw >= ((ci_uint64) ts->cong.bbr.full_bw * BBR_FULL_BW_THRESH >> 8) ) {
+      ts->cong.bbr.full_bw = bw;
+      ts->cong.bbr.full_bw_cnt = 0;
+    }
+    else if( ++ts->cong.bbr.full_bw_cnt >= BBR_FULL_BW_CNT ) {
+      ts->cong.bbr.flags |= BBR_FLAG_FULL_BW;
+    }
+  }
+
+  if( ts->cong.bbr.mode == BBR_PROBE_RTT && ts->cong.bbr.mode_stamp != 0 )
+    ts->cong.bbr.flags |= BBR_FLAG_PROBE_RTT_ROUND;
+
+  ts->cong.bbr.round_start = now;
+  ts->cong.bbr.round_seq = ack;
+  ts->cong.bbr.round_end = tcp_snd_nxt(ts);
+  ts->cong.bbr.flags &= ~BBR_FLAG_APP_LIMITED;
+}
+
+
+static void ci_tcp_bbr_update_mode(ci_netif* ni, ci_tcp_state* ts,
+                                   ci_uint32 now, unsigned inflight,
+                                   int expired)
+{
+  switch( ts->cong.bbr.mode ) {
+  case BBR_STARTUP:
+    if( ts->cong.bbr.flags & BBR_FLAG_FULL_BW ) {
+      ts->cong.bbr.mode = BBR_DRAIN;
+      ts->ssthresh = CI_MAX(ci_tcp_bbr_bdp(ts, BBR_UNIT),
+                            tcp_eff_mss(ts) << 1u);
+    }
+    break;
+  case BBR_DRAIN:
+    if( inflight <= ci_tcp_bbr_bdp(ts, BBR_UNIT) )
+      ci_tcp_bbr_enter_probe_bw(ni, ts, now);
+    break;
+  case BBR_PROBE_BW: {
+    unsigned gain = bbr_cycle_gain[ts->cong.bbr.cycle_idx];
+    int full = (ci_int32) (now - ts->cong.bbr.mode_stamp) >
+               (ci_int32) ts->cong.bbr.min_rtt;
+    int advance;
+    if( gain > BBR_UNIT )
+      advance = full && (ts->congstate != CI_TCP_CONG_OPEN ||
+                         inflight >= ci_tcp_bbr_bdp(ts, gain));
+    else if( gain < BBR_UNIT )
+      advance = full || inflight <= ci_tcp_bbr_bdp(ts, BBR_UNIT);
+    else
+      advance = full;
+    if( advance ) {
+      ts->cong.bbr.cycle_idx = (ts->cong.bbr.cycle_idx + 1) &
+                               (BBR_CYCLE_LEN - 1);
+      ts->cong.bbr.mode_stamp = now;
+    }
+    break;
+  }
+  case BBR_PROBE_RTT:
+    if( ts->cong.bbr.mode_stamp == 0 ) {
+      if( inflight <= ci_tcp_bbr_min_cwnd(ni, ts) ) {
+        ts->cong.bbr.mode_stamp = (now + ci_tcp_cong_ms2usticks(ni,
+                                            BBR_PROBE_RTT_MS)) | 1;
+        ts->cong.bbr.flags &= ~BBR_FLAG_PROBE_RTT_ROUND;
+      }
+    }
+    else if( (ts->cong.bbr.flags & BBR_FLAG_PROBE_RTT_ROUND) &&
+             (ci_int32) (now - ts->cong.bbr.mode_stamp) >= 0 ) {
+      ts->cong.bbr.min_rtt_stamp = now;
+      ts->cwnd = CI_MAX(ts->cwnd, ts->cong.bbr.prior_cwnd);
+      if( ts->cong.bbr.flags & BBR_FLAG_FULL_BW )
+        ci_tcp_bbr_enter_probe_bw(ni, ts, now);
+      else
+        ts->cong.bbr.mode = BBR_STARTUP;
+    }
+    break;
+  }
+
+  if( expired && ts->cong.bbr.mode != BBR_PROBE_RTT ) {
+    ci_tcp_bbr_save_cwnd(ts);
+    ts->cong.bbr.mode = BBR_PROBE_RTT;
+    ts->cong.bbr.mode_stamp = 0;
+  }
+}
+
+
+static void ci_tcp_bbr_on_ack(ci_netif* ni, ci_tcp_state* ts,
+                              ci_uint32 ack, unsigned acked)
+{
+  ci_uint32 now = ci_tcp_cong_usticks(ni);
+  unsigned inflight = SEQ_SUB(tcp_snd_nxt(ts), ack);
+  unsigned min_cwnd = ci_tcp_bbr_min_cwnd(ni, ts);
+  ci_uint32 target;
+  int expired;
+
+  if( ci_tcp_sendq_is_empty(ts) && inflight < ts->cwnd )
+    ts->cong.bbr.flags |= BBR_FLAG_APP_LIMITED;
+
+  expired = ts->cong.bbr.min_rtt != 0 &&
+            (ci_int32) (now - ts->cong.bbr.min_rtt_stamp) >
+            (ci_int32) ci_tcp_cong_ms2usticks(ni, BBR_MIN_RTT_WIN_MS);
+
+  if( SEQ_GT(ack, ts->cong.bbr.round_end) )
+    ci_tcp_bbr_round_end(ni, ts, ack, now, expired);
+  ci_tcp_bbr_update_mode(ni, ts, now, inflight, expired);
+
+  target = ci_tcp_bbr_bdp(ts, ci_tcp_bbr_cwnd_gain(ts));
+  if( target != 0 )
+    target += 3 * tcp_eff_mss(ts);
+
+  if( ts->congstate != CI_TCP_CONG_OPEN )
+    /* Packet conservation: send as much as was delivered. */
+    ts->cwnd = CI_MAX(ts->cwnd, inflight + acked);
+  else if( (ts->cong.bbr.flags & BBR_FLAG_FULL_BW) && target != 0 )
+    ts->cwnd = CI_MIN(ts->cwnd + acked, target);
+  else if( ts->cwnd < target || target == 0 )
+    ts->cwnd += acked;
+  ts->cwnd = CI_MAX(ts->cwnd, min_cwnd);
+  if( ts->cong.bbr.mode == BBR_PROBE_RTT )
+    ts->cwnd = CI_MIN(ts->cwnd, min_cwnd);
+  ts->bytes_acked = 0;
+
+  LOG_TV(log(LPF "%d BBR: %s cwnd=%u bw=%u min_rtt=%u inflight=%u",
+             S_FMT(ts), bbr_mode_str[ts->cong.bbr.mode], ts->cwnd,
+             ci_tcp_bbr_max_bw(ts), ts->cong.bbr.min_rtt, inflight));
+}
+
+
+static unsigned ci_tcp_bbr_losswnd(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_tcp_bbr_save_cwnd(ts);
+  return CI_MAX(ci_tcp_inflight(ts), tcp_eff_mss(ts) << 1u);
+}
+
+
+static void ci_tcp_bbr_recovered(ci_netif* ni, ci_tcp_state* ts)
+{
+  ts->cwnd = CI_MAX(ts->cwnd, ts->cong.bbr.prior_cwnd);
+}
+
+
+static ci_uint32 ci_tcp_bbr_pacing_rate(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_uint64 rate = (ci_uint64) ci_tcp_bbr_max_bw(ts) *
+                   ci_tcp_bbr_pacing_gain(ts) >> 8;
+  return (ci_uint32) CI_MIN(rate, 0xffffffffull);
+}
+
+
+static void ci_tcp_bbr_get_info(ci_netif* ni, ci_tcp_state* ts,
+                                struct ci_tcp_info* info)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  /* usticks per second */
+  ci_uint64 hz = ((ci_uint64) its->khz * 1000) >> its->ci_ip_time_frc2us;
+  ci_uint64 bw = ci_tcp_bbr_max_bw(ts);
+
+  info->tcpi_delivery_rate = (bw * hz) >> 10;
+  info->tcpi_pacing_rate = ((ci_uint64) ci_tcp_bbr_pacing_rate(ni, ts) *
+                            hz) >> 10;
+  if( ts->cong.bbr.min_rtt != 0 )
+    info->tcpi_min_rtt = ci_tcp_cong_usticks2us(ni, ts->cong.bbr.min_rtt);
+}
+
+
+static void ci_tcp_bbr_dump(ci_netif* ni, ci_tcp_state* ts, const char* pf,
+                            oo_dump_log_fn_t logger, void* log_arg)
+{
+  logger(log_arg, "%s  cong: bbr %s%s bw=%u,%u min_rtt=%uus cycle=%u "
+         "prior_cwnd=%u", pf, bbr_mode_str[ts->cong.bbr.mode & 3],
+         (ts->cong.bbr.flags & BBR_FLAG_FULL_BW) ? " full_bw" : "",
+         ts->cong.bbr.bw[0], ts->cong.bbr.bw[1],
+         ci_tcp_cong_usticks2us(ni, ts->cong.bbr.min_rtt),
+         ts->cong.bbr.cycle_idx, ts->cong.bbr.prior_cwnd);
+}
+
+
+/**********************************************************************
+ * DCTCP (RFC8257)
+ *
+ * The sender keeps alpha, a moving average of the fraction of bytes acked
+ * with ECE, updated once per window of data with gain g = 1/16.  On ECE
+ * the window is cut by alpha/2 rather than halved.  Window growth and the
+ * response to loss are reno's.  The receiver side (ECE reflects the CE
+ * mark of each segment) is in tcp_rx.c.
+ */
+
+#define DCTCP_ALPHA_SHIFT 10
+#define DCTCP_MAX_ALPHA   (1u << DCTCP_ALPHA_SHIFT)
+#define DCTCP_G_SHIFT     4
+
+
+static void ci_tcp_dctcp_reset(ci_tcp_state* ts)
+{
+  ts->cong.dctcp.acked = 0;
+  ts->cong.dctcp.ce_acked = 0;
+  ts->cong.dctcp.next_seq = tcp_snd_nxt(ts);
+}
+
+
+static void ci_tcp_dctcp_init(ci_netif* ni, ci_tcp_state* ts)
+{
+  /* Start cautious: the first reduction halves the window, as reno. */
+  ts->cong.dctcp.alpha = DCTCP_MAX_ALPHA;
+  ci_tcp_dctcp_reset(ts);
+}
+
+
+static void ci_tcp_dctcp_ecn_ack(ci_netif* ni, ci_tcp_state* ts,
+                                 ci_uint32 ack, unsigned acked, int ece)
+{
+  ci_uint32 alpha = ts->cong.dctcp.alpha;
+  ci_uint32 decay;
+
+  ts->cong.dctcp.acked += acked;
+  if( ece )
+    ts->cong.dctcp.ce_acked += acked;
+  if( SEQ_LT(ack, ts->cong.dctcp.next_seq) )
+    return;
+
+  /* alpha = (1 - g) * alpha + g * F, decaying to zero without marks */
+  decay = alpha >> DCTCP_G_SHIFT;
+  alpha -= decay != 0 ? decay : alpha;
+  if( ts->cong.dctcp.ce_acked != 0 ) {
+    ci_uint64 f = (ci_uint64) ts->cong.dctcp.ce_acked <<
+                  (DCTCP_ALPHA_SHIFT - DCTCP_G_SHIFT);
+    alpha += (ci_uint32) (f / CI_MAX(ts->cong.dctcp.acked, 1u));
+  }
+  ts->cong.dctcp.alpha = CI_MIN(alpha, DCTCP_MAX_ALPHA);
+
+  LOG_TV(log(LPF "%d DCTCP: alpha=%u acked=%u ce_acked=%u", S_FMT(ts),
+             ts->cong.dctcp.alpha, ts->cong.dctcp.acked,
+             ts->cong.dctcp.ce_acked));
+  ci_tcp_dctcp_reset(ts);
+}
+
+
+static unsigned ci_tcp_dctcp_ecn_losswnd(ci_netif* ni, ci_tcp_state* ts)
+{
+  unsigned cut = (ci_uint64) ts->cwnd * ts->cong.dctcp.alpha >>
+                 (DCTCP_ALPHA_SHIFT + 1);
+  return CI_MAX(ts->cwnd - cut, tcp_eff_mss(ts) << 1u);
+}
+
+
+static void ci_tcp_dctcp_dump(ci_netif* ni, ci_tcp_state* ts, const char* pf,
+                              oo_dump_log_fn_t logger, void* log_arg)
+{
+  logger(log_arg, "%s  cong: dctcp alpha=%u/%u acked=%u ce_acked=%u", pf,
+         ts->cong.dctcp.alpha, DCTCP_MAX_ALPHA, ts->cong.dctcp.acked,
+         ts->cong.dctcp.ce_acked);
+}
+
+
+/**********************************************************************
+ * Dispatch
+ */
+
+static const struct ci_tcp_cong_ops ci_tcp_cong_algs[] = {
+  [EF_TCP_CONG_CONTROL_RENO] = {
+    .name = "reno",
+  },
+  [EF_TCP_CONG_CONTROL_CUBIC] = {
+    .name = "cubic",
+    .init = ci_tcp_cubic_init,
+    .on_ack = ci_tcp_cubic_on_ack,
+    .losswnd = ci_tcp_cubic_losswnd,
+    .idle_restart = ci_tcp_cubic_idle_restart,
+    .dump = ci_tcp_cubic_dump,
+  },
+  [EF_TCP_CONG_CONTROL_BBR] = {
+    .name = "bbr",
+    .init = ci_tcp_bbr_init,
+    .on_ack = ci_tcp_bbr_on_ack,
+    .losswnd = ci_tcp_bbr_losswnd,
+    .recovered = ci_tcp_bbr_recovered,
+    .pacing_rate = ci_tcp_bbr_pacing_rate,
+    .get_info = ci_tcp_bbr_get_info,
+    .dump = ci_tcp_bbr_dump,
+  },
+  [EF_TCP_CONG_CONTROL_DCTCP] = {
+    .name = "dctcp",
+    .init = ci_tcp_dctcp_init,
+    .ecn_ack = ci_tcp_dctcp_ecn_ack,
+    .ecn_losswnd = ci_tcp_dctcp_ecn_losswnd,
+    .dump = ci_tcp_dctcp_dump,
+  },
+};
+CI_BUILD_ASSERT(sizeof(ci_tcp_cong_algs) / sizeof(ci_tcp_cong_algs[0]) ==
+                EF_TCP_CONG_CONTROL_MAX + 1);
+
+
+static const struct ci_tcp_cong_ops* ci_tcp_cong_ops(ci_tcp_state* ts)
+{
+  /* Shared state: do not trust it. */
+  unsigned alg = ts->c.cong_alg;
+  if(CI_UNLIKELY( alg > EF_TCP_CONG_CONTROL_MAX ))
+    alg = EF_TCP_CONG_CONTROL_RENO;
+  return &ci_tcp_cong_algs[alg];
+}
+
+
+const char* ci_tcp_cong_name(int alg)
+{
+  if( alg < 0 || alg > EF_TCP_CONG_CONTROL_MAX )
+    return "unknown";
+  return ci_tcp_cong_algs[alg].name;
+}
+
+
+int ci_tcp_cong_by_name(const char* name)
+{
+  int alg;
+  for( alg = 0; alg <= EF_TCP_CONG_CONTROL_MAX; ++alg )
+    if( strcmp(name, ci_tcp_cong_algs[alg].name) == 0 )
+      return alg;
+  return -ENOENT;
+}
+
+
+void ci_tcp_cong_init(ci_netif* ni, ci_tcp_state* ts)
+{
+  const struct ci_tcp_cong_ops* ops = ci_tcp_cong_ops(ts);
+  if( ops->init != NULL )
+    ops->init(ni, ts);
+}
+
+
+/* Returns false if the caller should open the window as reno does. */
+int ci_tcp_cong_on_ack(ci_netif* ni, ci_tcp_state* ts, ci_uint32 ack,
+                       unsigned acked)
+{
+  const struct ci_tcp_cong_ops* ops = ci_tcp_cong_ops(ts);
+
+  if( ops->on_ack == NULL )
+    return 0;
+  ops->on_ack(ni, ts, ack, acked);
+
+  ci_assert_ge(ts->cwnd, tcp_eff_mss(ts));
+  ci_assert_ge(ts->ssthresh, (ci_uint32)(tcp_eff_mss(ts) << 1));
+  return 1;
+}
+
+
+unsigned ci_tcp_cong_losswnd_slow(ci_netif* ni, ci_tcp_state* ts)
+{
+  const struct ci_tcp_cong_ops* ops = ci_tcp_cong_ops(ts);
+  if( ops->losswnd != NULL )
+    return ops->losswnd(ni, ts);
+  return ci_tcp_losswnd(ts);
+}
+
+
+void ci_tcp_cong_ecn_ack(ci_netif* ni, ci_tcp_state* ts, ci_uint32 ack,
+                         unsigned acked, int ece)
+{
+  const struct ci_tcp_cong_ops* ops = ci_tcp_cong_ops(ts);
+  if( ops->ecn_ack != NULL )
+    ops->ecn_ack(ni, ts, ack, acked, ece);
+}
+
+
+/* New value for [ssthresh] on ECE.  RFC3168 says to react as to loss. */
+unsigned ci_tcp_cong_ecn_losswnd(ci_netif* ni, ci_tcp_state* ts)
+{
+  const struct ci_tcp_cong_ops* ops = ci_tcp_cong_ops(ts);
+  if( ops->ecn_losswnd != NULL )
+    return ops->ecn_losswnd(ni, ts);
+  return ci_tcp_cong_losswnd(ni, ts);
+}
+
+
+void ci_tcp_cong_recovered(ci_netif* ni, ci_tcp_state* ts)
+{
+  const struct ci_tcp_cong_ops* ops = ci_tcp_cong_ops(ts);
+  if( ops->recovered != NULL )
+    ops->recovered(ni, ts);
+}
+
+
+void ci_tcp_cong_idle_restart(ci_netif* ni, ci_tcp_state* ts)
+{
+  const struct ci_tcp_cong_ops* ops = ci_tcp_cong_ops(ts);
+  if( ops->idle_restart != NULL )
+    ops->idle_restart(ni, ts);
+}
+
+
+void ci_tcp_cong_get_info(ci_netif* ni, ci_tcp_state* ts,
+                          struct ci_tcp_info* info)
+{
+  const struct ci_tcp_cong_ops* ops = ci_tcp_cong_ops(ts);
+  if( ops->get_info != NULL )
+    ops->get_info(ni, ts, info);
+#if CI_CFG_TCP_PACING
+  ci_tcp_pace_get_info(ni, ts, info);
+#endif
+}
+
+
+void ci_tcp_cong_dump(ci_netif* ni, ci_tcp_state* ts, const char* pf,
+                      oo_dump_log_fn_t logger, void* log_arg)
+{
+  const struct ci_tcp_cong_ops* ops = ci_tcp_cong_ops(ts);
+  if( ops->dump != NULL )
+    ops->dump(ni, ts, pf, logger, log_arg);
+}
+
+/*! \cidoxg_end */
+
+
+#if CI_CFG_TCP_PACING
+/**********************************************************************
+ * Pacing
+ *
+ * The pacer is a token bucket: [pace_credit] bytes may be sent now, and it
+ * is topped up at the pacing rate to at most one timer tick's worth (and
+ * at least two segments).  ci_tcp_tx_advance() does not send beyond the
+ * credit, and the pace timer sends the rest on the next tick.  So data is
+ * released in bursts of a tick, which is as fine as the timer wheel goes.
+ *
+ * Rates are in bytes per 1024 usticks, as BBR's model is.
+ */
+
+/* Twice cwnd/srtt in slow start and 1.2 times after it, as Linux does. */
+#define PACE_SS_RATIO  512
+#define PACE_CA_RATIO  307
+
+
+static ci_uint32 ci_tcp_pace_bps2rate(ci_netif* ni, ci_uint64 bps)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  /* usticks per second */
+  ci_uint64 hz = ((ci_uint64) its->khz * 1000) >> its->ci_ip_time_frc2us;
+  ci_uint64 rate;
+
+  if( hz == 0 )
+    return 0;
+  rate = (CI_MIN(bps, 1ull << 53) << 10) / hz;
+  return (ci_uint32) CI_MAX(CI_MIN(rate, 0xffffffffull), 1ull);
+}
+
+
+/* Returns the rate to pace the connection at, or 0 if it is not paced. */
+static ci_uint32 ci_tcp_pace_rate(ci_netif* ni, ci_tcp_state* ts)
+{
+  const struct ci_tcp_cong_ops* ops = ci_tcp_cong_ops(ts);
+  ci_uint32 rate = 0;
+
+  if( NI_OPTS(ni).tcp_pacing ) {
+    if( ops->pacing_rate != NULL )
+      rate = ops->pacing_rate(ni, ts);
+    /* [sa] is srtt in ticks << 3.  Below a tick it is too inaccurate to
+     * derive a rate from, and the timer could not pace it anyway. */
+    if( rate == 0 && ts->sa >= 8 ) {
+      ci_ip_timer_state* its = IPTIMER_STATE(ni);
+      unsigned ratio = ts->cwnd < ts->ssthresh / 2 ?
+                       PACE_SS_RATIO : PACE_CA_RATIO;
+      ci_uint64 srtt8 = (ci_uint64) ts->sa <<
+                        (its->ci_ip_time_frc2tick - its->ci_ip_time_frc2us);
+      ci_uint64 r = (((ci_uint64) ts->cwnd * ratio) << (10 + 3 - 8)) / srtt8;
+      rate = (ci_uint32) CI_MAX(CI_MIN(r, 0xffffffffull), 1ull);
+    }
+  }
+
+  if( ts->c.max_pacing_rate != CI_TCP_PACING_RATE_UNLIMITED ) {
+    ci_uint32 max = ci_tcp_pace_bps2rate(ni, ts->c.max_pacing_rate);
+    if( rate == 0 || max < rate )
+      rate = max;
+  }
+  return rate;
+}
+
+
+/* Returns the number of bytes which may be sent now, or -1 if the
+ * connection is not paced. */
+int ci_tcp_pace_budget(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  ci_uint32 rate = ci_tcp_pace_rate(ni, ts);
+  ci_uint32 now = ci_tcp_cong_usticks(ni);
+  ci_uint64 burst, credit;
+
+  if( rate == 0 )
+    return -1;
+
+  burst = ((ci_uint64) rate <<
+           (its->ci_ip_time_frc2tick - its->ci_ip_time_frc2us)) >> 10;
+  burst = CI_MIN(CI_MAX(burst, (ci_uint64) tcp_eff_mss(ts) << 1),
+                 0x7fffffffull);
+  credit = CI_MAX(ts->pace_credit, 0) +
+           (((ci_uint64) rate * (ci_uint32) (now - ts->pace_stamp)) >> 10);
+  ts->pace_credit = (ci_int32) CI_MIN(credit, burst);
+  ts->pace_stamp = now;
+  return ts->pace_credit;
+}
+
+
+void ci_tcp_pace_sent(ci_netif* ni, ci_tcp_state* ts, unsigned bytes)
+{
+  ts->pace_credit -= CI_MIN(bytes, (unsigned) ts->pace_credit);
+}
+
+
+void ci_tcp_pace_get_info(ci_netif* ni, ci_tcp_state* ts,
+                          struct ci_tcp_info* info)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  ci_uint64 hz = ((ci_uint64) its->khz * 1000) >> its->ci_ip_time_frc2us;
+  ci_uint32 rate = ci_tcp_pace_rate(ni, ts);
+
+  if( rate != 0 )
+    info->tcpi_pacing_rate = ((ci_uint64) rate * hz) >> 10;
+}
+#endif
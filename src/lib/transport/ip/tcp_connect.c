@@ -1117,9 +1117,13 @@ static int ci_tcp_connect_ul_start(ci_netif *ni, ci_tcp_state* ts, ci_fd_t fd,
 
   /* Must be after initialising snd_una. */
   ci_tcp_clear_rtt_timing(ts);
-  ci_tcp_set_flags(ts, CI_TCP_FLAG_SYN);
   ts->tcpflags &=~ CI_TCPT_FLAG_OPT_MASK;
-  ts->tcpflags |= NI_OPTS(ni).syn_opts;
+  ts->tcpflags |= ci_tcp_syn_opts(ni, &ts->c);
+  /* ECN-setup SYN (RFC3168 6.1.1) */
+  if( ts->tcpflags & CI_TCPT_FLAG_ECN )
+    ci_tcp_set_flags(ts, CI_TCP_FLAG_SYN | CI_TCP_FLAG_ECE | CI_TCP_FLAG_CWR);
+  else
+    ci_tcp_set_flags(ts, CI_TCP_FLAG_SYN);
 
   if( (ts->tcpflags & CI_TCPT_FLAG_WSCL) ) {
     if( NI_OPTS(ni).tcp_rcvbuf_mode == 1 )
@@ -1170,8 +1174,24 @@ static int ci_tcp_connect_ul_start(ci_netif *ni, ci_tcp_state* ts, ci_fd_t fd,
   /* If ARP resolution fails, we have to drop the connection, so we store
    * the socket id in the SYN packet. */
   pkt->pf.tcp_tx.sock_id = ts->s.b.bufid;
+#if CI_CFG_TCP_FASTOPEN
+  /* With a cookie for the server, hold the SYN back until the first send
+   * so it can carry the data.  Without one, the SYN asks for a cookie. */
+  ts->tcpflags &=~ (CI_TCPT_FLAG_FASTOPEN_DEFER | CI_TCPT_FLAG_FASTOPEN_DATA);
+  if( (ts->tcpflags & CI_TCPT_FLAG_FASTOPEN) &&
+      ! (ts->s.pkt.flags & CI_IP_CACHE_IS_LOCALROUTE) &&
+      ci_tcp_fastopen_cache_get(ni, ipcache_raddr(&ts->s.pkt), NULL) > 0 )
+    ts->tcpflags |= CI_TCPT_FLAG_FASTOPEN_DEFER;
+#endif
   ci_tcp_enqueue_no_data(ts, ni, pkt);
   ci_tcp_set_flags(ts, CI_TCP_FLAG_ACK);  
+#if CI_CFG_TCP_FASTOPEN
+  if( ts->tcpflags & CI_TCPT_FLAG_FASTOPEN_DEFER ) {
+    LOG_TC(log(LNT_FMT "TFO connect deferred until first send",
+               LNT_PRI_ARGS(ni, ts)));
+    return CI_CONNECT_UL_OK;
+  }
+#endif
 
   if( ts->s.b.sb_aflags & (CI_SB_AFLAG_O_NONBLOCK | CI_SB_AFLAG_O_NDELAY) ) {
     ts->tcpflags |= CI_TCPT_FLAG_NONBLOCK_CONNECT;
@@ -1483,6 +1503,11 @@ int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
     else {
       /* Socket is in SYN-SENT state. Let's block for receiving SYN-ACK */
       ci_assert_equal(s->b.state, CI_TCP_SYN_SENT);
+#if CI_CFG_TCP_FASTOPEN
+      if( ts->tcpflags & CI_TCPT_FLAG_FASTOPEN_DEFER )
+        CI_SET_ERROR(rc, EISCONN);
+      else
+#endif
       if( s->b.sb_aflags & (CI_SB_AFLAG_O_NONBLOCK | CI_SB_AFLAG_O_NDELAY) )
         CI_SET_ERROR(rc, EALREADY);
       else
@@ -1580,6 +1605,12 @@ int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
     }
   }
   CI_TCP_STATS_INC_ACTIVE_OPENS( ep->netif );
+#if CI_CFG_TCP_FASTOPEN
+  /* Connected as far as the app is concerned; the SYN goes with the
+   * first send. */
+  if( ts->tcpflags & CI_TCPT_FLAG_FASTOPEN_DEFER )
+    goto unlock_out;
+#endif
 
  syn_sent:
   rc = ci_tcp_connect_ul_syn_sent(ep->netif, ts);
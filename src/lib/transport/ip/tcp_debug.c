@@ -792,6 +792,7 @@ void ci_tcp_state_dump(ci_netif* ni, ci_tcp_state* ts,
   logger(log_arg, "%s  snd: cwnd=%d+%d used=%d ssthresh=%d bytes_acked=%d %s",
          pf, ts->cwnd, ts->cwnd_extra, tcp_cwnd_used(ts),
          ts->ssthresh, ts->bytes_acked, congstate_str(ts));
+  ci_tcp_cong_dump(ni, ts, pf, logger, log_arg);
   logger(log_arg, "%s  snd: timed_seq %x timed_ts %x",
          pf, ts->timed_seq, ts->timed_ts);
   logger(log_arg, "%s  snd: sndbuf_pkts=%d "OOF_IPCACHE_STATE" "
@@ -801,10 +802,27 @@ void ci_tcp_state_dump(ci_netif* ni, ci_tcp_state* ts,
   logger(log_arg, "%s  snd: limited rwnd=%d cwnd=%d nagle=%d more=%d app=%d",
          pf, stats.tx_stop_rwnd, stats.tx_stop_cwnd, stats.tx_stop_nagle,
          stats.tx_stop_more, stats.tx_stop_app);
+#if CI_CFG_TCP_PACING
+  if( NI_OPTS(ni).tcp_pacing ||
+      ts->c.max_pacing_rate != CI_TCP_PACING_RATE_UNLIMITED )
+    logger(log_arg, "%s  snd: pace max_rate=%"CI_PRIu64" credit=%d "
+           "limited=%d timer=%s", pf, ts->c.max_pacing_rate, ts->pace_credit,
+           stats.tx_stop_pace,
+           ci_ip_timer_pending(ni, &ts->pace_tid) ? "on" : "off");
+#endif
 #if CI_CFG_TAIL_DROP_PROBE
   if( ts->tcpflags & CI_TCPT_FLAG_TAIL_DROP_MARKED )
     logger(log_arg, "%s  snd: tail loss probe at %x", pf, ts->taildrop_mark);
 #endif
+#if CI_CFG_TCP_RACK
+  if( NI_OPTS(ni).tcp_rack )
+    logger(log_arg, "%s  snd: rack xmit_ts=%x end_seq=%08x rtt=%uus "
+           "min_rtt=%uus reo_wnd=%u/4%s%s", pf, ts->rack.xmit_ts,
+           ts->rack.end_seq, ts->rack.rtt, ts->rack.min_rtt,
+           ts->rack_reo_wnd_mult,
+           ts->rack_flags & CI_TCP_RACK_FLAG_REORDER ? " REORDER" : "",
+           ts->tcpflags & CI_TCPT_FLAG_RACK_REO_TIMING ? " timer" : "");
+#endif
 
   logger(log_arg, "%s  rcv: nxt-max=%08x-%08x wnd adv=%d cur=%d %s%s", pf,
          tcp_rcv_nxt(ts), tcp_rcv_wnd_right_edge_sent(ts),
@@ -855,14 +873,15 @@ void ci_tcp_state_dump(ci_netif* ni, ci_tcp_state* ts,
 # define fmt_timer(_b, _l, _n, name, tid)                       \
   if( ci_ip_timer_pending(ni, &tid) )                           \
     _n = line_fmt_timer(_b, _l, _n, #name"(%ums[%x]) ",         \
-                        ci_ip_time_ticks2ms(ni, tid.time-now),  \
-                        tid.time,                               \
+                        ci_ip_time_ticks2ms(ni, ci_ip_timer_expiry(&tid)-now), \
+                        ci_ip_timer_expiry(&tid),               \
                         logger, log_arg)
 #else
 # define fmt_timer(_b, _l, _n, name, tid)                   \
   if( ci_ip_timer_pending(ni, &tid) )                       \
     _n = line_fmt_timer(_b, _l, _n,  #name"(%uticks[%x]) ", \
-                        tid.time-now, tid.time,             \
+                        ci_ip_timer_expiry(&tid)-now,       \
+                        ci_ip_timer_expiry(&tid),           \
                         ci_log_dump_fn, NULL)
 #endif
 
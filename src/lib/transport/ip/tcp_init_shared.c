@@ -44,6 +44,9 @@ static void ci_tcp_state_setup_timers(ci_netif* ni, ci_tcp_state* ts)
   ci_tcp_setup_timer(stats,    CI_IP_TIMER_TCP_STATS,  "stat");
 #endif
   ci_tcp_setup_timer(cork,     CI_IP_TIMER_TCP_CORK,   "cork");
+#if CI_CFG_TCP_PACING
+  ci_tcp_setup_timer(pace,     CI_IP_TIMER_TCP_PACE,   "pace");
+#endif
 
 #undef ci_tcp_setup_timer
 }
@@ -157,6 +160,13 @@ void ci_tcp_state_tcb_reinit_minimal(ci_netif* netif, ci_tcp_state* ts)
   ts->sa = 0; /* set to zero to provoke initialisation in ci_tcp_update_rtt */
   ts->sv = NI_CONF(netif).tconst_rto_initial; /* cwndrecover b4 rtt measured */
 
+#if CI_CFG_TCP_RACK
+  memset(&ts->rack, 0, sizeof(ts->rack));
+  ts->rack_reo_wnd_mult = 1;
+  ts->rack_reo_wnd_persist = 0;
+  ts->rack_flags = 0;
+#endif
+
   ts->local_peer = OO_SP_NULL;
 
 #if CI_CFG_TX_CRC_OFFLOAD
@@ -190,6 +200,10 @@ static void ci_tcp_state_tcb_reinit(ci_netif* netif, ci_tcp_state* ts,
   if( ts->tcpflags & CI_TCPT_FLAG_TSO )  ts->outgoing_hdrs_len += 12;
   ts->incoming_tcp_hdr_len = (ci_uint8)sizeof(ci_tcp_hdr);
   ts->c.tcp_defer_accept = OO_TCP_DEFER_ACCEPT_OFF;
+  ts->c.cong_alg = NI_OPTS(netif).tcp_cong_control;
+#if CI_CFG_TCP_PACING
+  ts->c.max_pacing_rate = CI_TCP_PACING_RATE_UNLIMITED;
+#endif
 
   ci_tcp_state_connected_opts_init(netif, ts);
 
@@ -224,6 +238,10 @@ static void ci_tcp_state_tcb_reinit(ci_netif* netif, ci_tcp_state* ts,
   /* Burst control */
   ts->burst_window = 0;
 #endif
+#if CI_CFG_TCP_PACING
+  ts->pace_credit = 0;
+  ts->pace_stamp = 0;
+#endif
 
   /* congestion window validation RFC2861 */
 #if CI_CFG_CONGESTION_WINDOW_VALIDATION
@@ -188,6 +188,9 @@ void ci_tcp_state_verify_no_timers(ci_netif *ni, ci_tcp_state *ts)
   chk(zwin_tid);
   chk(kalive_tid);
   chk(cork_tid);
+#if CI_CFG_TCP_PACING
+  chk(pace_tid);
+#endif
 #if CI_CFG_TCP_SOCK_STATS
   chk(stats_tid);
 #endif
@@ -324,6 +327,8 @@ void ci_tcp_set_established_state(ci_netif* ni, ci_tcp_state* ts)
 
   ci_tcp_set_state(ni, ts, CI_TCP_ESTABLISHED);
   CI_TCP_STATS_INC_CURR_ESTAB( ni );
+  if( ts->tcpflags & CI_TCPT_FLAG_ECN )
+    CI_TCP_STATS_INC_ECN_ESTAB( ni );
 
   ts->s.tx_errno = 0;
   ts->s.rx_errno = 0;
@@ -435,6 +440,9 @@ int ci_tcp_parse_options(ci_netif* ni, ciip_tcp_rx_pkt* rxp,
   opt = CI_TCP_HDR_OPTS(tcp);
   bytes = CI_TCP_HDR_OPT_LEN(tcp);
   rxp->flags = 0;
+#if CI_CFG_TCP_FASTOPEN
+  rxp->fastopen_len = -1;
+#endif
 
   LOG_TV(log(LPF "parsing options packet %d, optlen %d",
              OO_PKT_FMT(rxp->pkt), bytes));
@@ -531,6 +539,20 @@ int ci_tcp_parse_options(ci_netif* ni, ciip_tcp_rx_pkt* rxp,
       }
       if( topts )  topts->flags |= CI_TCPT_FLAG_SACK;
       break;
+#if CI_CFG_TCP_FASTOPEN
+    case CI_TCP_OPT_FASTOPEN:
+      /* A cookie request, or a cookie */
+      if( len != 2 && (len < 2 + CI_TCP_FASTOPEN_COOKIE_MIN ||
+                       len > 2 + CI_TCP_FASTOPEN_COOKIE_MAX) ) {
+        LOG_U(log(LPF "TFO(bad length %d)", len));
+        goto fail_out;
+      }
+      if( topts ) {
+        rxp->fastopen_cookie = opt + 2;
+        rxp->fastopen_len = len - 2;
+      }
+      break;
+#endif
     default:
 #if CI_CFG_PORT_STRIPING
       if( opt[0] == NI_OPTS(ni).stripe_tcp_opt ) {
@@ -574,6 +596,9 @@ void ci_tcp_stop_timers(ci_netif* netif, ci_tcp_state* ts)
   ci_ip_timer_clear_ool(netif, &ts->zwin_tid);
   ci_ip_timer_clear_ool(netif, &ts->kalive_tid);
   ci_ip_timer_clear_ool(netif, &ts->cork_tid);
+#if CI_CFG_TCP_PACING
+  ci_ip_timer_clear_ool(netif, &ts->pace_tid);
+#endif
   if( OO_PP_NOT_NULL(ts->pmtus) ) {
     ci_pmtu_state_t* pmtus = ci_ni_aux_p2pmtus(netif, ts->pmtus);
     ci_ip_timer_clear_ool(netif, &pmtus->tid);
@@ -1027,6 +1052,11 @@ void ci_tcp_recovered(ci_netif* ni, ci_tcp_state* ts)
 
   /* If we get here, we've recovered. */
 
+  if( ! ci_tcp_cong_is_reno(ts) )
+    ci_tcp_cong_recovered(ni, ts);
+#if CI_CFG_TCP_RACK
+  ci_tcp_rack_recovered(ni, ts);
+#endif
   ts->congstate = CI_TCP_CONG_OPEN;
   ts->cwnd_extra = 0;
   ts->dup_acks = 0;
@@ -0,0 +1,213 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+*//*! \file
+**  \brief  TCP RACK-TLP loss detection (RFC8985).
+** <L5_PRIVATE L5_SOURCE>
+** </L5_PRIVATE>
+*//*
+\**************************************************************************/
+
+/*! \cidoxg_lib_transport_ip */
+
+/*
+** RACK deems a segment lost once a segment sent sufficiently later has
+** been delivered, rather than after a count of dupacks.  It needs SACK,
+** and is enabled per stack with EF_TCP_RACK.
+**
+** It sits alongside the SACK scoreboard in the retransmit queue rather
+** than replacing it:
+**  - each segment's send time is kept in pkt->tstamp_frc, set by
+**    ci_tcp_tx_finish() on every (re)transmission;
+**  - the most recently sent segment known to be delivered is updated as
+**    packets are SACKed or ACKed, by ci_tcp_rack_delivered() in ip.h;
+**  - ci_tcp_rack_on_ack() runs at the end of each ACK and decides whether
+**    to enter fast recovery, or re-enter it for a lost retransmission;
+**  - in fast recovery ci_tcp_retrans() only sends segments that RACK
+**    deems lost, rather than everything up to the last SACK block.
+**
+** The reordering timer (RFC8985 6.3) borrows the RTO timer in the same way
+** that the tail loss probe does, flagged by CI_TCPT_FLAG_RACK_REO_TIMING.
+** The probe itself is the existing tail drop probe, which EF_TCP_RACK
+** turns on.
+**
+** Times are in usticks, as for the congestion control algorithms.
+*/
+
+#include "ip_internal.h"
+
+#if CI_CFG_TCP_RACK
+
+#define LPF "TCP RACK "
+
+/* Upper bound on rack_reo_wnd_mult: two min_rtts (RFC8985 6.2 step 4). */
+#define RACK_REO_WND_MULT_MAX  8
+/* Recoveries for which a widened reordering window persists. */
+#define RACK_REO_WND_PERSIST   16
+
+
+/* RFC8985 6.2 step 5. */
+ci_ip_pkt_fmt* ci_tcp_rack_detect_loss(ci_netif* ni, ci_tcp_state* ts,
+                                       ci_uint32* timeout_out)
+{
+  ci_ip_pkt_queue* rtq = &ts->retrans;
+  ci_uint32 now = ci_tcp_rack_now(ni);
+  ci_uint32 reo_wnd = ci_tcp_rack_reo_wnd(ni, ts);
+  ci_ip_pkt_fmt* lost = NULL;
+  ci_uint32 timeout = 0;
+  ci_ip_pkt_fmt* pkt;
+  ci_int32 remaining;
+  oo_pkt_p pp;
+
+  for( pp = rtq->head; OO_PP_NOT_NULL(pp); pp = pkt->next ) {
+    pkt = PKT_CHK(ni, pp);
+    if( pkt->flags & CI_PKT_FLAG_RTQ_SACKED ) {
+      pkt = PKT_CHK(ni, pkt->pf.tcp_tx.block_end);
+      continue;
+    }
+    remaining = ci_tcp_rack_remaining(ni, ts, pkt, reo_wnd, now);
+    if( remaining < 0 ) {
+      /* Sent after anything known to be delivered.  So was everything
+       * beyond it, apart from retransmissions. */
+      if( ~pkt->flags & CI_PKT_FLAG_RTQ_RETRANS )
+        break;
+    }
+    else if( remaining == 0 ) {
+      if( lost == NULL )
+        lost = pkt;
+    }
+    else {
+      timeout = CI_MAX(timeout, (ci_uint32) remaining);
+    }
+  }
+
+  *timeout_out = timeout;
+  return lost;
+}
+
+
+static void ci_tcp_rack_reo_timer_set(ci_netif* ni, ci_tcp_state* ts,
+                                      ci_uint32 timeout)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  ci_iptime_t t = ci_tcp_time_now(ni) + 1 +
+    (timeout >> (its->ci_ip_time_frc2tick - its->ci_ip_time_frc2us));
+
+  /* Leave an RTO that will fire first, but not a tail loss probe
+   * (RFC8985 7.2). */
+  if( ci_ip_timer_pending(ni, &ts->rto_tid) &&
+      ! (ts->tcpflags & (CI_TCPT_FLAG_TAIL_DROP_TIMING |
+                         CI_TCPT_FLAG_RACK_REO_TIMING)) &&
+      TIME_LE(ci_ip_timer_expiry(&ts->rto_tid), t) )
+    return;
+
+  LOG_TL(log(LNT_FMT LPF "reordering timer in %u usticks",
+             LNT_PRI_ARGS(ni, ts), timeout));
+  ts->tcpflags &=~ CI_TCPT_FLAG_TAIL_DROP_TIMING;
+  ts->tcpflags |= CI_TCPT_FLAG_RACK_REO_TIMING;
+  if( ci_ip_timer_pending(ni, &ts->rto_tid) )
+    ci_ip_timer_modify(ni, &ts->rto_tid, t);
+  else
+    ci_ip_timer_set(ni, &ts->rto_tid, t);
+}
+
+
+/* Called after each ACK has been processed.  Returns non-zero if it
+ * retransmitted anything.
+ */
+int ci_tcp_rack_on_ack(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_ip_pkt_fmt* lost;
+  ci_uint32 timeout;
+  int rc = 0;
+
+  ci_assert(ci_tcp_rack_enabled(ni, ts));
+  if( ci_ip_queue_is_empty(&ts->retrans) ||
+      (ts->s.b.state & CI_TCP_STATE_NO_TIMERS) )
+    return 0;
+
+  lost = ci_tcp_rack_detect_loss(ni, ts, &timeout);
+  if( lost != NULL ) {
+    if( ts->congstate == CI_TCP_CONG_OPEN ||
+        ts->congstate == CI_TCP_CONG_NOTIFIED ) {
+      rc = ci_tcp_enter_fast_recovery(ni, ts);
+      if( rc )
+        CITP_STATS_NETIF_INC(ni, tcp_rack_recoveries);
+    }
+    else if( SEQ_LT(lost->pf.tcp_tx.start_seq, ts->congrecover) &&
+             (ts->congstate == CI_TCP_CONG_COOLING ||
+              (ts->congstate == CI_TCP_CONG_FAST_RECOV &&
+               SEQ_LT(lost->pf.tcp_tx.start_seq, ts->retrans_seq))) ) {
+      /* Either a retransmission has been lost, or we stopped at the last
+       * SACK block and have since learnt of losses beyond it.  Go back
+       * into recovery from there rather than waiting for the RTO.
+       */
+      LOG_TL(log(LNT_FMT LPF "lost %08x-%08x%s in %s", LNT_PRI_ARGS(ni, ts),
+                 lost->pf.tcp_tx.start_seq, lost->pf.tcp_tx.end_seq,
+                 lost->flags & CI_PKT_FLAG_RTQ_RETRANS ? " again" : "",
+                 congstate_str(ts)));
+      if( lost->flags & CI_PKT_FLAG_RTQ_RETRANS )
+        CITP_STATS_NETIF_INC(ni, tcp_rack_lost_retrans);
+      ts->retrans_ptr = OO_PKT_P(lost);
+      ts->retrans_seq = lost->pf.tcp_tx.start_seq;
+      ts->congstate = CI_TCP_CONG_FAST_RECOV;
+      ci_tcp_retrans_recover(ni, ts, 0);
+      rc = 1;
+    }
+  }
+
+  /* The timer is not wanted in RTO recovery, which retransmits everything
+   * anyway. */
+  if( timeout != 0 && ! ci_ip_queue_is_empty(&ts->retrans) &&
+      ! (ts->congstate & CI_TCP_CONG_RTO) &&
+      ts->congstate != CI_TCP_CONG_RTO_RECOV )
+    ci_tcp_rack_reo_timer_set(ni, ts, timeout);
+  return rc;
+}
+
+
+void ci_tcp_timeout_rack_reo(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_assert(ts->tcpflags & CI_TCPT_FLAG_RACK_REO_TIMING);
+  ci_assert(! ci_tcp_retransq_is_empty(ts));
+
+  CITP_STATS_NETIF_INC(ni, tcp_rack_reo_timeouts);
+  LOG_TL(log(LNT_FMT LPF "reordering timeout "TCP_SND_FMT,
+             LNT_PRI_ARGS(ni, ts), TCP_SND_PRI_ARG(ts)));
+
+  /* Put the RTO back before anything is retransmitted. */
+  ci_tcp_rto_set(ni, ts);
+  if( ! ci_tcp_rack_on_ack(ni, ts) &&
+      ts->congstate == CI_TCP_CONG_FAST_RECOV )
+    /* Segments that were waiting out the reordering window may be lost
+     * now. */
+    ci_tcp_retrans_recover(ni, ts, 0);
+}
+
+
+/* A D-SACK shows that we retransmitted needlessly: widen the reordering
+ * window, by one quarter of min_rtt per recovery in which it happens
+ * (RFC8985 6.2 step 4).
+ */
+void ci_tcp_rack_dsack(ci_netif* ni, ci_tcp_state* ts)
+{
+  if( ! (ts->rack_flags & CI_TCP_RACK_FLAG_DSACK) &&
+      ts->rack_reo_wnd_mult < RACK_REO_WND_MULT_MAX ) {
+    ++ts->rack_reo_wnd_mult;
+    CITP_STATS_NETIF_INC(ni, tcp_rack_reo_wnd_grown);
+  }
+  ts->rack_flags |= CI_TCP_RACK_FLAG_DSACK;
+  ts->rack_reo_wnd_persist = RACK_REO_WND_PERSIST;
+}
+
+
+void ci_tcp_rack_recovered(ci_netif* ni, ci_tcp_state* ts)
+{
+  ts->rack_flags &=~ CI_TCP_RACK_FLAG_DSACK;
+  if( ts->rack_reo_wnd_persist != 0 && --ts->rack_reo_wnd_persist == 0 )
+    ts->rack_reo_wnd_mult = 1;
+}
+
+#endif /* CI_CFG_TCP_RACK */
+
+/*! \cidoxg_end */
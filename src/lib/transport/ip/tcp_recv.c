@@ -226,6 +226,7 @@ ci_tcp_recvmsg_get_nopeek(int peek_off, ci_tcp_state *ts, ci_netif *netif,
     /* for now run every time we update rcv_delivered */
     ci_tcp_rcvbuf_drs(netif, ts);
   if( oo_offbuf_left(&(*pkt)->buf) == 0 ) {
+    oo_lat_hist_rx_to_app(netif, S_SP(ts), *pkt);
     if( total == max_bytes || OO_PP_IS_NULL((*pkt)->next) )
       /* We've emptied the receive queue. Return non-zero to report this
        * to the calling function, so that it can return appropriately. */
@@ -656,6 +657,8 @@ static int ci_tcp_recvmsg_spin(ci_netif* ni, ci_tcp_state* ts,
       spin_limit_by_so = 1;
     }
   }
+  if( ! spin_limit_by_so )
+    max_spin = oo_spin_budget(ni, max_spin);
 
   now_frc = start_frc;
 
@@ -700,6 +703,8 @@ static int ci_tcp_recvmsg_spin(ci_netif* ni, ci_tcp_state* ts,
 
   rc = spin_limit_by_so ? -EAGAIN : 0;
  out:
+  if( rc > 0 && ! spin_limit_by_so )
+    oo_spin_adapt_record(ni, start_frc, ts->s.b.spin_cycles);
   ni->state->is_spinner = 0;
   return rc;
 }
@@ -753,6 +758,7 @@ static inline int ci_tcp_recvmsg_impl(const ci_tcp_recvmsg_args* a,
   ci_uint64             start_frc = 0; /* suppress compiler warning */
 #ifndef __KERNEL__
   unsigned              tcp_recv_spin = 0;
+  unsigned              tcp_recv_spun = 0;
 #endif
   ci_uint32             timeout = ts->s.so.rcvtimeo_msec;
   struct tcp_recv_info  rinf;
@@ -904,6 +910,7 @@ static inline int ci_tcp_recvmsg_impl(const ci_tcp_recvmsg_args* a,
     }
 
     tcp_recv_spin = 0;
+    tcp_recv_spun = 1;
     if( timeout ) {
       ci_uint32 spin_ms = NI_OPTS(ni).spin_usec >> 10;
       if( spin_ms < timeout )
@@ -937,6 +944,13 @@ static inline int ci_tcp_recvmsg_impl(const ci_tcp_recvmsg_args* a,
     rc2 = ci_sock_sleep(ni, &ts->s.b, CI_SB_FLAG_WAKE_RX,
                         CI_SLEEP_SOCK_LOCKED | CI_SLEEP_SOCK_RQ,
                         sleep_seq, &timeout);
+#ifndef __KERNEL__
+    /* Let EF_SPIN_ADAPTIVE know how long the spin would have needed. */
+    if( rc2 == 0 && tcp_recv_spun ) {
+      oo_spin_adapt_record(ni, start_frc, ts->s.b.spin_cycles);
+      tcp_recv_spun = 0;
+    }
+#endif
     if( rc2 == 0 )
       rc2 = ci_sock_lock(ni, &ts->s.b);
     if( rc2 < 0 ) {
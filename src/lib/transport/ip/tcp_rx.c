@@ -742,26 +742,7 @@ ci_inline void ci_tcp_opencwnd(ci_netif *ni, ci_tcp_state* ts)
     }
   }
   else {
-    /* Slow-start. */
-    unsigned cwnd_inc;
-    LOG_TV(log(LPF "%d OPENCWND: SS eff_mss=%u bytes_acked=%u cwnd=%u",
-               S_FMT(ts), tcp_eff_mss(ts), ts->bytes_acked, ts->cwnd));
-#if CI_CFG_CONG_AVOID_SLOW_START_MODE == 2
-    cwnd_inc = CI_MIN(ts->ssthresh - ts->cwnd, ts->bytes_acked);
-    ts->cwnd += cwnd_inc;
-    ts->bytes_acked -= cwnd_inc;
-#else
-    if( CI_CFG_CONG_AVOID_SLOW_START_MODE == 0 && ts->stats.rtos == 0 )
-      /* RFC3465 sec 2.2: May only increase cwnd by more than mss if we've
-      * never had any RTOs on this connection.
-      */
-      cwnd_inc = tcp_eff_mss(ts) * CI_CFG_CONG_AVOID_RFC3465_L_VALUE;
-    else
-      cwnd_inc = tcp_eff_mss(ts);
-    cwnd_inc = CI_MIN(cwnd_inc, ts->bytes_acked);
-    ts->cwnd += cwnd_inc;
-    ts->bytes_acked = 0;
-#endif
+    ci_tcp_opencwnd_slow_start(ts);
   }
 
   LOG_TV(log(LPF "%d OPENCWND: end cwnd=%u", S_FMT(ts), ts->cwnd));
@@ -774,7 +755,7 @@ ci_inline void ci_tcp_opencwnd(ci_netif *ni, ci_tcp_state* ts)
 
 static void ci_tcp_reset_cwnd_on_loss(ci_netif* ni, ci_tcp_state* ts)
 {
-  ts->ssthresh = ci_tcp_losswnd(ts);
+  ts->ssthresh = ci_tcp_cong_losswnd(ni, ts);
   ts->cwnd = ts->ssthresh + ci_tcp_base_dupack_thresh(ts) * tcp_eff_mss(ts);
   ts->cwnd = CI_MAX(ts->cwnd, NI_OPTS(ni).loss_min_cwnd);
   ts->cwnd = CI_MAX(ts->cwnd, NI_OPTS(ni).min_cwnd);
@@ -782,6 +763,80 @@ static void ci_tcp_reset_cwnd_on_loss(ci_netif* ni, ci_tcp_state* ts)
 }
 
 
+/* Sender side of ECN (RFC3168 6.1.2): an ACK of new data with ECE asks us
+ * to reduce the window, no more than once per window of data.  Returns
+ * true while the window must not grow.
+ */
+static int ci_tcp_rx_ecn_ack(ci_netif* ni, ci_tcp_state* ts,
+                             ciip_tcp_rx_pkt* rxp, unsigned acked)
+{
+  int ece = rxp->tcp->tcp_flags & CI_TCP_FLAG_ECE;
+
+  if( ! ci_tcp_cong_is_reno(ts) )
+    ci_tcp_cong_ecn_ack(ni, ts, rxp->ack, acked, ece);
+
+  if( (ts->tcpflags & CI_TCPT_FLAG_ECN_CWR_STATE) &&
+      SEQ_GE(rxp->ack, ts->ecn_recover) )
+    ts->tcpflags &=~ CI_TCPT_FLAG_ECN_CWR_STATE;
+
+  if( ece ) {
+    CI_TCP_STATS_INC_ECN_ECE_RCVD(ni);
+    if( ! (ts->tcpflags & CI_TCPT_FLAG_ECN_CWR_STATE) &&
+        (ts->congstate == CI_TCP_CONG_OPEN ||
+         ts->congstate == CI_TCP_CONG_NOTIFIED) ) {
+      /* Nothing was lost, so no fast recovery and no inflation. */
+      ts->ssthresh = ci_tcp_cong_ecn_losswnd(ni, ts);
+      ts->cwnd = CI_MAX(ts->ssthresh, NI_OPTS(ni).min_cwnd);
+      ts->ecn_recover = tcp_snd_nxt(ts);
+      ts->tcpflags |= CI_TCPT_FLAG_ECN_CWR | CI_TCPT_FLAG_ECN_CWR_STATE;
+      CI_TCP_STATS_INC_ECN_CWND_REDUCED(ni);
+      LOG_TL(log(LNT_FMT "ECE: cwnd=%u ssthresh=%u recover=%08x",
+                 LNT_PRI_ARGS(ni, ts), ts->cwnd, ts->ssthresh,
+                 ts->ecn_recover));
+    }
+  }
+
+  return ts->tcpflags & CI_TCPT_FLAG_ECN_CWR_STATE;
+}
+
+
+/* Receiver side of ECN for a segment with payload: decide whether to set
+ * ECE on our ACKs.  RFC3168 6.1.3 echoes every CE until the peer sends
+ * CWR.  DCTCP (RFC8257 3.2) echoes the CE mark of each segment exactly,
+ * so on a change of CE state any delayed ACK goes out first with the old
+ * state, and the new state is ACKed at once.
+ */
+static void ci_tcp_rx_ecn_ce(ci_netif* ni, ci_tcp_state* ts,
+                             ci_ip_pkt_fmt* pkt, ci_tcp_hdr* tcp)
+{
+  int ce = (ipx_hdr_tos_tclass(oo_pkt_af(pkt), RX_PKT_IPX_HDR(pkt)) &
+            CI_IP_ECN_MASK) == CI_IP_ECN_CE;
+
+  if( ce )
+    CI_TCP_STATS_INC_ECN_CE_RCVD(ni);
+
+  if( ts->c.cong_alg == EF_TCP_CONG_CONTROL_DCTCP ) {
+    if( ! ce != ! (ts->tcpflags & CI_TCPT_FLAG_ECN_ECE) ) {
+      if( ts->acks_pending & CI_TCP_ACKS_PENDING_MASK ) {
+        ci_ip_pkt_fmt* ackpkt = ci_netif_pkt_alloc(ni, 0);
+        if( ackpkt ) ci_tcp_send_ack(ni, ts, ackpkt, CI_FALSE);
+      }
+      ts->tcpflags ^= CI_TCPT_FLAG_ECN_ECE;
+      TCP_FORCE_ACK(ts);
+    }
+  }
+  else {
+    if( tcp->tcp_flags & CI_TCP_FLAG_CWR )
+      ts->tcpflags &=~ CI_TCPT_FLAG_ECN_ECE;
+    if( ce && ! (ts->tcpflags & CI_TCPT_FLAG_ECN_ECE) ) {
+      /* Do not delay the news: the sender's window may be small. */
+      ts->tcpflags |= CI_TCPT_FLAG_ECN_ECE;
+      TCP_FORCE_ACK(ts);
+    }
+  }
+}
+
+
 /* Enters fast recovery if we've received enough dupacks.  Returns non-zero
  * iff we enter fast recovery. */
 int /*bool*/ ci_tcp_maybe_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts)
@@ -789,6 +844,18 @@ int /*bool*/ ci_tcp_maybe_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts)
   ci_uint32 dup_thresh = ci_tcp_base_dupack_thresh(ts);
   ci_ip_pkt_fmt *pkt;
 
+#if CI_CFG_TCP_RACK
+  if( ci_tcp_rack_enabled(ni, ts) ) {
+    /* RACK decides from transmit times rather than by counting dupacks. */
+    ci_uint32 timeout;
+    if( ci_tcp_rack_detect_loss(ni, ts, &timeout) == NULL ||
+        ! ci_tcp_enter_fast_recovery(ni, ts) )
+      return 0;
+    CITP_STATS_NETIF_INC(ni, tcp_rack_recoveries);
+    return 1;
+  }
+#endif
+
   if( ts->dup_acks == 0 ) {
     return 0;
   }
@@ -833,6 +900,14 @@ int /*bool*/ ci_tcp_maybe_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts)
     return 0;
   }
 
+  return ci_tcp_enter_fast_recovery(ni, ts);
+}
+
+
+/* Enters fast recovery now that loss has been detected.  Returns non-zero
+ * iff we enter fast recovery. */
+int /*bool*/ ci_tcp_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts)
+{
   if( ci_ip_queue_is_empty(&ts->retrans) ) {
     LOG_U(log(LNT_FMT "%d DUPACKs, but no data to retransmit!",
               LNT_PRI_ARGS(ni, ts), ts->dup_acks));
@@ -915,7 +990,8 @@ static void ci_tcp_rx_dupack(ci_tcp_state* ts, ci_netif* netif,
              LNT_PRI_ARGS(netif, ts), ts->dup_acks, TCP_SND_PRI_ARG(ts));
          log(LNT_FMT "  %s cwnd=%i crecover=%08x now-rto_to=%u rto=%u",
              LNT_PRI_ARGS(netif, ts), congstate_str(ts), ts->cwnd,
-             ts->congrecover, ci_tcp_time_now(netif) - ts->rto_tid.time,
+             ts->congrecover,
+             ci_tcp_time_now(netif) - ci_ip_timer_expiry(&ts->rto_tid),
              ts->rto));
   CI_IP_SOCK_STATS_INC_DUPACK( ts );
 
@@ -932,8 +1008,12 @@ static void ci_tcp_rx_dupack(ci_tcp_state* ts, ci_netif* netif,
 
   if( (ts->congstate == CI_TCP_CONG_OPEN)
       | (ts->congstate == CI_TCP_CONG_NOTIFIED) ) {
-    /* Goto fast recovery if we've received enough dupacks. */
-    ci_tcp_maybe_enter_fast_recovery(netif, ts);
+    /* Goto fast recovery if we've received enough dupacks.  RACK looks for
+     * losses on every ACK instead: see ci_tcp_rack_on_ack(). */
+#if CI_CFG_TCP_RACK
+    if( ! ci_tcp_rack_enabled(netif, ts) )
+#endif
+      ci_tcp_maybe_enter_fast_recovery(netif, ts);
   }
   else if( ts->congstate == CI_TCP_CONG_FAST_RECOV ) {
     if( !(ts->tcpflags & CI_TCPT_FLAG_SACK) ) {
@@ -1034,12 +1114,27 @@ static void ci_tcp_try_cwndrecover(ci_tcp_state* ts, ci_netif* netif,
 }
 
 
+/* Marks [pkt] as SACKed as part of the block that ends at [block_end].
+ * [rack_end_seq] is as for ci_tcp_rack_delivered(). */
+ci_inline void ci_tcp_rx_sack_mark(ci_netif* ni, ci_tcp_state* ts,
+                                   ci_ip_pkt_fmt* pkt, oo_pkt_p block_end,
+                                   ci_uint32 rack_end_seq)
+{
+#if CI_CFG_TCP_RACK
+  if( NI_OPTS(ni).tcp_rack && (~pkt->flags & CI_PKT_FLAG_RTQ_SACKED) )
+    ci_tcp_rack_delivered(ni, ts, pkt, rack_end_seq);
+#endif
+  pkt->pf.tcp_tx.block_end = block_end;
+  pkt->flags |= CI_PKT_FLAG_RTQ_SACKED;
+}
+
+
 /* Marks packets in the retransmit queue as having been SACKed.  Returns non-
  * zero if and only if the block allowed us to mark an entire packet, not
  * previously SACKed, as having now been SACKed. */
 static int /*bool*/
 ci_tcp_rx_sack_process_block(ci_netif* ni, ci_tcp_state* ts, unsigned start,
-                             unsigned end)
+                             unsigned end, ci_uint32 rack_end_seq)
 {
   ci_ip_pkt_queue* rtq = &ts->retrans;
   ci_ip_pkt_fmt* start_block;
@@ -1206,12 +1301,10 @@ ci_tcp_rx_sack_process_block(ci_netif* ni, ci_tcp_state* ts, unsigned start,
   else
     pkt = start_pkt;
   while( pkt != end_pkt ) {
-    pkt->pf.tcp_tx.block_end = next_pp;
-    pkt->flags |= CI_PKT_FLAG_RTQ_SACKED;
+    ci_tcp_rx_sack_mark(ni, ts, pkt, next_pp, rack_end_seq);
     pkt = PKT_CHK(ni, pkt->next);
   }
-  pkt->pf.tcp_tx.block_end = next_pp;
-  pkt->flags |= CI_PKT_FLAG_RTQ_SACKED;
+  ci_tcp_rx_sack_mark(ni, ts, pkt, next_pp, rack_end_seq);
 
   /* We took early exits from this function when this SACK block was contained
    * within an earlier one, so we know that we have recorded new SACK
@@ -1260,6 +1353,10 @@ ci_inline int ci_tcp_rx_dsack_check(ci_netif* ni, ci_tcp_state* ts,
     CITP_STATS_NETIF(++ni->state->stats.tail_drop_probe_unnecessary);
     ts->tcpflags &=~ CI_TCPT_FLAG_TAIL_DROP_MARKED;
   }
+#endif
+#if CI_CFG_TCP_RACK
+  if( rc && NI_OPTS(ni).tcp_rack )
+    ci_tcp_rack_dsack(ni, ts);
 #endif
   return rc;
 }
@@ -1278,6 +1375,7 @@ static void ci_tcp_rx_sack_process(ci_netif* netif, ci_tcp_state* ts,
   unsigned start;
   unsigned end;
   int sacked = 0;
+  ci_uint32 rack_end_seq = 0;
 
   if( !(ts->tcpflags & CI_TCPT_FLAG_SACK) ) {
     LOG_U(log(LNT_FMT "SACK received but not negotiated",
@@ -1304,6 +1402,9 @@ static void ci_tcp_rx_sack_process(ci_netif* netif, ci_tcp_state* ts,
 
   /* Check for DSACK.  If it is, then skip the first block. */
   i = ci_tcp_rx_dsack_check(netif, ts, rxp);
+#if CI_CFG_TCP_RACK
+  rack_end_seq = ts->rack.end_seq;
+#endif
 
   /* Iterate over each sack block, deciding what action to take */
   for( ; i < rxp->sack_blocks; i++ ) {
@@ -1324,7 +1425,7 @@ static void ci_tcp_rx_sack_process(ci_netif* netif, ci_tcp_state* ts,
     */
     if( ! (/*1*/SEQ_LE(start, rxp->ack) | /*2*/SEQ_LT(tcp_snd_nxt(ts), end) |
            /*3*/SEQ_LE(end, start)) ) {
-      if( ci_tcp_rx_sack_process_block(netif, ts, start, end) )
+      if( ci_tcp_rx_sack_process_block(netif, ts, start, end, rack_end_seq) )
         sacked = 1;
     }
     else {
@@ -1368,6 +1469,10 @@ static void ci_tcp_rx_free_acked_bufs(ci_netif* netif, ci_tcp_state* ts,
   oo_pkt_p ts_q_pending = ts->timestamp_q_pending;
   unsigned ts_q_bufs = 0;
 #endif
+#if CI_CFG_TCP_RACK
+  int rack = ci_tcp_rack_enabled(netif, ts);
+  ci_uint32 rack_end_seq = ts->rack.end_seq;
+#endif
 
   ci_assert(ci_ip_queue_is_valid(netif, rtq));
   ts->retransmits=0;
@@ -1409,6 +1514,11 @@ static void ci_tcp_rx_free_acked_bufs(ci_netif* netif, ci_tcp_state* ts,
       ci_nvme_plugin_crc_free_acked_ids(netif, p);
 #endif
 
+#if CI_CFG_TCP_RACK
+    if( rack && (~p->flags & CI_PKT_FLAG_RTQ_SACKED) )
+      ci_tcp_rack_delivered(netif, ts, p, rack_end_seq);
+#endif
+
     ci_ip_queue_dequeue(netif, rtq, p);
 
     ci_assert(p->refcount > 0);
@@ -1584,7 +1694,12 @@ static void ci_tcp_rx_handle_ack(ci_tcp_state* ts, ci_netif* netif,
 
     /* Open the congestion window. */
     ts->bytes_acked += acked;
-    ci_tcp_opencwnd(netif, ts);
+    if(CI_UNLIKELY( (ts->tcpflags & CI_TCPT_FLAG_ECN) &&
+                    ci_tcp_rx_ecn_ack(netif, ts, rxp, acked) ))
+      ts->bytes_acked = 0;
+    else if(CI_LIKELY( ci_tcp_cong_is_reno(ts) ) ||
+            ! ci_tcp_cong_on_ack(netif, ts, rxp->ack, acked))
+      ci_tcp_opencwnd(netif, ts);
 
     /* New acknowledgement clears any dup_acks. */
     ts->dup_acks = 0;
@@ -2760,6 +2875,42 @@ static void handle_rx_synrecv_ack(ci_netif* netif, ci_tcp_socket_listen* tls,
 }
 
 
+#if CI_CFG_TCP_FASTOPEN
+/* A SYN with data and a good Fast Open cookie: promote the connection
+** straight away, deliver the data and send a SYN-ACK that acks it.
+** Returns -1 if the connection can't be promoted, in which case the SYN is
+** handled as usual.
+*/
+static int handle_rx_listen_fastopen(ci_netif* netif,
+                                     ci_tcp_socket_listen* tls,
+                                     ci_tcp_state_synrecv* tsr,
+                                     ciip_tcp_rx_pkt* rxp,
+                                     ci_ip_cached_hdrs* ipcache)
+{
+  ci_ip_pkt_fmt* pkt = rxp->pkt;
+  ci_tcp_state* ts;
+
+  tsr->amss = ci_tcp_amss(netif, &tls->c, ipcache, __func__);
+  if( ci_tcp_listenq_try_promote(netif, tls, tsr, ipcache, pkt, &ts) < 0 )
+    return -1;
+
+  /* The window in a SYN is not scaled */
+  ci_tcp_set_snd_max(ts, rxp->seq, tcp_snd_una(ts), pkt->pf.tcp_rx.window);
+  oo_offbuf_init(&pkt->buf, CI_TCP_PAYLOAD(rxp->tcp), pkt->pf.tcp_rx.pay_len);
+  ci_tcp_rx_enqueue_packet(netif, ts, pkt);
+
+  ts->tcpflags |= CI_TCPT_FLAG_FASTOPEN_SYNACK;
+  ci_tcp_send_fastopen_synack(netif, ts);
+  ci_tcp_wake(netif, ts, CI_SB_FLAG_WAKE_RX);
+
+  LOG_TC(log(LNTS_FMT "TFO SYN-RECV->ESTABLISHED with %d bytes",
+             LNTS_PRI_ARGS(netif, ts), pkt->pf.tcp_rx.pay_len));
+  CI_TCP_STATS_INC_FASTOPEN_ACCEPTED(netif);
+  return 0;
+}
+#endif
+
+
 /*
 ** This function is assumed to be called when a SYN packet is routed
 ** to a listening socket it:
@@ -3132,11 +3283,16 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
   tsr->tcpopts.flags |= rxp->flags & CI_TCPT_FLAG_TSO;
   if( tsr->tcpopts.flags & CI_TCPT_FLAG_TSO )
     tsr->tspeer = rxp->timestamp;
+  /* ECN-setup SYN has both ECE and CWR (RFC3168 6.1.1) */
+  if( (tcp->tcp_flags & (CI_TCP_FLAG_ECE | CI_TCP_FLAG_CWR)) ==
+      (CI_TCP_FLAG_ECE | CI_TCP_FLAG_CWR) )
+    tsr->tcpopts.flags |= CI_TCPT_FLAG_ECN;
 
   if( !do_syncookie ) {
     if( ! ci_tcp_can_stripe(netif, ip->ip4.ip_daddr_be32,ip->ip4.ip_saddr_be32) )
       tsr->tcpopts.flags &=~ CI_TCPT_FLAG_STRIPE;
-    tsr->tcpopts.flags &= NI_OPTS(netif).syn_opts | CI_TCPT_FLAG_STRIPE;
+    tsr->tcpopts.flags &= ci_tcp_syn_opts(netif, &tls->c) |
+                          CI_TCPT_FLAG_STRIPE;
   }
 
   /* setup synrecv state */
@@ -3176,6 +3332,34 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
     CITP_STATS_NETIF(++netif->state->stats.listen2synrecv);
   }
 
+#if CI_CFG_TCP_FASTOPEN
+  if( rxp->fastopen_len >= 0 && ! do_syncookie &&
+      OO_SP_IS_NULL(tsr->local_peer) &&
+      (NI_OPTS(netif).tcp_fastopen & CI_TCP_FASTOPEN_SERVER) &&
+      tls->c.fastopen_qlen != 0 ) {
+    if( rxp->fastopen_len > 0 &&
+        ci_tcp_fastopen_cookie_check(netif, tsr->l_addr, tsr->r_addr,
+                                     rxp->fastopen_cookie,
+                                     rxp->fastopen_len) ) {
+      /* TCP_FASTOPEN's queue length limits the connections that skip
+       * the handshake. */
+      if( pkt->pf.tcp_rx.pay_len != 0 &&
+          (int) ci_tcp_acceptq_n(tls) < tls->c.fastopen_qlen &&
+          handle_rx_listen_fastopen(netif, tls, tsr, rxp, &ipcache) == 0 ) {
+        CI_TCP_STATS_INC_PASSIVE_OPENS( netif );
+        return;
+      }
+    }
+    else {
+      /* Asked for a cookie, or sent a bad one: send a good one. */
+      if( rxp->fastopen_len > 0 )
+        CI_TCP_STATS_INC_FASTOPEN_REJECTED(netif);
+      CI_TCP_STATS_INC_FASTOPEN_COOKIE_ISSUED(netif);
+      tsr->tcpopts.flags |= CI_TCPT_FLAG_FASTOPEN;
+    }
+  }
+#endif
+
   LOG_TC(if( tsr->amss == 0 ) tsr->amss = netif->state->max_mss;
          log(LNT_FMT "SYN-RECV rcv=%08x-%08x snd=%08x-%08x",
              LNT_PRI_ARGS(netif, tls),
@@ -3306,8 +3490,18 @@ static int handle_syn_sent_opts(ci_netif* netif, ci_tcp_state* ts,
   }
   if( !(tcpopts.flags & CI_TCPT_FLAG_SACK) )
     ts->tcpflags &=~ CI_TCPT_FLAG_SACK;
+  /* ECN-setup SYN-ACK has ECE without CWR (RFC3168 6.1.1) */
+  if( (rxp->tcp->tcp_flags & (CI_TCP_FLAG_ECE | CI_TCP_FLAG_CWR)) !=
+      CI_TCP_FLAG_ECE )
+    ts->tcpflags &=~ CI_TCPT_FLAG_ECN;
   if( !(tcpopts.flags & CI_TCPT_FLAG_STRIPE) )
     ts->tcpflags &=~ CI_TCPT_FLAG_STRIPE;
+#if CI_CFG_TCP_FASTOPEN
+  /* Remember the server's Fast Open cookie for next time */
+  if( (ts->tcpflags & CI_TCPT_FLAG_FASTOPEN) && rxp->fastopen_len > 0 )
+    ci_tcp_fastopen_cache_put(netif, ipcache_raddr(&ts->s.pkt),
+                              rxp->fastopen_cookie, rxp->fastopen_len);
+#endif
 
   ts->outgoing_hdrs_len = CI_IPX_HDR_SIZE(af) + sizeof(ci_tcp_hdr) + optlen;
   ci_tcp_set_hdr_len(ts, sizeof(ci_tcp_hdr) + optlen);
@@ -3422,6 +3616,17 @@ static void handle_rx_syn_sent(ci_netif* netif, ci_tcp_state* ts,
    */
   ci_tcp_set_snd_max(ts, rxp->seq, rxp->ack, pkt->pf.tcp_rx.window);
 
+#if CI_CFG_TCP_FASTOPEN
+  /* The server didn't take (all of) the data in our SYN */
+  if( (ts->tcpflags & CI_TCPT_FLAG_FASTOPEN_DATA) &&
+      ci_ip_queue_not_empty(&ts->retrans) &&
+      (TX_PKT_IPX_TCP(ipcache_af(&ts->s.pkt),
+                      PKT_CHK(netif, ts->retrans.head))->tcp_flags &
+       CI_TCP_FLAG_SYN) &&
+      ci_tcp_tx_fastopen_requeue(netif, ts) < 0 )
+    goto free_out;
+#endif
+
 set_isn:
   /* Snarf their initial sequence no. and window. */
   ci_tcp_rx_set_isn(ts, pkt->pf.tcp_rx.end_seq);
@@ -4032,9 +4237,23 @@ static void handle_rx_slow(ci_tcp_state* ts, ci_netif* netif,
   if(CI_UNLIKELY( tcp->tcp_flags & CI_TCP_FLAG_RST ))
     goto handle_rst;
 
-  /*! \TODO We don't support ECN yet. */
-  LOG_TR(if( tcp->tcp_flags & (CI_TCP_FLAG_ECE|CI_TCP_FLAG_CWR) )
-           log(LNT_FMT "ECN flags=%x not implemented (ignored)",
+#if CI_CFG_TCP_FASTOPEN
+  if(CI_UNLIKELY( ts->tcpflags & CI_TCPT_FLAG_FASTOPEN_SYNACK )) {
+    if( tcp->tcp_flags & CI_TCP_FLAG_SYN ) {
+      /* The client didn't get our SYN-ACK and resent the SYN */
+      LOG_TC(log(LNTS_FMT "TFO dup SYN", LNTS_PRI_ARGS(netif, ts)));
+      ci_tcp_send_fastopen_synack(netif, ts);
+      ci_netif_pkt_release_rx(netif, pkt);
+      return;
+    }
+    if( tcp->tcp_flags & CI_TCP_FLAG_ACK )
+      ts->tcpflags &=~ CI_TCPT_FLAG_FASTOPEN_SYNACK;
+  }
+#endif
+
+  LOG_TR(if( (tcp->tcp_flags & (CI_TCP_FLAG_ECE|CI_TCP_FLAG_CWR)) &&
+             ! (ts->tcpflags & CI_TCPT_FLAG_ECN) )
+           log(LNT_FMT "ECN flags=%x without ECN negotiated (ignored)",
                LNT_PRI_ARGS(netif, ts), (unsigned) tcp->tcp_flags));
 
   ci_assert(CI_IPX_ADDR_EQ(RX_PKT_SADDR(pkt),
@@ -4263,6 +4482,9 @@ static void handle_rx_slow(ci_tcp_state* ts, ci_netif* netif,
         }
       }
 
+      if( ts->tcpflags & CI_TCPT_FLAG_ECN )
+        ci_tcp_rx_ecn_ce(netif, ts, pkt, tcp);
+
       /* Deliver the segment's payload to the endpoint. */
 
       if( SEQ_LE(rxp->seq, tcp_rcv_nxt(ts)) ) {
@@ -4684,6 +4906,11 @@ int ci_tcp_rx_deliver_to_conn(ci_sock_cmn* s, void* opaque_arg)
               (pkt->pf.tcp_rx.pay_len <= 0) |
               /* we're suffering from memory pressure */
               (ni->state->mem_pressure & OO_MEM_PRESSURE_CRITICAL) |
+              /* CE mark to echo, or DCTCP may need to stop echoing it */
+              ((ts->tcpflags & CI_TCPT_FLAG_ECN) &&
+               ((ipx_hdr_tos_tclass(oo_pkt_af(pkt), RX_PKT_IPX_HDR(pkt)) &
+                 CI_IP_ECN_MASK) == CI_IP_ECN_CE ||
+                (ts->tcpflags & CI_TCPT_FLAG_ECN_ECE))) |
               /* some recycling is needed */
               (ci_tcp_is_pluginized(ts) &&
                ! ci_tcp_plugin_elided_payload(pkt)));
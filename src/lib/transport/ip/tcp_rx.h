@@ -15,6 +15,33 @@ ci_inline void ci_tcp_rx_set_isn(ci_tcp_state* ts, unsigned isn)
 }
 
 
+/* Slow-start part of RFC3465 (ABC): grow cwnd by the bytes acked, limited
+ * to L*SMSS.  Shared by reno and cubic. */
+ci_inline void ci_tcp_opencwnd_slow_start(ci_tcp_state* ts)
+{
+  unsigned cwnd_inc;
+  LOG_TV(ci_log("%s: %d OPENCWND: SS eff_mss=%u bytes_acked=%u cwnd=%u",
+                __FUNCTION__, S_FMT(ts), tcp_eff_mss(ts), ts->bytes_acked,
+                ts->cwnd));
+#if CI_CFG_CONG_AVOID_SLOW_START_MODE == 2
+  cwnd_inc = CI_MIN(ts->ssthresh - ts->cwnd, ts->bytes_acked);
+  ts->cwnd += cwnd_inc;
+  ts->bytes_acked -= cwnd_inc;
+#else
+  if( CI_CFG_CONG_AVOID_SLOW_START_MODE == 0 && ts->stats.rtos == 0 )
+    /* RFC3465 sec 2.2: May only increase cwnd by more than mss if we've
+    * never had any RTOs on this connection.
+    */
+    cwnd_inc = tcp_eff_mss(ts) * CI_CFG_CONG_AVOID_RFC3465_L_VALUE;
+  else
+    cwnd_inc = tcp_eff_mss(ts);
+  cwnd_inc = CI_MIN(cwnd_inc, ts->bytes_acked);
+  ts->cwnd += cwnd_inc;
+  ts->bytes_acked = 0;
+#endif
+}
+
+
 ci_inline int ci_tcp_need_ack(ci_netif* ni, ci_tcp_state* ts)
 {
   /* - More than [delack_thresh] ACKs have been requested, 
@@ -19,7 +19,7 @@
 #include <ci/internal/crc_offload_prefix.h>
 
 #if CI_CFG_NVME_LOCAL_CRC_MODE
-#include "crc32c.h"
+#include <ci/tools/crc32c.h>
 #endif
 
 #if !defined(__KERNEL__)
@@ -1055,6 +1055,9 @@ ci_tcp_tmpl_update(ci_netif* ni, ci_tcp_state* ts,
     tcp_enq_nxt(ts) = pkt->pf.tcp_tx.end_seq;
     pkt->pf.tcp_tx.block_end = OO_PP_NULL;
     ci_tcp_tmpl_remove(ni, ts, pkt);
+#if CI_CFG_TCP_RACK
+    ci_tcp_rack_stamp(ni, pkt);
+#endif
     ci_ip_queue_enqueue(ni, &ts->retrans, pkt);
     --ni->state->n_async_pkts;
     ++ts->stats.tx_tmpl_send_fast;
@@ -1114,6 +1117,11 @@ static int ci_tcp_sendmsg_enqueue(ci_netif* ni, ci_tcp_state* ts,
 
     seq -= pkt->pf.tcp_tx.end_seq;
     ci_tcp_sendmsg_prep_pkt(ni, ts, pkt, seq);
+#if CI_CFG_TCP_RACK
+    /* Straight onto the retransmit queue means these were sent already. */
+    if( sendq == &ts->retrans )
+      ci_tcp_rack_stamp(ni, pkt);
+#endif
 
     pkt->next = send_list;
     send_list = OO_PKT_P(pkt);
@@ -1351,9 +1359,98 @@ ci_inline void ci_tcp_sendmsg_free_unused_pkts(ci_netif* ni,
 }
 
 
+#if CI_CFG_TCP_FASTOPEN
+/* Send the SYN of a TCP_FASTOPEN_CONNECT socket, which was held back for
+** the first send.
+*/
+static void ci_tcp_fastopen_send_syn(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_assert(ci_netif_is_locked(ni));
+  ts->tcpflags &=~ CI_TCPT_FLAG_FASTOPEN_DEFER;
+  if( ci_tcp_sendq_not_empty(ts) )
+    ci_tcp_tx_advance(ts, ni);
+}
+
+
+/* The first send on a TCP_FASTOPEN_CONNECT socket: put as much as fits
+** into the SYN and send it.  Returns the number of bytes sent, 0 if the
+** SYN has already gone, or -1 with [sinf->rc] set if the stack lock
+** could not be taken.
+*/
+static int ci_tcp_sendmsg_fastopen(ci_netif* ni, ci_tcp_state* ts,
+                                   const ci_iovec* iov, unsigned long iovlen,
+                                   struct tcp_send_info* sinf
+                                   CI_KERNEL_ARG(ci_addr_spc_t addr_spc))
+{
+  int af = ipcache_af(&ts->s.pkt);
+  ci_ip_pkt_fmt* pkt;
+  ci_tcp_hdr* tcp;
+  ci_iovec_ptr piov;
+  int n, syn_len;
+
+  if( !sinf->stack_locked ) {
+    if( (sinf->rc = ci_netif_lock(ni)) )
+      return -1;
+    sinf->stack_locked = 1;
+  }
+  if( ~ts->tcpflags & CI_TCPT_FLAG_FASTOPEN_DEFER ||
+      ts->s.b.state != CI_TCP_SYN_SENT )
+    return 0;
+
+  ci_assert_equal(ts->send.num, 1);
+  pkt = PKT_CHK(ni, ts->send.head);
+  tcp = TX_PKT_IPX_TCP(af, pkt);
+  ci_assert(tcp->tcp_flags & CI_TCP_FLAG_SYN);
+  ci_assert_equal(pkt->n_buffers, 1);
+
+  /* The SYN options take the place of the usual ones. */
+  n = tcp_eff_mss(ts) -
+      (CI_TCP_HDR_OPT_LEN(tcp) - tcp_ipx_outgoing_opts_len(af, ts));
+  n = CI_MIN(n, ci_iovec_bytes(iov, iovlen));
+  syn_len = pkt->buf_len;
+
+  if( n > 0 ) {
+    ci_iovec_ptr_init_nz(&piov, iov, iovlen);
+    oo_pkt_filler_init(&sinf->pf, pkt, PKT_START(pkt) + syn_len);
+    sinf->rc = oo_pkt_fill(ni, &ts->s, &sinf->stack_locked, CI_FALSE,
+                           &sinf->pf, &piov, n CI_KERNEL_ARG(addr_spc));
+    if(CI_UNLIKELY( sinf->rc < 0 )) {
+      /* Nothing was sent: send the SYN bare and report the fault. */
+      pkt->pay_len = pkt->buf_len = syn_len;
+      sinf->rc = -sinf->rc;
+      ci_tcp_fastopen_send_syn(ni, ts);
+      return -1;
+    }
+    oo_offbuf_init(&pkt->buf, PKT_START(pkt) + pkt->buf_len, 0);
+    pkt->pf.tcp_tx.end_seq += n;
+    tcp_enq_nxt(ts) += n;
+    ts->snd_max += n;
+    ts->tcpflags |= CI_TCPT_FLAG_FASTOPEN_DATA;
+  }
+
+  LOG_TC(log(LNT_FMT "TFO SYN with %d bytes", LNT_PRI_ARGS(ni, ts), n));
+  ci_tcp_fastopen_send_syn(ni, ts);
+  return n;
+}
+#endif
+
+
 static int ci_tcp_sendmsg_notsynchronised(ci_netif* ni, ci_tcp_state* ts, 
                                           int flags, struct tcp_send_info* sinf)
 {
+#if CI_CFG_TCP_FASTOPEN
+  if( ts->tcpflags & CI_TCPT_FLAG_FASTOPEN_DEFER ) {
+    /* No data for the SYN on this path */
+    if( !sinf->stack_locked ) {
+      if( (sinf->rc = ci_netif_lock(ni)) )
+        return -1;
+      sinf->stack_locked = 1;
+    }
+    if( ts->tcpflags & CI_TCPT_FLAG_FASTOPEN_DEFER )
+      ci_tcp_fastopen_send_syn(ni, ts);
+  }
+#endif
+
   sinf->rc = 1;
   /* The same sanity check is done in intercept. This one here is to make
   ** sure (whether needed or not) that internal calls are checked.
@@ -2277,6 +2374,21 @@ int ci_tcp_sendmsg(ci_netif* ni, ci_tcp_state* ts,
     RET_WITH_ERRNO(EPIPE);
   }
 
+#if CI_CFG_TCP_FASTOPEN
+  if( ts->tcpflags & CI_TCPT_FLAG_FASTOPEN_DEFER ) {
+    /* Returns what went in the SYN, which may be less than asked for. */
+    m = ci_tcp_sendmsg_fastopen(ni, ts, iov, iovlen, &sinf
+                                CI_KERNEL_ARG(addr_spc));
+    if( m != 0 ) {
+      if( sinf.stack_locked )
+        ci_netif_unlock(ni);
+      if( m < 0 )
+        RET_WITH_ERRNO(sinf.rc);
+      return m;
+    }
+  }
+#endif
+
   if( ci_tcp_sendmsg_notsynchronised(ni, ts, flags, &sinf) == -1 ) {
     ci_tcp_sendmsg_handle_rc_or_tx_errno(ni, ts, flags, &sinf);
     if( sinf.set_errno ) CI_SET_ERROR(sinf.rc, sinf.rc);
@@ -2355,7 +2467,8 @@ ci_tcp_offload_zc_send_accum_crc(ci_netif* ni, ci_ip_pkt_fmt* pkt,
     abort();
   }
   ci_uint32 crc = crc_prefix->accum_crc.reset ? 0 : ni->state->nvme_crc_plugin_idp[intf_i].crcs[id];
-  ni->state->nvme_crc_plugin_idp[intf_i].crcs[id] = crc32c(crc ^ 0xffffffff, zcp->local_addr, zcp->len);
+  ni->state->nvme_crc_plugin_idp[intf_i].crcs[id] =
+    ~ci_crc32c_partial(zcp->local_addr, zcp->len, ~crc);
 #endif
 #endif
 
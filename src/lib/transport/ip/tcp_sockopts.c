@@ -17,6 +17,13 @@
 #include <ci/internal/ip_stats.h>
 #include <ci/net/sockopts.h>
 
+#ifndef TCP_FASTOPEN
+# define TCP_FASTOPEN          23
+#endif
+#ifndef TCP_FASTOPEN_CONNECT
+# define TCP_FASTOPEN_CONNECT  30
+#endif
+
 #if !defined(__KERNEL__)
 #  include <onload/extensions_zc.h>
 #  include <onload/extensions_zc_hlrx.h>
@@ -151,10 +158,20 @@ ci_tcp_info_get(ci_netif* netif, ci_sock_cmn* s, struct ci_tcp_info* uinfo,
     }
     info.tcpi_total_retrans = ts->stats.total_retrans;
 
-    /* Starting from linux-3.15, there are tcpi_pacing_rate and
-     * tcpi_max_pacing_rate fields.  However, as Onload does not support
-     * pacing, we might as well pretend that we simulate older kernel
-     * with smaller tcp_info size. */
+    /* Report "unlimited" like Linux does for a socket without a pacing
+     * rate.  ci_tcp_cong_get_info() fills in the rate we pace at, or the
+     * congestion control algorithm would pace at. */
+    info.tcpi_pacing_rate = ~0ULL;
+#if CI_CFG_TCP_PACING
+    info.tcpi_max_pacing_rate = ts->c.max_pacing_rate;
+#else
+    info.tcpi_max_pacing_rate = ~0ULL;
+#endif
+    if( s->b.state & CI_TCP_STATE_SYNCHRONISED )
+      info.tcpi_bytes_received = SEQ_SUB(tcp_rcv_nxt(ts), ts->stats.rx_isn);
+    info.tcpi_notsent_bytes = SEQ_SUB(tcp_enq_nxt(ts), tcp_snd_nxt(ts));
+    info.tcpi_min_rtt = ~0U;
+    ci_tcp_cong_get_info(netif, ts, &info);
   }
 
   if( *optlen > sizeof(info) )
@@ -231,6 +248,26 @@ int ci_get_sol_tcp(ci_netif* netif, ci_sock_cmn* s, int optname, void *optval,
       }
       goto u_out;
     }
+  case TCP_CONGESTION:
+    {
+      char name[CI_TCP_CONG_NAME_MAX];
+
+      memset(name, 0, sizeof(name));
+      strncpy(name, ci_tcp_cong_name(c->cong_alg), sizeof(name) - 1);
+      *optlen = CI_MIN(*optlen, sizeof(name));
+      memcpy(optval, name, *optlen);
+      return 0;
+    }
+#if CI_CFG_TCP_FASTOPEN
+  case TCP_FASTOPEN:
+    u = c->fastopen_qlen;
+    goto u_out;
+  case TCP_FASTOPEN_CONNECT:
+    u = 0;
+    if( s->b.state != CI_TCP_LISTEN )
+      u = (SOCK_TO_TCP(s)->tcpflags & CI_TCPT_FLAG_FASTOPEN) != 0;
+    goto u_out;
+#endif
   case TCP_QUICKACK:
     {
       u = 0;
@@ -303,6 +340,19 @@ int ci_tcp_getsockopt(citp_socket* ep, ci_fd_t fd, int level,
       ci_tcp_state* ts = SOCK_TO_TCP(s);
       ci_tcp_set_sndbuf_from_sndbuf_pkts(netif, ts);
     }
+#if CI_CFG_TCP_PACING
+    else if( optname == SO_MAX_PACING_RATE ) {
+      ci_uint64 rate = SOCK_TO_WAITABLE_OBJ(s)->tcp.c.max_pacing_rate;
+      unsigned u;
+
+      /* As Linux: 64 bits if there is room, else saturated to 32 */
+      if( *optlen >= sizeof(rate) )
+        return ci_getsockopt_final(optval, optlen, SOL_SOCKET,
+                                   &rate, sizeof(rate));
+      u = (unsigned) CI_MIN(rate, 0xffffffffull);
+      return ci_getsockopt_final(optval, optlen, SOL_SOCKET, &u, sizeof(u));
+    }
+#endif
 
     /* Common SOL_SOCKET handler */
     return ci_get_sol_socket(netif, s, optname, optval, optlen);
@@ -379,6 +429,23 @@ static int ci_tcp_setsockopt_lk(citp_socket* ep, ci_fd_t fd, int level,
       }
       break;
 
+#if CI_CFG_TCP_PACING
+    case SO_MAX_PACING_RATE:
+      /* As Linux: a 32-bit value of ~0 means "unlimited" */
+      if( optlen == sizeof(ci_uint64) ) {
+        c->max_pacing_rate = *(const ci_uint64*) optval;
+      }
+      else {
+        if( (rc = opt_not_ok(optval, optlen, unsigned)) )
+          goto fail_inval;
+        if( *(const unsigned*) optval == ~0u )
+          c->max_pacing_rate = CI_TCP_PACING_RATE_UNLIMITED;
+        else
+          c->max_pacing_rate = *(const unsigned*) optval;
+      }
+      break;
+#endif
+
     default:
       {
         /* Common socket level options */
@@ -395,6 +462,29 @@ static int ci_tcp_setsockopt_lk(citp_socket* ep, ci_fd_t fd, int level,
     return ci_set_sol_ip6(netif, s, optname, optval, optlen);
   }
   else if( level == IPPROTO_TCP ) {
+    if( optname == TCP_CONGESTION ) {
+      /* The only string value */
+      char name[CI_TCP_CONG_NAME_MAX];
+      int alg;
+
+      if( optlen < 1 ) {
+        rc = -EINVAL;
+        goto fail_inval;
+      }
+      optlen = CI_MIN(optlen, sizeof(name) - 1);
+      memcpy(name, optval, optlen);
+      name[optlen] = '\0';
+      if( (rc = ci_tcp_cong_by_name(name)) < 0 )
+        goto fail_inval;
+      alg = rc;
+      if( alg != c->cong_alg ) {
+        c->cong_alg = alg;
+        if( s->b.state != CI_TCP_LISTEN )
+          ci_tcp_cong_init(netif, SOCK_TO_TCP(s));
+      }
+      return 0;
+    }
+
     /* These are ints values */
     if( (rc = opt_not_ok(optval, optlen, int)) )
       goto fail_inval;
@@ -509,6 +599,34 @@ static int ci_tcp_setsockopt_lk(citp_socket* ep, ci_fd_t fd, int level,
         }
       }
       break;
+#if CI_CFG_TCP_FASTOPEN
+    case TCP_FASTOPEN:
+      /* Value is the maximum number of connections accepted with data in
+       * the SYN waiting to be accepted. */
+      if( *(int*) optval < 0 ||
+          (s->b.state != CI_TCP_CLOSED && s->b.state != CI_TCP_LISTEN) ) {
+        rc = -EINVAL;
+        goto fail_inval;
+      }
+      c->fastopen_qlen = CI_MIN(*(int*) optval, 0xffff);
+      break;
+    case TCP_FASTOPEN_CONNECT:
+      if( s->b.state != CI_TCP_CLOSED ) {
+        rc = -EINVAL;
+        goto fail_inval;
+      }
+      if( *(int*) optval ) {
+        if( ! (NI_OPTS(netif).tcp_fastopen & CI_TCP_FASTOPEN_CLIENT) ) {
+          rc = -EOPNOTSUPP;
+          goto fail_inval;
+        }
+        SOCK_TO_TCP(s)->tcpflags |= CI_TCPT_FLAG_FASTOPEN;
+      }
+      else {
+        SOCK_TO_TCP(s)->tcpflags &=~ CI_TCPT_FLAG_FASTOPEN;
+      }
+      break;
+#endif
 #if CI_CFG_TCP_OFFLOAD_RECYCLER
     case ONLOAD_TCP_OFFLOAD:
       {
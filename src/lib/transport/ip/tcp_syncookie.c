@@ -258,3 +258,84 @@ ci_tcp_syncookie_ack(ci_netif* netif, ci_tcp_socket_listen* tls,
   CITP_STATS_TCP_LISTEN(++tls->stats.n_syncookie_ack_answ);
 }
 
+
+
+#if CI_CFG_TCP_FASTOPEN
+
+/* TCP Fast Open cookies (RFC7413) are a MAC of the client address, keyed
+ * by the stack's secret.  The server address goes in too, so that a cookie
+ * is no good for another server sharing the stack. */
+void
+ci_tcp_fastopen_cookie(ci_netif* netif, ci_addr_t l_addr, ci_addr_t r_addr,
+                       ci_uint8* cookie)
+{
+  ci_uint8 hash_data[1 + 2 * sizeof(ci_addr_t)];
+  ci_uint64 mac;
+
+  /* Keep these apart from the syncookies, which use the same key */
+  hash_data[0] = 'F';
+  memcpy(hash_data + 1, &r_addr, sizeof(r_addr));
+  memcpy(hash_data + 1 + sizeof(r_addr), &l_addr, sizeof(l_addr));
+
+  CI_BUILD_ASSERT(CI_TCP_FASTOPEN_COOKIE_LEN == sizeof(mac));
+  mac = sip_hash((void *)netif->state->hash_salt,
+                 hash_data, sizeof(hash_data));
+  memcpy(cookie, &mac, sizeof(mac));
+}
+
+
+int
+ci_tcp_fastopen_cookie_check(ci_netif* netif, ci_addr_t l_addr,
+                             ci_addr_t r_addr, const ci_uint8* cookie,
+                             int len)
+{
+  ci_uint8 expected[CI_TCP_FASTOPEN_COOKIE_LEN];
+
+  if( len != CI_TCP_FASTOPEN_COOKIE_LEN )
+    return 0;
+  ci_tcp_fastopen_cookie(netif, l_addr, r_addr, expected);
+  return memcmp(cookie, expected, len) == 0;
+}
+
+
+static unsigned
+ci_tcp_fastopen_cache_idx(ci_netif* netif, ci_addr_t r_addr)
+{
+  return sip_hash((void *)netif->state->hash_salt, &r_addr, sizeof(r_addr))
+         % CI_TCP_FASTOPEN_CACHE_SIZE;
+}
+
+
+int
+ci_tcp_fastopen_cache_get(ci_netif* netif, ci_addr_t r_addr,
+                          ci_uint8* cookie)
+{
+  unsigned i = ci_tcp_fastopen_cache_idx(netif, r_addr);
+  int len = netif->state->fastopen_cache[i].len;
+
+  if( len == 0 ||
+      ! CI_IPX_ADDR_EQ(netif->state->fastopen_cache[i].addr, r_addr) )
+    return 0;
+  if( cookie != NULL )
+    memcpy(cookie, netif->state->fastopen_cache[i].cookie, len);
+  return len;
+}
+
+
+void
+ci_tcp_fastopen_cache_put(ci_netif* netif, ci_addr_t r_addr,
+                          const ci_uint8* cookie, int len)
+{
+  unsigned i = ci_tcp_fastopen_cache_idx(netif, r_addr);
+
+  ci_assert(ci_netif_is_locked(netif));
+  ci_assert_ge(len, CI_TCP_FASTOPEN_COOKIE_MIN);
+  ci_assert_le(len, CI_TCP_FASTOPEN_COOKIE_MAX);
+
+  /* Most recent wins if two servers share a slot */
+  netif->state->fastopen_cache[i].addr = r_addr;
+  memcpy(netif->state->fastopen_cache[i].cookie, cookie, len);
+  netif->state->fastopen_cache[i].len = len;
+}
+
+#endif
@@ -911,7 +911,7 @@ int ci_tcp_listenq_try_promote(ci_netif* netif, ci_tcp_socket_listen* tls,
 
     /* options and flags */
     ts->tcpflags = 0;
-    ts->tcpflags |= tsr->tcpopts.flags;
+    ts->tcpflags |= tsr->tcpopts.flags & ~CI_TCPT_FLAG_FASTOPEN;
     ts->tcpflags |= CI_TCPT_FLAG_PASSIVE_OPENED;
     ts->outgoing_hdrs_len = CI_IPX_HDR_SIZE(ipcache_af(&ts->s.pkt)) +
                             sizeof(ci_tcp_hdr);
@@ -945,13 +945,17 @@ int ci_tcp_listenq_try_promote(ci_netif* netif, ci_tcp_socket_listen* tls,
     ts->timed_ts = tsr->timest;
     /* SACK has nothing to be done. */
 
-    /* ?? ECN */
+    /* ECN needs no more setup: see CI_TCPT_FLAG_ECN_* */
     ci_tcp_set_hdr_len(ts,
                        ts->outgoing_hdrs_len -
                        CI_IPX_HDR_SIZE(ipcache_af(&ts->s.pkt)));
 
     ts->smss = tsr->tcpopts.smss;
     ts->c.user_mss = tls->c.user_mss;
+    ts->c.cong_alg = tls->c.cong_alg;
+#if CI_CFG_TCP_PACING
+    ts->c.max_pacing_rate = tls->c.max_pacing_rate;
+#endif
     if (ts->c.user_mss && ts->c.user_mss < ts->smss)
       ts->smss = ts->c.user_mss;
 #if CI_CFG_LIMIT_SMSS
@@ -443,6 +443,15 @@ void ci_tcp_send_corked_packets(ci_netif* netif, ci_tcp_state* ts)
   }
 }
 
+#if CI_CFG_TCP_PACING
+/* Called when the pacer may release more data */
+void ci_tcp_timeout_pace(ci_netif* netif, ci_tcp_state* ts)
+{
+  if( ci_ip_queue_not_empty(&ts->send) )
+    ci_tcp_tx_advance(ts, netif);
+}
+#endif
+
 /* Called as TCP_CORK timeout */
 void ci_tcp_timeout_cork(ci_netif* netif, ci_tcp_state* ts)
 {
@@ -462,6 +471,12 @@ void ci_tcp_timeout_rto(ci_netif* netif, ci_tcp_state* ts)
     ci_tcp_timeout_taildrop(netif, ts);
     return;
   }
+#if CI_CFG_TCP_RACK
+  if( ts->tcpflags & CI_TCPT_FLAG_RACK_REO_TIMING ) {
+    ci_tcp_timeout_rack_reo(netif, ts);
+    return;
+  }
+#endif
 
   ci_assert(netif);
   ci_assert(ts);
@@ -569,7 +584,7 @@ void ci_tcp_timeout_rto(ci_netif* netif, ci_tcp_state* ts)
       ts->ssthresh = CI_MAX(x, y);
     }
     else
-      ts->ssthresh = ci_tcp_losswnd(ts);
+      ts->ssthresh = ci_tcp_cong_losswnd(netif, ts);
 
     ts->congstate = CI_TCP_CONG_RTO;
     ts->cwnd_extra = 0;
@@ -618,7 +633,11 @@ void ci_tcp_timeout_rto(ci_netif* netif, ci_tcp_state* ts)
 static void ci_tcp_timeout_taildrop(ci_netif* netif, ci_tcp_state* ts)
 {
 #if CI_CFG_TAIL_DROP_PROBE
-  ci_assert(NI_OPTS(netif).tail_drop_probe);
+  ci_assert(NI_OPTS(netif).tail_drop_probe
+#if CI_CFG_TCP_RACK
+            || NI_OPTS(netif).tcp_rack
+#endif
+            );
   ci_assert(ts->tcpflags & CI_TCPT_FLAG_TAIL_DROP_TIMING);
 
   LOG_TL(log(FNTS_FMT "now=%x srtt=%u+%u "TCP_SND_FMT,
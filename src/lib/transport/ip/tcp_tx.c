@@ -483,6 +483,12 @@ ci_inline void ci_tcp_tx_cwv_idle(ci_netif* netif, ci_tcp_state* ts)
   i = ci_tcp_time_now(netif) - ts->t_last_sent;
   if( i > ts->rto ) {
     /* sender idle for more than an RTO */
+    if( ! ci_tcp_cong_is_reno(ts) ) {
+      ci_tcp_cong_idle_restart(netif, ts);
+      /* BBR's model of the path does not age with idleness. */
+      if( ts->c.cong_alg == EF_TCP_CONG_CONTROL_BBR )
+        return;
+    }
     /* set the ssthresh to 3/4 of cwnd, if larger than ssthresh */
     win = (3*ts->cwnd)>>2u;
     ts->ssthresh = CI_MAX(ts->ssthresh, win);
@@ -519,6 +525,10 @@ ci_inline void ci_tcp_tx_cwv_app_lmtd(ci_netif* netif, ci_tcp_state* ts)
 
   /* This is called to see if the sender is limited by the application */
 
+  /* BBR does its own app-limited accounting. */
+  if( ts->c.cong_alg == EF_TCP_CONG_CONTROL_BBR )
+    return;
+
   if( ci_tcp_inflight(ts) + ts->smss >= CI_MIN(ts->cwnd, tcp_snd_wnd(ts)) ) {
     /* Window is exercised, so network limited.  Record time for later
      * comparisons.
@@ -606,8 +616,12 @@ void ci_tcp_tx_change_mss(ci_netif* ni, ci_tcp_state* ts)
 }
 
 
+/* [fo_len] is the length of the TCP Fast Open cookie [fo_cookie] to send,
+ * 0 for a cookie request, or -1 for no TFO option.
+ */
 static int ci_tcp_tx_insert_syn_options(ci_netif* ni, ci_uint16 amss,
                                         unsigned optflags, unsigned rcv_wscl,
+                                        const ci_uint8* fo_cookie, int fo_len,
                                         ci_uint8** opt)
 {
   int optlen = 0;
@@ -632,6 +646,19 @@ static int ci_tcp_tx_insert_syn_options(ci_netif* ni, ci_uint16 amss,
   }
 #endif
 
+#if CI_CFG_TCP_FASTOPEN
+  /* TFO (RFC7413), if it fits with the timestamp (NOP, NOP, TSopt). */
+  if( fo_len >= 0 &&
+      ((optflags & CI_TCPT_FLAG_TSO) ? 12 : 0) + optlen + 2 + fo_len <=
+      CI_TCP_MAX_OPTS_LEN ) {
+    (*opt)[0] = CI_TCP_OPT_FASTOPEN;
+    (*opt)[1] = 2 + fo_len;
+    memcpy(*opt + 2, fo_cookie, fo_len);
+    *opt += 2 + fo_len;
+    optlen += 2 + fo_len;
+  }
+#endif
+
   /* Pad to dword boundary. */
   while( optlen & 3 ) {
     *(*opt)++ = CI_TCP_OPT_END;
@@ -668,9 +695,18 @@ void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
   thdr = PKT_IPX_TCP_HDR(af, pkt);
   if( TS_IPX_TCP(ts)->tcp_flags & CI_TCP_FLAG_SYN ) {
     ci_uint8* opt = CI_TCP_HDR_OPTS(thdr);
+    ci_uint8 fo_cookie[CI_TCP_FASTOPEN_COOKIE_MAX];
+    int fo_len = -1;
+#if CI_CFG_TCP_FASTOPEN
+    /* Send the cookie we have for the server, or ask for one. */
+    if( ts->tcpflags & CI_TCPT_FLAG_FASTOPEN )
+      fo_len = ci_tcp_fastopen_cache_get(netif, ipcache_raddr(&ts->s.pkt),
+                                         fo_cookie);
+#endif
     opt += optlen;
     optlen += ci_tcp_tx_insert_syn_options(netif, ts->amss,
-                                           ts->tcpflags, ts->rcv_wscl, &opt);
+                                           ts->tcpflags, ts->rcv_wscl,
+                                           fo_cookie, fo_len, &opt);
 
     /* If we don't get timestamps, we'll need to calculate RTT without
      * them.  Let's prepare: */
@@ -742,10 +778,14 @@ int ci_tcp_send_sim_synack(ci_netif* netif, ci_tcp_state *ts)
     optlen += ci_tcp_tx_opt_tso(&opt, ci_tcp_time_now(netif), 0);
 
   optlen += ci_tcp_tx_insert_syn_options(netif, ts->amss,
-                                         ts->tcpflags, ts->rcv_wscl, &opt);
+                                         ts->tcpflags, ts->rcv_wscl,
+                                         NULL, -1, &opt);
 
   CI_TCP_HDR_SET_LEN(tcp, sizeof(*tcp) + optlen);
   tcp->tcp_flags |= CI_TCP_FLAG_ACK;
+  /* We don't negotiate ECN on simultaneous open. */
+  tcp->tcp_flags &=~ (CI_TCP_FLAG_ECE | CI_TCP_FLAG_CWR);
+  ts->tcpflags &=~ CI_TCPT_FLAG_ECN;
 
   oo_offbuf_init(&pkt->buf,
                  (uint8_t*) oo_tx_ip_data(pkt) + sizeof(ci_tcp_hdr) + optlen,
@@ -842,6 +882,10 @@ int ci_tcp_synrecv_send(ci_netif* netif, ci_tcp_socket_listen* tls,
   thdr->tcp_seq_be32    = CI_BSWAP_BE32(seq);
   thdr->tcp_ack_be32    = CI_BSWAP_BE32(tsr->rcv_nxt);
   thdr->tcp_flags       = tcp_flags;
+  /* ECN-setup SYN-ACK (RFC3168 6.1.1) */
+  if( (tcp_flags & CI_TCP_FLAG_SYN) &&
+      (tsr->tcpopts.flags & CI_TCPT_FLAG_ECN) )
+    thdr->tcp_flags |= CI_TCP_FLAG_ECE;
 
   /* options */
   opt = CI_TCP_HDR_OPTS(thdr);
@@ -878,10 +922,20 @@ int ci_tcp_synrecv_send(ci_netif* netif, ci_tcp_socket_listen* tls,
       (ipcache->status == retrrc_success ||
        ipcache->status == retrrc_nomac ||
        OO_SP_NOT_NULL(tsr->local_peer)) ) {
+    ci_uint8 fo_cookie[CI_TCP_FASTOPEN_COOKIE_MAX];
+    int fo_len = -1;
+#if CI_CFG_TCP_FASTOPEN
+    /* The client asked for a cookie, or sent one we didn't like. */
+    if( tsr->tcpopts.flags & CI_TCPT_FLAG_FASTOPEN ) {
+      ci_tcp_fastopen_cookie(netif, tsr->l_addr, tsr->r_addr, fo_cookie);
+      fo_len = CI_TCP_FASTOPEN_COOKIE_LEN;
+    }
+#endif
     tsr->amss = ci_tcp_amss(netif, &tls->c, ipcache, __func__);
     optlen += ci_tcp_tx_insert_syn_options(netif, tsr->amss,
                                            tsr->tcpopts.flags,
-                                           tsr->rcv_wscl, &opt);
+                                           tsr->rcv_wscl,
+                                           fo_cookie, fo_len, &opt);
     pkt->pf.tcp_tx.sock_id = OO_SP_NULL;
   }
   /* NB. If [ipcache->status] has some other value, then packet won't be
@@ -960,6 +1014,9 @@ int ci_tcp_retrans_one(ci_tcp_state* ts, ci_netif* netif, ci_ip_pkt_fmt* pkt)
 
   /* place TCP options, ECN, and take RTT on outgoing packet */
   ci_tcp_tx_finish(netif, ts, pkt);
+  if( (ts->tcpflags & CI_TCPT_FLAG_ECN) &&
+      ! (tcp->tcp_flags & CI_TCP_FLAG_SYN) )
+    ci_tcp_tx_ecn(netif, ts, pkt);
 
   /* set the urgent pointer */
   ci_tcp_tx_set_urg_ptr(ts, netif, tcp);
@@ -1064,6 +1121,15 @@ int ci_tcp_retrans(ci_netif* ni, ci_tcp_state* ts, int seq_limit,
   ci_ip_pkt_fmt* pkt;
   int at_start_of_block = 0;
   int seq_space, is_fin;
+#if CI_CFG_TCP_RACK
+  /* In fast recovery RACK retransmits only the segments it deems lost. */
+  int rack = before_sacked_only && ci_tcp_rack_enabled(ni, ts);
+  ci_uint32 rack_now = 0, rack_reo_wnd = 0;
+  if( rack ) {
+    rack_now = ci_tcp_rack_now(ni);
+    rack_reo_wnd = ci_tcp_rack_reo_wnd(ni, ts);
+  }
+#endif
 
   /* Mustn't call this when there's nothing to send. */
   ci_assert(OO_PP_NOT_NULL(ts->retrans_ptr));
@@ -1109,6 +1175,17 @@ int ci_tcp_retrans(ci_netif* ni, ci_tcp_state* ts, int seq_limit,
     /* Stop if we've reached the recovery sequence number. */
     if( SEQ_LE(ts->congrecover, pkt->pf.tcp_tx.start_seq) )  return 1;
 
+#if CI_CFG_TCP_RACK
+    if( rack && ci_tcp_rack_remaining(ni, ts, pkt, rack_reo_wnd, rack_now) ) {
+      /* Not lost yet.  A retransmission is presumably still in flight, so
+      ** step over it; anything else must wait.
+      */
+      if( ~pkt->flags & CI_PKT_FLAG_RTQ_RETRANS )
+        return 0;
+      goto next;
+    }
+#endif
+
 #if CI_CFG_BURST_CONTROL
     if(ts->burst_window && ci_tcp_burst_exhausted(ni, ts)){
       LOG_TV(log(LNT_FMT "tx limited by burst avoidance",
@@ -1127,6 +1204,11 @@ int ci_tcp_retrans(ci_netif* ni, ci_tcp_state* ts, int seq_limit,
 
     *seq_used += seq_space;
     seq_limit -= seq_space;
+#if CI_CFG_TCP_RACK
+    if( rack )
+      CITP_STATS_NETIF_INC(ni, tcp_rack_losses);
+  next:
+#endif
     ts->retrans_seq = pkt->pf.tcp_tx.end_seq;
     ts->retrans_ptr = pkt->next;
     if( OO_PP_IS_NULL(ts->retrans_ptr) )  break;
@@ -1294,10 +1376,58 @@ static void ci_tcp_tx_advance_too_long(ci_netif* ni, ci_tcp_state* ts,
 }
 
 
+#if CI_CFG_TCP_PACING
+/* Limits [right_edge] to the data the pacer lets us send now.  Returns the
+ * budget to account the sent data against, or -1 if the socket is not
+ * paced. */
+static int ci_tcp_tx_pace(ci_netif* ni, ci_tcp_state* ts,
+                          unsigned* right_edge, ci_uint32** p_stop_cntr)
+{
+  unsigned pace_right_edge;
+  int budget;
+
+  if( ! NI_OPTS(ni).tcp_pacing &&
+      ts->c.max_pacing_rate == CI_TCP_PACING_RATE_UNLIMITED )
+    return -1;
+  /* MSG_WARM does not really send anything, and loopback has no wire */
+  if( (ts->tcpflags & CI_TCPT_FLAG_MSG_WARM) ||
+      OO_SP_NOT_NULL(ts->local_peer) )
+    return -1;
+
+  budget = ci_tcp_pace_budget(ni, ts);
+  if( budget < 0 )
+    return -1;
+  pace_right_edge = tcp_snd_nxt(ts) + budget;
+  if( SEQ_LT(pace_right_edge, *right_edge) ) {
+    *p_stop_cntr = &ts->stats.tx_stop_pace;
+    *right_edge = pace_right_edge;
+  }
+  return budget;
+}
+
+
+static void ci_tcp_tx_pace_sent(ci_netif* ni, ci_tcp_state* ts,
+                                unsigned bytes, int paced)
+{
+  ci_tcp_pace_sent(ni, ts, bytes);
+  /* Release the rest on the next tick, unless something else (i.e. an
+   * ACK) gets to it first. */
+  if( paced && ci_ip_queue_not_empty(&ts->send) &&
+      ts->s.b.state != CI_TCP_CLOSED &&
+      ! ci_ip_timer_pending(ni, &ts->pace_tid) )
+    ci_ip_timer_set(ni, &ts->pace_tid, ci_tcp_time_now(ni) + 1);
+}
+#endif
+
+
 void ci_tcp_tx_advance(ci_tcp_state* ts, ci_netif* ni)
 {
   unsigned cwnd_right_edge, right_edge;
   ci_uint32* p_stop_cntr;
+#if CI_CFG_TCP_PACING
+  ci_uint32 snd_nxt;
+  int pace_budget;
+#endif
 
   ci_assert(ci_netif_is_locked(ni));
   ci_assert(ci_ip_queue_not_empty(&ts->send));
@@ -1306,7 +1436,8 @@ void ci_tcp_tx_advance(ci_tcp_state* ts, ci_netif* ni)
   LOG_TV(ci_log("%s: "NTS_FMT "sendq.num=%d inflight=%d", __FUNCTION__,
                 NTS_PRI_ARGS(ni, ts), ts->send.num, ci_tcp_inflight(ts)));
 
-  if( CI_UNLIKELY(ts->tcpflags & CI_TCPT_FLAG_NO_TX_ADVANCE) )
+  if( CI_UNLIKELY(ts->tcpflags & (CI_TCPT_FLAG_NO_TX_ADVANCE |
+                                   CI_TCPT_FLAG_FASTOPEN_DEFER)) )
     return;
 
   ci_tcp_tx_cwv_idle(ni, ts);
@@ -1351,7 +1482,18 @@ void ci_tcp_tx_advance(ci_tcp_state* ts, ci_netif* ni)
   }
 #endif
 
+#if CI_CFG_TCP_PACING
+  pace_budget = ci_tcp_tx_pace(ni, ts, &right_edge, &p_stop_cntr);
+  snd_nxt = tcp_snd_nxt(ts);
+#endif
+
   ci_tcp_tx_advance_to(ni, ts, right_edge, p_stop_cntr);
+
+#if CI_CFG_TCP_PACING
+  if( pace_budget >= 0 )
+    ci_tcp_tx_pace_sent(ni, ts, SEQ_SUB(tcp_snd_nxt(ts), snd_nxt),
+                        p_stop_cntr == &ts->stats.tx_stop_pace);
+#endif
 }
 
 
@@ -1418,6 +1560,9 @@ void ci_tcp_tx_advance_to(ci_netif* ni, ci_tcp_state* ts,
 
     /* place TCP options into outgoing packet */
     ci_tcp_tx_finish(ni, ts, pkt);
+    if( (ts->tcpflags & CI_TCPT_FLAG_ECN) &&
+        ! (tcp->tcp_flags & CI_TCP_FLAG_SYN) )
+      ci_tcp_tx_ecn(ni, ts, pkt);
 
     /* Finish-off the IP header.  We increment the ID field for payload
      * segments because some old versions of Linux GRO require incrementing
@@ -1864,6 +2009,8 @@ void ci_tcp_send_zwin_probe(ci_netif* netif, ci_tcp_state* ts)
     optlen += ci_tcp_tx_opt_sack(&opt, optlen, netif, ts);
 
   tcp->tcp_flags = CI_TCP_FLAG_ACK;
+  if( ts->tcpflags & CI_TCPT_FLAG_ECN_ECE )
+    tcp->tcp_flags |= CI_TCP_FLAG_ECE;
   /* SACK option may change pre-computed header length. */
   CI_TCP_HDR_SET_LEN(tcp, sizeof(ci_tcp_hdr) + optlen);
 
@@ -1896,6 +2043,69 @@ void ci_tcp_send_zwin_probe(ci_netif* netif, ci_tcp_state* ts)
 }
 
 
+#if CI_CFG_TCP_FASTOPEN
+/* (Re)send the SYN-ACK for a connection that was promoted straight from a
+ * SYN with a good Fast Open cookie.  It acks the data in the SYN, so the
+ * client need not send it again.
+ */
+void ci_tcp_send_fastopen_synack(ci_netif* netif, ci_tcp_state* ts)
+{
+  ci_ip_pkt_fmt* pkt;
+  ci_tcp_hdr* tcp;
+  ci_uint8* opt;
+  int optlen = 0;
+  int af = ipcache_af(&ts->s.pkt);
+
+  ci_assert(ci_netif_is_locked(netif));
+  ci_assert(OO_SP_IS_NULL(ts->local_peer));
+
+  pkt = ci_netif_pkt_alloc(netif, 0);
+  if( ! pkt ) {
+    LOG_U(log(LNTS_FMT "out of pkt buffers, not sending TFO SYN-ACK",
+              LNTS_PRI_ARGS(netif, ts)));
+    return;
+  }
+
+  oo_tx_pkt_layout_init(pkt);
+  ci_ipcache_update_flowlabel(netif, &ts->s);
+  ci_pkt_init_from_ipcache(pkt, &ts->s.pkt);
+  tcp = TX_PKT_IPX_TCP(af, pkt);
+  opt = CI_TCP_HDR_OPTS(tcp);
+
+  if( ts->tcpflags & CI_TCPT_FLAG_TSO )
+    optlen += ci_tcp_tx_opt_tso(&opt, ci_tcp_time_now(netif), ts->tsrecent);
+  optlen += ci_tcp_tx_insert_syn_options(netif, ts->amss, ts->tcpflags,
+                                         ts->rcv_wscl, NULL, -1, &opt);
+
+  tcp->tcp_flags = CI_TCP_FLAG_SYN | CI_TCP_FLAG_ACK;
+  if( ts->tcpflags & CI_TCPT_FLAG_ECN )
+    tcp->tcp_flags |= CI_TCP_FLAG_ECE;
+  CI_TCP_HDR_SET_LEN(tcp, sizeof(ci_tcp_hdr) + optlen);
+
+  tcp->tcp_seq_be32 = CI_BSWAP_BE32(tcp_snd_una(ts) - 1);
+  tcp->tcp_ack_be32 = CI_BSWAP_BE32(tcp_rcv_nxt(ts));
+  tcp->tcp_window_be16 = ci_tcp_calc_rcv_wnd_syn(ts->s.so.rcvbuf, ts->amss,
+                                                 ts->rcv_wscl);
+  tcp->tcp_window_be16 = CI_BSWAP_BE16(tcp->tcp_window_be16);
+  ci_tcp_ipx_hdr_init(af, oo_tx_ipx_hdr(af, pkt),
+                      CI_IPX_HDR_SIZE(af) + sizeof(ci_tcp_hdr) + optlen);
+  pkt->buf_len = ( oo_tx_ether_hdr_size(pkt) + CI_IPX_HDR_SIZE(af)
+                   + sizeof(ci_tcp_hdr) + optlen );
+  pkt->pay_len = pkt->buf_len;
+
+  LOG_TC(log(LNTS_FMT "TFO SYN-ACK s=%08x a=%08x",
+             LNTS_PRI_ARGS(netif, ts), tcp_snd_una(ts) - 1,
+             tcp_rcv_nxt(ts)));
+
+  ts->acks_pending = 0;
+  ci_tcp_delack_clear(netif, ts);
+  ci_ip_send_tcp(netif, pkt, ts);
+  CI_TCP_STATS_INC_OUT_SEGS(netif);
+  ci_netif_pkt_release(netif, pkt);
+}
+#endif
+
+
 void ci_tcp_send_ack_loopback(ci_netif* netif, ci_tcp_state* ts)
 {
   ci_tcp_state* peer;
@@ -2012,6 +2222,8 @@ void ci_tcp_send_ack_rx(ci_netif* netif, ci_tcp_state* ts, ci_ip_pkt_fmt* pkt,
   }
 
   tcp->tcp_flags = CI_TCP_FLAG_ACK;
+  if( ts->tcpflags & CI_TCPT_FLAG_ECN_ECE )
+    tcp->tcp_flags |= CI_TCP_FLAG_ECE;
   /* SACK option may change pre-computed header length. */
   CI_TCP_HDR_SET_LEN(tcp, sizeof(ci_tcp_hdr) + optlen);
 
@@ -21,7 +21,8 @@ ci_inline int ci_tcp_tx_opt_tso(ci_uint8** opt,
 /* finish off a transmitted data segment by:
 **   - snarfing a timestamp for RTT measurement
 **   - timestamps
-** could be a place to deal with ECN.
+**   - noting the send time for RACK
+** ECN is dealt with by ci_tcp_tx_ecn().
 ** We could not deal with outgoing SACK here, because it will change packet
 ** length.
 */
@@ -62,6 +63,41 @@ ci_inline void ci_tcp_tx_finish(ci_netif* netif, ci_tcp_state* ts,
   }
 
   tcp->tcp_seq_be32 = CI_BSWAP_BE32(seq);
+#if CI_CFG_TCP_RACK
+  ci_tcp_rack_stamp(netif, pkt);
+#endif
+}
+
+
+/* ECN marking of an outgoing segment on a connection which negotiated
+** ECN (RFC3168 6.1): only new data is ECN-capable, retransmits and
+** control segments are not.  The first new data after a window reduction
+** carries CWR, and every segment echoes ECE when the receiver wants to.
+*/
+ci_inline void ci_tcp_tx_ecn(ci_netif* netif, ci_tcp_state* ts,
+                             ci_ip_pkt_fmt* pkt)
+{
+  int af = ipcache_af(&ts->s.pkt);
+  ci_tcp_hdr* tcp = TX_PKT_IPX_TCP(af, pkt);
+  ci_ipx_hdr_t* ip = oo_tx_ipx_hdr(af, pkt);
+  ci_uint8 tos = ipx_hdr_tos_tclass(af, ip) & ~CI_IP_ECN_MASK;
+
+  ci_assert(ts->tcpflags & CI_TCPT_FLAG_ECN);
+  ci_assert_nflags(tcp->tcp_flags, CI_TCP_FLAG_SYN);
+
+  tcp->tcp_flags &=~ (CI_TCP_FLAG_ECE | CI_TCP_FLAG_CWR);
+  if( ts->tcpflags & CI_TCPT_FLAG_ECN_ECE )
+    tcp->tcp_flags |= CI_TCP_FLAG_ECE;
+  if( SEQ_LE(tcp_snd_nxt(ts), pkt->pf.tcp_tx.start_seq) &&
+      PKT_TCP_TX_SEQ_SPACE(pkt) >
+        (tcp->tcp_flags & CI_TCP_FLAG_FIN ? 1u : 0u) ) {
+    tos |= CI_IP_ECN_ECT0;
+    if( ts->tcpflags & CI_TCPT_FLAG_ECN_CWR ) {
+      tcp->tcp_flags |= CI_TCP_FLAG_CWR;
+      ts->tcpflags &=~ CI_TCPT_FLAG_ECN_CWR;
+    }
+  }
+  ipx_hdr_set_tos_tclass(af, ip, tos);
 }
 
 
@@ -666,4 +666,68 @@ void ci_tcp_retrans_coalesce_block(ci_netif* ni, ci_tcp_state* ts,
       pkt = PKT_CHK(ni, pkt->next);
   }
 }
+
+
+#if CI_CFG_TCP_FASTOPEN
+/* The SYN-ACK acked our SYN but not (all of) the data it carried: turn the
+** rest of the data into an ordinary segment at the head of the send queue.
+**
+** Returns -1 if out of packet buffers, in which case the connection has
+** been dropped.
+*/
+int ci_tcp_tx_fastopen_requeue(ci_netif* ni, ci_tcp_state* ts)
+{
+  int af = ipcache_af(&ts->s.pkt);
+  int hdrlen = ts->outgoing_hdrs_len;
+  ci_ip_pkt_fmt* syn = PKT_CHK(ni, ts->retrans.head);
+  ci_tcp_hdr* syn_tcp = TX_PKT_IPX_TCP(af, syn);
+  ci_ip_pkt_fmt* pkt;
+  int n, off;
+
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert(syn_tcp->tcp_flags & CI_TCP_FLAG_SYN);
+  ci_assert(SEQ_LT(tcp_snd_una(ts), syn->pf.tcp_tx.end_seq));
+  ci_assert_equal(ts->retrans.num, 1);
+
+  n = SEQ_SUB(syn->pf.tcp_tx.end_seq, tcp_snd_una(ts));
+  off = SEQ_SUB(tcp_snd_una(ts), syn->pf.tcp_tx.start_seq + 1);
+
+  pkt = ci_netif_pkt_tx_tcp_alloc(ni, ts);
+  if( pkt == NULL ) {
+    LOG_U(log(LNTS_FMT "out of pkt buffers, can't requeue TFO data",
+              LNTS_PRI_ARGS(ni, ts)));
+    ci_tcp_drop(ni, ts, ENOBUFS);
+    return -1;
+  }
+  oo_tx_pkt_layout_init(pkt);
+  ci_ipcache_update_flowlabel(ni, &ts->s);
+  ci_pkt_init_from_ipcache_len(pkt, &ts->s.pkt, hdrlen);
+
+  memcpy((char*) oo_tx_l3_hdr(pkt) + hdrlen,
+         (char*) syn_tcp + CI_TCP_HDR_LEN(syn_tcp) + off, n);
+  pkt->buf_len = pkt->pay_len = oo_tx_ether_hdr_size(pkt) + hdrlen + n;
+  oo_offbuf_init(&pkt->buf, PKT_START(pkt) + pkt->buf_len, 0);
+  ci_tcp_tx_pkt_set_end(ts, pkt);
+  TX_PKT_IPX_TCP(af, pkt)->tcp_flags = CI_TCP_FLAG_ACK | CI_TCP_FLAG_PSH;
+  pkt->pf.tcp_tx.start_seq = tcp_snd_una(ts);
+  pkt->pf.tcp_tx.end_seq = syn->pf.tcp_tx.end_seq;
+  pkt->pf.tcp_tx.block_end = OO_PP_NULL;
+
+  ci_ip_queue_dequeue(ni, &ts->retrans, syn);
+  ci_netif_pkt_release(ni, syn);
+  ci_tcp_rto_clear(ni, ts);
+
+  pkt->next = ts->send.head;
+  ts->send.head = OO_PKT_P(pkt);
+  if( ++ts->send.num == 1 )
+    ts->send.tail = OO_PKT_P(pkt);
+  ++ts->send_in;
+  tcp_snd_nxt(ts) = tcp_snd_una(ts);
+
+  LOG_TC(log(LNTS_FMT "TFO requeue %d bytes seq=%08x",
+             LNTS_PRI_ARGS(ni, ts), n, tcp_snd_una(ts)));
+  ASSERT_VALID_PKT(ni, pkt);
+  return 0;
+}
+#endif
 #endif
@@ -0,0 +1,299 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+** <L5_PRIVATE L5_SOURCE>
+** Description: Classic BPF interpreter for the onload_tcpdump capture
+**              filter, run by the stack before it queues a packet, and
+**              for SO_ATTACH_REUSEPORT_CBPF programs.
+** </L5_PRIVATE>
+\**************************************************************************/
+
+#include "ip_internal.h"
+
+#if CI_CFG_TCPDUMP || CI_CFG_UDP_REUSEPORT
+
+/* Instruction encoding, as in linux/filter.h.  Our own names so that we
+ * don't depend on which of the kernel and libpcap headers are around. */
+#define OO_BPF_CLASS(code)  ((code) & 0x07)
+#define OO_BPF_LD    0x00
+#define OO_BPF_LDX   0x01
+#define OO_BPF_ST    0x02
+#define OO_BPF_STX   0x03
+#define OO_BPF_ALU   0x04
+#define OO_BPF_JMP   0x05
+#define OO_BPF_RET   0x06
+#define OO_BPF_MISC  0x07
+
+#define OO_BPF_W     0x00
+#define OO_BPF_H     0x08
+#define OO_BPF_B     0x10
+
+#define OO_BPF_IMM   0x00
+#define OO_BPF_ABS   0x20
+#define OO_BPF_IND   0x40
+#define OO_BPF_MEM   0x60
+#define OO_BPF_LEN   0x80
+#define OO_BPF_MSH   0xa0
+
+#define OO_BPF_ADD   0x00
+#define OO_BPF_SUB   0x10
+#define OO_BPF_MUL   0x20
+#define OO_BPF_DIV   0x30
+#define OO_BPF_OR    0x40
+#define OO_BPF_AND   0x50
+#define OO_BPF_LSH   0x60
+#define OO_BPF_RSH   0x70
+#define OO_BPF_NEG   0x80
+#define OO_BPF_MOD   0x90
+#define OO_BPF_XOR   0xa0
+
+#define OO_BPF_JA    0x00
+#define OO_BPF_JEQ   0x10
+#define OO_BPF_JGT   0x20
+#define OO_BPF_JGE   0x30
+#define OO_BPF_JSET  0x40
+
+#define OO_BPF_K     0x00
+#define OO_BPF_X     0x08
+#define OO_BPF_A     0x10
+
+#define OO_BPF_TAX   0x00
+#define OO_BPF_TXA   0x80
+
+#define OO_BPF_MEMWORDS  16
+
+
+/* Copy [base + off, base + off + len) of the frame into buf, following
+ * the scatter-gather chain.  Returns 0 if that isn't within the first
+ * [limit] bytes from [base], or the frame isn't that long.
+ *
+ * The filter and the packet metadata are in shared memory and this runs in
+ * the kernel too, so nothing here may trust them to keep us inside the
+ * packet buffers. */
+static int bpf_load(ci_netif* ni, ci_ip_pkt_fmt* pkt, ci_uint32 base,
+                    ci_uint32 limit, ci_uint32 off, int len, ci_uint8* buf)
+{
+  int n_segs = pkt->n_buffers;
+  int seg_len = n_segs > 1 ? pkt->buf_len : pkt->pay_len;
+  ci_uint8* p = (ci_uint8*) oo_ether_hdr(pkt);
+
+  if( off >= limit || (ci_uint32) len > limit - off )
+    return 0;
+  off += base;
+  if( off >= (ci_uint32) pkt->pay_len || len > pkt->pay_len - (int) off )
+    return 0;
+
+  while( 1 ) {
+    ci_uint8* end = (ci_uint8*) pkt + CI_CFG_PKT_BUF_SIZE;
+    if( p < (ci_uint8*) pkt || p >= end )
+      return 0;
+    seg_len = CI_MAX(CI_MIN(seg_len, (int) (end - p)), 0);
+
+    if( off < (ci_uint32) seg_len ) {
+      int n = CI_MIN(len, seg_len - (int) off);
+      memcpy(buf, p + off, n);
+      buf += n;
+      len -= n;
+      if( len == 0 )
+        return 1;
+      off = 0;
+    }
+    else {
+      off -= seg_len;
+    }
+
+    if( --n_segs <= 0 || OO_PP_IS_NULL(pkt->frag_next) )
+      return 0;
+    pkt = PKT_CHK_NNL(ni, pkt->frag_next);
+    p = pkt->dma_start;
+    seg_len = pkt->buf_len;
+  }
+}
+
+
+ci_uint32 oo_bpf_run(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                     const struct oo_bpf_insn* prog, unsigned n,
+                     ci_uint32 base, ci_uint32 limit)
+{
+  ci_uint32 a = 0, x = 0, mem[OO_BPF_MEMWORDS];
+  ci_uint8 buf[4];
+  ci_uint64 off;
+  unsigned pc;
+
+  memset(mem, 0, sizeof(mem));
+
+  /* Jumps only go forwards, so this terminates. */
+  for( pc = 0; pc < n; ++pc ) {
+    /* Take a copy: the program can change under our feet. */
+    struct oo_bpf_insn i = prog[pc];
+    int size;
+
+    switch( OO_BPF_CLASS(i.code) ) {
+    case OO_BPF_LD:
+    case OO_BPF_LDX: {
+      int mode = i.code & 0xe0;
+      ci_uint32 v;
+
+      /* LDX has MSH but not ABS or IND */
+      if( OO_BPF_CLASS(i.code) == OO_BPF_LDX ?
+          mode == OO_BPF_ABS || mode == OO_BPF_IND : mode == OO_BPF_MSH )
+        return 0;
+
+      switch( mode ) {
+      case OO_BPF_IMM:
+        v = i.k;
+        break;
+      case OO_BPF_LEN:
+        v = limit;
+        break;
+      case OO_BPF_MEM:
+        if( i.k >= OO_BPF_MEMWORDS )
+          return 0;
+        v = mem[i.k];
+        break;
+      case OO_BPF_ABS:
+      case OO_BPF_IND:
+      case OO_BPF_MSH:
+        off = i.k;
+        if( mode == OO_BPF_IND )
+          off += x;
+        if( mode == OO_BPF_MSH || (i.code & 0x18) == OO_BPF_B )
+          size = 1;
+        else if( (i.code & 0x18) == OO_BPF_H )
+          size = 2;
+        else
+          size = 4;
+        if( off > 0xffff ||
+            ! bpf_load(ni, pkt, base, limit, off, size, buf) )
+          return 0;
+        if( mode == OO_BPF_MSH )
+          v = (buf[0] & 0xf) << 2;
+        else if( size == 1 )
+          v = buf[0];
+        else if( size == 2 )
+          v = (buf[0] << 8) | buf[1];
+        else
+          v = ((ci_uint32) buf[0] << 24) | (buf[1] << 16) |
+              (buf[2] << 8) | buf[3];
+        break;
+      default:
+        return 0;
+      }
+
+      if( OO_BPF_CLASS(i.code) == OO_BPF_LDX )
+        x = v;
+      else
+        a = v;
+      break;
+    }
+
+    case OO_BPF_ST:
+    case OO_BPF_STX:
+      if( i.k >= OO_BPF_MEMWORDS )
+        return 0;
+      mem[i.k] = OO_BPF_CLASS(i.code) == OO_BPF_ST ? a : x;
+      break;
+
+    case OO_BPF_ALU: {
+      ci_uint32 v = (i.code & OO_BPF_X) ? x : i.k;
+      switch( i.code & 0xf0 ) {
+      case OO_BPF_ADD:  a += v;  break;
+      case OO_BPF_SUB:  a -= v;  break;
+      case OO_BPF_MUL:  a *= v;  break;
+      case OO_BPF_OR:   a |= v;  break;
+      case OO_BPF_AND:  a &= v;  break;
+      case OO_BPF_XOR:  a ^= v;  break;
+      case OO_BPF_LSH:  a = v < 32 ? a << v : 0;  break;
+      case OO_BPF_RSH:  a = v < 32 ? a >> v : 0;  break;
+      case OO_BPF_NEG:  a = -a;  break;
+      case OO_BPF_DIV:
+        if( v == 0 )
+          return 0;
+        a /= v;
+        break;
+      case OO_BPF_MOD:
+        if( v == 0 )
+          return 0;
+        a %= v;
+        break;
+      default:
+        return 0;
+      }
+      break;
+    }
+
+    case OO_BPF_JMP: {
+      ci_uint32 v = (i.code & OO_BPF_X) ? x : i.k;
+      unsigned jump;
+      switch( i.code & 0xf0 ) {
+      case OO_BPF_JA:
+        if( i.k >= n - pc - 1 )
+          return 0;
+        pc += i.k;
+        continue;
+      case OO_BPF_JEQ:   jump = a == v ? i.jt : i.jf;  break;
+      case OO_BPF_JGT:   jump = a > v ? i.jt : i.jf;   break;
+      case OO_BPF_JGE:   jump = a >= v ? i.jt : i.jf;  break;
+      case OO_BPF_JSET:  jump = (a & v) ? i.jt : i.jf; break;
+      default:
+        return 0;
+      }
+      if( jump >= n - pc - 1 )
+        return 0;
+      pc += jump;
+      break;
+    }
+
+    case OO_BPF_RET:
+      switch( i.code & 0x18 ) {
+      case OO_BPF_K:  return i.k;
+      case OO_BPF_X:  return x;
+      case OO_BPF_A:  return a;
+      default:        return 0;
+      }
+
+    case OO_BPF_MISC:
+      if( (i.code & 0xf8) == OO_BPF_TAX )
+        x = a;
+      else if( (i.code & 0xf8) == OO_BPF_TXA )
+        a = x;
+      else
+        return 0;
+      break;
+    }
+  }
+
+  /* Fell off the end */
+  return 0;
+}
+
+
+/* Does the program load from the negative offsets that the kernel uses for
+ * ancillary data (SKF_AD_OFF and friends)?  We don't provide that. */
+int oo_bpf_uses_ancillary(const struct oo_bpf_insn* prog, unsigned n)
+{
+  unsigned pc;
+
+  for( pc = 0; pc < n; ++pc ) {
+    int mode = prog[pc].code & 0xe0;
+    if( OO_BPF_CLASS(prog[pc].code) == OO_BPF_LD &&
+        (mode == OO_BPF_ABS || mode == OO_BPF_IND) &&
+        prog[pc].k >= 0x80000000u )
+      return 1;
+  }
+  return 0;
+}
+
+#endif /* CI_CFG_TCPDUMP || CI_CFG_UDP_REUSEPORT */
+
+
+#if CI_CFG_TCPDUMP
+
+ci_uint32 oo_tcpdump_filter(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  return oo_bpf_run(ni, pkt, ni->state->dump_filter,
+                    CI_MIN(ni->state->dump_filter_len, CI_CFG_DUMP_FILTER_MAX),
+                    0, pkt->pay_len);
+}
+
+#endif /* CI_CFG_TCPDUMP */
@@ -93,6 +93,10 @@ static void ci_udp_state_init(ci_netif* netif, ci_udp_state* us)
   us->tx_count = 0;
   us->udpflags = CI_UDPF_MCAST_LOOP;
   us->future_intf_i = 0;
+  us->gso_size = 0;
+#if CI_CFG_UDP_REUSEPORT
+  us->reuseport_group = -1;
+#endif
   us->ip_pktinfo_cache.intf_i = -1;
   us->stamp = 0;
   memset(&us->stats, 0, sizeof(us->stats));
@@ -271,6 +275,14 @@ void ci_udp_state_dump(ci_netif* ni, ci_udp_state* us, const char* pf,
          uss.max_recvq_pkts);
   logger(log_arg, "%s  rcv: os=%u(%u%%) os_slow=%u os_error=%u", pf,
          rx_os, percent(rx_os, rx_total), uss.n_rx_os_slow, uss.n_rx_os_error);
+  if( us->udpflags & CI_UDPF_GRO )
+    logger(log_arg, "%s  rcv: gro=%u gro_segs=%u", pf,
+           uss.n_rx_gro, uss.n_rx_gro_segs);
+#if CI_CFG_UDP_REUSEPORT
+  if( us->reuseport_group >= 0 )
+    logger(log_arg, "%s  rcv: reuseport_group=%d steered=%u", pf,
+           us->reuseport_group, uss.n_rx_reuseport);
+#endif
 
   /* Send path. */
   logger(log_arg, "%s  snd: q=%u+%u ul=%u os=%u(%u%%)", pf,
@@ -319,6 +331,9 @@ void ci_udp_state_dump(ci_netif* ni, ci_udp_state* us, const char* pf,
          uss.n_tx_eagain, uss.n_tx_spin, uss.n_tx_block);
   logger(log_arg, "%s  snd: poll_avoids_full=%d fragments=%d confirm=%d", pf,
          uss.n_tx_poll_avoids_full, uss.n_tx_fragments, uss.n_tx_msg_confirm);
+  if( us->gso_size != 0 || uss.n_tx_gso != 0 )
+    logger(log_arg, "%s  snd: gso_size=%u gso=%u gso_segs=%u", pf,
+           us->gso_size, uss.n_tx_gso, uss.n_tx_gso_segs);
   logger(log_arg,
          "%s  snd: os_slow=%d os_late=%d unconnect_late=%d nomac=%u(%u%%)", pf,
          uss.n_tx_os_slow, uss.n_tx_os_late, uss.n_tx_unconnect_late,
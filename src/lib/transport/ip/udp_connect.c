@@ -116,6 +116,9 @@ static void ci_udp_clr_filters(citp_socket* ep)
 {
   ci_udp_state* us = SOCK_TO_UDP(ep->s);
   if( UDP_GET_FLAG(us, CI_UDPF_FILTERED) ) {
+#if CI_CFG_UDP_REUSEPORT
+    ci_udp_reuseport_group_leave(ep->netif, us);
+#endif
     ci_tcp_ep_clear_filters(ep->netif, S_SP(us), 0);
     UDP_CLR_FLAG(us, CI_UDPF_FILTERED);
   }
@@ -149,6 +152,9 @@ static int ci_udp_set_filters(citp_socket* ep, ci_udp_state* us)
     return rc;
   }
   UDP_SET_FLAG(us, CI_UDPF_FILTERED);
+#if CI_CFG_UDP_REUSEPORT
+  ci_udp_reuseport_group_join(ep->netif, us);
+#endif
   return 0;
 }
 
@@ -752,6 +758,9 @@ void ci_udp_all_fds_gone(ci_netif* netif, oo_sp sock_id, int do_free)
 
   if( UDP_GET_FLAG(us, CI_UDPF_FILTERED) ) {
     UDP_CLR_FLAG(us, CI_UDPF_FILTERED);
+#if CI_CFG_UDP_REUSEPORT
+    ci_udp_reuseport_group_leave(netif, us);
+#endif
     ci_tcp_ep_clear_filters(netif, S_SP(us), 0);
   }
 #ifdef __KERNEL__
@@ -43,7 +43,12 @@ ci_inline int ci_udp_rx_deliver_to_future(ci_sock_cmn* s, void* opaque_arg)
   struct ci_udp_rx_future* future = opaque_arg;
   ci_udp_state* us = SOCK_TO_UDP(s);
 
+  /* Members of a reuseport group are chosen once the packet is complete,
+   * as the group's program looks at the payload. */
   if( ci_udp_recv_q_pkts(&us->recv_q) >= us->stats.max_recvq_pkts ||
+#if CI_CFG_UDP_REUSEPORT
+      us->reuseport_group >= 0 ||
+#endif
       future->socket != NULL ) {
     future->socket = NULL;
     return 1;
@@ -24,6 +24,7 @@
 #if !defined(__KERNEL__)
 #include <sys/socket.h>
 #include <onload/extensions_zc.h>
+#include <ci/net/sockopts.h>
 #endif
 
 #if OO_DO_STACK_POLL
@@ -332,6 +333,118 @@ static void ci_udp_filter_kernel_pkt(ci_netif* ni, ci_udp_state* us,
 #endif /* __KERNEL__ */
 
 
+#ifndef __KERNEL__
+
+/* The flow a UDP_GRO receive is coalescing.  Saved from the first datagram
+ * because that may be reaped once we move on to the next. */
+struct ci_udp_gro_flow {
+  int       af;
+  ci_addr_t saddr;
+  ci_addr_t daddr;
+  ci_uint16 sport_be16;
+  ci_uint16 dport_be16;
+};
+
+
+static void ci_udp_gro_flow_init(struct ci_udp_gro_flow* flow,
+                                 ci_ip_pkt_fmt* pkt)
+{
+  const ci_udp_hdr* udp;
+
+  flow->af = oo_pkt_af(pkt);
+  udp = oo_ipx_data(flow->af, pkt);
+  flow->saddr = RX_PKT_SADDR(pkt);
+  flow->daddr = RX_PKT_DADDR(pkt);
+  flow->sport_be16 = udp->udp_source_be16;
+  flow->dport_be16 = udp->udp_dest_be16;
+}
+
+
+static int ci_udp_gro_flow_match(const struct ci_udp_gro_flow* flow,
+                                 ci_ip_pkt_fmt* pkt)
+{
+  const ci_udp_hdr* udp;
+
+  if( (pkt->flags & CI_PKT_FLAG_INDIRECT) || oo_pkt_af(pkt) != flow->af )
+    return 0;
+  udp = oo_ipx_data(flow->af, pkt);
+  return udp->udp_source_be16 == flow->sport_be16 &&
+         udp->udp_dest_be16 == flow->dport_be16 &&
+         CI_IPX_ADDR_EQ(RX_PKT_SADDR(pkt), flow->saddr) &&
+         CI_IPX_ADDR_EQ(RX_PKT_DADDR(pkt), flow->daddr);
+}
+
+
+/* Move [piov] on by [n] bytes, crossing segments as needed. */
+static void ci_udp_iovec_ptr_skip(ci_iovec_ptr* piov, int n)
+{
+  while( n > 0 ) {
+    int m = CI_MIN(n, (int) CI_IOVEC_LEN(&piov->io));
+    ci_iovec_ptr_advance(piov, m);
+    n -= m;
+    if( CI_IOVEC_LEN(&piov->io) == 0 ) {
+      if( piov->iovlen == 0 )
+        break;
+      piov->io = *piov->iov++;
+      --piov->iovlen;
+    }
+  }
+}
+
+
+/* UDP_GRO: having delivered a datagram of [bytes] into [piov] (as it was
+ * before the copy), append following datagrams of the same flow for as long
+ * as they fit, as Linux GRO would have merged them.  Each must be no longer
+ * than the first, and a shorter one ends the batch.  Returns the total
+ * bytes delivered, and reports the segment size in a UDP_GRO message if
+ * anything was merged.
+ */
+static int ci_udp_recvmsg_gro(ci_udp_recv_info* rinf,
+                              const struct ci_udp_gro_flow* flow,
+                              ci_iovec_ptr* piov, int bytes,
+                              socklen_t controllen)
+{
+  ci_netif* ni = rinf->a->ni;
+  ci_udp_state* us = rinf->a->us;
+  ci_ip_pkt_fmt* pkt;
+  ci_iovec_ptr dest;
+  int gso_size = bytes, n_segs = 1, space, len;
+
+  ci_udp_iovec_ptr_skip(piov, bytes);
+  space = ci_iovec_ptr_bytes_count(piov);
+
+  while( n_segs < CI_UDP_GSO_MAX_SEGS &&
+         (pkt = ci_udp_recv_q_get(ni, &us->recv_q)) != NULL ) {
+    len = pkt->pf.udp.pay_len;
+    if( len > gso_size || len > space ||
+        bytes + len > CI_UDP_MAX_PAYLOAD_BYTES(flow->af) ||
+        ! ci_udp_gro_flow_match(flow, pkt) )
+      break;
+    /* The copy may or may not advance its iovec, so give it a scratch
+     * one and move ours on afterwards. */
+    dest = *piov;
+    if( oo_copy_pkt_to_iovec_no_adv(ni, pkt, &dest, len) != len )
+      break;
+    ci_udp_iovec_ptr_skip(piov, len);
+    ci_udp_recv_q_deliver(ni, &us->recv_q, pkt);
+    bytes += len;
+    space -= len;
+    ++n_segs;
+    if( len < gso_size )
+      break;
+  }
+
+  if( n_segs > 1 ) {
+    ++us->stats.n_rx_gro;
+    us->stats.n_rx_gro_segs += n_segs;
+    ci_ip_cmsg_recv_gro(rinf->msg, controllen, gso_size, &rinf->msg_flags);
+  }
+  return bytes;
+}
+
+#endif /* __KERNEL__ */
+
+
 static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
 {
   ci_netif* ni = rinf->a->ni;
@@ -339,6 +452,12 @@ static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
   ci_msghdr* msg = rinf->msg;
   ci_ip_pkt_fmt* pkt;
   int rc;
+#ifndef __KERNEL__
+  struct ci_udp_gro_flow gro_flow;
+  ci_iovec_ptr gro_iov;
+  socklen_t controllen = 0;
+  int gro;
+#endif
 
   /* NB. [msg] can be NULL for async recv. */
 
@@ -346,7 +465,16 @@ static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
     goto recv_q_is_empty;
 
 #ifndef __KERNEL__
+  gro = CI_UNLIKELY(us->udpflags & CI_UDPF_GRO) && msg != NULL &&
+        ! (rinf->flags & MSG_PEEK) && ! (pkt->flags & CI_PKT_FLAG_INDIRECT);
+# if CI_CFG_ZC_RECV_FILTER
+  /* The filter wants to see each datagram on its own. */
+  gro = gro && ! us->recv_q_filter;
+# endif
+  if( gro )
+    gro_iov = *piov;
   if( msg != NULL ) {
+    controllen = msg->msg_controllen;
     if( CI_UNLIKELY(us->s.cmsg_flags != 0 ) )
       ci_ip_cmsg_recv(ni, us, pkt, msg, 0, &rinf->msg_flags);
     else
@@ -392,7 +520,17 @@ static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
 # endif
 #endif
 
+#ifndef __KERNEL__
+      gro = gro && rc > 0 && rc == pkt->pf.udp.pay_len;
+      if( gro )
+        ci_udp_gro_flow_init(&gro_flow, pkt);
+#endif
+      oo_lat_hist_rx_to_app(ni, S_SP(us), pkt);
       ci_udp_recv_q_deliver(ni, &us->recv_q, pkt);
+#ifndef __KERNEL__
+      if( gro )
+        rc = ci_udp_recvmsg_gro(rinf, &gro_flow, &gro_iov, rc, controllen);
+#endif
     }
     us->udpflags |= CI_UDPF_LAST_RECV_ON;
   }
@@ -677,6 +815,7 @@ struct recvmsg_spinstate {
   ci_uint64 max_spin;
   int do_spin;
   int spin_limit_by_so;
+  int spin_adapt;       /* max_spin is from oo_spin_budget() */
   ci_uint32 timeout;
 #ifndef __KERNEL__
   uint32_t poison;
@@ -942,6 +1081,10 @@ ci_udp_recvmsg_common(ci_udp_recv_info *rinf)
           spin_state.spin_limit_by_so = 1;
         }
       }
+      if( ! spin_state.spin_limit_by_so ) {
+        spin_state.max_spin = oo_spin_budget(ni, spin_state.max_spin);
+        spin_state.spin_adapt = 1;
+      }
     }
   }
 
@@ -970,6 +1113,10 @@ ci_udp_recvmsg_common(ci_udp_recv_info *rinf)
   CI_SET_ERROR(rc, -rc);
 
  out:
+#ifndef __KERNEL__
+  if( spin_state.spin_adapt && rc >= 0 )
+    oo_spin_adapt_record(ni, spin_state.start_frc, us->s.b.spin_cycles);
+#endif
   ni->state->is_spinner = 0;
   return rc;
 
@@ -1321,6 +1468,7 @@ int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args)
 
       us->stamp = pkt->tstamp_frc;
       us->udpflags |= CI_UDPF_LAST_RECV_ON;
+      oo_lat_hist_rx_to_app(ni, S_SP(us), pkt);
     
       cb_flags = CI_IP_IS_MULTICAST(oo_ip_hdr(pkt)->ip_daddr_be32) ? 
         ONLOAD_ZC_MSG_SHARED : 0;
@@ -1501,6 +1649,83 @@ int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args)
 }
 
 
+/* Takes up to [max_msgs] messages from [us] for onload_zc_recv_batch(),
+ * using the iovecs at [*piov].  Doesn't poll or block, and skips the
+ * socket if another thread holds its lock.  Returns the number of
+ * messages, and advances [*piov] and [*piov_len] past the iovecs used.
+ */
+int ci_udp_zc_recv_batch(ci_netif* ni, ci_udp_state* us, int fd,
+                         struct onload_zc_recv_batch_msg* msgs, int max_msgs,
+                         struct onload_zc_iovec** piov, int* piov_len)
+{
+  struct onload_zc_iovec* iov = *piov;
+  int iov_len = *piov_len;
+  struct onload_timestamp ots;
+  ef_timespec nic;
+  ci_ip_pkt_fmt* pkt;
+  int n = 0;
+
+  if( ci_udp_recv_q_is_empty(&us->recv_q) || ! ci_sock_trylock(ni, &us->s.b) )
+    return 0;
+
+  while( n < max_msgs &&
+         (pkt = ci_udp_recv_q_get(ni, &us->recv_q)) != NULL ) {
+    struct onload_zc_recv_batch_msg* m = &msgs[n];
+
+    /* The worst case, rather than walking the fragments to count them */
+    if( iov_len < CI_MIN(pkt->n_buffers, CI_UDP_ZC_IOVEC_MAX) )
+      break;
+
+    m->fd = fd;
+    m->msg.iov = iov;
+    m->msg.msghdr.msg_flags = 0;
+    m->msg.msghdr.msg_controllen = 0;
+    m->msg.msghdr.msg_control = NULL;
+    if( m->msg.msghdr.msg_name == NULL )
+      m->msg.msghdr.msg_namelen = 0;
+    ci_udp_recvmsg_fill_msghdr(ni, &m->msg.msghdr, pkt, &us->s);
+    ci_udp_pkt_to_zc_msg(ni, pkt, &m->msg);
+    m->flags = CI_IP_IS_MULTICAST(oo_ip_hdr(pkt)->ip_daddr_be32) ?
+      ONLOAD_ZC_MSG_SHARED : 0;
+
+#if CI_CFG_ZC_RECV_FILTER
+    if( us->recv_q_filter ) {
+      enum onload_zc_callback_rc filterrc;
+      filterrc =
+        (*(onload_zc_recv_filter_callback)((ci_uintptr_t)us->recv_q_filter))
+          (&m->msg, (void *)((ci_uintptr_t)us->recv_q_filter_arg), m->flags);
+      ci_assert_equal(filterrc, ONLOAD_ZC_CONTINUE);
+      (void)filterrc;
+      pkt->pio_addr = -1;
+    }
+#endif
+
+    ci_udp_compute_stamp(ni, pkt->tstamp_frc, &m->ts);
+    ci_rx_pkt_timestamp_nic(pkt, &ots);
+    onload_timestamp_to_timespec(&ots, &nic);
+    m->hw_ts.tv_sec = nic.tv_sec;
+    m->hw_ts.tv_nsec = nic.tv_nsec;
+
+    us->stamp = pkt->tstamp_frc;
+    us->udpflags |= CI_UDPF_LAST_RECV_ON;
+    oo_lat_hist_rx_to_app(ni, S_SP(us), pkt);
+
+    /* The app owns the buffers now, as for ONLOAD_ZC_KEEP */
+    pkt->rx_flags |= CI_PKT_RX_FLAG_KEEP;
+    ci_udp_recv_q_deliver(ni, &us->recv_q, pkt);
+
+    iov += m->msg.msghdr.msg_iovlen;
+    iov_len -= m->msg.msghdr.msg_iovlen;
+    ++n;
+  }
+
+  ci_sock_unlock(ni, &us->s.b);
+  *piov = iov;
+  *piov_len = iov_len;
+  return n;
+}
+
+
 int ci_udp_recvmsg_kernel(int fd, ci_netif* ni, ci_udp_state* us,
                           struct msghdr* msg, int flags)
 {
@@ -0,0 +1,222 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+*//*! \file
+**  \brief  In-stack SO_REUSEPORT groups for unicast UDP.
+** <L5_PRIVATE L5_SOURCE>
+** </L5_PRIVATE>
+*//*
+\**************************************************************************/
+
+/*! \cidoxg_lib_transport_ip */
+
+/*
+** Sockets in different stacks that share a port are spread over by
+** clustering and RSS.  Within a stack, the software filter table has an
+** entry for only one of the sockets that share a wild filter, so without
+** this every unicast datagram would be delivered to that one socket.
+**
+** Instead, unconnected SO_REUSEPORT sockets bound to the same address and
+** port join a group in the shared stack state when their filters are
+** inserted, and ci_udp_rx_deliver() asks ci_udp_reuseport_group_select()
+** which member should have each unicast datagram.  As in the kernel, the
+** choice is made by the program attached with SO_ATTACH_REUSEPORT_CBPF,
+** run over the UDP payload, or by a hash of the addresses and ports if
+** there is no program or it returns an index beyond the last member.
+** Multicast and broadcast datagrams are delivered to every socket as
+** before.
+**
+** The groups are in shared memory and are read in the kernel, so nothing
+** here trusts them to be consistent.  They are only changed with the
+** stack lock held.
+*/
+
+#include "ip_internal.h"
+#include <onload/hash.h>
+
+#if CI_CFG_UDP_REUSEPORT
+
+#define LPF "UDP REUSEPORT "
+
+
+static struct oo_udp_reuseport_group*
+ci_udp_reuseport_group(ci_netif* ni, ci_udp_state* us)
+{
+  if( (unsigned) us->reuseport_group >= CI_CFG_UDP_REUSEPORT_GROUPS )
+    return NULL;
+  return &ni->state->udp_reuseport[us->reuseport_group];
+}
+
+
+/* Called once the socket's filters are in place. */
+void ci_udp_reuseport_group_join(ci_netif* ni, ci_udp_state* us)
+{
+  ci_addr_t laddr = udp_ipx_laddr(us);
+  ci_uint16 lport_be16 = udp_lport_be16(us);
+  struct oo_udp_reuseport_group* grp;
+  int g, free_g = -1;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  if( ! NI_OPTS(ni).udp_reuseport_instack ||
+      ! (us->s.s_flags & CI_SOCK_FLAG_REUSEPORT) ||
+      us->reuseport_group >= 0 || lport_be16 == 0 ||
+      ! CI_IPX_ADDR_IS_ANY(udp_ipx_raddr(us)) ||
+      CI_IPX_IS_MULTICAST(laddr) )
+    return;
+
+  for( g = 0; g < CI_CFG_UDP_REUSEPORT_GROUPS; ++g ) {
+    grp = &ni->state->udp_reuseport[g];
+    if( grp->n_members == 0 ) {
+      if( free_g < 0 )
+        free_g = g;
+    }
+    else if( grp->lport_be16 == lport_be16 &&
+             CI_IPX_ADDR_EQ(grp->laddr, laddr) ) {
+      if( grp->n_members >= CI_CFG_UDP_REUSEPORT_GROUP_SIZE )
+        goto full;
+      grp->members[grp->n_members++] = S_SP(us);
+      us->reuseport_group = g;
+      LOG_UC(log(LPF NS_FMT "joined group %d with %d members",
+                 NS_PRI_ARGS(ni, &us->s), g, grp->n_members));
+      return;
+    }
+  }
+
+  if( free_g < 0 )
+    goto full;
+  grp = &ni->state->udp_reuseport[free_g];
+  memset(grp, 0, sizeof(*grp));
+  grp->laddr = laddr;
+  grp->lport_be16 = lport_be16;
+  grp->members[0] = S_SP(us);
+  grp->n_members = 1;
+  us->reuseport_group = free_g;
+  LOG_UC(log(LPF NS_FMT "created group %d", NS_PRI_ARGS(ni, &us->s), free_g));
+  return;
+
+ full:
+  /* The socket still gets its share of the datagrams if it happens to be
+   * the one with the software filter, but not otherwise. */
+  CITP_STATS_NETIF_INC(ni, udp_reuseport_no_group);
+  NI_LOG_ONCE(ni, RESOURCE_WARNINGS,
+              "SO_REUSEPORT: no room in the stack's groups for another "
+              "socket, so datagrams will not be spread over it");
+}
+
+
+/* Called when the socket's filters are removed, which may be in the
+ * kernel. */
+void ci_udp_reuseport_group_leave(ci_netif* ni, ci_udp_state* us)
+{
+  struct oo_udp_reuseport_group* grp = ci_udp_reuseport_group(ni, us);
+  unsigned i, n;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  us->reuseport_group = -1;
+  if( grp == NULL )
+    return;
+
+  n = CI_MIN(grp->n_members, CI_CFG_UDP_REUSEPORT_GROUP_SIZE);
+  for( i = 0; i < n; ++i )
+    if( OO_SP_EQ(grp->members[i], S_SP(us)) ) {
+      /* Fill the hole from the end, as the kernel does.  Indices returned
+       * by the program refer to the members in that order. */
+      grp->members[i] = grp->members[n - 1];
+      grp->n_members = n - 1;
+      if( grp->n_members == 0 )
+        grp->prog_len = 0;
+      LOG_UC(log(LPF NS_FMT "left group with %d members",
+                 NS_PRI_ARGS(ni, &us->s), grp->n_members));
+      return;
+    }
+}
+
+
+/* [prog] is the sock_filter array from the application, or NULL to
+ * detach. */
+int ci_udp_reuseport_group_attach(ci_netif* ni, ci_udp_state* us,
+                                  const struct oo_bpf_insn* prog,
+                                  unsigned len)
+{
+  struct oo_udp_reuseport_group* grp = ci_udp_reuseport_group(ni, us);
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  if( grp == NULL ) {
+    if( prog != NULL )
+      NI_LOG_ONCE(ni, USAGE_WARNINGS,
+                  "SO_ATTACH_REUSEPORT_CBPF: only supported once the socket "
+                  "is bound, so datagrams will be steered by hash instead");
+    return 0;
+  }
+
+  grp->prog_len = 0;
+  if( prog == NULL )
+    return 0;
+  if( len > CI_CFG_UDP_REUSEPORT_PROG_MAX ||
+      oo_bpf_uses_ancillary(prog, len) ) {
+    NI_LOG_ONCE(ni, USAGE_WARNINGS,
+                "SO_ATTACH_REUSEPORT_CBPF: programs of more than %d "
+                "instructions or using ancillary data are not supported, so "
+                "datagrams will be steered by hash instead",
+                CI_CFG_UDP_REUSEPORT_PROG_MAX);
+    return 0;
+  }
+  memcpy(grp->prog, prog, len * sizeof(*prog));
+  grp->prog_len = len;
+  return 0;
+}
+
+
+ci_udp_state* ci_udp_reuseport_group_select(ci_netif* ni, ci_udp_state* us,
+                                            ci_ip_pkt_fmt* pkt)
+{
+  struct oo_udp_reuseport_group* grp = ci_udp_reuseport_group(ni, us);
+  int af = oo_pkt_af(pkt);
+  ci_ipx_hdr_t* ipx = oo_ipx_hdr(pkt);
+  ci_addr_t daddr = ipx_hdr_daddr(af, ipx);
+  ci_udp_hdr* udp;
+  ci_sock_cmn* s;
+  unsigned n, prog_len, i;
+  oo_sp sock_id;
+
+  if( grp == NULL ||
+      (n = CI_MIN(grp->n_members, CI_CFG_UDP_REUSEPORT_GROUP_SIZE)) <= 1 ||
+      CI_IPX_IS_MULTICAST(daddr) ||
+      (! IS_AF_INET6(af) && daddr.ip4 == CI_IP_ALL_BROADCAST) )
+    return us;
+
+  udp = oo_ipx_data(af, pkt);
+  prog_len = CI_MIN(grp->prog_len, CI_CFG_UDP_REUSEPORT_PROG_MAX);
+  if( prog_len != 0 ) {
+    i = oo_bpf_run(ni, pkt, grp->prog, prog_len,
+                   CI_UDP_PAYLOAD(udp) - PKT_START(pkt),
+                   pkt->pf.udp.pay_len);
+    if( i < n ) {
+      CITP_STATS_NETIF_INC(ni, udp_reuseport_prog);
+      goto found;
+    }
+  }
+
+  i = onload_hash3(daddr, udp->udp_dest_be16,
+                   ipx_hdr_saddr(af, ipx), udp->udp_source_be16,
+                   IPPROTO_UDP) % n;
+  CITP_STATS_NETIF_INC(ni, udp_reuseport_hash);
+
+ found:
+  sock_id = grp->members[i];
+  if( ! IS_VALID_SOCK_P(ni, sock_id) )
+    return us;
+  s = SP_TO_SOCK(ni, sock_id);
+  if( s->b.state != CI_TCP_STATE_UDP ||
+      SOCK_TO_UDP(s)->reuseport_group != us->reuseport_group )
+    return us;
+  ++SOCK_TO_UDP(s)->stats.n_rx_reuseport;
+  return SOCK_TO_UDP(s);
+}
+
+#endif /* CI_CFG_UDP_REUSEPORT */
+
+/*! \cidoxg_end */
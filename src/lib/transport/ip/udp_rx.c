@@ -128,7 +128,17 @@ int ci_udp_rx_deliver(ci_sock_cmn* s, void* opaque_arg)
   ci_ip_pkt_fmt* q_pkt;
   ci_udp_state* us = SOCK_TO_UDP(s);
   ci_netif* ni = state->ni;
-  int recvq_depth = ci_udp_recv_q_pkts(&us->recv_q) + pkt->n_buffers;
+  int recvq_depth;
+  int steered = 0;
+
+#if CI_CFG_UDP_REUSEPORT
+  if( us->reuseport_group >= 0 ) {
+    us = ci_udp_reuseport_group_select(ni, us, pkt);
+    s = &us->s;
+    steered = 1;
+  }
+#endif
+  recvq_depth = ci_udp_recv_q_pkts(&us->recv_q) + pkt->n_buffers;
 
   LOG_UV(log("%s: "NS_FMT "pay_len=%d "CI_IP_PRINTF_FORMAT" -> "
              CI_IP_PRINTF_FORMAT, __FUNCTION__,
@@ -223,6 +233,15 @@ int ci_udp_rx_deliver(ci_sock_cmn* s, void* opaque_arg)
     CITP_STATS_NETIF_INC(ni, memory_pressure_drops);
     ++us->stats.n_rx_mem_drop;
   }
+  /* A unicast datagram dropped by the member its group chose is dealt
+   * with: any other member would choose the same one, and count the drop
+   * again. */
+  if( steered ) {
+    ci_addr_t daddr = ipx_hdr_daddr(oo_pkt_af(pkt), oo_ipx_hdr(pkt));
+    if( ! CI_IPX_IS_MULTICAST(daddr) &&
+        (IS_AF_INET6(oo_pkt_af(pkt)) || daddr.ip4 != CI_IP_ALL_BROADCAST) )
+      return 1;
+  }
   return 0;  /* continue delivering to other sockets */
 }
 
@@ -20,6 +20,7 @@
 #include <onload/osfile.h>
 #include <onload/pkt_filler.h>
 #include <onload/sleep.h>
+#include <ci/net/sockopts.h>
 
 #ifndef __KERNEL__
 #include <ci/internal/efabcfg.h>
@@ -76,6 +77,7 @@ struct udp_send_info {
   int                   stack_locked;
   ci_uint32             timeout;
   int                   old_ipcache_updated;
+  ci_uint32             gso_size;
 };
 
 static bool ci_ipx_is_first_frag(int af, ci_ipx_hdr_t* ipx)
@@ -1361,6 +1363,75 @@ int ci_udp_sendmsg_fill(ci_netif* ni, ci_udp_state* us,
 }
 
 
+/* Send [bytes_to_send] as datagrams of [sinf->gso_size] payload bytes (the
+ * last may be shorter).  The stack lock is taken once for the lot, so each
+ * datagram goes straight out rather than via [tx_async_q].
+ */
+static void ci_udp_sendmsg_gso(ci_netif* ni, ci_udp_state* us,
+                               ci_iovec_ptr* piov, int bytes_to_send,
+                               int flags, struct udp_send_info* sinf)
+{
+  struct oo_pkt_filler pf;
+  int af = ipcache_af(&us->s.pkt);
+  int bytes_sent = 0, seg_bytes, rc = 0;
+
+  if( ! sinf->stack_locked ) {
+#ifndef __KERNEL__
+    ci_netif_lock(ni);
+#else
+    if( ci_netif_lock(ni) < 0 ) {
+      sinf->rc = -ERESTARTSYS;
+      return;
+    }
+#endif
+    sinf->stack_locked = 1;
+    ++us->stats.n_tx_lock_snd;
+  }
+  ++us->stats.n_tx_gso;
+
+  pf.alloc_pkt = NULL;
+  sinf->rc = 0;
+
+  while( bytes_sent < bytes_to_send ) {
+    seg_bytes = CI_MIN(bytes_to_send - bytes_sent, (int) sinf->gso_size);
+    rc = ci_udp_sendmsg_fill(ni, us, piov, seg_bytes, flags, &pf, sinf,
+                             false);
+    if(CI_UNLIKELY( rc < 0 ))
+      break;
+    /* ci_netif_pkt_alloc_block() may have dropped the lock while waiting
+     * for a buffer, but only returns success with it held again. */
+    ci_assert(sinf->stack_locked);
+#if CI_CFG_TIMESTAMPING
+    if( us->s.timestamping_flags & ONLOAD_SOF_TIMESTAMPING_OPT_ID ) {
+      pf.pkt->ts_key = us->s.ts_key;
+      ci_atomic32_inc(&us->s.ts_key);
+    }
+#endif
+    TX_PKT_SET_DADDR(af, pf.pkt, ipcache_raddr(&sinf->ipcache));
+    TX_PKT_IPX_UDP(af, pf.pkt, false)->udp_dest_be16 =
+        sinf->ipcache.dport_be16;
+
+    ci_udp_sendmsg_send(ni, us, pf.pkt, flags, sinf);
+    ci_netif_pkt_release(ni, pf.pkt);
+    if(CI_UNLIKELY( sinf->rc < 0 )) {
+      rc = sinf->rc;
+      break;
+    }
+    ++us->stats.n_tx_gso_segs;
+    bytes_sent += seg_bytes;
+  }
+
+  if( sinf->stack_locked ) {
+    ci_netif_unlock(ni);
+    sinf->stack_locked = 0;
+  }
+
+  /* Datagrams already on the wire can't be taken back, so a failure part
+   * way through gives a short count, as for a stream socket. */
+  sinf->rc = bytes_sent > 0 ? bytes_sent : rc;
+}
+
+
 static
 void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
                            const ci_msghdr* msg, int flags,
@@ -1373,6 +1444,7 @@ void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
   int was_locked;
   int af = ipcache_af(&us->s.pkt);
   bool need_frag = false;
+  bool gso = false;
 
   /* Caller should guarantee the following: */
   ci_assert(ni);
@@ -1395,8 +1467,19 @@ void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
     ci_iovec_ptr_init(&piov, NULL, 0);
   }
 
-  if( bytes_to_send > sinf->ipcache.mtu - CI_IPX_HDR_SIZE(af) -
-      sizeof(ci_udp_hdr) )
+  if( sinf->gso_size != 0 && bytes_to_send > sinf->gso_size ) {
+    /* As Linux: each segment must fit the MTU unfragmented, and there's a
+     * limit on how many there may be. */
+    if( sinf->gso_size > sinf->ipcache.mtu - CI_IPX_HDR_SIZE(af) -
+        sizeof(ci_udp_hdr) ||
+        bytes_to_send > (unsigned long) sinf->gso_size * CI_UDP_GSO_MAX_SEGS ) {
+      sinf->rc = -EINVAL;
+      return;
+    }
+    gso = true;
+  }
+  else if( bytes_to_send > sinf->ipcache.mtu - CI_IPX_HDR_SIZE(af) -
+           sizeof(ci_udp_hdr) )
     need_frag = true;
 
   /* For now we don't allocate packets in advance, so init to NULL */
@@ -1442,6 +1525,10 @@ void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
     }
     /* IP_PMTUDISC_PROBE does not do anything in non-connected case */
   }
+  if( gso ) {
+    ci_udp_sendmsg_gso(ni, us, &piov, bytes_to_send, flags, sinf);
+    return;
+  }
   rc = ci_udp_sendmsg_fill(ni, us, &piov, bytes_to_send, flags, &pf, sinf,
                            need_frag);
 #if CI_CFG_TIMESTAMPING
@@ -1541,6 +1628,7 @@ int ci_udp_sendmsg(ci_udp_iomsg_args *a,
   sinf.used_ipcache = 0;
   sinf.old_ipcache_updated = 0;
   sinf.timeout = us->s.so.sndtimeo_msec;
+  sinf.gso_size = us->gso_size;
 
 #ifndef __KERNEL__
 #ifdef __i386__
@@ -1552,7 +1640,7 @@ int ci_udp_sendmsg(ci_udp_iomsg_args *a,
 #else
   if(CI_UNLIKELY( CMSG_FIRSTHDR(msg) != NULL )) {
     void* info = NULL;
-    if( ci_ip_cmsg_send(msg, &info) != 0 || info != NULL )
+    if( ci_ip_cmsg_send(msg, &info, &sinf.gso_size) != 0 || info != NULL )
       goto send_via_os;
   }
 #endif
@@ -20,6 +20,7 @@
 #endif
 
 #include <netinet/udp.h>
+#include <ci/net/sockopts.h>
 
 
 #define LPF "UDP SOCKOPTS "
@@ -294,8 +295,18 @@ int ci_udp_getsockopt(citp_socket* ep, ci_fd_t fd, int level,
 #endif
 
   } else if (level == IPPROTO_UDP) {
-    /* We definitely don't support this */
-    RET_WITH_ERRNO(ENOPROTOOPT);
+    switch( optname ) {
+    case CI_UDP_SEGMENT:
+      u = us->gso_size;
+      break;
+    case CI_UDP_GRO:
+      u = (us->udpflags & CI_UDPF_GRO) != 0;
+      break;
+    default:
+      /* We definitely don't support this */
+      RET_WITH_ERRNO(ENOPROTOOPT);
+    }
+    return ci_getsockopt_final(optval, optlen, SOL_UDP, &u, sizeof(u));
   } else {
     SOCKOPT_RET_INVALID_LEVEL(&us->s);
   }
@@ -438,6 +449,22 @@ static int ci_udp_setsockopt_lk(citp_socket* ep, ci_fd_t fd, ci_fd_t os_sock,
       return ci_set_sol_socket(netif, &us->s, optname, optval, optlen);
       break;
 
+#if CI_CFG_UDP_REUSEPORT
+    case CI_SO_ATTACH_REUSEPORT_CBPF:
+    {
+      /* The kernel has checked the program when it was given to the OS
+       * socket.  The instructions are laid out as ours. */
+      const struct ci_sock_fprog* fprog = optval;
+      if( (rc = opt_not_ok(optval, optlen, struct ci_sock_fprog)) )
+        goto fail_inval;
+      return ci_udp_reuseport_group_attach(netif, us, fprog->filter,
+                                           fprog->len);
+    }
+
+    case CI_SO_DETACH_REUSEPORT_BPF:
+      return ci_udp_reuseport_group_attach(netif, us, NULL, 0);
+#endif
+
     default:
       /* Common socket level options */
       return ci_set_sol_socket(netif, &us->s, optname, optval, optlen);
@@ -625,7 +652,26 @@ static int ci_udp_setsockopt_lk(citp_socket* ep, ci_fd_t fd, ci_fd_t os_sock,
 #endif
 
   } else if (level == IPPROTO_UDP) {
-    RET_WITH_ERRNO(ENOPROTOOPT);
+    switch( optname ) {
+    case CI_UDP_SEGMENT:
+      if( (rc = opt_not_ok(optval, optlen, int)) )
+        goto fail_inval;
+      v = *(const int*) optval;
+      if( v < 0 || v > 0xffff )
+        RET_WITH_ERRNO(EINVAL);
+      us->gso_size = v;
+      break;
+    case CI_UDP_GRO:
+      if( (rc = opt_not_ok(optval, optlen, int)) )
+        goto fail_inval;
+      if( *(const int*) optval )
+        us->udpflags |= CI_UDPF_GRO;
+      else
+        us->udpflags &= ~CI_UDPF_GRO;
+      break;
+    default:
+      RET_WITH_ERRNO(ENOPROTOOPT);
+    }
   }
   else {
     LOG_U(log(FNS_FMT "unknown level=%d optname=%d accepted by O/S",
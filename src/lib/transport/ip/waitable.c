@@ -171,6 +171,11 @@ static void __citp_waitable_obj_free(ci_netif* ni, citp_waitable* w)
   OO_P_DLLINK_ASSERT_EMPTY_SB(ni, w, &w->post_poll_link);
   ci_assert(OO_SP_IS_NULL(w->wt_next));
 
+#if CI_CFG_LATENCY_HIST
+  if( NI_OPTS(ni).latency_hist >= 2 )
+    oo_lat_hist_sock_release(ni, W_SP(w));
+#endif
+
   w->wake_request = 0;
   w->sb_flags = 0;
   w->sb_aflags = CI_SB_AFLAG_ORPHAN | CI_SB_AFLAG_NOT_READY;
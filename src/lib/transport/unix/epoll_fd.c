@@ -75,9 +75,10 @@ exec()
 Restore onload epoll fd after exec.  Currently, we get kernel epoll fd
 in the exec'ed app.
 
-epoll_pwait()
-=============
-epoll_pwait(), ppoll() and pselect() are not accelerated.
+epoll_pwait2() with EF_UL_EPOLL=2
+=================================
+The epoll2 block ioctl only takes milliseconds, so sub-millisecond
+epoll_pwait2() timeouts are rounded up.
 
 multi-level poll
 ================
@@ -179,6 +180,89 @@ citp_ul_epoll_member_to_fdi(struct citp_epoll_member* eitem)
 }
 
 
+/* Non-home members live on [oo_sockets], and are also hashed by fd in
+ * [oo_sockets_hash] so that epoll_ctl() can find them quickly in big sets.
+ * The fd alone is the key, so that a member keeps its bucket when its
+ * fdi_seq changes on a stack move.  Callers hold the epoll lock, as for
+ * the list.
+ */
+#define CITP_EPOLL_HASH_MIN  64
+
+static void citp_epoll_hash_rebuild(struct citp_epoll_fd* ep)
+{
+  unsigned n = ep->oo_sockets_hash ? (ep->oo_sockets_hash_mask + 1) * 4 :
+                                     CITP_EPOLL_HASH_MIN;
+  struct citp_epoll_member* eitem;
+  ci_dllist* hash;
+  unsigned i;
+
+  while( n < (unsigned) ep->oo_sockets_n )
+    n *= 2;
+  /* If we can't grow it, we carry on with longer chains, or with walking
+   * the list if there's no table at all. */
+  if( (hash = CI_ALLOC_ARRAY(ci_dllist, n)) == NULL )
+    return;
+  for( i = 0; i < n; ++i )
+    ci_dllist_init(&hash[i]);
+  CI_DLLIST_FOR_EACH2(struct citp_epoll_member, eitem,
+                      dllink, &ep->oo_sockets)
+    ci_dllist_push(&hash[eitem->fd & (n - 1)], &eitem->hash_link);
+
+  ci_free(ep->oo_sockets_hash);
+  ep->oo_sockets_hash = hash;
+  ep->oo_sockets_hash_mask = n - 1;
+}
+
+
+static void citp_epoll_other_insert(struct citp_epoll_fd* ep,
+                                    struct citp_epoll_member* eitem)
+{
+  eitem->item_list = &ep->oo_sockets;
+  ci_dllist_push(&ep->oo_sockets, &eitem->dllink);
+  ep->oo_sockets_n++;
+
+  if( ep->oo_sockets_hash == NULL ||
+      ep->oo_sockets_n > 2 * (ep->oo_sockets_hash_mask + 1) )
+    citp_epoll_hash_rebuild(ep);
+  /* The rebuild hashes everything on the list, including this one */
+  if( ep->oo_sockets_hash != NULL &&
+      ci_dllink_is_self_linked(&eitem->hash_link) )
+    ci_dllist_push(&ep->oo_sockets_hash[eitem->fd & ep->oo_sockets_hash_mask],
+                   &eitem->hash_link);
+}
+
+
+static void citp_epoll_other_remove(struct citp_epoll_fd* ep,
+                                    struct citp_epoll_member* eitem)
+{
+  ci_dllist_remove_safe(&eitem->dllink);
+  ci_dllist_remove_safe(&eitem->hash_link);
+  ep->oo_sockets_n--;
+}
+
+
+static struct citp_epoll_member*
+citp_epoll_other_find(struct citp_epoll_fd* ep, const citp_fdinfo* fd_fdi)
+{
+  struct citp_epoll_member* eitem;
+
+  if(CI_LIKELY( ep->oo_sockets_hash != NULL )) {
+    ci_dllist* bucket =
+      &ep->oo_sockets_hash[fd_fdi->fd & ep->oo_sockets_hash_mask];
+    CI_DLLIST_FOR_EACH2(struct citp_epoll_member, eitem, hash_link, bucket)
+      if( eitem->fd == fd_fdi->fd && eitem->fdi_seq == fd_fdi->seq )
+        break;
+    return eitem;
+  }
+
+  CI_DLLIST_FOR_EACH2(struct citp_epoll_member, eitem,
+                      dllink, &ep->oo_sockets)
+    if( eitem->fd == fd_fdi->fd && eitem->fdi_seq == fd_fdi->seq )
+      break;
+  return eitem;
+}
+
+
 #if CI_CFG_EPOLL3
 static void
 citp_epoll_set_home_stack(struct citp_epoll_fd* ep, ci_netif* ni)
@@ -278,8 +362,7 @@ citp_epoll_promote_to_home(struct citp_epoll_member* eitem, citp_fdinfo* fd_fdi,
   /* Sockets from the oo_sockets list are added to the OS epoll set.
    * We'll handle it when deleting them, see citp_epoll_ctl_onload_del().
    */
-  ci_dllist_remove_safe(&eitem->dllink);
-  ep->oo_sockets_n--;
+  citp_epoll_other_remove(ep, eitem);
   eitem->item_list = &ep->oo_stack_sockets;
   eitem->ready_list_id = ep->ready_list;
   eitem->flags &=~ CITP_EITEM_FLAG_POLL_END;
@@ -461,6 +544,7 @@ static void citp_epoll_purge_other_socks(struct citp_epoll_fd* ep)
                       dllink, &ep->oo_sockets, next_eitem) {
     CI_FREE_OBJ(eitem);
   }
+  ci_free(ep->oo_sockets_hash);
 }
 
 static void citp_epoll_dtor(citp_fdinfo* fdi, int fdt_locked)
@@ -639,6 +723,8 @@ int citp_epoll_create(int size, int flags)
 #endif
   ci_dllist_init(&ep->oo_sockets);
   ep->oo_sockets_n = 0;
+  ep->oo_sockets_hash = NULL;
+  ep->oo_sockets_hash_mask = 0;
   ci_dllist_init(&ep->dead_sockets);
   oo_atomic_set(&ep->refcount, 1);
   ep->epfd_syncs_needed = 0;
@@ -710,7 +796,6 @@ ci_inline int
 citp_epoll_find(struct citp_epoll_fd* ep, const citp_fdinfo* fd_fdi,
                 struct citp_epoll_member** eitem_out, int epoll_fd)
 {
-  struct citp_epoll_member* eitem_next;
 #if CI_CFG_EPOLL3
   citp_socket* sock;
   ci_sb_epoll_state* epoll;
@@ -755,13 +840,8 @@ citp_epoll_find(struct citp_epoll_fd* ep, const citp_fdinfo* fd_fdi,
 
 out:
 #endif
-  CI_DLLIST_FOR_EACH3(struct citp_epoll_member, *eitem_out,
-                      dllink, &ep->oo_sockets, eitem_next) {
-    if( (*eitem_out)->fd == fd_fdi->fd && (*eitem_out)->fdi_seq == fd_fdi->seq )
-      return EPOLL_NON_STACK_EITEM;
-  }
-  *eitem_out = NULL;
-  return -1;
+  *eitem_out = citp_epoll_other_find(ep, fd_fdi);
+  return *eitem_out != NULL ? EPOLL_NON_STACK_EITEM : -1;
 }
 
 
@@ -785,6 +865,7 @@ static void citp_eitem_init(struct citp_epoll_member* eitem,
   citp_eitem_reset_epollet(eitem, fd_fdi);
   eitem->fd = fd_fdi->fd;
   eitem->fdi_seq = fd_fdi->seq;
+  ci_dllink_self_link(&eitem->hash_link);
 #if CI_CFG_EPOLL3
   eitem->ready_list_id = -1;
   ci_dllink_self_link(&eitem->dead_stack_link);
@@ -823,10 +904,8 @@ static void citp_epoll_ctl_onload_add_other(struct citp_epoll_member* eitem,
                                             citp_fdinfo* fd_fdi, int epoll_fd,
                                             ci_uint64 epoll_fd_seq)
 {
-  eitem->item_list = &ep->oo_sockets;
   eitem->flags &=~ CITP_EITEM_FLAG_POLL_END;
-  ci_dllist_push(&ep->oo_sockets, &eitem->dllink);
-  ep->oo_sockets_n++;
+  citp_epoll_other_insert(ep, eitem);
 
 #if CI_CFG_FD_CACHING
   /* We need to be able to autopop at user level if we want to cache, and that
@@ -980,8 +1059,7 @@ static void citp_epoll_ctl_onload_readd(struct citp_epoll_member* eitem,
     ++ep->epfd_syncs_needed;
   ci_dllist_remove(&eitem->dllink);
 
-  ci_dllist_push(&ep->oo_sockets, &eitem->dllink);
-  ep->oo_sockets_n++;
+  citp_epoll_other_insert(ep, eitem);
 
   if( ci_cas32_succeed(&fd_fdi->epoll_fd, -1, epoll_fd) )
     fd_fdi->epoll_fd_seq = epoll_fd_seq;
@@ -1090,8 +1168,7 @@ static int citp_epoll_ctl_onload_del(struct citp_epoll_member* eitem,
     else
 #endif
     {
-      ci_dllist_remove(&eitem->dllink);
-      ep->oo_sockets_n--;
+      citp_epoll_other_remove(ep, eitem);
       if( eitem->epfd_event.events == EP_NOT_REGISTERED ) {
         *sync_kernel = 0;
         CI_FREE_OBJ(eitem);
@@ -1449,8 +1526,7 @@ static void citp_ul_epoll_ctl_sync(struct citp_epoll_fd* ep, int epfd)
         eitem->flags |= CITP_EITEM_FLAG_OS_SYNC;
       }
       else {
-        ci_dllist_remove(&eitem->dllink);
-        ep->oo_sockets_n--;
+        citp_epoll_other_remove(ep, eitem);
         CI_FREE_OBJ(eitem);
       }
       if( --ep->epfd_syncs_needed == 0 )
@@ -1522,8 +1598,7 @@ static int citp_ul_epoll_one(struct oo_ul_epoll_state*__restrict__ eps,
     Log_POLL(ci_log("%s: auto remove fd %d from epoll set",
                     __FUNCTION__, eitem->fd));
 
-    ci_dllist_remove(&eitem->dllink);
-    eps->ep->oo_sockets_n--;
+    citp_epoll_other_remove(eps->ep, eitem);
     CI_FREE_OBJ(eitem);
   }
 
@@ -1764,6 +1839,32 @@ static ci_uint64 timeout_hr_to_us(ci_int64 hr)
 }
 
 
+/* Wait in the kernel.  Timeouts that aren't a whole number of
+ * milliseconds go via epoll_pwait2() so that they don't get rounded up. */
+static int citp_epoll_sys_wait(int epfd, struct epoll_event* events,
+                               int maxevents, ci_int64 timeout_hr,
+                               int timeout_ms, const sigset_t* sigmask)
+{
+  static int no_pwait2;
+
+  if( timeout_hr < OO_EPOLL_MAX_TIMEOUT_HR &&
+      timeout_hr % citp.cpu_khz != 0 && ! no_pwait2 ) {
+    struct timespec ts;
+    int rc;
+    citp_frc_to_timespec(timeout_hr, 0, &ts);
+    rc = citp_sys_epoll_pwait2(epfd, events, maxevents, &ts, sigmask);
+    if( rc >= 0 || errno != ENOSYS )
+      return rc;
+    no_pwait2 = 1;
+  }
+
+  if( sigmask != NULL )
+    return ci_sys_epoll_pwait(epfd, events, maxevents, timeout_ms, sigmask);
+  else
+    return ci_sys_epoll_wait(epfd, events, maxevents, timeout_ms);
+}
+
+
 /* Synchronise state to kernel if:
    - EF_EPOLL_CTL_FAST=0;
    - or we are going to block (timeout != 0 && rc == 0) */
@@ -1831,10 +1932,8 @@ int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event*__restrict__ events,
     if( timeout_ms )
       ep->blocking = 1;
     Log_POLL(ci_log("%s(%d, ..): passthrough", __FUNCTION__, fdi->fd));
-    if( sigmask != NULL )
-      rc = ci_sys_epoll_pwait(fdi->fd, events, maxevents, timeout_ms, sigmask);
-    else
-      rc = ci_sys_epoll_wait(fdi->fd, events, maxevents, timeout_ms);
+    rc = citp_epoll_sys_wait(fdi->fd, events, maxevents, timeout_hr,
+                             timeout_ms, sigmask);
 
     /* We don't have valid timestamps for events grabbed via the kernel, so
      * we need to ensure that the ordering info shows that.
@@ -2227,11 +2326,8 @@ citp_epoll_hook_start(struct citp_epoll_fd* ep, citp_fdinfo* fd_fdi,
   }
 #endif
 
-  CI_DLLIST_FOR_EACH2(struct citp_epoll_member, eitem,
-                      dllink, &ep->oo_sockets) {
-    if( eitem->fd == fd_fdi->fd && eitem->fdi_seq == fd_fdi->seq )
-      return eitem;
-  }
+  if( (eitem = citp_epoll_other_find(ep, fd_fdi)) != NULL )
+    return eitem;
 
   Log_POLL(ci_log("%s: epoll_fd=%d fd=%d not in epoll u/l set",
                   __FUNCTION__, fd_fdi->epoll_fd, fd_fdi->fd));
@@ -2281,9 +2377,7 @@ void citp_epoll_on_move_do(citp_fdinfo* epoll_fdi, citp_fdinfo* fd_fdi,
     if( ep->oo_stack_sockets_n == 0 )
       citp_epoll_last_stack_socket_gone(ep, fdt_locked);
 
-    eitem->item_list = &ep->oo_sockets;
-    ci_dllist_push(&ep->oo_sockets, &eitem->dllink);
-    ep->oo_sockets_n++;
+    citp_epoll_other_insert(ep, eitem);
 
     eitem->fdi_seq = new_fdi->seq;
     eitem->epfd_event.events = EP_NOT_REGISTERED;
@@ -2320,8 +2414,7 @@ static void citp_epoll_on_handover_do(citp_fdinfo* epoll_fdi,
   else
 #endif
   {
-    ep->oo_sockets_n--;
-    ci_dllist_remove(&eitem->dllink);
+    citp_epoll_other_remove(ep, eitem);
   }
 
   if( fd_fdi->protocol->type == CITP_PASSTHROUGH_FD )
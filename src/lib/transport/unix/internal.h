@@ -136,6 +136,7 @@ struct oo_ul_poll_state;
 struct oo_ul_select_state;
 struct citp_epoll_member;
 struct oo_ul_epoll_state;
+struct onload_accept_batch_msg;
 
 typedef struct {
   int  (*socket      )(int domain, int type, int protocol);
@@ -201,6 +202,10 @@ typedef struct {
   int  (*dsend_complete)(citp_fdinfo*, const ci_iovec *iov, int iovlen,
                          int flags);
   int  (*dsend_cancel)(citp_fdinfo*);
+  /* Optional: accepts up to [max_msgs] connections without blocking.
+   * Returns the number accepted or -errno. */
+  int  (*accept_batch)(citp_fdinfo*, struct onload_accept_batch_msg*,
+                       int max_msgs, int flags);
 } citp_fdops;
 
 
@@ -447,6 +452,27 @@ extern int citp_ep_dup3(unsigned oldfd, unsigned newfd, int flags) CI_HF;
 extern int citp_ep_close(unsigned fd) CI_HF;
 
 
+/**********************************************************************
+ ** io_uring support
+ */
+#if CI_CFG_IO_URING
+struct io_uring_params;
+struct citp_uring;
+
+/* Rings we intercept; NULL if there are none */
+extern struct citp_uring* citp_urings CI_HV;
+
+extern int citp_uring_setup(unsigned entries,
+                            struct io_uring_params* p) CI_HF;
+extern long citp_uring_enter(int fd, unsigned to_submit,
+                             unsigned min_complete, unsigned flags,
+                             const void* arg, size_t argsz) CI_HF;
+/* Stop intercepting the ring [fd], if it is one, or else fail the requests
+ * pending on it */
+extern void citp_uring_close(int fd) CI_HF;
+#endif
+
+
 /**********************************************************************
  ** exec() support
  */
@@ -989,21 +1015,21 @@ extern int citp_sock_fcntl(citp_sock_fdi*, int fd, int cmd, long arg) CI_HF;
 /* Generic poll/ppoll implementation.
  * This function is called after citp_enter_lib(), and it MUST NOT call
  * citp_exit_lib().
- * At exit time, if *timeout_ms!=0 and rc==0, caller should block in system
- * call for the specified timeout.
+ * Timeouts are in frc units (see citp_timespec_to_frc()).  At exit time, if
+ * *used_frc < timeout_frc and rc==0, caller should block in system call
+ * for the rest of the timeout.
  */
 int citp_ul_do_poll(struct pollfd*__restrict__ fds, nfds_t nfds,
-                    ci_uint64 timeout_ms, ci_uint64 *used_ms,
+                    ci_uint64 timeout_frc, ci_uint64 *used_frc,
                     citp_lib_context_t *lib_context,
                     const sigset_t *sigmask);
 /* Generic select/pselect implementation.
  * This function is called after citp_enter_lib(), and it MUST NOT call
  * citp_exit_lib().
- * At exit time, if *timeout_ms!=0 and rc==0, caller should block in system
- * call for the specified timeout.
+ * Timeouts are in frc units, as for citp_ul_do_poll().
  */
 int citp_ul_do_select(int nfds, fd_set* rds, fd_set* wrs, fd_set* exs,
-                      ci_uint64 timeout_ms, ci_uint64 *used_ms,
+                      ci_uint64 timeout_frc, ci_uint64 *used_frc,
                       citp_lib_context_t *lib_context,
                       const sigset_t *sigmask);
 
@@ -1129,18 +1155,82 @@ extern int citp_sock_is_spinning(citp_fdinfo* fdi);
 /**********************************************************************
  * Utils
  */
+
+/* poll() and select() timeouts are kept in frc units, so that ppoll(),
+ * pselect() and epoll_pwait2() can spin for exactly as long as asked.
+ * CITP_TIMEOUT_FRC_MAX means no timeout; it leaves room for the time
+ * spent to be added without overflowing.
+ */
+#define CITP_TIMEOUT_FRC_MAX  ((ci_uint64) -1 / 4)
+
+ci_inline ci_uint64 citp_ms_to_frc(ci_uint64 ms)
+{
+  if( ms >= CITP_TIMEOUT_FRC_MAX / citp.cpu_khz )
+    return CITP_TIMEOUT_FRC_MAX;
+  return ms * citp.cpu_khz;
+}
+
+ci_inline ci_uint64 citp_ns_to_frc(ci_uint64 sec, ci_uint64 nsec)
+{
+  ci_uint64 frc;
+
+  if( sec >= CITP_TIMEOUT_FRC_MAX / citp.cpu_khz / 1000 )
+    return CITP_TIMEOUT_FRC_MAX;
+  frc = sec * citp.cpu_khz * 1000 + nsec * citp.cpu_khz / 1000000;
+  /* A tiny timeout is still a timeout, not a non-blocking call */
+  return frc == 0 && nsec != 0 ? 1 : frc;
+}
+
+ci_inline ci_uint64 citp_timespec_to_frc(const struct timespec* ts)
+{
+  if( ts == NULL )
+    return CITP_TIMEOUT_FRC_MAX;
+  return citp_ns_to_frc(ts->tv_sec, ts->tv_nsec);
+}
+
+ci_inline ci_uint64 citp_timeval_to_frc(const struct timeval* tv)
+{
+  if( tv == NULL )
+    return CITP_TIMEOUT_FRC_MAX;
+  return citp_ns_to_frc(tv->tv_sec, (ci_uint64) tv->tv_usec * 1000);
+}
+
+/* The time left of [timeout] after [spent], rounded up */
 ci_inline void
-ms2timespec(ci_uint64 timeout, ci_uint64 spent, struct timespec* tv)
+citp_frc_to_timespec(ci_uint64 timeout, ci_uint64 spent, struct timespec* ts)
 {
-  if( timeout > spent ) {
-    tv->tv_sec = (timeout - spent) / 1000;
-    tv->tv_nsec = ((timeout - spent) % 1000) * 1000000;
+  ci_uint64 frc_per_sec = (ci_uint64) citp.cpu_khz * 1000;
+  ci_uint64 left = timeout > spent ? timeout - spent : 0;
+
+  ts->tv_sec = left / frc_per_sec;
+  ts->tv_nsec = ((left % frc_per_sec) * 1000000 + citp.cpu_khz - 1) /
+                citp.cpu_khz;
+  if( ts->tv_nsec >= 1000000000 ) {
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000;
   }
-  else {
-    tv->tv_sec = tv->tv_nsec = 0;
+}
+
+ci_inline void
+citp_frc_to_timeval(ci_uint64 timeout, ci_uint64 spent, struct timeval* tv)
+{
+  struct timespec ts;
+
+  citp_frc_to_timespec(timeout, spent, &ts);
+  tv->tv_sec = ts.tv_sec;
+  tv->tv_usec = (ts.tv_nsec + 999) / 1000;
+  if( tv->tv_usec >= 1000000 ) {
+    tv->tv_sec++;
+    tv->tv_usec -= 1000000;
   }
 }
 
+ci_inline int citp_frc_to_ms(ci_uint64 timeout, ci_uint64 spent)
+{
+  ci_uint64 left = timeout > spent ? timeout - spent : 0;
+  return CI_MIN((left + citp.cpu_khz - 1) / citp.cpu_khz, 0x7fffffff);
+}
+
 #if CI_CFG_FD_CACHING
 ci_inline int citp_getpid(void)
 {
@@ -43,6 +43,7 @@ LIB_SRCS	:=			\
 		common_fcntl.c		\
 		wqlock.c		\
 		poll_select.c		\
+		uring_intercept.c	\
 		passthrough_fd.c	\
 		utils.c
 
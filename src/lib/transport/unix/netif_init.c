@@ -179,6 +179,10 @@ static void citp_netif_child_fork_hook(void)
   oo_rwlock_ctor(&citp_dup2_lock);
   pthread_mutex_init(&citp_pkt_map_lock, NULL);
 
+  /* The child's thread has a new id, so it must not go on using the
+   * parent's EF_SPIN_ADAPTIVE slot in the stacks it shares. */
+  __oo_per_thread_get()->spin_adapt_tid = 0;
+
   if( citp.init_level < CITP_INIT_FDTABLE)
     return;
 
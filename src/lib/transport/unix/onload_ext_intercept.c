@@ -200,6 +200,76 @@ out:
 }
 
 
+static int onload_accept_batch_fd(int fd, struct onload_accept_batch_msg* msgs,
+                                  int max_msgs, int flags)
+{
+  citp_fdinfo* fdi;
+  int rc = -ESOCKTNOSUPPORT;
+
+  if( (fdi = citp_fdtable_lookup(fd)) != NULL ) {
+    if( citp_fdinfo_get_ops(fdi)->accept_batch != NULL )
+      rc = citp_fdinfo_get_ops(fdi)->accept_batch(fdi, msgs, max_msgs, flags);
+    citp_fdinfo_release_ref(fdi, 0);
+  }
+  return rc;
+}
+
+
+int onload_accept_batch(int fd, struct onload_accept_batch_msg* msgs,
+                        int max_msgs, int flags)
+{
+  citp_lib_context_t lib_context;
+  int rc;
+
+  Log_CALL(ci_log("%s(%d, %p, %d, %x)", __FUNCTION__,
+                  fd, msgs, max_msgs, flags));
+
+  if( max_msgs < 0 || (flags & ~(SOCK_NONBLOCK | SOCK_CLOEXEC)) )
+    return -EINVAL;
+
+  citp_enter_lib(&lib_context);
+  rc = onload_accept_batch_fd(fd, msgs, max_msgs, flags);
+  citp_exit_lib(&lib_context, TRUE);
+
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
+int onload_accept_batchv(struct onload_accept_batch_vec* vec, int vlen,
+                         int flags)
+{
+  citp_lib_context_t lib_context;
+  int n = 0, rc = 0, i;
+
+  Log_CALL(ci_log("%s(%p, %d, %x)", __FUNCTION__, vec, vlen, flags));
+
+  if( vlen < 0 || (flags & ~(SOCK_NONBLOCK | SOCK_CLOEXEC)) )
+    return -EINVAL;
+  for( i = 0; i < vlen; ++i ) {
+    if( vec[i].max_msgs < 0 )
+      return -EINVAL;
+    vec[i].n_msgs = 0;
+  }
+
+  citp_enter_lib(&lib_context);
+  for( i = 0; i < vlen; ++i ) {
+    rc = onload_accept_batch_fd(vec[i].fd, vec[i].msgs, vec[i].max_msgs,
+                                flags);
+    if( rc < 0 )
+      break;
+    vec[i].n_msgs = rc;
+    n += rc;
+  }
+  citp_exit_lib(&lib_context, TRUE);
+
+  if( n > 0 || rc >= 0 )
+    rc = n;
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
 static int onload_fd_check_msg_warm(int fd)
 {
   struct onload_stat stat = { .stack_name = NULL };
@@ -1105,68 +1105,12 @@ OO_INTERCEPT(int, sendmmsg,
 strong_alias(onload_sendmmsg, __sendmmsg);
 
 
-/* Internal poll/select timeout is calculated in milliseconds,
- * and in citp_ul_do_select/citp_ul_do_poll this value is multiplied by
- * citp.cpu_khz, assuming it not to overflow.
- * So we are dividing by 10GHz here.
- * This does limit us to maximum timeout of about 58 years.
- */
-#define MAX_POLL_SELECT_MILLISEC ((ci_uint64) -1 / 10000000)
-static inline ci_uint64
-timespec2ms(const struct timespec* tv)
-{
-  ci_uint64 ms;
-
-  if( tv == NULL )
-    return MAX_POLL_SELECT_MILLISEC;
-  ms = (ci_uint64)tv->tv_sec * 1000 +
-       (tv->tv_nsec + 500000) / 1000000;
-
-  /* If spinning is enabled, user expects us to spin a bit
-   * even with extra-small timeout. */
-  if( ms == 0 && tv->tv_nsec != 0 )
-    ms = 1;
-  if( ms >= MAX_POLL_SELECT_MILLISEC )
-    return MAX_POLL_SELECT_MILLISEC;
-  return ms;
-}
-static inline ci_uint64
-timeval2ms(const struct timeval* tv)
-{
-  ci_uint64 ms;
-
-  if( tv == NULL )
-    return MAX_POLL_SELECT_MILLISEC;
-  ms = (ci_uint64)tv->tv_sec * 1000 +
-    (tv->tv_usec + 500) / 1000;
-
-  /* If spinning is enabled, user expects us to spin a bit
-   * even with extra-small timeout. */
-  if( ms == 0 && tv->tv_usec != 0 )
-    ms = 1;
-  if( ms >= MAX_POLL_SELECT_MILLISEC )
-    return MAX_POLL_SELECT_MILLISEC;
-  return ms;
-}
-static inline void
-ms2timeval(ci_uint64 timeout, ci_uint64 spent, struct timeval* tv)
-{
-  if( timeout > spent ) {
-    tv->tv_sec = (timeout - spent) / 1000;
-    tv->tv_usec = ((timeout - spent) % 1000) * 1000;
-  }
-  else {
-    tv->tv_sec = tv->tv_usec = 0;
-  }
-}
-
-
 OO_INTERCEPT(int, select,
              (int nfds, fd_set* rds, fd_set* wrs, fd_set* exs,
               struct timeval* timeout))
 {
   citp_lib_context_t lib_context;
-  ci_uint64 timeout_ms, used_ms = 0;
+  ci_uint64 timeout_frc, used_frc = 0;
   int rc;
 
   if( CI_UNLIKELY(citp.init_level < CITP_INIT_ALL) ) {
@@ -1186,16 +1130,16 @@ OO_INTERCEPT(int, select,
     goto out;
   }
 
-  timeout_ms = timeval2ms(timeout);
+  timeout_frc = citp_timeval_to_frc(timeout);
 
   citp_enter_lib(&lib_context);
-  rc = citp_ul_do_select(nfds, rds, wrs, exs, timeout_ms, &used_ms,
+  rc = citp_ul_do_select(nfds, rds, wrs, exs, timeout_frc, &used_frc,
                          &lib_context, NULL);
 
   /* Linux-specific behaviour: change timeout parameter. */
-  if( timeout != NULL && used_ms != 0 ) {
-    if( timeout_ms > used_ms )
-      ms2timeval(timeout_ms, used_ms, timeout);
+  if( timeout != NULL && used_frc != 0 ) {
+    if( timeout_frc > used_frc )
+      citp_frc_to_timeval(timeout_frc, used_frc, timeout);
     else
       timeout->tv_sec = timeout->tv_usec = 0;
   }
@@ -1212,7 +1156,7 @@ OO_INTERCEPT(int, pselect,
               const struct timespec *timeout_ts, const sigset_t *sigmask))
 {
   citp_lib_context_t lib_context;
-  ci_uint64 timeout_ms, used_ms = 0;
+  ci_uint64 timeout_frc, used_frc = 0;
   int rc = 0;
 
   if( CI_UNLIKELY(citp.init_level < CITP_INIT_ALL) ) {
@@ -1233,18 +1177,18 @@ OO_INTERCEPT(int, pselect,
     goto out;
   }
 
-  timeout_ms = timespec2ms(timeout_ts);
+  timeout_frc = citp_timespec_to_frc(timeout_ts);
 
   /* Set up signal mask and spin */
   citp_enter_lib(&lib_context);
-  rc = citp_ul_do_select(nfds, rds, wrs, exs, timeout_ms, &used_ms,
+  rc = citp_ul_do_select(nfds, rds, wrs, exs, timeout_frc, &used_frc,
                          &lib_context, sigmask);
 
   /* we should not return 0 without signal check; do it now: */
   if( rc == CI_SOCKET_HANDOVER || (rc == 0 && sigmask != NULL) ) {
-    if( timeout_ts != NULL && used_ms != 0 ) {
+    if( timeout_ts != NULL && used_frc != 0 ) {
       struct timespec ts;
-      ms2timespec(timeout_ms, used_ms, &ts);
+      citp_frc_to_timespec(timeout_frc, used_frc, &ts);
       rc = ci_sys_pselect(nfds, rds, wrs, exs, &ts, sigmask);
     }
     else
@@ -1261,7 +1205,7 @@ OO_INTERCEPT(int, poll,
 {
   citp_lib_context_t lib_context;
   int rc;
-  ci_uint64 used_ms = 0;
+  ci_uint64 timeout_frc, used_frc = 0;
 
   if( CI_UNLIKELY(citp.init_level < CITP_INIT_ALL) ) {
     citp_do_init(CITP_INIT_SYSCALLS);
@@ -1273,11 +1217,14 @@ OO_INTERCEPT(int, poll,
 
   Log_CALL(ci_log("%s(%p, %ld, %d)", __FUNCTION__, fds, nfds, timeout));
 
+  timeout_frc = timeout < 0 ? CITP_TIMEOUT_FRC_MAX : citp_ms_to_frc(timeout);
+
   citp_enter_lib(&lib_context);
-  rc = citp_ul_do_poll(fds, nfds, timeout, &used_ms, &lib_context, NULL);
+  rc = citp_ul_do_poll(fds, nfds, timeout_frc, &used_frc, &lib_context, NULL);
 
-  if( timeout != used_ms && rc == 0 )
-    rc = ci_sys_poll(fds, nfds, timeout - used_ms);
+  if( rc == 0 && timeout_frc > used_frc )
+    rc = ci_sys_poll(fds, nfds,
+                     timeout < 0 ? -1 : citp_frc_to_ms(timeout_frc, used_frc));
 
   Log_CALL_RESULT(rc);
   return rc;
@@ -1296,7 +1243,7 @@ OO_INTERCEPT(int, ppoll,
               const struct timespec *timeout_ts, const sigset_t *sigmask))
 {
   citp_lib_context_t lib_context;
-  ci_uint64 timeout_ms, used_ms = 0;
+  ci_uint64 timeout_frc, used_frc = 0;
   int rc = 0;
 
   if( CI_UNLIKELY(citp.init_level < CITP_INIT_ALL) ) {
@@ -1316,20 +1263,20 @@ OO_INTERCEPT(int, ppoll,
     goto out;
   }
 
-  timeout_ms = timespec2ms(timeout_ts);
+  timeout_frc = citp_timespec_to_frc(timeout_ts);
 
   citp_enter_lib(&lib_context);
-  rc = citp_ul_do_poll(fds, nfds, timeout_ms, &used_ms, &lib_context,
+  rc = citp_ul_do_poll(fds, nfds, timeout_frc, &used_frc, &lib_context,
                        sigmask);
 
   /* Block in the OS, check signals */
-  if( rc == 0 && ( timeout_ms != used_ms ||
-                   (used_ms == 0 && sigmask != NULL) ) ) {
-    if( used_ms == 0 || timeout_ts == NULL )
+  if( rc == 0 && ( timeout_frc > used_frc ||
+                   (timeout_frc == 0 && sigmask != NULL) ) ) {
+    if( used_frc == 0 || timeout_ts == NULL )
       rc = ci_sys_ppoll(fds, nfds, timeout_ts, sigmask);
     else {
       struct timespec ts;
-      ms2timespec(timeout_ms, used_ms, &ts);
+      citp_frc_to_timespec(timeout_frc, used_frc, &ts);
       rc = ci_sys_ppoll(fds, nfds, &ts, sigmask);
     }
   }
@@ -1572,6 +1519,82 @@ error:
 }
 
 
+/* glibc only has epoll_pwait2() since 2.35, so go to the kernel if it's
+ * missing.  Kernels before 5.11 will say ENOSYS. */
+int citp_sys_epoll_pwait2(int epfd, struct epoll_event* events, int maxevents,
+                          const struct timespec* timeout,
+                          const sigset_t* sigmask)
+{
+  if( ci_sys_epoll_pwait2 != NULL )
+    return ci_sys_epoll_pwait2(epfd, events, maxevents, timeout, sigmask);
+#ifdef __NR_epoll_pwait2
+  return raw_syscall6(__NR_epoll_pwait2, epfd, (long) events, maxevents,
+                      (long) timeout, (long) sigmask, _NSIG / 8);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+OO_INTERCEPT(int, epoll_pwait2,
+             (int epfd, struct epoll_event*events, int maxevents,
+              const struct timespec *timeout, const sigset_t *sigmask))
+{
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+
+  if(CI_UNLIKELY( citp.init_level < CITP_INIT_ALL )) {
+    citp_do_init(CITP_INIT_SYSCALLS);
+    goto pass_through;
+  }
+  /* Let the kernel reject bad timeouts */
+  if( ! CITP_OPTS.ul_epoll ||
+      (timeout != NULL &&
+       (timeout->tv_sec < 0 || (unsigned long) timeout->tv_nsec >= 1000000000)) )
+    goto pass_through;
+
+  citp_enter_lib(&lib_context);
+  Log_CALL(ci_log("%s(%d, %p, %d, {%ld,%ld}, %p)", __FUNCTION__, epfd, events,
+                  maxevents, timeout ? (long) timeout->tv_sec : -1,
+                  timeout ? (long) timeout->tv_nsec : -1, sigmask));
+
+  if( (fdi=citp_fdtable_lookup(epfd)) ) {
+    int rc = CI_SOCKET_HANDOVER;
+    if( fdi->protocol->type == CITP_EPOLL_FD ) {
+      /* NB. citp_epoll_wait() calls citp_exit_lib(). */
+      rc = citp_epoll_wait(fdi, events, NULL, maxevents,
+                           oo_epoll_ts_to_frc(timeout), sigmask,
+                           &lib_context);
+      citp_reenter_lib(&lib_context);
+    }
+#if CI_CFG_EPOLL2
+    else if (fdi->protocol->type == CITP_EPOLLB_FD ) {
+      /* This one only does milliseconds, so round up */
+      rc = citp_epollb_wait(fdi, events, maxevents,
+                            timeout == NULL ? -1 :
+                              citp_frc_to_ms(citp_timespec_to_frc(timeout), 0),
+                            sigmask, &lib_context);
+    }
+#endif
+    citp_fdinfo_release_ref(fdi, 0);
+    citp_exit_lib(&lib_context, rc >= 0);
+    if( rc == CI_SOCKET_HANDOVER )
+      goto error;
+    Log_CALL_RESULT(rc);
+    return rc;
+  }
+  else {
+    citp_exit_lib(&lib_context, TRUE);
+  }
+
+error:
+  Log_PT(log("PT: sys_epoll_pwait2(%d, %p, %d, %p, %p)", epfd, events,
+             maxevents, timeout, sigmask));
+ pass_through:
+  return citp_sys_epoll_pwait2(epfd, events, maxevents, timeout, sigmask);
+}
+
+
 
 OO_INTERCEPT(ssize_t, read,
              (int fd, void* buf, size_t count))
@@ -1851,6 +1874,10 @@ OO_INTERCEPT(int, close,
   citp_enter_lib(&lib_context);
   Log_CALL(ci_log("%s(%d)", __FUNCTION__, fd));
 
+#if CI_CFG_IO_URING
+  if( citp_urings != NULL )
+    citp_uring_close(fd);
+#endif
   rc = citp_ep_close(fd);
 
   citp_exit_lib(&lib_context, rc == 0);
@@ -2017,6 +2044,11 @@ OO_INTERCEPT(int, dup2,
   citp_enter_lib(&lib_context);
   Log_CALL(ci_log("%s(%d,%d)", __FUNCTION__, oldfd, newfd));
 
+#if CI_CFG_IO_URING
+  /* newfd is closed, if it is open */
+  if( citp_urings != NULL )
+    citp_uring_close(newfd);
+#endif
   rc = citp_ep_dup3(oldfd, newfd, 0);
   Log_V(log("dup2(%d, %d) = %d", oldfd, newfd, rc));
 
@@ -2049,6 +2081,11 @@ OO_INTERCEPT(int, dup3,
   citp_enter_lib(&lib_context);
   Log_CALL(ci_log("%s(%d,%d,%x)", __FUNCTION__, oldfd, newfd, flags));
 
+#if CI_CFG_IO_URING
+  /* newfd is closed, if it is open */
+  if( citp_urings != NULL )
+    citp_uring_close(newfd);
+#endif
   rc = citp_ep_dup3(oldfd, newfd, flags);
   Log_V(log("dup3(%d, %d, %x) = %d", oldfd, newfd, flags, rc));
 
@@ -2799,6 +2836,15 @@ OO_INTERCEPT(long, syscall,
     NR(epoll_ctl)
     NR(epoll_wait)
     NR(epoll_pwait)
+#ifdef __NR_epoll_pwait2
+    NR(epoll_pwait2)
+#endif
+#if CI_CFG_IO_URING
+    case __NR_io_uring_setup:
+      return citp_uring_setup(a, (struct io_uring_params*) b);
+    case __NR_io_uring_enter:
+      return citp_uring_enter(a, b, c, d, (const void*) e, f);
+#endif
     /* When adding new syscalls here, make sure to check that the libc API
     matches the kernel API. It does for almost everything (on x86-64) but
     there are a few exceptions.  */
@@ -168,6 +168,7 @@ static void citp_dump_opts(citp_opts_t *o)
   DUMP_OPT_INT("EF_SO_BUSY_POLL_SPIN",  so_busy_poll_spin);
   DUMP_OPT_INT("EF_UL_EPOLL",	        ul_epoll);
   DUMP_OPT_INT("EF_EPOLL_SPIN",	        ul_epoll_spin);
+  DUMP_OPT_INT("EF_IO_URING",	        io_uring);
   DUMP_OPT_INT("EF_EPOLL_CTL_FAST",     ul_epoll_ctl_fast);
   DUMP_OPT_INT("EF_EPOLL_CTL_HANDOFF",  ul_epoll_ctl_handoff);
   DUMP_OPT_INT("EF_EPOLL_MT_SAFE",      ul_epoll_mt_safe);
@@ -430,6 +431,7 @@ static void citp_opts_getenv(citp_opts_t* opts)
   GET_ENV_OPT_INT("EF_SO_BUSY_POLL_SPIN", so_busy_poll_spin);
   GET_ENV_OPT_INT("EF_UL_EPOLL",        ul_epoll);
   GET_ENV_OPT_INT("EF_EPOLL_SPIN",      ul_epoll_spin);
+  GET_ENV_OPT_INT("EF_IO_URING",        io_uring);
   GET_ENV_OPT_INT("EF_EPOLL_CTL_FAST",  ul_epoll_ctl_fast);
   GET_ENV_OPT_INT("EF_EPOLL_CTL_HANDOFF",ul_epoll_ctl_handoff);
   GET_ENV_OPT_INT("EF_EPOLL_MT_SAFE",   ul_epoll_mt_safe);
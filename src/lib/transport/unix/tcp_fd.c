@@ -743,19 +743,93 @@ fail:
 #endif
 
 
+#if CI_CFG_FD_CACHING
+/* Called with the listener locked, for [ts] just taken from its accept
+ * queue.  Returns whether [ts] came from the cache, in which case it is
+ * also taken off the listener's epcache list.
+ */
+static int citp_tcp_accept_uncache(ci_netif* ni, ci_tcp_state* ts)
+{
+  if( S_TO_EPS(ni, ts)->fd != CI_FD_BAD ) {
+    /* we have fd to ep already this also means we are not at risk of concurrent
+     * sys_close()
+     * and are able to fixup state to reflect it coming from our cache */
+    ci_assert_nflags(ts->s.b.sb_aflags, CI_SB_AFLAG_IN_CACHE_NO_FD);
+    ts->cached_on_fd = S_TO_EPS(ni,ts)->fd;
+    ts->cached_on_pid = citp_getpid();
+  }
+  if( ! ci_tcp_is_cached(ts) )
+    return 0;
+  oo_p_dllink_del_init(ni, oo_p_dllink_sb(ni, &ts->s.b,
+                                          &ts->epcache_fd_link));
+  return 1;
+}
+#endif
+
+
+/* Creates the u/l state for [newfd], which has just been acquired for [ts],
+ * whether [ts] came from the cache or not.
+ */
+static int citp_tcp_accept_fdinfo(ci_netif* ni, ci_tcp_socket_listen* listener,
+                                  ci_tcp_state* ts, int from_cache, int newfd,
+                                  struct sockaddr* sa, socklen_t* p_sa_len)
+{
+  citp_sock_fdi* newepi;
+  citp_fdinfo* newfdi;
+
+  Log_EP(ci_log("%s: accepted fd=%d", __FUNCTION__, newfd));
+
+  ci_assert(!(ts->s.b.sb_aflags & CI_SB_AFLAG_ORPHAN));
+  ci_assert(!(ts->s.b.sb_aflags & CI_SB_AFLAG_TCP_IN_ACCEPTQ));
+
+  newepi = CI_ALLOC_OBJ(citp_sock_fdi);
+  if( newepi == 0 ) {
+    Log_E (ci_log(LPF "accept: newepi malloc failed"));
+    citp_fdtable_busy_clear(newfd, fdip_unknown, 0);
+    /* FIXME close the EP in case of shared EP cache */
+    ci_tcp_helper_close_no_trampoline(newfd);
+    S_TO_EPS(ni,ts)->fd = CI_FD_BAD;
+    return -1;
+  }
+  newfdi = &newepi->fdinfo;
+  citp_fdinfo_init(newfdi, &citp_tcp_protocol_impl);
+#if CI_CFG_FD_CACHING
+  newfdi->can_cache = 1;
+#endif
+  newepi->sock.s = &ts->s;
+  newepi->sock.netif = ni;
+  citp_netif_add_ref(ni);
+
+#if CI_CFG_FD_CACHING
+  if( from_cache ) {
+    ci_atomic32_inc(&ni->state->passive_cache_avail_stack);
+    ci_atomic32_inc(&listener->cache_avail_sock);
+    ci_assert_le(ni->state->passive_cache_avail_stack,
+                 ni->state->opts.sock_cache_max);
+    if( ~NI_OPTS(ni).scalable_filter_mode & CITP_SCALABLE_MODE_PASSIVE )
+      ci_assert_le(listener->cache_avail_sock,
+                   ni->state->opts.per_sock_cache_max);
+  }
+#endif
+
+  /* get new file descriptor into table */
+  ci_assert(newepi->sock.s->b.sb_aflags & CI_SB_AFLAG_NOT_READY);
+  ci_atomic32_and(&newepi->sock.s->b.sb_aflags, ~CI_SB_AFLAG_NOT_READY);
+  citp_fdtable_insert(newfdi, newfd, 0);
+
+  return citp_tcp_accept_complete(ni, sa, p_sa_len, listener, ts, newfd);
+}
+
+
 static int citp_tcp_accept_ul(citp_fdinfo* fdinfo, ci_netif* ni,
 			      ci_tcp_socket_listen* listener,
 			      struct sockaddr* sa, socklen_t* p_sa_len,
                               int flags)
 {
-  citp_sock_fdi* newepi;
-  citp_fdinfo* newfdi;
   ci_tcp_state* ts;
   citp_waitable* w;
   int newfd;
-#if CI_CFG_FD_CACHING
-  int from_cache;
-#endif
+  int from_cache = 0;
   int unlocked = 0;
 
   Log_VSS(ci_log(LPF "accept(%d:%d, sa, %d)", fdinfo->fd,
@@ -783,23 +857,11 @@ redo:
   ci_assert(w->state != CI_TCP_LISTEN);
   ts = &CI_CONTAINER(citp_waitable_obj, waitable, w)->tcp;
 #if CI_CFG_FD_CACHING
-  if( S_TO_EPS(ni, ts)->fd != CI_FD_BAD ) {
-    /* we have fd to ep already this also means we are not at risk of concurrent
-     * sys_close()
-     * and are able to fixup state to reflect it coming from our cache */
-    ci_assert_nflags(ts->s.b.sb_aflags, CI_SB_AFLAG_IN_CACHE_NO_FD);
-    ts->cached_on_fd = S_TO_EPS(ni,ts)->fd;
-    ts->cached_on_pid = citp_getpid();
-  }
-  from_cache = ci_tcp_is_cached(ts);
-  if( from_cache ) {
-    /* We need a listening socket lock to remove from the epcache list.
-     * But faked-up loopback connection can't be cached, so we are safe
-     * here. */
-    ci_assert(! unlocked);
-    oo_p_dllink_del_init(ni, oo_p_dllink_sb(ni, &ts->s.b,
-                                            &ts->epcache_fd_link));
-  }
+  /* We need a listening socket lock to remove from the epcache list.
+   * But faked-up loopback connection can't be cached, so we are safe
+   * here. */
+  from_cache = citp_tcp_accept_uncache(ni, ts);
+  ci_assert(! from_cache || ! unlocked);
 #endif
   if( ! unlocked )
     ci_sock_unlock(ni, &listener->s.b);
@@ -827,50 +889,8 @@ redo:
     RET_WITH_ERRNO(-newfd);
   }
 
-  Log_EP(ci_log("%s: accepted fd=%d", __FUNCTION__, newfd));
-
-  /* Whether [ts] came from the cache or not, we need to create the u/l state
-   * for the fd (i.e. fdinfo).
-   */
-  ci_assert(!(ts->s.b.sb_aflags & CI_SB_AFLAG_ORPHAN));
-  ci_assert(!(ts->s.b.sb_aflags & CI_SB_AFLAG_TCP_IN_ACCEPTQ));
-
-  newepi = CI_ALLOC_OBJ(citp_sock_fdi);
-  if( newepi == 0 ) {
-    Log_E (ci_log(LPF "accept: newepi malloc failed"));
-    citp_fdtable_busy_clear(newfd, fdip_unknown, 0);
-    /* FIXME close the EP in case of shared EP cache */
-    ci_tcp_helper_close_no_trampoline(newfd);
-    S_TO_EPS(ni,ts)->fd = CI_FD_BAD;
-    return -1;
-  }
-  newfdi = &newepi->fdinfo;
-  citp_fdinfo_init(newfdi, &citp_tcp_protocol_impl);
-#if CI_CFG_FD_CACHING
-  newfdi->can_cache = 1;
-#endif
-  newepi->sock.s = &ts->s;
-  newepi->sock.netif = ni;
-  citp_netif_add_ref(ni);
-
-#if CI_CFG_FD_CACHING
-  if( from_cache ) {
-    ci_atomic32_inc(&ni->state->passive_cache_avail_stack);
-    ci_atomic32_inc(&listener->cache_avail_sock);
-    ci_assert_le(ni->state->passive_cache_avail_stack,
-                 ni->state->opts.sock_cache_max);
-    if( ~NI_OPTS(ni).scalable_filter_mode & CITP_SCALABLE_MODE_PASSIVE )
-      ci_assert_le(listener->cache_avail_sock,
-                   ni->state->opts.per_sock_cache_max);
-  }
-#endif
-
-  /* get new file descriptor into table */
-  ci_assert(newepi->sock.s->b.sb_aflags & CI_SB_AFLAG_NOT_READY);
-  ci_atomic32_and(&newepi->sock.s->b.sb_aflags, ~CI_SB_AFLAG_NOT_READY);
-  citp_fdtable_insert(newfdi, newfd, 0);
-
-  return citp_tcp_accept_complete(ni, sa, p_sa_len, listener, ts, newfd);
+  return citp_tcp_accept_fdinfo(ni, listener, ts, from_cache, newfd,
+                                sa, p_sa_len);
 }
 
 
@@ -1068,6 +1088,159 @@ check_ul_accept_q:
   return rc;
 }
 
+/* Most connections citp_tcp_accept_batch() takes off the accept queue under
+ * one hold of the listener's lock */
+#define CITP_TCP_ACCEPT_BATCH_MAX  64
+
+/* Accepts up to [max_msgs] connections without blocking.  Returns the
+ * number accepted, or -errno if there was an error before any were.
+ */
+static int citp_tcp_accept_batch(citp_fdinfo* fdinfo,
+                                 struct onload_accept_batch_msg* msgs,
+                                 int max_msgs, int flags)
+{
+  citp_sock_fdi* epi = fdi_to_sock_fdi(fdinfo);
+  ci_netif* ni = epi->sock.netif;
+  ci_tcp_socket_listen* listener;
+  ci_tcp_state* batch[CITP_TCP_ACCEPT_BATCH_MAX];
+#if CI_CFG_FD_CACHING
+  char from_cache[CITP_TCP_ACCEPT_BATCH_MAX];
+#endif
+  ci_tcp_state* ts;
+  int n = 0, n_batch, i, j, newfd, rc = 0;
+
+  Log_VSS(ci_log(LPF "accept_batch("EF_FMT", %d, %x)",
+                 EF_PRI_ARGS(epi, fdinfo->fd), max_msgs, flags));
+
+  if( epi->sock.s->b.state != CI_TCP_LISTEN )
+    return -EINVAL;
+  listener = SOCK_TO_TCP_LISTEN(epi->sock.s);
+  if( (rc = ci_get_so_error(&listener->s)) != 0 )
+    return -rc;
+
+  if( ci_netif_may_poll(ni) && ci_netif_need_poll(ni) &&
+      ci_netif_trylock(ni) ) {
+    ci_netif_poll(ni);
+    ci_netif_unlock(ni);
+  }
+
+  while( n < max_msgs && ci_tcp_acceptq_n(listener) ) {
+    n_batch = 0;
+    ci_sock_lock(ni, &listener->s.b);
+    while( n_batch < CI_MIN(max_msgs - n, CITP_TCP_ACCEPT_BATCH_MAX) &&
+           ci_tcp_acceptq_not_empty(listener) ) {
+#if CI_CFG_ENDPOINT_MOVE
+      /* Connections that were moved to another stack are accepted one at a
+       * time, and only at the head of the batch. */
+      if( ci_tcp_acceptq_peek(ni, listener)->s.b.sb_aflags &
+          CI_SB_AFLAG_MOVED_AWAY )
+        break;
+#endif
+      ts = &CI_CONTAINER(citp_waitable_obj, waitable,
+                         ci_tcp_acceptq_get(ni, listener))->tcp;
+      ci_assert(ts->s.b.state & CI_TCP_STATE_TCP);
+      ci_assert(ts->s.b.state != CI_TCP_LISTEN);
+#if CI_CFG_FD_CACHING
+      from_cache[n_batch] = citp_tcp_accept_uncache(ni, ts);
+#endif
+      batch[n_batch++] = ts;
+    }
+
+    if( n_batch == 0 ) {
+      if( ! ci_tcp_acceptq_not_empty(listener) ) {
+        ci_sock_unlock(ni, &listener->s.b);
+        break;
+      }
+      /* citp_tcp_accept_ul() drops the lock */
+      msgs[n].addrlen = sizeof(msgs[n].addr);
+      newfd = citp_tcp_accept_ul(fdinfo, ni, listener,
+                                 (struct sockaddr*) &msgs[n].addr,
+                                 &msgs[n].addrlen, flags);
+      if( newfd < 0 ) {
+        rc = -errno;
+        break;
+      }
+      msgs[n++].fd = newfd;
+      continue;
+    }
+    ci_sock_unlock(ni, &listener->s.b);
+
+    /* Now get each of them an fd.  We must not hold the listener's lock for
+     * this, as we may need the fdtable lock. */
+    for( i = 0; i < n_batch; ++i ) {
+      ts = batch[i];
+      newfd = citp_tcp_ep_acquire_fd(ni, ts, listener, ts->s.domain,
+                                     SOCK_STREAM, flags);
+      if( newfd < 0 )
+        break;
+      msgs[n].addrlen = sizeof(msgs[n].addr);
+      newfd = citp_tcp_accept_fdinfo(ni, listener, ts,
+#if CI_CFG_FD_CACHING
+                                     from_cache[i],
+#else
+                                     0,
+#endif
+                                     newfd, (struct sockaddr*) &msgs[n].addr,
+                                     &msgs[n].addrlen);
+      if( newfd < 0 ) {
+        /* As for accept(), the connection is lost */
+        batch[i] = NULL;
+        newfd = -ENOMEM;
+        break;
+      }
+      msgs[n++].fd = newfd;
+    }
+    if( i == n_batch )
+      continue;
+
+    /* Put back whatever we did not get to, in the same order. */
+    Log_E(ci_log(LPF "%s: failed to accept %d of %d connections: %d",
+                 __FUNCTION__, n_batch - i, n_batch, newfd));
+    ci_sock_lock(ni, &listener->s.b);
+    for( j = n_batch - 1; j > i; --j )
+      ci_tcp_acceptq_put_back(ni, listener, &batch[j]->s.b);
+    if( batch[i] != NULL ) {
+      ci_assert(batch[i]->s.b.sb_aflags & CI_SB_AFLAG_TCP_IN_ACCEPTQ);
+#if CI_CFG_FD_CACHING
+      if( newfd == -ENOANO ) {
+        /* The cached fd is being closed under our feet: try the rest of the
+         * queue first, as accept() does. */
+        ci_tcp_acceptq_put_back_tail(ni, listener, &batch[i]->s.b);
+        CITP_STATS_NETIF_INC(ni, accept_attach_fd_retry);
+        ci_sock_unlock(ni, &listener->s.b);
+        sched_yield();
+        continue;
+      }
+#endif
+      ci_tcp_acceptq_put_back(ni, listener, &batch[i]->s.b);
+      CITP_STATS_TCP_LISTEN(++listener->stats.n_accept_no_fd);
+    }
+    ci_sock_unlock(ni, &listener->s.b);
+    rc = newfd;
+    break;
+  }
+
+  /* Then connections that arrived through the kernel. */
+  while( rc == 0 && n < max_msgs &&
+         (listener->s.os_sock_status & OO_OS_STATUS_RX) ) {
+    msgs[n].addrlen = sizeof(msgs[n].addr);
+    newfd = citp_tcp_accept_os(epi, fdinfo->fd,
+                               (struct sockaddr*) &msgs[n].addr,
+                               &msgs[n].addrlen, flags);
+    if( newfd < 0 ) {
+      if( errno != EAGAIN )
+        rc = -errno;
+      break;
+    }
+    CITP_STATS_TCP_LISTEN(++listener->stats.n_accept_os);
+    ++ni->state->stats.tcp_accept_os;
+    msgs[n++].fd = newfd;
+  }
+
+  return n > 0 ? n : rc;
+}
+
+
 static int citp_tcp_connect(citp_fdinfo* fdinfo,
                             const struct sockaddr* sa, socklen_t sa_len,
                             citp_lib_context_t* lib_context)
@@ -1751,6 +1924,71 @@ static int citp_tcp_sendmmsg(citp_fdinfo* fdinfo, struct mmsghdr* msg,
   return -1;
 }
 
+#if CI_CFG_TCP_FASTOPEN
+#ifndef MSG_FASTOPEN
+# define MSG_FASTOPEN 0x20000000
+#endif
+
+/* sendmsg(MSG_FASTOPEN) on an unconnected socket: connect() and send in
+ * one go.  If we have a cookie for the destination the data goes in the
+ * SYN, otherwise it goes after the handshake.
+ */
+static int citp_tcp_send_fastopen(citp_fdinfo* fdinfo,
+                                  const struct msghdr* msg, int flags)
+{
+  citp_sock_fdi* epi = fdi_to_sock_fdi(fdinfo);
+  ci_netif* ni = epi->sock.netif;
+  ci_tcp_state* ts = SOCK_TO_TCP(epi->sock.s);
+  citp_fdinfo* new_fdinfo;
+  int moved = 0;
+  int rc;
+
+  if( ! (NI_OPTS(ni).tcp_fastopen & CI_TCP_FASTOPEN_CLIENT) ) {
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+
+  ci_netif_lock_fdi(epi);
+  ts->tcpflags |= CI_TCPT_FLAG_FASTOPEN;
+  ci_netif_unlock_fdi(epi);
+
+  rc = ci_tcp_connect(&epi->sock, msg->msg_name, msg->msg_namelen,
+                      fdinfo->fd, &moved);
+  flags &=~ MSG_FASTOPEN;
+
+  if( moved ) {
+    /* Connected to another stack over loopback.  Our caller still holds
+     * a reference to the old fdinfo, so take another one for the reprobe
+     * to drop, and send on the new one. */
+    citp_fdinfo_ref_fast(fdinfo);
+    citp_reprobe_moved_common(fdinfo, CI_TRUE, CI_FALSE, &new_fdinfo);
+    if( new_fdinfo == NULL ) {
+      errno = EBADF;
+      return -1;
+    }
+    if( rc == 0 ||
+        (rc < 0 && errno == EINPROGRESS && ! (flags & MSG_DONTWAIT)) )
+      rc = citp_fdinfo_get_ops(new_fdinfo)->send(new_fdinfo, msg, flags);
+    citp_fdinfo_release_ref_fast(new_fdinfo);
+    return rc;
+  }
+
+  if( tcp_rc_means_handover(rc) ) {
+    /* Leave the socket closed, so the app can do a normal connect() */
+    ci_netif_lock_fdi(epi);
+    ts->tcpflags &=~ CI_TCPT_FLAG_FASTOPEN;
+    ci_netif_unlock_fdi(epi);
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+  if( rc < 0 )
+    return rc;
+
+  return ci_tcp_sendmsg(ni, ts, msg->msg_iov, msg->msg_iovlen, flags);
+}
+#endif
+
+
 static int citp_tcp_send(citp_fdinfo* fdinfo, const struct msghdr* msg,
                          int flags)
 {
@@ -1778,6 +2016,14 @@ static int citp_tcp_send(citp_fdinfo* fdinfo, const struct msghdr* msg,
      * state inside ci_tcp_sendmsg(). */
     if( CI_UNLIKELY(state == CI_TCP_CLOSED || state == CI_TCP_LISTEN ||
                     state == CI_TCP_INVALID) ) {
+#if CI_CFG_TCP_FASTOPEN
+      if( (flags & MSG_FASTOPEN) && state == CI_TCP_CLOSED &&
+          msg->msg_name != NULL ) {
+        rc = citp_tcp_send_fastopen(fdinfo, msg, flags);
+        Log_V(log(LPF "send("EF_FMT") = %d", EF_PRI_ARGS(epi,fdinfo->fd),rc));
+        return rc;
+      }
+#endif
       if( CI_UNLIKELY(flags & ONLOAD_MSG_WARM) )
         ++SOCK_TO_TCP(epi->sock.s)->stats.tx_msg_warm_abort;
       if( (rc = ci_get_so_error(epi->sock.s)) != 0 )
@@ -2344,6 +2590,7 @@ citp_protocol_impl citp_tcp_protocol_impl = {
     .dsend_prepare      = citp_tcp_ds_prepare,
     .dsend_complete     = citp_tcp_ds_complete,
     .dsend_cancel       = citp_tcp_ds_cancel,
+    .accept_batch       = citp_tcp_accept_batch,
   }
 };
 
@@ -105,6 +105,7 @@ CI_BUILD_ASSERT(EPOLLIN == POLLIN);
 struct citp_epoll_member {
   ci_dllink             dllink;     /*!< Double-linked list links */
   ci_dllist*            item_list;  /*!< The list this member belong on */
+  ci_dllink             hash_link;  /*!< Link in [oo_sockets_hash] */
 #if CI_CFG_EPOLL3
   ci_dllink             dead_stack_link; /*!< Link for dead stack list */
   int                   ready_list_id;
@@ -162,6 +163,11 @@ struct citp_epoll_fd {
   /* List of onload sockets in non-home stack (struct citp_epoll_member) */
   ci_dllist             oo_sockets;
   int                   oo_sockets_n;
+  /* The members of [oo_sockets] hashed by fd, so that epoll_ctl() doesn't
+   * have to walk the list.  NULL if it couldn't be allocated, in which
+   * case it does. */
+  ci_dllist*            oo_sockets_hash;
+  unsigned              oo_sockets_hash_mask;
 
   /* List of deleted sockets (struct citp_epoll_member) */
   ci_dllist             dead_sockets;
@@ -277,6 +283,15 @@ static inline ci_int64 oo_epoll_ms_to_frc(int ms_timeout)
 }
 
 
+static inline ci_int64 oo_epoll_ts_to_frc(const struct timespec* ts)
+{
+  return CI_MIN(citp_timespec_to_frc(ts), OO_EPOLL_MAX_TIMEOUT_HR);
+}
+
+
+extern int citp_sys_epoll_pwait2(int epfd, struct epoll_event* events,
+                                 int maxevents, const struct timespec* timeout,
+                                 const sigset_t* sigmask) CI_HF;
 extern int citp_epoll_create(int size, int flags) CI_HF;
 extern int citp_epoll_ctl(citp_fdinfo* fdi, int op, int fd,
                           struct epoll_event *event) CI_HF;
@@ -0,0 +1,1009 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+*//*! \file
+** <L5_PRIVATE L5_SOURCE>
+**  \brief  Intercept of io_uring requests on accelerated sockets
+** </L5_PRIVATE>
+*//*
+\**************************************************************************/
+
+/* The kernel can't carry out an io_uring request on an accelerated socket:
+ * at best it would go to the OS socket behind it.  So io_uring_enter()
+ * looks through the SQEs being submitted and takes the ones on our sockets
+ * out of the kernel's way, by turning them into NOPs that don't post a
+ * completion.  We do those requests here, and post their completions to
+ * the app's ring with IORING_OP_MSG_RING from a private ring, so that the
+ * kernel remains the only writer of the app's completion queue.
+ *
+ * Requests that can't complete at once are kept pending, and retried on
+ * each io_uring_enter() on the ring.  If the app waits for completions
+ * while we have requests pending, we wait in poll() on the ring and the
+ * sockets instead of in the kernel.  Cancel and poll remove requests that
+ * name pending requests of ours are done here too, and closing a socket
+ * fails the requests pending on it with ECANCELED.
+ *
+ * Only rings set up with syscall() are seen.  Rings using SQPOLL, 128 byte
+ * SQEs, app-provided memory or registered ring fds are left alone, as are
+ * linked requests, fixed files, provided buffers and multishot requests.
+ */
+
+#include "internal.h"
+
+#if CI_CFG_IO_URING
+
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+
+#define LPF "citp_uring_"
+
+/* Linux 6.12; older headers may lack it */
+#ifndef IORING_ENTER_ABS_TIMER
+#define IORING_ENTER_ABS_TIMER  (1U << 5)
+#endif
+
+
+/* Entries in our private ring */
+#define URING_MSG_ENTRIES  64
+
+/* How often to look at the app's CQ while it has some completions, but
+ * fewer than are wanted */
+#define URING_CQ_POLL_MS   1
+
+/* Flags in citp_uring_op::state */
+#define URING_OP_CONNECTING  0x1
+
+/* Which way a request moves data: requests in the same direction on a
+ * socket complete in the order they were submitted. */
+#define URING_DIR_NONE  0
+#define URING_DIR_IN    1
+#define URING_DIR_OUT   2
+
+
+struct citp_uring_map {
+  void*                ring;
+  size_t               ring_len;
+  struct io_uring_sqe* sqes;
+  size_t               sqes_len;
+  unsigned*            sq_head;
+  unsigned*            sq_tail;
+  unsigned*            sq_array;   /* NULL with IORING_SETUP_NO_SQARRAY */
+  unsigned             sq_mask;
+  unsigned             sq_entries;
+  unsigned*            cq_head;
+  unsigned*            cq_tail;
+  unsigned             cq_mask;
+  struct io_uring_cqe* cqes;
+};
+
+
+struct citp_uring_op {
+  /* A copy, as the app may reuse the SQE once it is submitted */
+  struct io_uring_sqe  sqe;
+  unsigned             state;
+};
+
+
+struct citp_uring {
+  struct citp_uring*    next;
+  int                   fd;
+  unsigned              setup_flags;
+  pthread_mutex_t       lock;
+  struct citp_uring_map app;
+
+  /* Our ring, for posting completions to the app's ring */
+  int                   msg_fd;
+  struct citp_uring_map msg;
+  unsigned              msg_queued;
+
+  /* Pending requests, oldest first */
+  struct citp_uring_op* ops;
+  int                   ops_n;
+  int                   ops_max;
+
+  /* Threads in citp_uring_enter(), which drop the lock while they wait.
+   * Once closed, the last of them to leave frees the ring. */
+  int                   users;
+  int                   closed;
+};
+
+
+struct citp_uring* citp_urings;
+static pthread_mutex_t citp_urings_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static long uring_sys_enter(int fd, unsigned to_submit, unsigned min_complete,
+                            unsigned flags, const void* arg, size_t argsz)
+{
+  return ci_sys_syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, arg, argsz);
+}
+
+
+/**********************************************************************
+ * Ring mappings
+ */
+
+static int uring_map(int fd, const struct io_uring_params* p,
+                     struct citp_uring_map* m)
+{
+  char* ring;
+  int rc;
+
+  /* We insist on IORING_FEAT_SINGLE_MMAP, so one mapping covers both
+   * queues.  With IORING_SETUP_NO_SQARRAY sq_off.array is zero. */
+  m->ring_len = CI_MAX(p->sq_off.array + p->sq_entries * sizeof(unsigned),
+                       p->cq_off.cqes +
+                       p->cq_entries * sizeof(struct io_uring_cqe));
+  m->ring = mmap(NULL, m->ring_len, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if( m->ring == MAP_FAILED )
+    return -errno;
+  m->sqes_len = p->sq_entries * sizeof(struct io_uring_sqe);
+  m->sqes = mmap(NULL, m->sqes_len, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if( m->sqes == MAP_FAILED ) {
+    rc = -errno;
+    munmap(m->ring, m->ring_len);
+    return rc;
+  }
+
+  ring = m->ring;
+  m->sq_head = (unsigned*) (ring + p->sq_off.head);
+  m->sq_tail = (unsigned*) (ring + p->sq_off.tail);
+  m->sq_mask = *(unsigned*) (ring + p->sq_off.ring_mask);
+  m->sq_entries = p->sq_entries;
+  m->sq_array = NULL;
+#ifdef IORING_SETUP_NO_SQARRAY
+  if( ! (p->flags & IORING_SETUP_NO_SQARRAY) )
+#endif
+    m->sq_array = (unsigned*) (ring + p->sq_off.array);
+  m->cq_head = (unsigned*) (ring + p->cq_off.head);
+  m->cq_tail = (unsigned*) (ring + p->cq_off.tail);
+  m->cq_mask = *(unsigned*) (ring + p->cq_off.ring_mask);
+  m->cqes = (struct io_uring_cqe*) (ring + p->cq_off.cqes);
+  return 0;
+}
+
+
+static void uring_unmap(struct citp_uring_map* m)
+{
+  munmap(m->sqes, m->sqes_len);
+  munmap(m->ring, m->ring_len);
+}
+
+
+/* Sets up the private ring, and checks that it can do IORING_OP_MSG_RING */
+static int uring_msg_init(struct citp_uring* r)
+{
+  struct io_uring_params p;
+  struct io_uring_probe* probe;
+  size_t probe_len;
+  int rc, supported;
+
+  memset(&p, 0, sizeof(p));
+  r->msg_fd = ci_sys_syscall(__NR_io_uring_setup, URING_MSG_ENTRIES, &p);
+  if( r->msg_fd < 0 )
+    return -errno;
+
+  probe_len = sizeof(*probe) + IORING_OP_LAST * sizeof(probe->ops[0]);
+  probe = calloc(1, probe_len);
+  if( probe == NULL ) {
+    rc = -ENOMEM;
+    goto fail;
+  }
+  rc = ci_sys_syscall(__NR_io_uring_register, r->msg_fd,
+                      IORING_REGISTER_PROBE, probe, IORING_OP_LAST);
+  supported = rc == 0 && probe->ops_len > IORING_OP_MSG_RING &&
+              (probe->ops[IORING_OP_MSG_RING].flags & IO_URING_OP_SUPPORTED);
+  free(probe);
+  if( ! supported ) {
+    rc = -EOPNOTSUPP;
+    goto fail;
+  }
+
+  if( (rc = uring_map(r->msg_fd, &p, &r->msg)) < 0 )
+    goto fail;
+  r->msg_queued = 0;
+  return 0;
+
+ fail:
+  ci_sys_close(r->msg_fd);
+  return rc;
+}
+
+
+/* Submits the completions queued on the private ring */
+static void uring_msg_flush(struct citp_uring* r)
+{
+  struct citp_uring_map* m = &r->msg;
+  unsigned head, tail;
+  long rc;
+
+  while( r->msg_queued != 0 ) {
+    rc = uring_sys_enter(r->msg_fd, r->msg_queued, 0, 0, NULL, 0);
+    if( rc < 0 ) {
+      if( errno == EINTR )
+        continue;
+      /* They'll go with the next lot */
+      Log_E(log(LPF "%s: io_uring_enter(%d) failed (%d)", __FUNCTION__,
+                r->msg_fd, errno));
+      break;
+    }
+    r->msg_queued -= rc;
+  }
+
+  /* We only see completions for messages that failed */
+  head = *m->cq_head;
+  tail = OO_ACCESS_ONCE(*m->cq_tail);
+  ci_rmb();
+  for( ; head != tail; ++head ) {
+    struct io_uring_cqe* cqe = &m->cqes[head & m->cq_mask];
+    Log_E(log(LPF "%s: lost completion %llx on ring %d (%d)", __FUNCTION__,
+              (unsigned long long) cqe->user_data, r->fd, cqe->res));
+  }
+  ci_mb();
+  OO_ACCESS_ONCE(*m->cq_head) = head;
+}
+
+
+/* Queues a completion for the app's ring */
+static void uring_msg_post(struct citp_uring* r, __u64 user_data, int res)
+{
+  struct citp_uring_map* m = &r->msg;
+  struct io_uring_sqe* sqe;
+  unsigned tail;
+
+  if( r->msg_queued == m->sq_entries )
+    uring_msg_flush(r);
+
+  tail = *m->sq_tail;
+  sqe = &m->sqes[tail & m->sq_mask];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_MSG_RING;
+  sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+  sqe->fd = r->fd;
+  sqe->addr = IORING_MSG_DATA;
+  /* The target's CQE gets res from len and user_data from off */
+  sqe->len = (__u32) res;
+  sqe->off = user_data;
+  sqe->user_data = user_data;
+  if( m->sq_array != NULL )
+    m->sq_array[tail & m->sq_mask] = tail & m->sq_mask;
+  ci_wmb();
+  OO_ACCESS_ONCE(*m->sq_tail) = tail + 1;
+  ++r->msg_queued;
+}
+
+
+/**********************************************************************
+ * Requests
+ */
+
+static int uring_op_dir(const struct io_uring_sqe* sqe)
+{
+  switch( sqe->opcode ) {
+  case IORING_OP_RECV:
+  case IORING_OP_RECVMSG:
+  case IORING_OP_ACCEPT:
+    return URING_DIR_IN;
+  case IORING_OP_SEND:
+  case IORING_OP_SENDMSG:
+  case IORING_OP_CONNECT:
+    return URING_DIR_OUT;
+  default:
+    return URING_DIR_NONE;
+  }
+}
+
+
+static short uring_op_events(const struct io_uring_sqe* sqe)
+{
+  switch( uring_op_dir(sqe) ) {
+  case URING_DIR_IN:
+    return POLLIN;
+  case URING_DIR_OUT:
+    return POLLOUT;
+  default:
+    return (short) sqe->poll32_events;
+  }
+}
+
+
+/* Is this a request we should do, rather than the kernel? */
+static int uring_sqe_is_ours(const struct io_uring_sqe* sqe)
+{
+  citp_fdinfo* fdi;
+  int ours;
+
+  switch( sqe->opcode ) {
+  case IORING_OP_SEND:
+    /* sendto() form */
+    if( sqe->addr2 != 0 )
+      return 0;
+    break;
+  case IORING_OP_POLL_ADD:
+    /* Multishot */
+    if( sqe->len != 0 )
+      return 0;
+    break;
+  case IORING_OP_RECV:
+  case IORING_OP_RECVMSG:
+  case IORING_OP_SENDMSG:
+  case IORING_OP_ACCEPT:
+  case IORING_OP_CONNECT:
+    break;
+  default:
+    return 0;
+  }
+  if( sqe->flags & (IOSQE_FIXED_FILE | IOSQE_IO_DRAIN | IOSQE_IO_LINK |
+                    IOSQE_IO_HARDLINK | IOSQE_BUFFER_SELECT) )
+    return 0;
+  /* Multishot, zero-copy and poll-first variants */
+  if( sqe->opcode != IORING_OP_POLL_ADD && sqe->ioprio != 0 )
+    return 0;
+
+  if( (fdi = citp_fdtable_lookup(sqe->fd)) == NULL )
+    return 0;
+  ours = citp_fdinfo_is_socket(fdi);
+  citp_fdinfo_release_ref(fdi, 0);
+  return ours;
+}
+
+
+static int uring_fd_ready(int fd, short events)
+{
+  struct pollfd pfd;
+
+  pfd.fd = fd;
+  pfd.events = events;
+  pfd.revents = 0;
+  if( onload_poll(&pfd, 1, 0) <= 0 )
+    return 0;
+  return pfd.revents;
+}
+
+
+/* Does a request without blocking.  Returns -EAGAIN if it can't complete
+ * yet, or else the result for its CQE.
+ */
+static int uring_op_try(struct citp_uring_op* op)
+{
+  const struct io_uring_sqe* sqe = &op->sqe;
+  void* addr = (void*) (uintptr_t) sqe->addr;
+  socklen_t len;
+  long rc;
+  int err;
+
+  switch( sqe->opcode ) {
+  case IORING_OP_RECV:
+    rc = onload_recvfrom(sqe->fd, addr, sqe->len,
+                         sqe->msg_flags | MSG_DONTWAIT, NULL, NULL);
+    break;
+  case IORING_OP_SEND:
+    rc = onload_sendto(sqe->fd, addr, sqe->len,
+                       sqe->msg_flags | MSG_DONTWAIT, NULL, 0);
+    break;
+  case IORING_OP_RECVMSG:
+    rc = onload_recvmsg(sqe->fd, addr, sqe->msg_flags | MSG_DONTWAIT);
+    break;
+  case IORING_OP_SENDMSG:
+    rc = onload_sendmsg(sqe->fd, addr, sqe->msg_flags | MSG_DONTWAIT);
+    break;
+  case IORING_OP_ACCEPT:
+    /* accept() has no MSG_DONTWAIT, and the listener may be blocking */
+    if( ! uring_fd_ready(sqe->fd, POLLIN) )
+      return -EAGAIN;
+    rc = onload_accept4(sqe->fd, addr, (socklen_t*) (uintptr_t) sqe->addr2,
+                        sqe->accept_flags);
+    break;
+  case IORING_OP_CONNECT:
+    if( op->state & URING_OP_CONNECTING ) {
+      if( ! uring_fd_ready(sqe->fd, POLLOUT) )
+        return -EAGAIN;
+      len = sizeof(err);
+      if( onload_getsockopt(sqe->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 )
+        return -errno;
+      return -err;
+    }
+    /* A blocking socket connects here and now */
+    rc = onload_connect(sqe->fd, addr, (socklen_t) sqe->off);
+    if( rc < 0 && errno == EINPROGRESS ) {
+      op->state |= URING_OP_CONNECTING;
+      return -EAGAIN;
+    }
+    break;
+  case IORING_OP_POLL_ADD:
+    rc = uring_fd_ready(sqe->fd, uring_op_events(sqe));
+    return rc ? rc : -EAGAIN;
+  default:
+    ci_assert(0);
+    return -EINVAL;
+  }
+
+  if( rc < 0 )
+    return errno == EWOULDBLOCK ? -EAGAIN : -errno;
+  return rc;
+}
+
+
+static int uring_ops_grow(struct citp_uring* r)
+{
+  int max = r->ops_max ? r->ops_max * 2 : 16;
+  struct citp_uring_op* ops;
+
+  ops = realloc(r->ops, max * sizeof(*ops));
+  if( ops == NULL )
+    return -ENOMEM;
+  r->ops = ops;
+  r->ops_max = max;
+  return 0;
+}
+
+
+/* Removes pending request [i], posting its completion */
+static void uring_op_complete(struct citp_uring* r, int i, int res)
+{
+  uring_msg_post(r, r->ops[i].sqe.user_data, res);
+  --r->ops_n;
+  memmove(&r->ops[i], &r->ops[i + 1], (r->ops_n - i) * sizeof(r->ops[0]));
+}
+
+
+/* Does the cancel request [sqe] name pending request [op]? */
+static int uring_cancel_match(const struct io_uring_sqe* sqe, unsigned flags,
+                              const struct citp_uring_op* op)
+{
+  if( sqe->opcode == IORING_OP_POLL_REMOVE )
+    return op->sqe.opcode == IORING_OP_POLL_ADD &&
+           op->sqe.user_data == sqe->addr;
+#ifdef IORING_ASYNC_CANCEL_ANY
+  if( flags & IORING_ASYNC_CANCEL_ANY )
+    return 1;
+#endif
+#ifdef IORING_ASYNC_CANCEL_FD
+  if( flags & IORING_ASYNC_CANCEL_FD )
+    return op->sqe.fd == sqe->fd;
+#endif
+  return op->sqe.user_data == sqe->addr;
+}
+
+
+/* Does a cancel or poll remove request if it names pending requests of
+ * ours, and returns true.  If it names none of ours it is the kernel's to
+ * do.  With IORING_ASYNC_CANCEL_ANY or _FD, a request could also match
+ * requests that the kernel has, but only ours are cancelled.
+ */
+static int uring_sqe_cancel(struct citp_uring* r,
+                            const struct io_uring_sqe* sqe)
+{
+  unsigned flags = 0, known = 0;
+  int i, n = 0, res = 0;
+
+  if( sqe->opcode == IORING_OP_ASYNC_CANCEL ) {
+#ifdef IORING_ASYNC_CANCEL_ALL
+    flags = sqe->cancel_flags;
+    known = IORING_ASYNC_CANCEL_ALL | IORING_ASYNC_CANCEL_FD |
+            IORING_ASYNC_CANCEL_ANY;
+#endif
+  }
+  else if( sqe->opcode == IORING_OP_POLL_REMOVE ) {
+    flags = sqe->len;
+    known = IORING_POLL_UPDATE_EVENTS | IORING_POLL_UPDATE_USER_DATA |
+            IORING_POLL_ADD_MULTI;
+  }
+  else {
+    return 0;
+  }
+  if( r->ops_n == 0 || (flags & ~known) ||
+      (sqe->flags & (IOSQE_FIXED_FILE | IOSQE_IO_DRAIN | IOSQE_IO_LINK |
+                     IOSQE_IO_HARDLINK)) )
+    return 0;
+
+  for( i = 0; i < r->ops_n; ) {
+    struct citp_uring_op* op = &r->ops[i];
+    if( ! uring_cancel_match(sqe, flags, op) ) {
+      ++i;
+      continue;
+    }
+    ++n;
+    if( sqe->opcode == IORING_OP_POLL_REMOVE && flags != 0 ) {
+      /* An update rather than a removal */
+      if( flags & IORING_POLL_ADD_MULTI ) {
+        /* We don't do multishot polls */
+        res = -EOPNOTSUPP;
+        break;
+      }
+      if( flags & IORING_POLL_UPDATE_EVENTS )
+        op->sqe.poll32_events = sqe->poll32_events;
+      if( flags & IORING_POLL_UPDATE_USER_DATA )
+        op->sqe.user_data = sqe->off;
+      break;
+    }
+    uring_op_complete(r, i, -ECANCELED);
+#ifdef IORING_ASYNC_CANCEL_ALL
+    if( flags & IORING_ASYNC_CANCEL_ALL )
+      continue;
+#endif
+    break;
+  }
+  if( n == 0 )
+    return 0;
+
+#ifdef IORING_ASYNC_CANCEL_ALL
+  if( flags & IORING_ASYNC_CANCEL_ALL )
+    res = n;
+#endif
+  uring_msg_post(r, sqe->user_data, res);
+  return 1;
+}
+
+
+/* Takes the requests on accelerated sockets, and the cancel requests for
+ * them, out of the next [to_submit] SQEs, leaving NOPs in their place.
+ */
+static void uring_sq_scan(struct citp_uring* r, unsigned to_submit)
+{
+  struct citp_uring_map* m = &r->app;
+  citp_lib_context_t lib_context;
+  struct io_uring_sqe* sqe;
+  unsigned head, tail, i;
+  __u64 user_data;
+
+  head = OO_ACCESS_ONCE(*m->sq_head);
+  ci_rmb();
+  tail = *m->sq_tail;
+  if( tail - head > to_submit )
+    tail = head + to_submit;
+
+  citp_enter_lib(&lib_context);
+  for( i = head; i != tail; ++i ) {
+    unsigned idx = i & m->sq_mask;
+    if( m->sq_array != NULL )
+      idx = m->sq_array[idx];
+    if( idx >= m->sq_entries )
+      continue;
+    sqe = &m->sqes[idx];
+    if( uring_sqe_cancel(r, sqe) )
+      goto nop;
+    if( ! uring_sqe_is_ours(sqe) )
+      continue;
+    if( r->ops_n == r->ops_max && uring_ops_grow(r) < 0 )
+      break;
+
+    r->ops[r->ops_n].sqe = *sqe;
+    r->ops[r->ops_n].state = 0;
+    ++r->ops_n;
+
+   nop:
+    user_data = sqe->user_data;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_NOP;
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = user_data;
+  }
+  citp_exit_lib(&lib_context, 1);
+}
+
+
+/* Does whatever pending requests can be done now, and posts their
+ * completions.
+ */
+static void uring_ops_progress(struct citp_uring* r)
+{
+  struct citp_uring_op* op;
+  int i, j, dir, rc;
+
+  for( i = 0; i < r->ops_n; ) {
+    op = &r->ops[i];
+    dir = uring_op_dir(&op->sqe);
+    if( dir != URING_DIR_NONE ) {
+      for( j = 0; j < i; ++j )
+        if( r->ops[j].sqe.fd == op->sqe.fd &&
+            uring_op_dir(&r->ops[j].sqe) == dir )
+          break;
+      if( j < i ) {
+        ++i;
+        continue;
+      }
+    }
+
+    rc = uring_op_try(op);
+    if( rc == -EAGAIN ) {
+      ++i;
+      continue;
+    }
+    uring_op_complete(r, i, rc);
+  }
+  uring_msg_flush(r);
+}
+
+
+/**********************************************************************
+ * Ring tracking
+ */
+
+/* Returns the ring with its lock held and a user reference, or NULL */
+static struct citp_uring* uring_find(int fd)
+{
+  struct citp_uring* r;
+
+  pthread_mutex_lock(&citp_urings_lock);
+  for( r = citp_urings; r != NULL; r = r->next )
+    if( r->fd == fd ) {
+      pthread_mutex_lock(&r->lock);
+      ++r->users;
+      break;
+    }
+  pthread_mutex_unlock(&citp_urings_lock);
+  return r;
+}
+
+
+static void uring_free(struct citp_uring* r)
+{
+  uring_unmap(&r->msg);
+  ci_sys_close(r->msg_fd);
+  uring_unmap(&r->app);
+  pthread_mutex_destroy(&r->lock);
+  free(r->ops);
+  free(r);
+}
+
+
+/* Drops the lock and the reference taken by uring_find() */
+static void uring_put(struct citp_uring* r)
+{
+  int free_it = --r->users == 0 && r->closed;
+  pthread_mutex_unlock(&r->lock);
+  if( free_it )
+    uring_free(r);
+}
+
+
+static int uring_track(int fd, const struct io_uring_params* p)
+{
+  unsigned bad_flags = IORING_SETUP_SQPOLL | IORING_SETUP_R_DISABLED;
+  struct citp_uring* r;
+  int rc;
+
+#ifdef IORING_SETUP_SQE128
+  bad_flags |= IORING_SETUP_SQE128;
+#endif
+#ifdef IORING_SETUP_NO_MMAP
+  bad_flags |= IORING_SETUP_NO_MMAP;
+#endif
+#ifdef IORING_SETUP_REGISTERED_FD_ONLY
+  bad_flags |= IORING_SETUP_REGISTERED_FD_ONLY;
+#endif
+  if( p->flags & bad_flags )
+    return -EOPNOTSUPP;
+  if( (p->features & (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_CQE_SKIP)) !=
+      (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_CQE_SKIP) )
+    return -EOPNOTSUPP;
+
+  if( (r = calloc(1, sizeof(*r))) == NULL )
+    return -ENOMEM;
+  r->fd = fd;
+  r->setup_flags = p->flags;
+  pthread_mutex_init(&r->lock, NULL);
+  if( (rc = uring_map(fd, p, &r->app)) < 0 )
+    goto fail1;
+  if( (rc = uring_msg_init(r)) < 0 )
+    goto fail2;
+
+  pthread_mutex_lock(&citp_urings_lock);
+  r->next = citp_urings;
+  citp_urings = r;
+  pthread_mutex_unlock(&citp_urings_lock);
+  return 0;
+
+ fail2:
+  uring_unmap(&r->app);
+ fail1:
+  pthread_mutex_destroy(&r->lock);
+  free(r);
+  return rc;
+}
+
+
+/**********************************************************************
+ * Entry points
+ */
+
+int citp_uring_setup(unsigned entries, struct io_uring_params* p)
+{
+  int fd, rc;
+
+  fd = ci_sys_syscall(__NR_io_uring_setup, entries, p);
+  if( fd < 0 || ! CITP_OPTS.io_uring || citp.init_level < CITP_INIT_ALL )
+    return fd;
+
+  rc = uring_track(fd, p);
+  Log_V(log(LPF "setup(%u, %x) = %d: %s (%d)", entries, p->flags, fd,
+            rc == 0 ? "intercepting" : "not intercepting", rc));
+  return fd;
+}
+
+
+/* Time left until [deadline], or zero if it has passed */
+static void uring_time_left(const struct timespec* deadline,
+                            struct timespec* left)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  left->tv_sec = deadline->tv_sec - now.tv_sec;
+  left->tv_nsec = deadline->tv_nsec - now.tv_nsec;
+  if( left->tv_nsec < 0 ) {
+    left->tv_nsec += 1000000000;
+    --left->tv_sec;
+  }
+  if( left->tv_sec < 0 ) {
+    left->tv_sec = 0;
+    left->tv_nsec = 0;
+  }
+}
+
+
+/* Milliseconds left until [deadline], rounded up, or -1 if there is none */
+static int uring_timeout_ms(const struct timespec* deadline)
+{
+  struct timespec left;
+  long long ms;
+
+  if( deadline == NULL )
+    return -1;
+  uring_time_left(deadline, &left);
+  ms = left.tv_sec * 1000LL + (left.tv_nsec + 999999) / 1000000;
+  return ms > INT_MAX ? INT_MAX : (int) ms;
+}
+
+
+/* Waits for [min_complete] completions on a ring with requests of ours
+ * pending.  Returns with the ring's lock held.
+ *
+ * With IORING_ENTER_ABS_TIMER the timeout is taken to be on
+ * CLOCK_MONOTONIC, which is the ring's clock unless the app registered
+ * another with IORING_REGISTER_CLOCK.
+ */
+static int uring_wait(struct citp_uring* r, unsigned min_complete,
+                      unsigned flags, const void* arg, size_t argsz)
+{
+  const sigset_t* sigmask = arg;
+  struct io_uring_getevents_arg ea_left;
+  struct __kernel_timespec ts_left;
+  struct timespec deadline_ts, left;
+  const struct timespec* deadline = NULL;
+  struct pollfd* pfds = NULL;
+  unsigned cq_n;
+  int i, n, ms, pfds_max = 0, rc = 0;
+
+  if( flags & IORING_ENTER_EXT_ARG ) {
+    const struct io_uring_getevents_arg* ea = arg;
+    if( argsz != sizeof(*ea) ) {
+      errno = EINVAL;
+      return -1;
+    }
+    sigmask = (const sigset_t*) (uintptr_t) ea->sigmask;
+    if( ea->ts != 0 ) {
+      const struct __kernel_timespec* ts =
+        (const struct __kernel_timespec*) (uintptr_t) ea->ts;
+      if( flags & IORING_ENTER_ABS_TIMER ) {
+        deadline_ts.tv_sec = ts->tv_sec;
+        deadline_ts.tv_nsec = ts->tv_nsec;
+      }
+      else {
+        clock_gettime(CLOCK_MONOTONIC, &deadline_ts);
+        deadline_ts.tv_sec += ts->tv_sec + (deadline_ts.tv_nsec +
+                                            ts->tv_nsec) / 1000000000;
+        deadline_ts.tv_nsec = (deadline_ts.tv_nsec + ts->tv_nsec) % 1000000000;
+      }
+      deadline = &deadline_ts;
+    }
+  }
+
+  while( 1 ) {
+#ifdef IORING_SETUP_DEFER_TASKRUN
+    /* The kernel only posts completions to these rings when asked */
+    if( r->setup_flags & IORING_SETUP_DEFER_TASKRUN )
+      uring_sys_enter(r->fd, 0, 0, IORING_ENTER_GETEVENTS, NULL, 0);
+#endif
+    cq_n = OO_ACCESS_ONCE(*r->app.cq_tail) - OO_ACCESS_ONCE(*r->app.cq_head);
+    if( cq_n >= min_complete || r->ops_n == 0 )
+      break;
+
+    /* Another thread may submit while we wait, so poll a copy */
+    if( r->ops_n + 1 > pfds_max ) {
+      struct pollfd* p = realloc(pfds, (r->ops_n + 1) * sizeof(*pfds));
+      if( p == NULL ) {
+        errno = ENOMEM;
+        rc = -1;
+        goto out;
+      }
+      pfds = p;
+      pfds_max = r->ops_n + 1;
+    }
+    /* The ring's fd is readable for as long as its CQ is not empty.  With
+     * some completions, but fewer than wanted, it would wake us at once, so
+     * leave it out and look at the CQ every URING_CQ_POLL_MS instead. */
+    n = 0;
+    ms = uring_timeout_ms(deadline);
+    if( cq_n == 0 ) {
+      pfds[n].fd = r->fd;
+      pfds[n].events = POLLIN;
+      pfds[n].revents = 0;
+      ++n;
+    }
+    else if( ms < 0 || ms > URING_CQ_POLL_MS ) {
+      ms = URING_CQ_POLL_MS;
+    }
+    for( i = 0; i < r->ops_n; ++i, ++n ) {
+      pfds[n].fd = r->ops[i].sqe.fd;
+      pfds[n].events = uring_op_events(&r->ops[i].sqe);
+      pfds[n].revents = 0;
+    }
+
+    pthread_mutex_unlock(&r->lock);
+    if( sigmask != NULL ) {
+      struct timespec ts;
+      ts.tv_sec = ms / 1000;
+      ts.tv_nsec = (ms % 1000) * 1000000;
+      rc = onload_ppoll(pfds, n, ms >= 0 ? &ts : NULL, sigmask);
+    }
+    else {
+      rc = onload_poll(pfds, n, ms);
+    }
+    pthread_mutex_lock(&r->lock);
+
+    if( r->closed ) {
+      /* The fd may have been reused already, so leave it alone */
+      errno = EBADF;
+      rc = -1;
+      goto out;
+    }
+    if( rc < 0 )
+      goto out;
+    if( rc > 0 ) {
+      uring_ops_progress(r);
+    }
+    else if( uring_timeout_ms(deadline) == 0 ) {
+      /* As the kernel, a timeout is only an error if there's nothing */
+      if( OO_ACCESS_ONCE(*r->app.cq_tail) ==
+          OO_ACCESS_ONCE(*r->app.cq_head) ) {
+        errno = ETIME;
+        rc = -1;
+      }
+      goto out;
+    }
+  }
+  rc = 0;
+
+  if( r->ops_n == 0 ) {
+    /* Nothing left for us to do, so the kernel can wait for the rest, for
+     * whatever is left of a relative timeout */
+    if( deadline != NULL && ! (flags & IORING_ENTER_ABS_TIMER) ) {
+      ea_left = *(const struct io_uring_getevents_arg*) arg;
+      uring_time_left(deadline, &left);
+      ts_left.tv_sec = left.tv_sec;
+      ts_left.tv_nsec = left.tv_nsec;
+      ea_left.ts = (uintptr_t) &ts_left;
+      arg = &ea_left;
+    }
+    pthread_mutex_unlock(&r->lock);
+    rc = uring_sys_enter(r->fd, 0, min_complete, flags, arg, argsz) < 0 ?
+         -1 : 0;
+    pthread_mutex_lock(&r->lock);
+  }
+
+ out:
+  free(pfds);
+  return rc;
+}
+
+
+long citp_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                      unsigned flags, const void* arg, size_t argsz)
+{
+  struct citp_uring* r;
+  long submitted = 0;
+  int rc;
+
+  if( citp_urings == NULL ||
+#ifdef IORING_ENTER_REGISTERED_RING
+      (flags & IORING_ENTER_REGISTERED_RING) ||
+#endif
+      (r = uring_find(fd)) == NULL )
+    return uring_sys_enter(fd, to_submit, min_complete, flags, arg, argsz);
+
+  Log_VV(log(LPF "enter(%d, %u, %u, %x) pending=%d", fd, to_submit,
+             min_complete, flags, r->ops_n));
+
+  if( to_submit != 0 )
+    uring_sq_scan(r, to_submit);
+  uring_ops_progress(r);
+
+  if( r->ops_n == 0 || ! (flags & IORING_ENTER_GETEVENTS) ||
+      min_complete == 0 ) {
+    uring_put(r);
+    return uring_sys_enter(fd, to_submit, min_complete, flags, arg, argsz);
+  }
+
+  /* Some of the completions we're waiting for may be ours */
+  if( to_submit != 0 ) {
+    submitted = uring_sys_enter(fd, to_submit, 0,
+                                flags & ~IORING_ENTER_GETEVENTS, arg, argsz);
+    if( submitted < 0 ) {
+      uring_put(r);
+      return submitted;
+    }
+  }
+  rc = uring_wait(r, min_complete, flags, arg, argsz);
+  uring_put(r);
+  if( rc < 0 && submitted == 0 )
+    return -1;
+  return submitted;
+}
+
+
+/* Fails the requests pending on [fd], which is being closed.  Once it is
+ * closed the fd may be reused, and they would be done on something else.
+ * Called with citp_urings_lock held.
+ */
+static void uring_fd_closed(int fd)
+{
+  struct citp_uring* r;
+  int i, n;
+
+  for( r = citp_urings; r != NULL; r = r->next ) {
+    pthread_mutex_lock(&r->lock);
+    for( i = 0, n = 0; i < r->ops_n; )
+      if( r->ops[i].sqe.fd == fd ) {
+        uring_op_complete(r, i, -ECANCELED);
+        ++n;
+      }
+      else {
+        ++i;
+      }
+    if( n != 0 ) {
+      Log_V(log(LPF "close(%d): cancelled %d requests on ring %d",
+                fd, n, r->fd));
+      uring_msg_flush(r);
+    }
+    pthread_mutex_unlock(&r->lock);
+  }
+}
+
+
+void citp_uring_close(int fd)
+{
+  struct citp_uring** pr;
+  struct citp_uring* r = NULL;
+  int free_it;
+
+  pthread_mutex_lock(&citp_urings_lock);
+  for( pr = &citp_urings; *pr != NULL; pr = &(*pr)->next )
+    if( (*pr)->fd == fd ) {
+      r = *pr;
+      *pr = r->next;
+      break;
+    }
+  if( r == NULL )
+    uring_fd_closed(fd);
+  pthread_mutex_unlock(&citp_urings_lock);
+
+  if( r != NULL ) {
+    /* Threads waiting on it notice when they next take the lock, and the
+     * last of them frees it */
+    pthread_mutex_lock(&r->lock);
+    r->closed = 1;
+    if( r->ops_n != 0 )
+      Log_V(log(LPF "close(%d): dropping %d pending requests", fd, r->ops_n));
+    free_it = r->users == 0;
+    pthread_mutex_unlock(&r->lock);
+    if( free_it )
+      uring_free(r);
+  }
+}
+
+#endif /* CI_CFG_IO_URING */
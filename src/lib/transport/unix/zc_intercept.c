@@ -338,6 +338,82 @@ int onload_zc_recv(int fd, struct onload_zc_recv_args* args)
 }
 
 
+/* Most stacks onload_zc_recv_batch() remembers having polled; any more
+ * may be polled more than once */
+#define ZC_RECV_BATCH_POLL_MAX  8
+
+int onload_zc_recv_batch(const int* fds, int nfds,
+                         struct onload_zc_recv_batch_msg* msgs, int max_msgs,
+                         struct onload_zc_iovec* iov, int iov_len, int flags)
+{
+  ci_netif* polled[ZC_RECV_BATCH_POLL_MAX];
+  int n_polled = 0, n = 0, rc = 0, quota, pass, i, j;
+  citp_lib_context_t lib_context;
+  citp_sock_fdi* epi;
+  citp_fdinfo* fdi;
+  ci_netif* ni;
+
+  Log_CALL(ci_log("%s(%p, %d, %p, %d, %p, %d, %x)", __FUNCTION__, fds, nfds,
+                  msgs, max_msgs, iov, iov_len, flags));
+
+  if( flags != 0 || nfds < 0 || max_msgs < 0 || iov_len < 0 )
+    return -EINVAL;
+
+  citp_enter_lib(&lib_context);
+
+  /* Poll each stack once, stopping at the first socket we can't use */
+  for( i = 0; i < nfds; ++i ) {
+    fdi = citp_fdtable_lookup(fds[i]);
+    if( fdi == NULL || citp_fdinfo_get_type(fdi) != CITP_UDP_SOCKET ) {
+      if( fdi != NULL )
+        citp_fdinfo_release_ref(fdi, 0);
+      rc = -ESOCKTNOSUPPORT;
+      break;
+    }
+    ni = fdi_to_sock_fdi(fdi)->sock.netif;
+    for( j = 0; j < n_polled && polled[j] != ni; ++j )
+      ;
+    if( j == n_polled ) {
+      if( n_polled < ZC_RECV_BATCH_POLL_MAX )
+        polled[n_polled++] = ni;
+      if( ci_netif_may_poll(ni) && ci_netif_need_poll(ni) &&
+          ci_netif_trylock(ni) ) {
+        ci_netif_poll(ni);
+        ci_netif_unlock(ni);
+      }
+    }
+    citp_fdinfo_release_ref(fdi, 0);
+  }
+  nfds = i;
+
+  /* First give each socket its share, so that a busy socket early in
+   * [fds] can't starve the rest, then fill up any space left. */
+  quota = nfds ? CI_MAX(max_msgs / nfds, 1) : 0;
+  for( pass = 0; pass < 2 && n < max_msgs; ++pass )
+    for( i = 0; i < nfds && n < max_msgs && iov_len > 0; ++i ) {
+      /* Another thread may have closed it since */
+      if( (fdi = citp_fdtable_lookup(fds[i])) == NULL )
+        continue;
+      if( citp_fdinfo_get_type(fdi) == CITP_UDP_SOCKET ) {
+        epi = fdi_to_sock_fdi(fdi);
+        n += ci_udp_zc_recv_batch(epi->sock.netif, SOCK_TO_UDP(epi->sock.s),
+                                  fds[i], msgs + n,
+                                  pass == 0 ? CI_MIN(quota, max_msgs - n) :
+                                              max_msgs - n,
+                                  &iov, &iov_len);
+      }
+      citp_fdinfo_release_ref(fdi, 0);
+    }
+
+  citp_exit_lib(&lib_context, TRUE);
+
+  if( n > 0 || rc == 0 )
+    rc = n;
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
 
 int onload_zc_send(struct onload_zc_mmsg* msgs, int mlen, int flags)
 {
@@ -0,0 +1,194 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Checks the CRC32C implementations against a bit-at-a-time reference,
+ * and compares their throughput by buffer size.
+ *
+ * Exits with an error if any implementation gets a CRC or a copy wrong.
+ * Implementations the CPU can't run are skipped.
+ */
+
+#include <ci/tools.h>
+#include <ci/tools/crc32c.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+
+static const int sizes[] = { 64, 256, 512, 1460, 4096, 9000, 65536 };
+
+#define N_SIZES   (sizeof(sizes) / sizeof(sizes[0]))
+#define MAX_SIZE  65536
+#define MAX_ALIGN 8
+
+/* Bytes to process per measurement */
+static long bench_bytes = 256 << 20;
+
+static ci_uint8* src;
+static ci_uint8* dest;
+
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static ci_uint32 ref_crc32c(ci_uint32 crc, const ci_uint8* buf, int len)
+{
+  int i;
+  while( len-- ) {
+    crc ^= *buf++;
+    for( i = 0; i < 8; ++i )
+      crc = (crc >> 1) ^ (crc & 1 ? 0x82f63b78 : 0);
+  }
+  return crc;
+}
+
+
+static int check(const char* impl, int size, int align)
+{
+  ci_uint32 ref = ref_crc32c(0xffffffff, src + align, size);
+  ci_uint32 crc;
+  int split = size ? rand() % size : 0;
+  int rc;
+
+  rc = ci_crc32c_impl_select(impl);
+  ci_assert_equal(rc, 0);
+
+  crc = ci_crc32c_partial(src + align, size, 0xffffffff);
+  if( crc != ref ) {
+    fprintf(stderr, "%s: ci_crc32c_partial(%d bytes at +%d) = %08x, "
+            "expected %08x\n", impl, size, align, crc, ref);
+    return 0;
+  }
+
+  crc = ci_crc32c_partial(src + align, split, 0xffffffff);
+  crc = ci_crc32c_partial(src + align + split, size - split, crc);
+  if( crc != ref ) {
+    fprintf(stderr, "%s: ci_crc32c_partial(%d bytes at +%d, split at %d) = "
+            "%08x, expected %08x\n", impl, size, align, split, crc, ref);
+    return 0;
+  }
+
+  memset(dest, 0, MAX_SIZE + MAX_ALIGN * 2);
+  crc = ci_crc32c_partial_copy(dest + align, src + align, size, 0xffffffff);
+  if( crc != ref || memcmp(dest + align, src + align, size) != 0 ||
+      dest[align + size] != 0 ) {
+    fprintf(stderr, "%s: ci_crc32c_partial_copy(%d bytes at +%d) wrong\n",
+            impl, size, align);
+    return 0;
+  }
+  return 1;
+}
+
+
+/* Returns GB/s */
+static double bench(int size)
+{
+  long i, iters = CI_MAX(bench_bytes / size, 1);
+  volatile ci_uint32 sink;
+  ci_uint32 crc = 0;
+  double t;
+
+  t = now_ns();
+  for( i = 0; i < iters; ++i )
+    crc = ci_crc32c_partial(src, size, crc);
+  t = now_ns() - t;
+  sink = crc;
+  (void) sink;
+  return (double) iters * size / t;
+}
+
+
+static void usage(void)
+{
+  fprintf(stderr, "usage:\n");
+  fprintf(stderr, "  crc32c_bench [-b MBYTES] [-c]\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "options:\n");
+  fprintf(stderr, "  -b MBYTES    - data to checksum per measurement\n");
+  fprintf(stderr, "  -c           - check correctness only\n");
+  exit(1);
+}
+
+
+int main(int argc, char* argv[])
+{
+  const char* impls[16];
+  int n_impls = 0, check_only = 0, failed = 0;
+  int i, s, a, c;
+
+  while( (c = getopt(argc, argv, "b:ch")) != -1 )
+    switch( c ) {
+    case 'b':
+      bench_bytes = atol(optarg) << 20;
+      break;
+    case 'c':
+      check_only = 1;
+      break;
+    default:
+      usage();
+    }
+
+  src = malloc(MAX_SIZE + MAX_ALIGN * 2);
+  dest = malloc(MAX_SIZE + MAX_ALIGN * 2);
+  if( src == NULL || dest == NULL ) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  srand(0xc3c3);
+  for( i = 0; i < MAX_SIZE + MAX_ALIGN * 2; ++i )
+    src[i] = rand();
+
+  printf("best implementation: %s\n", ci_crc32c_impl_selected());
+  for( i = 0; ci_crc32c_impl_name(i) != NULL; ++i ) {
+    const char* impl = ci_crc32c_impl_name(i);
+    if( ci_crc32c_impl_select(impl) != 0 ) {
+      printf("%s: not supported by this CPU\n", impl);
+      continue;
+    }
+    impls[n_impls++] = impl;
+  }
+
+  for( i = 0; i < n_impls; ++i ) {
+    /* The check value from RFC 3720 */
+    ci_crc32c_impl_select(impls[i]);
+    if( ci_crc32c((const ci_uint8*) "123456789", 9) != 0xe3069283 ) {
+      fprintf(stderr, "%s: wrong check value\n", impls[i]);
+      ++failed;
+    }
+    /* Every length past two rounds of the long blocks, for the block
+     * boundaries and the tail handling */
+    for( s = 0; s <= 7000; ++s )
+      failed += ! check(impls[i], s, s % MAX_ALIGN);
+    for( s = 0; s < N_SIZES; ++s )
+      for( a = 0; a < MAX_ALIGN; ++a )
+        failed += ! check(impls[i], sizes[s], a);
+  }
+  printf("correctness: %s\n", failed ? "FAILED" : "ok");
+  if( failed || check_only )
+    return failed ? 1 : 0;
+
+  printf("\nGB/s        ");
+  for( i = 0; i < n_impls; ++i )
+    printf(" %8s", impls[i]);
+  printf("\n");
+  for( s = 0; s < N_SIZES; ++s ) {
+    printf("%6d bytes", sizes[s]);
+    for( i = 0; i < n_impls; ++i ) {
+      ci_crc32c_impl_select(impls[i]);
+      printf(" %8.2f", bench(sizes[s]));
+    }
+    printf("\n");
+  }
+
+  free(src);
+  free(dest);
+  return 0;
+}
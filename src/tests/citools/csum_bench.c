@@ -0,0 +1,190 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Checks the vector Internet checksum implementations against the C one,
+ * and compares their throughput by buffer size and alignment.
+ *
+ * Exits with an error if any implementation gets a checksum or a copy
+ * wrong.  Implementations the CPU can't run are skipped.
+ */
+
+#include <ci/tools.h>
+#include <ci/tools/ipcsum_base.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+
+static const int sizes[] = { 64, 128, 256, 512, 1460, 4096, 9000, 65536 };
+static const int aligns[] = { 0, 1, 2, 8 };
+
+#define N_SIZES   (sizeof(sizes) / sizeof(sizes[0]))
+#define N_ALIGNS  (sizeof(aligns) / sizeof(aligns[0]))
+#define MAX_SIZE  65536
+#define MAX_ALIGN 64
+
+/* Bytes to process per measurement */
+static long bench_bytes = 256 << 20;
+
+static ci_uint8* src;
+static ci_uint8* dest;
+
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/* Sums are only defined modulo 0xffff */
+static unsigned csum_mod(unsigned sum)
+{
+  return sum % 0xffff;
+}
+
+
+static int check(const char* impl, int size, int align)
+{
+  unsigned ref_copy, ref_partial, copy, partial;
+  int rc;
+
+  rc = ci_ip_csum_impl_select("c");
+  ci_assert_equal(rc, 0);
+  ref_partial = ci_ip_csum_partial(0, src + align, size);
+  ref_copy = ci_ip_csum_copy2(dest + align, src + align, size, 0x1234);
+
+  memset(dest, 0, MAX_SIZE + MAX_ALIGN * 2);
+  rc = ci_ip_csum_impl_select(impl);
+  ci_assert_equal(rc, 0);
+  partial = ci_ip_csum_partial(0, src + align, size);
+  copy = ci_ip_csum_copy2(dest + align, src + align, size, 0x1234);
+
+  if( csum_mod(partial) != csum_mod(ref_partial) ) {
+    fprintf(stderr, "%s: ci_ip_csum_partial(%d bytes at +%d) = %x, "
+            "expected %x\n", impl, size, align, partial, ref_partial);
+    return 0;
+  }
+  if( csum_mod(copy) != csum_mod(ref_copy) ) {
+    fprintf(stderr, "%s: ci_ip_csum_copy2(%d bytes at +%d) = %x, "
+            "expected %x\n", impl, size, align, copy, ref_copy);
+    return 0;
+  }
+  if( memcmp(dest + align, src + align, size) != 0 ||
+      dest[align + size] != 0 || (align && dest[align - 1] != 0) ) {
+    fprintf(stderr, "%s: ci_ip_csum_copy2(%d bytes at +%d) copied wrong\n",
+            impl, size, align);
+    return 0;
+  }
+  return 1;
+}
+
+
+/* Returns GB/s */
+static double bench(int size, int align, int do_copy)
+{
+  long i, iters = CI_MAX(bench_bytes / size, 1);
+  volatile unsigned sink;
+  unsigned sum = 0;
+  double t;
+
+  t = now_ns();
+  if( do_copy )
+    for( i = 0; i < iters; ++i )
+      sum += ci_ip_csum_copy2(dest + align, src + align, size, sum);
+  else
+    for( i = 0; i < iters; ++i )
+      sum += ci_ip_csum_partial(sum, src + align, size);
+  t = now_ns() - t;
+  sink = sum;
+  (void) sink;
+  return (double) iters * size / t;
+}
+
+
+static void usage(void)
+{
+  fprintf(stderr, "usage:\n");
+  fprintf(stderr, "  csum_bench [-b MBYTES] [-c]\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "options:\n");
+  fprintf(stderr, "  -b MBYTES    - data to checksum per measurement\n");
+  fprintf(stderr, "  -c           - check correctness only\n");
+  exit(1);
+}
+
+
+int main(int argc, char* argv[])
+{
+  const char* impls[16];
+  int n_impls = 0, check_only = 0, failed = 0;
+  int i, s, a, c;
+
+  while( (c = getopt(argc, argv, "b:ch")) != -1 )
+    switch( c ) {
+    case 'b':
+      bench_bytes = atol(optarg) << 20;
+      break;
+    case 'c':
+      check_only = 1;
+      break;
+    default:
+      usage();
+    }
+
+  src = malloc(MAX_SIZE + MAX_ALIGN * 2);
+  dest = malloc(MAX_SIZE + MAX_ALIGN * 2);
+  if( src == NULL || dest == NULL ) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  srand(0xc5c5);
+  for( i = 0; i < MAX_SIZE + MAX_ALIGN * 2; ++i )
+    src[i] = rand();
+
+  printf("best implementation: %s\n", ci_ip_csum_impl_selected());
+  for( i = 0; ci_ip_csum_impl_name(i) != NULL; ++i ) {
+    const char* impl = ci_ip_csum_impl_name(i);
+    if( ci_ip_csum_impl_select(impl) != 0 ) {
+      printf("%s: not supported by this CPU\n", impl);
+      continue;
+    }
+    impls[n_impls++] = impl;
+  }
+
+  /* Every length up to 512, for the tail handling */
+  for( i = 0; i < n_impls; ++i )
+    for( s = 0; s <= 512; s += 2 )
+      for( a = 0; a < N_ALIGNS; ++a )
+        failed += ! check(impls[i], s, aligns[a]);
+  for( i = 0; i < n_impls; ++i )
+    for( s = 0; s < N_SIZES; ++s )
+      for( a = 0; a < N_ALIGNS; ++a )
+        failed += ! check(impls[i], sizes[s], aligns[a]);
+  printf("correctness: %s\n", failed ? "FAILED" : "ok");
+  if( failed || check_only )
+    return failed ? 1 : 0;
+
+  printf("\nGB/s            ");
+  for( i = 0; i < n_impls; ++i )
+    printf(" %8s-csum %8s-copy", impls[i], impls[i]);
+  printf("\n");
+  for( s = 0; s < N_SIZES; ++s )
+    for( a = 0; a < N_ALIGNS; ++a ) {
+      printf("%6d bytes +%-2d", sizes[s], aligns[a]);
+      for( i = 0; i < n_impls; ++i ) {
+        ci_ip_csum_impl_select(impls[i]);
+        printf(" %13.2f", bench(sizes[s], aligns[a], 0));
+        printf(" %13.2f", bench(sizes[s], aligns[a], 1));
+      }
+      printf("\n");
+    }
+
+  free(src);
+  free(dest);
+  return 0;
+}
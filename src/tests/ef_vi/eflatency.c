@@ -15,6 +15,7 @@
 #include <etherfabric/capabilities.h>
 #include <etherfabric/checksum.h>
 #include <etherfabric/efct_vi.h>
+#include <etherfabric/shm_vi.h>
 #include <ci/tools.h>
 #include <ci/tools/ipcsum_base.h>
 #include <ci/tools/ippacket.h>
@@ -45,6 +46,7 @@ static int              cfg_payload_step = 1;
 static int              cfg_ctpio_no_poison;
 static unsigned         cfg_ctpio_thresh = 64;
 static const char*      cfg_save_file = NULL;
+static const char*      cfg_shm_link = NULL;
 enum mode {
   MODE_DMA = 1,
   MODE_PIO = 2,
@@ -114,8 +116,14 @@ static void init_udp_pkt(void* pkt_buf, int paylen)
   ip4 = (void*) ((char*) eth + 14);
   udp = (void*) (ip4 + 1);
 
+  /* Locally administered, for links with no NIC behind them */
+  const uint8_t shm_mac[] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
   memcpy(eth->ether_dhost, remote_mac, sizeof(remote_mac));
-  ef_vi_get_mac(&rx_vi.vi, driver_handle, eth->ether_shost);
+  if( cfg_shm_link )
+    memcpy(eth->ether_shost, shm_mac, sizeof(shm_mac));
+  else
+    ef_vi_get_mac(&rx_vi.vi, driver_handle, eth->ether_shost);
   eth->ether_type = htons(0x0800);
   ci_ip4_hdr_init(ip4, CI_NO_OPTS, ip_len, 0, IPPROTO_UDP, htonl(laddr_he),
                   htonl(raddr_he), 0);
@@ -664,6 +672,42 @@ static const test_t* do_init(int ifindex, int mode,
   return t;
 }
 
+/* A shared-memory link has no driver behind it and supports DMA sends
+ * only.  Ping and pong take opposite ends of the link.
+ */
+static const test_t* do_init_shm(bool ping, struct eflatency_vi* latency_vi,
+                                 void* pkt_mem, size_t pkt_mem_bytes)
+{
+  ef_vi* vi = &latency_vi->vi;
+
+  if( ! (cfg_mode & MODE_DMA) ) {
+    fprintf(stderr, "No compatible mode found\n");
+    exit(1);
+  }
+  TRY(ef_shm_vi_alloc(vi, cfg_shm_link, ping ? 0 : 1, NULL, -1, -1,
+                      cfg_vi_flags));
+  ef_vi_receive_set_buffer_len(vi, BUF_SIZE - offsetof(struct pkt_buf,
+                                                       dma_buf));
+  TRY(ef_shm_memreg_init(&latency_vi->memreg, pkt_mem,
+                         CI_ROUND_UP(pkt_mem_bytes, 4096)));
+
+  init_udp_pkt(pkt_bufs[FIRST_TX_BUF]->dma_buf, cfg_payload_len);
+  tx_frame_len = cfg_payload_len + HEADER_SIZE;
+  return &dma_test;
+}
+
+static void print_shm_stats(ef_vi* vi)
+{
+  struct ef_shm_vi_stats s;
+
+  ef_shm_vi_get_stats(vi, &s);
+  printf("# shm tx_pkts=%"PRIu64" tx_lost=%"PRIu64" tx_reordered=%"PRIu64
+         " tx_link_full=%"PRIu64"\n",
+         s.tx_pkts, s.tx_lost, s.tx_reordered, s.tx_link_full);
+  printf("# shm rx_pkts=%"PRIu64" rx_no_desc=%"PRIu64"\n",
+         s.rx_pkts, s.rx_no_desc);
+}
+
 static void prepare(ef_vi* vi)
 {
   int i;
@@ -689,6 +733,7 @@ static CI_NORETURN usage(const char* fmt, ...)
   }
   fprintf(stderr, "\nusage:\n");
   fprintf(stderr, "  eflatency [options] <ping|pong> <interface> [<tx_interface>]\n");
+  fprintf(stderr, "  eflatency [options] -L <link-name> <ping|pong>\n");
   fprintf(stderr, "\noptions:\n");
   fprintf(stderr, "  -n <iterations>     - set number of iterations\n");
   fprintf(stderr, "  -s <message-size>   - set udp payload size. Accepts Python slices\n");
@@ -699,6 +744,9 @@ static CI_NORETURN usage(const char* fmt, ...)
   fprintf(stderr, "                        [pio], [a]lternatives, [d]ma, [x]dp\n");
   fprintf(stderr, "  -t <modes>          - set TX_PUSH: [a]lways, [d]isable\n");
   fprintf(stderr, "  -o <filename>       - save raw timings to file\n");
+  fprintf(stderr, "  -L <link-name>      - use a shared-memory link instead of a NIC.\n");
+  fprintf(stderr, "                        Impairments are read from EF_SHM_LATENCY_NS,\n");
+  fprintf(stderr, "                        EF_SHM_LOSS_PPM and EF_SHM_REORDER_PPM\n");
   fprintf(stderr, "\n");
   exit(1);
 }
@@ -736,7 +784,7 @@ int main(int argc, char* argv[])
     p = (unsigned int)__v;                                   \
   } while( 0 );
 
-  while( (c = getopt (argc, argv, "n:s:w:c:pm:t:o:")) != -1 )
+  while( (c = getopt (argc, argv, "n:s:w:c:pm:t:o:L:")) != -1 )
     switch( c ) {
     case 'n':
       OPT_INT(optarg, cfg_iter);
@@ -767,6 +815,9 @@ int main(int argc, char* argv[])
     case 'o':
       cfg_save_file = optarg;
       break;
+    case 'L':
+      cfg_shm_link = optarg;
+      break;
     case 'm':
       cfg_mode = 0;
       for( i = 0; i < strlen(optarg); ++i ) {
@@ -802,13 +853,19 @@ int main(int argc, char* argv[])
   argc -= optind;
   argv += optind;
 
-  if( argc != 2 && argc != 3 )
-    usage(NULL);
-  if( ! parse_interface(argv[1], &rx_ifindex) )
-    usage("Unable to parse RX interface '%s': %s", argv[1], strerror(errno));
+  if( cfg_shm_link ) {
+    if( argc != 1 )
+      usage(NULL);
+  }
+  else {
+    if( argc != 2 && argc != 3 )
+      usage(NULL);
+    if( ! parse_interface(argv[1], &rx_ifindex) )
+      usage("Unable to parse RX interface '%s': %s", argv[1], strerror(errno));
 
-  if( argc == 3 && ! parse_interface(argv[2], &tx_ifindex) )
-    usage("Unable to parse TX interface '%s': %s", argv[2], strerror(errno));
+    if( argc == 3 && ! parse_interface(argv[2], &tx_ifindex) )
+      usage("Unable to parse TX interface '%s': %s", argv[2], strerror(errno));
+  }
 
   if( cfg_payload_len > MAX_UDP_PAYLEN || cfg_payload_end > MAX_UDP_PAYLEN ) {
     fprintf(stderr, "WARNING: UDP payload length %d is larger than standard "
@@ -826,16 +883,23 @@ int main(int argc, char* argv[])
   else if( strcmp(argv[0], "pong") != 0 )
     usage("Unknown command '%s'", argv[0]);
 
-  TRY(ef_driver_open(&driver_handle));
-  TRY(ef_vi_capabilities_get(driver_handle, rx_ifindex,
-                             EF_VI_CAP_MIN_BUFFER_MODE_SIZE, &rx_min_page_size));
-  if( tx_ifindex < 0 ) {
-    min_page_size = rx_min_page_size;
+  if( cfg_shm_link ) {
+    min_page_size = 4096;
   }
   else {
-    TRY(ef_vi_capabilities_get(driver_handle, tx_ifindex,
-                               EF_VI_CAP_MIN_BUFFER_MODE_SIZE, &min_page_size));
-    min_page_size = CI_MAX(rx_min_page_size, min_page_size);
+    TRY(ef_driver_open(&driver_handle));
+    TRY(ef_vi_capabilities_get(driver_handle, rx_ifindex,
+                               EF_VI_CAP_MIN_BUFFER_MODE_SIZE,
+                               &rx_min_page_size));
+    if( tx_ifindex < 0 ) {
+      min_page_size = rx_min_page_size;
+    }
+    else {
+      TRY(ef_vi_capabilities_get(driver_handle, tx_ifindex,
+                                 EF_VI_CAP_MIN_BUFFER_MODE_SIZE,
+                                 &min_page_size));
+      min_page_size = CI_MAX(rx_min_page_size, min_page_size);
+    }
   }
 
   pkt_mem_bytes = N_BUFS * BUF_SIZE;
@@ -858,7 +922,10 @@ int main(int argc, char* argv[])
   /* Initialize a VI and configure it to operate with the lowest latency
    * possible.  The return value specifies the test that the application must
    * run to use the VI in its configured mode. */
-  t = do_init(rx_ifindex, cfg_mode, &rx_vi, pkt_mem, pkt_mem_bytes);
+  if( cfg_shm_link )
+    t = do_init_shm(ping, &rx_vi, pkt_mem, pkt_mem_bytes);
+  else
+    t = do_init(rx_ifindex, cfg_mode, &rx_vi, pkt_mem, pkt_mem_bytes);
 
   if( tx_ifindex < 0 ) {
     tx_vi_ptr = &rx_vi;
@@ -911,6 +978,11 @@ int main(int argc, char* argv[])
   }
   if( ping && iters_run == 1 )
     printf("mean round-trip time: %.3lf usec\n", last_mean_latency_usec);
+  if( cfg_shm_link ) {
+    print_shm_stats(&rx_vi.vi);
+    ef_shm_vi_free(&rx_vi.vi);
+    ef_shm_memreg_fini(&rx_vi.memreg);
+  }
 
   return 0;
 }
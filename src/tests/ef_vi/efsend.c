@@ -21,6 +21,7 @@
 #include <etherfabric/pd.h>
 #include <etherfabric/memreg.h>
 #include <etherfabric/capabilities.h>
+#include <etherfabric/shm_vi.h>
 
 static int parse_opts(int argc, char* argv[]);
 
@@ -52,6 +53,7 @@ static int                cfg_disable_tx_push;
 static int                cfg_use_vf;
 static int                cfg_max_batch = 8192;
 static int                cfg_vlan = -1;
+static const char*        cfg_shm_link;
 static int                n_sent;
 static int                n_pushed;
 static int                ifindex;
@@ -129,10 +131,16 @@ int main(int argc, char* argv[])
   if( cfg_disable_tx_push )
     vi_flags |= EF_VI_TX_PUSH_DISABLE;
 
-  /* Intialize and configure hardware resources */
-  TRY(ef_driver_open(&dh));
-  TRY(ef_pd_alloc(&pd, dh, ifindex, pd_flags));
-  TRY(ef_vi_alloc_from_pd(&vi, dh, &pd, dh, -1, 0, -1, NULL, -1, vi_flags));
+  /* Intialize and configure hardware resources.  We send from end 0 of a
+   * shared-memory link; efsink listens on end 1. */
+  if( cfg_shm_link ) {
+    TRY(ef_shm_vi_alloc(&vi, cfg_shm_link, 0, NULL, 0, -1, vi_flags));
+  }
+  else {
+    TRY(ef_driver_open(&dh));
+    TRY(ef_pd_alloc(&pd, dh, ifindex, pd_flags));
+    TRY(ef_vi_alloc_from_pd(&vi, dh, &pd, dh, -1, 0, -1, NULL, -1, vi_flags));
+  }
 
   printf("txq_size=%d\n", ef_vi_transmit_capacity(&vi));
   printf("rxq_size=%d\n", ef_vi_receive_capacity(&vi));
@@ -141,7 +149,7 @@ int main(int argc, char* argv[])
          (vi.vi_out_flags & EF_VI_OUT_CLOCK_SYNC_STATUS) != 0);
 
   /* Allocate memory for packet buffers, note alignment */
-  if (cfg_phys_mode)
+  if (cfg_phys_mode || cfg_shm_link)
     min_page_size = CI_PAGE_SIZE;
   else
     TRY(ef_vi_capabilities_get(dh, ifindex, EF_VI_CAP_MIN_BUFFER_MODE_SIZE,
@@ -157,7 +165,10 @@ int main(int argc, char* argv[])
     TEST(posix_memalign(&p, min_page_size, alloc_size) == 0);
   }
   /* Regiser memory with NIC */
-  TRY(ef_memreg_alloc(&mr, dh, &pd, dh, p, alloc_size));
+  if( cfg_shm_link )
+    TRY(ef_shm_memreg_init(&mr, p, alloc_size));
+  else
+    TRY(ef_memreg_alloc(&mr, dh, &pd, dh, p, alloc_size));
   /* Store DMA address of the packet buffer memory */
   dma_buf_addr = ef_memreg_dma_addr(&mr, 0);
 
@@ -176,6 +187,14 @@ int main(int argc, char* argv[])
   TEST(n_pushed == cfg_iter);
 
   printf("Sent %d packets\n", cfg_iter);
+  if( cfg_shm_link ) {
+    struct ef_shm_vi_stats s;
+    ef_shm_vi_get_stats(&vi, &s);
+    printf("shm tx_pkts=%"PRIu64" tx_lost=%"PRIu64
+           " tx_link_full=%"PRIu64"\n", s.tx_pkts, s.tx_lost, s.tx_link_full);
+    ef_shm_memreg_fini(&mr);
+    ef_shm_vi_free(&vi);
+  }
   return 0;
 }
 
@@ -192,10 +211,13 @@ void usage(void)
   fprintf(stderr, "  -s                  - microseconds to sleep between batches\n");
   fprintf(stderr, "  -v                  - use a VF\n");
   fprintf(stderr, "  -V <vlan>           - vlan to send to (interface must have an IP)\n");
+  fprintf(stderr, "  -S <link-name>      - send over a shared-memory link, not a NIC\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "e.g.:\n");
   fprintf(stderr, "  - Send pkts to 239.1.2.3:1234 from eth2:\n"
           "          efsend eth2 239.1.2.3 1234\n");
+  fprintf(stderr, "  - Send pkts to 239.1.2.3:1234 for 'efsink -S lnk':\n"
+          "          efsend -S lnk 239.1.2.3 1234\n");
   exit(1);
 }
 
@@ -204,7 +226,7 @@ static int parse_opts(int argc, char *argv[])
 {
   int c;
 
-  while((c = getopt(argc, argv, "n:m:s:B:l:V:bptvx")) != -1)
+  while((c = getopt(argc, argv, "n:m:s:B:l:V:S:bptvx")) != -1)
     switch( c ) {
     case 'n':
       cfg_iter = atoi(optarg);
@@ -224,6 +246,9 @@ static int parse_opts(int argc, char *argv[])
     case 'V':
       cfg_vlan = atoi(optarg);
       break;
+    case 'S':
+      cfg_shm_link = optarg;
+      break;
     case 'b':
       cfg_loopback = 1;
       break;
@@ -246,8 +271,12 @@ static int parse_opts(int argc, char *argv[])
   argc -= optind;
   argv += optind;
 
-  if( argc != 3 )
+  if( argc != (cfg_shm_link ? 2 : 3) )
     usage();
+  if( cfg_shm_link && (cfg_loopback || cfg_phys_mode || cfg_use_vf) ) {
+    fprintf(stderr, "ERROR: -b, -p and -v need a NIC\n");
+    exit(1);
+  }
 
   if( cfg_payload_len > MAX_UDP_PAYLEN ) {
     fprintf(stderr, "WARNING: UDP payload length %d is larger than standard "
@@ -255,6 +284,6 @@ static int parse_opts(int argc, char *argv[])
   }
 
   /* Parse arguments after options */
-  parse_args(argv, &ifindex, cfg_local_port, cfg_vlan);
+  parse_args(argv, cfg_shm_link ? NULL : &ifindex, cfg_local_port, cfg_vlan);
   return 0;
 }
@@ -9,6 +9,8 @@
 #include "efsend_common.h"
 
 static uint8_t mcast_mac[6];
+/* Locally administered, for shared-memory links with no NIC behind them */
+static const uint8_t shm_mac[6] = { 0x02, 0, 0, 0, 0, 0x01 };
 static struct sockaddr_in sa_local, sa_mcast;
 
 int init_udp_pkt(void* pkt_buf, int paylen, ef_vi *vi,
@@ -34,7 +36,10 @@ int init_udp_pkt(void* pkt_buf, int paylen, ef_vi *vi,
     eth->ether_type = htons(0x0800);
   }
   memcpy(eth->ether_dhost, mcast_mac, 6);
-  ef_vi_get_mac(vi, dh, eth->ether_shost);
+  if( vi->nic_type.arch == EF_VI_ARCH_SHM )
+    memcpy(eth->ether_shost, shm_mac, 6);
+  else
+    ef_vi_get_mac(vi, dh, eth->ether_shost);
 
   ci_ip4_hdr_init(ip4, CI_NO_OPTS, ip_len, 0, IPPROTO_UDP,
 		  sa_local.sin_addr.s_addr,
@@ -49,6 +54,7 @@ void common_usage()
 {
   fprintf(stderr, "usage:\n");
   fprintf(stderr, "  efsend [options] <interface> <mcast-ip> <mcast-port>\n");
+  fprintf(stderr, "  efsend [options] -S <link-name> <mcast-ip> <mcast-port>\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "positionals:\n");
   fprintf(stderr, " <interface>     local interface for sends and receives\n");
@@ -70,23 +76,28 @@ void print_and_exit(char* format, ...) {
   exit(1);
 }
 
+/* [ifindex] is NULL when sending over a shared-memory link, in which case
+ * there's no <interface> and the local address is left unspecified.
+ */
 void parse_args(char *argv[], int *ifindex, int local_port, int vlan)
 {
   const char *interface, *mcast_ip;
   char* local_ip;
   int mcast_port;
 
-  interface = (argv++)[0];
+  interface = ifindex ? (argv++)[0] : NULL;
   mcast_ip = (argv++)[0];
   mcast_port = atoi(argv[0]);
 
-  get_ipaddr_of_vlan_intf(interface, vlan, &local_ip);
+  if( interface != NULL ) {
+    get_ipaddr_of_vlan_intf(interface, vlan, &local_ip);
 
-  if( ! parse_interface(interface, ifindex) )
-    print_and_exit("ERROR: Failed to parse interface %s\n", interface);
+    if( ! parse_interface(interface, ifindex) )
+      print_and_exit("ERROR: Failed to parse interface %s\n", interface);
 
-  if( ! parse_host(local_ip, &sa_local.sin_addr) )
-    print_and_exit("ERROR: Failed to parse local address %s\n", local_ip);
+    if( ! parse_host(local_ip, &sa_local.sin_addr) )
+      print_and_exit("ERROR: Failed to parse local address %s\n", local_ip);
+  }
   sa_local.sin_port = htons(local_port);
 
   if ( ! parse_host(mcast_ip, &sa_mcast.sin_addr) )
@@ -13,6 +13,7 @@
 #include <etherfabric/pd.h>
 #include <etherfabric/memreg.h>
 #include <etherfabric/efct_vi.h>
+#include <etherfabric/shm_vi.h>
 
 #include <poll.h>
 
@@ -99,6 +100,7 @@ static int cfg_max_fill = -1;
 static int cfg_exit_pkts = -1;
 static int cfg_register_mcast;
 static int cfg_discard = -1;
+static const char* cfg_shm_link;
 
 /* Mutex to protect printing from different threads */
 static pthread_mutex_t printf_mutex;
@@ -544,6 +546,7 @@ static __attribute__ ((__noreturn__)) void usage(void)
 {
   fprintf(stderr, "usage:\n");
   fprintf(stderr, "  efsink [options] <interface> [<filter-spec>...]\n");
+  fprintf(stderr, "  efsink [options] -S <link-name>\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "filter-spec:\n");
   fprintf(stderr, "  {udp|tcp}:[mcastloop-rx,][vid=<vlan>,]<local-host>:"
@@ -574,6 +577,8 @@ static __attribute__ ((__noreturn__)) void usage(void)
   fprintf(stderr, "  -j       join multicast ipv4 address mentioned in filter-spec\n");
   fprintf(stderr, "  -D <num> set specific discard mask. For specifics of possible discard masks,"
                               "look at the enum defined for ef_vi_rx_discard_err_flags.\n");
+  fprintf(stderr, "  -S <link-name> receive everything sent over a shared-memory\n");
+  fprintf(stderr, "           link (e.g. by 'efsend -S') instead of from a NIC\n");
   exit(1);
 }
 
@@ -587,7 +592,7 @@ int main(int argc, char* argv[])
   struct in_addr sa_mcast;
   int c, sock;
 
-  while( (c = getopt (argc, argv, "dtVL:vmbefF:n:jD:")) != -1 )
+  while( (c = getopt (argc, argv, "dtVL:vmbefF:n:jD:S:")) != -1 )
     switch( c ) {
     case 'd':
       cfg_hexdump = 1;
@@ -628,6 +633,9 @@ int main(int argc, char* argv[])
     case 'D':
       cfg_discard = strtol(optarg, NULL, 0);
       break;
+    case 'S':
+      cfg_shm_link = optarg;
+      break;
     case '?':
       usage();
     default:
@@ -642,10 +650,24 @@ int main(int argc, char* argv[])
 
   argc -= optind;
   argv += optind;
-  if( argc < 1 )
-    usage();
-  interface = argv[0];
-  ++argv; --argc;
+  if( cfg_shm_link ) {
+    /* The link has no filters: the other end's frames all come here */
+    if( argc != 0 )
+      usage();
+    if( cfg_timestamping || cfg_vport || cfg_monitor_vi_stats ||
+        cfg_rx_merge || cfg_eventq_wait || cfg_fd_wait ||
+        cfg_register_mcast || cfg_discard > -1 ) {
+      LOGE("ERROR: -t, -V, -m, -b, -e, -f, -j and -D need a NIC\n");
+      exit(1);
+    }
+    interface = NULL;
+  }
+  else {
+    if( argc < 1 )
+      usage();
+    interface = argv[0];
+    ++argv; --argc;
+  }
 
   TEST((res = calloc(1, sizeof(*res))) != NULL);
 
@@ -657,16 +679,26 @@ int main(int argc, char* argv[])
 
   pd_flags = EF_PD_DEFAULT;
 
-  /* Open driver and allocate a VI. */
-  TRY(ef_driver_open(&res->dh));
-  if( cfg_vport )
-    TRY(ef_pd_alloc_with_vport(&res->pd, res->dh, interface,
-                               pd_flags, cfg_vlan_id));
-  else
-    TRY(ef_pd_alloc_by_name(&res->pd, res->dh, interface, pd_flags));
+  /* Open driver and allocate a VI.  A shared-memory link needs neither;
+   * we take end 1, and efsend sends from end 0.  Frames are delivered
+   * after our pkt_buf header, so the buffer is shorter than the default.
+   */
+  if( cfg_shm_link ) {
+    TRY(ef_shm_vi_alloc(&res->vi, cfg_shm_link, 1, NULL, cfg_max_fill, 0,
+                        vi_flags));
+    ef_vi_receive_set_buffer_len(&res->vi, PKT_BUF_SIZE - RX_DMA_OFF);
+  }
+  else {
+    TRY(ef_driver_open(&res->dh));
+    if( cfg_vport )
+      TRY(ef_pd_alloc_with_vport(&res->pd, res->dh, interface,
+                                 pd_flags, cfg_vlan_id));
+    else
+      TRY(ef_pd_alloc_by_name(&res->pd, res->dh, interface, pd_flags));
 
-  TRY(ef_vi_alloc_from_pd(&res->vi, res->dh, &res->pd, res->dh,
-                          -1, cfg_max_fill, 0, NULL, -1, vi_flags));
+    TRY(ef_vi_alloc_from_pd(&res->vi, res->dh, &res->pd, res->dh,
+                            -1, cfg_max_fill, 0, NULL, -1, vi_flags));
+  }
 
   if ( cfg_discard > -1 )
     TRY(ef_vi_receive_set_discards(&res->vi, cfg_discard));
@@ -723,8 +755,11 @@ int main(int argc, char* argv[])
   }
 
   /* Register the memory so that the adapter can access it. */
-  TRY(ef_memreg_alloc(&res->memreg, res->dh, &res->pd, res->dh,
-                      res->pkt_bufs, alloc_size));
+  if( cfg_shm_link )
+    TRY(ef_shm_memreg_init(&res->memreg, res->pkt_bufs, alloc_size));
+  else
+    TRY(ef_memreg_alloc(&res->memreg, res->dh, &res->pd, res->dh,
+                        res->pkt_bufs, alloc_size));
   for( i = 0; i < res->pkt_bufs_n; ++i ) {
     struct pkt_buf* pkt_buf = pkt_buf_from_id(res, i);
     pkt_buf->ef_addr = ef_memreg_dma_addr(&res->memreg, i * PKT_BUF_SIZE);
@@ -1,7 +1,8 @@
 # SPDX-License-Identifier: BSD-2-Clause
 # X-SPDX-Copyright-Text: (c) Copyright 2002-2020 Xilinx, Inc.
 ifeq ($(GNU),1)
-SUBDIRS		:=     driver \
+SUBDIRS		:=     citools \
+                   driver \
                    ef_vi \
                    onload \
                    orm_test_client \
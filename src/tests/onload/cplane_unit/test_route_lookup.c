@@ -0,0 +1,319 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Checks the longest-prefix-match route lookup against a linear scan of
+ * the route table, and measures both.
+ *
+ * By default a random route table is generated.  A real route dump can be
+ * replayed instead by pointing CP_UNIT_ROUTE_DUMP at a file with one
+ * destination per line, e.g. the output of
+ *   ip -4 route show table main | awk '{print $1}'
+ * Lines which are not "default", "a.b.c.d" or "a.b.c.d/len" are ignored.
+ */
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <time.h>
+#include <libmnl/libmnl.h>
+
+#include "cplane_unit.h"
+#include <cplane/server.h>
+
+#include "../../tap/tap.h"
+
+
+static const int IFINDEX = 1;
+static const int N_ROUTES = 20000;
+static const int N_LOOKUPS = 20000;
+static const int N_CHURN = 200;
+
+struct test_route {
+  ci_addr_sh_t dst;
+  int prefix;
+  uint32_t metric;
+  uint8_t tos;
+};
+
+static struct test_route* routes;
+static int n_routes;
+
+
+static void
+route_msg(struct cp_session* s, int af, uint16_t type,
+          const struct test_route* r)
+{
+  struct nlmsghdr* nlh;
+  char buf[MNL_SOCKET_BUFFER_SIZE];
+  struct rtmsg* rtm;
+
+  nlh = mnl_nlmsg_put_header(buf);
+  nlh->nlmsg_type = type;
+
+  rtm = mnl_nlmsg_put_extra_header(nlh, sizeof(struct rtmsg));
+  rtm->rtm_family = af;
+  rtm->rtm_dst_len = r->prefix;
+  rtm->rtm_tos = r->tos;
+  rtm->rtm_protocol = RTPROT_STATIC;
+  rtm->rtm_table = RT_TABLE_MAIN;
+  rtm->rtm_type = RTN_UNICAST;
+  rtm->rtm_scope = RT_SCOPE_LINK;
+
+  if( r->prefix != 0 ) {
+    if( af == AF_INET )
+      mnl_attr_put_u32(nlh, RTA_DST, r->dst.ip4);
+    else
+      mnl_attr_put(nlh, RTA_DST, sizeof(r->dst.ip6), r->dst.ip6);
+  }
+  mnl_attr_put_u32(nlh, RTA_PRIORITY, r->metric);
+  mnl_attr_put_u32(nlh, RTA_OIF, IFINDEX);
+
+  cp_nl_net_handle_msg(s, nlh, nlh->nlmsg_len);
+}
+
+
+static ci_addr_sh_t random_addr(int af)
+{
+  ci_addr_sh_t a;
+  if( af == AF_INET ) {
+    a = CI_ADDR_SH_FROM_IP4(rand32());
+  }
+  else {
+    int i;
+    for( i = 0; i < 4; i++ )
+      a.u32[i] = rand32();
+    /* Keep the addresses in a handful of /16s, as real tables do. */
+    a.u16[0] = htons(0x2001);
+    a.u16[1] = htons(rand() & 3);
+  }
+  return a;
+}
+
+
+static void random_route(int af, struct test_route* r)
+{
+  int max = af == AF_INET ? 32 : 128;
+
+  /* Prefer BGP-ish prefix lengths, with some host routes. */
+  if( af == AF_INET )
+    r->prefix = (rand() & 7) == 0 ? 32 : 8 + rand() % 17;
+  else
+    r->prefix = (rand() & 7) == 0 ? 128 : 32 + rand() % 33;
+  r->dst = random_addr(af);
+  cp_addr_apply_pfx(&r->dst, r->prefix + (af == AF_INET ? 96 : 0));
+  if( af == AF_INET )
+    r->dst.ip4 = r->dst.ip4 ? r->dst.ip4 : htonl(0x0a000000);
+  r->metric = rand() & 3;
+  r->tos = (rand() & 3) == 0 ? 0x10 : 0;
+  ci_assert_le(r->prefix, max);
+}
+
+
+static int load_route_dump(const char* path)
+{
+  FILE* f = fopen(path, "r");
+  char line[256];
+
+  if( f == NULL )
+    return -1;
+  while( fgets(line, sizeof(line), f) != NULL ) {
+    struct test_route r = {};
+    char addr[64];
+    struct in_addr in;
+
+    if( sscanf(line, "%63s", addr) != 1 )
+      continue;
+    if( strcmp(addr, "default") == 0 ) {
+      r.dst = ip4_addr_sh_any;
+      r.prefix = 0;
+    }
+    else {
+      char* slash = strchr(addr, '/');
+      r.prefix = 32;
+      if( slash != NULL ) {
+        *slash = '\0';
+        r.prefix = atoi(slash + 1);
+      }
+      if( inet_pton(AF_INET, addr, &in) != 1 || r.prefix > 32 )
+        continue;
+      r.dst = CI_ADDR_SH_FROM_IP4(in.s_addr);
+    }
+    routes[n_routes++] = r;
+    if( n_routes == N_ROUTES )
+      break;
+  }
+  fclose(f);
+  return n_routes;
+}
+
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static struct cp_route_table* main_table(struct cp_session* s, int af)
+{
+  struct cp_route_table* table;
+  table = (af == AF_INET ? s->rt_table : s->rt6_table)
+                    [RT_TABLE_MAIN & (ROUTE_TABLE_HASH_SIZE - 1)];
+  while( table != NULL && table->id != RT_TABLE_MAIN )
+    table = table->next;
+  return table;
+}
+
+
+/* The original lookup: the first match in the sorted route list. */
+static struct cp_route*
+linear_lookup(struct cp_route_table* table, struct cp_fwd_key* key, int af)
+{
+  int i;
+  for( i = 0; i < table->routes.used; i++ ) {
+    struct cp_ip_with_prefix* ipp = cp_ippl_entry(&table->routes, i);
+    struct cp_route* route = CI_CONTAINER(struct cp_route, dst, ipp);
+    if( cp_ipx_ippl_pfx_match(af, key->dst, ipp->addr, ipp->prefix) &&
+        (route->tos == 0 || route->tos == key->tos) )
+      return route;
+  }
+  return NULL;
+}
+
+
+static void random_key(int af, struct cp_fwd_key* key)
+{
+  memset(key, 0, sizeof(*key));
+  /* Half of the lookups are inside a known route. */
+  if( (rand() & 1) && n_routes > 0 ) {
+    const struct test_route* r = &routes[rand() % n_routes];
+    ci_addr_sh_t a = random_addr(af);
+    int i;
+    ci_addr_sh_t m = cp_ip6_pfx2mask(r->prefix +
+                                     (af == AF_INET ? 96 : 0));
+    for( i = 0; i < 2; i++ )
+      key->dst.u64[i] = (r->dst.u64[i] & m.u64[i]) | (a.u64[i] & ~m.u64[i]);
+  }
+  else {
+    key->dst = random_addr(af);
+  }
+  key->tos = (rand() & 3) == 0 ? 0x10 : 0;
+}
+
+
+static int check_lookups(struct cp_session* s, int af, int n, bool timing)
+{
+  struct cp_route_table* table = main_table(s, af);
+  struct cp_fwd_key* keys = calloc(n, sizeof(*keys));
+  struct cp_route** expected = calloc(n, sizeof(*expected));
+  int i, mismatch = 0;
+  double t0, t1, t2;
+
+  CP_TEST(table != NULL);
+  for( i = 0; i < n; i++ )
+    random_key(af, &keys[i]);
+
+  t0 = now_ns();
+  for( i = 0; i < n; i++ )
+    expected[i] = linear_lookup(table, &keys[i], af);
+  t1 = now_ns();
+  for( i = 0; i < n; i++ )
+    if( cp_route_lookup(s, RT_TABLE_MAIN, &keys[i], af) != expected[i] )
+      mismatch++;
+  t2 = now_ns();
+
+  if( timing )
+    diag("%s: %d routes, %d lookups: linear %.0f ns/lookup, "
+         "trie %.0f ns/lookup (including rebuild)",
+         af == AF_INET ? "IPv4" : "IPv6", table->routes.used, n,
+         (t1 - t0) / n, (t2 - t1) / n);
+
+  free(keys);
+  free(expected);
+  return mismatch;
+}
+
+
+static void replay_dump(struct cp_session* s, int af)
+{
+  int i;
+  double t0 = now_ns();
+
+  cp_ipif_dump_start(s, af);
+  cp_rule_dump_start(s, af);
+  cp_rule_dump_done(s, af);
+  cp_route_dump_start(s, af);
+  s->state = af == AF_INET ? CP_DUMP_ROUTE : CP_DUMP_ROUTE6;
+  for( i = 0; i < n_routes; i++ )
+    route_msg(s, af, RTM_NEWROUTE, &routes[i]);
+  cp_route_dump_done(s, af);
+  cp_nl_dump_all_done(s);
+
+  diag("%s: replayed %d routes in %.1f ms", af == AF_INET ? "IPv4" : "IPv6",
+       n_routes, (now_ns() - t0) / 1e6);
+}
+
+
+static void test_af(struct cp_session* s, int af, const char* dump)
+{
+  int i;
+
+  n_routes = 0;
+  if( af == AF_INET && dump != NULL ) {
+    CP_TEST(load_route_dump(dump) >= 0);
+  }
+  else {
+    /* A default route first, so that most lookups succeed. */
+    routes[n_routes].dst = af == AF_INET ? ip4_addr_sh_any : addr_sh_any;
+    routes[n_routes++].prefix = 0;
+    while( n_routes < N_ROUTES )
+      random_route(af, &routes[n_routes++]);
+  }
+
+  replay_dump(s, af);
+  cmp_ok(check_lookups(s, af, N_LOOKUPS, true), "==", 0,
+         "%s lookups after dump", af == AF_INET ? "IPv4" : "IPv6");
+
+  /* Route flaps outside of a dump: the lookup must follow every change. */
+  int mismatch = 0;
+  for( i = 0; i < N_CHURN; i++ ) {
+    struct test_route* r = &routes[1 + rand() % (n_routes - 1)];
+    route_msg(s, af, RTM_DELROUTE, r);
+    mismatch += check_lookups(s, af, 16, false);
+    r->metric = rand() & 3;
+    route_msg(s, af, RTM_NEWROUTE, r);
+    mismatch += check_lookups(s, af, 16, false);
+  }
+  cmp_ok(mismatch, "==", 0, "%s lookups during route flaps",
+         af == AF_INET ? "IPv4" : "IPv6");
+}
+
+
+int main(void)
+{
+  cp_unit_init();
+  struct cp_session s;
+  const char* dump = getenv("CP_UNIT_ROUTE_DUMP");
+
+  srand(0x7e1e7e1e);
+  cp_unit_init_session(&s);
+
+  const char mac[] = {0x00, 0x0f, 0x53, 0x00, 0x00, 0x00};
+  cp_unit_nl_handle_link_msg(&s, RTM_NEWLINK, IFINDEX, "ethO0", mac);
+
+  routes = calloc(N_ROUTES, sizeof(*routes));
+  CP_TEST(routes != NULL);
+
+  plan(4);
+
+  test_af(&s, AF_INET, dump);
+  test_af(&s, AF_INET6, NULL);
+
+  diag("Trie rebuilds: %d, linear lookups: %d",
+       s.stats.route.trie_rebuild, s.stats.route.linear_lookup);
+
+  free(routes);
+  done_testing();
+}
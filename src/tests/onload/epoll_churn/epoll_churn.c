@@ -0,0 +1,168 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Measures the cost of epoll_ctl() on a large epoll set, as seen by
+ * applications that churn through many connections.
+ *
+ * Creates a number of UDP sockets, adds them all to one epoll set, and
+ * then times EPOLL_CTL_MOD, and EPOLL_CTL_DEL followed by EPOLL_CTL_ADD,
+ * on sockets picked at random.
+ *
+ * Run it under onload.  Sockets outside the epoll set's home stack are the
+ * interesting case; to get them, either spread the sockets over several
+ * stacks with -s (needs the onload extensions library), or use
+ * EF_UL_EPOLL=1, which has no home stack.
+ *
+ * Example:
+ *   $ EF_UL_EPOLL=1 onload ./epoll_churn -n 50000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#ifdef ONLOADEXT_AVAILABLE
+#include "onload/extensions.h"
+#endif
+
+
+#define TRY(x)                                                          \
+  do {                                                                  \
+    int __rc = (x);                                                     \
+    if( __rc < 0 ) {                                                    \
+      fprintf(stderr, "ERROR: %s failed at %s:%d (errno=%d %s)\n",      \
+              #x, __FILE__, __LINE__, errno, strerror(errno));          \
+      exit(1);                                                          \
+    }                                                                   \
+  } while( 0 )
+
+
+static int n_socks = 10000;
+static int n_stacks = 1;
+static long n_iters = 1000000;
+
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static void set_stack(int i)
+{
+#ifdef ONLOADEXT_AVAILABLE
+  char name[16];
+  snprintf(name, sizeof(name), "churn%d", i);
+  TRY(onload_set_stackname(ONLOAD_ALL_THREADS, ONLOAD_SCOPE_GLOBAL, name));
+#else
+  if( n_stacks > 1 ) {
+    fprintf(stderr, "ERROR: -s needs the onload extensions library\n");
+    exit(1);
+  }
+#endif
+}
+
+
+static void usage(void)
+{
+  fprintf(stderr, "usage:\n");
+  fprintf(stderr, "  epoll_churn [-n SOCKETS] [-s STACKS] [-i ITERATIONS]\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "options:\n");
+  fprintf(stderr, "  -n SOCKETS     - size of the epoll set\n");
+  fprintf(stderr, "  -s STACKS      - number of stacks to spread them over\n");
+  fprintf(stderr, "  -i ITERATIONS  - epoll_ctl() calls to time per test\n");
+  exit(1);
+}
+
+
+int main(int argc, char* argv[])
+{
+  struct epoll_event ev;
+  struct rlimit rl;
+  int* fds;
+  int epfd, i, c;
+  long it;
+  double t;
+
+  while( (c = getopt(argc, argv, "n:s:i:h")) != -1 )
+    switch( c ) {
+    case 'n':
+      n_socks = atoi(optarg);
+      break;
+    case 's':
+      n_stacks = atoi(optarg);
+      break;
+    case 'i':
+      n_iters = atol(optarg);
+      break;
+    default:
+      usage();
+    }
+  if( n_socks < 1 || n_stacks < 1 || n_iters < 1 )
+    usage();
+
+  TRY(getrlimit(RLIMIT_NOFILE, &rl));
+  if( rl.rlim_cur < (rlim_t) n_socks + 64 ) {
+    rl.rlim_cur = (rlim_t) n_socks + 64;
+    if( rl.rlim_max < rl.rlim_cur )
+      rl.rlim_max = rl.rlim_cur;
+    TRY(setrlimit(RLIMIT_NOFILE, &rl));
+  }
+
+  fds = malloc(n_socks * sizeof(*fds));
+  if( fds == NULL ) {
+    fprintf(stderr, "ERROR: out of memory\n");
+    return 1;
+  }
+
+  /* The epoll set's home stack is the stack of the first socket added, so
+   * with several stacks most of the sockets are not in it. */
+  TRY(epfd = epoll_create(1));
+  for( i = 0; i < n_socks; ++i ) {
+    if( i % (n_socks / n_stacks + 1) == 0 )
+      set_stack(i / (n_socks / n_stacks + 1));
+    TRY(fds[i] = socket(AF_INET, SOCK_DGRAM, 0));
+    ev.events = EPOLLIN;
+    ev.data.u32 = i;
+    TRY(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev));
+  }
+  printf("%d sockets in %d stack(s)\n", n_socks, n_stacks);
+
+  srand(0xe9011);
+  t = now_ns();
+  for( it = 0; it < n_iters; ++it ) {
+    i = rand() % n_socks;
+    ev.events = (it & 1) ? EPOLLIN : EPOLLIN | EPOLLOUT;
+    ev.data.u32 = i;
+    TRY(epoll_ctl(epfd, EPOLL_CTL_MOD, fds[i], &ev));
+  }
+  t = now_ns() - t;
+  printf("EPOLL_CTL_MOD:      %8.1f ns/call\n", t / n_iters);
+
+  t = now_ns();
+  for( it = 0; it < n_iters; ++it ) {
+    i = rand() % n_socks;
+    ev.events = EPOLLIN;
+    ev.data.u32 = i;
+    TRY(epoll_ctl(epfd, EPOLL_CTL_DEL, fds[i], &ev));
+    TRY(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev));
+  }
+  t = now_ns() - t;
+  printf("EPOLL_CTL_DEL+ADD:  %8.1f ns/call\n", t / (n_iters * 2));
+
+  for( i = 0; i < n_socks; ++i )
+    close(fds[i]);
+  close(epfd);
+  free(fds);
+  return 0;
+}
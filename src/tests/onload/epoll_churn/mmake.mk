@@ -0,0 +1,17 @@
+# SPDX-License-Identifier: BSD-2-Clause
+# X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc.
+TARGETS	:= epoll_churn
+
+ifneq ($(strip $(USEONLOADEXT)),)
+CFLAGS += -DONLOADEXT_AVAILABLE
+MMAKE_LIBS += $(LINK_ONLOAD_EXT_LIB)
+MMAKE_LIB_DEPS += $(ONLOAD_EXT_LIB_DEPEND)
+endif
+
+all: $(TARGETS)
+
+targets:
+	@echo $(TARGETS)
+
+clean:
+	@$(MakeClean)
@@ -8,6 +8,7 @@
 #include <etherfabric/memreg.h>
 #include <etherfabric/ef_vi.h>
 #include <etherfabric/checksum.h>
+#include <etherfabric/shm_vi.h>
 
 #include <stdbool.h>
 #include <net/ethernet.h>
@@ -50,6 +51,7 @@ struct efvi_endpoint {
   struct rtt_endpoint  ep;
   bool                 mcast;
   unsigned             dirs;
+  bool                 shm;
 
   struct vi            tx_vi;
   struct vi            rx_vi;
@@ -382,6 +384,49 @@ static void init_vi(struct vi* vi, const char* interface,
 }
 
 
+/* A shared-memory link is one-to-one, so each direction gets a link of its
+ * own: end [shm_end] sends on "LINK.<shm_end>" and receives on the other
+ * end's.  Only the VI's own end of each link is used.
+ */
+static void init_shm_vi(struct vi* vi, const char* shm_link, unsigned shm_end,
+                        unsigned n_bufs, bool for_tx, bool tx_ctpio,
+                        bool nopoison)
+{
+  char link_name[256];
+
+  vi->posted = 0;
+  vi->completed = 0;
+  vi->ctpio_ok = 0;
+  vi->ctpio_ok_total = 0;
+
+  unsigned vi_flags = 0;
+  if( tx_ctpio ) {
+    vi_flags |= EF_VI_TX_CTPIO;
+    if( nopoison )
+      vi_flags |= EF_VI_TX_CTPIO_NO_POISON;
+  }
+
+  snprintf(link_name, sizeof(link_name), "%s.%u", shm_link,
+           for_tx ? shm_end : ! shm_end);
+  RTT_TRY( ef_shm_vi_alloc(&(vi->vi), link_name, for_tx ? 0 : 1, NULL,
+                           for_tx ? 0 : n_bufs, for_tx ? -1 : 0, vi_flags) );
+  ef_vi_receive_set_buffer_len(&(vi->vi),
+                               BUF_SIZE - offsetof(struct pkt_buf, payload));
+
+  size_t bytes = n_bufs * BUF_SIZE;
+  void* p;
+  RTT_TEST( posix_memalign(&p, 4096, bytes) == 0 );
+  RTT_TRY( ef_shm_memreg_init(&(vi->memreg), p, bytes) );
+  vi->bufs = p;
+  vi->num_bufs = n_bufs;
+  unsigned i;
+  for( i = 0; i < n_bufs; ++i ) {
+    struct pkt_buf* pb = PKT_BUF(vi, i);
+    pb->dma_addr = ef_memreg_dma_addr(&(vi->memreg), pb->payload - vi->bufs);
+  }
+}
+
+
 static void efvi_cleanup(struct rtt_endpoint* ep)
 {
   struct efvi_endpoint* eep = EFVI_ENDPOINT(ep);
@@ -389,6 +434,12 @@ static void efvi_cleanup(struct rtt_endpoint* ep)
     unsigned alt_id = (eep->tx.alt.send)++ % N_TX_ALT;
     RTT_TRY( ef_vi_transmit_alt_discard(&(eep->tx_vi.vi), alt_id) );
   }
+  if( eep->shm ) {
+    if( eep->dirs & RTT_DIR_RX )
+      ef_shm_vi_free(&(eep->rx_vi.vi));
+    if( eep->dirs & RTT_DIR_TX )
+      ef_shm_vi_free(&(eep->tx_vi.vi));
+  }
 }
 
 
@@ -482,6 +533,8 @@ int rtt_efvi_build_endpoint(struct rtt_endpoint** ep_out,
   bool tx_pio = false, tx_alt = false, tx_ctpio = false;
   const char* interface = NULL;
   const char* file_path = NULL;
+  const char* shm_link = NULL;
+  unsigned shm_end = 0;
   unsigned u;
   char dummy;
 
@@ -498,6 +551,8 @@ int rtt_efvi_build_endpoint(struct rtt_endpoint** ep_out,
     const char* arg = args[arg_i];
     if( ! strcmp(arg, "help") ) {
       fprintf(stdout, "  intf=INTERFACE       - Ethernet interface name\n");
+      fprintf(stdout, "  shm=LINK             - shared-memory link, not a NIC\n");
+      fprintf(stdout, "    shm_end=0|1        - this side's end of the link\n");
       fprintf(stdout, "  file=FILE_PATH       - file path of binary frame\n");
       fprintf(stdout, "  tx=dma               - DMA transmit\n");
       fprintf(stdout, "  tx=ctpio             - CTPIO transmit\n");
@@ -546,6 +601,11 @@ int rtt_efvi_build_endpoint(struct rtt_endpoint** ep_out,
     }
     else if( match_prefix(arg, "file=", &file_path) ) {
     }
+    else if( match_prefix(arg, "shm=", &shm_link) ) {
+    }
+    else if( sscanf(arg, "shm_end=%u%c", &u, &dummy) == 1 && u <= 1 ) {
+      shm_end = u;
+    }
     else if( sscanf(arg, "rx_max_fill=%u%c", &u, &dummy) == 1 ||
              /* old name also accepted for compatibility */
              sscanf(arg, "n_rx_bufs=%u%c", &u, &dummy) == 1 ) {
@@ -556,19 +616,31 @@ int rtt_efvi_build_endpoint(struct rtt_endpoint** ep_out,
     }
   }
 
-  if( interface == NULL )
-    return rtt_err("ERROR: no intf= given for efvi:\n");
+  if( interface == NULL && shm_link == NULL )
+    return rtt_err("ERROR: no intf= or shm= given for efvi:\n");
+  if( interface != NULL && shm_link != NULL )
+    return rtt_err("ERROR: intf= and shm= are exclusive\n");
+  if( shm_link != NULL && (tx_pio || tx_alt) )
+    return rtt_err("ERROR: shm= supports tx=dma and tx=ctpio only\n");
+  eep->shm = shm_link != NULL;
   if( tx_ctpio && eep->tx.ctpio.thresh == 0 )
     eep->tx.ctpio.thresh = EF_VI_CTPIO_CT_THRESHOLD_SNF;
 
   if( dirs & RTT_DIR_RX ) {
     eep->ep.pong = efvi_pong;
-    init_vi(&(eep->rx_vi), interface, eep->rx_max_fill, false, false,
-            false, false, false);
-    if( file_path != NULL )
-      vi_filter_packet_by_mac_dest(&(eep->rx_vi), file_path);
-    else
-      vi_filter_udp_full(&(eep->rx_vi), eep->mcast);
+    if( eep->shm ) {
+      /* No filters: everything sent over the link is ours */
+      init_shm_vi(&(eep->rx_vi), shm_link, shm_end, eep->rx_max_fill, false,
+                  false, false);
+    }
+    else {
+      init_vi(&(eep->rx_vi), interface, eep->rx_max_fill, false, false,
+              false, false, false);
+      if( file_path != NULL )
+        vi_filter_packet_by_mac_dest(&(eep->rx_vi), file_path);
+      else
+        vi_filter_udp_full(&(eep->rx_vi), eep->mcast);
+    }
 
     rx_fill(&(eep->rx_vi));
   }
@@ -576,8 +648,12 @@ int rtt_efvi_build_endpoint(struct rtt_endpoint** ep_out,
   if( dirs & RTT_DIR_TX ) {
     if( eep->ep.ping == NULL )
       return rtt_err("ERROR: TX mode not given (eg. tx=dma)\n");
-    init_vi(&(eep->tx_vi), interface, 1, true, tx_alt, tx_pio, tx_ctpio,
-            (tx_ctpio) ? eep->tx.ctpio.nopoison : false);
+    if( eep->shm )
+      init_shm_vi(&(eep->tx_vi), shm_link, shm_end, 1, true, tx_ctpio,
+                  (tx_ctpio) ? eep->tx.ctpio.nopoison : false);
+    else
+      init_vi(&(eep->tx_vi), interface, 1, true, tx_alt, tx_pio, tx_ctpio,
+              (tx_ctpio) ? eep->tx.ctpio.nopoison : false);
 
     struct pkt_buf* tx_buf = PKT_BUF(&(eep->tx_vi), 0);
     eep->tx_buf = tx_buf->payload;
@@ -0,0 +1,246 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <etherfabric/ef_vi.h>
+#include <etherfabric/shm_vi.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#define FRAME_LEN 60
+#define N_BUFS    32
+/* More than twice round the link's ring */
+#define N_WRAP    3000
+/* The number of frames the link holds */
+#define WIRE_FRAMES 1024
+
+
+/* Dependencies */
+/* The other architectures' VIs, which ef_vi_init() may call */
+void ef10_vi_init(ef_vi* vi);
+void ef100_vi_init(ef_vi* vi);
+void efct_vi_init(ef_vi* vi);
+void efxdp_vi_init(ef_vi* vi);
+
+void ef10_vi_init(ef_vi* vi)
+{
+  CHECK_TRUE(0);
+}
+
+void ef100_vi_init(ef_vi* vi)
+{
+  CHECK_TRUE(0);
+}
+
+void efct_vi_init(ef_vi* vi)
+{
+  CHECK_TRUE(0);
+}
+
+void efxdp_vi_init(ef_vi* vi)
+{
+  CHECK_TRUE(0);
+}
+
+
+static char link_name[64];
+static ef_vi a, b;
+static uint8_t tx_frame[FRAME_LEN];
+static uint8_t rx_bufs[N_BUFS][EF_SHM_VI_MAX_FRAME];
+
+
+static void setup(int rxq_cap, int txq_cap)
+{
+  struct ef_shm_attr attr = {};
+  int rc;
+
+  snprintf(link_name, sizeof(link_name), "/unit_shm_vi.%d", (int) getpid());
+  rc = ef_shm_vi_alloc(&a, link_name, 0, &attr, rxq_cap, txq_cap, 0);
+  CHECK(rc, ==, 0);
+  rc = ef_shm_vi_alloc(&b, link_name, 1, &attr, rxq_cap, txq_cap, 0);
+  CHECK(rc, ==, 0);
+}
+
+
+static void teardown(void)
+{
+  ef_shm_vi_free(&a);
+  ef_shm_vi_free(&b);
+}
+
+
+static int send_frame(ef_vi* vi, uint32_t seq)
+{
+  memcpy(tx_frame, &seq, sizeof(seq));
+  return ef_vi_transmit(vi, (uintptr_t) tx_frame, FRAME_LEN, seq);
+}
+
+
+/* The desc_id of a TX completion is where the next one will start, so a
+ * completion must not report the descriptor it names.
+ */
+static void test_tx_complete_exclusive(void)
+{
+  ef_request_id ids[EF_VI_TRANSMIT_BATCH];
+  ef_event evs[8];
+  int i, n, rc;
+
+  setup(-1, 255);
+  for( i = 0; i < 100; ++i ) {
+    rc = send_frame(&a, i);
+    CHECK(rc, ==, 0);
+  }
+
+  n = ef_eventq_poll(&a, evs, 8);
+  CHECK(n, ==, 2);
+  CHECK(EF_EVENT_TYPE(evs[0]), ==, EF_EVENT_TYPE_TX);
+  CHECK(evs[0].tx.desc_id, ==, EF_VI_TRANSMIT_BATCH);
+  CHECK(EF_EVENT_TYPE(evs[1]), ==, EF_EVENT_TYPE_TX);
+  CHECK(evs[1].tx.desc_id, ==, 100);
+
+  n = ef_vi_transmit_unbundle(&a, &evs[0], ids);
+  CHECK(n, ==, EF_VI_TRANSMIT_BATCH);
+  CHECK(ids[0], ==, 0);
+  CHECK(ids[n - 1], ==, EF_VI_TRANSMIT_BATCH - 1);
+  CHECK(a.ep_state->txq.removed, ==, EF_VI_TRANSMIT_BATCH);
+  CHECK(a.vi_txq.ids[EF_VI_TRANSMIT_BATCH], ==, EF_VI_TRANSMIT_BATCH);
+
+  n = ef_vi_transmit_unbundle(&a, &evs[1], ids);
+  CHECK(n, ==, 100 - EF_VI_TRANSMIT_BATCH);
+  CHECK(ids[0], ==, EF_VI_TRANSMIT_BATCH);
+  CHECK(ids[n - 1], ==, 99);
+  CHECK(a.ep_state->txq.removed, ==, 100);
+
+  /* Nothing more to complete */
+  n = ef_eventq_poll(&a, evs, 8);
+  CHECK(n, ==, 0);
+  teardown();
+}
+
+
+/* Both the TX descriptor ring and the link's ring go round several times */
+static void test_ring_wrap(void)
+{
+  ef_request_id ids[EF_VI_TRANSMIT_BATCH];
+  struct ef_shm_vi_stats stats;
+  ef_event evs[16];
+  uint32_t sent = 0, rcvd = 0, completed = 0, posted = 0;
+  int i, n, rc;
+
+  setup(15, 7);
+  while( rcvd < N_WRAP ) {
+    while( posted - rcvd < 15 ) {
+      rc = ef_vi_receive_post(&b, (uintptr_t) rx_bufs[posted % N_BUFS],
+                              posted);
+      CHECK(rc, ==, 0);
+      ++posted;
+    }
+    while( sent < N_WRAP && sent - completed < 7 ) {
+      rc = send_frame(&a, sent);
+      CHECK(rc, ==, 0);
+      ++sent;
+    }
+    /* The TX ring is full */
+    if( sent < N_WRAP ) {
+      rc = send_frame(&a, sent);
+      CHECK(rc, ==, -EAGAIN);
+    }
+
+    n = ef_eventq_poll(&a, evs, 16);
+    for( i = 0; i < n; ++i ) {
+      int j, n_ids;
+      CHECK(EF_EVENT_TYPE(evs[i]), ==, EF_EVENT_TYPE_TX);
+      n_ids = ef_vi_transmit_unbundle(&a, &evs[i], ids);
+      for( j = 0; j < n_ids; ++j, ++completed )
+        CHECK(ids[j], ==, completed);
+    }
+    CHECK(completed, ==, sent);
+
+    n = ef_eventq_poll(&b, evs, 16);
+    for( i = 0; i < n; ++i ) {
+      uint32_t seq;
+      CHECK(EF_EVENT_TYPE(evs[i]), ==, EF_EVENT_TYPE_RX);
+      CHECK(EF_EVENT_RX_RQ_ID(evs[i]), ==, rcvd);
+      CHECK(EF_EVENT_RX_BYTES(evs[i]), ==, FRAME_LEN);
+      memcpy(&seq, rx_bufs[rcvd % N_BUFS], sizeof(seq));
+      CHECK(seq, ==, rcvd);
+      ++rcvd;
+    }
+    CHECK(rcvd, ==, sent);
+  }
+
+  ef_shm_vi_get_stats(&a, &stats);
+  CHECK(stats.tx_pkts, ==, N_WRAP);
+  CHECK(stats.tx_link_full, ==, 0);
+  ef_shm_vi_get_stats(&b, &stats);
+  CHECK(stats.rx_pkts, ==, N_WRAP);
+  CHECK(stats.rx_no_desc, ==, 0);
+  teardown();
+}
+
+
+/* A full link drops what it can't hold, and the rest still arrives in
+ * order after the receiver catches up.
+ */
+static void test_link_full(void)
+{
+  ef_request_id ids[EF_VI_TRANSMIT_BATCH];
+  struct ef_shm_vi_stats stats;
+  ef_event evs[16];
+  uint32_t rcvd = 0;
+  int i, n, rc;
+
+  setup(N_BUFS - 1, 2047);
+  for( i = 0; i < WIRE_FRAMES + 2; ++i ) {
+    rc = send_frame(&a, i);
+    CHECK(rc, ==, 0);
+  }
+  ef_shm_vi_get_stats(&a, &stats);
+  CHECK(stats.tx_pkts, ==, WIRE_FRAMES);
+  CHECK(stats.tx_link_full, ==, 2);
+
+  /* Dropped frames are still completed */
+  while( (n = ef_eventq_poll(&a, evs, 16)) > 0 )
+    for( i = 0; i < n; ++i )
+      ef_vi_transmit_unbundle(&a, &evs[i], ids);
+  CHECK(a.ep_state->txq.removed, ==, WIRE_FRAMES + 2);
+
+  while( rcvd < WIRE_FRAMES ) {
+    for( i = 0; i < 16; ++i ) {
+      rc = ef_vi_receive_post(&b, (uintptr_t) rx_bufs[i], rcvd + i);
+      CHECK(rc, ==, 0);
+    }
+    n = ef_eventq_poll(&b, evs, 16);
+    CHECK(n, ==, 16);
+    for( i = 0; i < n; ++i ) {
+      uint32_t seq;
+      CHECK(EF_EVENT_RX_RQ_ID(evs[i]), ==, rcvd);
+      memcpy(&seq, rx_bufs[i], sizeof(seq));
+      CHECK(seq, ==, rcvd);
+      ++rcvd;
+    }
+  }
+
+  /* With room again, the link carries frames */
+  rc = send_frame(&a, WIRE_FRAMES);
+  CHECK(rc, ==, 0);
+  ef_shm_vi_get_stats(&a, &stats);
+  CHECK(stats.tx_pkts, ==, WIRE_FRAMES + 1);
+  teardown();
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_tx_complete_exclusive);
+  TEST_RUN(test_ring_wrap);
+  TEST_RUN(test_link_full);
+  TEST_END();
+}
@@ -11,7 +11,15 @@ UNIT_TEST_WRAPPER ?=
 
 # All the tests that can be run. Can be filtered using UNIT_TEST_FILTER.
 # In principle, this could be autogenerated by searching the source directory.
-ALL_UNIT_TESTS := transport/ip/tcp_rx transport/ip/tcp_tx
+ALL_UNIT_TESTS := transport/ip/tcp_rx transport/ip/tcp_tx transport/ip/tcp_cong \
+                  transport/ip/tcpdump_bpf transport/ip/lat_hist \
+                  transport/ip/tcp_rack transport/ip/lock_prof \
+                  transport/ip/spin_adapt transport/ip/iptimer \
+                  transport/ip/udp_recv transport/ip/tcp_fastopen \
+                  transport/ip/udp_gso transport/ip/udp_reuseport \
+                  ciul/shm_vi transport/unix/tcp_accept_batch \
+                  transport/unix/poll_timeout transport/unix/uring_intercept \
+                  tools/onload_remote_monitor/orm_openmetrics
 
 # The tests to be run, and their corresponding files
 TESTS := $(filter $(UNIT_TEST_FILTER)%, $(ALL_UNIT_TESTS))
@@ -19,15 +27,67 @@ TARGETS := $(TESTS:%=$(AppPattern))
 OBJECTS := $(TESTS:%=%.o)
 PASSED := $(TESTS:%=%.passed)
 
+# Benchmarks are built with the tests, but only run by "make bench". Options
+# can be passed with UNIT_BENCH_ARGS, e.g. UNIT_BENCH_ARGS="1000000 10".
+ALL_UNIT_BENCHMARKS := transport/ip/tcp_bench transport/ip/udp_send_bench
+UNIT_BENCH_ARGS ?=
+BENCHMARKS := $(filter $(UNIT_TEST_FILTER)%, $(ALL_UNIT_BENCHMARKS))
+BENCH_TARGETS := $(BENCHMARKS:%=$(AppPattern))
+OBJECTS += $(BENCHMARKS:%=%.o)
+
+# Library objects linked with each test or benchmark, where it needs more than
+# the one it's named after.  Test helpers in this directory can be listed too.
+transport/ip/tcp_cong_LIBS := transport/ip/tcp_cong unit_netif
+transport/ip/tcpdump_bpf_LIBS := transport/ip/tcpdump_bpf unit_netif
+transport/ip/lat_hist_LIBS := transport/ip/lat_hist unit_netif
+transport/ip/tcp_rack_LIBS := transport/ip/tcp_rack unit_netif
+transport/ip/lock_prof_LIBS := transport/ip/lock_prof unit_netif
+transport/ip/iptimer_LIBS := transport/ip/iptimer unit_netif
+transport/ip/udp_recv_LIBS := transport/ip/udp_recv unit_netif
+transport/ip/spin_adapt_LIBS := transport/ip/spin_adapt unit_netif
+transport/ip/tcp_fastopen_LIBS := transport/ip/tcp_syncookie \
+                                 transport/ip/tcp_tx_reformat \
+                                 transport/ip/iptimer unit_netif
+transport/ip/udp_gso_LIBS := transport/ip/udp_send transport/ip/udp_recv \
+                            transport/ip/pkt_filler transport/ip/ip_cmsg \
+                            unit_netif
+transport/ip/udp_reuseport_LIBS := transport/ip/udp_reuseport \
+                                  transport/ip/udp_rx \
+                                  transport/ip/tcpdump_bpf unit_netif
+ciul/shm_vi_LIBS := ciul/shm_vi ciul/vi_init ciul/pt_tx ciul/pt_rx \
+                     ciul/logging
+transport/unix/tcp_accept_batch_LIBS := transport/unix/tcp_fd unit_netif
+transport/unix/poll_timeout_LIBS := transport/unix/sockcall_intercept
+tools/onload_remote_monitor/orm_openmetrics_LIBS := \
+  tools/onload_remote_monitor/orm_openmetrics unit_netif
+transport/ip/tcp_bench_LIBS := transport/ip/tcp_rx transport/ip/tcp_misc \
+                              transport/ip/iptimer transport/ip/tcp_rack
+transport/ip/udp_send_bench_LIBS := transport/ip/netif transport/ip/udp_misc
+
 # Library objects names are mangled with a prefix. Deal with that madness here.
-LIB_PREFIXES := transport/common/ci_tp_common_ transport/ip/ci_ip_
+# Objects from tools are not, and live in their own tree.
+LIB_PREFIXES := transport/common/ci_tp_common_ transport/ip/ci_ip_ \
+                transport/unix/ci_tp_unix_ ciul/ci_ul_
 lib_prefix = $(notdir $(filter $(dir $(1))%,$(LIB_PREFIXES)))
-lib_object = ../../lib/$(dir $(1))$(call lib_prefix,$(1))$(notdir $(1)).o
+UNIT_HELPERS := unit_netif
+lib_object = $(if $(filter $(1),$(UNIT_HELPERS)),$(1).o,\
+               $(if $(filter tools/%,$(1)),../../$(1).o,\
+               ../../lib/$(dir $(1))$(call lib_prefix,$(1))$(notdir $(1)).o))
+lib_objects = $(foreach o,$(or $($(1)_LIBS),$(1)),$(call lib_object,$(o)))
+
+# Tests of the preload library need its private headers
+transport/unix/%.o: MMAKE_CFLAGS += -I$(TOPPATH)/src/lib/transport/unix
+tools/onload_remote_monitor/%.o: MMAKE_CFLAGS += \
+  -I$(TOPPATH)/src/tools/onload_remote_monitor
 
 # TODO can we rely on a sufficiently up-to-date version of make?
 .SECONDEXPANSION:
 
-all: $(PASSED)
+all: $(PASSED) $(BENCH_TARGETS)
+
+.PHONY: bench
+bench: $(BENCH_TARGETS)
+	@for b in $^; do $(UNIT_TEST_WRAPPER) ./$$b $(UNIT_BENCH_ARGS) || exit; done
 
 # Sentinel files indicate that a test has passed. The test only needs to be
 # run again if the sentinel is out of date.
@@ -48,7 +108,8 @@ $(OBJECTS): % : $$(@D)/.unit_test_dir
 # be rebuilt if out of date. A top-level build is needed to make sure it's up
 # to date before building the tests. This sadly means we can't reliably run an
 # invididual test without waiting for several seconds of flappery first.
-$(TARGETS): MMAKE_DIR_LINKFLAGS += -Wl,--unresolved-symbols=ignore-all -no-pie
-$(TARGETS): %: %.o $$(call lib_object,$$@) stubs.o
+$(TARGETS) $(BENCH_TARGETS): MMAKE_DIR_LINKFLAGS += \
+  -Wl,--unresolved-symbols=ignore-all -no-pie
+$(TARGETS) $(BENCH_TARGETS): %: %.o $$(call lib_objects,$$@) stubs.o
 	$(MMakeLinkCApp)
 
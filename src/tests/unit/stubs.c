@@ -4,13 +4,35 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <poll.h>
+#include <sys/socket.h>
 
 /* Resolve references to global variables */
 __attribute__ ((weak)) unsigned ci_tp_log = 0;
 __attribute__ ((weak)) unsigned ci_tp_max_dump = 0;
 __attribute__ ((weak)) void (*ci_log_fn)(const char* msg) = NULL;
 __attribute__ ((weak)) int  (*ci_sys_ioctl)(int, long unsigned int, ...) = NULL;
+__attribute__ ((weak)) int  (*ci_sys_poll)(struct pollfd*, nfds_t, int) = NULL;
+__attribute__ ((weak)) int  (*ci_sys_bind)(int, const struct sockaddr*,
+                                           socklen_t) = NULL;
+__attribute__ ((weak)) int  (*ci_sys_getsockname)(int, struct sockaddr*,
+                                                  socklen_t*) = NULL;
+__attribute__ ((weak)) int  (*ci_sys_connect)(int, const struct sockaddr*,
+                                              socklen_t) = NULL;
+__attribute__ ((weak)) int  (*ci_sys_fcntl)(int, int, ...) = NULL;
+__attribute__ ((weak)) int  (*ci_sys_close)(int) = NULL;
+__attribute__ ((weak)) void (*ci_fail_stop_fn)(void) = abort;
 
 /* Allow the unit under test to call ci_log (with no effect) */
 __attribute__ ((weak)) void ci_log(const char* fmt, ...) {}
 
+/* Report failed assertions in the unit under test */
+__attribute__ ((weak)) void __ci_fail(const char* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+  abort();
+}
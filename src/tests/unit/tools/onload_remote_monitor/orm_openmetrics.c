@@ -0,0 +1,411 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <stdio.h>
+#include <stdbool.h>
+#include "orm_openmetrics.h"
+
+#include <onload/ioctl.h>
+#include <onload/debug_intf.h>
+#include <stdarg.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_netif.h"
+
+/* The fd that the stubbed open() gives for the driver */
+#define DEV_FD     1000
+#define N_STACKS   2
+#define N_SOCKS    2
+#define VERSION    "9.9.9"
+
+/* The labels of each stack, with its name escaped */
+#define LABELS_0   "stack=\"0\",stack_name=\"alpha\""
+#define LABELS_3   "stack=\"3\",stack_name=\"b\\\"e\\\\ta\""
+
+
+static const int stack_ids[N_STACKS] = { 0, 3 };
+static ci_netif* stacks[N_STACKS];
+static int n_dtor;
+
+
+/* Dependencies */
+const char* onload_version = VERSION;
+
+int open(const char* path, int flags, ...)
+{
+  CHECK(strcmp(path, "/dev/onload"), ==, 0);
+  return DEV_FD;
+}
+
+/* Lists the stacks in [stack_ids], as the driver would */
+int ioctl(int fd, unsigned long req, ...)
+{
+  ci_netif_info_t* info;
+  va_list args;
+  int i;
+
+  va_start(args, req);
+  info = va_arg(args, ci_netif_info_t*);
+  va_end(args);
+
+  CHECK(fd, ==, DEV_FD);
+  CHECK((unsigned) req, ==, (unsigned) OO_IOC_DBG_GET_STACK_INFO);
+  CHECK(info->ni_subop, ==, CI_DBG_NETIF_INFO_GET_NEXT_NETIF);
+
+  info->ni_exists = 0;
+  info->u.ni_next_ni.index = -1;
+  for( i = 0; i < N_STACKS; ++i ) {
+    if( stack_ids[i] == info->ni_index )
+      info->ni_exists = 1;
+    if( stack_ids[i] > info->ni_index ) {
+      info->u.ni_next_ni.index = stack_ids[i];
+      break;
+    }
+  }
+  return 0;
+}
+
+int ci_netif_restore_id(ci_netif* ni, unsigned stack_id, bool is_service)
+{
+  int i;
+
+  for( i = 0; i < N_STACKS; ++i )
+    if( stack_ids[i] == stack_id ) {
+      *ni = *stacks[i];
+      return 0;
+    }
+  return -ENOENT;
+}
+
+int ci_netif_dtor(ci_netif* ni)
+{
+  ++n_dtor;
+  return 0;
+}
+
+
+static citp_waitable_obj* sock(ci_netif* ni, int i)
+{
+  return (citp_waitable_obj*) oo_sockp_to_ptr(ni, OO_SP_FROM_INT(ni, i));
+}
+
+
+/* Stack 0 has a TCP and a UDP socket and a latency histogram.  Stack 3 has
+ * no sockets, and a name that needs escaping.
+ */
+static void setup(void)
+{
+  unsigned ep_ofs = CI_ROUND_UP(sizeof(ci_netif_state), CI_PAGE_SIZE);
+  ci_netif* ni;
+
+  ni = stacks[0] = unit_netif_alloc_extra(0, ep_ofs -
+                                             sizeof(ci_netif_state) +
+                                             N_SOCKS * EP_BUF_SIZE);
+  *(ci_uint32*) &ni->state->ep_ofs = ep_ofs;
+  *(ci_uint32*) &ni->state->n_ep_bufs = N_SOCKS;
+  strcpy(ni->state->name, "alpha");
+  ni->state->stats.rx_evs = 7;
+  ni->state->stats.table_n_entries = 5;
+  ni->state->stats_snapshot.tcp.tcp_active_opens = 11;
+
+  sock(ni, 0)->waitable.state = CI_TCP_ESTABLISHED;
+  sock(ni, 0)->tcp.stats.rx_pkts = 21;
+  sock(ni, 1)->waitable.state = CI_TCP_STATE_UDP;
+  sock(ni, 1)->udp.stats.n_rx_os = 6;
+  sock(ni, 1)->udp.stats.max_recvq_pkts = 3;
+
+  /* Two of 3 cycles and one off the end, taking a second in all */
+  ni->state->opts.latency_hist = 1;
+  ni->state->lat_rx_to_app.bucket[3] = 2;
+  ni->state->lat_rx_to_app.bucket[OO_LAT_HIST_N_BUCKETS - 1] = 1;
+  ni->state->lat_rx_to_app.sum = UNIT_NETIF_KHZ * 1000ull;
+
+  ni = stacks[1] = unit_netif_alloc(0);
+  strcpy(ni->state->name, "b\"e\\ta");
+  ni->state->stats.rx_evs = 9;
+  ni->state->stats.table_n_entries = 1;
+  ni->state->stats_snapshot.tcp.tcp_active_opens = 13;
+  ni->state->lat_rx_to_app.bucket[3] = 4;
+}
+
+
+static void teardown(void)
+{
+  int i;
+
+  for( i = 0; i < N_STACKS; ++i )
+    unit_netif_free(stacks[i]);
+}
+
+
+/* Returns the exposition as the exporter serves it, with the sockets part
+ * and EOF line only if asked for.
+ */
+static char* dump(bool sockets, bool per_socket, bool eof)
+{
+  struct orm_om_state* st;
+  char* buf = NULL;
+  size_t len = 0;
+  FILE* f;
+  int rc;
+
+  n_dtor = 0;
+  st = orm_om_alloc(NULL);
+  CHECK_TRUE(st != NULL);
+  rc = orm_om_map_stacks(st);
+  CHECK(rc, ==, 0);
+
+  f = open_memstream(&buf, &len);
+  CHECK_TRUE(f != NULL);
+  rc = orm_om_dump_stacks(st, f);
+  CHECK(rc, ==, 0);
+  if( sockets ) {
+    rc = orm_om_dump_sockets(st, f, per_socket);
+    CHECK(rc, ==, 0);
+  }
+  if( eof )
+    fputs(orm_om_eof, f);
+  fclose(f);
+
+  orm_om_free(st);
+  CHECK(n_dtor, ==, N_STACKS);
+  return buf;
+}
+
+
+/* Returns the samples of family [name], which must be declared exactly once
+ * with [type], or NULL if it is not declared at all.  The samples run from
+ * after the TYPE and any HELP line to the next comment or the end.
+ */
+static char* family(const char* out, const char* name, const char* type)
+{
+  char type_line[256];
+  const char* p;
+  const char* end;
+
+  snprintf(type_line, sizeof(type_line), "# TYPE %s %s\n", name, type);
+  p = strstr(out, type_line);
+  if( p == NULL )
+    return NULL;
+  CHECK_TRUE(strstr(p + 1, type_line) == NULL);
+
+  p += strlen(type_line);
+  if( strncmp(p, "# HELP ", 7) == 0 )
+    p = strchr(p, '\n') + 1;
+  for( end = p; *end != '\0' && *end != '#'; end = strchr(end, '\n') + 1 )
+    ;
+  return strndup(p, end - p);
+}
+
+
+static void check_family(const char* out, const char* name,
+                         const char* type, const char* expect)
+{
+  char* samples = family(out, name, type);
+
+  CHECK_TRUE(samples != NULL);
+  CHECK(strcmp(samples, expect), ==, 0);
+  free(samples);
+}
+
+
+/* Each family is declared once, and is followed by all its samples for
+ * every stack.  Counters carry "_total", gauges nothing.
+ */
+static void test_stack_families(void)
+{
+  static const char info[] =
+    "# TYPE onload_stack info\n"
+    "# HELP onload_stack Onload stacks being reported.\n"
+    "onload_stack_info{" LABELS_0 ",version=\"" VERSION "\"} 1\n"
+    "onload_stack_info{" LABELS_3 ",version=\"" VERSION "\"} 1\n"
+    "# TYPE ";
+  char* out;
+
+  setup();
+  out = dump(false, false, false);
+
+  CHECK(strncmp(out, info, strlen(info)), ==, 0);
+
+  check_family(out, "onload_stack_rx_evs", "counter",
+               "onload_stack_rx_evs_total{" LABELS_0 "} 7\n"
+               "onload_stack_rx_evs_total{" LABELS_3 "} 9\n");
+  check_family(out, "onload_stack_table_n_entries", "gauge",
+               "onload_stack_table_n_entries{" LABELS_0 "} 5\n"
+               "onload_stack_table_n_entries{" LABELS_3 "} 1\n");
+  check_family(out, "onload_tcp_active_opens", "counter",
+               "onload_tcp_active_opens_total{" LABELS_0 "} 11\n"
+               "onload_tcp_active_opens_total{" LABELS_3 "} 13\n");
+
+  /* Counters that are never maintained are left out */
+  CHECK_TRUE(strstr(out, "tcp_prequeued") == NULL);
+  /* Socket walks are a separate part */
+  CHECK_TRUE(strstr(out, "onload_sockets_") == NULL);
+  CHECK_TRUE(strstr(out, "# EOF") == NULL);
+
+  free(out);
+  teardown();
+}
+
+
+/* Buckets are cumulative, and the +Inf bucket and the count include the
+ * overflow bucket.  Stacks without histograms enabled have no samples.
+ */
+static void test_histogram(void)
+{
+  char* out;
+
+  setup();
+  out = dump(false, false, false);
+
+  check_family(out, "onload_latency_rx_to_app_seconds", "histogram",
+               "onload_latency_rx_to_app_seconds_bucket{" LABELS_0
+               ",le=\"3e-09\"} 2\n"
+               "onload_latency_rx_to_app_seconds_bucket{" LABELS_0
+               ",le=\"+Inf\"} 3\n"
+               "onload_latency_rx_to_app_seconds_count{" LABELS_0 "} 3\n"
+               "onload_latency_rx_to_app_seconds_sum{" LABELS_0 "} 1\n");
+  check_family(out, "onload_latency_lock_hold_seconds", "histogram",
+               "onload_latency_lock_hold_seconds_bucket{" LABELS_0
+               ",le=\"+Inf\"} 0\n"
+               "onload_latency_lock_hold_seconds_count{" LABELS_0 "} 0\n"
+               "onload_latency_lock_hold_seconds_sum{" LABELS_0 "} 0\n");
+  /* Per-socket histograms need EF_LATENCY_HIST=2 */
+  check_family(out, "onload_socket_latency_rx_to_app_seconds", "histogram",
+               "");
+
+  free(out);
+  teardown();
+}
+
+
+static void test_sockets(void)
+{
+  char* out;
+  char* samples;
+
+  setup();
+  out = dump(true, false, false);
+  check_family(out, "onload_sockets_udp_tot_recv_pkts_os", "counter",
+               "onload_sockets_udp_tot_recv_pkts_os_total{" LABELS_0 "} 6\n"
+               "onload_sockets_udp_tot_recv_pkts_os_total{" LABELS_3
+               "} 0\n");
+  samples = family(out, "onload_tcp_socket_rx_pkts", "counter");
+  CHECK_TRUE(samples == NULL);
+  free(out);
+
+  out = dump(true, true, false);
+  check_family(out, "onload_tcp_socket_rx_pkts", "counter",
+               "onload_tcp_socket_rx_pkts_total{" LABELS_0
+               ",socket=\"0\"} 21\n");
+  check_family(out, "onload_udp_socket_n_rx_os", "counter",
+               "onload_udp_socket_n_rx_os_total{" LABELS_0
+               ",socket=\"1\"} 6\n");
+  check_family(out, "onload_udp_socket_max_recvq_pkts", "gauge",
+               "onload_udp_socket_max_recvq_pkts{" LABELS_0
+               ",socket=\"1\"} 3\n");
+  free(out);
+  teardown();
+}
+
+
+/* Returns whether sample [name] can belong to a family [family] of [type] */
+static bool in_family(const char* name, size_t len, const char* family,
+                      const char* type)
+{
+  static const char* const counter[] = { "_total", NULL };
+  static const char* const gauge[] = { "", NULL };
+  static const char* const info[] = { "_info", NULL };
+  static const char* const histogram[] = {
+    "_bucket", "_count", "_sum", NULL
+  };
+  const char* const* suffix;
+  size_t flen = strlen(family);
+
+  if( strcmp(type, "counter") == 0 )
+    suffix = counter;
+  else if( strcmp(type, "gauge") == 0 )
+    suffix = gauge;
+  else if( strcmp(type, "info") == 0 )
+    suffix = info;
+  else if( strcmp(type, "histogram") == 0 )
+    suffix = histogram;
+  else
+    return false;
+
+  if( len < flen || strncmp(name, family, flen) != 0 )
+    return false;
+  for( ; *suffix != NULL; ++suffix )
+    if( len - flen == strlen(*suffix) &&
+        strncmp(name + flen, *suffix, len - flen) == 0 )
+      return true;
+  return false;
+}
+
+
+/* Every sample of the whole exposition is in the family declared before it,
+ * and it ends with the one EOF line.
+ */
+static void test_exposition(void)
+{
+  char family_name[256] = "";
+  char type[32] = "";
+  char* out;
+  char* line;
+  char* next;
+  int n_families = 0, n_samples = 0;
+
+  setup();
+  out = dump(true, true, true);
+
+  CHECK(strcmp(out + strlen(out) - strlen(orm_om_eof), orm_om_eof), ==, 0);
+  CHECK_TRUE(strstr(out, "# EOF") == out + strlen(out) - strlen(orm_om_eof));
+
+  for( line = out; *line != '\0'; line = next ) {
+    next = strchr(line, '\n');
+    CHECK_TRUE(next != NULL);
+    *next++ = '\0';
+
+    if( strncmp(line, "# TYPE ", 7) == 0 ) {
+      char* space = strchr(line + 7, ' ');
+      char pattern[300];
+      CHECK_TRUE(space != NULL);
+      *space = '\0';
+      strcpy(family_name, line + 7);
+      strcpy(type, space + 1);
+      /* Declared once only */
+      snprintf(pattern, sizeof(pattern), "# TYPE %s ", family_name);
+      CHECK_TRUE(strstr(next, pattern) == NULL);
+      ++n_families;
+    }
+    else if( strncmp(line, "# HELP ", 7) == 0 ) {
+      CHECK(strncmp(line + 7, family_name, strlen(family_name)), ==, 0);
+      CHECK(line[7 + strlen(family_name)], ==, ' ');
+    }
+    else if( strcmp(line, "# EOF") == 0 ) {
+      CHECK(*next, ==, '\0');
+    }
+    else {
+      size_t len = strcspn(line, "{ ");
+      CHECK_TRUE(in_family(line, len, family_name, type));
+      ++n_samples;
+    }
+  }
+  CHECK(n_families, >, 100);
+  CHECK(n_samples, >, n_families);
+
+  free(out);
+  teardown();
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_stack_families);
+  TEST_RUN(test_histogram);
+  TEST_RUN(test_sockets);
+  TEST_RUN(test_exposition);
+  TEST_END();
+}
@@ -0,0 +1,274 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_netif.h"
+
+#define N_TIMERS  256
+/* The start of a wheel0 rotation and of a wheel1 rotation */
+#define START     0x10000u
+#define ROTATION  CI_IPTIME_BUCKETS
+
+
+static ci_netif* ni;
+static ci_ip_timer* timers;
+static int n_fired[N_TIMERS];
+static ci_iptime_t fired_at[N_TIMERS];
+
+
+/* All the test timers are CI_IP_TIMER_NETIF_TIMEOUT.  The one firing is the
+ * one that has just been unlinked from the fire list with the current time,
+ * and hasn't already fired at this time.
+ */
+void ci_netif_timeout_state(ci_netif* netif)
+{
+  ci_iptime_t now = IPTIMER_STATE(netif)->sched_ticks;
+  int i, found = -1, n = 0;
+
+  for( i = 0; i < N_TIMERS; ++i )
+    if( ! ci_ip_timer_pending(netif, &timers[i]) && timers[i].time == now &&
+        ! (n_fired[i] != 0 && fired_at[i] == now) ) {
+      found = i;
+      ++n;
+    }
+  CHECK(n, ==, 1);
+  if( found >= 0 ) {
+    ++n_fired[found];
+    fired_at[found] = now;
+  }
+}
+
+
+static void setup(void)
+{
+  ci_ip_timer_state* ipts;
+  int i;
+
+  ni = unit_netif_alloc_extra(0, N_TIMERS * sizeof(ci_ip_timer));
+  timers = unit_netif_extra(ni);
+  ipts = IPTIMER_STATE(ni);
+  ipts->ci_ip_time_real_ticks = START;
+  ipts->sched_ticks = START;
+  ipts->closest_timer = START + 2 * CI_IPTIME_BUCKETS;
+  oo_p_dllink_init(ni, oo_p_dllink_ptr(ni, &ipts->fire_list));
+  for( i = 0; i < CI_IPTIME_WHEELSIZE; ++i )
+    oo_p_dllink_init(ni, oo_p_dllink_ptr(ni, &ipts->warray[i]));
+
+  for( i = 0; i < N_TIMERS; ++i ) {
+    timers[i].fn = CI_IP_TIMER_NETIF_TIMEOUT;
+    ci_ip_timer_init(ni, &timers[i], oo_state_ptr_to_statep(ni, &timers[i]),
+                     "test");
+  }
+  memset(n_fired, 0, sizeof(n_fired));
+  memset(fired_at, 0, sizeof(fired_at));
+}
+
+
+/* Move the clock on to [t], polling every [step] ticks */
+static void run_to(ci_iptime_t t, unsigned step)
+{
+  ci_ip_timer_state* ipts = IPTIMER_STATE(ni);
+
+  while( TIME_LT(ipts->sched_ticks, t) ) {
+    ipts->ci_ip_time_real_ticks += CI_MIN(step, t - ipts->sched_ticks);
+    ci_ip_timer_poll(ni);
+  }
+  CI_DEBUG(ci_ip_timer_state_assert_valid(ni, __FILE__, __LINE__));
+}
+
+
+/* Check that timer [i] fired exactly once, at [t] */
+static void check_fired(int i, ci_iptime_t t)
+{
+  CHECK(n_fired[i], ==, 1);
+  CHECK(fired_at[i] - START, ==, t - START);
+  CHECK(ci_ip_timer_pending(ni, &timers[i]), ==, 0);
+}
+
+
+static void test_wheel0(void)
+{
+  /* Both rotations held by wheel0, and the edges of each */
+  static const ci_iptime_t when[] = {
+    1, 100, ROTATION - 1, ROTATION, ROTATION + 44, 2 * ROTATION - 1,
+  };
+  int i, n = sizeof(when) / sizeof(when[0]);
+
+  setup();
+  for( i = 0; i < n; ++i )
+    ci_ip_timer_set(ni, &timers[i], START + when[i]);
+  CI_DEBUG(ci_ip_timer_state_assert_valid(ni, __FILE__, __LINE__));
+
+  /* Nothing fires early */
+  run_to(START + ROTATION - 2, 1);
+  CHECK(n_fired[2], ==, 0);
+  CHECK(n_fired[3], ==, 0);
+  CHECK(ci_ip_timer_pending(ni, &timers[2]), !=, 0);
+
+  run_to(START + 3 * ROTATION, 1);
+  for( i = 0; i < n; ++i )
+    check_fired(i, START + when[i]);
+  CHECK(ni->state->stats.timer_cascaded, ==, 0);
+  CHECK(ni->state->stats.timer_cascade_forced, ==, 0);
+
+  /* The same, with the clock jumping over several timers at once */
+  unit_netif_free(ni);
+  setup();
+  for( i = 0; i < n; ++i )
+    ci_ip_timer_set(ni, &timers[i], START + when[i]);
+  run_to(START + 3 * ROTATION, 150);
+  for( i = 0; i < n; ++i )
+    check_fired(i, START + when[i]);
+
+  unit_netif_free(ni);
+}
+
+
+static void test_cascade(void)
+{
+  ci_iptime_t t = START + 2 * ROTATION;
+  int i, n = 150;
+
+  /* The rotation after next is in wheel1.  Polled every tick, it is moved
+   * into wheel0 during the rotation before it. */
+  setup();
+  for( i = 0; i < n; ++i )
+    ci_ip_timer_set(ni, &timers[i], t + i);
+  run_to(t - 1, 1);
+  CHECK(ni->state->stats.timer_cascaded, ==, n);
+  CHECK(ni->state->stats.timer_cascade_forced, ==, 0);
+  CHECK(n_fired[0], ==, 0);
+  run_to(t + ROTATION, 1);
+  for( i = 0; i < n; ++i )
+    check_fired(i, t + i);
+
+  /* Without a poll in the rotation before, it all moves when the rotation
+   * starts */
+  unit_netif_free(ni);
+  setup();
+  for( i = 0; i < n; ++i )
+    ci_ip_timer_set(ni, &timers[i], t + i);
+  run_to(t + 20, 2 * ROTATION + 20);
+  CHECK(ni->state->stats.timer_cascade_forced, ==, n);
+  for( i = 0; i <= 20; ++i )
+    check_fired(i, t + i);
+  CHECK(n_fired[21], ==, 0);
+  run_to(t + ROTATION, 1);
+  for( i = 0; i < n; ++i )
+    check_fired(i, t + i);
+
+  /* Timers in wheels 2 and 3 come down through wheel1 */
+  unit_netif_free(ni);
+  setup();
+  ci_ip_timer_set(ni, &timers[0], START + 70000);
+  ci_ip_timer_set(ni, &timers[1], START + 70001);
+  ci_ip_timer_set(ni, &timers[2], START + (1u << 24) + 5);
+  run_to(START + 60000, 1000);
+  CHECK(n_fired[0], ==, 0);
+  run_to(START + 75000, 1);
+  check_fired(0, START + 70000);
+  check_fired(1, START + 70001);
+  run_to(START + (1u << 24) + ROTATION, 977);
+  check_fired(2, START + (1u << 24) + 5);
+
+  unit_netif_free(ni);
+}
+
+
+static void test_lazy(void)
+{
+  setup();
+
+  /* Pushed back within wheel0: left where it is, and requeued on reaching
+   * its first slot */
+  ci_ip_timer_set(ni, &timers[0], START + 10);
+  ci_ip_timer_modify_lazy(ni, &timers[0], START + 100);
+  CHECK(timers[0].time - START, ==, 10);
+  CHECK(ci_ip_timer_expiry(&timers[0]) - START, ==, 100);
+  CHECK(ci_ip_timer_pending(ni, &timers[0]), !=, 0);
+
+  /* Pushed back beyond wheel0: requeued into wheel1 */
+  ci_ip_timer_set(ni, &timers[1], START + 20);
+  ci_ip_timer_modify_lazy(ni, &timers[1], START + 1000);
+
+  /* Pushed back while in wheel1: folded in when cascaded */
+  ci_ip_timer_set(ni, &timers[2], START + 600);
+  ci_ip_timer_modify_lazy(ni, &timers[2], START + 700);
+
+  /* Pushed back repeatedly: only the last counts */
+  ci_ip_timer_set(ni, &timers[3], START + 40);
+  ci_ip_timer_modify_lazy(ni, &timers[3], START + 60);
+  ci_ip_timer_modify_lazy(ni, &timers[3], START + 80);
+
+  /* Brought forward: moved at once */
+  ci_ip_timer_set(ni, &timers[4], START + 50);
+  ci_ip_timer_modify_lazy(ni, &timers[4], START + 30);
+  CHECK(timers[4].time - START, ==, 30);
+  CHECK(ni->state->stats.timer_lazy_rearms, ==, 5);
+
+  run_to(START + 11, 1);
+  CHECK(n_fired[0], ==, 0);
+  CHECK(timers[0].time - START, ==, 100);
+  CHECK(timers[0].defer, ==, 0);
+
+  run_to(START + 1100, 1);
+  check_fired(0, START + 100);
+  check_fired(1, START + 1000);
+  check_fired(2, START + 700);
+  check_fired(3, START + 80);
+  check_fired(4, START + 30);
+  /* Timers 0, 1 and 3 were requeued from wheel0; timer 2 was not */
+  CHECK(ni->state->stats.timer_lazy_requeues, ==, 3);
+
+  unit_netif_free(ni);
+}
+
+
+static void test_cancel(void)
+{
+  setup();
+
+  /* Cancelled after being requeued */
+  ci_ip_timer_set(ni, &timers[0], START + 10);
+  ci_ip_timer_modify_lazy(ni, &timers[0], START + 300);
+  run_to(START + 11, 1);
+  CHECK(ci_ip_timer_pending(ni, &timers[0]), !=, 0);
+  CHECK(timers[0].time - START, ==, 300);
+  ci_ip_timer_clear(ni, &timers[0]);
+
+  /* Cancelled before reaching its first slot, then set again */
+  ci_ip_timer_set(ni, &timers[1], START + 15);
+  ci_ip_timer_modify_lazy(ni, &timers[1], START + 200);
+  ci_ip_timer_clear(ni, &timers[1]);
+  CHECK(ci_ip_timer_pending(ni, &timers[1]), ==, 0);
+  ci_ip_timer_set(ni, &timers[1], START + 250);
+  CHECK(ci_ip_timer_expiry(&timers[1]) - START, ==, 250);
+
+  /* Cancelled while pushed back in wheel1 */
+  ci_ip_timer_set(ni, &timers[2], START + 600);
+  ci_ip_timer_modify_lazy(ni, &timers[2], START + 650);
+  ci_ip_timer_clear(ni, &timers[2]);
+
+  run_to(START + 1000, 1);
+  CHECK(n_fired[0], ==, 0);
+  check_fired(1, START + 250);
+  CHECK(n_fired[2], ==, 0);
+  CHECK(ci_ip_timer_pending(ni, &timers[0]), ==, 0);
+  CHECK(ci_ip_timer_pending(ni, &timers[2]), ==, 0);
+
+  unit_netif_free(ni);
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_wheel0);
+  TEST_RUN(test_cascade);
+  TEST_RUN(test_lazy);
+  TEST_RUN(test_cancel);
+  TEST_END();
+}
@@ -0,0 +1,143 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_netif.h"
+
+
+static ci_netif* alloc_netif(int mode)
+{
+  ci_netif* ni = unit_netif_alloc(0);
+  int i;
+
+  NI_OPTS(ni).latency_hist = mode;
+  for( i = 0; i < CI_CFG_LATENCY_HIST_SOCKETS; ++i )
+    ni->state->lat_sock[i].sock_id = OO_SP_NULL;
+  return ni;
+}
+
+
+static void test_buckets(void)
+{
+  ci_uint64 v;
+  unsigned i;
+
+  CHECK(OO_LAT_HIST_N_BUCKETS, ==, 240);
+
+  /* Small values are exact */
+  for( i = 0; i < 8; ++i ) {
+    CHECK(oo_lat_hist_bucket(i), ==, i);
+    CHECK(oo_lat_hist_bucket_min(i), ==, i);
+  }
+  CHECK(oo_lat_hist_bucket(8), ==, 8);
+  CHECK(oo_lat_hist_bucket(15), ==, 15);
+  CHECK(oo_lat_hist_bucket(16), ==, 16);
+  CHECK(oo_lat_hist_bucket(17), ==, 16);
+  CHECK(oo_lat_hist_bucket(18), ==, 17);
+  CHECK(oo_lat_hist_bucket(0xffffffff), ==, OO_LAT_HIST_N_BUCKETS - 1);
+
+  /* Each bucket starts where the previous one stops */
+  for( i = 1; i < OO_LAT_HIST_N_BUCKETS; ++i ) {
+    v = oo_lat_hist_bucket_min(i);
+    CHECK(oo_lat_hist_bucket(v), ==, i);
+    CHECK(oo_lat_hist_bucket(v - 1), ==, i - 1);
+  }
+
+  /* and is no more than 1/8 wider than its lower bound */
+  for( i = 8; i < OO_LAT_HIST_N_BUCKETS - 1; ++i )
+    CHECK((oo_lat_hist_bucket_min(i + 1) - oo_lat_hist_bucket_min(i)) * 8,
+          <=, oo_lat_hist_bucket_min(i));
+}
+
+
+static void test_add(void)
+{
+  struct oo_lat_hist* h = calloc(1, sizeof(*h));
+
+  oo_lat_hist_add(h, 5);
+  oo_lat_hist_add(h, 1000);
+  oo_lat_hist_add(h, 1000);
+  CHECK(h->count, ==, 3);
+  CHECK(h->sum, ==, 2005);
+  CHECK(h->max, ==, 1000);
+  CHECK(h->bucket[5], ==, 1);
+  CHECK(h->bucket[oo_lat_hist_bucket(1000)], ==, 2);
+
+  /* Clamped to 32 bits */
+  oo_lat_hist_add(h, 1ull << 40);
+  CHECK(h->max, ==, 0xffffffff);
+  CHECK(h->bucket[OO_LAT_HIST_N_BUCKETS - 1], ==, 1);
+
+  free(h);
+}
+
+
+static void test_sock_slots(void)
+{
+  ci_netif* ni = alloc_netif(2);
+  struct oo_lat_hist_sock* ls;
+  int i;
+
+  /* First come, first served */
+  for( i = 0; i < CI_CFG_LATENCY_HIST_SOCKETS; ++i ) {
+    ls = oo_lat_hist_sock(ni, i + 10);
+    CHECK(ls, ==, &ni->state->lat_sock[i]);
+    CHECK(ls->sock_id, ==, i + 10);
+  }
+  CHECK(oo_lat_hist_sock(ni, 100), ==, NULL);
+  CHECK(oo_lat_hist_sock(ni, 12), ==, &ni->state->lat_sock[2]);
+  CHECK(oo_lat_hist_sock(ni, OO_SP_NULL), ==, NULL);
+
+  /* A released slot keeps its data until it's reused */
+  oo_lat_hist_add(&ni->state->lat_sock[2].rx_to_app, 7);
+  oo_lat_hist_sock_release(ni, 12);
+  CHECK(ni->state->lat_sock[2].sock_id, ==, OO_SP_NULL);
+  CHECK(ni->state->lat_sock[2].rx_to_app.count, ==, 1);
+  ls = oo_lat_hist_sock(ni, 100);
+  CHECK(ls, ==, &ni->state->lat_sock[2]);
+  CHECK(ls->rx_to_app.count, ==, 0);
+
+  /* Per-stack mode only */
+  NI_OPTS(ni).latency_hist = 1;
+  CHECK(oo_lat_hist_sock(ni, 100), ==, NULL);
+
+  unit_netif_free(ni);
+}
+
+
+static void test_lock_hold(void)
+{
+  ci_netif* ni = alloc_netif(1);
+
+  /* Nothing recorded unless the lock was stamped */
+  __oo_lat_hist_lock_hold(ni);
+  CHECK(ni->state->lat_lock_hold.count, ==, 0);
+
+  ci_frc64(&ni->state->lock_frc);
+  __oo_lat_hist_lock_hold(ni);
+  CHECK(ni->state->lat_lock_hold.count, ==, 1);
+  CHECK(ni->state->lock_frc, ==, 0);
+
+  /* A stamp from the future counts as zero */
+  ci_frc64(&ni->state->lock_frc);
+  ni->state->lock_frc += 1000000000;
+  __oo_lat_hist_lock_hold(ni);
+  CHECK(ni->state->lat_lock_hold.count, ==, 2);
+  CHECK(ni->state->lat_lock_hold.bucket[0], ==, 1);
+
+  unit_netif_free(ni);
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_buckets);
+  TEST_RUN(test_add);
+  TEST_RUN(test_sock_slots);
+  TEST_RUN(test_lock_hold);
+  TEST_END();
+}
@@ -0,0 +1,195 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_netif.h"
+
+
+static ci_netif* alloc_netif(void)
+{
+  ci_netif* ni = unit_netif_alloc(0);
+
+  NI_OPTS(ni).lock_profile = 1;
+  ni->state->lock_prof.holder = -1;
+  return ni;
+}
+
+
+static struct oo_lock_prof_site* find_site(ci_netif* ni, const char* func,
+                                           unsigned line)
+{
+  struct oo_lock_prof* lp = &ni->state->lock_prof;
+  int i;
+
+  for( i = 0; i < CI_CFG_LOCK_PROFILE_SITES; ++i )
+    if( lp->site[i].line == line && ! strcmp(lp->site[i].func, func) )
+      return &lp->site[i];
+  return NULL;
+}
+
+
+static void test_sites(void)
+{
+  ci_netif* ni = alloc_netif();
+  struct oo_lock_prof* lp = &ni->state->lock_prof;
+  struct oo_lock_prof_site* site;
+  int i;
+
+  /* Each caller gets a site of its own, however often it locks */
+  for( i = 0; i < 3; ++i ) {
+    __oo_lock_prof_acquired(ni, "caller_a", 100, 0);
+    __oo_lock_prof_released(ni);
+  }
+  __oo_lock_prof_acquired(ni, "caller_b", 100, 0);
+  __oo_lock_prof_released(ni);
+  __oo_lock_prof_acquired(ni, "caller_a", 164, 0);
+  __oo_lock_prof_released(ni);
+
+  site = find_site(ni, "caller_a", 100);
+  CHECK(site, !=, NULL);
+  CHECK(site->n_locks, ==, 3);
+  CHECK(site->n_holds, ==, 3);
+  CHECK(site->n_waits, ==, 0);
+  CHECK(find_site(ni, "caller_b", 100)->n_locks, ==, 1);
+  CHECK(find_site(ni, "caller_a", 164)->n_locks, ==, 1);
+  CHECK(lp->holder, ==, -1);
+  CHECK(lp->n_untracked, ==, 0);
+
+  /* Long names are truncated */
+  __oo_lock_prof_acquired(ni, "a_function_with_a_rather_long_name", 7, 0);
+  __oo_lock_prof_released(ni);
+  CHECK(lp->site[7].line, ==, 7);
+  CHECK(strlen(lp->site[7].func), ==, sizeof(lp->site[7].func) - 1);
+  __oo_lock_prof_acquired(ni, "a_function_with_a_rather_long_name", 7, 0);
+  CHECK(lp->holder, ==, 7);
+  CHECK(lp->site[7].n_locks, ==, 2);
+
+  unit_netif_free(ni);
+}
+
+
+static void test_times(void)
+{
+  ci_netif* ni = alloc_netif();
+  struct oo_lock_prof* lp = &ni->state->lock_prof;
+  struct oo_lock_prof_site* site;
+  ci_uint64 start;
+
+  ci_frc64(&start);
+  __oo_lock_prof_acquired(ni, "waiter", 10, start - 1000);
+  site = &lp->site[lp->holder];
+  CHECK(site->n_waits, ==, 1);
+  CHECK(site->wait_cycles, >=, 1000);
+  CHECK(site->wait_max, ==, site->wait_cycles);
+
+  lp->hold_frc -= 5000;
+  __oo_lock_prof_released(ni);
+  CHECK(site->n_holds, ==, 1);
+  CHECK(site->hold_cycles, >=, 5000);
+  CHECK(site->hold_max, ==, site->hold_cycles);
+
+  /* A stamp from the future counts as zero */
+  __oo_lock_prof_acquired(ni, "waiter", 10, start + 1000000000000ull);
+  CHECK(site->n_waits, ==, 2);
+  lp->hold_frc += 1000000000000ull;
+  __oo_lock_prof_released(ni);
+  CHECK(site->n_holds, ==, 2);
+  CHECK(site->hold_max, >=, 5000);
+
+  /* Releasing without a recorded holder does nothing */
+  __oo_lock_prof_released(ni);
+  CHECK(site->n_holds, ==, 2);
+
+  unit_netif_free(ni);
+}
+
+
+static void test_lock_macros(void)
+{
+  ci_netif* ni = alloc_netif();
+  struct oo_lock_prof* lp = &ni->state->lock_prof;
+  int line, rc;
+
+  /* CHECK() evaluates its arguments more than once */
+  line = __LINE__; rc = ci_netif_trylock(ni);
+  CHECK(rc, !=, 0);
+  CHECK(lp->holder, >=, 0);
+  CHECK(lp->site[lp->holder].line, ==, line);
+  CHECK(strcmp(lp->site[lp->holder].func, __func__), ==, 0);
+  __oo_lock_prof_released(ni);
+
+  /* Failing to get the lock isn't counted */
+  rc = ci_netif_trylock(ni);
+  CHECK(rc, ==, 0);
+  CHECK(lp->holder, ==, -1);
+  CHECK(lp->site[line % CI_CFG_LOCK_PROFILE_SITES].n_locks, ==, 1);
+
+  /* Nor is anything recorded when the option is off */
+  ni->state->lock.lock = 0;
+  NI_OPTS(ni).lock_profile = 0;
+  rc = ci_netif_trylock(ni);
+  CHECK(rc, !=, 0);
+  CHECK(lp->holder, ==, -1);
+
+  unit_netif_free(ni);
+}
+
+
+static void test_full(void)
+{
+  ci_netif* ni = alloc_netif();
+  struct oo_lock_prof* lp = &ni->state->lock_prof;
+  int i;
+
+  for( i = 1; i <= CI_CFG_LOCK_PROFILE_SITES; ++i ) {
+    __oo_lock_prof_acquired(ni, "f", i, 0);
+    __oo_lock_prof_released(ni);
+  }
+  CHECK(lp->n_untracked, ==, 0);
+
+  __oo_lock_prof_acquired(ni, "g", 1, 0);
+  CHECK(lp->holder, ==, -1);
+  CHECK(lp->n_untracked, ==, 1);
+  __oo_lock_prof_released(ni);
+
+  /* Existing sites are still found */
+  __oo_lock_prof_acquired(ni, "f", 5, 0);
+  CHECK(lp->site[lp->holder].n_locks, ==, 2);
+  CHECK(lp->n_untracked, ==, 1);
+
+  unit_netif_free(ni);
+}
+
+
+static void test_deferred(void)
+{
+  ci_netif* ni = alloc_netif();
+  ci_uint64* deferred = ni->state->lock_prof.deferred;
+
+  __oo_lock_prof_deferred(ni, CI_EPLOCK_NETIF_SOCKET_LIST);
+  __oo_lock_prof_deferred(ni, CI_EPLOCK_NETIF_NEED_POLL |
+                              CI_EPLOCK_NETIF_NEED_WAKE);
+  __oo_lock_prof_deferred(ni, CI_EPLOCK_NETIF_NEED_POLL | 0x5);
+  CHECK(deferred[0], ==, 2);
+  CHECK(deferred[61], ==, 2);
+  CHECK(deferred[63], ==, 1);
+  CHECK(deferred[1], ==, 0);
+  CHECK(deferred[2], ==, 0);
+
+  unit_netif_free(ni);
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_sites);
+  TEST_RUN(test_times);
+  TEST_RUN(test_lock_macros);
+  TEST_RUN(test_full);
+  TEST_RUN(test_deferred);
+  TEST_END();
+}
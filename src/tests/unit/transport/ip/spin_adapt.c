@@ -0,0 +1,235 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_netif.h"
+#include <onload/ul/per_thread.h>
+
+/* The slot lookup's view of the calling thread */
+__thread struct oo_per_thread oo_per_thread;
+
+
+#define MAX_SPIN  100000ull
+
+
+static void init_slot(struct oo_spin_adapt* sa)
+{
+  memset(sa, 0, sizeof(*sa));
+  sa->tid = 1;
+  sa->budget_bucket = OO_SPIN_ADAPT_N_BUCKETS - 1;
+}
+
+
+static void test_buckets(void)
+{
+  struct oo_spin_adapt sa;
+
+  CHECK(oo_spin_adapt_bucket(0), ==, 0);
+  CHECK(oo_spin_adapt_bucket(1), ==, 0);
+  CHECK(oo_spin_adapt_bucket(2), ==, 1);
+  CHECK(oo_spin_adapt_bucket(3), ==, 1);
+  CHECK(oo_spin_adapt_bucket(1024), ==, 10);
+  CHECK(oo_spin_adapt_bucket(2047), ==, 10);
+  CHECK(oo_spin_adapt_bucket(~0ull), ==, OO_SPIN_ADAPT_N_BUCKETS - 1);
+
+  /* A budget covers the whole of its bucket, within the limit */
+  init_slot(&sa);
+  CHECK(oo_spin_adapt_budget(&sa, MAX_SPIN), ==, MAX_SPIN);
+  sa.budget_bucket = 10;
+  CHECK(oo_spin_adapt_budget(&sa, MAX_SPIN), ==, 2048);
+  CHECK(oo_spin_adapt_budget(&sa, 1000), ==, 1000);
+  sa.budget_bucket = -1;
+  CHECK(oo_spin_adapt_budget(&sa, MAX_SPIN), ==, 0);
+}
+
+
+static void test_short_waits(void)
+{
+  struct oo_spin_adapt sa;
+  int i;
+
+  /* Data that turns up quickly needs little spin */
+  init_slot(&sa);
+  for( i = 0; i < 100; ++i )
+    oo_spin_adapt_add(&sa, 1500, MAX_SPIN, 99);
+  CHECK(sa.budget_bucket, ==, 10);
+  CHECK(oo_spin_adapt_budget(&sa, MAX_SPIN), ==, 2048);
+  CHECK(sa.n_waits, ==, 100);
+  CHECK(sa.n_spun, ==, 100);
+  CHECK(sa.n_long, ==, 0);
+  CHECK(sa.spin_cycles, ==, 150000);
+  CHECK(sa.full_spin_cycles, ==, 150000);
+
+  /* The occasional longer wait within the limit raises the budget once it
+   * is more than the tail the percentage allows */
+  oo_spin_adapt_add(&sa, 40000, MAX_SPIN, 99);
+  CHECK(sa.budget_bucket, ==, 10);
+  CHECK(sa.n_spun, ==, 100);
+  CHECK(sa.spin_cycles, ==, 150000 + 2048);
+  oo_spin_adapt_add(&sa, 40000, MAX_SPIN, 99);
+  CHECK(sa.budget_bucket, ==, oo_spin_adapt_bucket(40000));
+  CHECK(oo_spin_adapt_budget(&sa, MAX_SPIN), ==, 65536);
+  oo_spin_adapt_add(&sa, 40000, MAX_SPIN, 99);
+  CHECK(sa.n_spun, ==, 101);
+
+  /* but not at a lower percentage */
+  init_slot(&sa);
+  for( i = 0; i < 100; ++i )
+    oo_spin_adapt_add(&sa, 1500, MAX_SPIN, 90);
+  for( i = 0; i < 5; ++i )
+    oo_spin_adapt_add(&sa, 40000, MAX_SPIN, 90);
+  CHECK(sa.budget_bucket, ==, 10);
+}
+
+
+static void test_long_waits(void)
+{
+  struct oo_spin_adapt sa;
+
+  /* Waits that the full spin wouldn't catch stop the spinning */
+  init_slot(&sa);
+  oo_spin_adapt_add(&sa, MAX_SPIN * 10, MAX_SPIN, 99);
+  CHECK(sa.budget_bucket, ==, -1);
+  CHECK(sa.n_long, ==, 1);
+  CHECK(sa.recent_long, ==, 1);
+  CHECK(sa.n_spun, ==, 0);
+  CHECK(sa.spin_cycles, ==, MAX_SPIN);
+  CHECK(sa.full_spin_cycles, ==, MAX_SPIN);
+
+  oo_spin_adapt_add(&sa, MAX_SPIN * 10, MAX_SPIN, 99);
+  CHECK(sa.spin_cycles, ==, MAX_SPIN);
+  CHECK(sa.full_spin_cycles, ==, 2 * MAX_SPIN);
+
+  /* until one would have been caught */
+  oo_spin_adapt_add(&sa, 300, MAX_SPIN, 99);
+  CHECK(sa.budget_bucket, ==, 8);
+  CHECK(sa.n_spun, ==, 0);
+
+  /* An infinite limit catches everything */
+  init_slot(&sa);
+  oo_spin_adapt_add(&sa, 1ull << 40, ~0ull, 99);
+  CHECK(sa.n_long, ==, 0);
+  CHECK(sa.budget_bucket, ==, OO_SPIN_ADAPT_N_BUCKETS - 1);
+  CHECK(oo_spin_adapt_budget(&sa, ~0ull), ==, ~0ull);
+}
+
+
+static void test_decay(void)
+{
+  struct oo_spin_adapt sa;
+  int i;
+
+  /* Old traffic is forgotten */
+  init_slot(&sa);
+  for( i = 0; i < 100; ++i )
+    oo_spin_adapt_add(&sa, 50000, MAX_SPIN, 99);
+  CHECK(sa.budget_bucket, ==, oo_spin_adapt_bucket(50000));
+  for( i = 0; i < OO_SPIN_ADAPT_DECAY * 8; ++i )
+    oo_spin_adapt_add(&sa, 100, MAX_SPIN, 99);
+  CHECK(sa.hist[oo_spin_adapt_bucket(50000)], <, 100);
+  CHECK(sa.recent, <, OO_SPIN_ADAPT_DECAY);
+  CHECK(sa.budget_bucket, ==, oo_spin_adapt_bucket(100));
+  CHECK(sa.n_waits, ==, 100 + OO_SPIN_ADAPT_DECAY * 8);
+
+  /* The counts are halved every OO_SPIN_ADAPT_DECAY waits, not only the
+   * first time */
+  init_slot(&sa);
+  for( i = 0; i < OO_SPIN_ADAPT_DECAY; ++i )
+    oo_spin_adapt_add(&sa, 100, MAX_SPIN, 99);
+  CHECK(sa.hist[oo_spin_adapt_bucket(100)], ==, OO_SPIN_ADAPT_DECAY / 2);
+  CHECK(sa.recent, ==, 0);
+  for( i = 0; i < OO_SPIN_ADAPT_DECAY - 1; ++i )
+    oo_spin_adapt_add(&sa, 100, MAX_SPIN, 99);
+  CHECK(sa.hist[oo_spin_adapt_bucket(100)], ==,
+        OO_SPIN_ADAPT_DECAY / 2 + OO_SPIN_ADAPT_DECAY - 1);
+  oo_spin_adapt_add(&sa, 100, MAX_SPIN, 99);
+  CHECK(sa.hist[oo_spin_adapt_bucket(100)], ==,
+        (OO_SPIN_ADAPT_DECAY / 2 + OO_SPIN_ADAPT_DECAY) / 2);
+  CHECK(sa.recent, ==, 0);
+
+  /* and a thread whose traffic goes quiet stops spinning */
+  for( i = 0; i < OO_SPIN_ADAPT_DECAY * 12; ++i )
+    oo_spin_adapt_add(&sa, MAX_SPIN * 2, MAX_SPIN, 99);
+  CHECK(sa.budget_bucket, ==, -1);
+}
+
+
+/* Make the following calls as if from thread [tid] */
+static void as_thread(int tid)
+{
+  oo_per_thread.initialised = 1;
+  oo_per_thread.spin_adapt_tid = tid;
+  oo_per_thread.spin_adapt_slot = -1;
+}
+
+
+static void test_slots(void)
+{
+  ci_netif* ni = unit_netif_alloc(0);
+  struct oo_spin_adapt* sa = ni->state->spin_adapt;
+  ci_uint64 now, idle = (ci_uint64) UNIT_NETIF_KHZ * 1000;
+  ci_uint64 budget;
+  int i, last = CI_CFG_SPIN_ADAPTIVE_THREADS - 1;
+
+  /* All but the last slot belong to threads that haven't waited lately */
+  ci_frc64(&now);
+  for( i = 0; i < last; ++i ) {
+    init_slot(&sa[i]);
+    sa[i].tid = 100 + i;
+    sa[i].budget_bucket = 3;
+    sa[i].last_frc = now - 2 * idle;
+  }
+
+  /* A newcomer takes the free slot, leaving the idle ones alone */
+  as_thread(1000);
+  budget = __oo_spin_budget(ni, MAX_SPIN);
+  CHECK(budget, ==, MAX_SPIN);
+  CHECK(sa[last].tid, ==, 1000);
+  CHECK(oo_per_thread.spin_adapt_slot, ==, last);
+  for( i = 0; i < last; ++i )
+    CHECK(sa[i].tid, ==, 100 + i);
+
+  /* Starting a wait keeps a thread's slot, even if it hasn't finished one
+   * for a long time */
+  as_thread(101);
+  budget = __oo_spin_budget(ni, MAX_SPIN);
+  CHECK(budget, ==, 16);
+  CHECK(oo_per_thread.spin_adapt_slot, ==, 1);
+
+  /* With no free slots left, idle ones are taken, with a fresh history */
+  as_thread(1001);
+  budget = __oo_spin_budget(ni, MAX_SPIN);
+  CHECK(budget, ==, MAX_SPIN);
+  CHECK(sa[0].tid, ==, 1001);
+  CHECK(sa[0].budget_bucket, ==, OO_SPIN_ADAPT_N_BUCKETS - 1);
+  as_thread(1002);
+  budget = __oo_spin_budget(ni, MAX_SPIN);
+  CHECK(sa[1].tid, ==, 101);
+  CHECK(sa[2].tid, ==, 1002);
+
+  /* and when none is idle, a thread spins for the full limit */
+  ci_frc64(&now);
+  for( i = 0; i <= last; ++i )
+    sa[i].last_frc = now;
+  as_thread(1003);
+  budget = __oo_spin_budget(ni, 1234);
+  CHECK(budget, ==, 1234);
+  CHECK(ni->state->stats.spin_adapt_no_slot, ==, 1);
+
+  unit_netif_free(ni);
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_buckets);
+  TEST_RUN(test_short_waits);
+  TEST_RUN(test_long_waits);
+  TEST_RUN(test_decay);
+  TEST_RUN(test_slots);
+  TEST_END();
+}
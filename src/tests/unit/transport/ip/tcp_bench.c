@@ -0,0 +1,693 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Micro-benchmarks for the TCP receive path and the timer wheel.
+ *
+ * These drive the real tcp_rx.c, tcp_misc.c and iptimer.c objects against
+ * a synthetic stack: one established connection and a single packet set,
+ * laid out in a netif state blob so that netif addresses resolve as they do
+ * in a real stack.  Anything outside those objects (transmit, packet
+ * allocation, socket wakeups) is stubbed below, so the figures measure
+ * protocol processing only.
+ *
+ * Each scenario prints one line of JSON to stdout:
+ *   {"bench":"<name>","ops":<n>,"cycles_per_op":<x>,"cycles_min":<y>}
+ * where cycles_per_op is the mean over all runs and cycles_min is from the
+ * fastest run.  Usage: tcp_bench [<ops-per-run> [<runs>]]
+ *
+ * Scenarios:
+ *  tcp_rx_in_order  full-sized in-order segments
+ *  tcp_rx_small     64 byte in-order segments
+ *  tcp_rx_ooo       every other segment arrives late: reorder buffer
+ *                   insertion, then the gap fill drains it
+ *  tcp_rx_ack       pure ACKs, each freeing one segment of a bulk send
+ *  tcp_rx_sack      loss recovery: dup ACKs carrying a growing SACK block,
+ *                   then a cumulative ACK for the whole window
+ *  timer_rearm      RTO-style modify of a pending timer
+ *  timer_rearm_lazy the same, pushing the timer back without requeueing it
+ *  timer_expire     timers spread over all wheels, run to expiry
+ *
+ * Figures from a debug build include the assertions: build with NDEBUG=1
+ * for figures worth comparing.  The checks made along the way confirm only
+ * that each scenario did what it was meant to.
+ */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define MSS          1448
+#define SMALL        64
+#define N_PKTS       PKTS_PER_SET
+#define N_TIMERS     4096
+/* Segments in flight for the ACK and SACK scenarios */
+#define SND_WINDOW   64
+#define LADDR        CI_BSWAPC_BE32(0x0a000001)
+#define RADDR        CI_BSWAPC_BE32(0x0a000002)
+#define LPORT        CI_BSWAPC_BE16(5201)
+#define RPORT        CI_BSWAPC_BE16(40000)
+#define ISS          1000000
+#define IRS          5000000
+#define START_TICKS  1000
+
+
+static ci_netif*       ni;
+static ci_tcp_state*   ts;
+static ci_ip_timer*    timers;
+static int             n_acks_sent;
+static int             n_retrans;
+static int             n_timeouts;
+
+static int cfg_ops = 100000;
+static int cfg_runs = 5;
+
+
+/**********************************************************************
+ * Dependencies
+ */
+
+void ci_assert_valid_pkt(ci_netif* netif, ci_ip_pkt_fmt* pkt,
+                         ci_boolean_t ni_locked,
+                         const char* file, int line)
+{
+}
+
+int
+ci_netif_filter_for_each_match(ci_netif* netif,
+                               unsigned laddr, unsigned lport,
+                               unsigned raddr, unsigned rport,
+                               unsigned protocol, int intf_i, int vlan,
+                               int (*callback)(ci_sock_cmn*, void*),
+                               void* callback_arg, ci_uint32* hash_out)
+{
+  return callback(&ts->s, callback_arg);
+}
+
+void ci_netif_pkt_free(ci_netif* netif, ci_ip_pkt_fmt* pkt)
+{
+  ci_netif_pkt_put(netif, pkt);
+}
+
+/* A real ACK would also advertise the window from the new rcv_nxt */
+void ci_tcp_send_ack_rx(ci_netif* netif, ci_tcp_state* tcp,
+                        ci_ip_pkt_fmt* pkt, int sock_locked, int update_window)
+{
+  ++n_acks_sent;
+  ts->acks_pending = 0;
+  tcp_rcv_wnd_right_edge_sent(ts) = tcp_rcv_nxt(ts) + ts->rcv_window_max;
+  if( pkt != NULL )
+    ci_netif_pkt_release(netif, pkt);
+}
+
+void ci_tcp_retrans_recover(ci_netif* netif, ci_tcp_state* tcp,
+                            int force_retrans_first)
+{
+  ++n_retrans;
+}
+
+int ci_tcp_retrans_one(ci_tcp_state* tcp, ci_netif* netif,
+                       ci_ip_pkt_fmt* pkt)
+{
+  ++n_retrans;
+  return 0;
+}
+
+void ci_netif_timeout_state(ci_netif* netif)
+{
+  ++n_timeouts;
+}
+
+
+/**********************************************************************
+ * Synthetic stack
+ */
+
+static void* alloc_zeroed(size_t bytes)
+{
+  void* p;
+
+  bytes = CI_ROUND_UP(bytes, CI_PAGE_SIZE);
+  p = aligned_alloc(CI_PAGE_SIZE, bytes);
+  memset(p, 0, bytes);
+  return p;
+}
+
+
+static ci_ip_pkt_fmt* pkt_get(void)
+{
+  oo_pktbuf_set* set = &ni->packets->set[0];
+  ci_ip_pkt_fmt* pkt;
+
+  CHECK_TRUE(OO_PP_NOT_NULL(set->free));
+  pkt = PKT(ni, set->free);
+  set->free = pkt->next;
+  --set->n_free;
+  --ni->packets->n_free;
+  pkt->next = OO_PP_NULL;
+  pkt->refcount = 1;
+  return pkt;
+}
+
+
+/* Allocations by the code under test come from the same pool */
+ci_ip_pkt_fmt* ci_netif_pkt_alloc_slow(ci_netif* netif, int flags)
+{
+  return pkt_get();
+}
+
+
+static void setup_stack(void)
+{
+  unsigned ep_ofs = CI_ROUND_UP(sizeof(ci_netif_state), CI_PAGE_SIZE);
+  unsigned timers_ofs = ep_ofs + EP_BUF_SIZE;
+  oo_pktbuf_manager* pm;
+  ci_ip_timer_state* ipts;
+  int i;
+
+  ni = calloc(1, sizeof(*ni));
+  ni->state = alloc_zeroed(timers_ofs + N_TIMERS * sizeof(ci_ip_timer));
+  *(ci_uint32*) &ni->state->ep_ofs = ep_ofs;
+  *(ci_uint32*) &ni->state->n_ep_bufs = 1;
+  ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  oo_p_dllink_init(ni, oo_p_dllink_ptr(ni, &ni->state->post_poll_list));
+
+  /* One packet set, all free */
+  pm = calloc(1, sizeof(*pm) + sizeof(pm->set[0]));
+  *(ci_uint32*) &pm->sets_n = 1;
+  *(ci_uint32*) &pm->sets_max = 1;
+  *(ci_int32*) &pm->n_pkts_allocated = N_PKTS;
+  ni->packets = pm;
+  ni->pkt_bufs = calloc(1, sizeof(ni->pkt_bufs[0]));
+  ni->pkt_bufs[0] = alloc_zeroed(N_PKTS * CI_CFG_PKT_BUF_SIZE);
+  pm->set[0].free = OO_PP_NULL;
+  for( i = N_PKTS - 1; i >= 0; --i ) {
+    ci_ip_pkt_fmt* pkt = (ci_ip_pkt_fmt*) __PKT_BUF(ni, i);
+    OO_PP_INIT(ni, pkt->pp, i);
+    ci_netif_pkt_put(ni, pkt);
+  }
+
+  /* A 1GHz clock, and ticks of 2^20 cycles: about a millisecond */
+  ipts = IPTIMER_STATE(ni);
+  ipts->khz = 1000000;
+  ipts->ci_ip_time_frc2tick = 20;
+  ipts->ci_ip_time_frc2us = 10;
+  ipts->ci_ip_time_ms2tick_fxp = 1ull << 32;
+  NI_CONF(ni).tconst_rto_initial = 1000;
+  NI_CONF(ni).tconst_rto_min = 201;
+  NI_CONF(ni).tconst_rto_max = 120000;
+  NI_CONF(ni).tconst_delack = CI_TCP_TCONST_DELACK;
+  NI_CONF(ni).tconst_idle = CI_TCP_TCONST_IDLE;
+  timers = (ci_ip_timer*) ((char*) ni->state + timers_ofs);
+}
+
+
+/* Empty the timer wheel and rewind the clock */
+static void reset_timers(void)
+{
+  ci_ip_timer_state* ipts = IPTIMER_STATE(ni);
+  int i;
+
+  ipts->frc = (ci_uint64) START_TICKS << ipts->ci_ip_time_frc2tick;
+  ipts->ci_ip_time_real_ticks = START_TICKS;
+  ipts->sched_ticks = START_TICKS;
+  ipts->closest_timer = ipts->sched_ticks + 2 * CI_IPTIME_BUCKETS;
+  memset(ipts->busy_mask, 0, sizeof(ipts->busy_mask));
+  memset(ipts->cascade_count, 0, sizeof(ipts->cascade_count));
+  ipts->cascade_left = 0;
+  oo_p_dllink_init(ni, oo_p_dllink_ptr(ni, &ipts->fire_list));
+  for( i = 0; i < CI_IPTIME_WHEELSIZE; ++i )
+    oo_p_dllink_init(ni, oo_p_dllink_ptr(ni, &ipts->warray[i]));
+
+  for( i = 0; i < N_TIMERS; ++i ) {
+    timers[i].fn = CI_IP_TIMER_NETIF_TIMEOUT;
+    ci_ip_timer_init(ni, &timers[i],
+                     oo_state_ptr_to_statep(ni, &timers[i]), "bnch");
+  }
+  n_timeouts = 0;
+}
+
+
+static void setup_timer(ci_ip_timer* t, int fn)
+{
+  t->fn = fn;
+  ci_ip_timer_init(ni, t, oo_state_ptr_to_statep(ni, t), "bnch");
+}
+
+
+/* Return every packet the socket holds to the free pool */
+static void drop_queue(ci_ip_pkt_queue* q)
+{
+  while( OO_PP_NOT_NULL(q->head) ) {
+    ci_ip_pkt_fmt* pkt = PKT(ni, q->head);
+    q->head = pkt->next;
+    ci_netif_pkt_free(ni, pkt);
+  }
+}
+
+
+/* An established connection with window scaling, timestamps and SACK, as
+ * most real connections are.
+ */
+static void setup_socket(void)
+{
+  int i;
+
+  if( ts != NULL ) {
+    drop_queue(&ts->recv1);
+    drop_queue(&ts->rob);
+    drop_queue(&ts->retrans);
+  }
+  CHECK(ni->packets->n_free, ==, N_PKTS);
+  reset_timers();
+
+  ts = (ci_tcp_state*) oo_sockp_to_ptr(ni, OO_SP_FROM_INT(ni, 0));
+  memset(ts, 0, sizeof(*ts));
+  ts->s.b.bufid = 0;
+  ts->s.b.state = CI_TCP_ESTABLISHED;
+  oo_p_dllink_init(ni, oo_p_dllink_sb(ni, &ts->s.b, &ts->s.b.post_poll_link));
+
+  ts->s.pkt.ether_type = CI_ETHERTYPE_IP;
+  /* No route: keeps the control plane out of the ACK path */
+  ts->s.pkt.fwd_ver.id = CICP_MAC_ROWID_BAD;
+  ts->s.pkt.ipx.ip4.ip_saddr_be32 = LADDR;
+  ts->s.pkt.ipx.ip4.ip_daddr_be32 = RADDR;
+  ts->s.laddr = CI_ADDR_FROM_IP4(LADDR);
+  TS_IPX_TCP(ts)->tcp_source_be16 = LPORT;
+  TS_IPX_TCP(ts)->tcp_dest_be16 = RPORT;
+  ts->s.so.rcvbuf = 64 << 20;
+  ts->s.so.sndbuf = 64 << 20;
+
+  ci_ip_queue_init(&ts->recv1);
+  ci_ip_queue_init(&ts->recv2);
+  TS_QUEUE_RX_SET(ts, recv1);
+  ts->recv1_extract = OO_PP_NULL;
+  ci_ip_queue_init(&ts->rob);
+  ci_ip_queue_init(&ts->send);
+  ci_ip_queue_init(&ts->retrans);
+  for( i = 0; i <= CI_TCP_SACK_MAX_BLOCKS; ++i )
+    ts->last_sack[i] = OO_PP_NULL;
+  ts->dsack_block = OO_PP_INVALID;
+  ts->pmtus = OO_PP_NULL;
+  ts->tmpl_head = OO_PP_NULL;
+  ts->local_peer = OO_SP_NULL;
+  oo_p_dllink_init(ni, oo_p_dllink_sb(ni, &ts->s.b, &ts->timeout_q_link));
+  setup_timer(&ts->rto_tid, CI_IP_TIMER_TCP_RTO);
+  setup_timer(&ts->delack_tid, CI_IP_TIMER_TCP_DELACK);
+  setup_timer(&ts->zwin_tid, CI_IP_TIMER_TCP_ZWIN);
+  setup_timer(&ts->kalive_tid, CI_IP_TIMER_TCP_KALIVE);
+  setup_timer(&ts->cork_tid, CI_IP_TIMER_TCP_CORK);
+#if CI_CFG_TCP_SOCK_STATS
+  setup_timer(&ts->stats_tid, CI_IP_TIMER_TCP_STATS);
+#endif
+#if CI_CFG_TCP_PACING
+  setup_timer(&ts->pace_tid, CI_IP_TIMER_TCP_PACE);
+#endif
+
+  ts->tcpflags = CI_TCPT_FLAG_TSO | CI_TCPT_FLAG_WSCL | CI_TCPT_FLAG_SACK;
+  ts->incoming_tcp_hdr_len = sizeof(ci_tcp_hdr) + 12;
+  ts->outgoing_hdrs_len = sizeof(ci_ip4_hdr) + sizeof(ci_tcp_hdr) + 12;
+  ts->snd_wscl = ts->rcv_wscl = 7;
+  ts->eff_mss = ts->amss = ts->smss = MSS;
+  ts->congstate = CI_TCP_CONG_OPEN;
+  ts->cwnd = 1000 * MSS;
+  ts->ssthresh = 1000 * MSS;
+  ts->rto = 200;
+  ts->sa = 10 << 3;
+  ts->sv = 5 << 2;
+
+  tcp_snd_una(ts) = tcp_snd_nxt(ts) = tcp_enq_nxt(ts) = ISS;
+  ts->snd_max = ISS + (32 << 20);
+  tcp_rcv_nxt(ts) = IRS;
+  ts->rcv_window_max = 32 << 20;
+  tcp_rcv_wnd_advertised(ts) = 32 << 20;
+  tcp_rcv_wnd_right_edge_sent(ts) = IRS + (32 << 20);
+  tcp_rcv_up(ts) = IRS - 1;
+  ts->t_last_recv_ack = ts->t_last_recv_payload = ci_tcp_time_now(ni);
+  ci_tcp_fast_path_enable(ts);
+
+  n_acks_sent = n_retrans = 0;
+}
+
+
+/* Make [pkt] look like it has just been received: Ethernet, IPv4 and a
+ * TCP header with an aligned timestamp option, followed by [paylen] bytes.
+ * [sack] optionally adds SACK blocks after the timestamp.
+ */
+static ci_tcp_hdr* fill_rx_pkt(ci_ip_pkt_fmt* pkt, unsigned seq, unsigned ack,
+                               int paylen, const unsigned* sack, int n_sack)
+{
+  int opt_len = 12 + (n_sack ? 4 + 8 * n_sack : 0);
+  int ip_len = sizeof(ci_ip4_hdr) + sizeof(ci_tcp_hdr) + opt_len + paylen;
+  ci_ip4_hdr* ip;
+  ci_tcp_hdr* tcp;
+  ci_uint32* opt;
+  int i;
+
+  pkt->pkt_start_off = 0;
+  pkt->pkt_eth_payload_off = ETH_HLEN;
+  pkt->frag_next = OO_PP_NULL;
+  pkt->intf_i = 0;
+  pkt->vlan = 0;
+  pkt->flags = CI_PKT_FLAG_RX;
+  pkt->q_id = CI_Q_ID_NORMAL;
+  pkt->pay_len = ETH_HLEN + ip_len;
+  pkt->buf_len = pkt->pay_len;
+  oo_pkt_af_set(pkt, AF_INET);
+  oo_ether_hdr(pkt)->ether_type = CI_ETHERTYPE_IP;
+
+  ip = oo_ip_hdr(pkt);
+  ip->ip_ihl_version = CI_IP4_IHL_VERSION(sizeof(*ip));
+  ip->ip_tos = 0;
+  ip->ip_tot_len_be16 = CI_BSWAP_BE16(ip_len);
+  ip->ip_frag_off_be16 = CI_IP4_FRAG_DONT;
+  ip->ip_protocol = IPPROTO_TCP;
+  ip->ip_saddr_be32 = RADDR;
+  ip->ip_daddr_be32 = LADDR;
+
+  tcp = (ci_tcp_hdr*) (ip + 1);
+  tcp->tcp_source_be16 = RPORT;
+  tcp->tcp_dest_be16 = LPORT;
+  tcp->tcp_seq_be32 = CI_BSWAP_BE32(seq);
+  tcp->tcp_ack_be32 = CI_BSWAP_BE32(ack);
+  CI_TCP_HDR_SET_LEN(tcp, sizeof(*tcp) + opt_len);
+  tcp->tcp_flags = CI_TCP_FLAG_ACK;
+  tcp->tcp_window_be16 = CI_BSWAPC_BE16(0xffff);
+  tcp->tcp_urg_ptr_be16 = 0;
+
+  opt = (ci_uint32*) CI_TCP_HDR_OPTS(tcp);
+  opt[0] = CI_TCP_TSO_WORD;
+  opt[1] = CI_BSWAP_BE32(ci_tcp_time_now(ni));
+  opt[2] = CI_BSWAP_BE32(ci_tcp_time_now(ni));
+  if( n_sack ) {
+    opt[3] = CI_BSWAP_BE32((CI_TCP_OPT_NOP << 24) | (CI_TCP_OPT_NOP << 16) |
+                           (CI_TCP_OPT_SACK << 8) | (2 + 8 * n_sack));
+    for( i = 0; i < n_sack; ++i ) {
+      opt[4 + 2 * i] = CI_BSWAP_BE32(sack[2 * i]);
+      opt[5 + 2 * i] = CI_BSWAP_BE32(sack[2 * i + 1]);
+    }
+  }
+  return tcp;
+}
+
+
+static void rx_deliver(unsigned seq, unsigned ack, int paylen,
+                       const unsigned* sack, int n_sack)
+{
+  ci_ip_pkt_fmt* pkt = pkt_get();
+  ci_tcp_hdr* tcp = fill_rx_pkt(pkt, seq, ack, paylen, sack, n_sack);
+  struct ci_netif_poll_state ps;
+
+  memset(&ps, 0, sizeof(ps));
+  ni->state->in_poll = 1;
+  ci_tcp_handle_rx(ni, &ps, pkt, tcp,
+                   CI_BSWAP_BE16(oo_ip_hdr(pkt)->ip_tot_len_be16) -
+                   sizeof(ci_ip4_hdr));
+  ni->state->in_poll = 0;
+}
+
+
+/* Stand in for the rest of a poll: the post-poll ACK, and an application
+ * that consumes everything it has been given.
+ */
+static void rx_poll_done(void)
+{
+  ci_ip_pkt_queue* rxq = &ts->recv1;
+
+  oo_p_dllink_del_init(ni, oo_p_dllink_sb(ni, &ts->s.b,
+                                          &ts->s.b.post_poll_link));
+  ts->s.b.sb_flags = 0;
+  if( ts->acks_pending )
+    ci_tcp_send_ack_rx(ni, ts, NULL, 0, 0);
+
+  if( ci_ip_queue_not_empty(rxq) ) {
+    oo_offbuf_empty(&PKT(ni, rxq->tail)->buf);
+    ts->recv1_extract = rxq->tail;
+  }
+  ts->rcv_delivered = ts->rcv_added;
+  ci_tcp_rx_reap_rxq_bufs(ni, ts);
+}
+
+
+/* Queue [n] full-sized segments as sent and awaiting acknowledgement.
+ * Only the fields used by ACK processing are filled in.
+ */
+static void tx_fill(int n)
+{
+  while( n-- ) {
+    ci_ip_pkt_fmt* pkt = pkt_get();
+
+    pkt->pkt_start_off = 0;
+    pkt->pkt_eth_payload_off = ETH_HLEN;
+    pkt->frag_next = OO_PP_NULL;
+    pkt->flags = 0;
+    oo_pkt_af_set(pkt, AF_INET);
+    pkt->pf.tcp_tx.start_seq = tcp_enq_nxt(ts);
+    tcp_enq_nxt(ts) += MSS;
+    pkt->pf.tcp_tx.end_seq = tcp_enq_nxt(ts);
+    pkt->pf.tcp_tx.block_end = OO_PP_NULL;
+    ci_ip_queue_enqueue(ni, &ts->retrans, pkt);
+  }
+  tcp_snd_nxt(ts) = tcp_enq_nxt(ts);
+  ts->snd_max = tcp_snd_nxt(ts) + (32 << 20);
+  ci_tcp_rto_check_and_set(ni, ts);
+}
+
+
+/**********************************************************************
+ * Measurement
+ */
+
+struct result {
+  ci_uint64 cycles;
+  ci_uint64 best;
+  ci_uint64 ops;
+};
+
+
+static void result_add(struct result* r, ci_uint64 cycles, int ops)
+{
+  r->cycles += cycles;
+  r->ops += ops;
+  if( r->best == 0 || cycles < r->best )
+    r->best = cycles;
+}
+
+
+static void report(const char* name, const struct result* r, int ops_per_run)
+{
+  printf("{\"bench\":\"%s\",\"ops\":%llu,\"cycles_per_op\":%.1f,"
+         "\"cycles_min\":%.1f}\n", name, (unsigned long long) r->ops,
+         (double) r->cycles / r->ops, (double) r->best / ops_per_run);
+  fflush(stdout);
+}
+
+
+/**********************************************************************
+ * Scenarios
+ */
+
+/* Receive [cfg_ops] segments of [paylen] bytes in order.  The application
+ * reads after every 32, as it might after a poll.
+ */
+static void bench_rx_in_order(const char* name, int paylen)
+{
+  struct result r = {};
+  ci_uint64 start;
+  int run, i;
+
+  for( run = 0; run < cfg_runs; ++run ) {
+    setup_socket();
+    start = ci_frc64_get();
+    for( i = 0; i < cfg_ops; ++i ) {
+      rx_deliver(IRS + i * paylen, ISS, paylen, NULL, 0);
+      if( (i & 31) == 31 )
+        rx_poll_done();
+    }
+    result_add(&r, ci_frc64_get() - start, cfg_ops);
+    rx_poll_done();
+    CHECK(tcp_rcv_nxt(ts), ==, IRS + cfg_ops * paylen);
+    CHECK(ts->rob.num, ==, 0);
+  }
+  report(name, &r, cfg_ops);
+}
+
+
+static void bench_rx_ooo(void)
+{
+  struct result r = {};
+  ci_uint64 start;
+  int run, i;
+
+  for( run = 0; run < cfg_runs; ++run ) {
+    setup_socket();
+    start = ci_frc64_get();
+    for( i = 0; i + 1 < cfg_ops; i += 2 ) {
+      rx_deliver(IRS + (i + 1) * MSS, ISS, MSS, NULL, 0);
+      rx_deliver(IRS + i * MSS, ISS, MSS, NULL, 0);
+      if( (i & 31) == 30 )
+        rx_poll_done();
+    }
+    result_add(&r, ci_frc64_get() - start, i);
+    rx_poll_done();
+    CHECK(tcp_rcv_nxt(ts), ==, IRS + i * MSS);
+    CHECK(ts->rob.num, ==, 0);
+  }
+  report("tcp_rx_ooo", &r, cfg_ops & ~1);
+}
+
+
+static void bench_rx_ack(void)
+{
+  struct result r = {};
+  ci_uint64 start;
+  int run, i;
+
+  for( run = 0; run < cfg_runs; ++run ) {
+    setup_socket();
+    tx_fill(SND_WINDOW);
+    start = ci_frc64_get();
+    for( i = 0; i < cfg_ops; ++i ) {
+      rx_deliver(IRS, tcp_snd_una(ts) + MSS, 0, NULL, 0);
+      rx_poll_done();
+      tx_fill(1);
+    }
+    result_add(&r, ci_frc64_get() - start, cfg_ops);
+    CHECK(tcp_snd_una(ts), ==, ISS + cfg_ops * MSS);
+    CHECK(ts->retrans.num, ==, SND_WINDOW);
+  }
+  report("tcp_rx_ack", &r, cfg_ops);
+}
+
+
+/* In each window of SND_WINDOW segments the first is lost.  Every other
+ * segment provokes a dup ACK SACKing everything received so far, which
+ * after the third puts the connection into recovery.  The retransmission
+ * then arrives and is ACKed along with the rest of the window.
+ */
+static void bench_rx_sack(void)
+{
+  struct result r = {};
+  int windows = CI_MAX(cfg_ops / SND_WINDOW, 1);
+  ci_uint64 start;
+  unsigned una, sack[2];
+  int run, w, i;
+
+  for( run = 0; run < cfg_runs; ++run ) {
+    setup_socket();
+    start = ci_frc64_get();
+    for( w = 0; w < windows; ++w ) {
+      tx_fill(SND_WINDOW);
+      una = tcp_snd_una(ts);
+      for( i = 1; i < SND_WINDOW; ++i ) {
+        sack[0] = una + MSS;
+        sack[1] = una + (i + 1) * MSS;
+        rx_deliver(IRS, una, 0, sack, 1);
+        rx_poll_done();
+      }
+      rx_deliver(IRS, una + SND_WINDOW * MSS, 0, NULL, 0);
+      rx_poll_done();
+    }
+    result_add(&r, ci_frc64_get() - start, windows * SND_WINDOW);
+    CHECK(tcp_snd_una(ts), ==, ISS + windows * SND_WINDOW * MSS);
+    CHECK(ts->retrans.num, ==, 0);
+    CHECK(n_retrans, >=, windows);
+  }
+  report("tcp_rx_sack", &r, windows * SND_WINDOW);
+}
+
+
+/* Most timers are re-armed many times for each time that they fire: this
+ * is the RTO restart made for every ACK of new data.
+ */
+static void bench_timer_rearm(const char* name, int lazy)
+{
+  struct result r = {};
+  ci_uint64 start;
+  ci_iptime_t now;
+  int run, i;
+
+  for( run = 0; run < cfg_runs; ++run ) {
+    reset_timers();
+    now = ci_ip_time_now(ni);
+    for( i = 0; i < N_TIMERS; ++i )
+      ci_ip_timer_set(ni, &timers[i], now + 200);
+    start = ci_frc64_get();
+    for( i = 0; i < cfg_ops; ++i )
+      if( lazy )
+        ci_ip_timer_modify_lazy(ni, &timers[i & (N_TIMERS - 1)],
+                                now + 200 + (i & 1023));
+      else
+        ci_ip_timer_modify(ni, &timers[i & (N_TIMERS - 1)],
+                           now + 200 + (i & 1023));
+    result_add(&r, ci_frc64_get() - start, cfg_ops);
+    for( i = 0; i < N_TIMERS; ++i )
+      ci_ip_timer_clear(ni, &timers[i]);
+  }
+  report(name, &r, cfg_ops);
+}
+
+
+/* Timeouts from one tick to about a minute, run to expiry one tick at a
+ * time as a busy stack would.  This includes the cost of cascading timers
+ * down from the outer wheels.
+ */
+static void bench_timer_expire(void)
+{
+  ci_ip_timer_state* ipts = IPTIMER_STATE(ni);
+  struct result r = {};
+  ci_uint64 start;
+  ci_iptime_t now, t, last;
+  int run, i;
+
+  for( run = 0; run < cfg_runs; ++run ) {
+    reset_timers();
+    now = last = ci_ip_time_now(ni);
+    for( i = 0; i < N_TIMERS; ++i ) {
+      /* Roughly log-uniform over 1 to 2^16 ticks */
+      t = now + 1 + ((i * 2654435761u) & ((2u << (i & 15)) - 1));
+      ci_ip_timer_set(ni, &timers[i], t);
+      if( TIME_GT(t, last) )
+        last = t;
+    }
+    start = ci_frc64_get();
+    while( TIME_LT(ipts->sched_ticks, last) ) {
+      ++ipts->ci_ip_time_real_ticks;
+      ci_ip_timer_poll(ni);
+    }
+    result_add(&r, ci_frc64_get() - start, N_TIMERS);
+    CHECK(n_timeouts, ==, N_TIMERS);
+  }
+  report("timer_expire", &r, N_TIMERS);
+}
+
+
+static void test_tcp_bench(void)
+{
+  setup_stack();
+  bench_rx_in_order("tcp_rx_in_order", MSS);
+  bench_rx_in_order("tcp_rx_small", SMALL);
+  bench_rx_ooo();
+  bench_rx_ack();
+  bench_rx_sack();
+  bench_timer_rearm("timer_rearm", 0);
+  bench_timer_rearm("timer_rearm_lazy", 1);
+  bench_timer_expire();
+}
+
+
+int main(int argc, char* argv[])
+{
+  if( argc > 1 )
+    cfg_ops = atoi(argv[1]);
+  if( argc > 2 )
+    cfg_runs = atoi(argv[2]);
+  TEST_RUN(test_tcp_bench);
+  TEST_END();
+}
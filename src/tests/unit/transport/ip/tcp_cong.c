@@ -0,0 +1,356 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+#include <ci/net/sockopts.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_netif.h"
+
+#define MSS 1000
+#define CYCLES_PER_MS (UNIT_NETIF_KHZ)
+
+/* Modes private to tcp_cong.c */
+#define BBR_STARTUP   0
+#define BBR_PROBE_BW  2
+
+
+static ci_netif* alloc_netif(void)
+{
+  ci_netif* ni = unit_netif_alloc(0);
+  IPTIMER_STATE(ni)->frc = 1000 * CYCLES_PER_MS;
+  return ni;
+}
+
+static ci_tcp_state* alloc_ts(ci_netif* ni, int alg)
+{
+  ci_tcp_state* ts = calloc(1, sizeof(*ts));
+  ts->s.b.state = CI_TCP_CLOSED;
+  ts->eff_mss = MSS;
+  ts->c.cong_alg = alg;
+#if CI_CFG_TCP_PACING
+  ts->c.max_pacing_rate = CI_TCP_PACING_RATE_UNLIMITED;
+#endif
+  ts->congstate = CI_TCP_CONG_OPEN;
+  ts->cwnd = 10 * MSS;
+  ts->ssthresh = 65535;
+  ts->snd_una = ts->snd_nxt = 1000;
+  ts->sa = 10 << 3;   /* srtt 10ms */
+  ci_tcp_cong_init(ni, ts);
+  return ts;
+}
+
+
+static void test_cong_names(void)
+{
+  CHECK(ci_tcp_cong_by_name("reno"), ==, EF_TCP_CONG_CONTROL_RENO);
+  CHECK(ci_tcp_cong_by_name("cubic"), ==, EF_TCP_CONG_CONTROL_CUBIC);
+  CHECK(ci_tcp_cong_by_name("bbr"), ==, EF_TCP_CONG_CONTROL_BBR);
+  CHECK(ci_tcp_cong_by_name("dctcp"), ==, EF_TCP_CONG_CONTROL_DCTCP);
+  CHECK(ci_tcp_cong_by_name("vegas"), ==, -ENOENT);
+  CHECK(ci_tcp_cong_by_name(""), ==, -ENOENT);
+  CHECK_TRUE(strcmp(ci_tcp_cong_name(EF_TCP_CONG_CONTROL_CUBIC), "cubic")
+             == 0);
+}
+
+
+static void test_reno_losswnd(void)
+{
+  ci_netif* ni = alloc_netif();
+  ci_tcp_state* ts = alloc_ts(ni, EF_TCP_CONG_CONTROL_RENO);
+
+  ts->snd_nxt = ts->snd_una + 100 * MSS;
+  CHECK(ci_tcp_cong_losswnd(ni, ts), ==, 50 * MSS);
+
+  free(ts);
+  unit_netif_free(ni);
+}
+
+
+static void test_cubic_loss(void)
+{
+  ci_netif* ni = alloc_netif();
+  ci_tcp_state* ts = alloc_ts(ni, EF_TCP_CONG_CONTROL_CUBIC);
+  unsigned ssthresh;
+
+  /* beta = 0.7 */
+  ts->cwnd = 100 * MSS;
+  ts->snd_nxt = ts->snd_una + 100 * MSS;
+  ts->cong.cubic.epoch_start = 1;
+  ssthresh = ci_tcp_cong_losswnd(ni, ts);
+  CHECK(ssthresh, ==, 100 * MSS * 717 / 1024);
+  CHECK(ts->cong.cubic.w_max, ==, 100 * MSS);
+  CHECK(ts->cong.cubic.epoch_start, ==, 0);
+
+  /* Fast convergence: a second loss below w_max lowers it further */
+  ts->snd_nxt = ts->snd_una + 80 * MSS;
+  ci_tcp_cong_losswnd(ni, ts);
+  CHECK(ts->cong.cubic.w_max, ==, 80 * MSS * 870 / 1024);
+
+  free(ts);
+  unit_netif_free(ni);
+}
+
+
+static void test_cubic_growth(void)
+{
+  ci_netif* ni = alloc_netif();
+  ci_tcp_state* ts = alloc_ts(ni, EF_TCP_CONG_CONTROL_CUBIC);
+  unsigned prev;
+  int i;
+
+  /* Long RTT, so that the cubic function rather than the reno-friendly
+   * estimate drives the window */
+  ts->sa = 100 << 3;
+
+  ts->cwnd = 100 * MSS;
+  ts->snd_nxt = ts->snd_una + 100 * MSS;
+  ts->ssthresh = ci_tcp_cong_losswnd(ni, ts);
+  ts->cwnd = ts->ssthresh;
+
+  /* K = cbrt(W_max * (1 - beta) / C) = cbrt(30 / 0.4) s ~= 4.2 s */
+  ts->bytes_acked = ts->cwnd;
+  ci_tcp_cong_on_ack(ni, ts, ts->snd_una + ts->cwnd, ts->cwnd);
+  CHECK(ts->cong.cubic.k, >=, 4200);
+  CHECK(ts->cong.cubic.k, <=, 4230);
+  CHECK(ts->cong.cubic.origin, ==, 100 * MSS);
+
+  /* Concave growth towards w_max, one window per RTT */
+  prev = ts->cwnd;
+  for( i = 0; i < 42; ++i ) {
+    IPTIMER_STATE(ni)->frc += 100 * CYCLES_PER_MS;
+    ts->bytes_acked += ts->cwnd;
+    ci_tcp_cong_on_ack(ni, ts, ts->snd_una + ts->cwnd, ts->cwnd);
+    CHECK(ts->cwnd, >=, prev);
+    prev = ts->cwnd;
+  }
+  CHECK(ts->cwnd, >=, 98 * MSS);
+  CHECK(ts->cwnd, <=, 102 * MSS);
+
+  /* Then convex growth beyond it */
+  for( i = 0; i < 30; ++i ) {
+    IPTIMER_STATE(ni)->frc += 100 * CYCLES_PER_MS;
+    ts->bytes_acked += ts->cwnd;
+    ci_tcp_cong_on_ack(ni, ts, ts->snd_una + ts->cwnd, ts->cwnd);
+  }
+  CHECK(ts->cwnd, >, 110 * MSS);
+
+  /* No growth in recovery */
+  prev = ts->cwnd;
+  ts->congstate = CI_TCP_CONG_FAST_RECOV;
+  ts->bytes_acked += ts->cwnd;
+  ci_tcp_cong_on_ack(ni, ts, ts->snd_una + ts->cwnd, ts->cwnd);
+  CHECK(ts->cwnd, ==, prev);
+  CHECK(ts->bytes_acked, ==, 0);
+
+  free(ts);
+  unit_netif_free(ni);
+}
+
+
+/* One round trip over a path with 10ms RTT, delivering at most [limit]
+ * bytes per round. */
+static void bbr_round(ci_netif* ni, ci_tcp_state* ts, unsigned limit)
+{
+  unsigned acked = CI_MIN(SEQ_SUB(ts->snd_nxt, ts->snd_una), limit);
+  ci_uint32 ack = ts->snd_una + acked;
+
+  IPTIMER_STATE(ni)->frc += 10 * CYCLES_PER_MS;
+  ts->bytes_acked += acked;
+  ci_tcp_cong_on_ack(ni, ts, ack, acked);
+  ts->snd_una = ack;
+  /* Backlogged sender: fill the window */
+  if( SEQ_SUB(ts->snd_nxt, ts->snd_una) < ts->cwnd )
+    ts->snd_nxt = ts->snd_una + ts->cwnd;
+}
+
+static void test_bbr_startup(void)
+{
+  ci_netif* ni = alloc_netif();
+  ci_tcp_state* ts = alloc_ts(ni, EF_TCP_CONG_CONTROL_BBR);
+  const unsigned bdp = 200 * MSS;
+  struct ci_tcp_info info;
+  int i;
+
+  ts->send.num = 1;
+  ts->snd_nxt = ts->snd_una + ts->cwnd;
+  CHECK(ts->cong.bbr.mode, ==, BBR_STARTUP);
+
+  /* STARTUP doubles cwnd each round until the bottleneck is found */
+  for( i = 0; i < 4; ++i )
+    bbr_round(ni, ts, bdp);
+  CHECK(ts->cong.bbr.mode, ==, BBR_STARTUP);
+  CHECK(ts->cwnd, ==, 10 * MSS << 4);
+
+  for( i = 0; i < 20; ++i )
+    bbr_round(ni, ts, bdp);
+  CHECK(ts->cong.bbr.mode, ==, BBR_PROBE_BW);
+  CHECK_TRUE(ts->cong.bbr.flags & 1);
+
+  /* The model converges on the path */
+  CHECK(ts->cong.bbr.min_rtt, ==, (10 * CYCLES_PER_MS) >> UNIT_NETIF_FRC2US);
+  CHECK(((ci_uint64) ts->cong.bbr.bw[0] * ts->cong.bbr.min_rtt) >> 10, >=,
+        bdp - MSS);
+  CHECK(ts->cwnd, <=, 2 * bdp + 3 * MSS);
+  CHECK(ts->cwnd, >=, bdp);
+
+  memset(&info, 0, sizeof(info));
+  ci_tcp_cong_get_info(ni, ts, &info);
+  /* 200KB per 10ms, at ~1us usticks */
+  CHECK(info.tcpi_delivery_rate, >=, 19000000);
+  CHECK(info.tcpi_delivery_rate, <=, 21000000);
+  CHECK(info.tcpi_min_rtt, >=, 9900);
+  CHECK(info.tcpi_min_rtt, <=, 10000);
+  CHECK(info.tcpi_pacing_rate, >=, info.tcpi_delivery_rate * 3 / 4);
+
+  free(ts);
+  unit_netif_free(ni);
+}
+
+
+static void test_bbr_loss(void)
+{
+  ci_netif* ni = alloc_netif();
+  ci_tcp_state* ts = alloc_ts(ni, EF_TCP_CONG_CONTROL_BBR);
+  unsigned cwnd;
+  int i;
+
+  ts->send.num = 1;
+  ts->snd_nxt = ts->snd_una + ts->cwnd;
+  for( i = 0; i < 30; ++i )
+    bbr_round(ni, ts, 100 * MSS);
+  cwnd = ts->cwnd;
+
+  /* Loss saves cwnd, and recovery restores it */
+  ts->ssthresh = ci_tcp_cong_losswnd(ni, ts);
+  CHECK(ts->cong.bbr.prior_cwnd, ==, cwnd);
+  ts->congstate = CI_TCP_CONG_FAST_RECOV;
+  ts->cwnd = ts->ssthresh;
+  ci_tcp_cong_recovered(ni, ts);
+  CHECK(ts->cwnd, ==, cwnd);
+
+  free(ts);
+  unit_netif_free(ni);
+}
+
+
+/* One window of data acked, with [ce] segments out of 10 marked.  The
+ * sender keeps 10 segments in flight. */
+static void dctcp_window(ci_netif* ni, ci_tcp_state* ts, int ce)
+{
+  int i;
+
+  for( i = 0; i < 10; ++i ) {
+    ts->snd_una += MSS;
+    ci_tcp_cong_ecn_ack(ni, ts, ts->snd_una, MSS, i < ce);
+    ts->snd_nxt = ts->snd_una + 10 * MSS;
+  }
+}
+
+static void test_dctcp(void)
+{
+  ci_netif* ni = alloc_netif();
+  ci_tcp_state* ts = alloc_ts(ni, EF_TCP_CONG_CONTROL_DCTCP);
+  int i;
+
+  ts->snd_nxt = ts->snd_una + 10 * MSS;
+  ci_tcp_cong_init(ni, ts);
+
+  /* Until alpha is known, ECE halves the window */
+  ts->cwnd = 100 * MSS;
+  CHECK(ci_tcp_cong_ecn_losswnd(ni, ts), ==, 50 * MSS);
+
+  /* Without marks, alpha decays to zero and ECE barely cuts the window */
+  for( i = 0; i < 200; ++i )
+    dctcp_window(ni, ts, 0);
+  CHECK(ts->cong.dctcp.alpha, ==, 0);
+  CHECK(ci_tcp_cong_ecn_losswnd(ni, ts), ==, 100 * MSS);
+
+  /* With half of the bytes marked, alpha converges to 1/2 (give or take
+   * the rounding of the decay), and the window is cut by a quarter */
+  for( i = 0; i < 200; ++i )
+    dctcp_window(ni, ts, 5);
+  CHECK(ts->cong.dctcp.alpha, >=, 500);
+  CHECK(ts->cong.dctcp.alpha, <=, 512 + 16);
+  CHECK(ci_tcp_cong_ecn_losswnd(ni, ts), >=, 74 * MSS);
+  CHECK(ci_tcp_cong_ecn_losswnd(ni, ts), <=, 76 * MSS);
+
+  /* Never below two segments */
+  ts->cwnd = 2 * MSS;
+  CHECK(ci_tcp_cong_ecn_losswnd(ni, ts), ==, 2 * MSS);
+
+  /* Loss is reno's */
+  ts->snd_nxt = ts->snd_una + 100 * MSS;
+  CHECK(ci_tcp_cong_losswnd(ni, ts), ==, 50 * MSS);
+
+  free(ts);
+  unit_netif_free(ni);
+}
+
+
+#if CI_CFG_TCP_PACING
+static void test_pacing(void)
+{
+  ci_netif* ni = alloc_netif();
+  ci_tcp_state* ts = alloc_ts(ni, EF_TCP_CONG_CONTROL_RENO);
+  struct ci_tcp_info info;
+  int budget;
+
+  /* Not paced by default */
+  CHECK(ci_tcp_pace_budget(ni, ts), ==, -1);
+
+  /* SO_MAX_PACING_RATE alone: 1MB/s, with a burst of two segments */
+  ts->c.max_pacing_rate = 1000000;
+  CHECK(ci_tcp_pace_budget(ni, ts), ==, 2 * MSS);
+  ci_tcp_pace_sent(ni, ts, 2 * MSS);
+  CHECK(ci_tcp_pace_budget(ni, ts), ==, 0);
+  IPTIMER_STATE(ni)->frc += CYCLES_PER_MS;
+  budget = ci_tcp_pace_budget(ni, ts);
+  CHECK(budget, >=, 990);
+  CHECK(budget, <=, 1010);
+  ci_tcp_pace_sent(ni, ts, budget);
+  IPTIMER_STATE(ni)->frc += 100 * CYCLES_PER_MS;
+  CHECK(ci_tcp_pace_budget(ni, ts), ==, 2 * MSS);
+
+  /* EF_TCP_PACING: twice cwnd/srtt in slow start */
+  NI_OPTS(ni).tcp_pacing = 1;
+  ts->c.max_pacing_rate = CI_TCP_PACING_RATE_UNLIMITED;
+  memset(&info, 0, sizeof(info));
+  ci_tcp_cong_get_info(ni, ts, &info);
+  CHECK(info.tcpi_pacing_rate, >=, 1800000);
+  CHECK(info.tcpi_pacing_rate, <=, 2000000);
+
+  /* ... and capped by SO_MAX_PACING_RATE */
+  ts->c.max_pacing_rate = 500000;
+  memset(&info, 0, sizeof(info));
+  ci_tcp_cong_get_info(ni, ts, &info);
+  CHECK(info.tcpi_pacing_rate, >=, 490000);
+  CHECK(info.tcpi_pacing_rate, <=, 510000);
+
+  /* No rate can be derived from an RTT below a tick */
+  ts->c.max_pacing_rate = CI_TCP_PACING_RATE_UNLIMITED;
+  ts->sa = 4;
+  CHECK(ci_tcp_pace_budget(ni, ts), ==, -1);
+
+  free(ts);
+  unit_netif_free(ni);
+}
+#endif
+
+
+int main(void)
+{
+  TEST_RUN(test_cong_names);
+  TEST_RUN(test_reno_losswnd);
+  TEST_RUN(test_cubic_loss);
+  TEST_RUN(test_cubic_growth);
+  TEST_RUN(test_bbr_startup);
+  TEST_RUN(test_bbr_loss);
+  TEST_RUN(test_dctcp);
+#if CI_CFG_TCP_PACING
+  TEST_RUN(test_pacing);
+#endif
+  TEST_END();
+}
@@ -0,0 +1,310 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_netif.h"
+
+#define N_PKTS    4
+#define LADDR     CI_BSWAPC_BE32(0x0a000001)
+#define RADDR     CI_BSWAPC_BE32(0x0a000002)
+#define ISS       1000000
+#define MSS       1448
+#define SYN_OPTS  8
+#define SYN_DATA  100
+
+
+/* A packet as it comes from the free pool */
+static ci_ip_pkt_fmt* fresh_pkt(ci_netif* ni, int id)
+{
+  ci_ip_pkt_fmt* pkt = PKT(ni, id);
+
+  pkt->pkt_start_off = PKT_START_OFF_BAD;
+  pkt->pkt_eth_payload_off = PKT_START_OFF_BAD;
+  pkt->next = OO_PP_NULL;
+  pkt->refcount = 1;
+  return pkt;
+}
+
+
+/* Dependencies */
+static ci_ip_pkt_fmt* alloc_pkt;
+static ci_ip_pkt_fmt* freed_pkt;
+static int dropped;
+
+ci_ip_pkt_fmt* ci_netif_pkt_alloc_slow(ci_netif* ni, int flags)
+{
+  ci_ip_pkt_fmt* pkt = alloc_pkt;
+
+  CHECK(flags & CI_PKT_ALLOC_FOR_TCP_TX, !=, 0);
+  alloc_pkt = NULL;
+  return pkt;
+}
+
+void ci_netif_pkt_free(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  CHECK(freed_pkt, ==, NULL);
+  freed_pkt = pkt;
+}
+
+void ci_tcp_drop(ci_netif* ni, ci_tcp_state* ts, int so_error)
+{
+  dropped = so_error;
+}
+
+void ci_assert_valid_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                         ci_boolean_t ni_locked, const char* file, int line)
+{
+}
+
+
+static ci_netif* ni;
+
+
+/* The stack's secret, which is read-only at user level */
+static ci_uint8* hash_salt(void)
+{
+  return (ci_uint8*) ni->state->hash_salt;
+}
+
+
+static void setup(void)
+{
+  ni = unit_netif_alloc_extra(N_PKTS, sizeof(ci_tcp_state));
+  ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  memset(hash_salt(), 0x5a, sizeof(ni->state->hash_salt));
+}
+
+
+static void teardown(void)
+{
+  unit_netif_free(ni);
+}
+
+
+static void test_cookie(void)
+{
+  ci_addr_t l = CI_ADDR_FROM_IP4(LADDR);
+  ci_addr_t r = CI_ADDR_FROM_IP4(RADDR);
+  ci_addr_t other = CI_ADDR_FROM_IP4(CI_BSWAPC_BE32(0x0a000003));
+  ci_uint8 cookie[CI_TCP_FASTOPEN_COOKIE_LEN];
+  ci_uint8 cookie2[CI_TCP_FASTOPEN_COOKIE_LEN];
+  int rc;
+
+  setup();
+
+  /* Valid only for the client it was issued to, at this server */
+  ci_tcp_fastopen_cookie(ni, l, r, cookie);
+  rc = ci_tcp_fastopen_cookie_check(ni, l, r, cookie, sizeof(cookie));
+  CHECK(rc, ==, 1);
+  rc = ci_tcp_fastopen_cookie_check(ni, l, other, cookie, sizeof(cookie));
+  CHECK(rc, ==, 0);
+  rc = ci_tcp_fastopen_cookie_check(ni, other, r, cookie, sizeof(cookie));
+  CHECK(rc, ==, 0);
+  rc = ci_tcp_fastopen_cookie_check(ni, r, l, cookie, sizeof(cookie));
+  CHECK(rc, ==, 0);
+
+  /* The same every time, and no good if cut short or altered */
+  ci_tcp_fastopen_cookie(ni, l, r, cookie2);
+  CHECK(memcmp(cookie, cookie2, sizeof(cookie)), ==, 0);
+  rc = ci_tcp_fastopen_cookie_check(ni, l, r, cookie, CI_TCP_FASTOPEN_COOKIE_MIN);
+  CHECK(rc, ==, 0);
+  cookie2[3] ^= 1;
+  rc = ci_tcp_fastopen_cookie_check(ni, l, r, cookie2, sizeof(cookie2));
+  CHECK(rc, ==, 0);
+
+  /* A new key invalidates the cookies issued with the old one */
+  hash_salt()[7] ^= 0x80;
+  rc = ci_tcp_fastopen_cookie_check(ni, l, r, cookie, sizeof(cookie));
+  CHECK(rc, ==, 0);
+  ci_tcp_fastopen_cookie(ni, l, r, cookie2);
+  CHECK(memcmp(cookie, cookie2, sizeof(cookie)), !=, 0);
+  rc = ci_tcp_fastopen_cookie_check(ni, l, r, cookie2, sizeof(cookie2));
+  CHECK(rc, ==, 1);
+
+  teardown();
+}
+
+
+static void test_cache(void)
+{
+  ci_addr_t r = CI_ADDR_FROM_IP4(RADDR);
+  ci_addr_t other;
+  ci_uint8 in[CI_TCP_FASTOPEN_COOKIE_MAX];
+  ci_uint8 out[CI_TCP_FASTOPEN_COOKIE_MAX];
+  ci_uint32 i;
+  int len;
+
+  setup();
+  for( i = 0; i < sizeof(in); ++i )
+    in[i] = i + 1;
+
+  /* Nothing cached at first */
+  len = ci_tcp_fastopen_cache_get(ni, r, out);
+  CHECK(len, ==, 0);
+
+  /* Insert and look up, at both extremes of cookie length */
+  ci_tcp_fastopen_cache_put(ni, r, in, CI_TCP_FASTOPEN_COOKIE_MIN);
+  len = ci_tcp_fastopen_cache_get(ni, r, NULL);
+  CHECK(len, ==, CI_TCP_FASTOPEN_COOKIE_MIN);
+  ci_tcp_fastopen_cache_put(ni, r, in, CI_TCP_FASTOPEN_COOKIE_MAX);
+  memset(out, 0, sizeof(out));
+  len = ci_tcp_fastopen_cache_get(ni, r, out);
+  CHECK(len, ==, CI_TCP_FASTOPEN_COOKIE_MAX);
+  CHECK(memcmp(in, out, len), ==, 0);
+
+  /* Another server only gets its own cookie, and evicts the first when it
+   * maps to the same entry */
+  for( i = 3; i < 100000; ++i ) {
+    other = CI_ADDR_FROM_IP4(CI_BSWAP_BE32(0x0a000000 + i));
+    len = ci_tcp_fastopen_cache_get(ni, other, out);
+    CHECK(len, ==, 0);
+    in[0] = i;
+    ci_tcp_fastopen_cache_put(ni, other, in, CI_TCP_FASTOPEN_COOKIE_LEN);
+    if( ci_tcp_fastopen_cache_get(ni, r, NULL) == 0 )
+      break;
+  }
+  CHECK(i, <, 100000);
+  CHECK(i, >, 3);
+  len = ci_tcp_fastopen_cache_get(ni, other, out);
+  CHECK(len, ==, CI_TCP_FASTOPEN_COOKIE_LEN);
+  CHECK(out[0], ==, (ci_uint8) i);
+
+  teardown();
+}
+
+
+/* A client socket whose SYN carried [SYN_DATA] bytes, in the retransmit
+ * queue with the RTO running */
+static ci_tcp_state* setup_syn_sent(void)
+{
+  ci_tcp_state* ts = unit_netif_extra(ni);
+  ci_ip_timer_state* ipts = IPTIMER_STATE(ni);
+  ci_ip_pkt_fmt* syn = fresh_pkt(ni, 0);
+  ci_tcp_hdr* tcp;
+  ci_uint8* data;
+  int i;
+
+  ipts->sched_ticks = ipts->ci_ip_time_real_ticks = 1000;
+  ipts->closest_timer = 1000 + 2 * CI_IPTIME_BUCKETS;
+  oo_p_dllink_init(ni, oo_p_dllink_ptr(ni, &ipts->fire_list));
+  for( i = 0; i < CI_IPTIME_WHEELSIZE; ++i )
+    oo_p_dllink_init(ni, oo_p_dllink_ptr(ni, &ipts->warray[i]));
+
+  ts->s.pkt.ether_type = CI_ETHERTYPE_IP;
+  ts->s.pkt.ipx.ip4.ip_ihl_version = CI_IP4_IHL_VERSION(sizeof(ci_ip4_hdr));
+  ts->s.pkt.ipx.ip4.ip_saddr_be32 = LADDR;
+  ts->s.pkt.ipx.ip4.ip_daddr_be32 = RADDR;
+  ts->outgoing_hdrs_len = sizeof(ci_ip4_hdr) + sizeof(ci_tcp_hdr);
+  ts->eff_mss = ts->amss = ts->smss = MSS;
+  ci_ip_queue_init(&ts->send);
+  ci_ip_queue_init(&ts->retrans);
+  ts->rto_tid.fn = CI_IP_TIMER_TCP_RTO;
+  ci_ip_timer_init(ni, &ts->rto_tid, oo_state_ptr_to_statep(ni, &ts->rto_tid),
+                   "rto");
+  ci_ip_timer_set(ni, &ts->rto_tid, 1100);
+
+  oo_tx_pkt_layout_init(syn);
+  ci_pkt_init_from_ipcache_len(syn, &ts->s.pkt,
+                               ts->outgoing_hdrs_len + SYN_OPTS);
+  tcp = TX_PKT_IPX_TCP(AF_INET, syn);
+  tcp->tcp_flags = CI_TCP_FLAG_SYN;
+  CI_TCP_HDR_SET_LEN(tcp, sizeof(ci_tcp_hdr) + SYN_OPTS);
+  data = (ci_uint8*) tcp + sizeof(ci_tcp_hdr) + SYN_OPTS;
+  for( i = 0; i < SYN_DATA; ++i )
+    data[i] = i;
+  syn->pf.tcp_tx.start_seq = ISS;
+  syn->pf.tcp_tx.end_seq = ISS + 1 + SYN_DATA;
+  ci_ip_queue_enqueue(ni, &ts->retrans, syn);
+  tcp_snd_nxt(ts) = tcp_enq_nxt(ts) = ISS + 1 + SYN_DATA;
+
+  alloc_pkt = fresh_pkt(ni, 1);
+  freed_pkt = NULL;
+  dropped = 0;
+  return ts;
+}
+
+
+/* The server acked the SYN and [acked] bytes of its data: the rest must go
+ * again as an ordinary segment */
+static void check_requeue(int acked)
+{
+  ci_tcp_state* ts;
+  ci_ip_pkt_fmt* pkt;
+  ci_uint8* data;
+  int rc, i, n = SYN_DATA - acked;
+
+  setup();
+  ts = setup_syn_sent();
+  tcp_snd_una(ts) = ISS + 1 + acked;
+
+  rc = ci_tcp_tx_fastopen_requeue(ni, ts);
+  CHECK(rc, ==, 0);
+  CHECK(dropped, ==, 0);
+
+  /* The SYN is gone, and the RTO with it */
+  CHECK(freed_pkt, ==, PKT(ni, 0));
+  CHECK(ts->retrans.num, ==, 0);
+  CHECK(ci_ip_timer_pending(ni, &ts->rto_tid), ==, 0);
+
+  /* The rest of the data heads the send queue, ready to go again */
+  CHECK(ts->send.num, ==, 1);
+  CHECK(OO_PP_EQ(ts->send.head, OO_PKT_P(PKT(ni, 1))), !=, 0);
+  pkt = PKT(ni, 1);
+  CHECK(pkt->pf.tcp_tx.start_seq, ==, ISS + 1 + acked);
+  CHECK(pkt->pf.tcp_tx.end_seq, ==, ISS + 1 + SYN_DATA);
+  CHECK(TX_PKT_IPX_TCP(AF_INET, pkt)->tcp_flags, ==,
+        CI_TCP_FLAG_ACK | CI_TCP_FLAG_PSH);
+  CHECK(oo_tx_ip_hdr(pkt)->ip_daddr_be32, ==, RADDR);
+  CHECK(pkt->buf_len, ==,
+        oo_tx_ether_hdr_size(pkt) + ts->outgoing_hdrs_len + n);
+  data = (ci_uint8*) oo_tx_l3_hdr(pkt) + ts->outgoing_hdrs_len;
+  for( i = 0; i < n; ++i )
+    CHECK(data[i], ==, acked + i);
+  CHECK(tcp_snd_nxt(ts), ==, tcp_snd_una(ts));
+
+  teardown();
+}
+
+
+static void test_refused(void)
+{
+  /* None of the data accepted */
+  check_requeue(0);
+  /* Some of it */
+  check_requeue(40);
+  check_requeue(SYN_DATA - 1);
+}
+
+
+static void test_refused_no_bufs(void)
+{
+  ci_tcp_state* ts;
+  int rc;
+
+  setup();
+  ts = setup_syn_sent();
+  tcp_snd_una(ts) = ISS + 1;
+  alloc_pkt = NULL;
+
+  /* The connection can't go on without the data */
+  rc = ci_tcp_tx_fastopen_requeue(ni, ts);
+  CHECK(rc, ==, -1);
+  CHECK(dropped, ==, ENOBUFS);
+  CHECK(ts->send.num, ==, 0);
+
+  teardown();
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_cookie);
+  TEST_RUN(test_cache);
+  TEST_RUN(test_refused);
+  TEST_RUN(test_refused_no_bufs);
+  TEST_END();
+}
@@ -0,0 +1,257 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_netif.h"
+
+#if CI_CFG_TCP_RACK
+
+#define MSS 1000
+#define N_PKTS 8
+#define FRC2US UNIT_NETIF_FRC2US
+#define START_US 1000000
+
+
+static ci_netif* alloc_netif(void)
+{
+  ci_netif* ni = unit_netif_alloc(N_PKTS);
+
+  IPTIMER_STATE(ni)->frc = (ci_uint64) START_US << FRC2US;
+  NI_OPTS(ni).tcp_rack = 1;
+  return ni;
+}
+
+static ci_tcp_state* alloc_ts(ci_netif* ni)
+{
+  ci_tcp_state* ts = calloc(1, sizeof(*ts));
+  ts->tcpflags = CI_TCPT_FLAG_SACK;
+  ts->congstate = CI_TCP_CONG_OPEN;
+  ts->sa = 10 << 3;   /* srtt 10 ticks */
+  ts->rack_reo_wnd_mult = 1;
+  ci_ip_queue_init(&ts->retrans);
+  return ts;
+}
+
+static void set_now(ci_netif* ni, ci_uint32 us)
+{
+  IPTIMER_STATE(ni)->frc = (ci_uint64) us << FRC2US;
+}
+
+/* Queue segment [i] on the retransmit queue, sent at [us] */
+static ci_ip_pkt_fmt* send_pkt(ci_netif* ni, ci_tcp_state* ts, int i,
+                               ci_uint32 us)
+{
+  ci_ip_pkt_fmt* pkt = PKT(ni, i);
+  pkt->flags = 0;
+  pkt->pf.tcp_tx.start_seq = 1000 + i * MSS;
+  pkt->pf.tcp_tx.end_seq = 1000 + (i + 1) * MSS;
+  pkt->pf.tcp_tx.block_end = OO_PP_NULL;
+  pkt->tstamp_frc = (ci_uint64) us << FRC2US;
+  ci_ip_queue_enqueue(ni, &ts->retrans, pkt);
+  return pkt;
+}
+
+/* SACK a single segment, which must not be next to another SACKed one */
+static void sack_pkt(ci_netif* ni, ci_tcp_state* ts, ci_ip_pkt_fmt* pkt)
+{
+  ci_uint32 prior_end_seq = ts->rack.end_seq;
+  pkt->flags |= CI_PKT_FLAG_RTQ_SACKED;
+  pkt->pf.tcp_tx.block_end = OO_PKT_P(pkt);
+  ci_tcp_rack_delivered(ni, ts, pkt, prior_end_seq);
+}
+
+
+static void test_sent_after(void)
+{
+  CHECK_TRUE(ci_tcp_rack_sent_after(2, 1000, 1, 2000));
+  CHECK_FALSE(ci_tcp_rack_sent_after(1, 2000, 2, 1000));
+  /* Same time: order by sequence */
+  CHECK_TRUE(ci_tcp_rack_sent_after(5, 2000, 5, 1000));
+  CHECK_FALSE(ci_tcp_rack_sent_after(5, 1000, 5, 2000));
+  CHECK_FALSE(ci_tcp_rack_sent_after(5, 1000, 5, 1000));
+  /* Across wrap */
+  CHECK_TRUE(ci_tcp_rack_sent_after(3, 0, 0xfffffff0, 0));
+}
+
+
+static void test_delivered(void)
+{
+  ci_netif* ni = alloc_netif();
+  ci_tcp_state* ts = alloc_ts(ni);
+  ci_ip_pkt_fmt* p0 = send_pkt(ni, ts, 0, START_US);
+  ci_ip_pkt_fmt* p1 = send_pkt(ni, ts, 1, START_US + 100);
+  ci_ip_pkt_fmt* p2 = send_pkt(ni, ts, 2, START_US + 200);
+
+  /* p1 SACKed first */
+  set_now(ni, START_US + 5100);
+  sack_pkt(ni, ts, p1);
+  CHECK(ts->rack.rtt, ==, 5000);
+  CHECK(ts->rack.min_rtt, ==, 5000);
+  CHECK(ts->rack.end_seq, ==, p1->pf.tcp_tx.end_seq);
+  CHECK(ts->rack.xmit_ts, ==, START_US + 100);
+  CHECK_FALSE(ts->rack_flags & CI_TCP_RACK_FLAG_REORDER);
+
+  /* p0 arrives late: reordering, but RACK stays with p1 */
+  set_now(ni, START_US + 6000);
+  sack_pkt(ni, ts, p0);
+  CHECK_TRUE(ts->rack_flags & CI_TCP_RACK_FLAG_REORDER);
+  CHECK(ni->state->stats.tcp_rack_reordering, ==, 1);
+  CHECK(ts->rack.end_seq, ==, p1->pf.tcp_tx.end_seq);
+  CHECK(ts->rack.min_rtt, ==, 5000);
+
+  /* A retransmission ACKed sooner than any ACK could be is ignored */
+  p2->flags |= CI_PKT_FLAG_RTQ_RETRANS;
+  p2->tstamp_frc = (ci_uint64) (START_US + 5000) << FRC2US;
+  set_now(ni, START_US + 6000);
+  sack_pkt(ni, ts, p2);
+  CHECK(ts->rack.end_seq, ==, p1->pf.tcp_tx.end_seq);
+
+  /* ...but one that takes long enough counts, without touching min_rtt */
+  p2->tstamp_frc = (ci_uint64) (START_US + 500) << FRC2US;
+  sack_pkt(ni, ts, p2);
+  CHECK(ts->rack.end_seq, ==, p2->pf.tcp_tx.end_seq);
+  CHECK(ts->rack.rtt, ==, 5500);
+  CHECK(ts->rack.min_rtt, ==, 5000);
+
+  free(ts);
+  unit_netif_free(ni);
+}
+
+
+static void test_reo_wnd(void)
+{
+  ci_netif* ni = alloc_netif();
+  ci_tcp_state* ts = alloc_ts(ni);
+
+  ts->rack.min_rtt = 8000;
+  CHECK(ci_tcp_rack_reo_wnd(ni, ts), ==, 2000);
+  ts->rack_reo_wnd_mult = 3;
+  CHECK(ci_tcp_rack_reo_wnd(ni, ts), ==, 6000);
+  /* Bounded by srtt: 10 ticks of 1024 usticks */
+  ts->rack_reo_wnd_mult = 8;
+  CHECK(ci_tcp_rack_reo_wnd(ni, ts), ==, 10240);
+  ts->rack_reo_wnd_mult = 1;
+
+  /* Without reordering seen, zero once dupthresh is reached or in
+   * recovery */
+  ts->dup_acks = ci_tcp_base_dupack_thresh(ts);
+  CHECK(ci_tcp_rack_reo_wnd(ni, ts), ==, 0);
+  ts->dup_acks = 0;
+  ts->congstate = CI_TCP_CONG_FAST_RECOV;
+  CHECK(ci_tcp_rack_reo_wnd(ni, ts), ==, 0);
+  ts->rack_flags |= CI_TCP_RACK_FLAG_REORDER;
+  CHECK(ci_tcp_rack_reo_wnd(ni, ts), ==, 2000);
+
+  free(ts);
+  unit_netif_free(ni);
+}
+
+
+static void test_detect_loss(void)
+{
+  ci_netif* ni = alloc_netif();
+  ci_tcp_state* ts = alloc_ts(ni);
+  ci_ip_pkt_fmt* pkt[5];
+  ci_uint32 timeout;
+  int i;
+
+  for( i = 0; i < 3; ++i )
+    pkt[i] = send_pkt(ni, ts, i, START_US);
+  pkt[3] = send_pkt(ni, ts, 3, START_US + 2000);
+  pkt[4] = send_pkt(ni, ts, 4, START_US + 11500);
+
+  /* Nothing delivered: nothing lost and no timer */
+  set_now(ni, START_US + 100000);
+  CHECK(ci_tcp_rack_detect_loss(ni, ts, &timeout), ==, NULL);
+  CHECK(timeout, ==, 0);
+
+  /* pkt[3] SACKed after 10ms.  The reordering window is 2.5ms, so the
+   * earlier segments are lost 0.5ms from now. */
+  set_now(ni, START_US + 12000);
+  sack_pkt(ni, ts, pkt[3]);
+  CHECK(ci_tcp_rack_detect_loss(ni, ts, &timeout), ==, NULL);
+  CHECK(timeout, ==, 500);
+
+  set_now(ni, START_US + 12500);
+  CHECK(ci_tcp_rack_detect_loss(ni, ts, &timeout), ==, pkt[0]);
+  CHECK(timeout, ==, 0);
+
+  /* With enough dupacks there is no reordering window */
+  set_now(ni, START_US + 12000);
+  ts->dup_acks = ci_tcp_base_dupack_thresh(ts);
+  CHECK(ci_tcp_rack_detect_loss(ni, ts, &timeout), ==, pkt[0]);
+
+  /* SACKed segments are skipped.  pkt[0] arriving after pkt[3] is
+   * reordering, which brings back the reordering window. */
+  set_now(ni, START_US + 12500);
+  sack_pkt(ni, ts, pkt[0]);
+  CHECK_TRUE(ts->rack_flags & CI_TCP_RACK_FLAG_REORDER);
+  CHECK(ci_tcp_rack_detect_loss(ni, ts, &timeout), ==, pkt[1]);
+
+  /* A retransmission sent since is not lost, but does not stop the walk */
+  pkt[1]->flags |= CI_PKT_FLAG_RTQ_RETRANS;
+  pkt[1]->tstamp_frc = (ci_uint64) (START_US + 11000) << FRC2US;
+  CHECK(ci_tcp_rack_detect_loss(ni, ts, &timeout), ==, pkt[2]);
+  CHECK(timeout, ==, 0);
+
+  /* It is lost once something sent after it has been delivered, and an
+   * RTT and the reordering window have passed. */
+  pkt[2]->flags |= CI_PKT_FLAG_RTQ_SACKED;
+  pkt[2]->pf.tcp_tx.block_end = OO_PKT_P(pkt[3]);
+  set_now(ni, START_US + 21600);
+  sack_pkt(ni, ts, pkt[4]);
+  CHECK(ts->rack.rtt, ==, 10100);
+  CHECK(ci_tcp_rack_detect_loss(ni, ts, &timeout), ==, NULL);
+  CHECK(timeout, ==, 2000);
+  set_now(ni, START_US + 23600);
+  CHECK(ci_tcp_rack_detect_loss(ni, ts, &timeout), ==, pkt[1]);
+
+  free(ts);
+  unit_netif_free(ni);
+}
+
+
+static void test_dsack(void)
+{
+  ci_netif* ni = alloc_netif();
+  ci_tcp_state* ts = alloc_ts(ni);
+  int i;
+
+  /* Widened once per recovery */
+  ci_tcp_rack_dsack(ni, ts);
+  ci_tcp_rack_dsack(ni, ts);
+  CHECK(ts->rack_reo_wnd_mult, ==, 2);
+  ci_tcp_rack_recovered(ni, ts);
+  ci_tcp_rack_dsack(ni, ts);
+  CHECK(ts->rack_reo_wnd_mult, ==, 3);
+  CHECK(ni->state->stats.tcp_rack_reo_wnd_grown, ==, 2);
+
+  /* Reset after 16 recoveries without a D-SACK */
+  for( i = 0; i < 15; ++i )
+    ci_tcp_rack_recovered(ni, ts);
+  CHECK(ts->rack_reo_wnd_mult, ==, 3);
+  ci_tcp_rack_recovered(ni, ts);
+  CHECK(ts->rack_reo_wnd_mult, ==, 1);
+
+  free(ts);
+  unit_netif_free(ni);
+}
+
+#endif
+
+
+int main(void)
+{
+#if CI_CFG_TCP_RACK
+  TEST_RUN(test_sent_after);
+  TEST_RUN(test_delivered);
+  TEST_RUN(test_reo_wnd);
+  TEST_RUN(test_detect_loss);
+  TEST_RUN(test_dsack);
+#endif
+  TEST_END();
+}
@@ -0,0 +1,246 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_netif.h"
+
+#define ETH_HLEN 14
+
+#define INSN(c, t, f, kk)  { .code = (c), .jt = (t), .jf = (f), .k = (kk) }
+
+/* "udp dst port 53", as compiled by tcpdump -d */
+static const struct oo_bpf_insn udp_53[] = {
+  INSN(0x28, 0, 0, 12),         /* ldh [12] */
+  INSN(0x15, 0, 8, 0x0800),     /* jeq #0x800 */
+  INSN(0x30, 0, 0, 23),         /* ldb [23] */
+  INSN(0x15, 0, 6, 17),         /* jeq #17 */
+  INSN(0x28, 0, 0, 20),         /* ldh [20] */
+  INSN(0x45, 4, 0, 0x1fff),     /* jset #0x1fff */
+  INSN(0xb1, 0, 0, 14),         /* ldxb 4*([14]&0xf) */
+  INSN(0x48, 0, 0, 16),         /* ldh [x + 16] */
+  INSN(0x15, 0, 1, 53),         /* jeq #53 */
+  INSN(0x06, 0, 0, 65535),      /* ret #65535 */
+  INSN(0x06, 0, 0, 0),          /* ret #0 */
+};
+
+
+static void set_prog(ci_netif* ni, const struct oo_bpf_insn* prog, int len)
+{
+  memcpy(ni->state->dump_filter, prog, len * sizeof(*prog));
+  ni->state->dump_filter_len = len;
+}
+
+/* An Ethernet/IPv4 frame with a UDP or TCP header */
+static ci_ip_pkt_fmt* alloc_pkt(int proto, int dport, int ihl, int len)
+{
+  ci_ip_pkt_fmt* pkt = aligned_alloc(CI_CFG_PKT_BUF_SIZE,
+                                     CI_CFG_PKT_BUF_SIZE);
+  ci_uint8* eth;
+
+  memset(pkt, 0, CI_CFG_PKT_BUF_SIZE);
+  pkt->n_buffers = 1;
+  pkt->frag_next = OO_PP_NULL;
+  pkt->pay_len = len;
+  eth = (ci_uint8*) oo_ether_hdr(pkt);
+  eth[12] = 0x08;
+  eth[13] = 0x00;
+  eth[ETH_HLEN] = 0x40 | ihl;
+  eth[ETH_HLEN + 9] = proto;
+  eth[ETH_HLEN + ihl * 4 + 2] = dport >> 8;
+  eth[ETH_HLEN + ihl * 4 + 3] = dport & 0xff;
+  return pkt;
+}
+
+
+static void test_match(void)
+{
+  ci_netif* ni = unit_netif_alloc(0);
+  ci_ip_pkt_fmt* pkt;
+
+  set_prog(ni, udp_53, sizeof(udp_53) / sizeof(udp_53[0]));
+
+  pkt = alloc_pkt(IPPROTO_UDP, 53, 5, 100);
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 65535);
+  free(pkt);
+
+  /* IP options move the UDP header */
+  pkt = alloc_pkt(IPPROTO_UDP, 53, 7, 100);
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 65535);
+  free(pkt);
+
+  pkt = alloc_pkt(IPPROTO_UDP, 54, 5, 100);
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 0);
+  free(pkt);
+
+  pkt = alloc_pkt(IPPROTO_TCP, 53, 5, 100);
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 0);
+  free(pkt);
+
+  /* Fragment */
+  pkt = alloc_pkt(IPPROTO_UDP, 53, 5, 100);
+  ((ci_uint8*) oo_ether_hdr(pkt))[ETH_HLEN + 7] = 1;
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 0);
+  free(pkt);
+
+  unit_netif_free(ni);
+}
+
+
+static void test_short_frame(void)
+{
+  ci_netif* ni = unit_netif_alloc(0);
+  ci_ip_pkt_fmt* pkt;
+
+  set_prog(ni, udp_53, sizeof(udp_53) / sizeof(udp_53[0]));
+
+  /* The port is in the last two bytes */
+  pkt = alloc_pkt(IPPROTO_UDP, 53, 5, ETH_HLEN + 20 + 4);
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 65535);
+  /* Loads past the end of the frame reject it */
+  pkt->pay_len -= 1;
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 0);
+  pkt->pay_len = 0;
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 0);
+  /* and so does nonsense */
+  pkt->pay_len = -1;
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 0);
+  pkt->pay_len = 100;
+  pkt->n_buffers = 2;
+  pkt->buf_len = 20;
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 0);
+  free(pkt);
+
+  unit_netif_free(ni);
+}
+
+
+static void test_alu(void)
+{
+  ci_netif* ni = unit_netif_alloc(0);
+  ci_ip_pkt_fmt* pkt = alloc_pkt(IPPROTO_UDP, 53, 5, 100);
+  const struct oo_bpf_insn prog[] = {
+    INSN(0x00, 0, 0, 100),      /* ld #100 */
+    INSN(0x04, 0, 0, 20),       /* add #20 */
+    INSN(0x34, 0, 0, 3),        /* div #3 */
+    INSN(0x02, 0, 0, 5),        /* st M[5] */
+    INSN(0x01, 0, 0, 7),        /* ldx #7 */
+    INSN(0x9c, 0, 0, 0),        /* mod x */
+    INSN(0x07, 0, 0, 0),        /* tax */
+    INSN(0x60, 0, 0, 5),        /* ld M[5] */
+    INSN(0x6c, 0, 0, 0),        /* lsh x */
+    INSN(0x80, 0, 0, 0),        /* ld len */
+    INSN(0x0c, 0, 0, 0),        /* add x */
+    INSN(0x16, 0, 0, 0),        /* ret a */
+  };
+
+  /* 120 / 3 = 40, 40 % 7 = 5, 40 << 5 = 1280, len + 5 = 105 */
+  set_prog(ni, prog, sizeof(prog) / sizeof(prog[0]));
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 105);
+
+  /* Stop before the ld len */
+  set_prog(ni, prog, 9);
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 0);
+
+  free(pkt);
+  unit_netif_free(ni);
+}
+
+
+static void test_bad_prog(void)
+{
+  ci_netif* ni = unit_netif_alloc(0);
+  ci_ip_pkt_fmt* pkt = alloc_pkt(IPPROTO_UDP, 53, 5, 100);
+  const struct oo_bpf_insn jump_out[] = {
+    INSN(0x05, 0, 0, 1),        /* ja +1 */
+    INSN(0x06, 0, 0, 1),        /* ret #1 */
+  };
+  const struct oo_bpf_insn cond_out[] = {
+    INSN(0x15, 1, 1, 0),        /* jeq #0 */
+    INSN(0x06, 0, 0, 1),        /* ret #1 */
+  };
+  const struct oo_bpf_insn bad_mem[] = {
+    INSN(0x02, 0, 0, 16),       /* st M[16] */
+    INSN(0x06, 0, 0, 1),        /* ret #1 */
+  };
+  const struct oo_bpf_insn div_zero[] = {
+    INSN(0x3c, 0, 0, 0),        /* div x */
+    INSN(0x06, 0, 0, 1),        /* ret #1 */
+  };
+  const struct oo_bpf_insn big_ind[] = {
+    INSN(0x01, 0, 0, 0xfffffff0), /* ldx #-16 */
+    INSN(0x50, 0, 0, 0x20),     /* ldb [x + 32] */
+    INSN(0x06, 0, 0, 1),        /* ret #1 */
+  };
+  const struct oo_bpf_insn ret_1[] = {
+    INSN(0x06, 0, 0, 1),        /* ret #1 */
+  };
+
+  set_prog(ni, jump_out, 2);
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 0);
+  set_prog(ni, cond_out, 2);
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 0);
+  set_prog(ni, bad_mem, 2);
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 0);
+  set_prog(ni, div_zero, 2);
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 0);
+  set_prog(ni, big_ind, 3);
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 0);
+
+  /* A length past the end of the array is clamped */
+  set_prog(ni, ret_1, 1);
+  ni->state->dump_filter_len = 0xffff;
+  CHECK(oo_tcpdump_filter(ni, pkt), ==, 1);
+
+  free(pkt);
+  unit_netif_free(ni);
+}
+
+
+/* SO_ATTACH_REUSEPORT_CBPF programs see only the UDP payload */
+static void test_window(void)
+{
+  ci_netif* ni = unit_netif_alloc(0);
+  ci_ip_pkt_fmt* pkt = alloc_pkt(IPPROTO_UDP, 53, 5, 100);
+  ci_uint8* payload = (ci_uint8*) oo_ether_hdr(pkt) + ETH_HLEN + 20 + 8;
+  const struct oo_bpf_insn first_byte[] = {
+    INSN(0x30, 0, 0, 0),        /* ldb [0] */
+    INSN(0x16, 0, 0, 0),        /* ret a */
+  };
+  const struct oo_bpf_insn len[] = {
+    INSN(0x80, 0, 0, 0),        /* ld len */
+    INSN(0x16, 0, 0, 0),        /* ret a */
+  };
+  const struct oo_bpf_insn cpu[] = {
+    INSN(0x20, 0, 0, 0xfffff024), /* ld cpu */
+    INSN(0x16, 0, 0, 0),        /* ret a */
+  };
+  unsigned base = payload - (ci_uint8*) oo_ether_hdr(pkt);
+
+  payload[0] = 7;
+  CHECK(oo_bpf_run(ni, pkt, first_byte, 2, base, 10), ==, 7);
+  CHECK(oo_bpf_run(ni, pkt, len, 2, base, 10), ==, 10);
+  /* Nothing beyond the window, nor the frame */
+  CHECK(oo_bpf_run(ni, pkt, first_byte, 2, base, 0), ==, 0);
+  CHECK(oo_bpf_run(ni, pkt, first_byte, 2, 100, 10), ==, 0);
+
+  CHECK(oo_bpf_uses_ancillary(first_byte, 2), ==, 0);
+  CHECK(oo_bpf_uses_ancillary(cpu, 2), ==, 1);
+
+  free(pkt);
+  unit_netif_free(ni);
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_match);
+  TEST_RUN(test_short_frame);
+  TEST_RUN(test_alu);
+  TEST_RUN(test_bad_prog);
+  TEST_RUN(test_window);
+  TEST_END();
+}
@@ -0,0 +1,612 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+#include <ci/internal/efabcfg.h>
+#include <ci/net/sockopts.h>
+#include <onload/ul/per_thread.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_netif.h"
+
+#define N_PKTS    96
+#define MTU       1500
+#define MAX_SEG   (MTU - sizeof(ci_ip4_hdr) - sizeof(ci_udp_hdr))
+#define MAX_SENT  (CI_UDP_GSO_MAX_SEGS + 1)
+
+#define LADDR     CI_BSWAPC_BE32(0x0a000001)
+#define RADDR     CI_BSWAPC_BE32(0x0a000002)
+#define LPORT     CI_BSWAPC_BE16(1234)
+#define RPORT     CI_BSWAPC_BE16(5678)
+
+
+static ci_netif* ni;
+static ci_udp_state* us;
+static ci_udp_iomsg_args args;
+static struct oo_cplane_handle* cplane;
+static struct cp_fwd_row fwd_row;
+static int n_alloced;
+static ci_ip_pkt_fmt* sent[MAX_SENT];
+static int n_sent;
+static char payload[CI_UDP_MAX_PAYLOAD_BYTES(AF_INET)];
+
+
+/* Dependencies */
+__thread struct oo_per_thread oo_per_thread;
+ci_cfg_opts_t ci_cfg_opts;
+
+int ci_netif_pkt_alloc_block(ci_netif* netif, ci_sock_cmn* s,
+                             int* p_netif_locked, int can_block,
+                             ci_ip_pkt_fmt** p_pkt)
+{
+  ci_ip_pkt_fmt* pkt;
+
+  CHECK(n_alloced, <, N_PKTS);
+  pkt = PKT(netif, n_alloced++);
+  pkt->pkt_start_off = PKT_START_OFF_BAD;
+  pkt->pkt_eth_payload_off = PKT_START_OFF_BAD;
+  pkt->next = OO_PP_NULL;
+  pkt->frag_next = OO_PP_NULL;
+  pkt->n_buffers = 1;
+  pkt->refcount = 1;
+  *p_pkt = pkt;
+  return 0;
+}
+
+void __ci_netif_send(ci_netif* netif, ci_ip_pkt_fmt* pkt)
+{
+  CHECK(ci_netif_is_locked(netif), !=, 0);
+  CHECK(n_sent, <, MAX_SENT);
+  sent[n_sent++] = pkt;
+}
+
+void ci_ipcache_set_daddr(ci_ip_cached_hdrs* ipcache, ci_addr_t addr)
+{
+  ipcache->ipx.ip4.ip_daddr_be32 = addr.ip4;
+}
+
+void ci_netif_unlock(ci_netif* netif)
+{
+  CHECK(netif->state->lock.lock, ==, CI_EPLOCK_LOCKED);
+  netif->state->lock.lock = 0;
+}
+
+int ci_udp_recv_q_reap(ci_netif* netif, ci_udp_recv_q* q)
+{
+  return 0;
+}
+
+
+static void setup(void)
+{
+  ci_ip_cached_hdrs* ipcache;
+  ci_ether_hdr* eth;
+  int i;
+
+  ni = unit_netif_alloc(N_PKTS);
+  cplane = calloc(1, sizeof(*cplane));
+  memset(&fwd_row, 0, sizeof(fwd_row));
+  cplane->mib[0].fwd_table.rows = &fwd_row;
+  ni->cplane = cplane;
+
+  us = calloc(1, sizeof(*us));
+  us->s.b.state = CI_TCP_STATE_UDP;
+  us->s.domain = AF_INET;
+  us->s.s_flags = CI_SOCK_FLAG_CONNECTED;
+  us->s.so.sndbuf = 1 << 24;
+  ci_udp_recv_q_init(&us->recv_q);
+
+  /* A connected socket with a route that stays valid */
+  ipcache = &us->s.pkt;
+  ci_ip_cache_init(ipcache, AF_INET);
+  ipcache->fwd_ver.id = 0;
+  ipcache->fwd_ver.version = fwd_row.version;
+  ipcache->status = retrrc_success;
+  ipcache->mtu = MTU;
+  ipcache->intf_i = 0;
+  ipcache->ether_offset = 4;
+  eth = ci_ip_cache_ether_hdr(ipcache);
+  eth->ether_type = CI_ETHERTYPE_IP;
+  ipcache->ipx.ip4.ip_ihl_version = CI_IP4_IHL_VERSION(sizeof(ci_ip4_hdr));
+  ipcache->ipx.ip4.ip_saddr_be32 = LADDR;
+  ipcache->ipx.ip4.ip_daddr_be32 = RADDR;
+  ipcache_lport_be16(ipcache) = LPORT;
+  ipcache_rport_be16(ipcache) = RPORT;
+
+  args.ni = ni;
+  args.us = us;
+  n_alloced = 0;
+  n_sent = 0;
+  for( i = 0; i < (int) sizeof(payload); ++i )
+    payload[i] = i * 7 + i / 251;
+}
+
+
+static void teardown(void)
+{
+  free(us);
+  free(cplane);
+  unit_netif_free(ni);
+}
+
+
+/* One's complement sum of [len] bytes, folded to 16 bits */
+static ci_uint32 csum_add(ci_uint32 sum, const void* p, int len)
+{
+  const ci_uint8* b = p;
+  int i;
+
+  for( i = 0; i + 1 < len; i += 2 )
+    sum += (b[i] << 8) | b[i + 1];
+  if( len & 1 )
+    sum += b[len - 1] << 8;
+  while( sum >> 16 )
+    sum = (sum & 0xffff) + (sum >> 16);
+  return sum;
+}
+
+
+/* The UDP checksum of a datagram from the addresses and ports given, with
+ * [udp_len] bytes of UDP header and payload */
+static ci_uint16 udp_csum(ci_uint32 saddr_be32, ci_uint32 daddr_be32,
+                          ci_uint16 sport_be16, ci_uint16 dport_be16,
+                          int udp_len, const void* data, int data_len)
+{
+  ci_uint8 pseudo[12];
+  ci_udp_hdr udp;
+  ci_uint32 sum;
+
+  memcpy(pseudo, &saddr_be32, 4);
+  memcpy(pseudo + 4, &daddr_be32, 4);
+  pseudo[8] = 0;
+  pseudo[9] = IPPROTO_UDP;
+  pseudo[10] = udp_len >> 8;
+  pseudo[11] = udp_len;
+  udp.udp_source_be16 = sport_be16;
+  udp.udp_dest_be16 = dport_be16;
+  udp.udp_len_be16 = CI_BSWAP_BE16(udp_len);
+  udp.udp_check_be16 = 0;
+
+  sum = csum_add(0, pseudo, sizeof(pseudo));
+  sum = csum_add(sum, &udp, sizeof(udp));
+  sum = csum_add(sum, data, data_len);
+  return ~sum & 0xffff;
+}
+
+
+/* Check that sent[i] is a datagram of its own carrying [len] bytes of the
+ * payload from offset [off] */
+static void check_seg(int i, int off, int len)
+{
+  ci_ip_pkt_fmt* pkt = sent[i];
+  ci_ip4_hdr* ip = oo_tx_ip_hdr(pkt);
+  ci_udp_hdr* udp = (ci_udp_hdr*) (ip + 1);
+  char* data = (char*) (udp + 1);
+
+  CHECK(oo_tx_ether_type_get(pkt), ==, CI_ETHERTYPE_IP);
+  CHECK(pkt->n_buffers, ==, 1);
+  CHECK(OO_PP_IS_NULL(pkt->next), !=, 0);
+  CHECK((int) (PKT_START(pkt) + pkt->pay_len - data), ==, len);
+
+  CHECK(ip->ip_ihl_version, ==, CI_IP4_IHL_VERSION(sizeof(ci_ip4_hdr)));
+  CHECK(ip->ip_protocol, ==, IPPROTO_UDP);
+  CHECK(CI_BSWAP_BE16(ip->ip_tot_len_be16), ==,
+        len + sizeof(ci_udp_hdr) + sizeof(ci_ip4_hdr));
+  CHECK(ip->ip_frag_off_be16, ==, 0);
+  CHECK(ip->ip_saddr_be32, ==, LADDR);
+  CHECK(ip->ip_daddr_be32, ==, RADDR);
+  CHECK(ip->ip_ttl, ==, CI_IPX_DFLT_TTL_HOPLIMIT(AF_INET));
+
+  CHECK(udp->udp_source_be16, ==, LPORT);
+  CHECK(udp->udp_dest_be16, ==, RPORT);
+  CHECK(CI_BSWAP_BE16(udp->udp_len_be16), ==, len + sizeof(ci_udp_hdr));
+  CHECK(memcmp(data, payload + off, len), ==, 0);
+
+  /* Both checksums are left for the NIC, each over its own datagram */
+  CHECK(ip->ip_check_be16, ==, 0);
+  CHECK(udp->udp_check_be16, ==, 0);
+  CHECK(udp_csum(ip->ip_saddr_be32, ip->ip_daddr_be32, udp->udp_source_be16,
+                 udp->udp_dest_be16, CI_BSWAP_BE16(udp->udp_len_be16),
+                 data, len),
+        ==,
+        udp_csum(LADDR, RADDR, LPORT, RPORT, len + sizeof(ci_udp_hdr),
+                 payload + off, len));
+}
+
+
+/* Send [len] bytes of the payload, split into the iovecs given */
+static int send_iov(const int* iov_lens, int n_iov, int len,
+                    struct msghdr* msg)
+{
+  struct iovec iov[8];
+  int i, off = 0;
+
+  CHECK(n_iov, <=, 8);
+  for( i = 0; i < n_iov; ++i ) {
+    iov[i].iov_base = payload + off;
+    iov[i].iov_len = iov_lens[i];
+    off += iov_lens[i];
+  }
+  CHECK(off, ==, len);
+  msg->msg_iov = iov;
+  msg->msg_iovlen = n_iov;
+  return ci_udp_sendmsg(&args, msg, 0);
+}
+
+
+static int send_bytes(int len)
+{
+  struct msghdr msg = {};
+  return send_iov(&len, 1, len, &msg);
+}
+
+
+static void test_gso_segments(void)
+{
+  ci_uint16 id;
+  int rc, i;
+
+  /* A short last segment */
+  setup();
+  us->gso_size = 300;
+  rc = send_bytes(1000);
+  CHECK(rc, ==, 1000);
+  CHECK(n_sent, ==, 4);
+  check_seg(0, 0, 300);
+  check_seg(1, 300, 300);
+  check_seg(2, 600, 300);
+  check_seg(3, 900, 100);
+  CHECK(us->stats.n_tx_gso, ==, 1);
+  CHECK(us->stats.n_tx_gso_segs, ==, 4);
+  CHECK(ni->state->lock.lock, ==, 0);
+
+  /* Each datagram has an IP ID of its own */
+  id = CI_BSWAP_BE16(oo_tx_ip_hdr(sent[0])->ip_id_be16);
+  for( i = 1; i < n_sent; ++i )
+    CHECK(CI_BSWAP_BE16(oo_tx_ip_hdr(sent[i])->ip_id_be16), ==,
+          (ci_uint16) (id + i));
+  teardown();
+
+  /* An exact multiple of the segment size */
+  setup();
+  us->gso_size = 300;
+  rc = send_bytes(900);
+  CHECK(rc, ==, 900);
+  CHECK(n_sent, ==, 3);
+  for( i = 0; i < 3; ++i )
+    check_seg(i, i * 300, 300);
+  teardown();
+
+  /* The largest segments the MTU allows */
+  setup();
+  us->gso_size = MAX_SEG;
+  rc = send_bytes(44 * MAX_SEG);
+  CHECK(rc, ==, (int) (44 * MAX_SEG));
+  CHECK(n_sent, ==, 44);
+  for( i = 0; i < n_sent; ++i )
+    check_seg(i, i * MAX_SEG, MAX_SEG);
+  teardown();
+
+  /* As many segments as are allowed */
+  setup();
+  us->gso_size = 1000;
+  rc = send_bytes(CI_UDP_GSO_MAX_SEGS * 1000);
+  CHECK(rc, ==, CI_UDP_GSO_MAX_SEGS * 1000);
+  CHECK(n_sent, ==, CI_UDP_GSO_MAX_SEGS);
+  for( i = 0; i < n_sent; ++i )
+    check_seg(i, i * 1000, 1000);
+  teardown();
+
+  /* No longer than a segment: one ordinary datagram */
+  setup();
+  us->gso_size = 300;
+  rc = send_bytes(300);
+  CHECK(rc, ==, 300);
+  CHECK(n_sent, ==, 1);
+  check_seg(0, 0, 300);
+  CHECK(us->stats.n_tx_gso, ==, 0);
+  teardown();
+}
+
+
+static void test_gso_cmsg(void)
+{
+  static const int iov_lens[] = { 150, 333, 17, 500 };
+  char control[CMSG_SPACE(sizeof(ci_uint16))];
+  struct msghdr msg = {};
+  struct cmsghdr* cmsg;
+  int rc, i;
+
+  /* The segment size from a cmsg overrides the socket's, and segments
+   * cross iovec boundaries */
+  setup();
+  us->gso_size = 100;
+  memset(control, 0, sizeof(control));
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = IPPROTO_UDP;
+  cmsg->cmsg_type = CI_UDP_SEGMENT;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(ci_uint16));
+  *(ci_uint16*) CMSG_DATA(cmsg) = 200;
+
+  rc = send_iov(iov_lens, 4, 1000, &msg);
+  CHECK(rc, ==, 1000);
+  CHECK(n_sent, ==, 5);
+  for( i = 0; i < 5; ++i )
+    check_seg(i, i * 200, 200);
+  teardown();
+}
+
+
+static void test_gso_einval(void)
+{
+  int rc;
+
+  /* A segment that would not fit the MTU */
+  setup();
+  us->gso_size = MAX_SEG + 1;
+  rc = send_bytes(2 * MAX_SEG + 2);
+  CHECK(rc, ==, -1);
+  CHECK(errno, ==, EINVAL);
+  CHECK(n_sent, ==, 0);
+  CHECK(n_alloced, ==, 0);
+  CHECK(ni->state->lock.lock, ==, 0);
+  teardown();
+
+  /* Too many segments */
+  setup();
+  us->gso_size = 100;
+  rc = send_bytes(CI_UDP_GSO_MAX_SEGS * 100 + 1);
+  CHECK(rc, ==, -1);
+  CHECK(errno, ==, EINVAL);
+  CHECK(n_sent, ==, 0);
+  teardown();
+}
+
+
+/**********************************************************************
+ * GRO
+ */
+
+#define SADDR     CI_BSWAPC_BE32(0x0a000009)
+#define SPORT     CI_BSWAPC_BE16(4000)
+
+static char rx_buf[4096];
+static char rx_control[CMSG_SPACE(sizeof(int))];
+static struct msghdr rx_msg;
+static struct iovec rx_iov;
+
+
+/* Queue a datagram of [len] bytes from [sport_be16], whose bytes are all
+ * [tag] */
+static ci_ip_pkt_fmt* rx_pkt(ci_uint16 sport_be16, int len, char tag)
+{
+  ci_ip_pkt_fmt* pkt = PKT(ni, n_alloced++);
+  ci_ip4_hdr* ip;
+  ci_udp_hdr* udp;
+  char* data;
+
+  pkt->pkt_eth_payload_off = ETH_HLEN;
+  pkt->frag_next = OO_PP_NULL;
+  pkt->n_buffers = 1;
+  ip = oo_ip_hdr(pkt);
+  ip->ip_ihl_version = CI_IP4_IHL_VERSION(sizeof(*ip));
+  ip->ip_protocol = IPPROTO_UDP;
+  ip->ip_saddr_be32 = SADDR;
+  ip->ip_daddr_be32 = LADDR;
+  udp = (ci_udp_hdr*) (ip + 1);
+  udp->udp_source_be16 = sport_be16;
+  udp->udp_dest_be16 = LPORT;
+  data = (char*) (udp + 1);
+  memset(data, tag, len);
+  oo_offbuf_init(&pkt->buf, data, len);
+  pkt->pf.udp.pay_len = len;
+
+  ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  ci_udp_recv_q_put(ni, &us->recv_q, pkt);
+  ni->state->lock.lock = 0;
+  return pkt;
+}
+
+
+/* Receive into [space] bytes of buffer.  Returns the bytes received, and
+ * the segment size from the UDP_GRO message in [*gso_size] (0 if none). */
+static int recv_gro(int space, int flags, int* gso_size)
+{
+  struct cmsghdr* cmsg;
+  int rc;
+
+  memset(rx_buf, 0, sizeof(rx_buf));
+  memset(rx_control, 0, sizeof(rx_control));
+  memset(&rx_msg, 0, sizeof(rx_msg));
+  rx_iov.iov_base = rx_buf;
+  rx_iov.iov_len = space;
+  rx_msg.msg_iov = &rx_iov;
+  rx_msg.msg_iovlen = 1;
+  rx_msg.msg_control = rx_control;
+  rx_msg.msg_controllen = sizeof(rx_control);
+
+  rc = ci_udp_recvmsg(&args, &rx_msg, flags | MSG_DONTWAIT);
+  CHECK(ci_sock_is_locked(ni, &us->s.b), ==, 0);
+
+  *gso_size = 0;
+  for( cmsg = CMSG_FIRSTHDR(&rx_msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(&rx_msg, cmsg) ) {
+    CHECK(cmsg->cmsg_level, ==, IPPROTO_UDP);
+    CHECK(cmsg->cmsg_type, ==, CI_UDP_GRO);
+    CHECK(cmsg->cmsg_len, ==, CMSG_LEN(sizeof(int)));
+    *gso_size = *(int*) CMSG_DATA(cmsg);
+  }
+  return rc;
+}
+
+
+/* Check that [len] bytes of rx_buf from [off] are all [tag] */
+static void check_rx(int off, int len, char tag)
+{
+  int i;
+
+  for( i = off; i < off + len; ++i )
+    if( rx_buf[i] != tag ) {
+      CHECK(rx_buf[i], ==, tag);
+      break;
+    }
+}
+
+
+static void gro_setup(void)
+{
+  setup();
+  us->udpflags |= CI_UDPF_GRO;
+}
+
+
+static void test_gro_merge(void)
+{
+  int rc, gso;
+
+  /* Equal-sized datagrams of one flow are merged in order */
+  gro_setup();
+  rx_pkt(SPORT, 100, 'a');
+  rx_pkt(SPORT, 100, 'b');
+  rx_pkt(SPORT, 100, 'c');
+  rx_pkt(SPORT, 100, 'd');
+  rc = recv_gro(sizeof(rx_buf), 0, &gso);
+  CHECK(rc, ==, 400);
+  CHECK(gso, ==, 100);
+  check_rx(0, 100, 'a');
+  check_rx(100, 100, 'b');
+  check_rx(200, 100, 'c');
+  check_rx(300, 100, 'd');
+  CHECK(ci_udp_recv_q_is_empty(&us->recv_q), !=, 0);
+  CHECK(us->stats.n_rx_gro, ==, 1);
+  CHECK(us->stats.n_rx_gro_segs, ==, 4);
+  teardown();
+
+  /* A shorter datagram is the last of a batch */
+  gro_setup();
+  rx_pkt(SPORT, 100, 'a');
+  rx_pkt(SPORT, 100, 'b');
+  rx_pkt(SPORT, 60, 'c');
+  rx_pkt(SPORT, 100, 'd');
+  rc = recv_gro(sizeof(rx_buf), 0, &gso);
+  CHECK(rc, ==, 260);
+  CHECK(gso, ==, 100);
+  check_rx(200, 60, 'c');
+  rc = recv_gro(sizeof(rx_buf), 0, &gso);
+  CHECK(rc, ==, 100);
+  CHECK(gso, ==, 0);
+  check_rx(0, 100, 'd');
+  CHECK(us->stats.n_rx_gro, ==, 1);
+  CHECK(us->stats.n_rx_gro_segs, ==, 3);
+  teardown();
+
+  /* Only as many as fit the buffer */
+  gro_setup();
+  rx_pkt(SPORT, 100, 'a');
+  rx_pkt(SPORT, 100, 'b');
+  rx_pkt(SPORT, 100, 'c');
+  rc = recv_gro(250, 0, &gso);
+  CHECK(rc, ==, 200);
+  CHECK(gso, ==, 100);
+  rc = recv_gro(250, 0, &gso);
+  CHECK(rc, ==, 100);
+  check_rx(0, 100, 'c');
+  teardown();
+}
+
+
+static void test_gro_flush(void)
+{
+  ci_ip_pkt_fmt* pkt;
+  int rc, gso;
+
+  /* A longer datagram starts a new batch */
+  gro_setup();
+  rx_pkt(SPORT, 100, 'a');
+  rx_pkt(SPORT, 150, 'b');
+  rx_pkt(SPORT, 150, 'c');
+  rc = recv_gro(sizeof(rx_buf), 0, &gso);
+  CHECK(rc, ==, 100);
+  CHECK(gso, ==, 0);
+  rc = recv_gro(sizeof(rx_buf), 0, &gso);
+  CHECK(rc, ==, 300);
+  CHECK(gso, ==, 150);
+  check_rx(0, 150, 'b');
+  check_rx(150, 150, 'c');
+  teardown();
+
+  /* Another flow ends the batch, and nothing is taken from behind it */
+  gro_setup();
+  rx_pkt(SPORT, 100, 'a');
+  rx_pkt(SPORT, 100, 'b');
+  rx_pkt(CI_BSWAPC_BE16(4001), 100, 'x');
+  rx_pkt(SPORT, 100, 'c');
+  rc = recv_gro(sizeof(rx_buf), 0, &gso);
+  CHECK(rc, ==, 200);
+  rc = recv_gro(sizeof(rx_buf), 0, &gso);
+  CHECK(rc, ==, 100);
+  CHECK(gso, ==, 0);
+  check_rx(0, 100, 'x');
+  rc = recv_gro(sizeof(rx_buf), 0, &gso);
+  CHECK(rc, ==, 100);
+  check_rx(0, 100, 'c');
+  teardown();
+
+  /* As does a datagram with another source address */
+  gro_setup();
+  rx_pkt(SPORT, 100, 'a');
+  pkt = rx_pkt(SPORT, 100, 'x');
+  oo_ip_hdr(pkt)->ip_saddr_be32 = CI_BSWAPC_BE32(0x0a000008);
+  rc = recv_gro(sizeof(rx_buf), 0, &gso);
+  CHECK(rc, ==, 100);
+  CHECK(gso, ==, 0);
+  teardown();
+
+  /* An indirect packet is never merged */
+  gro_setup();
+  rx_pkt(SPORT, 100, 'a');
+  pkt = rx_pkt(SPORT, 100, 'x');
+  pkt->flags |= CI_PKT_FLAG_INDIRECT;
+  rc = recv_gro(sizeof(rx_buf), 0, &gso);
+  CHECK(rc, ==, 100);
+  CHECK(gso, ==, 0);
+  CHECK(ci_udp_recv_q_is_empty(&us->recv_q), ==, 0);
+  teardown();
+
+  /* MSG_PEEK sees one datagram and leaves it */
+  gro_setup();
+  rx_pkt(SPORT, 100, 'a');
+  rx_pkt(SPORT, 100, 'b');
+  rc = recv_gro(sizeof(rx_buf), MSG_PEEK, &gso);
+  CHECK(rc, ==, 100);
+  CHECK(gso, ==, 0);
+  rc = recv_gro(sizeof(rx_buf), 0, &gso);
+  CHECK(rc, ==, 200);
+  CHECK(gso, ==, 100);
+  teardown();
+
+  /* Without UDP_GRO, one datagram per receive */
+  setup();
+  rx_pkt(SPORT, 100, 'a');
+  rx_pkt(SPORT, 100, 'b');
+  rc = recv_gro(sizeof(rx_buf), 0, &gso);
+  CHECK(rc, ==, 100);
+  CHECK(gso, ==, 0);
+  CHECK(us->stats.n_rx_gro, ==, 0);
+  teardown();
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_gso_segments);
+  TEST_RUN(test_gso_cmsg);
+  TEST_RUN(test_gso_einval);
+  TEST_RUN(test_gro_merge);
+  TEST_RUN(test_gro_flush);
+  TEST_END();
+}
@@ -0,0 +1,204 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+#include <onload/extensions_zc.h>
+#include <onload/ul/per_thread.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_netif.h"
+
+#define N_PKTS    8
+#define N_MSGS    8
+#define TEST_FD   42
+#define PAY_LEN   100
+
+#define UNICAST   CI_BSWAPC_BE32(0x0a000001)
+#define MULTICAST CI_BSWAPC_BE32(0xe1020304)
+
+
+/* Dependencies */
+__thread struct oo_per_thread oo_per_thread;
+
+void ci_udp_compute_stamp(ci_netif* netif, ci_uint64 stamp,
+                          struct timespec* ts)
+{
+  ts->tv_sec = 0;
+  ts->tv_nsec = stamp;
+}
+
+int ci_udp_recv_q_reap(ci_netif* ni, ci_udp_recv_q* q)
+{
+  return 0;
+}
+
+
+static ci_netif* ni;
+static ci_udp_state* us;
+static struct onload_zc_recv_batch_msg msgs[N_MSGS];
+static struct onload_zc_iovec iovs[N_MSGS];
+
+
+static void setup(void)
+{
+  ni = unit_netif_alloc(N_PKTS);
+  us = calloc(1, sizeof(*us));
+  ci_udp_recv_q_init(&us->recv_q);
+  memset(msgs, 0, sizeof(msgs));
+  memset(iovs, 0, sizeof(iovs));
+}
+
+
+static void teardown(void)
+{
+  free(us);
+  unit_netif_free(ni);
+}
+
+
+/* Queue datagram [i] to [daddr_be32], whose payload starts with [tag] */
+static ci_ip_pkt_fmt* rx_pkt(int i, ci_uint32 daddr_be32, char tag)
+{
+  ci_ip_pkt_fmt* pkt = PKT(ni, i);
+  char* payload;
+
+  pkt->pkt_eth_payload_off = ETH_HLEN;
+  pkt->frag_next = OO_PP_NULL;
+  pkt->n_buffers = 1;
+  pkt->tstamp_frc = 1000 + i;
+  oo_ip_hdr(pkt)->ip_daddr_be32 = daddr_be32;
+  payload = (char*) oo_ip_hdr(pkt) + sizeof(ci_ip4_hdr) + sizeof(ci_udp_hdr);
+  payload[0] = tag;
+  oo_offbuf_init(&pkt->buf, payload, PAY_LEN);
+  pkt->pf.udp.pay_len = PAY_LEN;
+
+  ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  ci_udp_recv_q_put(ni, &us->recv_q, pkt);
+  ni->state->lock.lock = 0;
+  return pkt;
+}
+
+
+static int batch(void)
+{
+  struct onload_zc_iovec* iov = iovs;
+  int iov_len = N_MSGS;
+  int n;
+
+  n = ci_udp_zc_recv_batch(ni, us, TEST_FD, msgs, N_MSGS, &iov, &iov_len);
+  CHECK(iov_len, ==, N_MSGS - n);
+  CHECK((int) (iov - iovs), ==, n);
+  return n;
+}
+
+
+static void test_multicast_shared(void)
+{
+  ci_ip_pkt_fmt* p0;
+  ci_ip_pkt_fmt* p1;
+  ci_ip_pkt_fmt* p2;
+  int n;
+
+  setup();
+  p0 = rx_pkt(0, UNICAST, 'a');
+  p1 = rx_pkt(1, MULTICAST, 'b');
+  p2 = rx_pkt(2, UNICAST, 'c');
+
+  n = batch();
+  CHECK(n, ==, 3);
+  CHECK(ci_udp_recv_q_is_empty(&us->recv_q), !=, 0);
+
+  /* Only the multicast datagram may be seen by other sockets */
+  CHECK(msgs[0].flags, ==, 0);
+  CHECK(msgs[1].flags, ==, ONLOAD_ZC_MSG_SHARED);
+  CHECK(msgs[2].flags, ==, 0);
+
+  CHECK(msgs[1].fd, ==, TEST_FD);
+  CHECK(msgs[1].msg.msghdr.msg_iovlen, ==, 1);
+  CHECK(msgs[1].msg.iov[0].iov_len, ==, PAY_LEN);
+  CHECK(*(char*) msgs[1].msg.iov[0].iov_base, ==, 'b');
+  CHECK(msgs[1].ts.tv_nsec, ==, 1001);
+
+  /* The app owns all of them */
+  CHECK(p0->rx_flags & CI_PKT_RX_FLAG_KEEP, !=, 0);
+  CHECK(p1->rx_flags & CI_PKT_RX_FLAG_KEEP, !=, 0);
+  CHECK(p2->rx_flags & CI_PKT_RX_FLAG_KEEP, !=, 0);
+  CHECK(ci_sock_is_locked(ni, &us->s.b), ==, 0);
+
+  teardown();
+}
+
+
+static int n_filtered;
+static int filter_flags[N_PKTS];
+
+static char filter_tags[N_PKTS];
+
+/* Sees each datagram, and as with the other receive calls lets it through */
+static enum onload_zc_callback_rc
+filter(struct onload_zc_msg* msg, void* arg, int flags)
+{
+  CHECK(arg, ==, &n_filtered);
+  CHECK(msg->msghdr.msg_iovlen, ==, 1);
+  filter_tags[n_filtered] = *(char*) msg->iov[0].iov_base;
+  filter_flags[n_filtered++] = flags;
+  return ONLOAD_ZC_CONTINUE;
+}
+
+
+static void test_recv_filter(void)
+{
+  ci_ip_pkt_fmt* p0;
+  ci_ip_pkt_fmt* p1;
+  ci_ip_pkt_fmt* p2;
+  ci_ip_pkt_fmt* p3;
+  int n;
+
+  setup();
+  us->recv_q_filter = (ci_uintptr_t) filter;
+  us->recv_q_filter_arg = (ci_uintptr_t) &n_filtered;
+  n_filtered = 0;
+  p0 = rx_pkt(0, UNICAST, 'a');
+  p1 = rx_pkt(1, MULTICAST, 'b');
+  p2 = rx_pkt(2, MULTICAST, 'c');
+  p3 = rx_pkt(3, UNICAST, 'd');
+
+  /* The filter sees every datagram, in order and with its flags, before
+   * the app gets it */
+  n = batch();
+  CHECK(n, ==, 4);
+  CHECK(n_filtered, ==, 4);
+  CHECK(memcmp(filter_tags, "abcd", 4), ==, 0);
+  CHECK(filter_flags[0], ==, 0);
+  CHECK(filter_flags[1], ==, ONLOAD_ZC_MSG_SHARED);
+  CHECK(filter_flags[2], ==, ONLOAD_ZC_MSG_SHARED);
+  CHECK(filter_flags[3], ==, 0);
+  CHECK(ci_udp_recv_q_is_empty(&us->recv_q), !=, 0);
+
+  CHECK(*(char*) msgs[1].msg.iov[0].iov_base, ==, 'b');
+  CHECK(msgs[1].flags, ==, ONLOAD_ZC_MSG_SHARED);
+  CHECK(*(char*) msgs[3].msg.iov[0].iov_base, ==, 'd');
+  CHECK(msgs[3].flags, ==, 0);
+
+  /* Each is marked as filtered, and kept for the app */
+  CHECK(p0->pio_addr, ==, -1);
+  CHECK(p1->pio_addr, ==, -1);
+  CHECK(p2->pio_addr, ==, -1);
+  CHECK(p3->pio_addr, ==, -1);
+  CHECK(p0->rx_flags & CI_PKT_RX_FLAG_KEEP, !=, 0);
+  CHECK(p1->rx_flags & CI_PKT_RX_FLAG_KEEP, !=, 0);
+  CHECK(p2->rx_flags & CI_PKT_RX_FLAG_KEEP, !=, 0);
+  CHECK(p3->rx_flags & CI_PKT_RX_FLAG_KEEP, !=, 0);
+
+  teardown();
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_multicast_shared);
+  TEST_RUN(test_recv_filter);
+  TEST_END();
+}
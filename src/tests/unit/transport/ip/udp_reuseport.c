@@ -0,0 +1,432 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+#include <onload/hash.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_netif.h"
+
+#define N_PKTS    8
+#define N_SOCKS   8
+#define ETH_HLEN  14
+#define PAY_LEN   100
+
+#define LADDR     CI_BSWAPC_BE32(0x0a000001)
+#define SADDR     CI_BSWAPC_BE32(0x0a000009)
+#define MULTICAST CI_BSWAPC_BE32(0xe1020304)
+#define LPORT     CI_BSWAPC_BE16(1234)
+
+#define INSN(c, t, f, kk)  { .code = (c), .jt = (t), .jf = (f), .k = (kk) }
+
+
+static ci_netif* ni;
+static ci_udp_state* socks[N_SOCKS];
+static int n_group;
+static int n_offered;
+static ci_ip_pkt_fmt* freed;
+
+
+/* Dependencies */
+void ci_assert_valid_pkt(ci_netif* netif, ci_ip_pkt_fmt* pkt,
+                         ci_boolean_t ni_locked,
+                         const char* file, int line)
+{
+}
+
+/* Every datagram matches the wild filters of the first [n_group] sockets,
+ * and no others */
+int
+ci_netif_filter_for_each_match(ci_netif* netif,
+                               unsigned laddr, unsigned lport,
+                               unsigned raddr, unsigned rport,
+                               unsigned protocol, int intf_i, int vlan,
+                               int (*callback)(ci_sock_cmn*, void*),
+                               void* callback_arg, ci_uint32* hash_out)
+{
+  int i;
+
+  CHECK(protocol, ==, IPPROTO_UDP);
+  CHECK(lport, ==, LPORT);
+  if( raddr != 0 )
+    return 0;
+  for( i = 0; i < n_group; ++i ) {
+    ++n_offered;
+    if( callback(&socks[i]->s, callback_arg) )
+      return 1;
+  }
+  return 0;
+}
+
+/* Only a datagram queued on more than one socket needs another buffer */
+ci_ip_pkt_fmt* ci_netif_pkt_alloc_slow(ci_netif* netif, int flags)
+{
+  CHECK(n_group, >, 1);
+  return NULL;
+}
+
+void ci_netif_pkt_free(ci_netif* netif, ci_ip_pkt_fmt* pkt)
+{
+  CHECK(pkt->refcount, ==, 0);
+  freed = pkt;
+}
+
+void citp_waitable_wake(ci_netif* netif, citp_waitable* sb, unsigned what)
+{
+}
+
+
+static void setup(void)
+{
+  unsigned ep_ofs = CI_ROUND_UP(sizeof(ci_netif_state), CI_PAGE_SIZE);
+  int i;
+
+  ni = unit_netif_alloc_extra(N_PKTS, ep_ofs - sizeof(ci_netif_state) +
+                                      N_SOCKS * EP_BUF_SIZE);
+  *(ci_uint32*) &ni->state->ep_ofs = ep_ofs;
+  *(ci_uint32*) &ni->state->n_ep_bufs = N_SOCKS;
+  NI_OPTS(ni).udp_reuseport_instack = 1;
+  ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  ni->state->in_poll = 1;
+  oo_p_dllink_init(ni, oo_p_dllink_ptr(ni, &ni->state->post_poll_list));
+
+  /* Unconnected SO_REUSEPORT sockets bound to LADDR:LPORT */
+  for( i = 0; i < N_SOCKS; ++i ) {
+    ci_udp_state* us;
+    us = (ci_udp_state*) oo_sockp_to_ptr(ni, OO_SP_FROM_INT(ni, i));
+    us->s.b.bufid = i;
+    us->s.b.state = CI_TCP_STATE_UDP;
+    oo_p_dllink_init(ni, oo_p_dllink_sb(ni, &us->s.b,
+                                        &us->s.b.post_poll_link));
+    us->s.s_flags = CI_SOCK_FLAG_REUSEPORT;
+    us->s.domain = AF_INET;
+    ci_ip_cache_init(&us->s.pkt, AF_INET);
+    us->s.laddr = CI_ADDR_FROM_IP4(LADDR);
+    udp_lport_be16(us) = LPORT;
+    us->s.so.rcvbuf = 1 << 20;
+    us->stats.max_recvq_pkts = N_PKTS;
+    us->reuseport_group = -1;
+    ci_udp_recv_q_init(&us->recv_q);
+    socks[i] = us;
+  }
+}
+
+
+static void teardown(void)
+{
+  unit_netif_free(ni);
+}
+
+
+static struct oo_udp_reuseport_group* group(int g)
+{
+  return &ni->state->udp_reuseport[g];
+}
+
+
+/* A datagram from SADDR:[sport] to [daddr_be32]:LPORT, whose payload
+ * starts with [tag] */
+static ci_ip_pkt_fmt* rx_pkt(int i, ci_uint32 daddr_be32, int sport,
+                             ci_uint8 tag)
+{
+  ci_ip_pkt_fmt* pkt = PKT(ni, i);
+  ci_ip4_hdr* ip;
+  ci_udp_hdr* udp;
+
+  pkt->pkt_start_off = 0;
+  pkt->pkt_eth_payload_off = ETH_HLEN;
+  pkt->frag_next = OO_PP_NULL;
+  pkt->n_buffers = 1;
+  pkt->refcount = 1;
+  pkt->rx_flags = 0;
+  pkt->pay_len = ETH_HLEN + sizeof(*ip) + sizeof(*udp) + PAY_LEN;
+  pkt->pf.udp.pay_len = PAY_LEN;
+
+  ip = oo_ip_hdr(pkt);
+  ip->ip_ihl_version = CI_IP4_IHL_VERSION(sizeof(*ip));
+  ip->ip_protocol = IPPROTO_UDP;
+  ip->ip_saddr_be32 = SADDR;
+  ip->ip_daddr_be32 = daddr_be32;
+  udp = (ci_udp_hdr*) (ip + 1);
+  udp->udp_source_be16 = CI_BSWAP_BE16(sport);
+  udp->udp_dest_be16 = LPORT;
+  *(ci_uint8*) CI_UDP_PAYLOAD(udp) = tag;
+  oo_offbuf_init(&pkt->buf, CI_UDP_PAYLOAD(udp), PAY_LEN);
+  return pkt;
+}
+
+
+/* The member chosen by hash for a datagram from [sport] */
+static int hash_member(int g, int sport)
+{
+  return onload_hash3(CI_ADDR_FROM_IP4(LADDR), LPORT,
+                      CI_ADDR_FROM_IP4(SADDR), CI_BSWAP_BE16(sport),
+                      IPPROTO_UDP) % group(g)->n_members;
+}
+
+
+static void test_join_leave(void)
+{
+  struct oo_udp_reuseport_group* grp;
+  int i;
+
+  setup();
+
+  /* The first socket creates the group, and the rest join it in order */
+  for( i = 0; i < 4; ++i )
+    ci_udp_reuseport_group_join(ni, socks[i]);
+  CHECK(socks[0]->reuseport_group, ==, 0);
+  grp = group(0);
+  CHECK(grp->n_members, ==, 4);
+  CHECK(grp->lport_be16, ==, LPORT);
+  for( i = 0; i < 4; ++i ) {
+    CHECK(socks[i]->reuseport_group, ==, 0);
+    CHECK(OO_SP_TO_INT(grp->members[i]), ==, i);
+  }
+
+  /* Joining again changes nothing */
+  ci_udp_reuseport_group_join(ni, socks[2]);
+  CHECK(grp->n_members, ==, 4);
+
+  /* Another port has a group of its own */
+  udp_lport_be16(socks[4]) = CI_BSWAPC_BE16(4321);
+  ci_udp_reuseport_group_join(ni, socks[4]);
+  CHECK(socks[4]->reuseport_group, ==, 1);
+  CHECK(group(1)->n_members, ==, 1);
+
+  /* Sockets that are connected or not SO_REUSEPORT don't join */
+  socks[5]->s.pkt.ipx.ip4.ip_daddr_be32 = SADDR;
+  ci_udp_reuseport_group_join(ni, socks[5]);
+  CHECK(socks[5]->reuseport_group, ==, -1);
+  socks[6]->s.s_flags = 0;
+  ci_udp_reuseport_group_join(ni, socks[6]);
+  CHECK(socks[6]->reuseport_group, ==, -1);
+  CHECK(grp->n_members, ==, 4);
+
+  /* The last member fills the hole left by a leaver */
+  ci_udp_reuseport_group_leave(ni, socks[1]);
+  CHECK(socks[1]->reuseport_group, ==, -1);
+  CHECK(grp->n_members, ==, 3);
+  CHECK(OO_SP_TO_INT(grp->members[0]), ==, 0);
+  CHECK(OO_SP_TO_INT(grp->members[1]), ==, 3);
+  CHECK(OO_SP_TO_INT(grp->members[2]), ==, 2);
+
+  /* The last member leaving leaves no hole */
+  ci_udp_reuseport_group_leave(ni, socks[2]);
+  CHECK(grp->n_members, ==, 2);
+  CHECK(OO_SP_TO_INT(grp->members[0]), ==, 0);
+  CHECK(OO_SP_TO_INT(grp->members[1]), ==, 3);
+
+  /* Leaving twice is harmless */
+  ci_udp_reuseport_group_leave(ni, socks[2]);
+  CHECK(grp->n_members, ==, 2);
+
+  /* A rejoining socket goes on the end, and an emptied group is free */
+  ci_udp_reuseport_group_join(ni, socks[1]);
+  CHECK(grp->n_members, ==, 3);
+  CHECK(OO_SP_TO_INT(grp->members[2]), ==, 1);
+  ci_udp_reuseport_group_leave(ni, socks[4]);
+  CHECK(group(1)->n_members, ==, 0);
+  ci_udp_reuseport_group_join(ni, socks[4]);
+  CHECK(socks[4]->reuseport_group, ==, 1);
+
+  teardown();
+}
+
+
+static void test_select_hash(void)
+{
+  ci_ip_pkt_fmt* pkt;
+  ci_udp_state* us;
+  int seen[N_SOCKS] = {};
+  int sport, i, n_seen = 0;
+
+  setup();
+  for( i = 0; i < 4; ++i )
+    ci_udp_reuseport_group_join(ni, socks[i]);
+
+  for( sport = 1000; sport < 1064; ++sport ) {
+    ci_udp_state* chosen;
+    ci_udp_state* us;
+    int m = hash_member(0, sport);
+
+    /* The same member, whichever socket the filter matched, and every
+     * time */
+    pkt = rx_pkt(0, LADDR, sport, 0);
+    chosen = ci_udp_reuseport_group_select(ni, socks[0], pkt);
+    CHECK(chosen, ==, socks[m]);
+    for( i = 0; i < 4; ++i ) {
+      us = ci_udp_reuseport_group_select(ni, socks[i], pkt);
+      CHECK(us, ==, chosen);
+    }
+    if( seen[m]++ == 0 )
+      ++n_seen;
+  }
+  /* Spread over all of them */
+  CHECK(n_seen, ==, 4);
+  CHECK(ni->state->stats.udp_reuseport_hash, ==, 64 * 5);
+  CHECK(ni->state->stats.udp_reuseport_prog, ==, 0);
+  for( i = 0; i < 4; ++i )
+    CHECK(socks[i]->stats.n_rx_reuseport, ==, seen[i] * 5);
+
+  /* Multicast and broadcast go to the socket matched */
+  pkt = rx_pkt(0, MULTICAST, 1000, 0);
+  for( i = 0; i < 4; ++i ) {
+    us = ci_udp_reuseport_group_select(ni, socks[i], pkt);
+    CHECK(us, ==, socks[i]);
+  }
+  pkt = rx_pkt(0, CI_IP_ALL_BROADCAST, 1000, 0);
+  us = ci_udp_reuseport_group_select(ni, socks[2], pkt);
+  CHECK(us, ==, socks[2]);
+
+  /* A member left alone has everything */
+  for( i = 1; i < 4; ++i )
+    ci_udp_reuseport_group_leave(ni, socks[i]);
+  pkt = rx_pkt(0, LADDR, 1001, 0);
+  us = ci_udp_reuseport_group_select(ni, socks[0], pkt);
+  CHECK(us, ==, socks[0]);
+
+  teardown();
+}
+
+
+static void test_select_prog(void)
+{
+  /* Use the first byte of the payload as the index */
+  const struct oo_bpf_insn first_byte[] = {
+    INSN(0x30, 0, 0, 0),        /* ldb [0] */
+    INSN(0x16, 0, 0, 0),        /* ret a */
+  };
+  ci_ip_pkt_fmt* pkt;
+  ci_udp_state* us;
+  int rc, i;
+
+  setup();
+  for( i = 0; i < 4; ++i )
+    ci_udp_reuseport_group_join(ni, socks[i]);
+  rc = ci_udp_reuseport_group_attach(ni, socks[2], first_byte, 2);
+  CHECK(rc, ==, 0);
+  CHECK(group(0)->prog_len, ==, 2);
+
+  for( i = 0; i < 4; ++i ) {
+    pkt = rx_pkt(0, LADDR, 1000 + i, 3 - i);
+    us = ci_udp_reuseport_group_select(ni, socks[0], pkt);
+    CHECK(us, ==, socks[3 - i]);
+  }
+  CHECK(ni->state->stats.udp_reuseport_prog, ==, 4);
+  CHECK(ni->state->stats.udp_reuseport_hash, ==, 0);
+
+  /* An index beyond the last member falls back to the hash */
+  pkt = rx_pkt(0, LADDR, 1000, 4);
+  us = ci_udp_reuseport_group_select(ni, socks[0], pkt);
+  CHECK(us, ==, socks[hash_member(0, 1000)]);
+  CHECK(ni->state->stats.udp_reuseport_hash, ==, 1);
+
+  /* The index follows the order of the members after one leaves */
+  ci_udp_reuseport_group_leave(ni, socks[0]);
+  pkt = rx_pkt(0, LADDR, 1000, 0);
+  us = ci_udp_reuseport_group_select(ni, socks[1], pkt);
+  CHECK(us, ==, socks[3]);
+  pkt = rx_pkt(0, LADDR, 1000, 3);
+  us = ci_udp_reuseport_group_select(ni, socks[1], pkt);
+  CHECK(us, ==, socks[OO_SP_TO_INT(group(0)->members[hash_member(0, 1000)])]);
+
+  /* Detached, it's all by hash */
+  rc = ci_udp_reuseport_group_attach(ni, socks[1], NULL, 0);
+  CHECK(rc, ==, 0);
+  CHECK(group(0)->prog_len, ==, 0);
+  pkt = rx_pkt(0, LADDR, 1000, 0);
+  us = ci_udp_reuseport_group_select(ni, socks[1], pkt);
+  CHECK(us, ==, socks[OO_SP_TO_INT(group(0)->members[hash_member(0, 1000)])]);
+
+  teardown();
+}
+
+
+/* Receive [pkt] as the stack does, and return the number of sockets it
+ * was offered to */
+static int handle_rx(ci_ip_pkt_fmt* pkt)
+{
+  ci_udp_hdr* udp = (ci_udp_hdr*) (oo_ip_hdr(pkt) + 1);
+
+  udp->udp_len_be16 = CI_BSWAP_BE16(sizeof(*udp) + PAY_LEN);
+  n_offered = 0;
+  freed = NULL;
+  ci_udp_handle_rx(ni, pkt, udp, sizeof(*udp) + PAY_LEN);
+  return n_offered;
+}
+
+
+static void test_deliver(void)
+{
+  ci_ip_pkt_fmt* pkt;
+  int m, n, i;
+
+  setup();
+  n_group = 4;
+  for( i = 0; i < n_group; ++i )
+    ci_udp_reuseport_group_join(ni, socks[i]);
+  m = hash_member(0, 1000);
+
+  /* Queued on the chosen member, by the first socket offered it */
+  pkt = rx_pkt(0, LADDR, 1000, 'a');
+  n = handle_rx(pkt);
+  CHECK(n, ==, 1);
+  CHECK(freed, ==, NULL);
+  CHECK(pkt->refcount, ==, 1);
+  CHECK(ci_udp_recv_q_pkts(&socks[m]->recv_q), ==, 1);
+  CHECK(OO_PP_EQ(socks[m]->recv_q.head, OO_PKT_P(pkt)), !=, 0);
+  for( i = 0; i < n_group; ++i )
+    if( i != m )
+      CHECK(ci_udp_recv_q_pkts(&socks[i]->recv_q), ==, 0);
+
+  /* Dropped by the chosen member: counted there once, and offered to no
+   * other member to be chosen again */
+  socks[m]->stats.max_recvq_pkts = 1;
+  socks[m]->s.so.rcvbuf = 0;
+  pkt = rx_pkt(1, LADDR, 1000, 'b');
+  n = handle_rx(pkt);
+  CHECK(n, ==, 1);
+  CHECK(freed, ==, pkt);
+  CHECK(socks[m]->stats.n_rx_overflow, ==, 1);
+  CHECK(socks[m]->stats.n_rx_reuseport, ==, 2);
+  CHECK(ci_udp_recv_q_pkts(&socks[m]->recv_q), ==, 1);
+  for( i = 0; i < n_group; ++i ) {
+    if( i != m ) {
+      CHECK(socks[i]->stats.n_rx_overflow, ==, 0);
+      CHECK(ci_udp_recv_q_pkts(&socks[i]->recv_q), ==, 0);
+    }
+    CHECK(socks[i]->stats.n_rx_mem_drop, ==, 0);
+  }
+
+  /* Multicast is still offered to every member, each counting its own
+   * drop */
+  for( i = 0; i < n_group; ++i ) {
+    if( i != m )
+      ci_udp_recv_q_put(ni, &socks[i]->recv_q,
+                        rx_pkt(3 + i, LADDR, 1000, 'x'));
+    socks[i]->stats.n_rx_overflow = 0;
+    socks[i]->stats.max_recvq_pkts = 1;
+    socks[i]->s.so.rcvbuf = 0;
+  }
+  pkt = rx_pkt(2, MULTICAST, 1000, 'c');
+  n = handle_rx(pkt);
+  CHECK(n, ==, n_group);
+  CHECK(freed, ==, pkt);
+  for( i = 0; i < n_group; ++i )
+    CHECK(socks[i]->stats.n_rx_overflow, ==, 1);
+
+  teardown();
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_join_leave);
+  TEST_RUN(test_select_hash);
+  TEST_RUN(test_select_prog);
+  TEST_RUN(test_deliver);
+  TEST_END();
+}
@@ -0,0 +1,335 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Contention benchmark for UDP sends from many threads sharing a stack.
+ *
+ * Each thread sends on a UDP socket of its own in one synthetic stack.  The
+ * stack lock and the deferral of work through the lock word are the real
+ * code from netif.c and udp_misc.c.
+ * Building and transmitting the datagram are not: the datagrams are
+ * preallocated, and "transmitting" one is a fixed SEND_COST cycles of work
+ * under the lock, standing in for pushing it to the NIC.
+ *
+ * Each scenario is run with 1, 2, 4, 8, 16 and 32 threads, and prints one
+ * line of JSON per thread count to stdout:
+ *   {"bench":"<name>","threads":<t>,"ops":<n>,"cycles_per_op":<x>,
+ *    "cycles_min":<y>}
+ * where cycles_per_op is the time a thread spends in each send, averaged
+ * over all threads and runs, and cycles_min is from the fastest run.
+ * Usage: udp_send_bench [<ops-per-thread-per-run> [<runs>]]
+ *
+ * Scenarios:
+ *  udp_send_lock       every send waits for the stack lock, as with
+ *                      EF_UDP_SEND_UNLOCKED=0
+ *  udp_send_defer      a sender that finds the lock held queues its
+ *                      datagram and defers the socket to the lock holder
+ *                      through the lock word
+ *
+ * Waiting for the lock spins, yielding the CPU, rather than sleeping in
+ * the kernel.  The checks confirm that every datagram was sent, and in
+ * order for its socket.  With fewer CPUs than threads the figures mostly
+ * show the scheduler, as each thread's time includes that of the threads
+ * that preempt it.
+ */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define MAX_THREADS  32
+#define N_PKTS       PKTS_PER_SET
+/* Datagrams each socket can have queued: its send buffer */
+#define RING         (N_PKTS / MAX_THREADS)
+#define SEND_COST    200
+/* Spins after which a sender waiting for its datagrams to go yields */
+#define SPIN_YIELD   1000
+
+enum mode { MODE_LOCK, MODE_DEFER };
+
+struct sender {
+  pthread_t      thread;
+  ci_udp_state*  us;
+  ci_ip_pkt_fmt* ring[RING];
+  /* Written by the sender only */
+  unsigned       n_queued;
+  ci_uint64      cycles;
+  /* Written under the stack lock only */
+  unsigned       n_sent CI_ALIGN(CI_CACHE_LINE_SIZE);
+};
+
+static ci_netif*         ni;
+static struct sender     senders[MAX_THREADS];
+static enum mode         mode;
+static pthread_barrier_t start_barrier;
+
+static int cfg_ops = 20000;
+static int cfg_runs = 5;
+
+
+/**********************************************************************
+ * Dependencies
+ */
+
+/* Waiting for the lock in the kernel */
+int __ef_eplock_lock_slow(ci_netif* netif, long timeout, int maybe_wedged)
+{
+  int spins = 0;
+
+  while( ! ef_eplock_trylock(&netif->state->lock) )
+    if( ++spins % SPIN_YIELD == 0 )
+      sched_yield();
+    else
+      ci_spinloop_pause();
+  return 0;
+}
+
+
+static void xmit(ci_udp_state* us, ci_ip_pkt_fmt* pkt)
+{
+  struct sender* snd = &senders[S_ID(us)];
+  ci_uint64 start = ci_frc64_get();
+
+  CHECK_TRUE(ci_netif_is_locked(ni));
+  CHECK(pkt->pf.udp.pay_len, ==, snd->n_sent);
+  ++snd->n_sent;
+  while( ci_frc64_get() - start < SEND_COST )
+    ci_spinloop_pause();
+}
+
+
+/* The send path's own version of this builds and transmits each datagram */
+void ci_udp_sendmsg_send_async_q(ci_netif* netif, ci_udp_state* us)
+{
+  oo_pkt_p pp, send_list;
+  ci_ip_pkt_fmt* pkt;
+  int n = 0;
+
+  do {
+    OO_PP_INIT(netif, pp, us->tx_async_q);
+    if( OO_PP_IS_NULL(pp) )  return;
+  } while( ci_cas32_fail(&us->tx_async_q, OO_PP_ID(pp), OO_PP_ID_NULL) );
+
+  send_list = OO_PP_NULL;
+  do {
+    pkt = PKT(netif, pp);
+    pp = pkt->netif.tx.dmaq_next;
+    pkt->netif.tx.dmaq_next = send_list;
+    send_list = OO_PKT_P(pkt);
+  } while( OO_PP_NOT_NULL(pp) );
+
+  for( pp = send_list; OO_PP_NOT_NULL(pp); pp = pkt->netif.tx.dmaq_next ) {
+    pkt = PKT(netif, pp);
+    xmit(us, pkt);
+    ++n;
+  }
+  /* The sender may reuse the packets once they are off the level. */
+  oo_atomic_add(&us->tx_async_q_level, -n);
+}
+
+
+/**********************************************************************
+ * Synthetic stack
+ */
+
+static void* alloc_zeroed(size_t bytes)
+{
+  void* p;
+
+  bytes = CI_ROUND_UP(bytes, CI_PAGE_SIZE);
+  p = aligned_alloc(CI_PAGE_SIZE, bytes);
+  memset(p, 0, bytes);
+  return p;
+}
+
+
+static void setup_stack(void)
+{
+  unsigned ep_ofs = CI_ROUND_UP(sizeof(ci_netif_state), CI_PAGE_SIZE);
+  oo_pktbuf_manager* pm;
+  int t, i;
+
+  ni = calloc(1, sizeof(*ni));
+  ni->state = alloc_zeroed(ep_ofs + MAX_THREADS * EP_BUF_SIZE);
+  *(ci_uint32*) &ni->state->ep_ofs = ep_ofs;
+  *(ci_uint32*) &ni->state->n_ep_bufs = MAX_THREADS;
+  NI_OPTS(ni).defer_work_limit = 32;
+
+  pm = calloc(1, sizeof(*pm) + sizeof(pm->set[0]));
+  *(ci_uint32*) &pm->sets_n = 1;
+  *(ci_uint32*) &pm->sets_max = 1;
+  *(ci_int32*) &pm->n_pkts_allocated = N_PKTS;
+  ni->packets = pm;
+  ni->pkt_bufs = calloc(1, sizeof(ni->pkt_bufs[0]));
+  ni->pkt_bufs[0] = alloc_zeroed(N_PKTS * CI_CFG_PKT_BUF_SIZE);
+
+  for( t = 0; t < MAX_THREADS; ++t ) {
+    senders[t].us = SP_TO_UDP(ni, OO_SP_FROM_INT(ni, t));
+    for( i = 0; i < RING; ++i ) {
+      ci_ip_pkt_fmt* pkt = (ci_ip_pkt_fmt*) __PKT_BUF(ni, t * RING + i);
+      OO_PP_INIT(ni, pkt->pp, t * RING + i);
+      pkt->refcount = 1;
+      senders[t].ring[i] = pkt;
+    }
+  }
+}
+
+
+static void setup_sockets(void)
+{
+  int t;
+
+  for( t = 0; t < MAX_THREADS; ++t ) {
+    struct sender* snd = &senders[t];
+    ci_udp_state* us = snd->us;
+
+    memset(us, 0, sizeof(*us));
+    us->s.b.bufid = OO_SP_FROM_INT(ni, t);
+    us->s.b.state = CI_TCP_STATE_UDP;
+    us->tx_async_q = CI_ILL_END;
+    oo_atomic_set(&us->tx_async_q_level, 0);
+    snd->n_queued = snd->n_sent = 0;
+    snd->cycles = 0;
+  }
+}
+
+
+/**********************************************************************
+ * Senders
+ */
+
+/* As ci_udp_sendmsg_async_q_enqueue() */
+static void async_q_enqueue(ci_udp_state* us, ci_ip_pkt_fmt* pkt)
+{
+  oo_atomic_add(&us->tx_async_q_level, 1);
+  do
+    OO_PP_INIT(ni, pkt->netif.tx.dmaq_next, us->tx_async_q);
+  while( ci_cas32_fail(&us->tx_async_q,
+                       OO_PP_ID(pkt->netif.tx.dmaq_next), OO_PKT_ID(pkt)) );
+
+  if( ci_netif_lock_or_defer_work(ni, &us->s.b) )
+    ci_netif_unlock(ni);
+}
+
+
+static void send_one(struct sender* snd)
+{
+  ci_udp_state* us = snd->us;
+  ci_ip_pkt_fmt* pkt = snd->ring[snd->n_queued % RING];
+  int spins = 0;
+
+  /* Wait for room in the send buffer. */
+  while( oo_atomic_read(&us->tx_async_q_level) >= RING )
+    if( ++spins % SPIN_YIELD == 0 )
+      sched_yield();
+    else
+      ci_spinloop_pause();
+  pkt->pf.udp.pay_len = snd->n_queued++;
+
+  if( mode == MODE_LOCK ) {
+    ci_netif_lock(ni);
+    xmit(us, pkt);
+    ci_netif_unlock(ni);
+  }
+  else if( ci_netif_trylock(ni) ) {
+    xmit(us, pkt);
+    ci_netif_unlock(ni);
+  }
+  else {
+    async_q_enqueue(us, pkt);
+  }
+}
+
+
+static void* sender_thread(void* arg)
+{
+  struct sender* snd = arg;
+  ci_uint64 start;
+  int i;
+
+  pthread_barrier_wait(&start_barrier);
+  start = ci_frc64_get();
+  for( i = 0; i < cfg_ops; ++i )
+    send_one(snd);
+  snd->cycles = ci_frc64_get() - start;
+  return NULL;
+}
+
+
+/**********************************************************************
+ * Measurement
+ */
+
+static void bench_send(const char* name, enum mode m)
+{
+  int n_threads, run, t, rc;
+
+  mode = m;
+
+  for( n_threads = 1; n_threads <= MAX_THREADS; n_threads *= 2 ) {
+    ci_uint64 cycles = 0, best = 0, run_cycles;
+
+    for( run = 0; run < cfg_runs; ++run ) {
+      setup_sockets();
+      pthread_barrier_init(&start_barrier, NULL, n_threads);
+      for( t = 0; t < n_threads; ++t ) {
+        rc = pthread_create(&senders[t].thread, NULL, sender_thread,
+                            &senders[t]);
+        CHECK(rc, ==, 0);
+      }
+      run_cycles = 0;
+      for( t = 0; t < n_threads; ++t ) {
+        pthread_join(senders[t].thread, NULL);
+        run_cycles += senders[t].cycles;
+      }
+      pthread_barrier_destroy(&start_barrier);
+
+      /* Nothing may be left behind once every sender has returned. */
+      CHECK(ni->state->lock.lock, ==, 0);
+      for( t = 0; t < n_threads; ++t ) {
+        CHECK(senders[t].n_sent, ==, cfg_ops);
+        CHECK(senders[t].us->tx_async_q, ==, CI_ILL_END);
+        CHECK(senders[t].us->s.b.sb_aflags, ==, 0);
+      }
+
+      cycles += run_cycles;
+      if( best == 0 || run_cycles < best )
+        best = run_cycles;
+    }
+
+    printf("{\"bench\":\"%s\",\"threads\":%d,\"ops\":%llu,"
+           "\"cycles_per_op\":%.1f,\"cycles_min\":%.1f}\n",
+           name, n_threads,
+           (unsigned long long) cfg_runs * n_threads * cfg_ops,
+           (double) cycles / ((ci_uint64) cfg_runs * n_threads * cfg_ops),
+           (double) best / ((ci_uint64) n_threads * cfg_ops));
+    fflush(stdout);
+  }
+}
+
+
+static void test_udp_send_bench(void)
+{
+  setup_stack();
+  bench_send("udp_send_lock", MODE_LOCK);
+  bench_send("udp_send_defer", MODE_DEFER);
+}
+
+
+int main(int argc, char* argv[])
+{
+  if( argc > 1 )
+    cfg_ops = CI_MAX(atoi(argv[1]), 1);
+  if( argc > 2 )
+    cfg_runs = CI_MAX(atoi(argv[2]), 1);
+  TEST_RUN(test_udp_send_bench);
+  TEST_END();
+}
@@ -0,0 +1,445 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include "internal.h"
+#include "ul_epoll.h"
+#include <ci/internal/efabcfg.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+/* A 3GHz clock makes a cycle a third of a nanosecond, so conversions to
+ * time have to round.  A 500MHz clock makes a nanosecond half a cycle. */
+#define KHZ        3000000
+#define SLOW_KHZ   500000
+
+#define EPFD       10
+#define EPBFD      11
+#define TCPFD      12
+#define MAXEVENTS  8
+
+static citp_protocol_impl epoll_impl = { .type = CITP_EPOLL_FD };
+static citp_protocol_impl epollb_impl = { .type = CITP_EPOLLB_FD };
+static citp_protocol_impl tcp_impl = { .type = CITP_TCP_SOCKET };
+static citp_fdinfo epoll_fdi, epollb_fdi, tcp_fdi;
+
+static struct epoll_event events[MAXEVENTS];
+static sigset_t mask;
+static struct pollfd pfd;
+
+/* What each stub was last called with, and how often */
+static int n_epoll_wait, n_epollb_wait, n_sys_pwait2;
+static ci_int64 epoll_timeout_hr;
+static int epollb_timeout_ms;
+static const sigset_t* wait_sigmask;
+static const struct timespec* sys_timeout;
+
+static int n_do_poll, n_sys_poll, n_sys_ppoll;
+static ci_uint64 poll_timeout_frc, poll_used_frc;
+static int sys_poll_timeout;
+static struct timespec sys_ppoll_ts;
+static bool sys_ppoll_ts_null;
+
+
+/* Dependencies */
+ci_cfg_opts_t ci_cfg_opts;
+citp_globals_t citp;
+citp_ul_lock_t citp_ul_lock;
+citp_fdtable_globals citp_fdtable;
+citp_fdinfo citp_the_closed_fd;
+citp_fdinfo citp_the_reserved_fd;
+unsigned citp_log_level;
+ci_uint64 fdtable_seq_no;
+struct citp_uring* citp_urings;
+__thread struct oo_per_thread oo_per_thread = { .initialised = 1 };
+
+/* The libc calls that the intercepts fall back on */
+#define CI_MK_DECL(ret, fn, args)  ret (*ci_sys_##fn) args;
+#define CI_MK_DECL_OPTIONAL CI_MK_DECL
+#include <onload/declare_syscalls.h.tmpl>
+
+/* Only its address is needed */
+int citp_ep_dup_dup(int oldfd, long arg_unused)
+{
+  CHECK_TRUE(0);
+  return -1;
+}
+
+citp_fdinfo* citp_fdtable_lookup(unsigned fd)
+{
+  citp_fdinfo* fdi;
+
+  switch( fd ) {
+  case EPFD:
+    fdi = &epoll_fdi;
+    break;
+  case EPBFD:
+    fdi = &epollb_fdi;
+    break;
+  case TCPFD:
+    fdi = &tcp_fdi;
+    break;
+  default:
+    return NULL;
+  }
+  citp_fdinfo_ref(fdi);
+  return fdi;
+}
+
+int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event* ev,
+                    struct citp_ordered_wait* ordering, int maxev,
+                    ci_int64 timeout_hr, const sigset_t* sigmask,
+                    citp_lib_context_t* lib_context)
+{
+  CHECK_TRUE(fdi == &epoll_fdi);
+  CHECK_TRUE(ev == events);
+  CHECK(maxev, ==, MAXEVENTS);
+  ++n_epoll_wait;
+  epoll_timeout_hr = timeout_hr;
+  wait_sigmask = sigmask;
+  citp_exit_lib(lib_context, TRUE);
+  return 1;
+}
+
+int citp_epollb_wait(citp_fdinfo* fdi, struct epoll_event* ev,
+                     int maxev, int timeout, const sigset_t* sigmask,
+                     citp_lib_context_t* lib_context)
+{
+  CHECK_TRUE(fdi == &epollb_fdi);
+  ++n_epollb_wait;
+  epollb_timeout_ms = timeout;
+  wait_sigmask = sigmask;
+  return 1;
+}
+
+static int sys_epoll_pwait2(int epfd, struct epoll_event* ev, int maxev,
+                            const struct timespec* timeout,
+                            const sigset_t* sigmask)
+{
+  ++n_sys_pwait2;
+  sys_timeout = timeout;
+  wait_sigmask = sigmask;
+  return 2;
+}
+
+/* Spins for [poll_used_frc] and finds nothing */
+int citp_ul_do_poll(struct pollfd* fds, nfds_t nfds, ci_uint64 timeout_frc,
+                    ci_uint64* used_frc, citp_lib_context_t* lib_context,
+                    const sigset_t* sigmask)
+{
+  ++n_do_poll;
+  poll_timeout_frc = timeout_frc;
+  *used_frc = poll_used_frc;
+  citp_exit_lib(lib_context, TRUE);
+  return 0;
+}
+
+static int sys_poll(struct pollfd* fds, nfds_t nfds, int timeout)
+{
+  ++n_sys_poll;
+  sys_poll_timeout = timeout;
+  return 0;
+}
+
+static int sys_ppoll(struct pollfd* fds, nfds_t nfds,
+                     const struct timespec* ts, const sigset_t* sigmask)
+{
+  ++n_sys_ppoll;
+  sys_ppoll_ts_null = ts == NULL;
+  if( ts != NULL )
+    sys_ppoll_ts = *ts;
+  return 0;
+}
+
+
+static void setup(unsigned khz)
+{
+  citp.init_level = CITP_INIT_ALL;
+  citp.cpu_khz = khz;
+  CITP_OPTS.ul_epoll = 3;
+  CITP_OPTS.ul_poll = 1;
+
+  citp_fdinfo_init(&epoll_fdi, &epoll_impl);
+  citp_fdinfo_init(&epollb_fdi, &epollb_impl);
+  citp_fdinfo_init(&tcp_fdi, &tcp_impl);
+  sigemptyset(&mask);
+
+  ci_sys_epoll_pwait2 = sys_epoll_pwait2;
+  ci_sys_poll = sys_poll;
+  ci_sys_ppoll = sys_ppoll;
+
+  n_epoll_wait = n_epollb_wait = n_sys_pwait2 = 0;
+  n_do_poll = n_sys_poll = n_sys_ppoll = 0;
+  poll_used_frc = 0;
+  wait_sigmask = NULL;
+}
+
+
+/* The fd table's references are given back */
+static void check_refs(void)
+{
+  CHECK(oo_atomic_read(&epoll_fdi.ref_count), ==, 1);
+  CHECK(oo_atomic_read(&epollb_fdi.ref_count), ==, 1);
+  CHECK(oo_atomic_read(&tcp_fdi.ref_count), ==, 1);
+  CHECK(oo_per_thread.sig.c.inside_lib, ==, 0);
+}
+
+
+static ci_int64 pwait2_hr(time_t sec, long nsec)
+{
+  struct timespec ts = { .tv_sec = sec, .tv_nsec = nsec };
+  int rc;
+
+  rc = onload_epoll_pwait2(EPFD, events, MAXEVENTS, &ts, &mask);
+  CHECK(rc, ==, 1);
+  CHECK_TRUE(wait_sigmask == &mask);
+  return epoll_timeout_hr;
+}
+
+
+/* The timeout reaches the UL epoll in cycles, not rounded to milliseconds */
+static void test_epoll_pwait2(void)
+{
+  ci_int64 hr;
+  int rc;
+
+  setup(KHZ);
+
+  hr = pwait2_hr(0, 50000);
+  CHECK(hr, ==, 150000);
+  hr = pwait2_hr(2, 1000);
+  CHECK(hr, ==, 2ll * KHZ * 1000 + 3000);
+  hr = pwait2_hr(0, 0);
+  CHECK(hr, ==, 0);
+  CHECK(n_epoll_wait, ==, 3);
+
+  /* No timeout, and one too long to spin for, are the same */
+  rc = onload_epoll_pwait2(EPFD, events, MAXEVENTS, NULL, NULL);
+  CHECK(rc, ==, 1);
+  CHECK(epoll_timeout_hr, ==, OO_EPOLL_MAX_TIMEOUT_HR);
+  CHECK_TRUE(wait_sigmask == NULL);
+  hr = pwait2_hr(1ll << 40, 0);
+  CHECK(hr, ==, OO_EPOLL_MAX_TIMEOUT_HR);
+
+  CHECK(n_sys_pwait2, ==, 0);
+  check_refs();
+}
+
+
+/* A timeout shorter than a cycle must not become a non-blocking call */
+static void test_epoll_pwait2_tiny(void)
+{
+  ci_int64 hr;
+
+  setup(SLOW_KHZ);
+  hr = pwait2_hr(0, 1);
+  CHECK(hr, ==, 1);
+  hr = pwait2_hr(0, 3);
+  CHECK(hr, ==, 1);
+  hr = pwait2_hr(0, 4);
+  CHECK(hr, ==, 2);
+  check_refs();
+}
+
+
+#if CI_CFG_EPOLL2
+static int pwait2_ms(const struct timespec* ts)
+{
+  int rc = onload_epoll_pwait2(EPBFD, events, MAXEVENTS, ts, &mask);
+  CHECK(rc, ==, 1);
+  return epollb_timeout_ms;
+}
+
+
+/* EF_UL_EPOLL=2 only does milliseconds, so rounds up */
+static void test_epoll_pwait2_epollb(void)
+{
+  struct timespec ts;
+  int ms;
+
+  setup(KHZ);
+  ts = (struct timespec) { .tv_sec = 0, .tv_nsec = 1500000 };
+  ms = pwait2_ms(&ts);
+  CHECK(ms, ==, 2);
+  ts = (struct timespec) { .tv_sec = 0, .tv_nsec = 1 };
+  ms = pwait2_ms(&ts);
+  CHECK(ms, ==, 1);
+  ts = (struct timespec) { .tv_sec = 3, .tv_nsec = 0 };
+  ms = pwait2_ms(&ts);
+  CHECK(ms, ==, 3000);
+  ts = (struct timespec) { .tv_sec = 0, .tv_nsec = 0 };
+  ms = pwait2_ms(&ts);
+  CHECK(ms, ==, 0);
+  ms = pwait2_ms(NULL);
+  CHECK(ms, ==, -1);
+  CHECK_TRUE(wait_sigmask == &mask);
+  CHECK(n_epoll_wait, ==, 0);
+  check_refs();
+}
+#endif
+
+
+/* Anything we can't accelerate goes to the kernel as it was */
+static void test_epoll_pwait2_pass_through(void)
+{
+  struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000000 };
+  int rc;
+
+  setup(KHZ);
+
+  /* The kernel rejects this, not us */
+  rc = onload_epoll_pwait2(EPFD, events, MAXEVENTS, &ts, &mask);
+  CHECK(rc, ==, 2);
+  CHECK_TRUE(sys_timeout == &ts);
+  CHECK_TRUE(wait_sigmask == &mask);
+
+  ts.tv_nsec = 1000;
+  rc = onload_epoll_pwait2(TCPFD, events, MAXEVENTS, &ts, &mask);
+  CHECK(rc, ==, 2);
+  rc = onload_epoll_pwait2(EPFD + 100, events, MAXEVENTS, &ts, &mask);
+  CHECK(rc, ==, 2);
+
+  CITP_OPTS.ul_epoll = 0;
+  rc = onload_epoll_pwait2(EPFD, events, MAXEVENTS, &ts, NULL);
+  CHECK(rc, ==, 2);
+  CHECK_TRUE(sys_timeout == &ts);
+  CHECK_TRUE(wait_sigmask == NULL);
+
+  CHECK(n_sys_pwait2, ==, 4);
+  CHECK(n_epoll_wait, ==, 0);
+  check_refs();
+}
+
+
+static void ppoll_ns(long nsec)
+{
+  struct timespec ts = { .tv_sec = 0, .tv_nsec = nsec };
+  int rc = onload_ppoll(&pfd, 1, &ts, &mask);
+  CHECK(rc, ==, 0);
+}
+
+
+/* ppoll() spins for the timeout in cycles, and what's left of it goes to
+ * the kernel rounded up */
+static void test_ppoll(void)
+{
+  int rc;
+
+  setup(KHZ);
+
+  ppoll_ns(50000);
+  CHECK(poll_timeout_frc, ==, 150000);
+  CHECK(n_sys_ppoll, ==, 1);
+  CHECK_TRUE(! sys_ppoll_ts_null);
+  CHECK_TRUE(sys_ppoll_ts.tv_sec == 0 && sys_ppoll_ts.tv_nsec == 50000);
+
+  /* 100000 cycles is 33333.3ns, leaving 16666.7ns */
+  poll_used_frc = 100000;
+  ppoll_ns(50000);
+  CHECK(n_sys_ppoll, ==, 2);
+  CHECK_TRUE(sys_ppoll_ts.tv_sec == 0 && sys_ppoll_ts.tv_nsec == 16667);
+
+  /* Spun for all of it, or more */
+  poll_used_frc = 150000;
+  ppoll_ns(50000);
+  poll_used_frc = 200000;
+  ppoll_ns(50000);
+  CHECK(n_sys_ppoll, ==, 2);
+
+  /* A non-blocking ppoll() with a mask still checks for signals */
+  poll_used_frc = 0;
+  ppoll_ns(0);
+  CHECK(poll_timeout_frc, ==, 0);
+  CHECK(n_sys_ppoll, ==, 3);
+
+  /* No timeout stays no timeout */
+  rc = onload_ppoll(&pfd, 1, NULL, &mask);
+  CHECK(rc, ==, 0);
+  CHECK(poll_timeout_frc, ==, CITP_TIMEOUT_FRC_MAX);
+  CHECK(n_sys_ppoll, ==, 4);
+  CHECK_TRUE(sys_ppoll_ts_null);
+
+  CHECK(n_do_poll, ==, 6);
+}
+
+
+/* poll() blocks in the kernel for the rest of the timeout, rounded up, and
+ * not at all once spinning has used it up */
+static void test_poll(void)
+{
+  int rc;
+
+  setup(KHZ);
+
+  poll_used_frc = 1;
+  rc = onload_poll(&pfd, 1, 5);
+  CHECK(rc, ==, 0);
+  CHECK(poll_timeout_frc, ==, 5ull * KHZ);
+  CHECK(n_sys_poll, ==, 1);
+  CHECK(sys_poll_timeout, ==, 5);
+
+  poll_used_frc = 5ull * KHZ + 1;
+  rc = onload_poll(&pfd, 1, 5);
+  CHECK(rc, ==, 0);
+  CHECK(n_sys_poll, ==, 1);
+
+  /* No timeout stays no timeout */
+  rc = onload_poll(&pfd, 1, -1);
+  CHECK(rc, ==, 0);
+  CHECK(poll_timeout_frc, ==, CITP_TIMEOUT_FRC_MAX);
+  CHECK(n_sys_poll, ==, 2);
+  CHECK(sys_poll_timeout, ==, -1);
+}
+
+
+static void test_frc_conversions(void)
+{
+  struct timespec ts;
+  struct timeval tv;
+
+  setup(KHZ);
+
+  CHECK(citp_ns_to_frc(1, 5), ==, KHZ * 1000ull + 15);
+  CHECK(citp_ms_to_frc(7), ==, 7ull * KHZ);
+  CHECK(citp_ms_to_frc(~0ull), ==, CITP_TIMEOUT_FRC_MAX);
+  CHECK(citp_timespec_to_frc(NULL), ==, CITP_TIMEOUT_FRC_MAX);
+  CHECK(citp_timeval_to_frc(NULL), ==, CITP_TIMEOUT_FRC_MAX);
+  tv = (struct timeval) { .tv_sec = 0, .tv_usec = 3 };
+  CHECK(citp_timeval_to_frc(&tv), ==, 9000);
+
+  /* What's left is rounded up, never down to nothing */
+  citp_frc_to_timespec(2ull * KHZ * 1000 + 1, 0, &ts);
+  CHECK(ts.tv_sec, ==, 2);
+  CHECK(ts.tv_nsec, ==, 1);
+  citp_frc_to_timespec(KHZ * 1000ull - 1, 0, &ts);
+  CHECK(ts.tv_sec, ==, 1);
+  CHECK(ts.tv_nsec, ==, 0);
+  citp_frc_to_timespec(10, 20, &ts);
+  CHECK(ts.tv_sec, ==, 0);
+  CHECK(ts.tv_nsec, ==, 0);
+
+  citp_frc_to_timeval(3001, 0, &tv);
+  CHECK(tv.tv_sec, ==, 0);
+  CHECK(tv.tv_usec, ==, 2);
+
+  CHECK(citp_frc_to_ms(KHZ + 1, 0), ==, 2);
+  CHECK(citp_frc_to_ms(KHZ, 0), ==, 1);
+  CHECK(citp_frc_to_ms(KHZ, KHZ), ==, 0);
+  CHECK(citp_frc_to_ms(CITP_TIMEOUT_FRC_MAX, 0), ==, 0x7fffffff);
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_epoll_pwait2);
+  TEST_RUN(test_epoll_pwait2_tiny);
+#if CI_CFG_EPOLL2
+  TEST_RUN(test_epoll_pwait2_epollb);
+#endif
+  TEST_RUN(test_epoll_pwait2_pass_through);
+  TEST_RUN(test_ppoll);
+  TEST_RUN(test_poll);
+  TEST_RUN(test_frc_conversions);
+  TEST_END();
+}
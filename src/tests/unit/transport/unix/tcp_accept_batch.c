@@ -0,0 +1,329 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include "internal.h"
+#include <ci/internal/efabcfg.h>
+#include <onload/extensions.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include "unit_netif.h"
+
+#define N_SOCKS    8
+#define LISTEN_FD  3
+#define FD_BASE    100
+
+/* Socket 0 listens, and the others are connections for it to accept */
+#define LISTENER   0
+
+
+static ci_netif* ni;
+static ci_tcp_socket_listen* listener;
+static citp_sock_fdi* epi;
+static struct onload_accept_batch_msg msgs[N_SOCKS];
+
+/* The sockets attached, in order */
+static int attached[N_SOCKS * 2];
+static int n_attached;
+/* Attaching [fail_sock] fails, once, with [fail_rc] */
+static int fail_sock;
+static int fail_rc;
+static int n_inserted;
+
+static ci_tcp_state* sock(int i);
+
+
+/* Dependencies */
+ci_cfg_opts_t ci_cfg_opts;
+citp_globals_t citp;
+citp_ul_lock_t citp_ul_lock;
+citp_fdtable_globals citp_fdtable;
+citp_fdinfo citp_the_closed_fd;
+citp_fdinfo citp_the_reserved_fd;
+ci_uint64 fdtable_seq_no;
+unsigned citp_log_level;
+__thread struct oo_per_thread oo_per_thread = { .initialised = 1 };
+
+/* As the kernel does, a socket that gets an fd leaves the accept queue */
+ci_fd_t ci_tcp_helper_tcp_accept_sock_attach(ci_fd_t fd, oo_sp ep_id,
+                                             int type)
+{
+  int i = OO_SP_TO_INT(ep_id);
+
+  CHECK(n_attached, <, N_SOCKS * 2);
+  attached[n_attached++] = i;
+  if( i == fail_sock ) {
+    fail_sock = -1;
+    return fail_rc;
+  }
+  ci_atomic32_and(&sock(i)->s.b.sb_aflags, ~CI_SB_AFLAG_TCP_IN_ACCEPTQ);
+  return FD_BASE + i;
+}
+
+citp_fdinfo_p citp_fdtable_new_fd_set(unsigned fd, citp_fdinfo_p new_fdip,
+                                      int fdt_locked)
+{
+  return fdip_unknown;
+}
+
+void citp_fdtable_insert(citp_fdinfo* fdi, unsigned fd, int fdt_locked)
+{
+  citp_sock_fdi* newepi = fdi_to_sock_fdi(fdi);
+
+  CHECK(newepi->sock.netif, ==, ni);
+  CHECK(fd, ==, FD_BASE + newepi->sock.s->b.bufid);
+  CHECK(newepi->sock.s->b.sb_aflags & CI_SB_AFLAG_NOT_READY, ==, 0);
+  ++n_inserted;
+  free(newepi);
+}
+
+/* The peer port tells us which socket was accepted */
+void ci_tcp_get_peer_addr(ci_tcp_state* ts, struct sockaddr* name,
+                          socklen_t* namelen)
+{
+  struct sockaddr_in* sin = (struct sockaddr_in*) name;
+
+  CHECK(*namelen, >=, sizeof(*sin));
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons(S_ID(ts));
+  *namelen = sizeof(*sin);
+}
+
+
+static ci_tcp_state* sock(int i)
+{
+  return (ci_tcp_state*) oo_sockp_to_ptr(ni, OO_SP_FROM_INT(ni, i));
+}
+
+
+static void setup(void)
+{
+  unsigned ep_ofs = CI_ROUND_UP(sizeof(ci_netif_state), CI_PAGE_SIZE);
+  int i;
+
+  ni = unit_netif_alloc_extra(0, ep_ofs - sizeof(ci_netif_state) +
+                                 N_SOCKS * EP_BUF_SIZE);
+  *(ci_uint32*) &ni->state->ep_ofs = ep_ofs;
+  *(ci_uint32*) &ni->state->n_ep_bufs = N_SOCKS;
+  ni->eps = calloc(N_SOCKS, sizeof(*ni->eps));
+  CI_MAGIC_SET(ni, NETIF_MAGIC);
+
+  for( i = 0; i < N_SOCKS; ++i ) {
+    ci_tcp_state* ts = sock(i);
+    ts->s.b.bufid = i;
+    ts->s.b.wt_next = OO_SP_NULL;
+    ts->s.domain = AF_INET;
+    ni->eps[i].fd = CI_FD_BAD;
+#if CI_CFG_FD_CACHING
+    ts->cached_on_fd = -1;
+    ts->cached_on_pid = -1;
+#endif
+  }
+
+  listener = (ci_tcp_socket_listen*) sock(LISTENER);
+  listener->s.b.state = CI_TCP_LISTEN;
+  listener->acceptq_put = CI_ILL_END;
+  listener->acceptq_get = OO_SP_NULL;
+
+  epi = calloc(1, sizeof(*epi));
+  epi->fdinfo.fd = LISTEN_FD;
+  epi->sock.s = &listener->s;
+  epi->sock.netif = ni;
+
+  memset(msgs, 0, sizeof(msgs));
+  n_attached = 0;
+  n_inserted = 0;
+  fail_sock = -1;
+}
+
+
+static void teardown(void)
+{
+  free(epi);
+  free(ni->eps);
+  unit_netif_free(ni);
+}
+
+
+/* Queue connections [first, last] on the listener, oldest first */
+static void queue(int first, int last)
+{
+  int i;
+
+  ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  for( i = first; i <= last; ++i ) {
+    ci_tcp_state* ts = sock(i);
+    ts->s.b.state = CI_TCP_ESTABLISHED;
+    ts->s.b.sb_aflags = CI_SB_AFLAG_TCP_IN_ACCEPTQ | CI_SB_AFLAG_NOT_READY;
+    ci_tcp_acceptq_put(ni, listener, &ts->s.b);
+  }
+  ni->state->lock.lock = 0;
+}
+
+
+static int accept_batch(int max_msgs)
+{
+  return citp_tcp_protocol_impl.ops.accept_batch(&epi->fdinfo, msgs,
+                                                  max_msgs, 0);
+}
+
+
+/* The connections [msgs] says were accepted, by socket */
+static void check_accepted(int n, const int* expect)
+{
+  int i;
+
+  for( i = 0; i < n; ++i ) {
+    struct sockaddr_in* sin = (struct sockaddr_in*) &msgs[i].addr;
+    CHECK(msgs[i].fd, ==, FD_BASE + expect[i]);
+    CHECK(msgs[i].addrlen, ==, sizeof(*sin));
+    CHECK(ntohs(sin->sin_port), ==, expect[i]);
+    CHECK(sock(expect[i])->s.b.sb_aflags & CI_SB_AFLAG_TCP_IN_ACCEPTQ, ==, 0);
+  }
+}
+
+
+static void test_accept_all(void)
+{
+  static const int expect[] = { 1, 2, 3, 4, 5 };
+  int n;
+
+  setup();
+  queue(1, 5);
+
+  n = accept_batch(N_SOCKS);
+  CHECK(n, ==, 5);
+  check_accepted(n, expect);
+  CHECK(n_inserted, ==, 5);
+  CHECK(ci_tcp_acceptq_n(listener), ==, 0);
+  CHECK(ci_sock_is_locked(ni, &listener->s.b), ==, 0);
+
+  /* Nothing left, and that's not an error */
+  n = accept_batch(N_SOCKS);
+  CHECK(n, ==, 0);
+  teardown();
+}
+
+
+/* Taking fewer than are queued leaves the rest, in order */
+static void test_accept_some(void)
+{
+  static const int expect[] = { 1, 2, 3, 4, 5 };
+  int n;
+
+  setup();
+  queue(1, 5);
+
+  n = accept_batch(2);
+  CHECK(n, ==, 2);
+  check_accepted(n, expect);
+  CHECK(ci_tcp_acceptq_n(listener), ==, 3);
+
+  n = accept_batch(N_SOCKS);
+  CHECK(n, ==, 3);
+  check_accepted(n, expect + 2);
+  CHECK(n_attached, ==, 5);
+  teardown();
+}
+
+
+/* When a connection can't have an fd, those accepted so far are returned,
+ * and it and the ones after it go back on the queue in order.
+ */
+static void test_accept_partial(void)
+{
+  static const int expect[] = { 1, 2, 3, 4, 5 };
+  int n;
+
+  setup();
+  queue(1, 5);
+  fail_sock = 3;
+  fail_rc = -EMFILE;
+
+  n = accept_batch(N_SOCKS);
+  CHECK(n, ==, 2);
+  check_accepted(n, expect);
+  CHECK(n_attached, ==, 3);
+  CHECK(ci_tcp_acceptq_n(listener), ==, 3);
+  CHECK(ci_sock_is_locked(ni, &listener->s.b), ==, 0);
+  CHECK(sock(3)->s.b.sb_aflags & CI_SB_AFLAG_TCP_IN_ACCEPTQ, !=, 0);
+  CHECK(sock(4)->s.b.sb_aflags & CI_SB_AFLAG_TCP_IN_ACCEPTQ, !=, 0);
+
+  n = accept_batch(N_SOCKS);
+  CHECK(n, ==, 3);
+  check_accepted(n, expect + 2);
+  CHECK(ci_tcp_acceptq_n(listener), ==, 0);
+  teardown();
+}
+
+
+/* A failure before anything is accepted is returned as such */
+static void test_accept_error(void)
+{
+  static const int expect[] = { 1, 2 };
+  int n;
+
+  setup();
+  queue(1, 2);
+  fail_sock = 1;
+  fail_rc = -EMFILE;
+
+  n = accept_batch(N_SOCKS);
+  CHECK(n, ==, -EMFILE);
+  CHECK(ci_tcp_acceptq_n(listener), ==, 2);
+
+  n = accept_batch(N_SOCKS);
+  CHECK(n, ==, 2);
+  check_accepted(n, expect);
+  teardown();
+}
+
+
+/* ENOANO means the fd is going away under us: that connection is retried
+ * after the rest of the queue, within the same call.
+ */
+static void test_accept_enoano(void)
+{
+  static const int expect[] = { 1, 3, 4, 2 };
+  int n;
+
+  setup();
+  queue(1, 4);
+  fail_sock = 2;
+  fail_rc = -ENOANO;
+
+  n = accept_batch(N_SOCKS);
+  CHECK(n, ==, 4);
+  check_accepted(n, expect);
+  CHECK(n_attached, ==, 5);
+  CHECK(attached[1], ==, 2);
+  CHECK(attached[4], ==, 2);
+  CHECK(ci_tcp_acceptq_n(listener), ==, 0);
+  CHECK(ni->state->stats.accept_attach_fd_retry, ==, 1);
+  teardown();
+}
+
+
+static void test_not_listening(void)
+{
+  int n;
+
+  setup();
+  listener->s.b.state = CI_TCP_CLOSED;
+  n = accept_batch(N_SOCKS);
+  CHECK(n, ==, -EINVAL);
+  teardown();
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_accept_all);
+  TEST_RUN(test_accept_some);
+  TEST_RUN(test_accept_partial);
+  TEST_RUN(test_accept_error);
+  TEST_RUN(test_accept_enoano);
+  TEST_RUN(test_not_listening);
+  TEST_END();
+}
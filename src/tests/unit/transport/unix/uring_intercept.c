@@ -0,0 +1,549 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include "internal.h"
+#include <ci/internal/efabcfg.h>
+
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <linux/io_uring.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+/* The rings and sockets are real.  Socket pairs and timerfds stand in for
+ * accelerated sockets, and the onload_*() calls the intercept makes on them
+ * go straight to libc. */
+
+#ifndef IORING_ENTER_ABS_TIMER
+#define IORING_ENTER_ABS_TIMER  (1U << 5)
+#endif
+
+#define ENTRIES  16
+#define MAX_FDS  1024
+#define NO_CQE   INT_MIN
+
+/* The app's view of its ring */
+struct ring {
+  int                  fd;
+  void*                ring;
+  size_t               ring_len;
+  struct io_uring_sqe* sqes;
+  unsigned*            sq_tail;
+  unsigned*            sq_array;
+  unsigned             sq_mask;
+  unsigned*            cq_head;
+  unsigned*            cq_tail;
+  unsigned             cq_mask;
+  struct io_uring_cqe* cqes;
+};
+
+static struct ring ring;
+static int sv[2];
+static char rx_buf[64];
+static bool accelerated[MAX_FDS];
+
+static citp_protocol_impl tcp_impl = { .type = CITP_TCP_SOCKET };
+static citp_fdinfo tcp_fdi;
+
+
+/* Dependencies */
+ci_cfg_opts_t ci_cfg_opts;
+citp_globals_t citp;
+citp_fdinfo citp_the_closed_fd;
+citp_fdinfo citp_the_reserved_fd;
+unsigned citp_log_level;
+__thread struct oo_per_thread oo_per_thread = { .initialised = 1 };
+
+#define CI_MK_DECL(ret, fn, args)  ret (*ci_sys_##fn) args;
+#define CI_MK_DECL_OPTIONAL CI_MK_DECL
+#include <onload/declare_syscalls.h.tmpl>
+
+citp_fdinfo* citp_fdtable_lookup(unsigned fd)
+{
+  if( fd >= MAX_FDS || ! accelerated[fd] )
+    return NULL;
+  citp_fdinfo_ref(&tcp_fdi);
+  return &tcp_fdi;
+}
+
+ssize_t onload_recvfrom(int fd, void* buf, size_t len, int flags,
+                        struct sockaddr* from, socklen_t* fromlen)
+{
+  return recvfrom(fd, buf, len, flags, from, fromlen);
+}
+
+ssize_t onload_sendto(int fd, const void* buf, size_t len, int flags,
+                      const struct sockaddr* to, socklen_t tolen)
+{
+  return sendto(fd, buf, len, flags, to, tolen);
+}
+
+ssize_t onload_recvmsg(int fd, struct msghdr* msg, int flags)
+{
+  return recvmsg(fd, msg, flags);
+}
+
+ssize_t onload_sendmsg(int fd, const struct msghdr* msg, int flags)
+{
+  return sendmsg(fd, msg, flags);
+}
+
+int onload_accept4(int fd, struct sockaddr* addr, socklen_t* addrlen,
+                   int flags)
+{
+  return accept4(fd, addr, addrlen, flags);
+}
+
+int onload_connect(int fd, const struct sockaddr* addr, socklen_t addrlen)
+{
+  return connect(fd, addr, addrlen);
+}
+
+int onload_getsockopt(int fd, int level, int optname, void* optval,
+                      socklen_t* optlen)
+{
+  return getsockopt(fd, level, optname, optval, optlen);
+}
+
+int onload_poll(struct pollfd* fds, nfds_t nfds, int timeout)
+{
+  return poll(fds, nfds, timeout);
+}
+
+int onload_ppoll(struct pollfd* fds, nfds_t nfds,
+                 const struct timespec* timeout, const sigset_t* sigmask)
+{
+  return ppoll(fds, nfds, timeout, sigmask);
+}
+
+
+static void ring_map(const struct io_uring_params* p)
+{
+  char* r;
+
+  ring.ring_len = CI_MAX(p->sq_off.array + p->sq_entries * sizeof(unsigned),
+                         p->cq_off.cqes +
+                         p->cq_entries * sizeof(struct io_uring_cqe));
+  ring.ring = mmap(NULL, ring.ring_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+  CHECK_TRUE(ring.ring != MAP_FAILED);
+  ring.sqes = mmap(NULL, p->sq_entries * sizeof(struct io_uring_sqe),
+                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ring.fd, IORING_OFF_SQES);
+  CHECK_TRUE(ring.sqes != MAP_FAILED);
+
+  r = ring.ring;
+  ring.sq_tail = (unsigned*) (r + p->sq_off.tail);
+  ring.sq_array = (unsigned*) (r + p->sq_off.array);
+  ring.sq_mask = *(unsigned*) (r + p->sq_off.ring_mask);
+  ring.cq_head = (unsigned*) (r + p->cq_off.head);
+  ring.cq_tail = (unsigned*) (r + p->cq_off.tail);
+  ring.cq_mask = *(unsigned*) (r + p->cq_off.ring_mask);
+  ring.cqes = (struct io_uring_cqe*) (r + p->cq_off.cqes);
+}
+
+
+static void setup(void)
+{
+  struct io_uring_params p;
+  int rc;
+
+  CITP_OPTS.io_uring = 1;
+  citp.init_level = CITP_INIT_ALL;
+  ci_sys_syscall = syscall;
+  ci_sys_close = close;
+  tcp_fdi.protocol = &tcp_impl;
+  oo_atomic_set(&tcp_fdi.ref_count, 1);
+
+  memset(&p, 0, sizeof(p));
+  ring.fd = citp_uring_setup(ENTRIES, &p);
+  CHECK(ring.fd, >=, 0);
+  CHECK_TRUE(citp_urings != NULL);
+  ring_map(&p);
+
+  rc = socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv);
+  CHECK(rc, ==, 0);
+  accelerated[sv[0]] = true;
+}
+
+
+static void teardown(void)
+{
+  accelerated[sv[0]] = false;
+  close(sv[0]);
+  close(sv[1]);
+  citp_uring_close(ring.fd);
+  CHECK_TRUE(citp_urings == NULL);
+  munmap(ring.sqes, ENTRIES * sizeof(struct io_uring_sqe));
+  munmap(ring.ring, ring.ring_len);
+  close(ring.fd);
+}
+
+
+/* A zeroed SQE at the tail of the SQ, which submit() makes visible */
+static struct io_uring_sqe* sqe_add(__u8 opcode, int fd, __u64 user_data)
+{
+  unsigned tail = *ring.sq_tail;
+  unsigned idx = tail & ring.sq_mask;
+  struct io_uring_sqe* sqe = &ring.sqes[idx];
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->user_data = user_data;
+  ring.sq_array[idx] = idx;
+  ci_wmb();
+  *ring.sq_tail = tail + 1;
+  return sqe;
+}
+
+
+static void add_recv(int fd, __u64 user_data)
+{
+  struct io_uring_sqe* sqe = sqe_add(IORING_OP_RECV, fd, user_data);
+  sqe->addr = (uintptr_t) rx_buf;
+  sqe->len = sizeof(rx_buf);
+}
+
+
+static void add_poll(int fd, __u64 user_data, unsigned events)
+{
+  struct io_uring_sqe* sqe = sqe_add(IORING_OP_POLL_ADD, fd, user_data);
+  sqe->poll32_events = events;
+}
+
+
+static void submit(unsigned n)
+{
+  long rc = citp_uring_enter(ring.fd, n, 0, 0, NULL, 0);
+  CHECK(rc, ==, n);
+}
+
+
+/* Takes the CQEs that have been posted.  Returns how many there were, and
+ * the result of each in [res], by user_data. */
+static int reap(int* res, int n_res)
+{
+  unsigned head = *ring.cq_head;
+  unsigned tail = OO_ACCESS_ONCE(*ring.cq_tail);
+  int i, n = 0;
+
+  for( i = 0; i < n_res; ++i )
+    res[i] = NO_CQE;
+  ci_rmb();
+  for( ; head != tail; ++head, ++n ) {
+    struct io_uring_cqe* cqe = &ring.cqes[head & ring.cq_mask];
+    CHECK(cqe->user_data, <, n_res);
+    CHECK(res[cqe->user_data], ==, NO_CQE);
+    res[cqe->user_data] = cqe->res;
+  }
+  ci_mb();
+  *ring.cq_head = head;
+  return n;
+}
+
+
+static int timer_start(int ms)
+{
+  struct itimerspec its = { .it_value = { 0, ms * 1000000L } };
+  int fd, rc;
+
+  fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  CHECK(fd, >=, 0);
+  rc = timerfd_settime(fd, 0, &its, NULL);
+  CHECK(rc, ==, 0);
+  accelerated[fd] = true;
+  return fd;
+}
+
+
+static void timer_stop(int fd)
+{
+  accelerated[fd] = false;
+  close(fd);
+}
+
+
+static long long now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+
+/* Requests on our sockets are done here, and the rest by the kernel */
+static void test_submit(void)
+{
+  static const char msg[] = "hello";
+  struct io_uring_sqe* sqe;
+  char buf[16];
+  int res[4];
+  int n;
+
+  setup();
+  add_recv(sv[0], 1);
+  sqe = sqe_add(IORING_OP_SEND, sv[0], 2);
+  sqe->addr = (uintptr_t) msg;
+  sqe->len = sizeof(msg);
+  sqe_add(IORING_OP_NOP, -1, 3);
+  /* Not an accelerated socket */
+  sqe_add(IORING_OP_POLL_ADD, sv[1], 0)->poll32_events = POLLOUT;
+  submit(4);
+
+  n = reap(res, 4);
+  CHECK(n, ==, 3);
+  CHECK(res[0], ==, POLLOUT);
+  CHECK(res[1], ==, NO_CQE);
+  CHECK(res[2], ==, sizeof(msg));
+  CHECK(res[3], ==, 0);
+  n = recv(sv[1], buf, sizeof(buf), 0);
+  CHECK(n, ==, sizeof(msg));
+  CHECK(strcmp(buf, msg), ==, 0);
+
+  /* No change yet */
+  submit(0);
+  n = reap(res, 4);
+  CHECK(n, ==, 0);
+  teardown();
+}
+
+
+/* Pending requests complete on a later enter, or while the app waits */
+static void test_complete(void)
+{
+  static const char msg[] = "world";
+  long long start;
+  int res[4];
+  int tfd, n;
+  long rc;
+
+  setup();
+  add_recv(sv[0], 1);
+  submit(1);
+  n = send(sv[1], msg, sizeof(msg), 0);
+  CHECK(n, ==, sizeof(msg));
+  rc = citp_uring_enter(ring.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+  CHECK(rc, ==, 0);
+  n = reap(res, 4);
+  CHECK(n, ==, 1);
+  CHECK(res[1], ==, sizeof(msg));
+  CHECK(strcmp(rx_buf, msg), ==, 0);
+
+  /* Waiting for a request of ours */
+  tfd = timer_start(20);
+  add_poll(tfd, 2, POLLIN);
+  start = now_ms();
+  rc = citp_uring_enter(ring.fd, 1, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+  CHECK(rc, ==, 1);
+  CHECK(now_ms() - start, >=, 19);
+  n = reap(res, 4);
+  CHECK(n, ==, 1);
+  CHECK(res[2], ==, POLLIN);
+  timer_stop(tfd);
+  teardown();
+}
+
+
+static void test_cancel(void)
+{
+  struct io_uring_sqe* sqe;
+  int res[16];
+  int n;
+
+  setup();
+  add_recv(sv[0], 1);
+  add_poll(sv[0], 2, POLLIN);
+  submit(2);
+
+  sqe = sqe_add(IORING_OP_ASYNC_CANCEL, -1, 10);
+  sqe->addr = 1;
+  sqe = sqe_add(IORING_OP_POLL_REMOVE, -1, 11);
+  sqe->addr = 2;
+  /* Nothing of ours, so the kernel's to do */
+  sqe = sqe_add(IORING_OP_ASYNC_CANCEL, -1, 12);
+  sqe->addr = 1;
+  submit(3);
+  n = reap(res, 16);
+  CHECK(n, ==, 5);
+  CHECK(res[1], ==, -ECANCELED);
+  CHECK(res[2], ==, -ECANCELED);
+  CHECK(res[10], ==, 0);
+  CHECK(res[11], ==, 0);
+  CHECK(res[12], ==, -ENOENT);
+
+  /* Everything on a socket */
+  add_recv(sv[0], 3);
+  add_recv(sv[0], 4);
+  sqe = sqe_add(IORING_OP_ASYNC_CANCEL, sv[0], 13);
+  sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+  submit(3);
+  n = reap(res, 16);
+  CHECK(n, ==, 3);
+  CHECK(res[3], ==, -ECANCELED);
+  CHECK(res[4], ==, -ECANCELED);
+  CHECK(res[13], ==, 2);
+
+  /* Updating a poll leaves it pending */
+  add_poll(sv[0], 5, POLLPRI);
+  sqe = sqe_add(IORING_OP_POLL_REMOVE, -1, 14);
+  sqe->addr = 5;
+  sqe->off = 6;
+  sqe->poll32_events = POLLIN;
+  sqe->len = IORING_POLL_UPDATE_EVENTS | IORING_POLL_UPDATE_USER_DATA;
+  submit(2);
+  n = reap(res, 16);
+  CHECK(n, ==, 1);
+  CHECK(res[14], ==, 0);
+  n = send(sv[1], "x", 1, 0);
+  CHECK(n, ==, 1);
+  submit(0);
+  n = reap(res, 16);
+  CHECK(n, ==, 1);
+  CHECK(res[6], ==, POLLIN);
+  teardown();
+}
+
+
+/* Requests pending on a socket fail when it is closed, as its fd may be
+ * reused */
+static void test_close(void)
+{
+  int res[4];
+  int n;
+
+  setup();
+  add_recv(sv[0], 1);
+  add_poll(sv[0], 2, POLLIN);
+  submit(2);
+  n = reap(res, 4);
+  CHECK(n, ==, 0);
+
+  citp_uring_close(sv[0]);
+  n = reap(res, 4);
+  CHECK(n, ==, 2);
+  CHECK(res[1], ==, -ECANCELED);
+  CHECK(res[2], ==, -ECANCELED);
+
+  /* Nothing left to do */
+  n = send(sv[1], "x", 1, 0);
+  CHECK(n, ==, 1);
+  submit(0);
+  n = reap(res, 4);
+  CHECK(n, ==, 0);
+  teardown();
+}
+
+
+/* Does the kernel take IORING_ENTER_ABS_TIMER? */
+static bool abs_timer_supported(void)
+{
+  struct __kernel_timespec ts = { 0, 0 };
+  struct io_uring_getevents_arg ea = { .ts = (uintptr_t) &ts };
+  long rc;
+
+  rc = syscall(__NR_io_uring_enter, ring.fd, 0, 0, IORING_ENTER_GETEVENTS |
+               IORING_ENTER_EXT_ARG | IORING_ENTER_ABS_TIMER, &ea, sizeof(ea));
+  return rc == 0 || errno != EINVAL;
+}
+
+
+/* Waits for two completions, where a poll of ours completes after [ms]
+ * and nothing else does, with the given timeout.  As there is one
+ * completion, the timeout isn't an error. */
+static int wait_timeout(int ms, unsigned flags,
+                        const struct __kernel_timespec* ts)
+{
+  struct io_uring_getevents_arg ea = { .ts = (uintptr_t) ts };
+  int res[4];
+  int tfd, n;
+  long rc;
+
+  tfd = timer_start(ms);
+  add_poll(tfd, 1, POLLIN);
+  submit(1);
+  rc = citp_uring_enter(ring.fd, 0, 2, IORING_ENTER_GETEVENTS |
+                        IORING_ENTER_EXT_ARG | flags, &ea, sizeof(ea));
+  n = reap(res, 4);
+  timer_stop(tfd);
+  CHECK(n, ==, 1);
+  CHECK(res[1], ==, POLLIN);
+  return rc < 0 ? -errno : rc;
+}
+
+
+static void test_timeout(void)
+{
+  struct io_uring_getevents_arg ea;
+  struct __kernel_timespec ts;
+  struct timespec now;
+  long long start;
+  int res[4];
+  int rc, n;
+
+  setup();
+
+  /* Nothing completes */
+  add_recv(sv[0], 1);
+  submit(1);
+  ts.tv_sec = 0;
+  ts.tv_nsec = 50000000;
+  memset(&ea, 0, sizeof(ea));
+  ea.ts = (uintptr_t) &ts;
+  start = now_ms();
+  rc = citp_uring_enter(ring.fd, 0, 1, IORING_ENTER_GETEVENTS |
+                        IORING_ENTER_EXT_ARG, &ea, sizeof(ea));
+  CHECK(rc, ==, -1);
+  CHECK(errno, ==, ETIME);
+  CHECK(now_ms() - start, >=, 49);
+  CHECK(now_ms() - start, <, 150);
+
+  /* As the kernel, nor is it an error once there's a completion */
+  sqe_add(IORING_OP_NOP, -1, 2);
+  submit(1);
+  start = now_ms();
+  rc = citp_uring_enter(ring.fd, 0, 2, IORING_ENTER_GETEVENTS |
+                        IORING_ENTER_EXT_ARG, &ea, sizeof(ea));
+  CHECK(rc, ==, 0);
+  CHECK(now_ms() - start, >=, 49);
+  CHECK(now_ms() - start, <, 150);
+  citp_uring_close(sv[0]);
+  n = reap(res, 4);
+  CHECK(n, ==, 2);
+  CHECK(res[1], ==, -ECANCELED);
+  CHECK(res[2], ==, 0);
+
+  /* Once ours are done, the kernel waits for only what is left */
+  ts.tv_nsec = 200000000;
+  start = now_ms();
+  rc = wait_timeout(100, 0, &ts);
+  CHECK(rc, ==, 0);
+  CHECK(now_ms() - start, >=, 199);
+  CHECK(now_ms() - start, <, 280);
+
+  /* An absolute timeout, if the kernel has them */
+  if( abs_timer_supported() ) {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ts.tv_sec = now.tv_sec + (now.tv_nsec + 200000000) / 1000000000;
+    ts.tv_nsec = (now.tv_nsec + 200000000) % 1000000000;
+    start = now_ms();
+    rc = wait_timeout(100, IORING_ENTER_ABS_TIMER, &ts);
+    CHECK(rc, ==, 0);
+    CHECK(now_ms() - start, >=, 199);
+    CHECK(now_ms() - start, <, 280);
+  }
+  teardown();
+}
+
+
+int main(void)
+{
+  TEST_RUN(test_submit);
+  TEST_RUN(test_complete);
+  TEST_RUN(test_cancel);
+  TEST_RUN(test_close);
+  TEST_RUN(test_timeout);
+  TEST_END();
+}
@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+#include "unit_netif.h"
+
+
+ci_netif* unit_netif_alloc_extra(int n_pkts, size_t extra_bytes)
+{
+  ci_netif* ni = calloc(1, sizeof(*ni));
+  oo_pktbuf_manager* pm;
+  int i;
+
+  ni->state = calloc(1, sizeof(*ni->state) + extra_bytes);
+  IPTIMER_STATE(ni)->khz = UNIT_NETIF_KHZ;
+  IPTIMER_STATE(ni)->ci_ip_time_frc2us = UNIT_NETIF_FRC2US;
+  IPTIMER_STATE(ni)->ci_ip_time_frc2tick = UNIT_NETIF_FRC2TICK;
+  IPTIMER_STATE(ni)->ci_ip_time_ms2tick_fxp = 1ull << 32;
+
+  if( n_pkts > 0 ) {
+    pm = calloc(1, sizeof(*pm) + sizeof(pm->set[0]));
+    *(ci_uint32*) &pm->sets_n = 1;
+    *(ci_uint32*) &pm->sets_max = 1;
+    *(ci_int32*) &pm->n_pkts_allocated = n_pkts;
+    ni->packets = pm;
+    ni->pkt_bufs = calloc(1, sizeof(ni->pkt_bufs[0]));
+    /* Aligned as the real buffers are: the packet filler finds the end of
+     * a buffer by rounding up */
+    ni->pkt_bufs[0] = aligned_alloc(CI_CFG_PKT_BUF_SIZE,
+                                    n_pkts * CI_CFG_PKT_BUF_SIZE);
+    memset(ni->pkt_bufs[0], 0, n_pkts * CI_CFG_PKT_BUF_SIZE);
+    for( i = 0; i < n_pkts; ++i )
+      OO_PP_INIT(ni, ((ci_ip_pkt_fmt*) __PKT_BUF(ni, i))->pp, i);
+  }
+  return ni;
+}
+
+
+ci_netif* unit_netif_alloc(int n_pkts)
+{
+  return unit_netif_alloc_extra(n_pkts, 0);
+}
+
+
+void unit_netif_free(ci_netif* ni)
+{
+  if( ni->pkt_bufs != NULL ) {
+    free(ni->pkt_bufs[0]);
+    free(ni->pkt_bufs);
+  }
+  free(ni->packets);
+  free(ni->state);
+  free(ni);
+}
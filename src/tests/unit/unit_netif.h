@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* A minimal stack for testing code that takes a ci_netif.
+ *
+ * Tests using it should list "unit_netif" in their _LIBS in mmake.mk.
+ */
+#ifndef ONLOAD_UNIT_NETIF_H
+#define ONLOAD_UNIT_NETIF_H
+
+#include <ci/internal/ip.h>
+
+/* The timer state is a 1GHz clock, with usticks of 1024 cycles and ticks of
+ * 1024 usticks, so a tick is about a millisecond.  The clock starts at
+ * zero: tests needing a particular time set IPTIMER_STATE(ni)->frc. */
+#define UNIT_NETIF_KHZ       1000000
+#define UNIT_NETIF_FRC2US    10
+#define UNIT_NETIF_FRC2TICK  20
+
+/* Allocate a stack with zeroed shared state and options, and a single
+ * packet set holding [n_pkts] zeroed packet buffers (none if 0). */
+extern ci_netif* unit_netif_alloc(int n_pkts);
+
+/* As unit_netif_alloc(), with [extra_bytes] of zeroed space after the
+ * shared state for objects that are reached through an oo_p, such as
+ * timers.  unit_netif_extra() returns the start of it. */
+extern ci_netif* unit_netif_alloc_extra(int n_pkts, size_t extra_bytes);
+
+static inline void* unit_netif_extra(ci_netif* ni)
+{
+  return ni->state + 1;
+}
+
+/* Free a stack from unit_netif_alloc() */
+extern void unit_netif_free(ci_netif* ni);
+
+#endif
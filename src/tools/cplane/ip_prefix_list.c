@@ -81,6 +81,7 @@ bool cp_ippl_add(struct cp_ip_prefix_list* list,
     *idx_p = list->used;
   cp_row_mask_set(list->seen, list->used);
   memcpy(cp_ippl_entry(list, list->used++), ipp, list->stride);
+  list->gen++;
 
   if( ! list->in_dump )
     cp_ippl_sort(list);
@@ -38,10 +38,11 @@ struct cp_ip_prefix_list {
   int in_dump;
 
   cp_ipp_compare_fn_t compare;
-  cp_row_mask_t seen;  /* which entries we've seen during this dump? */
-  cicp_rowid_t max;    /* allocated array size */
-  cicp_rowid_t used;   /* number of entries in use */
-  cicp_rowid_t sorted; /* number of sorted entries */
+  cp_row_mask_t seen;      /* which entries we've seen during this dump? */
+  cicp_mac_rowid_t max;    /* allocated array size */
+  cicp_mac_rowid_t used;   /* number of entries in use */
+  cicp_mac_rowid_t sorted; /* number of sorted entries */
+  uint32_t gen;            /* bumped when entries may have moved */
 };
 #define CP_IPPL_ASSERT_VALID(list) \
   ci_assert_le((list)->sorted, (list)->used);   \
@@ -63,7 +64,7 @@ cp_ippl_idx(struct cp_ip_prefix_list* list, struct cp_ip_with_prefix* entry)
 int cp_ippl_compare(const void *void_a, const void *void_b);
 static inline void
 cp_ippl_init(struct cp_ip_prefix_list* list, size_t stride,
-             cp_ipp_compare_fn_t compare, cicp_rowid_t size)
+             cp_ipp_compare_fn_t compare, cicp_mac_rowid_t size)
 {
   list->stride = stride;
   list->compare = compare == NULL ? cp_ippl_compare : compare;
@@ -72,6 +73,7 @@ cp_ippl_init(struct cp_ip_prefix_list* list, size_t stride,
   list->seen = cp_row_mask_alloc(size);
   list->max = size;
   list->used = list->sorted = 0;
+  list->gen = 0;
   list->in_dump = false;
 
   int i;
@@ -93,6 +95,7 @@ static inline void
 cp_ippl_sort(struct cp_ip_prefix_list* list)
 {
   qsort(list->list, list->used, list->stride, list->compare);
+  list->gen++;
 
   /* Check that the last entries are really used */
   while( list->used > 0 &&
@@ -127,6 +130,7 @@ cp_ippl_del(struct cp_ip_prefix_list* list,
 
   entry->addr = addr_sh_any;
   entry->sort_by = -1;
+  list->gen++;
 
   if( ! list->in_dump ) {
     cp_ippl_sort(list);
@@ -149,8 +153,8 @@ static inline bool cp_ippl_finalize(struct cp_session* s,
                                     struct cp_ip_prefix_list* list,
                                     cp_ippl_finalize_callback cb)
 {
-  cicp_rowid_t id = -1;
-  cicp_rowid_t removed = 0;
+  cicp_mac_rowid_t id = -1;
+  cicp_mac_rowid_t removed = 0;
 
   ci_assert(list->in_dump);
 
@@ -244,7 +248,7 @@ static inline cicp_prefixlen_t
 cp_ippl_get_prefix(struct cp_ip_prefix_list* list, int af, ci_addr_sh_t addr)
 {
   cicp_prefixlen_t len;
-  cicp_rowid_t id;
+  cicp_mac_rowid_t id;
 
   /* INADDR_ANY has special meaning in many contexts.  Assume that
    * 0.0.0.0/32 is the first entry in any list.
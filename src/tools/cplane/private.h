@@ -38,6 +38,7 @@
 #include <cplane/ioctl.h>
 #include "mask.h"
 #include "ip_prefix_list.h"
+#include "route_trie.h"
 
 /* CP_FWD_FLAG_* flags
  * Definitions are in:
@@ -325,6 +326,7 @@ struct cp_route {
 struct cp_route_table {
   uint32_t id;
   struct cp_ip_prefix_list routes;
+  struct cp_route_trie trie;
   struct cp_route_table* next;
 };
 
@@ -1073,6 +1075,8 @@ void cp_newrule_handle(struct cp_session* s, uint16_t nlmsg_type,
                        struct fib_rule_hdr* rule, size_t bytes);
 void cp_routes_update_laddr(struct cp_session* s,
                             struct cp_route_table** tables, int af);
+struct cp_route* cp_route_lookup(struct cp_session* s, uint32_t table_id,
+                                 struct cp_fwd_key* key, int af);
 
 void cp_verify_hwport_flags(struct cp_session* s);
 
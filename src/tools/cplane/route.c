@@ -349,6 +349,7 @@ cp_route_add(struct cp_session* s, uint32_t table_id,
     table->id = table_id;
     cp_ippl_init(&table->routes, sizeof(struct cp_route),
                  cp_route_compare, 4);
+    cp_route_trie_init(&table->trie);
     if( cp_routes_under_dump(s,af) )
       cp_ippl_start_dump(&table->routes);
     table->next =
@@ -610,14 +611,42 @@ cp_nl_route_table_update(struct cp_session* s, struct nlmsghdr* nlhdr,
                 CP_SESSION_FLAG_FWD_PREFIX_CHECK_NEEDED;
 }
 
+struct cp_route_find_arg {
+  struct cp_fwd_key* key;
+};
+
+static bool
+cp_route_find_accept(struct cp_ip_with_prefix* ipp, void* void_arg)
+{
+  struct cp_route_find_arg* arg = void_arg;
+  struct cp_route* route = cp_route_entry_from_dst(ipp);
+  return route->tos == 0 || route->tos == arg->key->tos;
+}
+
 static struct cp_route *
 cp_route_find(struct cp_session* s, struct cp_fwd_key* key,
               struct cp_route_table* table, int af)
 {
   struct cp_ip_with_prefix* ipp = NULL;
   struct cp_route *route = NULL;
+  bool trie_ok, rebuilt;
   int i;
 
+  /* The trie gives the same answer as the linear scan below, but it is
+   * only usable when the route list is sorted. */
+  trie_ok = cp_route_trie_sync(&table->trie, &table->routes, af, &rebuilt);
+  if( rebuilt )
+    s->stats.route.trie_rebuild++;
+  if( trie_ok ) {
+    struct cp_route_find_arg arg = { .key = key };
+    i = cp_route_trie_lookup(&table->trie, &table->routes, af, key->dst,
+                             cp_route_find_accept, &arg);
+    if( i == CP_ROUTE_TRIE_NONE )
+      return NULL;
+    return cp_route_entry_by_idx(table, i);
+  }
+  s->stats.route.linear_lookup++;
+
   /* Find the best prefix and metric.
    * The list is ordered by prefix length, then by metric,
    * so the first match is the best prefix & metric. */
@@ -634,6 +663,18 @@ cp_route_find(struct cp_session* s, struct cp_fwd_key* key,
   return route;
 }
 
+/* Find the best route for key->dst in the given table.  Exported for the
+ * unit tests. */
+struct cp_route*
+cp_route_lookup(struct cp_session* s, uint32_t table_id,
+                struct cp_fwd_key* key, int af)
+{
+  struct cp_route_table* table = cp_route_table_find(s, table_id, af);
+  if( table == NULL )
+    return NULL;
+  return cp_route_find(s, key, table, af);
+}
+
 /* This function finds the preferred source address for a given route.
  * It is not needed in normal case, but we have to do it in multipath case.
  * This function is also used in --verify-routes mode, which exists solely
@@ -0,0 +1,184 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+#include <ci/compat.h>
+
+#include "private.h"
+#include "route_trie.h"
+
+
+static inline uint32_t
+cp_route_trie_word(int af, const ci_addr_sh_t* addr, int word)
+{
+  return CI_BSWAP_BE32(af == AF_INET6 ? addr->u32[word] : addr->ip4);
+}
+
+static inline int
+cp_route_trie_bit(int af, const ci_addr_sh_t* addr, int pos)
+{
+  return (cp_route_trie_word(af, addr, pos >> 5) >> (31 - (pos & 31))) & 1;
+}
+
+/* Length of the common prefix of two addresses, limited by max */
+static int
+cp_route_trie_common(int af, const ci_addr_sh_t* a, const ci_addr_sh_t* b,
+                     int max)
+{
+  int word;
+
+  for( word = 0; word * 32 < max; word++ ) {
+    uint32_t x = cp_route_trie_word(af, a, word) ^
+                 cp_route_trie_word(af, b, word);
+    if( x != 0 )
+      return CI_MIN(word * 32 + __builtin_clz(x), max);
+  }
+  return max;
+}
+
+static int
+cp_route_trie_node_alloc(struct cp_route_trie* trie,
+                         const ci_addr_sh_t* addr, int prefix)
+{
+  struct cp_route_trie_node* node;
+
+  ci_assert_lt(trie->n_nodes, trie->max_nodes);
+  node = &trie->nodes[trie->n_nodes];
+  node->addr = *addr;
+  node->prefix = prefix;
+  node->head = CP_ROUTE_TRIE_NONE;
+  node->child[0] = node->child[1] = CP_ROUTE_TRIE_NONE;
+  return trie->n_nodes++;
+}
+
+static void
+cp_route_trie_node_attach(struct cp_route_trie* trie, int node, int idx)
+{
+  trie->next[idx] = trie->nodes[node].head;
+  trie->nodes[node].head = idx;
+}
+
+static void
+cp_route_trie_insert(struct cp_route_trie* trie, int af,
+                     struct cp_ip_with_prefix* ipp, int idx)
+{
+  int n = 0;
+
+  /* Invariant: node n matches ipp->addr on its prefix, and its prefix is
+   * not longer than ipp->prefix. */
+  while( trie->nodes[n].prefix != ipp->prefix ) {
+    int b = cp_route_trie_bit(af, &ipp->addr, trie->nodes[n].prefix);
+    int c = trie->nodes[n].child[b];
+    int common, m;
+
+    if( c == CP_ROUTE_TRIE_NONE ) {
+      c = cp_route_trie_node_alloc(trie, &ipp->addr, ipp->prefix);
+      trie->nodes[n].child[b] = c;
+      n = c;
+      break;
+    }
+
+    common = cp_route_trie_common(af, &ipp->addr, &trie->nodes[c].addr,
+                                  CI_MIN(ipp->prefix, trie->nodes[c].prefix));
+    ci_assert_gt(common, trie->nodes[n].prefix);
+    if( common == trie->nodes[c].prefix ) {
+      n = c;
+      continue;
+    }
+
+    /* The child diverges from us: insert a new node in between */
+    m = cp_route_trie_node_alloc(trie, &ipp->addr, common);
+    trie->nodes[m].child[cp_route_trie_bit(af, &trie->nodes[c].addr,
+                                           common)] = c;
+    trie->nodes[n].child[b] = m;
+    n = m;
+  }
+
+  cp_route_trie_node_attach(trie, n, idx);
+}
+
+static bool
+cp_route_trie_rebuild(struct cp_route_trie* trie,
+                      struct cp_ip_prefix_list* list, int af)
+{
+  int i;
+
+  /* Every route adds no more than 2 nodes to the root */
+  if( trie->max_nodes < list->used * 2 + 1 ) {
+    int max = list->max * 2 + 1;
+    struct cp_route_trie_node* nodes = realloc(trie->nodes,
+                                               max * sizeof(*nodes));
+    if( nodes == NULL )
+      return false;
+    trie->nodes = nodes;
+    trie->max_nodes = max;
+  }
+  if( trie->max_routes < list->used ) {
+    int* next = realloc(trie->next, list->max * sizeof(*next));
+    if( next == NULL )
+      return false;
+    trie->next = next;
+    trie->max_routes = list->max;
+  }
+
+  trie->n_nodes = 0;
+  cp_route_trie_node_alloc(trie, &addr_sh_any, 0);
+
+  /* Insert in the reverse order, so that each chain is in list order */
+  for( i = list->used - 1; i >= 0; i-- )
+    cp_route_trie_insert(trie, af, cp_ippl_entry(list, i), i);
+
+  trie->gen = list->gen;
+  trie->valid = true;
+  return true;
+}
+
+bool cp_route_trie_sync(struct cp_route_trie* trie,
+                        struct cp_ip_prefix_list* list, int af,
+                        bool* rebuilt)
+{
+  CP_IPPL_ASSERT_VALID(list);
+
+  *rebuilt = false;
+  if( list->sorted != list->used ) {
+    trie->valid = false;
+    return false;
+  }
+  if( trie->valid && trie->gen == list->gen )
+    return true;
+  trie->valid = false;
+  if( ! cp_route_trie_rebuild(trie, list, af) )
+    return false;
+  *rebuilt = true;
+  return true;
+}
+
+int cp_route_trie_lookup(struct cp_route_trie* trie,
+                         struct cp_ip_prefix_list* list, int af,
+                         ci_addr_sh_t addr,
+                         cp_route_trie_accept_fn_t accept, void* arg)
+{
+  int best = CP_ROUTE_TRIE_NONE;
+  int n = 0;
+
+  ci_assert(trie->valid);
+  ci_assert_equal(trie->gen, list->gen);
+
+  /* Walk down; deeper nodes have longer prefixes, so the last accepted
+   * chain entry wins. */
+  while( n != CP_ROUTE_TRIE_NONE ) {
+    struct cp_route_trie_node* node = &trie->nodes[n];
+    int idx;
+
+    if( ! cp_ipx_ippl_pfx_match(af, addr, node->addr, node->prefix) )
+      break;
+    for( idx = node->head; idx != CP_ROUTE_TRIE_NONE; idx = trie->next[idx] )
+      if( accept(cp_ippl_entry(list, idx), arg) ) {
+        best = idx;
+        break;
+      }
+    if( node->prefix == CI_IPX_MAX_PREFIX_LEN(af) )
+      break;
+    n = node->child[cp_route_trie_bit(af, &addr, node->prefix)];
+  }
+
+  return best;
+}
@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+#ifndef __TOOLS_CPLANE_ROUTE_TRIE_H__
+#define __TOOLS_CPLANE_ROUTE_TRIE_H__
+
+#include "ip_prefix_list.h"
+
+
+/* Longest-prefix-match index over a route table.
+ *
+ * The route table itself stays a sorted cp_ip_prefix_list: it is the
+ * source of truth, and the ordering rules (prefix, then metric, scope,
+ * tos, see cp_route_compare()) are defined there.  The trie is a
+ * path-compressed binary trie whose nodes point to the chain of route
+ * entries with exactly the node's destination, in list order.  So the
+ * best route for an address is the first acceptable entry at the deepest
+ * matching node, and this is exactly what a linear scan of the sorted
+ * list finds.
+ *
+ * The list moves entries around on every add/del, so the trie stores
+ * list indices and remembers the list generation it was built for.  It is
+ * rebuilt lazily on the first lookup after any change, which means that
+ * a burst of route updates followed by fwd table refresh costs one
+ * rebuild instead of a linear scan per fwd entry.  While the list is
+ * unsorted (i.e. route dump is in progress) the trie can't be used and
+ * the callers should fall back to the linear scan.
+ */
+
+#define CP_ROUTE_TRIE_NONE (-1)
+
+struct cp_route_trie_node {
+  ci_addr_sh_t addr;
+  int prefix;
+  /* Index of the first route with this addr/prefix, or CP_ROUTE_TRIE_NONE
+   * for a pure branching node. */
+  int head;
+  int child[2];
+};
+
+struct cp_route_trie {
+  struct cp_route_trie_node* nodes;
+  int n_nodes;
+  int max_nodes;
+
+  /* next[i] is the next route after the i-th one in the node chain */
+  int* next;
+  int max_routes;
+
+  /* Generation of the route list this trie was built from */
+  uint32_t gen;
+  bool valid;
+};
+
+static inline void
+cp_route_trie_init(struct cp_route_trie* trie)
+{
+  memset(trie, 0, sizeof(*trie));
+}
+
+/* Returns true if the trie is usable for the list, rebuilding it if
+ * necessary.  *rebuilt is set only if a rebuild was done and succeeded. */
+bool cp_route_trie_sync(struct cp_route_trie* trie,
+                        struct cp_ip_prefix_list* list, int af,
+                        bool* rebuilt);
+
+typedef bool (*cp_route_trie_accept_fn_t)(struct cp_ip_with_prefix* ipp,
+                                          void* arg);
+
+/* Find the first list entry (in list order) among the longest prefixes
+ * matching addr and accepted by the callback.  Returns list index or
+ * CP_ROUTE_TRIE_NONE.  The trie must be in sync with the list. */
+int cp_route_trie_lookup(struct cp_route_trie* trie,
+                         struct cp_ip_prefix_list* list, int af,
+                         ci_addr_sh_t addr,
+                         cp_route_trie_accept_fn_t accept, void* arg);
+
+#endif /*__TOOLS_CPLANE_ROUTE_TRIE_H__*/
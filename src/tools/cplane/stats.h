@@ -85,4 +85,8 @@ CP_STAT("Failed to find any suitable source address", int, no_source)
 CP_STAT("Data mismatch between netlink info and route tables, used when "
         "--verify-routes is specified or multipath route is present",
         int, mismatch)
+CP_STAT("Number of times the route lookup trie was rebuilt", int,
+        trie_rebuild)
+CP_STAT("Route lookups done by linear scan while the table is unsorted",
+        int, linear_lookup)
 CP_STAT_GROUP_END(route)
@@ -1328,6 +1328,265 @@ static void stack_more_stats_describe(ci_netif* ni)
   ci_dump_stats(more_stats_fields, N_MORE_STATS_FIELDS, &stats, 1, NULL, NULL);
 }
 
+#if CI_CFG_LATENCY_HIST
+
+static double lat_hist_cycles_to_usec(ci_netif* ni, double cycles)
+{
+  return cycles * 1000.0 / IPTIMER_STATE(ni)->khz;
+}
+
+/* Upper bound of the bucket holding the [pct] percentile */
+static double lat_hist_percentile(ci_netif* ni, const struct oo_lat_hist* h,
+                                  double pct)
+{
+  ci_uint64 want = (ci_uint64) (h->count * pct / 100.0 + 0.5);
+  ci_uint64 seen = 0;
+  unsigned i;
+
+  for( i = 0; i < OO_LAT_HIST_N_BUCKETS; ++i ) {
+    seen += h->bucket[i];
+    if( seen >= want && seen != 0 )
+      break;
+  }
+  if( i + 1 >= OO_LAT_HIST_N_BUCKETS )
+    return lat_hist_cycles_to_usec(ni, h->max);
+  return lat_hist_cycles_to_usec(ni, CI_MIN(oo_lat_hist_bucket_min(i + 1) - 1,
+                                            (ci_uint64) h->max));
+}
+
+static void lat_hist_dump(ci_netif* ni, const char* name,
+                          const struct oo_lat_hist* h_shared)
+{
+  static const double pcts[] = { 50, 90, 99, 99.9, 99.99 };
+  struct oo_lat_hist h;
+  unsigned i;
+
+  /* Snapshot, as the stack carries on updating it */
+  memcpy(&h, h_shared, sizeof(h));
+  ci_log("  %s: count=%"CI_PRIu64" mean=%.3fus max=%.3fus", name, h.count,
+         h.count ? lat_hist_cycles_to_usec(ni, (double) h.sum / h.count) : 0,
+         lat_hist_cycles_to_usec(ni, h.max));
+  if( h.count == 0 )
+    return;
+  for( i = 0; i < sizeof(pcts) / sizeof(pcts[0]); ++i )
+    ci_log("    p%-6g <= %.3fus", pcts[i],
+           lat_hist_percentile(ni, &h, pcts[i]));
+  for( i = 0; i < OO_LAT_HIST_N_BUCKETS; ++i )
+    if( h.bucket[i] )
+      ci_log("    >= %10"CI_PRIu64" cycles: %u", oo_lat_hist_bucket_min(i),
+             h.bucket[i]);
+}
+
+static void stack_lat_hist(ci_netif* ni)
+{
+  ci_netif_state* ns = ni->state;
+  int i;
+
+  ci_log("-------------------- lat_hist: %d ---------------------------",
+         NI_ID(ni));
+  if( ! NI_OPTS(ni).latency_hist ) {
+    ci_log("  not recording: EF_LATENCY_HIST is not set");
+    return;
+  }
+  ci_log("  khz=%u", IPTIMER_STATE(ni)->khz);
+  lat_hist_dump(ni, "rx_to_app", &ns->lat_rx_to_app);
+  lat_hist_dump(ni, "send_to_wire", &ns->lat_send_to_wire);
+  lat_hist_dump(ni, "lock_hold", &ns->lat_lock_hold);
+  for( i = 0; i < CI_CFG_LATENCY_HIST_SOCKETS; ++i ) {
+    struct oo_lat_hist_sock* ls = &ns->lat_sock[i];
+    if( ls->rx_to_app.count == 0 && ls->send_to_wire.count == 0 )
+      continue;
+    if( OO_SP_IS_NULL(ls->sock_id) )
+      ci_log("  (closed socket):");
+    else
+      ci_log("  %d:%d:", NI_ID(ni), OO_SP_FMT(ls->sock_id));
+    lat_hist_dump(ni, "rx_to_app", &ls->rx_to_app);
+    lat_hist_dump(ni, "send_to_wire", &ls->send_to_wire);
+  }
+}
+
+static void stack_clear_lat_hist(ci_netif* ni)
+{
+  ci_netif_state* ns = ni->state;
+  int i;
+
+  memset(&ns->lat_rx_to_app, 0, sizeof(ns->lat_rx_to_app));
+  memset(&ns->lat_send_to_wire, 0, sizeof(ns->lat_send_to_wire));
+  memset(&ns->lat_lock_hold, 0, sizeof(ns->lat_lock_hold));
+  for( i = 0; i < CI_CFG_LATENCY_HIST_SOCKETS; ++i ) {
+    memset(&ns->lat_sock[i].rx_to_app, 0, sizeof(ns->lat_sock[i].rx_to_app));
+    memset(&ns->lat_sock[i].send_to_wire, 0,
+           sizeof(ns->lat_sock[i].send_to_wire));
+  }
+}
+
+#endif /* CI_CFG_LATENCY_HIST */
+
+#if CI_CFG_LOCK_PROFILE
+
+static double lock_prof_cycles_to_usec(ci_netif* ni, double cycles)
+{
+  return cycles * 1000.0 / IPTIMER_STATE(ni)->khz;
+}
+
+static int lock_prof_site_cmp(const void* a, const void* b)
+{
+  const struct oo_lock_prof_site* sa = a;
+  const struct oo_lock_prof_site* sb = b;
+  ci_uint64 ta = sa->wait_cycles + sa->hold_cycles;
+  ci_uint64 tb = sb->wait_cycles + sb->hold_cycles;
+  return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+static void stack_lock_prof(ci_netif* ni)
+{
+  static const struct {
+    ci_uint64 flag;
+    const char* name;
+  } flags[] = {
+    { CI_EPLOCK_NETIF_SOCKET_LIST,           "DEFERRED" },
+    { CI_EPLOCK_NETIF_IS_PKT_WAITER,         "PKT_WAIT" },
+    { CI_EPLOCK_NETIF_NEED_POLL,             "POLL" },
+    { CI_EPLOCK_NETIF_NEED_PRIME,            "PRIME" },
+    { CI_EPLOCK_NETIF_PRIME_IF_IDLE,         "PRIME_IF_IDLE" },
+    { CI_EPLOCK_NETIF_CLOSE_ENDPOINT,        "CLOSE_EP" },
+    { CI_EPLOCK_NETIF_NEED_WAKE,             "WAKE" },
+    { CI_EPLOCK_NETIF_PKT_WAKE,              "PKT_WAKE" },
+    { CI_EPLOCK_NETIF_SWF_UPDATE,            "SWF_UPDATE" },
+    { CI_EPLOCK_NETIF_MERGE_ATOMIC_COUNTERS, "MERGE" },
+    { CI_EPLOCK_NETIF_NEED_PKT_SET,          "PKT_SET" },
+    { CI_EPLOCK_NETIF_NEED_SOCK_BUFS,        "SOCK_BUFS" },
+    { CI_EPLOCK_NETIF_PURGE_TXQS,            "PURGE_TXQ" },
+    { CI_EPLOCK_NETIF_KERNEL_PACKETS,        "KPKTS" },
+    { CI_EPLOCK_NETIF_FREE_READY_LIST,       "FREE_RLIST" },
+    { CI_EPLOCK_NETIF_HAS_DEFERRED_PKTS,     "DEFERRED_PKTS" },
+    { CI_EPLOCK_NETIF_HANDLE_ICMP,           "ICMP" },
+  };
+  static struct oo_lock_prof lp;
+  struct oo_lock_prof_site* site;
+  ci_uint64 now;
+  int i, holder;
+
+  ci_log("-------------------- lock_prof: %d --------------------------",
+         NI_ID(ni));
+  if( ! NI_OPTS(ni).lock_profile ) {
+    ci_log("  not recording: EF_LOCK_PROFILE is not set");
+    return;
+  }
+
+  /* Snapshot, as the stack carries on updating it */
+  memcpy(&lp, &ni->state->lock_prof, sizeof(lp));
+  ci_frc64(&now);
+  holder = lp.holder;
+  if( (unsigned) holder < CI_CFG_LOCK_PROFILE_SITES &&
+      (ni->state->lock.lock & CI_EPLOCK_LOCKED) )
+    ci_log("  holder: %.*s:%u for %.3fus",
+           (int) sizeof(lp.site[holder].func), lp.site[holder].func,
+           lp.site[holder].line,
+           lock_prof_cycles_to_usec(ni, (double) (ci_int64)
+                                    (now - lp.hold_frc)));
+  else
+    ci_log("  holder: none recorded");
+  ci_log("  khz=%u untracked=%u", IPTIMER_STATE(ni)->khz, lp.n_untracked);
+
+  qsort(lp.site, CI_CFG_LOCK_PROFILE_SITES, sizeof(lp.site[0]),
+        lock_prof_site_cmp);
+  ci_log("  %-32s %10s %10s %10s %10s %10s %10s", "site (us)", "locks",
+         "waits", "wait_mean", "wait_max", "hold_mean", "hold_max");
+  for( i = 0; i < CI_CFG_LOCK_PROFILE_SITES; ++i ) {
+    char name[48];
+    site = &lp.site[i];
+    if( site->line == 0 || site->n_locks == 0 )
+      continue;
+    snprintf(name, sizeof(name), "%.*s:%u", (int) sizeof(site->func),
+             site->func, site->line);
+    ci_log("  %-32s %10"CI_PRIu64" %10"CI_PRIu64" %10.3f %10.3f "
+           "%10.3f %10.3f", name, site->n_locks, site->n_waits,
+           site->n_waits ? lock_prof_cycles_to_usec(ni,
+                             (double) site->wait_cycles / site->n_waits) : 0,
+           lock_prof_cycles_to_usec(ni, site->wait_max),
+           site->n_holds ? lock_prof_cycles_to_usec(ni,
+                             (double) site->hold_cycles / site->n_holds) : 0,
+           lock_prof_cycles_to_usec(ni, site->hold_max));
+  }
+
+  ci_log("  deferred work done on unlock:");
+  for( i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i ) {
+    unsigned bit = flags[i].flag == CI_EPLOCK_NETIF_SOCKET_LIST ? 0 :
+                   __builtin_ctzll(flags[i].flag);
+    if( lp.deferred[bit] )
+      ci_log("    %-14s %"CI_PRIu64, flags[i].name, lp.deferred[bit]);
+  }
+}
+
+static void stack_clear_lock_prof(ci_netif* ni)
+{
+  struct oo_lock_prof* lp = &ni->state->lock_prof;
+  int i;
+
+  /* Keep the sites, as the holder refers to one. */
+  lp->n_untracked = 0;
+  memset(lp->deferred, 0, sizeof(lp->deferred));
+  for( i = 0; i < CI_CFG_LOCK_PROFILE_SITES; ++i ) {
+    struct oo_lock_prof_site* site = &lp->site[i];
+    site->n_locks = site->n_waits = site->n_holds = 0;
+    site->wait_cycles = site->hold_cycles = 0;
+    site->wait_max = site->hold_max = 0;
+  }
+}
+
+#endif /* CI_CFG_LOCK_PROFILE */
+
+#if CI_CFG_SPIN_ADAPTIVE
+
+static double spin_adapt_cycles_to_usec(ci_netif* ni, double cycles)
+{
+  return cycles * 1000.0 / IPTIMER_STATE(ni)->khz;
+}
+
+static void stack_spin_adapt(ci_netif* ni)
+{
+  ci_uint64 max_spin = ni->state->sock_spin_cycles;
+  struct oo_spin_adapt sa;
+  int i, j;
+
+  ci_log("-------------------- spin_adapt: %d -------------------------",
+         NI_ID(ni));
+  if( ! NI_OPTS(ni).spin_adaptive ) {
+    ci_log("  not adapting: EF_SPIN_ADAPTIVE is not set");
+    return;
+  }
+  ci_log("  EF_SPIN_ADAPTIVE=%u EF_SPIN_USEC=%u khz=%u",
+         NI_OPTS(ni).spin_adaptive, NI_OPTS(ni).spin_usec,
+         IPTIMER_STATE(ni)->khz);
+  for( i = 0; i < CI_CFG_SPIN_ADAPTIVE_THREADS; ++i ) {
+    /* Snapshot, as the thread carries on updating it */
+    memcpy(&sa, &ni->state->spin_adapt[i], sizeof(sa));
+    if( sa.tid == 0 )
+      continue;
+    if( sa.budget_bucket < 0 )
+      ci_log("  tid %d: not spinning", sa.tid);
+    else if( sa.budget_bucket >= OO_SPIN_ADAPT_N_BUCKETS - 1 )
+      ci_log("  tid %d: spinning for the full limit", sa.tid);
+    else
+      ci_log("  tid %d: spinning for up to %.3fus", sa.tid,
+             spin_adapt_cycles_to_usec(ni,
+                                       oo_spin_adapt_budget(&sa, max_spin)));
+    ci_log("    waits=%"CI_PRIu64" spun=%"CI_PRIu64" long=%"CI_PRIu64
+           " spin_time=%.3fus (%.1f%% of full spin)", sa.n_waits, sa.n_spun,
+           sa.n_long, spin_adapt_cycles_to_usec(ni, sa.spin_cycles),
+           sa.full_spin_cycles ?
+             100.0 * sa.spin_cycles / sa.full_spin_cycles : 100.0);
+    ci_log("    recent waits: long=%u", sa.recent_long);
+    for( j = 0; j < OO_SPIN_ADAPT_N_BUCKETS; ++j )
+      if( sa.hist[j] )
+        ci_log("      < %10.3fus: %u",
+               spin_adapt_cycles_to_usec(ni, 2.0 * (1ull << j)), sa.hist[j]);
+  }
+}
+
+#endif /* CI_CFG_SPIN_ADAPTIVE */
+
 #if CI_CFG_SUPPORT_STATS_COLLECTION
 
 static void stack_ip_stats(ci_netif* ni)
@@ -2230,6 +2489,17 @@ static const stack_op_t stack_ops[] = {
   STACK_OP(clear_stats,        "reset stack statistics"),
   STACK_OP(dstats,             "show derived statistics"),
   STACK_OP(more_stats,         "show more stack statistics"),
+#if CI_CFG_LATENCY_HIST
+  STACK_OP(lat_hist,           "show latency histograms (EF_LATENCY_HIST)"),
+  STACK_OP(clear_lat_hist,     "reset latency histograms"),
+#endif
+#if CI_CFG_LOCK_PROFILE
+  STACK_OP(lock_prof,          "show stack lock statistics (EF_LOCK_PROFILE)"),
+  STACK_OP(clear_lock_prof,    "reset stack lock statistics"),
+#endif
+#if CI_CFG_SPIN_ADAPTIVE
+  STACK_OP(spin_adapt,         "show adaptive spin state (EF_SPIN_ADAPTIVE)"),
+#endif
 #if CI_CFG_SUPPORT_STATS_COLLECTION
   STACK_OP(ip_stats,           "show IP statistics"),
   STACK_OP(tcp_stats,          "show TCP statistics"),
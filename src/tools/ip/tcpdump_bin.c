@@ -16,6 +16,7 @@
 #include <stdlib.h>
 #include <ci/internal/ip.h>
 #include <ci/internal/ip_signal.h>
+#include <ci/internal/ip_timestamp.h>
 #include "libc_compat.h"
 
 #if CI_CFG_TCPDUMP
@@ -54,6 +55,25 @@ static int cfg_dump_no_match_only = 0;
 static const char *cfg_precision = "micro";
 static int do_nano = 0;
 
+static int cfg_queue_len = CI_CFG_DUMPQUEUE_LEN_DEFAULT;
+static const char *cfg_bpf_filter = NULL;
+static int cfg_pcapng = 0;
+
+/* cfg_bpf_filter compiled for the stacks to run */
+static struct oo_bpf_insn bpf_prog[CI_CFG_DUMP_FILTER_MAX];
+static int bpf_prog_len = 0;
+
+/* pcapng state for each stack we have attached to */
+struct dump_stack {
+  /* Interface IDs we've described, -1 if not yet */
+  ci_int32  if_id[OO_INTF_I_NUM];
+  /* tcpdump_missed when we last reported drops */
+  ci_uint32 missed;
+};
+static struct dump_stack *dump_stacks = NULL;
+static int dump_stacks_n = 0;
+static int pcapng_n_ifs = 0;
+
 /* Interface to dump */
 static const char *cfg_interface = "any";
 static int cfg_ifindex = -1;
@@ -87,6 +107,12 @@ static ci_cfg_desc cfg_opts[] = {
                            "dump only packets not matching onload sockets"},
   {  2, "time-stamp-precision", CI_CFG_STR, &cfg_precision,
                  "set the timestamp precision, default to \"micro\", man tcpdump"},
+  {  3, "queue-len", CI_CFG_UINT, &cfg_queue_len,
+                 "packets each stack may queue for us, rounded up to 2^n"},
+  {  4, "filter",    CI_CFG_STR,  &cfg_bpf_filter,
+                 "pcap filter expression for the stacks to apply"},
+  {  5, "pcapng",    CI_CFG_FLAG, &cfg_pcapng,
+                 "write pcapng with interfaces, drop counts and NIC stamps"},
 };
 #define N_CFG_OPTS (sizeof(cfg_opts) / sizeof(cfg_opts[0]))
 
@@ -243,6 +269,28 @@ suicide:
   exit(1);
 }
 
+/* Forget what we told the pcapng reader about a stack with this ID */
+static void dump_stack_init(ci_netif *ni)
+{
+  int i, id = ni->state->stack_id;
+  struct dump_stack *ds;
+
+  if( id >= dump_stacks_n ) {
+    int n = CI_MAX(id + 1, dump_stacks_n * 2);
+    dump_stacks = realloc(dump_stacks, n * sizeof(dump_stacks[0]));
+    CI_TEST(dump_stacks != NULL);
+    dump_stacks_n = n;
+  }
+  ds = &dump_stacks[id];
+  for( i = 0; i < OO_INTF_I_NUM; i++ )
+    ds->if_id[i] = -1;
+#if CI_CFG_STATS_NETIF
+  ds->missed = ni->state->stats.tcpdump_missed;
+#else
+  ds->missed = 0;
+#endif
+}
+
 /* Turn dumping on */
 static void stack_dump_on(ci_netif *ni)
 {
@@ -275,11 +323,26 @@ static void stack_dump_on(ci_netif *ni)
   /* Init dump queue */
   for( i = 0; i < CI_CFG_DUMPQUEUE_LEN; i++ )
     ni->state->dump_queue[i] = OO_PP_NULL;
+  ni->state->dump_queue_mask = cfg_queue_len - 1;
 
   /* Find interface details if unknown */
   if( dump_hwports[0] == -1 )
     ifindex_to_intf_i(ni);
 
+  /* The stack sees VLAN tags that we strip, so it can't filter for us on a
+   * VLAN interface. */
+  if( bpf_prog_len != 0 && ! (cfg_encap.type & CICP_LLAP_TYPE_VLAN) ) {
+    memcpy(ni->state->dump_filter, bpf_prog,
+           bpf_prog_len * sizeof(bpf_prog[0]));
+    ni->state->dump_filter_len = bpf_prog_len;
+  }
+  else {
+    ni->state->dump_filter_len = 0;
+  }
+
+  if( cfg_pcapng )
+    dump_stack_init(ni);
+
   /* Set up dumping */
   ci_log("Onload stack [%d,%s]: start packet dump",
          ni->state->stack_id, ni->state->name);
@@ -305,6 +368,7 @@ static void stack_dump_off(ci_netif *ni)
 {
   memset(ni->state->dump_intf, 0, sizeof(ni->state->dump_intf));
   libstack_netif_lock(ni);
+  ni->state->dump_filter_len = 0;
   oo_tcpdump_free_pkts(ni, ni->state->dump_read_i);
   ni->state->dump_read_i = ni->state->dump_write_i;
   ci_log("Onload stack [%d,%s]: stop packet dump",
@@ -327,6 +391,178 @@ static void dump_flush(void)
   }
 }
 
+/* pcapng blocks and options, see draft-ietf-opsawg-pcapng */
+#define PCAPNG_SHB           0x0a0d0d0a
+#define PCAPNG_IDB           0x00000001
+#define PCAPNG_EPB           0x00000006
+#define PCAPNG_BYTE_ORDER    0x1a2b3c4d
+
+#define PCAPNG_OPT_END       0
+#define PCAPNG_SHB_USERAPPL  4
+#define PCAPNG_IF_NAME       2
+#define PCAPNG_IF_DESC       3
+#define PCAPNG_IF_TSRESOL    9
+#define PCAPNG_EPB_FLAGS     2
+#define PCAPNG_EPB_DROPCOUNT 4
+
+#define PCAPNG_EPB_INBOUND   1
+#define PCAPNG_EPB_OUTBOUND  2
+
+#define PCAPNG_PAD(len)      (((len) + 3) & ~3)
+#define PCAPNG_OPT_LEN(len)  (4 + PCAPNG_PAD(len))
+
+static void dump_pad(size_t len)
+{
+  static const ci_uint8 zeros[4];
+  if( len & 3 )
+    dump_data(zeros, 4 - (len & 3));
+}
+
+static void pcapng_opt(ci_uint16 code, const void *val, ci_uint16 len)
+{
+  ci_uint16 hdr[2] = { code, len };
+  dump_data(hdr, sizeof(hdr));
+  if( len != 0 ) {
+    dump_data(val, len);
+    dump_pad(len);
+  }
+}
+
+static void write_pcapng_header(void)
+{
+  static const char appl[] = "onload_tcpdump";
+  ci_uint32 hdr[6];
+  ci_uint32 len = sizeof(hdr) + PCAPNG_OPT_LEN(sizeof(appl)) +
+                  PCAPNG_OPT_LEN(0) + sizeof(len);
+
+  hdr[0] = PCAPNG_SHB;
+  hdr[1] = len;
+  hdr[2] = PCAPNG_BYTE_ORDER;
+  hdr[3] = 1;  /* version 1.0 */
+  hdr[4] = hdr[5] = 0xffffffff;  /* section length unknown */
+  dump_data(hdr, sizeof(hdr));
+  pcapng_opt(PCAPNG_SHB_USERAPPL, appl, sizeof(appl));
+  pcapng_opt(PCAPNG_OPT_END, NULL, 0);
+  dump_data(&len, sizeof(len));
+  dump_flush();
+}
+
+/* Describe an interface of a stack, and return its pcapng ID */
+static int pcapng_if_id(ci_netif *ni, int intf_i)
+{
+  struct dump_stack *ds = &dump_stacks[ni->state->stack_id];
+  char name[sizeof(ni->state->nic[0].dev_name) + 1];
+  char desc[CI_CFG_STACK_NAME_LEN + 32];
+  ci_uint8 tsresol = 9;  /* nanoseconds */
+  ci_uint32 hdr[4];
+  ci_uint32 len;
+
+  if( intf_i < 0 || intf_i >= OO_INTF_I_NUM )
+    intf_i = OO_INTF_I_SEND_VIA_OS;
+  if( ds->if_id[intf_i] >= 0 )
+    return ds->if_id[intf_i];
+
+  if( intf_i == OO_INTF_I_LOOPBACK )
+    strcpy(name, "lo");
+  else if( intf_i == OO_INTF_I_SEND_VIA_OS )
+    strcpy(name, "os");
+  else
+    snprintf(name, sizeof(name), "%s", ni->state->nic[intf_i].dev_name);
+  snprintf(desc, sizeof(desc), "Onload stack [%d,%s]",
+           ni->state->stack_id, ni->state->name);
+
+  len = sizeof(hdr) + PCAPNG_OPT_LEN(strlen(name)) +
+        PCAPNG_OPT_LEN(strlen(desc)) + PCAPNG_OPT_LEN(sizeof(tsresol)) +
+        PCAPNG_OPT_LEN(0) + sizeof(len);
+  hdr[0] = PCAPNG_IDB;
+  hdr[1] = len;
+  hdr[2] = DLT_EN10MB;  /* and 16 reserved bits */
+  hdr[3] = cfg_snaplen;
+  dump_data(hdr, sizeof(hdr));
+  pcapng_opt(PCAPNG_IF_NAME, name, strlen(name));
+  pcapng_opt(PCAPNG_IF_DESC, desc, strlen(desc));
+  pcapng_opt(PCAPNG_IF_TSRESOL, &tsresol, sizeof(tsresol));
+  pcapng_opt(PCAPNG_OPT_END, NULL, 0);
+  dump_data(&len, sizeof(len));
+
+  ds->if_id[intf_i] = pcapng_n_ifs++;
+  return ds->if_id[intf_i];
+}
+
+/* Packets the stack couldn't queue for us since we last asked */
+static ci_uint64 pcapng_dropped(ci_netif *ni)
+{
+#if CI_CFG_STATS_NETIF
+  struct dump_stack *ds = &dump_stacks[ni->state->stack_id];
+  ci_uint32 missed = ni->state->stats.tcpdump_missed;
+  ci_uint32 dropped = missed - ds->missed;
+  ds->missed = missed;
+  return dropped;
+#else
+  return 0;
+#endif
+}
+
+/* Options of an Enhanced Packet Block, which follow the packet data */
+struct pcapng_epb_opts {
+  ci_uint32 flags;
+  ci_uint64 dropped;
+};
+
+static ci_uint32 pcapng_epb_len(ci_uint32 caplen,
+                                const struct pcapng_epb_opts *opts)
+{
+  return 7 * sizeof(ci_uint32) + PCAPNG_PAD(caplen) +
+         PCAPNG_OPT_LEN(sizeof(opts->flags)) +
+         (opts->dropped ? PCAPNG_OPT_LEN(sizeof(opts->dropped)) : 0) +
+         PCAPNG_OPT_LEN(0) + sizeof(ci_uint32);
+}
+
+/* Write an Enhanced Packet Block up to the packet data.
+ *
+ * We use the NIC's timestamp where a received packet has one.  Drops are
+ * counted for the whole stack, and reported on the stack's next packet. */
+static void pcapng_epb_start(ci_netif *ni, ci_ip_pkt_fmt *pkt,
+                             const struct timespec *ts, ci_uint32 caplen,
+                             ci_uint32 len, struct pcapng_epb_opts *opts)
+{
+  ci_uint32 hdr[7];
+  int if_id = pcapng_if_id(ni, pkt->intf_i);
+  ci_uint64 stamp = ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+
+  opts->flags = (pkt->flags & CI_PKT_FLAG_RX) ? PCAPNG_EPB_INBOUND :
+                                                PCAPNG_EPB_OUTBOUND;
+  opts->dropped = pcapng_dropped(ni);
+
+#if CI_CFG_TIMESTAMPING
+  if( (pkt->flags & CI_PKT_FLAG_RX) && pkt->hw_stamp.tv_sec != 0 )
+    stamp = pkt->hw_stamp.tv_sec * 1000000000ULL + pkt->hw_stamp.tv_nsec;
+#endif
+
+  hdr[0] = PCAPNG_EPB;
+  hdr[1] = pcapng_epb_len(caplen, opts);
+  hdr[2] = if_id;
+  hdr[3] = stamp >> 32;
+  hdr[4] = (ci_uint32) stamp;
+  hdr[5] = caplen;
+  hdr[6] = len;
+  dump_data(hdr, sizeof(hdr));
+}
+
+/* Finish off an Enhanced Packet Block after the packet data */
+static void pcapng_epb_end(ci_uint32 caplen,
+                           const struct pcapng_epb_opts *opts)
+{
+  ci_uint32 block_len = pcapng_epb_len(caplen, opts);
+
+  dump_pad(caplen);
+  pcapng_opt(PCAPNG_EPB_FLAGS, &opts->flags, sizeof(opts->flags));
+  if( opts->dropped )
+    pcapng_opt(PCAPNG_EPB_DROPCOUNT, &opts->dropped, sizeof(opts->dropped));
+  pcapng_opt(PCAPNG_OPT_END, NULL, 0);
+  dump_data(&block_len, sizeof(block_len));
+}
+
 /* Do dump */
 static void stack_dump(ci_netif *ni)
 {
@@ -334,6 +570,7 @@ static void stack_dump(ci_netif *ni)
   int do_strip_vlan = strip_vlan;
   ci_uint16 read_i = ni->state->dump_read_i;
   ci_uint16 i, fill_level = ni->state->dump_write_i - read_i;
+  ci_uint16 mask = ni->state->dump_queue_mask;
   sigset_t sigset;
 
   if( fill_level == 0 )
@@ -346,8 +583,8 @@ static void stack_dump(ci_netif *ni)
    * dump_read_i frequently since dirtying the cache line adds overhead to
    * the application we're monitoring.
    */
-  if( fill_level > CI_CFG_DUMPQUEUE_LEN / 4 )
-    fill_level = CI_CFG_DUMPQUEUE_LEN / 4;
+  if( fill_level > (mask + 1) / 4 )
+    fill_level = (mask + 1) / 4;
 
   /* Barrier to ensure entries in dump ring are written. */
   ci_rmb();
@@ -357,13 +594,15 @@ static void stack_dump(ci_netif *ni)
 
   for( i = 0; i < fill_level; ++i, ++read_i ) {
     struct oo_pcap_pkthdr hdr;
+    struct pcapng_epb_opts epb;
     struct timespec ts;
+    ci_uint32 caplen;
     int paylen;
     int fraglen;
     oo_pkt_p id;
     ci_ip_pkt_fmt *pkt;
 
-    id = ni->state->dump_queue[read_i % CI_CFG_DUMPQUEUE_LEN];
+    id = ni->state->dump_queue[read_i & mask];
     if( id == OO_PP_NULL )
       continue;
     pkt = PKT_CHK_NNL(ni, id);
@@ -414,7 +653,11 @@ static void stack_dump(ci_netif *ni)
                     read_i, ni->state->stack_id,
                     OO_PKT_FMT(pkt), paylen, pkt->refcount));
 
-    dump_data(&hdr, sizeof(hdr));
+    caplen = hdr.caplen;
+    if( cfg_pcapng )
+      pcapng_epb_start(ni, pkt, &ts, caplen, hdr.len, &epb);
+    else
+      dump_data(&hdr, sizeof(hdr));
     fraglen = hdr.caplen;
     if( do_strip_vlan ) {
       if( pkt->n_buffers > 1 )
@@ -442,6 +685,9 @@ static void stack_dump(ci_netif *ni)
         frag = PKT_CHK_NNL(ni, frag->frag_next);
       } while( frag != NULL );
     }
+
+    if( cfg_pcapng )
+      pcapng_epb_end(caplen, &epb);
   }
 
   /* Ensure we've finished reading before we release. */
@@ -565,6 +811,46 @@ static void write_pcap_header(void)
   dump_flush();
 }
 
+/* Compile cfg_bpf_filter for the stacks to run.  If we can't, the stacks
+ * queue everything and leave the filtering to tcpdump, as they used to. */
+static void compile_filter(void)
+{
+  struct bpf_program prog;
+  pcap_t *p;
+
+  if( cfg_bpf_filter == NULL || cfg_bpf_filter[0] == '\0' )
+    return;
+
+  p = pcap_open_dead(DLT_EN10MB, cfg_snaplen);
+  if( p == NULL ) {
+    ci_log("Failed to compile filter: pcap_open_dead failed");
+    return;
+  }
+  if( pcap_compile(p, &prog, cfg_bpf_filter, 1, PCAP_NETMASK_UNKNOWN) != 0 ) {
+    ci_log("Not filtering in the stacks: %s", pcap_geterr(p));
+  }
+  else {
+    if( prog.bf_len > CI_CFG_DUMP_FILTER_MAX ) {
+      ci_log("Not filtering in the stacks: filter has %u instructions, "
+             "the limit is %d", prog.bf_len, CI_CFG_DUMP_FILTER_MAX);
+    }
+    else {
+      int i;
+      for( i = 0; i < prog.bf_len; i++ ) {
+        bpf_prog[i].code = prog.bf_insns[i].code;
+        bpf_prog[i].jt = prog.bf_insns[i].jt;
+        bpf_prog[i].jf = prog.bf_insns[i].jf;
+        bpf_prog[i].k = prog.bf_insns[i].k;
+      }
+      bpf_prog_len = prog.bf_len;
+      LOG_DUMP(ci_log("filter '%s': %d instructions", cfg_bpf_filter,
+                      bpf_prog_len));
+    }
+    pcap_freecode(&prog);
+  }
+  pcap_close(p);
+}
+
 /* Thread to catch stack list updates.  This thread should not call
  * list_all_stacks2(), since libstack is not thread-safe.  So, we just set
  * stacklist_has_update flag and main thread should call
@@ -690,11 +976,23 @@ int main(int argc, char* argv[])
   cfg_snaplen = CI_MAX(cfg_snaplen, 80);
   cfg_snaplen = CI_MIN(cfg_snaplen, MAXIMUM_SNAPLEN);
 
+  /* The queue length must be a power of 2.  We keep a quarter of it free
+   * for the stack while we write out the rest. */
+  cfg_queue_len = CI_MAX(cfg_queue_len, 4);
+  cfg_queue_len = CI_MIN(cfg_queue_len, CI_CFG_DUMPQUEUE_LEN);
+  while( cfg_queue_len & (cfg_queue_len - 1) )
+    cfg_queue_len += cfg_queue_len & -cfg_queue_len;
+
+  compile_filter();
+
   /* Parse interfaces */
   parse_interface();
 
-  /* Pcap file header */
-  write_pcap_header();
+  /* File header */
+  if( cfg_pcapng )
+    write_pcapng_header();
+  else
+    write_pcap_header();
 
   /* Get the initial seq no of stack list */
   CI_TRY(oo_fd_open(&onload_fd));
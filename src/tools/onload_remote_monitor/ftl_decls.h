@@ -26,6 +26,10 @@ FTL_DECLARE(STRUCT_NETIF_DBG_MAX)
 FTL_DECLARE(STRUCT_NETIF_THRD_INFO)
 FTL_DECLARE(STRUCT_EF_VI_STATS)
 FTL_DECLARE(STRUCT_SOCKET_CACHE)
+#if CI_CFG_LATENCY_HIST
+FTL_DECLARE(STRUCT_OO_LAT_HIST)
+FTL_DECLARE(STRUCT_OO_LAT_HIST_SOCK)
+#endif
 FTL_DECLARE(STRUCT_NETIF_STATE)
 FTL_DECLARE(STRUCT_USER_PTR)
 FTL_DECLARE(UNION_SLEEP_SEQ)
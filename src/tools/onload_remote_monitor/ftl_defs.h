@@ -105,6 +105,12 @@
 #define ON_CI_CFG_BURST_CONTROL IGNORE
 #endif
 
+#if CI_CFG_TCP_PACING
+#define ON_CI_CFG_TCP_PACING DO
+#else
+#define ON_CI_CFG_TCP_PACING IGNORE
+#endif
+
 #if CI_CFG_TCP_FASTSTART
 #define ON_CI_CFG_TCP_FASTSTART DO
 #else
@@ -141,6 +147,12 @@
 #define ON_CI_CFG_TCPDUMP IGNORE
 #endif
 
+#if CI_CFG_LATENCY_HIST
+#define ON_CI_CFG_LATENCY_HIST DO
+#else
+#define ON_CI_CFG_LATENCY_HIST IGNORE
+#endif
+
 #if CI_CFG_SPIN_STATS
 #define ON_CI_CFG_SPIN_STATS DO
 #else
@@ -345,6 +357,7 @@ typedef struct oo_p_dllink oo_p_dllink_t;
     FTL_TFIELD_STRUCT(ctx, oo_p_dllink_t, fire_list, ORM_OUTPUT_EXTRA)      \
     FTL_TFIELD_ARRAYOFSTRUCT(ctx, \
                              oo_p_dllink_t, warray, CI_IPTIME_WHEELSIZE, ORM_OUTPUT_EXTRA, 1)   \
+    FTL_TFIELD_INT(ctx, ci_uint32, cascade_left, ORM_OUTPUT_STACK)           \
     FTL_TSTRUCT_END(ctx)                                                 
 
 #define STRUCT_IP_TIMER(ctx) \
@@ -353,6 +366,7 @@ typedef struct oo_p_dllink oo_p_dllink_t;
     FTL_TFIELD_INT(ctx, ci_iptime_t, time, ORM_OUTPUT_STACK)                       \
     FTL_TFIELD_INT(ctx, oo_p, statep, ORM_OUTPUT_EXTRA)                     \
     FTL_TFIELD_INT(ctx, ci_iptime_callback_fn_t, fn, ORM_OUTPUT_EXTRA)             \
+    FTL_TFIELD_INT(ctx, ci_uint16, defer, ORM_OUTPUT_STACK)                       \
     FTL_TSTRUCT_END(ctx)                                                 
 
 #define STRUCT_EF_VI_TXQ_STATE(ctx)                             \
@@ -464,6 +478,28 @@ typedef struct oo_p_dllink oo_p_dllink_t;
   FTL_TFIELD_INT(ctx, ci_int32, avail_stack, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
   FTL_TSTRUCT_END(ctx)
 
+#if CI_CFG_LATENCY_HIST
+typedef struct oo_lat_hist oo_lat_hist_t;
+typedef struct oo_lat_hist_sock oo_lat_hist_sock_t;
+
+/* Buckets are in CPU cycles; see oo_lat_hist_bucket_min() */
+#define STRUCT_OO_LAT_HIST(ctx)                                         \
+  FTL_TSTRUCT_BEGIN(ctx, oo_lat_hist_t, )                               \
+  FTL_TFIELD_INT(ctx, ci_uint64, count, ORM_OUTPUT_STACK)               \
+  FTL_TFIELD_INT(ctx, ci_uint64, sum, ORM_OUTPUT_STACK)                 \
+  FTL_TFIELD_INT(ctx, ci_uint32, max, ORM_OUTPUT_STACK)                 \
+  FTL_TFIELD_ARRAYOFINT(ctx, ci_uint32, bucket, OO_LAT_HIST_N_BUCKETS,  \
+                        ORM_OUTPUT_STACK)                               \
+  FTL_TSTRUCT_END(ctx)
+
+#define STRUCT_OO_LAT_HIST_SOCK(ctx)                                    \
+  FTL_TSTRUCT_BEGIN(ctx, oo_lat_hist_sock_t, )                          \
+  FTL_TFIELD_INT(ctx, ci_int32, sock_id, ORM_OUTPUT_STACK)              \
+  FTL_TFIELD_STRUCT(ctx, oo_lat_hist_t, rx_to_app, ORM_OUTPUT_STACK)    \
+  FTL_TFIELD_STRUCT(ctx, oo_lat_hist_t, send_to_wire, ORM_OUTPUT_STACK) \
+  FTL_TSTRUCT_END(ctx)
+#endif
+
 #define STRUCT_NETIF_STATE(ctx)                                         \
   FTL_TSTRUCT_BEGIN(ctx, ci_netif_state, )                              \
   FTL_TFIELD_ARRAYOFSTRUCT(ctx, ci_netif_state_nic_t, nic, CI_CFG_MAX_INTERFACES, \
@@ -588,10 +624,21 @@ typedef struct oo_p_dllink oo_p_dllink_t;
                           OO_INTF_I_NUM, ORM_OUTPUT_STACK)                                \
     FTL_TFIELD_INT(ctx, ci_uint16, dump_read_i, ORM_OUTPUT_STACK)         \
     FTL_TFIELD_INT(ctx, ci_uint16, dump_write_i, ORM_OUTPUT_STACK)        \
+    FTL_TFIELD_INT(ctx, ci_uint16, dump_queue_mask, ORM_OUTPUT_STACK)     \
+    FTL_TFIELD_INT(ctx, ci_uint16, dump_filter_len, ORM_OUTPUT_STACK)     \
+  ) \
+  ON_CI_CFG_LATENCY_HIST(                                               \
+    FTL_TFIELD_STRUCT(ctx, oo_lat_hist_t, lat_rx_to_app, ORM_OUTPUT_STACK) \
+    FTL_TFIELD_STRUCT(ctx, oo_lat_hist_t, lat_send_to_wire, ORM_OUTPUT_STACK) \
+    FTL_TFIELD_STRUCT(ctx, oo_lat_hist_t, lat_lock_hold, ORM_OUTPUT_STACK) \
+    FTL_TFIELD_ARRAYOFSTRUCT(ctx, oo_lat_hist_sock_t, lat_sock,         \
+                             CI_CFG_LATENCY_HIST_SOCKETS, ORM_OUTPUT_STACK, \
+                             OO_SP_NOT_NULL(stats->lat_sock[i].sock_id)) \
   ) \
   FTL_TFIELD_STRUCT(ctx, ef_vi_stats, vi_stats, ORM_OUTPUT_STACK) \
   FTL_TFIELD_INT(ctx, ci_int32, creation_numa_node, ORM_OUTPUT_STACK)     \
   FTL_TFIELD_INT(ctx, ci_int32, load_numa_node, ORM_OUTPUT_STACK)         \
+  FTL_TFIELD_INT(ctx, ci_int32, alloc_numa_node, ORM_OUTPUT_STACK)        \
   FTL_TFIELD_INT(ctx, ci_uint32, packet_alloc_numa_nodes, ORM_OUTPUT_STACK)\
   FTL_TFIELD_INT(ctx, ci_uint32, sock_alloc_numa_nodes, ORM_OUTPUT_STACK) \
   FTL_TFIELD_INT(ctx, ci_uint32, interrupt_numa_nodes, ORM_OUTPUT_STACK)  \
@@ -847,6 +894,8 @@ typedef struct oo_sock_cplane oo_sock_cplane_t;
   FTL_TFIELD_INT(ctx, ci_uint32, n_rx_overflow, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))    \
   FTL_TFIELD_INT(ctx, ci_uint32, n_rx_mem_drop, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))    \
   FTL_TFIELD_INT(ctx, ci_uint32, n_rx_pktinfo, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_rx_gro, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_rx_gro_segs, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))    \
   FTL_TFIELD_INT(ctx, ci_uint32, max_recvq_pkts, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_os, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_os_slow, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
@@ -867,6 +916,8 @@ typedef struct oo_sock_cplane oo_sock_cplane_t;
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_block, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))       \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_poll_avoids_full, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_fragments, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))   \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_tx_gso, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_tx_gso_segs, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))    \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_msg_confirm, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_os_late, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_unconnect_late, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
@@ -885,6 +936,9 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
   ON_CI_CFG_BURST_CONTROL(                                              \
      FTL_TFIELD_INT(ctx, ci_uint32, tx_stop_burst, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
                                                                         ) \
+  ON_CI_CFG_TCP_PACING(                                                 \
+     FTL_TFIELD_INT(ctx, ci_uint32, tx_stop_pace, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+                                                                        ) \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_nomac_defer, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))   \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_defer, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_msg_warm_abort, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
@@ -917,6 +971,7 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
   FTL_TFIELD_STRUCT(ctx, ci_sock_cmn, s, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                  \
   FTL_TFIELD_STRUCT(ctx, ci_ip_cached_hdrs, ephemeral_pkt, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
   FTL_TFIELD_INT(ctx, ci_uint32, udpflags, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
+  FTL_TFIELD_INT(ctx, ci_uint32, gso_size, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
   ON_CI_CFG_ZC_RECV_FILTER( \
     FTL_TFIELD_INT(ctx, ci_uint64, recv_q_filter, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
     FTL_TFIELD_INT(ctx, ci_uint64, recv_q_filter_arg, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
@@ -1006,6 +1061,9 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     FTL_TFIELD_INT(ctx, ci_iptime_t, t_ka_intvl_in_secs, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
     FTL_TFIELD_INT(ctx, ci_uint16, user_mss, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
     FTL_TFIELD_INT(ctx, ci_uint8, tcp_defer_accept, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))	      \
+    ON_CI_CFG_TCP_PACING(                                                     \
+      FTL_TFIELD_INT(ctx, ci_uint64, max_pacing_rate, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))      \
+    )                                                                         \
     FTL_TSTRUCT_END(ctx)
 
 #define STRUCT_TCP(ctx) \
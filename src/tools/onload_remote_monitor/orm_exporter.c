@@ -0,0 +1,241 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/*
+ * Serve Onload stack statistics over HTTP in OpenMetrics text format, for
+ * scraping by Prometheus or compatible collectors.
+ *
+ * Scrapes never touch the stacks: they are answered from a cached snapshot
+ * that is refreshed between scrapes.  Stack-wide counters are refreshed
+ * every --interval; anything that needs a walk of every endpoint (socket
+ * summaries and --sockets output) only every --sockets-interval, which is
+ * also when the set of stacks is re-read.
+ */
+
+#define _GNU_SOURCE
+
+#include <ci/internal/ip.h>
+#include <ci/app/testapp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "orm_openmetrics.h"
+
+
+static const char* cfg_stackname;
+static const char* cfg_bind = "0.0.0.0";
+static unsigned cfg_port = 9185;
+static unsigned cfg_interval = 1;
+static unsigned cfg_sockets_interval = 10;
+static int cfg_sockets;
+
+static ci_cfg_desc cfg_opts[] = {
+  { 'h', "help", CI_CFG_USAGE, 0, "this message" },
+  { 0, "name",  CI_CFG_STR,  &cfg_stackname, "select a single stack name" },
+  { 0, "bind",  CI_CFG_STR,  &cfg_bind,
+    "address to listen on (default 0.0.0.0)" },
+  { 0, "port",  CI_CFG_UINT, &cfg_port,
+    "port to listen on (default 9185)" },
+  { 0, "interval",  CI_CFG_UINT,  &cfg_interval,
+    "seconds between refreshes of stack counters (default 1s)" },
+  { 0, "sockets-interval",  CI_CFG_UINT,  &cfg_sockets_interval,
+    "seconds between walks of all sockets (default 10s)" },
+  { 0, "sockets",  CI_CFG_FLAG,  &cfg_sockets,
+    "include per-socket TCP and UDP counters" },
+};
+#define N_CFG_OPTS (sizeof(cfg_opts) / sizeof(cfg_opts[0]))
+
+
+struct snapshot {
+  char*  buf;
+  size_t len;
+};
+
+
+static uint64_t now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000ull + ts.tv_nsec / 1000000;
+}
+
+
+/* Replace [snap] with fresh output.  On failure the previous snapshot is
+ * kept, so scrapers see stale data rather than none.
+ */
+static void snapshot_refresh(struct snapshot* snap, struct orm_om_state* st,
+                             bool sockets)
+{
+  char* buf = NULL;
+  size_t len = 0;
+  FILE* f = open_memstream(&buf, &len);
+  int rc;
+
+  if( f == NULL ) {
+    ci_log("open_memstream failed (%d)", errno);
+    return;
+  }
+  if( sockets )
+    rc = orm_om_dump_sockets(st, f, cfg_sockets);
+  else
+    rc = orm_om_dump_stacks(st, f);
+  fclose(f);
+
+  if( rc != 0 ) {
+    ci_log("Not able to generate %s metrics rc=%d",
+           sockets ? "socket" : "stack", rc);
+    free(buf);
+    return;
+  }
+  free(snap->buf);
+  snap->buf = buf;
+  snap->len = len;
+}
+
+
+static void send_all(int fd, const char* buf, size_t len)
+{
+  ssize_t rc;
+
+  while( len > 0 ) {
+    rc = send(fd, buf, len, MSG_NOSIGNAL);
+    if( rc <= 0 ) {
+      if( rc < 0 && errno == EINTR )
+        continue;
+      return;
+    }
+    buf += rc;
+    len -= rc;
+  }
+}
+
+
+static void serve(int fd, const struct snapshot* stacks,
+                  const struct snapshot* sockets)
+{
+  struct timeval tv = { .tv_sec = 1 };
+  char req[1024];
+  char hdr[256];
+  size_t got = 0;
+  ssize_t rc;
+
+  /* Don't let a slow or stuck client hold up everyone else */
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+  /* Only the request line matters */
+  while( got < sizeof(req) - 1 && memchr(req, '\n', got) == NULL ) {
+    rc = recv(fd, req + got, sizeof(req) - 1 - got, 0);
+    if( rc <= 0 )
+      return;
+    got += rc;
+  }
+  req[got] = '\0';
+
+  if( strncmp(req, "GET /metrics ", 13) != 0 &&
+      strncmp(req, "GET / ", 6) != 0 ) {
+    static const char not_found[] =
+      "HTTP/1.1 404 Not Found\r\n"
+      "Content-Length: 0\r\n"
+      "Connection: close\r\n\r\n";
+    send_all(fd, not_found, sizeof(not_found) - 1);
+    return;
+  }
+
+  snprintf(hdr, sizeof(hdr),
+           "HTTP/1.1 200 OK\r\n"
+           "Content-Type: application/openmetrics-text; version=1.0.0; "
+           "charset=utf-8\r\n"
+           "Content-Length: %zu\r\n"
+           "Connection: close\r\n\r\n",
+           stacks->len + sockets->len + strlen(orm_om_eof));
+  send_all(fd, hdr, strlen(hdr));
+  send_all(fd, stacks->buf, stacks->len);
+  send_all(fd, sockets->buf, sockets->len);
+  send_all(fd, orm_om_eof, strlen(orm_om_eof));
+}
+
+
+static int listen_socket(void)
+{
+  struct sockaddr_in sin = {
+    .sin_family = AF_INET,
+    .sin_port = htons(cfg_port),
+  };
+  int one = 1;
+  int fd;
+
+  if( inet_pton(AF_INET, cfg_bind, &sin.sin_addr) != 1 ) {
+    ci_log("Bad --bind address '%s'", cfg_bind);
+    return -1;
+  }
+  if( (fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+      bind(fd, (struct sockaddr*) &sin, sizeof(sin)) < 0 ||
+      listen(fd, 16) < 0 ) {
+    ci_log("Cannot listen on %s:%u (%s)", cfg_bind, cfg_port,
+           strerror(errno));
+    return -1;
+  }
+  return fd;
+}
+
+
+int main(int argc, char** argv)
+{
+  struct snapshot stacks = { }, sockets = { };
+  struct orm_om_state* st;
+  uint64_t now, next_stacks = 0, next_sockets = 0, next;
+  int lfd, fd;
+
+  ci_app_standard_opts = 0;
+  ci_app_getopt("", &argc, argv, cfg_opts, N_CFG_OPTS);
+  ++argv;  --argc;
+  if( argc != 0 )
+    ci_app_usage("unexpected arguments");
+  if( cfg_interval == 0 )
+    cfg_interval = 1;
+  if( cfg_sockets_interval < cfg_interval )
+    cfg_sockets_interval = cfg_interval;
+
+  if( (st = orm_om_alloc(cfg_stackname)) == NULL )
+    return EXIT_FAILURE;
+  if( (lfd = listen_socket()) < 0 )
+    return EXIT_FAILURE;
+  signal(SIGPIPE, SIG_IGN);
+
+  while( 1 ) {
+    struct pollfd pfd = { .fd = lfd, .events = POLLIN };
+
+    now = now_ms();
+    if( now >= next_sockets ) {
+      orm_om_map_stacks(st);
+      snapshot_refresh(&sockets, st, true);
+      next_sockets = now + cfg_sockets_interval * 1000ull;
+      next_stacks = 0;
+    }
+    if( now >= next_stacks ) {
+      snapshot_refresh(&stacks, st, false);
+      next_stacks = now + cfg_interval * 1000ull;
+    }
+
+    next = CI_MIN(next_stacks, next_sockets);
+    if( poll(&pfd, 1, (int) (next - now)) <= 0 )
+      continue;
+    if( (fd = accept(lfd, NULL, NULL)) < 0 )
+      continue;
+    serve(fd, &stacks, &sockets);
+    close(fd);
+  }
+
+  orm_om_free(st);
+  return 0;
+}
@@ -0,0 +1,618 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/* OpenMetrics text exposition of Onload stack statistics.  See
+ * orm_openmetrics.h for how the output is split up.
+ */
+
+#define _GNU_SOURCE
+
+#include <ci/internal/ip.h>
+#include <onload/ioctl.h>
+#include <onload/driveraccess.h>
+#include <onload/debug_intf.h>
+#include <onload/version.h>
+
+#include "ftl_defs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#include <ci/internal/more_stats.h>
+#include "orm_openmetrics.h"
+
+
+#define LOG(...) fprintf(stderr, __VA_ARGS__)
+
+/**********************************************************/
+/* Field tables */
+/**********************************************************/
+
+enum orm_om_type {
+  OM_SKIP,
+  OM_COUNTER,
+  OM_GAUGE,
+};
+
+struct orm_om_field {
+  const char*      name;
+  const char*      help;
+  enum orm_om_type type;
+  unsigned         offset;
+  unsigned         size;
+};
+
+/* Counters that are always zero are left out, as they are in the JSON
+ * output.
+ */
+#define OM_KIND_count       OM_COUNTER
+#define OM_KIND_val         OM_GAUGE
+#define OM_KIND_count_zero  OM_SKIP
+
+#define OO_STAT(desc, type, name, kind)                                 \
+  { #name, desc, OM_KIND_##kind, offsetof(OM_STRUCT, name), sizeof(type) },
+
+#define OM_STRUCT ci_netif_stats
+static const struct orm_om_field netif_stats_fields[] = {
+#include <ci/internal/stats_def.h>
+};
+#undef OM_STRUCT
+
+#define OM_STRUCT more_stats_t
+static const struct orm_om_field more_stats_fields[] = {
+#include <ci/internal/more_stats_def.h>
+};
+#undef OM_STRUCT
+
+#define OM_STRUCT ci_ip_stats_count
+static const struct orm_om_field ip_stats_fields[] = {
+#include <ci/internal/ip_stats_count_def.h>
+};
+#undef OM_STRUCT
+
+#define OM_STRUCT ci_tcp_stats_count
+static const struct orm_om_field tcp_stats_fields[] = {
+#include <ci/internal/tcp_stats_count_def.h>
+};
+#undef OM_STRUCT
+
+#define OM_STRUCT ci_udp_stats_count
+static const struct orm_om_field udp_stats_fields[] = {
+#include <ci/internal/udp_stats_count_def.h>
+};
+#undef OM_STRUCT
+
+#define OM_STRUCT ci_tcp_ext_stats_count
+static const struct orm_om_field tcp_ext_stats_fields[] = {
+#include <ci/internal/tcp_ext_stats_count_def.h>
+};
+#undef OM_STRUCT
+
+#undef OO_STAT
+
+
+/* The per-socket counters come from the same descriptions as the JSON
+ * output.  Those carry no semantics, so everything is a counter apart from
+ * the few fields listed in orm_om_sock_type().
+ */
+#define OM_STRUCT_TCP oo_tcp_socket_stats
+#define OM_STRUCT_UDP ci_udp_socket_stats
+
+#define FTL_TSTRUCT_BEGIN(ctx, name, tag)                               \
+  static const struct orm_om_field ctx##_sock_fields[] = {
+#define FTL_TFIELD_INT(ctx, type, field_name, flags)                    \
+  { #field_name, NULL, OM_COUNTER, offsetof(OM_STRUCT_##ctx, field_name), \
+    sizeof(type) },
+#define FTL_TSTRUCT_END(ctx)                                            \
+  };
+
+STRUCT_TCP_SOCKET_STATS(TCP)
+STRUCT_UDP_SOCKET_STATS(UDP)
+
+#undef FTL_TSTRUCT_BEGIN
+#undef FTL_TFIELD_INT
+#undef FTL_TSTRUCT_END
+
+
+static enum orm_om_type orm_om_sock_type(const struct orm_om_field* field)
+{
+  static const char* const gauges[] = {
+    "max_recvq_pkts",
+    "tx_tmpl_active",
+  };
+  unsigned i;
+
+  for( i = 0; i < sizeof(gauges) / sizeof(gauges[0]); ++i )
+    if( strcmp(field->name, gauges[i]) == 0 )
+      return OM_GAUGE;
+  return field->type;
+}
+
+
+static ci_uint64 orm_om_field_value(const struct orm_om_field* field,
+                                    const void* base)
+{
+  const char* p = (const char*) base + field->offset;
+
+  switch( field->size ) {
+  case 1:
+    return *(const ci_uint8*) p;
+  case 2:
+    return *(const ci_uint16*) p;
+  case 4:
+    return *(const ci_uint32*) p;
+  default:
+    ci_assert_equal(field->size, 8);
+    return *(const ci_uint64*) p;
+  }
+}
+
+#define N_FIELDS(fields)  (sizeof(fields) / sizeof(fields[0]))
+
+/**********************************************************/
+/* Manage stack mappings */
+/**********************************************************/
+
+struct orm_om_stack {
+  ci_netif os_ni;
+  int      os_id;
+};
+
+struct orm_om_state {
+  const char*           stackname;
+  struct orm_om_stack** stacks;
+  int                   n_stacks;
+};
+
+
+struct orm_om_state* orm_om_alloc(const char* stackname)
+{
+  struct orm_om_state* state = calloc(1, sizeof(*state));
+  if( state )
+    state->stackname = stackname;
+  return state;
+}
+
+
+static void orm_om_unmap_stacks(struct orm_om_state* state)
+{
+  int i;
+  for( i = 0; i < state->n_stacks; ++i ) {
+    ci_netif_dtor(&state->stacks[i]->os_ni);
+    free(state->stacks[i]);
+  }
+  free(state->stacks);
+  state->stacks = NULL;
+  state->n_stacks = 0;
+}
+
+
+void orm_om_free(struct orm_om_state* state)
+{
+  orm_om_unmap_stacks(state);
+  free(state);
+}
+
+
+static int orm_om_map_stack(struct orm_om_state* state, unsigned stack_id)
+{
+  struct orm_om_stack** new_stacks;
+  struct orm_om_stack* stack;
+  int rc;
+
+  new_stacks = realloc(state->stacks,
+                       (state->n_stacks + 1) * sizeof(*state->stacks));
+  if( ! new_stacks )
+    return -ENOMEM;
+  state->stacks = new_stacks;
+
+  if( (stack = calloc(1, sizeof(*stack))) == NULL )
+    return -ENOMEM;
+  if( (rc = ci_netif_restore_id(&stack->os_ni, stack_id, true)) != 0 ) {
+    /* Most likely the stack went away since we listed it */
+    LOG("%s: ci_netif_restore_id(%d)=%d\n", __func__, stack_id, rc);
+    free(stack);
+    return 0;
+  }
+  if( state->stackname != NULL &&
+      strcmp(state->stackname, stack->os_ni.state->name) != 0 ) {
+    ci_netif_dtor(&stack->os_ni);
+    free(stack);
+    return 0;
+  }
+  stack->os_id = stack_id;
+  state->stacks[state->n_stacks++] = stack;
+  return 0;
+}
+
+
+int orm_om_map_stacks(struct orm_om_state* state)
+{
+  ci_netif_info_t info;
+  oo_fd fd;
+  int rc, i;
+
+  /* Remapping from scratch each time means that we never keep a stack
+   * alive for long after its last user has gone.
+   */
+  orm_om_unmap_stacks(state);
+
+  if( (rc = oo_fd_open(&fd)) != 0 ) {
+    LOG("%s: Fail: oo_fd_open()=%d.  Onload drivers loaded?\n",
+        __func__, rc);
+    return rc;
+  }
+
+  memset(&info, 0, sizeof(info));
+  i = 0;
+  while( i >= 0 ) {
+    info.ni_index = i;
+    info.ni_orphan = 0;
+    info.ni_subop = CI_DBG_NETIF_INFO_GET_NEXT_NETIF;
+    if( (rc = oo_ioctl(fd, OO_IOC_DBG_GET_STACK_INFO, &info)) != 0 ) {
+      LOG("%s: Fail: oo_ioctl(OO_IOC_DBG_GET_STACK_INFO)=%d.\n",
+          __func__, rc);
+      break;
+    }
+    if( info.ni_exists && (rc = orm_om_map_stack(state, info.ni_index)) != 0 )
+      break;
+    i = info.u.ni_next_ni.index;
+  }
+
+  oo_fd_close(fd);
+  return rc;
+}
+
+/**********************************************************/
+/* Exposition helpers */
+/**********************************************************/
+
+static void om_escape(FILE* f, const char* s, bool label)
+{
+  for( ; *s; ++s ) {
+    if( *s == '\\' )
+      fputs("\\\\", f);
+    else if( *s == '\n' )
+      fputs("\\n", f);
+    else if( *s == '"' && label )
+      fputs("\\\"", f);
+    else
+      fputc(*s, f);
+  }
+}
+
+
+static void om_family(FILE* f, const char* prefix, const char* name,
+                      const char* type, const char* help)
+{
+  fprintf(f, "# TYPE onload_%s%s %s\n", prefix, name, type);
+  if( help != NULL ) {
+    fprintf(f, "# HELP onload_%s%s ", prefix, name);
+    om_escape(f, help, false);
+    fputc('\n', f);
+  }
+}
+
+
+static void om_stack_labels(FILE* f, const struct orm_om_stack* stack)
+{
+  fprintf(f, "stack=\"%d\",stack_name=\"", stack->os_id);
+  om_escape(f, stack->os_ni.state->name, true);
+  fputc('"', f);
+}
+
+
+/* Emit one family per field, with one sample per stack.  OpenMetrics wants
+ * all samples of a family together, hence fields in the outer loop.
+ *
+ * Stack i's values are read from [copies + i * stride], or straight from
+ * its shared state at [state_offset] when [copies] is NULL.
+ */
+static void om_dump_stack_fields(FILE* f, const char* prefix,
+                                 const struct orm_om_field* fields,
+                                 unsigned n_fields,
+                                 struct orm_om_state* state,
+                                 size_t state_offset,
+                                 const void* copies, size_t stride)
+{
+  const struct orm_om_field* field;
+  const void* base;
+  int i;
+
+  for( field = fields; field < fields + n_fields; ++field ) {
+    if( field->type == OM_SKIP )
+      continue;
+    om_family(f, prefix, field->name,
+              field->type == OM_COUNTER ? "counter" : "gauge", field->help);
+    for( i = 0; i < state->n_stacks; ++i ) {
+      if( copies != NULL )
+        base = (const char*) copies + i * stride;
+      else
+        base = (const char*) state->stacks[i]->os_ni.state + state_offset;
+      fprintf(f, "onload_%s%s%s{", prefix, field->name,
+              field->type == OM_COUNTER ? "_total" : "");
+      om_stack_labels(f, state->stacks[i]);
+      fprintf(f, "} %llu\n",
+              (unsigned long long) orm_om_field_value(field, base));
+    }
+  }
+}
+
+/**********************************************************/
+/* Latency histograms */
+/**********************************************************/
+
+#if CI_CFG_LATENCY_HIST
+
+/* Buckets are emitted only where the cumulative count changes, which keeps
+ * mostly-empty histograms small while still being a valid (if sparse)
+ * histogram.  Bounds are converted from CPU cycles to seconds.
+ */
+static void om_lat_hist(FILE* f, const char* name,
+                        const struct orm_om_stack* stack, int sock_id,
+                        const struct oo_lat_hist* h)
+{
+  double hz = IPTIMER_STATE(&stack->os_ni)->khz * 1000.0;
+  ci_uint64 cum = 0;
+  unsigned i;
+
+#define OM_LAT_LABELS()                                                 \
+  do {                                                                  \
+    om_stack_labels(f, stack);                                          \
+    if( sock_id >= 0 )                                                  \
+      fprintf(f, ",socket=\"%d\"", sock_id);                            \
+  } while( 0 )
+
+  for( i = 0; i < OO_LAT_HIST_N_BUCKETS - 1; ++i ) {
+    if( h->bucket[i] == 0 )
+      continue;
+    cum += h->bucket[i];
+    fprintf(f, "onload_%s_seconds_bucket{", name);
+    OM_LAT_LABELS();
+    fprintf(f, ",le=\"%.9g\"} %llu\n",
+            (oo_lat_hist_bucket_min(i + 1) - 1) / hz,
+            (unsigned long long) cum);
+  }
+  /* Count from the buckets rather than h->count so the two can't disagree
+   * when we race with an update.
+   */
+  cum += h->bucket[OO_LAT_HIST_N_BUCKETS - 1];
+  fprintf(f, "onload_%s_seconds_bucket{", name);
+  OM_LAT_LABELS();
+  fprintf(f, ",le=\"+Inf\"} %llu\n", (unsigned long long) cum);
+  fprintf(f, "onload_%s_seconds_count{", name);
+  OM_LAT_LABELS();
+  fprintf(f, "} %llu\n", (unsigned long long) cum);
+  fprintf(f, "onload_%s_seconds_sum{", name);
+  OM_LAT_LABELS();
+  fprintf(f, "} %.9g\n", h->sum / hz);
+
+#undef OM_LAT_LABELS
+}
+
+
+static bool om_lat_hist_on(const struct orm_om_stack* stack, unsigned mode)
+{
+  const ci_netif* ni = &stack->os_ni;
+  return ni->state->opts.latency_hist >= mode &&
+         IPTIMER_STATE(ni)->khz != 0;
+}
+
+
+static void om_dump_lat_hists(FILE* f, struct orm_om_state* state)
+{
+  static const struct {
+    const char* name;
+    const char* help;
+    size_t      offset;
+  } stack_hists[] = {
+    { "latency_rx_to_app", "Time from packet arrival to delivery to the "
+      "application.", offsetof(ci_netif_state, lat_rx_to_app) },
+    { "latency_send_to_wire", "Time from a packet being queued for "
+      "transmit to its TX completion.",
+      offsetof(ci_netif_state, lat_send_to_wire) },
+    { "latency_lock_hold", "Time for which the stack lock was held.",
+      offsetof(ci_netif_state, lat_lock_hold) },
+  };
+  unsigned h, j;
+  int i;
+
+  for( h = 0; h < sizeof(stack_hists) / sizeof(stack_hists[0]); ++h ) {
+    om_family(f, stack_hists[h].name, "_seconds", "histogram",
+              stack_hists[h].help);
+    for( i = 0; i < state->n_stacks; ++i )
+      if( om_lat_hist_on(state->stacks[i], 1) )
+        om_lat_hist(f, stack_hists[h].name, state->stacks[i], -1,
+                    (const void*) ((const char*) state->stacks[i]->os_ni.state
+                                   + stack_hists[h].offset));
+  }
+
+  om_family(f, "socket_latency_rx_to_app", "_seconds", "histogram",
+            "Per-socket time from packet arrival to delivery to the "
+            "application.");
+  for( i = 0; i < state->n_stacks; ++i ) {
+    ci_netif_state* ns = state->stacks[i]->os_ni.state;
+    if( ! om_lat_hist_on(state->stacks[i], 2) )
+      continue;
+    for( j = 0; j < CI_CFG_LATENCY_HIST_SOCKETS; ++j )
+      if( OO_SP_NOT_NULL(ns->lat_sock[j].sock_id) )
+        om_lat_hist(f, "socket_latency_rx_to_app", state->stacks[i],
+                    OO_SP_TO_INT(ns->lat_sock[j].sock_id),
+                    &ns->lat_sock[j].rx_to_app);
+  }
+
+  om_family(f, "socket_latency_send_to_wire", "_seconds", "histogram",
+            "Per-socket time from a packet being queued for transmit to "
+            "its TX completion.");
+  for( i = 0; i < state->n_stacks; ++i ) {
+    ci_netif_state* ns = state->stacks[i]->os_ni.state;
+    if( ! om_lat_hist_on(state->stacks[i], 2) )
+      continue;
+    for( j = 0; j < CI_CFG_LATENCY_HIST_SOCKETS; ++j )
+      if( OO_SP_NOT_NULL(ns->lat_sock[j].sock_id) )
+        om_lat_hist(f, "socket_latency_send_to_wire", state->stacks[i],
+                    OO_SP_TO_INT(ns->lat_sock[j].sock_id),
+                    &ns->lat_sock[j].send_to_wire);
+  }
+}
+
+#endif
+
+/**********************************************************/
+/* Public interface */
+/**********************************************************/
+
+const char orm_om_eof[] = "# EOF\n";
+
+
+int orm_om_dump_stacks(struct orm_om_state* state, FILE* f)
+{
+  int i;
+
+  om_family(f, "stack", "", "info", "Onload stacks being reported.");
+  for( i = 0; i < state->n_stacks; ++i ) {
+    fprintf(f, "onload_stack_info{");
+    om_stack_labels(f, state->stacks[i]);
+    fprintf(f, ",version=\"%s\"} 1\n", onload_version);
+  }
+
+  om_dump_stack_fields(f, "stack_", netif_stats_fields,
+                       N_FIELDS(netif_stats_fields), state,
+                       offsetof(ci_netif_state, stats), NULL, 0);
+#if CI_CFG_SUPPORT_STATS_COLLECTION
+  /* The SNMP-style tcp and udp names carry their own prefix */
+  om_dump_stack_fields(f, "ip_", ip_stats_fields, N_FIELDS(ip_stats_fields),
+                       state, offsetof(ci_netif_state, stats_snapshot.ip),
+                       NULL, 0);
+  om_dump_stack_fields(f, "", tcp_stats_fields, N_FIELDS(tcp_stats_fields),
+                       state, offsetof(ci_netif_state, stats_snapshot.tcp),
+                       NULL, 0);
+  om_dump_stack_fields(f, "", udp_stats_fields, N_FIELDS(udp_stats_fields),
+                       state, offsetof(ci_netif_state, stats_snapshot.udp),
+                       NULL, 0);
+  om_dump_stack_fields(f, "tcp_ext_", tcp_ext_stats_fields,
+                       N_FIELDS(tcp_ext_stats_fields), state,
+                       offsetof(ci_netif_state, stats_snapshot.tcp_ext),
+                       NULL, 0);
+#endif
+#if CI_CFG_LATENCY_HIST
+  om_dump_lat_hists(f, state);
+#endif
+
+  return ferror(f) ? -EIO : 0;
+}
+
+
+struct orm_om_sock {
+  int stack;
+  int id;
+  union {
+    oo_tcp_socket_stats tcp;
+    ci_udp_socket_stats udp;
+  } stats;
+};
+
+
+static void om_dump_sock_fields(FILE* f, const char* prefix,
+                                const struct orm_om_field* fields,
+                                unsigned n_fields,
+                                struct orm_om_state* state,
+                                const struct orm_om_sock* socks, int n_socks)
+{
+  const struct orm_om_field* field;
+  enum orm_om_type type;
+  int i;
+
+  if( n_socks == 0 )
+    return;
+  for( field = fields; field < fields + n_fields; ++field ) {
+    type = orm_om_sock_type(field);
+    om_family(f, prefix, field->name,
+              type == OM_COUNTER ? "counter" : "gauge", NULL);
+    for( i = 0; i < n_socks; ++i ) {
+      fprintf(f, "onload_%s%s%s{", prefix, field->name,
+              type == OM_COUNTER ? "_total" : "");
+      om_stack_labels(f, state->stacks[socks[i].stack]);
+      fprintf(f, ",socket=\"%d\"} %llu\n", socks[i].id,
+              (unsigned long long) orm_om_field_value(field,
+                                                      &socks[i].stats));
+    }
+  }
+}
+
+
+int orm_om_dump_sockets(struct orm_om_state* state, FILE* f, bool per_socket)
+{
+  more_stats_t* more_stats;
+  struct orm_om_sock* tcp = NULL;
+  struct orm_om_sock* udp = NULL;
+  int n_tcp = 0, n_udp = 0;
+  int i, rc = 0;
+  unsigned id;
+
+  more_stats = calloc(state->n_stacks + 1, sizeof(*more_stats));
+  if( more_stats == NULL )
+    return -ENOMEM;
+
+  /* One walk of the endpoints per stack.  Per-socket counters are copied
+   * out so that sockets freed or reused while we emit don't get mixed up.
+   */
+  for( i = 0; i < state->n_stacks; ++i ) {
+    ci_netif* ni = &state->stacks[i]->os_ni;
+
+    get_more_stats(ni, &more_stats[i]);
+    if( ! per_socket )
+      continue;
+
+    for( id = 0; id < ni->state->n_ep_bufs; ++id ) {
+      citp_waitable_obj* wo = ID_TO_WAITABLE_OBJ(ni, id);
+      unsigned w_state = wo->waitable.state;
+      struct orm_om_sock** socks;
+      struct orm_om_sock* new_socks;
+      int* n_socks;
+
+      if( w_state == CI_TCP_STATE_UDP ) {
+        socks = &udp;
+        n_socks = &n_udp;
+      }
+      else if( w_state & CI_TCP_STATE_TCP_CONN ) {
+        socks = &tcp;
+        n_socks = &n_tcp;
+      }
+      else {
+        continue;
+      }
+
+      new_socks = realloc(*socks, (*n_socks + 1) * sizeof(**socks));
+      if( new_socks == NULL ) {
+        rc = -ENOMEM;
+        goto out;
+      }
+      *socks = new_socks;
+      new_socks += (*n_socks)++;
+      new_socks->stack = i;
+      new_socks->id = id;
+      if( socks == &udp )
+        new_socks->stats.udp = wo->udp.stats;
+      else
+        new_socks->stats.tcp = wo->tcp.stats;
+    }
+  }
+
+  om_dump_stack_fields(f, "sockets_", more_stats_fields,
+                       N_FIELDS(more_stats_fields), state, 0,
+                       more_stats, sizeof(*more_stats));
+  om_dump_sock_fields(f, "tcp_socket_", TCP_sock_fields,
+                      N_FIELDS(TCP_sock_fields), state, tcp, n_tcp);
+  om_dump_sock_fields(f, "udp_socket_", UDP_sock_fields,
+                      N_FIELDS(UDP_sock_fields), state, udp, n_udp);
+  rc = ferror(f) ? -EIO : 0;
+
+ out:
+  free(tcp);
+  free(udp);
+  free(more_stats);
+  return rc;
+}
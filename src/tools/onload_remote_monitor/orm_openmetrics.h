@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+#ifndef __ORM_OPENMETRICS_H__
+#define __ORM_OPENMETRICS_H__
+
+/* Generate OpenMetrics text exposition of Onload stack statistics.
+ *
+ * The stacks are mapped once by orm_om_map_stacks() and the mappings kept
+ * until the next call, so that the periodic dumps below are nothing more
+ * than reads of shared memory.  No stack lock is ever taken.
+ *
+ * Output is split in two so that callers can refresh each part on its own
+ * schedule:
+ *
+ *  - orm_om_dump_stacks() emits counters that Onload maintains in the
+ *    shared stack state (ci_netif_stats, the SNMP-style ip/tcp/udp/tcp_ext
+ *    groups and the latency histograms).  The cost is independent of the
+ *    number of sockets.
+ *
+ *  - orm_om_dump_sockets() emits anything that needs a walk of every
+ *    endpoint: the per-stack socket summary ("more_stats") and, optionally,
+ *    per-socket TCP and UDP counters.
+ *
+ * Neither writes the terminating "# EOF" line; the caller appends
+ * orm_om_eof after concatenating the parts.
+ */
+
+struct orm_om_state;
+
+/* The line that ends an exposition */
+extern const char orm_om_eof[];
+
+/* Returns NULL on allocation failure.  [stackname] may be NULL to select all
+ * stacks; the string is not copied.
+ */
+extern struct orm_om_state* orm_om_alloc(const char* stackname);
+
+extern void orm_om_free(struct orm_om_state* state);
+
+/* Drop any existing mappings and map every stack currently accessible.
+ * Stacks that disappear between enumeration and mapping are skipped.
+ * Returns 0 on success, or negative error code.
+ */
+extern int orm_om_map_stacks(struct orm_om_state* state);
+
+/* Return 0 on success, or negative error code */
+extern int orm_om_dump_stacks(struct orm_om_state* state, FILE* f);
+
+/* Return 0 on success, or negative error code */
+extern int orm_om_dump_sockets(struct orm_om_state* state, FILE* f,
+                               bool per_socket);
+
+#endif  /* __ORM_OPENMETRICS_H__ */